@@ -38,10 +38,25 @@
 #include "stats.h"
 #include "parallel.h"
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#ifdef PBRT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE__) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#define PBRT_BVH4_SSE
+#include <xmmintrin.h>
+#endif
 
 namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/BVH tree", treeBytes);
+STAT_COUNTER("Intersections/Occlusion hint hits", nOcclusionHintHits);
 STAT_RATIO("BVH/Primitives per leaf node", totalPrimitives, totalLeafNodes);
 STAT_COUNTER("BVH/Interior nodes", interiorNodes);
 STAT_COUNTER("BVH/Leaf nodes", leafNodes);
@@ -82,6 +97,32 @@ struct BVHBuildNode {
     int splitAxis, firstPrimOffset, nPrimitives;
 };
 
+// Shared state for (possibly parallel) recursive SAH-style builds: leaves
+// claim their ranges of _orderedPrims_ with an atomic offset, and arenas for
+// subtree tasks are kept alive here until the tree has been flattened.
+struct BVHBuildContext {
+    BVHBuildContext(std::vector<std::shared_ptr<Primitive>> &orderedPrims)
+        : orderedPrims(orderedPrims) {}
+    MemoryArena *AllocTaskArena() {
+        std::lock_guard<std::mutex> lock(arenaMutex);
+        taskArenas.push_back(
+            std::unique_ptr<MemoryArena>(new MemoryArena(1024 * 1024)));
+        return taskArenas.back().get();
+    }
+    std::vector<std::shared_ptr<Primitive>> &orderedPrims;
+    // When non-null, leaves also record the original index of each ordered
+    // primitive so the result can be written to the on-disk cache.
+    std::vector<int32_t> *orderedPrimIndices = nullptr;
+    std::atomic<int> totalNodes{0};
+    std::atomic<int> orderedPrimsOffset{0};
+    std::mutex arenaMutex;
+    std::vector<std::unique_ptr<MemoryArena>> taskArenas;
+};
+
+// Minimum number of primitives in a subtree before its build is worth
+// handing to the thread pool.
+PBRT_CONSTEXPR int minPrimsForParallelBuild = 128 * 1024;
+
 struct MortonPrimitive {
     int primitiveIndex;
     uint32_t mortonCode;
@@ -103,6 +144,230 @@ struct LinearBVHNode {
     uint8_t pad[1];        // ensure 32 byte total size
 };
 
+struct alignas(16) WideBVHNode {
+    // Child slab bounds, stored by axis so that one SIMD load covers all
+    // four children for a given axis and side.
+    Float minC[3][4];
+    Float maxC[3][4];
+    int32_t child[4];        // interior: node index; leaf: primitives offset
+    uint16_t nPrimitives[4];  // 0 -> interior child
+    uint8_t nChildren;
+};
+
+// Sixteen-byte node storing its bounds as 8-bit offsets relative to its
+// parent's (decoded) bounds; the traversal stack carries decoded boxes so
+// each node costs half the memory traffic of a _LinearBVHNode_.
+struct CompressedBVHNode {
+    union {
+        int primitivesOffset;   // leaf
+        int secondChildOffset;  // interior
+    };
+    uint16_t nPrimitives;  // 0 -> interior node
+    uint8_t axis;          // interior node: xyz
+    uint8_t qMin[3];       // quantized bounds relative to parent
+    uint8_t qMax[3];
+    uint8_t pad[3];        // ensure 16 byte total size
+};
+
+// Reconstruct a node's bounds from its quantized offsets and its parent's
+// decoded bounds; identical arithmetic is used at build and traversal time,
+// and the result is widened an ulp each way so containment survives
+// round-off.
+static inline Bounds3f DecodeCompressedBounds(const CompressedBVHNode &node,
+                                              const Bounds3f &parent) {
+    Bounds3f b;
+    for (int a = 0; a < 3; ++a) {
+        Float d = parent.pMax[a] - parent.pMin[a];
+        b.pMin[a] =
+            NextFloatDown(parent.pMin[a] + node.qMin[a] * d * (1.f / 255.f));
+        b.pMax[a] =
+            NextFloatUp(parent.pMin[a] + node.qMax[a] * d * (1.f / 255.f));
+    }
+    return b;
+}
+
+// Test the up-to-four child boxes of _node_ against the ray and return a
+// bitmask of the children hit; entry distances are written to _tNear_.
+static inline int IntersectBounds4(const WideBVHNode &node, const Point3f &o,
+                                   const Vector3f &invDir,
+                                   const int dirIsNeg[3], Float rayTMax,
+                                   Float *tNear) {
+    // The slab math (including the conservative tFar scaling) lives in the
+    // shared IntersectP4() utility in geometry.h; mask off the lanes of
+    // children that don't exist.
+    return IntersectP4(node.minC, node.maxC, o, invDir, dirIsNeg, rayTMax,
+                       tNear) &
+           ((1 << node.nChildren) - 1);
+}
+
+// Precomputed shear coefficients for the watertight ray-triangle test,
+// matching the setup in Triangle::Intersect(); computed once per traversal
+// and shared by every leaf triangle batch.
+struct RayShear {
+    RayShear(const Ray &ray) {
+        kz = MaxDimension(Abs(ray.d));
+        kx = kz + 1;
+        if (kx == 3) kx = 0;
+        ky = kx + 1;
+        if (ky == 3) ky = 0;
+        Vector3f d = Permute(ray.d, kx, ky, kz);
+        Sx = -d.x / d.z;
+        Sy = -d.y / d.z;
+        Sz = 1.f / d.z;
+    }
+    int kx, ky, kz;
+    Float Sx, Sy, Sz;
+};
+
+// Conservatively test up to four leaf triangles against one ray, returning
+// a bitmask of the triangles that may be hit. Every rejection carries a
+// relative margin, so rounding (or FP contraction) differences against the
+// full test can only produce false positives; the surviving triangles are
+// handed to Primitive::Intersect(), which keeps the watertight guarantees.
+PBRT_CONSTEXPR Float triBatchRelEps = 1e-6f;
+
+static int IntersectTriangles4(const Ray &ray, const RayShear &rs,
+                               const Point3f *const p0[4],
+                               const Point3f *const p1[4],
+                               const Point3f *const p2[4], int nTris,
+                               Float tEst[4]) {
+#ifdef PBRT_BVH4_SSE
+    // Gather the translated vertex components into lane arrays, padding
+    // unused lanes with the first triangle
+    alignas(16) float xs[3][4], ys[3][4], zs[3][4];
+    for (int l = 0; l < nTris; ++l) {
+        const Point3f *tv[3] = {p0[l], p1[l], p2[l]};
+        for (int j = 0; j < 3; ++j) {
+            xs[j][l] = (*tv[j])[rs.kx] - ray.o[rs.kx];
+            ys[j][l] = (*tv[j])[rs.ky] - ray.o[rs.ky];
+            zs[j][l] = (*tv[j])[rs.kz] - ray.o[rs.kz];
+        }
+    }
+    for (int l = nTris; l < 4; ++l)
+        for (int j = 0; j < 3; ++j) {
+            xs[j][l] = xs[j][0];
+            ys[j][l] = ys[j][0];
+            zs[j][l] = zs[j][0];
+        }
+    __m128 Sx = _mm_set1_ps(rs.Sx), Sy = _mm_set1_ps(rs.Sy),
+           Sz = _mm_set1_ps(rs.Sz);
+    __m128 z0 = _mm_load_ps(zs[0]), z1 = _mm_load_ps(zs[1]),
+           z2 = _mm_load_ps(zs[2]);
+    __m128 x0 = _mm_add_ps(_mm_load_ps(xs[0]), _mm_mul_ps(Sx, z0));
+    __m128 x1 = _mm_add_ps(_mm_load_ps(xs[1]), _mm_mul_ps(Sx, z1));
+    __m128 x2 = _mm_add_ps(_mm_load_ps(xs[2]), _mm_mul_ps(Sx, z2));
+    __m128 y0 = _mm_add_ps(_mm_load_ps(ys[0]), _mm_mul_ps(Sy, z0));
+    __m128 y1 = _mm_add_ps(_mm_load_ps(ys[1]), _mm_mul_ps(Sy, z1));
+    __m128 y2 = _mm_add_ps(_mm_load_ps(ys[2]), _mm_mul_ps(Sy, z2));
+
+    // Compute edge functions and their conservative margins
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 eps = _mm_set1_ps(triBatchRelEps);
+    __m128 e0 = _mm_sub_ps(_mm_mul_ps(x1, y2), _mm_mul_ps(y1, x2));
+    __m128 e1 = _mm_sub_ps(_mm_mul_ps(x2, y0), _mm_mul_ps(y2, x0));
+    __m128 e2 = _mm_sub_ps(_mm_mul_ps(x0, y1), _mm_mul_ps(y0, x1));
+    __m128 m0 = _mm_mul_ps(
+        eps, _mm_add_ps(_mm_and_ps(absMask, _mm_mul_ps(x1, y2)),
+                        _mm_and_ps(absMask, _mm_mul_ps(y1, x2))));
+    __m128 m1 = _mm_mul_ps(
+        eps, _mm_add_ps(_mm_and_ps(absMask, _mm_mul_ps(x2, y0)),
+                        _mm_and_ps(absMask, _mm_mul_ps(y2, x0))));
+    __m128 m2 = _mm_mul_ps(
+        eps, _mm_add_ps(_mm_and_ps(absMask, _mm_mul_ps(x0, y1)),
+                        _mm_and_ps(absMask, _mm_mul_ps(y0, x1))));
+    __m128 zero = _mm_setzero_ps();
+    __m128 hasNeg = _mm_or_ps(
+        _mm_cmplt_ps(e0, _mm_sub_ps(zero, m0)),
+        _mm_or_ps(_mm_cmplt_ps(e1, _mm_sub_ps(zero, m1)),
+                  _mm_cmplt_ps(e2, _mm_sub_ps(zero, m2))));
+    __m128 hasPos =
+        _mm_or_ps(_mm_cmpgt_ps(e0, m0),
+                  _mm_or_ps(_mm_cmpgt_ps(e1, m1), _mm_cmpgt_ps(e2, m2)));
+    __m128 miss = _mm_and_ps(hasNeg, hasPos);
+
+    // Reject triangles whose scaled hit distance lies outside (0, tMax)
+    __m128 det = _mm_add_ps(e0, _mm_add_ps(e1, e2));
+    __m128 mDet = _mm_add_ps(m0, _mm_add_ps(m1, m2));
+    z0 = _mm_mul_ps(z0, Sz);
+    z1 = _mm_mul_ps(z1, Sz);
+    z2 = _mm_mul_ps(z2, Sz);
+    __m128 tScaled =
+        _mm_add_ps(_mm_mul_ps(e0, z0),
+                   _mm_add_ps(_mm_mul_ps(e1, z1), _mm_mul_ps(e2, z2)));
+    __m128 mT = _mm_mul_ps(
+        eps, _mm_add_ps(_mm_and_ps(absMask, _mm_mul_ps(e0, z0)),
+                        _mm_add_ps(_mm_and_ps(absMask, _mm_mul_ps(e1, z1)),
+                                   _mm_and_ps(absMask, _mm_mul_ps(e2, z2)))));
+    __m128 detTMax = _mm_mul_ps(_mm_set1_ps(ray.tMax), det);
+    __m128 M =
+        _mm_add_ps(mT, _mm_mul_ps(eps, _mm_and_ps(absMask, detTMax)));
+    __m128 negDet = _mm_cmplt_ps(det, _mm_sub_ps(zero, mDet));
+    __m128 posDet = _mm_cmpgt_ps(det, mDet);
+    __m128 missNeg =
+        _mm_and_ps(negDet, _mm_or_ps(_mm_cmpge_ps(tScaled, M),
+                                     _mm_cmplt_ps(tScaled,
+                                                  _mm_sub_ps(detTMax, M))));
+    __m128 missPos = _mm_and_ps(
+        posDet, _mm_or_ps(_mm_cmple_ps(tScaled, _mm_sub_ps(zero, M)),
+                          _mm_cmpgt_ps(tScaled, _mm_add_ps(detTMax, M))));
+    miss = _mm_or_ps(miss, _mm_or_ps(missNeg, missPos));
+    // Estimate each surviving triangle's hit distance so candidates can be
+    // fully intersected nearest-first; purely an ordering hint, so the
+    // unguarded division is harmless for rejected or degenerate lanes
+    alignas(16) float t[4];
+    _mm_store_ps(t, _mm_div_ps(tScaled, det));
+    for (int l = 0; l < 4; ++l) tEst[l] = t[l];
+    return ~_mm_movemask_ps(miss) & ((1 << nTris) - 1);
+#else
+    int hits = 0;
+    for (int l = 0; l < nTris; ++l) {
+        // Translate and shear the triangle vertices into ray space
+        Float z0 = (*p0[l])[rs.kz] - ray.o[rs.kz];
+        Float z1 = (*p1[l])[rs.kz] - ray.o[rs.kz];
+        Float z2 = (*p2[l])[rs.kz] - ray.o[rs.kz];
+        Float x0 = (*p0[l])[rs.kx] - ray.o[rs.kx] + rs.Sx * z0;
+        Float x1 = (*p1[l])[rs.kx] - ray.o[rs.kx] + rs.Sx * z1;
+        Float x2 = (*p2[l])[rs.kx] - ray.o[rs.kx] + rs.Sx * z2;
+        Float y0 = (*p0[l])[rs.ky] - ray.o[rs.ky] + rs.Sy * z0;
+        Float y1 = (*p1[l])[rs.ky] - ray.o[rs.ky] + rs.Sy * z1;
+        Float y2 = (*p2[l])[rs.ky] - ray.o[rs.ky] + rs.Sy * z2;
+
+        // Compute edge functions and their conservative margins
+        Float e0 = x1 * y2 - y1 * x2;
+        Float e1 = x2 * y0 - y2 * x0;
+        Float e2 = x0 * y1 - y0 * x1;
+        Float m0 = triBatchRelEps * (std::abs(x1 * y2) + std::abs(y1 * x2));
+        Float m1 = triBatchRelEps * (std::abs(x2 * y0) + std::abs(y2 * x0));
+        Float m2 = triBatchRelEps * (std::abs(x0 * y1) + std::abs(y0 * x1));
+        bool hasNeg = e0 < -m0 || e1 < -m1 || e2 < -m2;
+        bool hasPos = e0 > m0 || e1 > m1 || e2 > m2;
+        if (hasNeg && hasPos) continue;
+
+        // Reject the triangle if the scaled hit distance lies outside
+        // (0, tMax)
+        Float det = e0 + e1 + e2;
+        Float mDet = m0 + m1 + m2;
+        z0 *= rs.Sz;
+        z1 *= rs.Sz;
+        z2 *= rs.Sz;
+        Float tScaled = e0 * z0 + e1 * z1 + e2 * z2;
+        Float mT = triBatchRelEps * (std::abs(e0 * z0) + std::abs(e1 * z1) +
+                                     std::abs(e2 * z2));
+        Float detTMax = ray.tMax * det;
+        Float M = mT + triBatchRelEps * std::abs(detTMax);
+        if (det < -mDet) {
+            if (tScaled >= M || tScaled < detTMax - M) continue;
+        } else if (det > mDet) {
+            if (tScaled <= -M || tScaled > detTMax + M) continue;
+        }
+        // Ordering hint only; exact distances come from the full test
+        tEst[l] = det != 0 ? tScaled / det : 0;
+        hits |= 1 << l;
+    }
+    return hits;
+#endif
+}
+
 // BVHAccel Utility Functions
 inline uint32_t LeftShift3(uint32_t x) {
     CHECK_LE(x, (1 << 10));
@@ -179,32 +444,119 @@ static void RadixSort(std::vector<MortonPrimitive> *v) {
     if (nPasses & 1) std::swap(*v, tempVector);
 }
 
+// On-disk BVH cache format: header, _nNodes_ LinearBVHNodes, and the
+// ordered-primitive index permutation.
+struct BVHCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t floatSize;
+    uint64_t hash;
+    int32_t nNodes;
+    int32_t pad;
+    int64_t nOrderedPrims;
+    int64_t nOrigPrims;
+};
+static const char bvhCacheMagic[8] = {'P', 'B', 'R', 'T', 'B', 'V', 'H', '\0'};
+PBRT_CONSTEXPR uint32_t bvhCacheVersion = 1;
+
+// Hash the build inputs (primitive bounds and build settings) with FNV-1a;
+// any geometry or parameter change invalidates the cached tree.
+static uint64_t HashBVHInputs(
+    const std::vector<BVHPrimitiveInfo> &primitiveInfo, int maxPrimsInNode,
+    BVHAccel::SplitMethod splitMethod) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const void *ptr, size_t size) {
+        const unsigned char *c = (const unsigned char *)ptr;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= c[i];
+            h *= 1099511628211ull;
+        }
+    };
+    mix(&maxPrimsInNode, sizeof(maxPrimsInNode));
+    mix(&splitMethod, sizeof(splitMethod));
+    uint64_t n = primitiveInfo.size();
+    mix(&n, sizeof(n));
+    for (const BVHPrimitiveInfo &pi : primitiveInfo) {
+        mix(&pi.bounds.pMin, sizeof(pi.bounds.pMin));
+        mix(&pi.bounds.pMax, sizeof(pi.bounds.pMax));
+    }
+    return h;
+}
+
 // BVHAccel Method Definitions
 BVHAccel::BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
-                   int maxPrimsInNode, SplitMethod splitMethod)
+                   int maxPrimsInNode, SplitMethod splitMethod,
+                   NodeLayout nodeLayout, const std::string &cacheDir,
+                   bool occlusionHintsEnabled, bool primaryHintsEnabled)
     : maxPrimsInNode(std::min(255, maxPrimsInNode)),
       splitMethod(splitMethod),
+      nodeLayout(nodeLayout),
       primitives(std::move(p)) {
     ProfilePhase _(Prof::AccelConstruction);
+    if (occlusionHintsEnabled) occlusionHints.resize(MaxThreadIndex());
+    if (primaryHintsEnabled) lastHits.resize(MaxThreadIndex());
     if (primitives.empty()) return;
     // Build BVH from _primitives_
 
     // Initialize _primitiveInfo_ array for primitives
     std::vector<BVHPrimitiveInfo> primitiveInfo(primitives.size());
-    for (size_t i = 0; i < primitives.size(); ++i)
-        primitiveInfo[i] = {i, primitives[i]->WorldBound()};
+    ParallelFor([&](int64_t i) {
+        primitiveInfo[i] = {(size_t)i, primitives[i]->WorldBound()};
+    }, primitives.size(), 1024);
+
+    // Check for a cached flattened tree before building; the HLBVH and wide
+    // layouts aren't cached since the former builds quickly anyway and the
+    // latter doesn't use _LinearBVHNode_.
+    std::string cachePath;
+    uint64_t cacheHash = 0;
+    std::vector<int32_t> orderedPrimIndices;
+    if (!cacheDir.empty() && nodeLayout == NodeLayout::Binary &&
+        splitMethod != SplitMethod::HLBVH) {
+        cacheHash =
+            HashBVHInputs(primitiveInfo, this->maxPrimsInNode, splitMethod);
+        cachePath = cacheDir + "/" +
+                    StringPrintf("bvh-%016llx.bin",
+                                 (unsigned long long)cacheHash);
+        if (LoadBVHCache(cachePath, cacheHash)) {
+            LOG(INFO) << "Loaded BVH from cache file " << cachePath;
+            return;
+        }
+    }
 
     // Build BVH tree for primitives using _primitiveInfo_
     MemoryArena arena(1024 * 1024);
     int totalNodes = 0;
     std::vector<std::shared_ptr<Primitive>> orderedPrims;
-    orderedPrims.reserve(primitives.size());
+    BVHBuildContext ctx(orderedPrims);
     BVHBuildNode *root;
-    if (splitMethod == SplitMethod::HLBVH)
+    if (splitMethod == SplitMethod::HLBVH) {
+        orderedPrims.reserve(primitives.size());
         root = HLBVHBuild(arena, primitiveInfo, &totalNodes, orderedPrims);
-    else
-        root = recursiveBuild(arena, primitiveInfo, 0, primitives.size(),
-                              &totalNodes, orderedPrims);
+    } else if (splitMethod == SplitMethod::SBVH) {
+        // Allow reference duplication up to one extra reference per
+        // primitive before spatial splits are disabled
+        orderedPrims.reserve(primitives.size());
+        int spatialSplitBudget = primitives.size();
+        Bounds3f rootBounds;
+        for (const BVHPrimitiveInfo &pi : primitiveInfo)
+            rootBounds = Union(rootBounds, pi.bounds);
+        root = SBVHBuild(arena, primitiveInfo, &totalNodes,
+                         &spatialSplitBudget, orderedPrims,
+                         rootBounds.SurfaceArea(),
+                         cachePath.empty() ? nullptr : &orderedPrimIndices);
+    } else {
+        // Pre-size _orderedPrims_ so that leaves created by concurrent
+        // subtree tasks can claim their ranges via _ctx.orderedPrimsOffset_
+        orderedPrims.resize(primitives.size());
+        if (!cachePath.empty()) {
+            orderedPrimIndices.resize(primitives.size());
+            ctx.orderedPrimIndices = &orderedPrimIndices;
+        }
+        root = recursiveBuild(ctx, arena, primitiveInfo, 0, primitives.size());
+        totalNodes = ctx.totalNodes;
+        CHECK_EQ((int)primitives.size(), (int)ctx.orderedPrimsOffset);
+    }
+    size_t nOrigPrims = primitives.size();
     primitives.swap(orderedPrims);
     primitiveInfo.resize(0);
     LOG(INFO) << StringPrintf("BVH created with %d nodes for %d "
@@ -216,16 +568,165 @@ BVHAccel::BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
                               (1024.f * 1024.f));
 
     // Compute representation of depth-first traversal of BVH tree
-    treeBytes += totalNodes * sizeof(LinearBVHNode) + sizeof(*this) +
-                 primitives.size() * sizeof(primitives[0]);
-    nodes = AllocAligned<LinearBVHNode>(totalNodes);
-    int offset = 0;
-    flattenBVHTree(root, &offset);
-    CHECK_EQ(totalNodes, offset);
+    if (nodeLayout == NodeLayout::Wide4) {
+        // Collapse binary tree into four-wide nodes for SIMD traversal
+        std::vector<WideBVHNode> wide;
+        wide.reserve(totalNodes / 2 + 1);
+        flattenWideBVHTree(root, &wide);
+        treeBytes += wide.size() * sizeof(WideBVHNode) + sizeof(*this) +
+                     primitives.size() * sizeof(primitives[0]);
+        wideNodes = AllocAligned<WideBVHNode>(wide.size());
+        memcpy(wideNodes, wide.data(), wide.size() * sizeof(WideBVHNode));
+        nWideNodes = wide.size();
+    } else if (nodeLayout == NodeLayout::Compressed) {
+        treeBytes += totalNodes * sizeof(CompressedBVHNode) + sizeof(*this) +
+                     primitives.size() * sizeof(primitives[0]);
+        compressedRootBounds = root->bounds;
+        compressedNodes = AllocAligned<CompressedBVHNode>(totalNodes);
+        nNodes = totalNodes;
+        int offset = 0;
+        flattenCompressedBVHTree(root, compressedRootBounds, &offset);
+        CHECK_EQ(totalNodes, offset);
+    } else {
+        treeBytes += totalNodes * sizeof(LinearBVHNode) + sizeof(*this) +
+                     primitives.size() * sizeof(primitives[0]);
+        nodes = AllocAligned<LinearBVHNode>(totalNodes);
+        ParallelFirstTouch(nodes, totalNodes * sizeof(LinearBVHNode));
+        nNodes = totalNodes;
+        int offset = 0;
+        flattenBVHTree(root, &offset);
+        CHECK_EQ(totalNodes, offset);
+        if (!cachePath.empty())
+            WriteBVHCache(cachePath, cacheHash, totalNodes, orderedPrimIndices,
+                          nOrigPrims);
+    }
+}
+
+bool BVHAccel::LoadBVHCache(const std::string &path, uint64_t hash) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    BVHCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              memcmp(header.magic, bvhCacheMagic, sizeof(bvhCacheMagic)) == 0 &&
+              header.version == bvhCacheVersion &&
+              header.floatSize == sizeof(Float) && header.hash == hash &&
+              header.nNodes > 0 &&
+              header.nOrigPrims == (int64_t)primitives.size() &&
+              header.nOrderedPrims >= (int64_t)primitives.size();
+    if (ok) {
+        nNodes = header.nNodes;
+        std::vector<int32_t> indices(header.nOrderedPrims);
+        bool nodesLoaded = false;
+#ifdef PBRT_HAVE_MMAP
+        // Map the node array straight out of the cache file rather than
+        // copying it onto the heap: with several pbrt processes rendering
+        // the same scene on one machine, the page cache then backs them
+        // all with a single physical copy of the tree. The mapping is
+        // private and writable, so an in-place Refit() just privatizes the
+        // pages it touches.
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            size_t mapLen = sizeof(BVHCacheHeader) +
+                            (size_t)header.nNodes * sizeof(LinearBVHNode);
+            void *base =
+                mmap(nullptr, mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                     fd, 0);
+            close(fd);
+            if (base != MAP_FAILED) {
+                if (fseek(f, (long)mapLen, SEEK_SET) == 0) {
+                    nodes = (LinearBVHNode *)((char *)base +
+                                              sizeof(BVHCacheHeader));
+                    nodesUnmapPtr = base;
+                    nodesUnmapLength = mapLen;
+                    nodesLoaded = true;
+                } else
+                    munmap(base, mapLen);
+            }
+        }
+#endif
+        if (!nodesLoaded) {
+            nodes = AllocAligned<LinearBVHNode>(header.nNodes);
+            nodesLoaded = fread(nodes, sizeof(LinearBVHNode), header.nNodes,
+                                f) == (size_t)header.nNodes;
+        }
+        ok = nodesLoaded &&
+             fread(&indices[0], sizeof(int32_t), indices.size(), f) ==
+                 indices.size();
+        for (size_t i = 0; ok && i < indices.size(); ++i)
+            ok = indices[i] >= 0 && indices[i] < (int32_t)primitives.size();
+        if (ok) {
+            // Reorder _primitives_ to match the cached tree's leaf offsets
+            std::vector<std::shared_ptr<Primitive>> orderedPrims(
+                header.nOrderedPrims);
+            for (size_t i = 0; i < indices.size(); ++i)
+                orderedPrims[i] = primitives[indices[i]];
+            primitives.swap(orderedPrims);
+            treeBytes += header.nNodes * sizeof(LinearBVHNode) +
+                         sizeof(*this) +
+                         primitives.size() * sizeof(primitives[0]);
+        } else {
+            Warning("Ignoring truncated or corrupt BVH cache file \"%s\".",
+                    path.c_str());
+            ReleaseNodes();
+            nNodes = 0;
+        }
+    }
+    fclose(f);
+    return ok && nodes != nullptr;
+}
+
+void BVHAccel::WriteBVHCache(const std::string &path, uint64_t hash,
+                             int nNodes,
+                             const std::vector<int32_t> &orderedPrimIndices,
+                             size_t nOrigPrims) const {
+    CHECK_EQ(orderedPrimIndices.size(), primitives.size());
+    // Write to a temporary file and rename it into place so that a
+    // concurrent render of the same scene never reads a partial cache
+    std::string tmpPath = path + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        Warning("Unable to write BVH cache file \"%s\".", tmpPath.c_str());
+        return;
+    }
+    BVHCacheHeader header = {};
+    memcpy(header.magic, bvhCacheMagic, sizeof(bvhCacheMagic));
+    header.version = bvhCacheVersion;
+    header.floatSize = sizeof(Float);
+    header.hash = hash;
+    header.nNodes = nNodes;
+    header.nOrderedPrims = primitives.size();
+    header.nOrigPrims = nOrigPrims;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(nodes, sizeof(LinearBVHNode), nNodes, f) ==
+                  (size_t)nNodes &&
+              fwrite(&orderedPrimIndices[0], sizeof(int32_t),
+                     orderedPrimIndices.size(),
+                     f) == orderedPrimIndices.size();
+    if (fclose(f) != 0) ok = false;
+    if (ok && rename(tmpPath.c_str(), path.c_str()) != 0) ok = false;
+    if (!ok) {
+        Warning("Error writing BVH cache file \"%s\".", path.c_str());
+        remove(tmpPath.c_str());
+    } else
+        LOG(INFO) << "Wrote BVH cache file " << path;
 }
 
 Bounds3f BVHAccel::WorldBound() const {
-    return nodes ? nodes[0].bounds : Bounds3f();
+    if (nodes) return nodes[0].bounds;
+    if (compressedNodes) return compressedRootBounds;
+    if (wideNodes) {
+        // Recover the root bounds from the root node's child slabs
+        Bounds3f b;
+        for (int i = 0; i < wideNodes[0].nChildren; ++i)
+            b = Union(b, Bounds3f(Point3f(wideNodes[0].minC[0][i],
+                                          wideNodes[0].minC[1][i],
+                                          wideNodes[0].minC[2][i]),
+                                  Point3f(wideNodes[0].maxC[0][i],
+                                          wideNodes[0].maxC[1][i],
+                                          wideNodes[0].maxC[2][i])));
+        return b;
+    }
+    return Bounds3f();
 }
 
 struct BucketInfo {
@@ -233,42 +734,72 @@ struct BucketInfo {
     Bounds3f bounds;
 };
 
+// Compute the union of the primitive bounds (or centroids) over
+// _[start, end)_, chunking the reduction across threads for large ranges
+static Bounds3f RangeBounds(const std::vector<BVHPrimitiveInfo> &primitiveInfo,
+                            int start, int end, bool centroidsOnly) {
+    PBRT_CONSTEXPR int chunkSize = 64 * 1024;
+    int n = end - start;
+    Bounds3f bounds;
+    if (n < minPrimsForParallelBuild) {
+        for (int i = start; i < end; ++i)
+            bounds = centroidsOnly
+                         ? Union(bounds, primitiveInfo[i].centroid)
+                         : Union(bounds, primitiveInfo[i].bounds);
+        return bounds;
+    }
+    int nChunks = (n + chunkSize - 1) / chunkSize;
+    std::vector<Bounds3f> chunkBounds(nChunks);
+    ParallelFor([&](int64_t c) {
+        int cs = start + c * chunkSize;
+        int ce = std::min(cs + chunkSize, end);
+        for (int i = cs; i < ce; ++i)
+            chunkBounds[c] =
+                centroidsOnly ? Union(chunkBounds[c], primitiveInfo[i].centroid)
+                              : Union(chunkBounds[c], primitiveInfo[i].bounds);
+    }, nChunks);
+    for (const Bounds3f &b : chunkBounds) bounds = Union(bounds, b);
+    return bounds;
+}
+
 BVHBuildNode *BVHAccel::recursiveBuild(
-    MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo, int start,
-    int end, int *totalNodes,
-    std::vector<std::shared_ptr<Primitive>> &orderedPrims) {
+    BVHBuildContext &ctx, MemoryArena &arena,
+    std::vector<BVHPrimitiveInfo> &primitiveInfo, int start, int end) {
     CHECK_NE(start, end);
     BVHBuildNode *node = arena.Alloc<BVHBuildNode>();
-    (*totalNodes)++;
+    ctx.totalNodes++;
     // Compute bounds of all primitives in BVH node
-    Bounds3f bounds;
-    for (int i = start; i < end; ++i)
-        bounds = Union(bounds, primitiveInfo[i].bounds);
+    Bounds3f bounds = RangeBounds(primitiveInfo, start, end, false);
     int nPrimitives = end - start;
     if (nPrimitives == 1) {
         // Create leaf _BVHBuildNode_
-        int firstPrimOffset = orderedPrims.size();
+        int firstPrimOffset = ctx.orderedPrimsOffset.fetch_add(nPrimitives);
         for (int i = start; i < end; ++i) {
             int primNum = primitiveInfo[i].primitiveNumber;
-            orderedPrims.push_back(primitives[primNum]);
+            ctx.orderedPrims[firstPrimOffset + i - start] = primitives[primNum];
+            if (ctx.orderedPrimIndices)
+                (*ctx.orderedPrimIndices)[firstPrimOffset + i - start] =
+                    primNum;
         }
         node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
         return node;
     } else {
         // Compute bound of primitive centroids, choose split dimension _dim_
-        Bounds3f centroidBounds;
-        for (int i = start; i < end; ++i)
-            centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
+        Bounds3f centroidBounds = RangeBounds(primitiveInfo, start, end, true);
         int dim = centroidBounds.MaximumExtent();
 
         // Partition primitives into two sets and build children
         int mid = (start + end) / 2;
         if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
             // Create leaf _BVHBuildNode_
-            int firstPrimOffset = orderedPrims.size();
+            int firstPrimOffset = ctx.orderedPrimsOffset.fetch_add(nPrimitives);
             for (int i = start; i < end; ++i) {
                 int primNum = primitiveInfo[i].primitiveNumber;
-                orderedPrims.push_back(primitives[primNum]);
+                ctx.orderedPrims[firstPrimOffset + i - start] =
+                    primitives[primNum];
+                if (ctx.orderedPrimIndices)
+                    (*ctx.orderedPrimIndices)[firstPrimOffset + i - start] =
+                        primNum;
             }
             node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
             return node;
@@ -321,16 +852,49 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                     BucketInfo buckets[nBuckets];
 
                     // Initialize _BucketInfo_ for SAH partition buckets
-                    for (int i = start; i < end; ++i) {
-                        int b = nBuckets *
-                                centroidBounds.Offset(
-                                    primitiveInfo[i].centroid)[dim];
-                        if (b == nBuckets) b = nBuckets - 1;
-                        CHECK_GE(b, 0);
-                        CHECK_LT(b, nBuckets);
-                        buckets[b].count++;
-                        buckets[b].bounds =
-                            Union(buckets[b].bounds, primitiveInfo[i].bounds);
+                    if (nPrimitives < minPrimsForParallelBuild) {
+                        for (int i = start; i < end; ++i) {
+                            int b = nBuckets *
+                                    centroidBounds.Offset(
+                                        primitiveInfo[i].centroid)[dim];
+                            if (b == nBuckets) b = nBuckets - 1;
+                            CHECK_GE(b, 0);
+                            CHECK_LT(b, nBuckets);
+                            buckets[b].count++;
+                            buckets[b].bounds = Union(buckets[b].bounds,
+                                                      primitiveInfo[i].bounds);
+                        }
+                    } else {
+                        // Bin primitives into per-chunk buckets in parallel,
+                        // then merge the chunks
+                        PBRT_CONSTEXPR int chunkSize = 64 * 1024;
+                        int nChunks = (nPrimitives + chunkSize - 1) / chunkSize;
+                        std::vector<BucketInfo> chunkBuckets(nChunks *
+                                                             nBuckets);
+                        ParallelFor([&](int64_t c) {
+                            BucketInfo *cb = &chunkBuckets[c * nBuckets];
+                            int cs = start + c * chunkSize;
+                            int ce = std::min(cs + chunkSize, end);
+                            for (int i = cs; i < ce; ++i) {
+                                int b = nBuckets *
+                                        centroidBounds.Offset(
+                                            primitiveInfo[i].centroid)[dim];
+                                if (b == nBuckets) b = nBuckets - 1;
+                                CHECK_GE(b, 0);
+                                CHECK_LT(b, nBuckets);
+                                cb[b].count++;
+                                cb[b].bounds = Union(cb[b].bounds,
+                                                     primitiveInfo[i].bounds);
+                            }
+                        }, nChunks);
+                        for (int c = 0; c < nChunks; ++c)
+                            for (int b = 0; b < nBuckets; ++b) {
+                                buckets[b].count +=
+                                    chunkBuckets[c * nBuckets + b].count;
+                                buckets[b].bounds =
+                                    Union(buckets[b].bounds,
+                                          chunkBuckets[c * nBuckets + b].bounds);
+                            }
                     }
 
                     // Compute costs for splitting after each bucket
@@ -366,6 +930,7 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                     // bucket
                     Float leafCost = nPrimitives;
                     if (nPrimitives > maxPrimsInNode || minCost < leafCost) {
+                        // Partition primitives at selected SAH bucket
                         BVHPrimitiveInfo *pmid = std::partition(
                             &primitiveInfo[start], &primitiveInfo[end - 1] + 1,
                             [=](const BVHPrimitiveInfo &pi) {
@@ -379,10 +944,15 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                         mid = pmid - &primitiveInfo[0];
                     } else {
                         // Create leaf _BVHBuildNode_
-                        int firstPrimOffset = orderedPrims.size();
+                        int firstPrimOffset =
+                            ctx.orderedPrimsOffset.fetch_add(nPrimitives);
                         for (int i = start; i < end; ++i) {
                             int primNum = primitiveInfo[i].primitiveNumber;
-                            orderedPrims.push_back(primitives[primNum]);
+                            ctx.orderedPrims[firstPrimOffset + i - start] =
+                                primitives[primNum];
+                            if (ctx.orderedPrimIndices)
+                                (*ctx.orderedPrimIndices)[firstPrimOffset + i -
+                                                          start] = primNum;
                         }
                         node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
                         return node;
@@ -391,13 +961,243 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                 break;
             }
             }
-            node->InitInterior(dim,
-                               recursiveBuild(arena, primitiveInfo, start, mid,
-                                              totalNodes, orderedPrims),
-                               recursiveBuild(arena, primitiveInfo, mid, end,
-                                              totalNodes, orderedPrims));
+            if (nPrimitives > minPrimsForParallelBuild) {
+                // Build the two subtrees as thread pool tasks; the spawned
+                // subtree gets its own arena since _MemoryArena_ isn't
+                // thread-safe
+                BVHBuildNode *children[2];
+                MemoryArena *taskArena = ctx.AllocTaskArena();
+                ParallelFor([&](int64_t i) {
+                    if (i == 0)
+                        children[0] = recursiveBuild(ctx, *taskArena,
+                                                     primitiveInfo, start, mid);
+                    else
+                        children[1] =
+                            recursiveBuild(ctx, arena, primitiveInfo, mid, end);
+                }, 2);
+                node->InitInterior(dim, children[0], children[1]);
+            } else
+                node->InitInterior(
+                    dim, recursiveBuild(ctx, arena, primitiveInfo, start, mid),
+                    recursiveBuild(ctx, arena, primitiveInfo, mid, end));
+        }
+    }
+    return node;
+}
+
+BVHBuildNode *BVHAccel::SBVHBuild(
+    MemoryArena &arena, std::vector<BVHPrimitiveInfo> &refs, int *totalNodes,
+    int *spatialSplitBudget,
+    std::vector<std::shared_ptr<Primitive>> &orderedPrims,
+    Float rootSurfaceArea, std::vector<int32_t> *orderedPrimIndices) {
+    CHECK(!refs.empty());
+    (*totalNodes)++;
+    BVHBuildNode *node = arena.Alloc<BVHBuildNode>();
+    // Compute bounds of all references in SBVH node
+    Bounds3f bounds;
+    for (const BVHPrimitiveInfo &r : refs) bounds = Union(bounds, r.bounds);
+    int nRefs = refs.size();
+
+    // Create a leaf, deduplicating references that spatial splits have
+    // copied into both subtrees of an ancestor
+    auto makeLeaf = [&]() -> BVHBuildNode * {
+        std::sort(refs.begin(), refs.end(),
+                  [](const BVHPrimitiveInfo &a, const BVHPrimitiveInfo &b) {
+                      return a.primitiveNumber < b.primitiveNumber;
+                  });
+        int firstPrimOffset = orderedPrims.size();
+        int nUnique = 0;
+        for (int i = 0; i < nRefs; ++i) {
+            if (i > 0 &&
+                refs[i].primitiveNumber == refs[i - 1].primitiveNumber)
+                continue;
+            orderedPrims.push_back(primitives[refs[i].primitiveNumber]);
+            if (orderedPrimIndices)
+                orderedPrimIndices->push_back(refs[i].primitiveNumber);
+            ++nUnique;
+        }
+        node->InitLeaf(firstPrimOffset, nUnique, bounds);
+        return node;
+    };
+    if (nRefs == 1) return makeLeaf();
+
+    // Compute bound of reference centroids, choose split dimension _dim_
+    Bounds3f centroidBounds;
+    for (const BVHPrimitiveInfo &r : refs)
+        centroidBounds = Union(centroidBounds, r.centroid);
+    int dim = centroidBounds.MaximumExtent();
+    if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) return makeLeaf();
+
+    // Find best object split with standard SAH binning over centroids
+    PBRT_CONSTEXPR int nBuckets = 12;
+    BucketInfo buckets[nBuckets];
+    for (const BVHPrimitiveInfo &r : refs) {
+        int b = nBuckets * centroidBounds.Offset(r.centroid)[dim];
+        if (b == nBuckets) b = nBuckets - 1;
+        buckets[b].count++;
+        buckets[b].bounds = Union(buckets[b].bounds, r.bounds);
+    }
+    Float minObjectCost = Infinity;
+    int minObjectSplitBucket = -1;
+    Bounds3f objectB0, objectB1;
+    for (int i = 0; i < nBuckets - 1; ++i) {
+        Bounds3f b0, b1;
+        int count0 = 0, count1 = 0;
+        for (int j = 0; j <= i; ++j) {
+            b0 = Union(b0, buckets[j].bounds);
+            count0 += buckets[j].count;
+        }
+        for (int j = i + 1; j < nBuckets; ++j) {
+            b1 = Union(b1, buckets[j].bounds);
+            count1 += buckets[j].count;
+        }
+        if (count0 == 0 || count1 == 0) continue;
+        Float cost = 1 + (count0 * b0.SurfaceArea() +
+                          count1 * b1.SurfaceArea()) / bounds.SurfaceArea();
+        if (cost < minObjectCost) {
+            minObjectCost = cost;
+            minObjectSplitBucket = i;
+            objectB0 = b0;
+            objectB1 = b1;
+        }
+    }
+
+    // Consider a spatial split when the object split children overlap
+    // significantly, following the SBVH alpha criterion
+    PBRT_CONSTEXPR Float sbvhAlpha = 1e-5;
+    Float overlapSA = 0;
+    if (minObjectSplitBucket >= 0) {
+        // Qualified: the BVHAccel::Intersect member name hides the
+        // namespace-scope bounds intersection
+        Bounds3f overlap = pbrt::Intersect(objectB0, objectB1);
+        if (overlap.pMin.x <= overlap.pMax.x &&
+            overlap.pMin.y <= overlap.pMax.y &&
+            overlap.pMin.z <= overlap.pMax.z)
+            overlapSA = overlap.SurfaceArea();
+    }
+    Float minSpatialCost = Infinity;
+    Float spatialSplitPos = 0;
+    if (*spatialSplitBudget > 0 && overlapSA / rootSurfaceArea > sbvhAlpha &&
+        bounds.pMax[dim] > bounds.pMin[dim]) {
+        // Bin the references' clipped bounds into spatial bins along _dim_
+        struct SpatialBin {
+            Bounds3f bounds;
+            int enter = 0, exit = 0;
+        };
+        SpatialBin bins[nBuckets];
+        Float binExtent =
+            (bounds.pMax[dim] - bounds.pMin[dim]) / nBuckets;
+        for (const BVHPrimitiveInfo &r : refs) {
+            int binMin = std::min(
+                nBuckets - 1,
+                std::max(0, int((r.bounds.pMin[dim] - bounds.pMin[dim]) /
+                                binExtent)));
+            int binMax = std::min(
+                nBuckets - 1,
+                std::max(0, int((r.bounds.pMax[dim] - bounds.pMin[dim]) /
+                                binExtent)));
+            bins[binMin].enter++;
+            bins[binMax].exit++;
+            for (int b = binMin; b <= binMax; ++b) {
+                // Clip the reference bounds to the _b_th bin's slab
+                Bounds3f clipped = r.bounds;
+                clipped.pMin[dim] = std::max(
+                    clipped.pMin[dim], bounds.pMin[dim] + b * binExtent);
+                clipped.pMax[dim] = std::min(
+                    clipped.pMax[dim], bounds.pMin[dim] + (b + 1) * binExtent);
+                bins[b].bounds = Union(bins[b].bounds, clipped);
+            }
+        }
+
+        // Sweep the spatial bins to find the lowest-cost split plane
+        for (int i = 0; i < nBuckets - 1; ++i) {
+            Bounds3f b0, b1;
+            int count0 = 0, count1 = 0;
+            for (int j = 0; j <= i; ++j) {
+                b0 = Union(b0, bins[j].bounds);
+                count0 += bins[j].enter;
+            }
+            for (int j = i + 1; j < nBuckets; ++j) {
+                b1 = Union(b1, bins[j].bounds);
+                count1 += bins[j].exit;
+            }
+            if (count0 == 0 || count1 == 0) continue;
+            Float cost = 1 + (count0 * b0.SurfaceArea() +
+                              count1 * b1.SurfaceArea()) / bounds.SurfaceArea();
+            if (cost < minSpatialCost) {
+                minSpatialCost = cost;
+                spatialSplitPos = bounds.pMin[dim] + (i + 1) * binExtent;
+            }
+        }
+    }
+
+    // Create leaf if neither split improves on the leaf cost
+    Float leafCost = nRefs;
+    Float minCost = std::min(minObjectCost, minSpatialCost);
+    if (nRefs <= maxPrimsInNode && minCost >= leafCost) return makeLeaf();
+
+    // Partition references according to the winning split
+    std::vector<BVHPrimitiveInfo> leftRefs, rightRefs;
+    if (minSpatialCost < minObjectCost) {
+        // Split references spatially, duplicating those that straddle the
+        // plane with bounds clipped to each side
+        for (const BVHPrimitiveInfo &r : refs) {
+            if (r.bounds.pMax[dim] <= spatialSplitPos)
+                leftRefs.push_back(r);
+            else if (r.bounds.pMin[dim] >= spatialSplitPos)
+                rightRefs.push_back(r);
+            else {
+                BVHPrimitiveInfo left = r, right = r;
+                left.bounds.pMax[dim] = spatialSplitPos;
+                right.bounds.pMin[dim] = spatialSplitPos;
+                left.centroid =
+                    .5f * left.bounds.pMin + .5f * left.bounds.pMax;
+                right.centroid =
+                    .5f * right.bounds.pMin + .5f * right.bounds.pMax;
+                leftRefs.push_back(left);
+                rightRefs.push_back(right);
+                --*spatialSplitBudget;
+            }
         }
     }
+    if (leftRefs.empty() || rightRefs.empty() ||
+        (int)leftRefs.size() == nRefs || (int)rightRefs.size() == nRefs) {
+        // Use the object split (also the fallback if the spatial split
+        // failed to separate the references)
+        leftRefs.clear();
+        rightRefs.clear();
+        if (minObjectSplitBucket >= 0) {
+            for (const BVHPrimitiveInfo &r : refs) {
+                int b = nBuckets * centroidBounds.Offset(r.centroid)[dim];
+                if (b == nBuckets) b = nBuckets - 1;
+                if (b <= minObjectSplitBucket)
+                    leftRefs.push_back(r);
+                else
+                    rightRefs.push_back(r);
+            }
+        } else {
+            // Split references into equally-sized subsets
+            std::nth_element(refs.begin(), refs.begin() + nRefs / 2,
+                             refs.end(),
+                             [dim](const BVHPrimitiveInfo &a,
+                                   const BVHPrimitiveInfo &b) {
+                                 return a.centroid[dim] < b.centroid[dim];
+                             });
+            leftRefs.assign(refs.begin(), refs.begin() + nRefs / 2);
+            rightRefs.assign(refs.begin() + nRefs / 2, refs.end());
+        }
+    }
+
+    // Release this node's reference list before recursing into children
+    refs.clear();
+    refs.shrink_to_fit();
+    BVHBuildNode *c0 =
+        SBVHBuild(arena, leftRefs, totalNodes, spatialSplitBudget,
+                  orderedPrims, rootSurfaceArea, orderedPrimIndices);
+    BVHBuildNode *c1 =
+        SBVHBuild(arena, rightRefs, totalNodes, spatialSplitBudget,
+                  orderedPrims, rootSurfaceArea, orderedPrimIndices);
+    node->InitInterior(dim, c0, c1);
     return node;
 }
 
@@ -657,27 +1457,531 @@ int BVHAccel::flattenBVHTree(BVHBuildNode *node, int *offset) {
     return myOffset;
 }
 
-BVHAccel::~BVHAccel() { FreeAligned(nodes); }
+int BVHAccel::flattenWideBVHTree(BVHBuildNode *node,
+                                 std::vector<WideBVHNode> *wide) {
+    int myOffset = wide->size();
+    wide->push_back(WideBVHNode());
+
+    // Collapse binary subtree into up to four children for this node
+    BVHBuildNode *children[4];
+    int nChildren = 0;
+    if (node->nPrimitives > 0)
+        // Degenerate tree: a single leaf becomes a one-child wide node
+        children[nChildren++] = node;
+    else {
+        children[0] = node->children[0];
+        children[1] = node->children[1];
+        nChildren = 2;
+        // Repeatedly replace the interior child with the largest surface
+        // area by its two children until all four slots are used
+        while (nChildren < 4) {
+            int best = -1;
+            Float bestArea = 0;
+            for (int i = 0; i < nChildren; ++i) {
+                if (children[i]->nPrimitives > 0) continue;
+                Float area = children[i]->bounds.SurfaceArea();
+                if (best == -1 || area > bestArea) {
+                    best = i;
+                    bestArea = area;
+                }
+            }
+            if (best == -1) break;
+            BVHBuildNode *n = children[best];
+            children[best] = n->children[0];
+            children[nChildren++] = n->children[1];
+        }
+    }
+
+    // Initialize wide node child bounds and mark unused lanes degenerate
+    for (int i = 0; i < 4; ++i) {
+        const Bounds3f b =
+            i < nChildren ? children[i]->bounds : Bounds3f();
+        for (int a = 0; a < 3; ++a) {
+            (*wide)[myOffset].minC[a][i] = b.pMin[a];
+            (*wide)[myOffset].maxC[a][i] = b.pMax[a];
+        }
+        (*wide)[myOffset].child[i] = -1;
+        (*wide)[myOffset].nPrimitives[i] = 0;
+    }
+    (*wide)[myOffset].nChildren = nChildren;
+
+    // Emit leaf children in place and recurse into interior children; note
+    // that recursion may reallocate _wide_, so index rather than hold a
+    // pointer to the node
+    for (int i = 0; i < nChildren; ++i) {
+        if (children[i]->nPrimitives > 0) {
+            CHECK_LT(children[i]->nPrimitives, 65536);
+            (*wide)[myOffset].child[i] = children[i]->firstPrimOffset;
+            (*wide)[myOffset].nPrimitives[i] = children[i]->nPrimitives;
+        } else {
+            int childOffset = flattenWideBVHTree(children[i], wide);
+            (*wide)[myOffset].child[i] = childOffset;
+        }
+    }
+    return myOffset;
+}
+
+// Free (or unmap) the linear node array, whichever way it was obtained.
+void BVHAccel::ReleaseNodes() {
+#ifdef PBRT_HAVE_MMAP
+    if (nodesUnmapPtr) {
+        munmap(nodesUnmapPtr, nodesUnmapLength);
+        nodesUnmapPtr = nullptr;
+        nodesUnmapLength = 0;
+        nodes = nullptr;
+        return;
+    }
+#endif
+    FreeAligned(nodes);
+    nodes = nullptr;
+}
+
+BVHAccel::~BVHAccel() {
+    ReleaseNodes();
+    FreeAligned(wideNodes);
+    FreeAligned(compressedNodes);
+}
+
+int BVHAccel::flattenCompressedBVHTree(BVHBuildNode *node,
+                                       const Bounds3f &parentBounds,
+                                       int *offset) {
+    CompressedBVHNode *cnode = &compressedNodes[*offset];
+    int myOffset = (*offset)++;
+    // Quantize this node's bounds against the parent's decoded bounds,
+    // rounding outward so the decoded box always contains the true one
+    for (int a = 0; a < 3; ++a) {
+        Float d = parentBounds.pMax[a] - parentBounds.pMin[a];
+        Float inv = d > 0 ? 255.f / d : 0;
+        int qMin = (int)std::floor(
+            (node->bounds.pMin[a] - parentBounds.pMin[a]) * inv);
+        int qMax = d > 0 ? (int)std::ceil(
+                               (node->bounds.pMax[a] - parentBounds.pMin[a]) *
+                               inv)
+                         : 255;
+        cnode->qMin[a] = Clamp(qMin, 0, 255);
+        cnode->qMax[a] = Clamp(qMax, 0, 255);
+    }
+    // Children are quantized against this node's decoded (not true) bounds
+    // so that traversal-time decoding reproduces the build exactly
+    Bounds3f decoded = DecodeCompressedBounds(*cnode, parentBounds);
+    if (node->nPrimitives > 0) {
+        CHECK(!node->children[0] && !node->children[1]);
+        CHECK_LT(node->nPrimitives, 65536);
+        cnode->primitivesOffset = node->firstPrimOffset;
+        cnode->nPrimitives = node->nPrimitives;
+    } else {
+        cnode->axis = node->splitAxis;
+        cnode->nPrimitives = 0;
+        flattenCompressedBVHTree(node->children[0], decoded, offset);
+        cnode->secondChildOffset =
+            flattenCompressedBVHTree(node->children[1], decoded, offset);
+    }
+    return myOffset;
+}
+
+bool BVHAccel::IntersectCompressed(const Ray &ray, SurfaceInteraction *isect,
+                                   const Primitive **hitPrim) const {
+    ProfilePhase p(Prof::AccelIntersect);
+    bool hit = false;
+    Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+    // The traversal stack carries each pending node's decoded bounds
+    struct StackEntry {
+        int nodeIndex;
+        Bounds3f bounds;
+    };
+    StackEntry nodesToVisit[64];
+    int toVisitOffset = 0;
+    int currentNodeIndex = 0;
+    Bounds3f currentBounds =
+        DecodeCompressedBounds(compressedNodes[0], compressedRootBounds);
+    if (!currentBounds.IntersectP(ray, invDir, dirIsNeg)) return false;
+    while (true) {
+        const CompressedBVHNode *node = &compressedNodes[currentNodeIndex];
+        ++perRayTraversalStats.nodesVisited;
+        if (node->nPrimitives > 0) {
+            // Intersect ray with primitives in leaf compressed BVH node
+            perRayTraversalStats.primTests += node->nPrimitives;
+            for (int i = 0; i < node->nPrimitives; ++i)
+                if (primitives[node->primitivesOffset + i]->Intersect(ray,
+                                                                     isect)) {
+                    hit = true;
+                    if (hitPrim)
+                        *hitPrim =
+                            primitives[node->primitivesOffset + i].get();
+                }
+            if (toVisitOffset == 0) break;
+            currentNodeIndex = nodesToVisit[toVisitOffset - 1].nodeIndex;
+            currentBounds = nodesToVisit[--toVisitOffset].bounds;
+        } else {
+            // Decode both children and test them against the ray
+            int c0 = currentNodeIndex + 1, c1 = node->secondChildOffset;
+            Bounds3f b0 =
+                DecodeCompressedBounds(compressedNodes[c0], currentBounds);
+            Bounds3f b1 =
+                DecodeCompressedBounds(compressedNodes[c1], currentBounds);
+            bool hit0 = b0.IntersectP(ray, invDir, dirIsNeg);
+            bool hit1 = b1.IntersectP(ray, invDir, dirIsNeg);
+            if (hit0 && hit1) {
+                // Visit the near child first, pushing the far child
+                if (dirIsNeg[node->axis]) {
+                    std::swap(c0, c1);
+                    std::swap(b0, b1);
+                }
+                CHECK_LT(toVisitOffset, 64);
+                nodesToVisit[toVisitOffset].nodeIndex = c1;
+                nodesToVisit[toVisitOffset++].bounds = b1;
+                currentNodeIndex = c0;
+                currentBounds = b0;
+            } else if (hit0) {
+                currentNodeIndex = c0;
+                currentBounds = b0;
+            } else if (hit1) {
+                currentNodeIndex = c1;
+                currentBounds = b1;
+            } else {
+                if (toVisitOffset == 0) break;
+                currentNodeIndex = nodesToVisit[toVisitOffset - 1].nodeIndex;
+                currentBounds = nodesToVisit[--toVisitOffset].bounds;
+            }
+        }
+    }
+    return hit;
+}
+
+bool BVHAccel::IntersectPCompressed(const Ray &ray,
+                                    const Primitive **hitPrim) const {
+    ProfilePhase p(Prof::AccelIntersectP);
+    Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+    struct StackEntry {
+        int nodeIndex;
+        Bounds3f bounds;
+    };
+    StackEntry nodesToVisit[64];
+    int toVisitOffset = 0;
+    int currentNodeIndex = 0;
+    Bounds3f currentBounds =
+        DecodeCompressedBounds(compressedNodes[0], compressedRootBounds);
+    if (!currentBounds.IntersectP(ray, invDir, dirIsNeg)) return false;
+    while (true) {
+        const CompressedBVHNode *node = &compressedNodes[currentNodeIndex];
+        ++perRayTraversalStats.nodesVisited;
+        if (node->nPrimitives > 0) {
+            perRayTraversalStats.primTests += node->nPrimitives;
+            for (int i = 0; i < node->nPrimitives; ++i)
+                if (primitives[node->primitivesOffset + i]->IntersectP(ray)) {
+                    if (hitPrim)
+                        *hitPrim = primitives[node->primitivesOffset + i].get();
+                    return true;
+                }
+            if (toVisitOffset == 0) break;
+            currentNodeIndex = nodesToVisit[toVisitOffset - 1].nodeIndex;
+            currentBounds = nodesToVisit[--toVisitOffset].bounds;
+        } else {
+            int c0 = currentNodeIndex + 1, c1 = node->secondChildOffset;
+            Bounds3f b0 =
+                DecodeCompressedBounds(compressedNodes[c0], currentBounds);
+            Bounds3f b1 =
+                DecodeCompressedBounds(compressedNodes[c1], currentBounds);
+            bool hit0 = b0.IntersectP(ray, invDir, dirIsNeg);
+            bool hit1 = b1.IntersectP(ray, invDir, dirIsNeg);
+            if (hit0 && hit1) {
+                CHECK_LT(toVisitOffset, 64);
+                nodesToVisit[toVisitOffset].nodeIndex = c1;
+                nodesToVisit[toVisitOffset++].bounds = b1;
+                currentNodeIndex = c0;
+                currentBounds = b0;
+            } else if (hit0 || hit1) {
+                currentNodeIndex = hit0 ? c0 : c1;
+                currentBounds = hit0 ? b0 : b1;
+            } else {
+                if (toVisitOffset == 0) break;
+                currentNodeIndex = nodesToVisit[toVisitOffset - 1].nodeIndex;
+                currentBounds = nodesToVisit[--toVisitOffset].bounds;
+            }
+        }
+    }
+    return false;
+}
+
+Float BVHAccel::TotalNodeArea() const {
+    Float nodeArea = 0;
+    if (nodes)
+        for (int i = 0; i < nNodes; ++i)
+            nodeArea += nodes[i].bounds.SurfaceArea();
+    else if (wideNodes)
+        for (int i = 0; i < nWideNodes; ++i)
+            for (int c = 0; c < wideNodes[i].nChildren; ++c)
+                nodeArea += Bounds3f(Point3f(wideNodes[i].minC[0][c],
+                                             wideNodes[i].minC[1][c],
+                                             wideNodes[i].minC[2][c]),
+                                     Point3f(wideNodes[i].maxC[0][c],
+                                             wideNodes[i].maxC[1][c],
+                                             wideNodes[i].maxC[2][c]))
+                                .SurfaceArea();
+    return nodeArea;
+}
+
+bool BVHAccel::Refit() {
+    // Update node bounds in place after primitive transforms have changed,
+    // preserving the tree topology. Traversal quality degrades as geometry
+    // diverges from the layout the tree was built for, so this is only
+    // appropriate for rigid-motion updates between frames; the return
+    // value reports when the SAH-proxy quality has decayed enough to
+    // rebuild instead.
+    ProfilePhase _(Prof::AccelConstruction);
+    if (compressedNodes) {
+        Warning("BVH refitting isn't supported for the compressed node "
+                "layout; the tree was left unchanged.");
+        return false;
+    }
+    // The bounds still describe the built layout on the first call (the
+    // primitives have moved, but the tree hasn't been updated yet), so
+    // capture the quality baseline here.
+    if (builtNodeArea == 0) builtNodeArea = TotalNodeArea();
+    if (nodes) {
+        // Recompute leaf bounds from the primitives in parallel
+        ParallelFor([&](int64_t i) {
+            LinearBVHNode *node = &nodes[i];
+            if (node->nPrimitives > 0) {
+                Bounds3f b;
+                for (int j = 0; j < node->nPrimitives; ++j)
+                    b = Union(
+                        b,
+                        primitives[node->primitivesOffset + j]->WorldBound());
+                node->bounds = b;
+            }
+        }, nNodes, 256);
+        // Propagate interior bounds bottom-up; children always follow their
+        // parent in the depth-first layout, so a reverse sweep suffices
+        for (int i = nNodes - 1; i >= 0; --i) {
+            LinearBVHNode *node = &nodes[i];
+            if (node->nPrimitives == 0)
+                node->bounds = Union(nodes[i + 1].bounds,
+                                     nodes[node->secondChildOffset].bounds);
+        }
+    }
+    if (wideNodes) {
+        // Recompute leaf lane bounds in parallel
+        ParallelFor([&](int64_t i) {
+            WideBVHNode *node = &wideNodes[i];
+            for (int c = 0; c < node->nChildren; ++c) {
+                if (node->nPrimitives[c] == 0) continue;
+                Bounds3f b;
+                for (int j = 0; j < node->nPrimitives[c]; ++j)
+                    b = Union(b,
+                              primitives[node->child[c] + j]->WorldBound());
+                for (int a = 0; a < 3; ++a) {
+                    node->minC[a][c] = b.pMin[a];
+                    node->maxC[a][c] = b.pMax[a];
+                }
+            }
+        }, nWideNodes, 256);
+        // Propagate interior lane bounds bottom-up over the reverse order
+        for (int i = nWideNodes - 1; i >= 0; --i) {
+            WideBVHNode *node = &wideNodes[i];
+            for (int c = 0; c < node->nChildren; ++c) {
+                if (node->nPrimitives[c] > 0) continue;
+                const WideBVHNode &child = wideNodes[node->child[c]];
+                Bounds3f b;
+                for (int cc = 0; cc < child.nChildren; ++cc)
+                    b = Union(b, Bounds3f(Point3f(child.minC[0][cc],
+                                                  child.minC[1][cc],
+                                                  child.minC[2][cc]),
+                                          Point3f(child.maxC[0][cc],
+                                                  child.maxC[1][cc],
+                                                  child.maxC[2][cc])));
+                for (int a = 0; a < 3; ++a) {
+                    node->minC[a][c] = b.pMin[a];
+                    node->maxC[a][c] = b.pMax[a];
+                }
+            }
+        }
+    }
+
+    // Estimate traversal quality decay: total node surface area is the
+    // SAH cost proxy, and a refitted tree whose boxes have inflated well
+    // past the built layout's will traverse poorly no matter how valid
+    // its bounds are.
+    return TotalNodeArea() > 1.5f * builtNodeArea;
+}
+
+bool BVHAccel::IntersectWide(const Ray &ray, SurfaceInteraction *isect,
+                             const Primitive **hitPrim) const {
+    ProfilePhase p(Prof::AccelIntersect);
+    bool hit = false;
+    Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+    // Follow ray through wide BVH nodes to find primitive intersections
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[128];
+    while (true) {
+        const WideBVHNode &node = wideNodes[currentNodeIndex];
+        ++perRayTraversalStats.nodesVisited;
+        alignas(16) Float tNear[4];
+        int hits = IntersectBounds4(node, ray.o, invDir, dirIsNeg, ray.tMax,
+                                    tNear);
+        // Sort hit children by entry distance for front-to-back traversal
+        int order[4], nHit = 0;
+        for (int i = 0; i < node.nChildren; ++i)
+            if (hits & (1 << i)) order[nHit++] = i;
+        for (int i = 1; i < nHit; ++i)
+            for (int j = i; j > 0 && tNear[order[j]] < tNear[order[j - 1]]; --j)
+                std::swap(order[j], order[j - 1]);
+        // Intersect leaf children and push interior children far to near
+        for (int i = nHit - 1; i >= 0; --i) {
+            int c = order[i];
+            if (node.nPrimitives[c] > 0) {
+                perRayTraversalStats.primTests += node.nPrimitives[c];
+                for (int pi = 0; pi < node.nPrimitives[c]; ++pi)
+                    if (primitives[node.child[c] + pi]->Intersect(ray,
+                                                                  isect)) {
+                        hit = true;
+                        if (hitPrim)
+                            *hitPrim = primitives[node.child[c] + pi].get();
+                    }
+            } else {
+                CHECK_LT(toVisitOffset, 128);
+                nodesToVisit[toVisitOffset++] = node.child[c];
+            }
+        }
+        if (toVisitOffset == 0) break;
+        currentNodeIndex = nodesToVisit[--toVisitOffset];
+    }
+    return hit;
+}
+
+bool BVHAccel::IntersectPWide(const Ray &ray,
+                              const Primitive **hitPrim) const {
+    ProfilePhase p(Prof::AccelIntersectP);
+    Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[128];
+    while (true) {
+        const WideBVHNode &node = wideNodes[currentNodeIndex];
+        ++perRayTraversalStats.nodesVisited;
+        alignas(16) Float tNear[4];
+        int hits = IntersectBounds4(node, ray.o, invDir, dirIsNeg, ray.tMax,
+                                    tNear);
+        for (int c = 0; c < node.nChildren; ++c) {
+            if (!(hits & (1 << c))) continue;
+            if (node.nPrimitives[c] > 0) {
+                perRayTraversalStats.primTests += node.nPrimitives[c];
+                for (int pi = 0; pi < node.nPrimitives[c]; ++pi)
+                    if (primitives[node.child[c] + pi]->IntersectP(ray)) {
+                        if (hitPrim)
+                            *hitPrim = primitives[node.child[c] + pi].get();
+                        return true;
+                    }
+            } else {
+                CHECK_LT(toVisitOffset, 128);
+                nodesToVisit[toVisitOffset++] = node.child[c];
+            }
+        }
+        if (toVisitOffset == 0) break;
+        currentNodeIndex = nodesToVisit[--toVisitOffset];
+    }
+    return false;
+}
 
 bool BVHAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
+    // Prime ray.tMax with the previous hit on this thread: coherent rays
+    // (primary visibility above all) usually strike the same primitive,
+    // and a tight tMax before traversal prunes most of the tree. The full
+    // traversal still runs, so results are exact.
+    LastHitHint *hint = nullptr;
+    if (!lastHits.empty() && ThreadIndex < (int)lastHits.size()) {
+        hint = &lastHits[ThreadIndex];
+        bool hintHit = hint->prim && hint->prim->Intersect(ray, isect);
+        // Record this BVH's top-level primitive as the next hint:
+        // isect->primitive points at the object-space primitive inside an
+        // instance, whose Intersect() expects instance-space rays, so
+        // re-testing it with next ray's world-space coordinates would
+        // produce garbage hits.
+        const Primitive *topHit = nullptr;
+        bool traversalHit = IntersectImpl(ray, isect, &topHit);
+        if (hintHit || traversalHit) {
+            // When only the hint hit, it stays the closest and is already
+            // a top-level primitive of this BVH
+            if (traversalHit) hint->prim = topHit;
+            return true;
+        }
+        hint->prim = nullptr;
+        return false;
+    }
+    return IntersectImpl(ray, isect);
+}
+
+bool BVHAccel::IntersectImpl(const Ray &ray, SurfaceInteraction *isect,
+                             const Primitive **hitPrim) const {
+    if (wideNodes) return IntersectWide(ray, isect, hitPrim);
+    if (compressedNodes) return IntersectCompressed(ray, isect, hitPrim);
     if (!nodes) return false;
     ProfilePhase p(Prof::AccelIntersect);
     bool hit = false;
     Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
     int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+    // Precompute the watertight shear coefficients once for this ray
+    RayShear shear(ray);
     // Follow ray through BVH nodes to find primitive intersections
     int toVisitOffset = 0, currentNodeIndex = 0;
     int nodesToVisit[64];
     while (true) {
         const LinearBVHNode *node = &nodes[currentNodeIndex];
+        ++perRayTraversalStats.nodesVisited;
         // Check ray against BVH node
         if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
             if (node->nPrimitives > 0) {
-                // Intersect ray with primitives in leaf BVH node
-                for (int i = 0; i < node->nPrimitives; ++i)
-                    if (primitives[node->primitivesOffset + i]->Intersect(
-                            ray, isect))
+                // Intersect ray with primitives in leaf BVH node,
+                // pre-filtering mesh triangles in batches of four with the
+                // shared shear test
+                perRayTraversalStats.primTests += node->nPrimitives;
+                const Point3f *tp0[4], *tp1[4], *tp2[4];
+                int triIndex[4], nTri = 0;
+                auto flushTriangles = [&]() {
+                    Float tEst[4];
+                    int mask = IntersectTriangles4(ray, shear, tp0, tp1, tp2,
+                                                   nTri, tEst);
+                    // Fully intersect the surviving candidates nearest
+                    // first, so the first accepted hit truncates ray.tMax
+                    // and later candidates reject before doing their
+                    // SurfaceInteraction setup
+                    int order[4], nHit = 0;
+                    for (int l = 0; l < nTri; ++l)
+                        if (mask & (1 << l)) order[nHit++] = l;
+                    for (int a = 1; a < nHit; ++a)
+                        for (int b = a;
+                             b > 0 && tEst[order[b]] < tEst[order[b - 1]]; --b)
+                            std::swap(order[b], order[b - 1]);
+                    for (int a = 0; a < nHit; ++a)
+                        if (primitives[triIndex[order[a]]]->Intersect(ray,
+                                                                      isect)) {
+                            hit = true;
+                            // The last accepting primitive is the closest;
+                            // record this BVH's top-level primitive, not
+                            // isect->primitive, which for instanced
+                            // geometry is the inner object-space one
+                            if (hitPrim)
+                                *hitPrim =
+                                    primitives[triIndex[order[a]]].get();
+                        }
+                    nTri = 0;
+                };
+                for (int i = 0; i < node->nPrimitives; ++i) {
+                    const Primitive *prim =
+                        primitives[node->primitivesOffset + i].get();
+                    if (prim->WorldSpaceTriangle(&tp0[nTri], &tp1[nTri],
+                                                 &tp2[nTri])) {
+                        triIndex[nTri++] = node->primitivesOffset + i;
+                        if (nTri == 4) flushTriangles();
+                    } else if (prim->Intersect(ray, isect)) {
                         hit = true;
+                        if (hitPrim) *hitPrim = prim;
+                    }
+                }
+                if (nTri > 0) flushTriangles();
                 if (toVisitOffset == 0) break;
                 currentNodeIndex = nodesToVisit[--toVisitOffset];
             } else {
@@ -700,23 +2004,77 @@ bool BVHAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
 }
 
 bool BVHAccel::IntersectP(const Ray &ray) const {
+    // Per-thread occlusion hints: re-test the last few occluders found on
+    // this thread before any traversal. Architectural scenes have long
+    // runs of shadow rays blocked by the same handful of surfaces, and a
+    // hint hit replaces the whole tree walk with one primitive test.
+    if (!occlusionHints.empty() &&
+        ThreadIndex < (int)occlusionHints.size()) {
+        OcclusionHints &hints = occlusionHints[ThreadIndex];
+        for (const Primitive *prim : hints.prims)
+            if (prim && prim->IntersectP(ray)) {
+                ++nOcclusionHintHits;
+                return true;
+            }
+        const Primitive *hit = nullptr;
+        bool occluded = IntersectPImpl(ray, &hit);
+        if (occluded && hit) {
+            hints.prims[hints.next] = hit;
+            hints.next = (hints.next + 1) % 4;
+        }
+        return occluded;
+    }
+    return IntersectPImpl(ray, nullptr);
+}
+
+bool BVHAccel::IntersectPImpl(const Ray &ray,
+                              const Primitive **hitPrim) const {
+    if (wideNodes) return IntersectPWide(ray, hitPrim);
+    if (compressedNodes) return IntersectPCompressed(ray, hitPrim);
     if (!nodes) return false;
     ProfilePhase p(Prof::AccelIntersectP);
     Vector3f invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
     int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+    // Precompute the watertight shear coefficients once for this ray
+    RayShear shear(ray);
     int nodesToVisit[64];
     int toVisitOffset = 0, currentNodeIndex = 0;
     while (true) {
         const LinearBVHNode *node = &nodes[currentNodeIndex];
+        ++perRayTraversalStats.nodesVisited;
         if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
             // Process BVH node _node_ for traversal
             if (node->nPrimitives > 0) {
+                perRayTraversalStats.primTests += node->nPrimitives;
+                const Point3f *tp0[4], *tp1[4], *tp2[4];
+                int triIndex[4], nTri = 0;
+                auto anyTriangleHit = [&]() {
+                    Float tEst[4];
+                    int mask = IntersectTriangles4(ray, shear, tp0, tp1, tp2,
+                                                   nTri, tEst);
+                    for (int l = 0; l < nTri; ++l)
+                        if ((mask & (1 << l)) &&
+                            primitives[triIndex[l]]->IntersectP(ray)) {
+                            if (hitPrim)
+                                *hitPrim = primitives[triIndex[l]].get();
+                            return true;
+                        }
+                    nTri = 0;
+                    return false;
+                };
                 for (int i = 0; i < node->nPrimitives; ++i) {
-                    if (primitives[node->primitivesOffset + i]->IntersectP(
-                            ray)) {
+                    const Primitive *prim =
+                        primitives[node->primitivesOffset + i].get();
+                    if (prim->WorldSpaceTriangle(&tp0[nTri], &tp1[nTri],
+                                                 &tp2[nTri])) {
+                        triIndex[nTri++] = node->primitivesOffset + i;
+                        if (nTri == 4 && anyTriangleHit()) return true;
+                    } else if (prim->IntersectP(ray)) {
+                        if (hitPrim) *hitPrim = prim;
                         return true;
                     }
                 }
+                if (nTri > 0 && anyTriangleHit()) return true;
                 if (toVisitOffset == 0) break;
                 currentNodeIndex = nodesToVisit[--toVisitOffset];
             } else {
@@ -737,6 +2095,128 @@ bool BVHAccel::IntersectP(const Ray &ray) const {
     return false;
 }
 
+void BVHAccel::IntersectPStream(RayStream *stream) const {
+    size_t nRays = stream->rays.size();
+    stream->occluded.assign(nRays, 0);
+    if (nRays == 0) return;
+    if (!nodes || wideNodes) {
+        // Fall back to single-ray traversal for the wide node layout, which
+        // already amortizes box tests within each ray.
+        for (size_t i = 0; i < nRays; ++i)
+            stream->occluded[i] = IntersectP(stream->rays[i]) ? 1 : 0;
+        return;
+    }
+
+    // Sort the bundle into direction-octant groups before traversal: rays
+    // in a group agree on near-child ordering and tend to enter the same
+    // nodes, so the per-node active scans in the group traversal stay
+    // dense. (Origins within a shading batch are already coherent.)
+    int octant[8] = {};
+    std::vector<uint8_t> rayOctant(nRays);
+    for (size_t i = 0; i < nRays; ++i) {
+        const Vector3f &d = stream->rays[i].d;
+        rayOctant[i] =
+            (d.x < 0 ? 1 : 0) | (d.y < 0 ? 2 : 0) | (d.z < 0 ? 4 : 0);
+        ++octant[rayOctant[i]];
+    }
+    int nGroups = 0;
+    for (int o = 0; o < 8; ++o) nGroups += octant[o] > 0;
+    if (nGroups <= 1) {
+        IntersectPStreamGroup(stream);
+        return;
+    }
+    RayStream group;
+    std::vector<int> groupIndex;
+    for (int o = 0; o < 8; ++o) {
+        if (octant[o] == 0) continue;
+        group.Clear();
+        groupIndex.clear();
+        for (size_t i = 0; i < nRays; ++i)
+            if (rayOctant[i] == o) {
+                group.AddRay(stream->rays[i]);
+                groupIndex.push_back((int)i);
+            }
+        IntersectPStreamGroup(&group);
+        for (size_t k = 0; k < groupIndex.size(); ++k)
+            stream->occluded[groupIndex[k]] = group.occluded[k];
+    }
+}
+
+void BVHAccel::IntersectPStreamGroup(RayStream *stream) const {
+    size_t nRays = stream->rays.size();
+    stream->occluded.assign(nRays, 0);
+    ProfilePhase p(Prof::AccelIntersectP);
+    // Precompute reciprocal ray directions for the whole bundle
+    std::vector<Vector3f> invDirs(nRays);
+    for (size_t i = 0; i < nRays; ++i) {
+        const Vector3f &d = stream->rays[i].d;
+        invDirs[i] = Vector3f(1 / d.x, 1 / d.y, 1 / d.z);
+    }
+
+    // Traverse all rays through the tree together so each visited node is
+    // fetched once per bundle rather than once per ray.
+    size_t nRemaining = nRays;
+    std::vector<uint8_t> active(nRays);
+    int nodesToVisit[64];
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    while (true) {
+        const LinearBVHNode *node = &nodes[currentNodeIndex];
+        // Find the first unoccluded ray that enters this node's bounds
+        int firstActive = -1;
+        for (size_t i = 0; i < nRays; ++i) {
+            if (stream->occluded[i]) continue;
+            int dirIsNeg[3] = {invDirs[i].x < 0, invDirs[i].y < 0,
+                               invDirs[i].z < 0};
+            if (node->bounds.IntersectP(stream->rays[i], invDirs[i],
+                                        dirIsNeg)) {
+                firstActive = (int)i;
+                break;
+            }
+        }
+        if (firstActive >= 0) {
+            if (node->nPrimitives > 0) {
+                // Compute the set of unoccluded rays that enter the leaf's
+                // bounds so that primitives are only tested against those
+                std::fill(active.begin(), active.end(), 0);
+                active[firstActive] = 1;
+                for (size_t i = firstActive + 1; i < nRays; ++i) {
+                    if (stream->occluded[i]) continue;
+                    int dirIsNeg[3] = {invDirs[i].x < 0, invDirs[i].y < 0,
+                                       invDirs[i].z < 0};
+                    active[i] = node->bounds.IntersectP(stream->rays[i],
+                                                        invDirs[i], dirIsNeg);
+                }
+                // Test each leaf primitive against the active rays
+                for (int j = 0; j < node->nPrimitives; ++j) {
+                    const std::shared_ptr<Primitive> &prim =
+                        primitives[node->primitivesOffset + j];
+                    for (size_t i = firstActive; i < nRays; ++i) {
+                        if (!active[i] || stream->occluded[i]) continue;
+                        if (prim->IntersectP(stream->rays[i])) {
+                            stream->occluded[i] = 1;
+                            if (--nRemaining == 0) return;
+                        }
+                    }
+                }
+                if (toVisitOffset == 0) break;
+                currentNodeIndex = nodesToVisit[--toVisitOffset];
+            } else {
+                // Descend near child first for the first active ray
+                if (invDirs[firstActive][node->axis] < 0) {
+                    nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+                    currentNodeIndex = node->secondChildOffset;
+                } else {
+                    nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                    currentNodeIndex = currentNodeIndex + 1;
+                }
+            }
+        } else {
+            if (toVisitOffset == 0) break;
+            currentNodeIndex = nodesToVisit[--toVisitOffset];
+        }
+    }
+}
+
 std::shared_ptr<BVHAccel> CreateBVHAccelerator(
     std::vector<std::shared_ptr<Primitive>> prims, const ParamSet &ps) {
     std::string splitMethodName = ps.FindOneString("splitmethod", "sah");
@@ -749,14 +2229,35 @@ std::shared_ptr<BVHAccel> CreateBVHAccelerator(
         splitMethod = BVHAccel::SplitMethod::Middle;
     else if (splitMethodName == "equal")
         splitMethod = BVHAccel::SplitMethod::EqualCounts;
+    else if (splitMethodName == "sbvh")
+        splitMethod = BVHAccel::SplitMethod::SBVH;
     else {
         Warning("BVH split method \"%s\" unknown.  Using \"sah\".",
                 splitMethodName.c_str());
         splitMethod = BVHAccel::SplitMethod::SAH;
     }
 
+    std::string nodeLayoutName = ps.FindOneString("nodelayout", "binary");
+    BVHAccel::NodeLayout nodeLayout;
+    if (nodeLayoutName == "binary")
+        nodeLayout = BVHAccel::NodeLayout::Binary;
+    else if (nodeLayoutName == "bvh4")
+        nodeLayout = BVHAccel::NodeLayout::Wide4;
+    else if (nodeLayoutName == "compressed")
+        nodeLayout = BVHAccel::NodeLayout::Compressed;
+    else {
+        Warning("BVH node layout \"%s\" unknown.  Using \"binary\".",
+                nodeLayoutName.c_str());
+        nodeLayout = BVHAccel::NodeLayout::Binary;
+    }
+
     int maxPrimsInNode = ps.FindOneInt("maxnodeprims", 4);
-    return std::make_shared<BVHAccel>(std::move(prims), maxPrimsInNode, splitMethod);
+    std::string cacheDir = ps.FindOneString("cachedir", "");
+    bool occlusionHints = ps.FindOneBool("occlusionhints", false);
+    bool primaryHints = ps.FindOneBool("primaryhints", false);
+    return std::make_shared<BVHAccel>(std::move(prims), maxPrimsInNode,
+                                      splitMethod, nodeLayout, cacheDir,
+                                      occlusionHints, primaryHints);
 }
 
 }  // namespace pbrt
@@ -48,30 +48,55 @@ struct BVHBuildNode;
 
 // BVHAccel Forward Declarations
 struct BVHPrimitiveInfo;
+struct BVHBuildContext;
 struct MortonPrimitive;
 struct LinearBVHNode;
+struct WideBVHNode;
+struct CompressedBVHNode;
 
 // BVHAccel Declarations
 class BVHAccel : public Aggregate {
   public:
     // BVHAccel Public Types
-    enum class SplitMethod { SAH, HLBVH, Middle, EqualCounts };
+    enum class SplitMethod { SAH, HLBVH, Middle, EqualCounts, SBVH };
+    enum class NodeLayout { Binary, Wide4, Compressed };
 
     // BVHAccel Public Methods
     BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
              int maxPrimsInNode = 1,
-             SplitMethod splitMethod = SplitMethod::SAH);
+             SplitMethod splitMethod = SplitMethod::SAH,
+             NodeLayout nodeLayout = NodeLayout::Binary,
+             const std::string &cacheDir = "",
+             bool occlusionHintsEnabled = false,
+             bool primaryHintsEnabled = false);
     Bounds3f WorldBound() const;
     ~BVHAccel();
     bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
     bool IntersectP(const Ray &ray) const;
+    void IntersectPStream(RayStream *stream) const;
+    // Update node bounds in place after primitive motion; returns true
+    // when the refitted tree's estimated traversal quality has decayed
+    // enough (total node surface area grown past ~1.5x the built tree's)
+    // that a rebuild is recommended. Persistent-session drivers use this
+    // as their deferred-rebuild heuristic.
+    bool Refit();
 
   private:
     // BVHAccel Private Methods
     BVHBuildNode *recursiveBuild(
-        MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo,
-        int start, int end, int *totalNodes,
-        std::vector<std::shared_ptr<Primitive>> &orderedPrims);
+        BVHBuildContext &ctx, MemoryArena &arena,
+        std::vector<BVHPrimitiveInfo> &primitiveInfo, int start, int end);
+    BVHBuildNode *SBVHBuild(MemoryArena &arena,
+                            std::vector<BVHPrimitiveInfo> &refs,
+                            int *totalNodes, int *spatialSplitBudget,
+                            std::vector<std::shared_ptr<Primitive>> &orderedPrims,
+                            Float rootSurfaceArea,
+                            std::vector<int32_t> *orderedPrimIndices);
+    bool LoadBVHCache(const std::string &path, uint64_t hash);
+    void ReleaseNodes();
+    void WriteBVHCache(const std::string &path, uint64_t hash, int nNodes,
+                       const std::vector<int32_t> &orderedPrimIndices,
+                       size_t nOrigPrims) const;
     BVHBuildNode *HLBVHBuild(
         MemoryArena &arena, const std::vector<BVHPrimitiveInfo> &primitiveInfo,
         int *totalNodes,
@@ -86,12 +111,60 @@ class BVHAccel : public Aggregate {
                                 std::vector<BVHBuildNode *> &treeletRoots,
                                 int start, int end, int *totalNodes) const;
     int flattenBVHTree(BVHBuildNode *node, int *offset);
+    int flattenWideBVHTree(BVHBuildNode *node, std::vector<WideBVHNode> *wide);
+    int flattenCompressedBVHTree(BVHBuildNode *node,
+                                 const Bounds3f &parentBounds, int *offset);
+    bool IntersectWide(const Ray &ray, SurfaceInteraction *isect,
+                       const Primitive **hitPrim = nullptr) const;
+    bool IntersectPWide(const Ray &ray,
+                        const Primitive **hitPrim = nullptr) const;
+    bool IntersectCompressed(const Ray &ray, SurfaceInteraction *isect,
+                             const Primitive **hitPrim = nullptr) const;
+    bool IntersectPCompressed(const Ray &ray,
+                              const Primitive **hitPrim = nullptr) const;
+    bool IntersectPImpl(const Ray &ray, const Primitive **hitPrim) const;
+    Float TotalNodeArea() const;
+    bool IntersectImpl(const Ray &ray, SurfaceInteraction *isect,
+                       const Primitive **hitPrim = nullptr) const;
+    void IntersectPStreamGroup(RayStream *stream) const;
 
     // BVHAccel Private Data
     const int maxPrimsInNode;
     const SplitMethod splitMethod;
+    const NodeLayout nodeLayout;
     std::vector<std::shared_ptr<Primitive>> primitives;
+    // Per-thread occlusion hints ("occlusionhints" parameter): the last
+    // few primitives that occluded a shadow ray on this thread are tested
+    // before any traversal, short-circuiting the common case where
+    // successive shading points are blocked by the same geometry. Padded
+    // to a cache line to keep threads from sharing one.
+    struct alignas(64) OcclusionHints {
+        const Primitive *prims[4] = {nullptr, nullptr, nullptr, nullptr};
+        int next = 0;
+    };
+    mutable std::vector<OcclusionHints> occlusionHints;
+    // Per-thread last-hit hints ("primaryhints" parameter): testing the
+    // previous ray's hit primitive first shrinks ray.tMax before
+    // traversal, so the coherent primary rays of a tile prune most of the
+    // tree. Exact - the full (bounded) traversal still runs.
+    struct alignas(64) LastHitHint {
+        const Primitive *prim = nullptr;
+    };
+    mutable std::vector<LastHitHint> lastHits;
     LinearBVHNode *nodes = nullptr;
+    // Set when _nodes_ points into a memory-mapped BVH cache file rather
+    // than a heap allocation; the page cache then backs every process
+    // rendering this scene on the machine with a single physical copy of
+    // the tree. See LoadBVHCache().
+    void *nodesUnmapPtr = nullptr;
+    size_t nodesUnmapLength = 0;
+    WideBVHNode *wideNodes = nullptr;
+    CompressedBVHNode *compressedNodes = nullptr;
+    Bounds3f compressedRootBounds;
+    int nNodes = 0, nWideNodes = 0;
+    // Total node surface area at build time, the baseline for Refit()'s
+    // quality-decay estimate
+    Float builtNodeArea = 0;
 };
 
 std::shared_ptr<BVHAccel> CreateBVHAccelerator(
@@ -35,8 +35,11 @@
 #include "accelerators/kdtreeaccel.h"
 #include "paramset.h"
 #include "interaction.h"
+#include "memory.h"
+#include "parallel.h"
 #include "stats.h"
 #include <algorithm>
+#include <mutex>
 
 namespace pbrt {
 
@@ -80,15 +83,79 @@ struct BoundEdge {
     EdgeType type;
 };
 
+// Intermediate build tree node; the final depth-first _KdAccelNode_ layout
+// is produced by _flattenTree()_ after the (possibly parallel) build.
+struct KdBuildNode {
+    void InitLeaf(int *pn, int np) {
+        splitAxis = -1;
+        primNums = pn;
+        nPrimitives = np;
+    }
+    void InitInterior(int axis, Float split, KdBuildNode *below,
+                      KdBuildNode *above) {
+        splitAxis = axis;
+        splitPos = split;
+        children[0] = below;
+        children[1] = above;
+    }
+    int splitAxis;  // -1 -> leaf
+    Float splitPos;
+    KdBuildNode *children[2];
+    int *primNums;
+    int nPrimitives;
+};
+
+// Shared state for parallel kd-tree builds; arenas created for subtree
+// tasks are kept alive here until the tree has been flattened.
+struct KdBuildContext {
+    MemoryArena *AllocTaskArena() {
+        std::lock_guard<std::mutex> lock(arenaMutex);
+        taskArenas.push_back(
+            std::unique_ptr<MemoryArena>(new MemoryArena(1024 * 1024)));
+        return taskArenas.back().get();
+    }
+    std::mutex arenaMutex;
+    std::vector<std::unique_ptr<MemoryArena>> taskArenas;
+};
+
+// Minimum number of primitives in a subtree before its build is worth
+// handing to the thread pool.
+PBRT_CONSTEXPR int kdMinPrimsForParallelBuild = 256 * 1024;
+
+// Sort a _BoundEdge_ range, splitting the range across threads when it is
+// large enough for the merge overhead to pay off
+static void SortBoundEdges(BoundEdge *start, BoundEdge *end) {
+    auto cmp = [](const BoundEdge &e0, const BoundEdge &e1) -> bool {
+        if (e0.t == e1.t)
+            return (int)e0.type < (int)e1.type;
+        else
+            return e0.t < e1.t;
+    };
+    ptrdiff_t n = end - start;
+    if (n < 2 * kdMinPrimsForParallelBuild) {
+        std::sort(start, end, cmp);
+        return;
+    }
+    BoundEdge *mid = start + n / 2;
+    ParallelFor([&](int64_t i) {
+        if (i == 0)
+            SortBoundEdges(start, mid);
+        else
+            SortBoundEdges(mid, end);
+    }, 2);
+    std::inplace_merge(start, mid, end, cmp);
+}
+
 // KdTreeAccel Method Definitions
 KdTreeAccel::KdTreeAccel(std::vector<std::shared_ptr<Primitive>> p,
                          int isectCost, int traversalCost, Float emptyBonus,
-                         int maxPrims, int maxDepth)
+                         int maxPrims, int maxDepth, bool ropesEnabled)
     : isectCost(isectCost),
       traversalCost(traversalCost),
       maxPrims(maxPrims),
       emptyBonus(emptyBonus),
-      primitives(std::move(p)) {
+      primitives(std::move(p)),
+      useRopes(ropesEnabled) {
     // Build kd-tree for accelerator
     ProfilePhase _(Prof::AccelConstruction);
     nextFreeNode = nAllocedNodes = 0;
@@ -96,13 +163,11 @@ KdTreeAccel::KdTreeAccel(std::vector<std::shared_ptr<Primitive>> p,
         maxDepth = std::round(8 + 1.3f * Log2Int(int64_t(primitives.size())));
 
     // Compute bounds for kd-tree construction
-    std::vector<Bounds3f> primBounds;
-    primBounds.reserve(primitives.size());
-    for (const std::shared_ptr<Primitive> &prim : primitives) {
-        Bounds3f b = prim->WorldBound();
-        bounds = Union(bounds, b);
-        primBounds.push_back(b);
-    }
+    std::vector<Bounds3f> primBounds(primitives.size());
+    ParallelFor([&](int64_t i) {
+        primBounds[i] = primitives[i]->WorldBound();
+    }, primitives.size(), 1024);
+    for (const Bounds3f &b : primBounds) bounds = Union(bounds, b);
 
     // Allocate working memory for kd-tree construction
     std::unique_ptr<BoundEdge[]> edges[3];
@@ -115,9 +180,46 @@ KdTreeAccel::KdTreeAccel(std::vector<std::shared_ptr<Primitive>> p,
     std::unique_ptr<int[]> primNums(new int[primitives.size()]);
     for (size_t i = 0; i < primitives.size(); ++i) primNums[i] = i;
 
-    // Start recursive construction of kd-tree
-    buildTree(0, bounds, primBounds, primNums.get(), primitives.size(),
-              maxDepth, edges, prims0.get(), prims1.get());
+    // Start recursive construction of kd-tree, then flatten the result into
+    // the depth-first _KdAccelNode_ layout
+    KdBuildContext ctx;
+    MemoryArena arena(1024 * 1024);
+    KdBuildNode *root =
+        buildTree(ctx, arena, bounds, primBounds, primNums.get(),
+                  primitives.size(), maxDepth, edges, prims0.get(),
+                  prims1.get());
+    flattenTree(root);
+
+    // Precompute neighbor links and leaf bounds for stackless traversal
+    if (useRopes && nextFreeNode > 0) {
+        leafBounds.resize(nextFreeNode);
+        ropes.assign(6 * (size_t)nextFreeNode, -1);
+        int exteriorRopes[6] = {-1, -1, -1, -1, -1, -1};
+        buildRopes(0, bounds, exteriorRopes);
+    }
+}
+
+void KdTreeAccel::buildRopes(int nodeIndex, const Bounds3f &nodeBounds,
+                             const int ropesIn[6]) {
+    const KdAccelNode *node = &nodes[nodeIndex];
+    if (node->IsLeaf()) {
+        leafBounds[nodeIndex] = nodeBounds;
+        for (int i = 0; i < 6; ++i) ropes[6 * (size_t)nodeIndex + i] = ropesIn[i];
+        return;
+    }
+    int axis = node->SplitAxis();
+    Float split = node->SplitPos();
+    Bounds3f belowBounds = nodeBounds, aboveBounds = nodeBounds;
+    belowBounds.pMax[axis] = aboveBounds.pMin[axis] = split;
+    // The below child's +axis neighbor is the above child and vice versa;
+    // the other four ropes pass through unchanged. Rope targets may be
+    // interior nodes; traversal descends from them using the exit point.
+    int belowRopes[6], aboveRopes[6];
+    for (int i = 0; i < 6; ++i) belowRopes[i] = aboveRopes[i] = ropesIn[i];
+    belowRopes[2 * axis + 1] = node->AboveChild();
+    aboveRopes[2 * axis] = nodeIndex + 1;
+    buildRopes(nodeIndex + 1, belowBounds, belowRopes);
+    buildRopes(node->AboveChild(), aboveBounds, aboveRopes);
 }
 
 void KdAccelNode::InitLeaf(int *primNums, int np,
@@ -137,29 +239,22 @@ void KdAccelNode::InitLeaf(int *primNums, int np,
 
 KdTreeAccel::~KdTreeAccel() { FreeAligned(nodes); }
 
-void KdTreeAccel::buildTree(int nodeNum, const Bounds3f &nodeBounds,
-                            const std::vector<Bounds3f> &allPrimBounds,
-                            int *primNums, int nPrimitives, int depth,
-                            const std::unique_ptr<BoundEdge[]> edges[3],
-                            int *prims0, int *prims1, int badRefines) {
-    CHECK_EQ(nodeNum, nextFreeNode);
-    // Get next free node from _nodes_ array
-    if (nextFreeNode == nAllocedNodes) {
-        int nNewAllocNodes = std::max(2 * nAllocedNodes, 512);
-        KdAccelNode *n = AllocAligned<KdAccelNode>(nNewAllocNodes);
-        if (nAllocedNodes > 0) {
-            memcpy(n, nodes, nAllocedNodes * sizeof(KdAccelNode));
-            FreeAligned(nodes);
-        }
-        nodes = n;
-        nAllocedNodes = nNewAllocNodes;
-    }
-    ++nextFreeNode;
+KdBuildNode *KdTreeAccel::buildTree(KdBuildContext &ctx, MemoryArena &arena,
+                                    const Bounds3f &nodeBounds,
+                                    const std::vector<Bounds3f> &allPrimBounds,
+                                    int *primNums, int nPrimitives, int depth,
+                                    const std::unique_ptr<BoundEdge[]> edges[3],
+                                    int *prims0, int *prims1, int badRefines) {
+    KdBuildNode *node = arena.Alloc<KdBuildNode>();
 
     // Initialize leaf node if termination criteria met
     if (nPrimitives <= maxPrims || depth == 0) {
-        nodes[nodeNum].InitLeaf(primNums, nPrimitives, &primitiveIndices);
-        return;
+        // Copy the primitive list into the arena; _primNums_ points into
+        // scratch storage that later build steps reuse
+        int *leafPrims = arena.Alloc<int>(nPrimitives, false);
+        memcpy(leafPrims, primNums, nPrimitives * sizeof(int));
+        node->InitLeaf(leafPrims, nPrimitives);
+        return node;
     }
 
     // Initialize interior node and continue recursion
@@ -186,13 +281,7 @@ retrySplit:
     }
 
     // Sort _edges_ for _axis_
-    std::sort(&edges[axis][0], &edges[axis][2 * nPrimitives],
-              [](const BoundEdge &e0, const BoundEdge &e1) -> bool {
-                  if (e0.t == e1.t)
-                      return (int)e0.type < (int)e1.type;
-                  else
-                      return e0.t < e1.t;
-              });
+    SortBoundEdges(&edges[axis][0], &edges[axis][2 * nPrimitives]);
 
     // Compute cost of all splits for _axis_ to find best
     int nBelow = 0, nAbove = nPrimitives;
@@ -237,8 +326,10 @@ retrySplit:
     if (bestCost > oldCost) ++badRefines;
     if ((bestCost > 4 * oldCost && nPrimitives < 16) || bestAxis == -1 ||
         badRefines == 3) {
-        nodes[nodeNum].InitLeaf(primNums, nPrimitives, &primitiveIndices);
-        return;
+        int *leafPrims = arena.Alloc<int>(nPrimitives, false);
+        memcpy(leafPrims, primNums, nPrimitives * sizeof(int));
+        node->InitLeaf(leafPrims, nPrimitives);
+        return node;
     }
 
     // Classify primitives with respect to split
@@ -254,16 +345,189 @@ retrySplit:
     Float tSplit = edges[bestAxis][bestOffset].t;
     Bounds3f bounds0 = nodeBounds, bounds1 = nodeBounds;
     bounds0.pMax[bestAxis] = bounds1.pMin[bestAxis] = tSplit;
-    buildTree(nodeNum + 1, bounds0, allPrimBounds, prims0, n0, depth - 1, edges,
-              prims0, prims1 + nPrimitives, badRefines);
-    int aboveChild = nextFreeNode;
-    nodes[nodeNum].InitInterior(bestAxis, aboveChild, tSplit);
-    buildTree(aboveChild, bounds1, allPrimBounds, prims1, n1, depth - 1, edges,
-              prims0, prims1 + nPrimitives, badRefines);
+    KdBuildNode *below, *above;
+    if (nPrimitives > kdMinPrimsForParallelBuild) {
+        // Build the children as thread-pool tasks; the above child gets its
+        // own scratch buffers and arena since the parent's are reused by
+        // the below child
+        std::unique_ptr<BoundEdge[]> aboveEdges[3];
+        for (int i = 0; i < 3; ++i)
+            aboveEdges[i].reset(new BoundEdge[2 * n1]);
+        std::unique_ptr<int[]> abovePrims0(new int[n1]);
+        std::unique_ptr<int[]> abovePrims1(new int[(depth + 1) * n1]);
+        MemoryArena *taskArena = ctx.AllocTaskArena();
+        ParallelFor([&](int64_t i) {
+            if (i == 0)
+                below = buildTree(ctx, arena, bounds0, allPrimBounds, prims0,
+                                  n0, depth - 1, edges, prims0,
+                                  prims1 + nPrimitives, badRefines);
+            else
+                above = buildTree(ctx, *taskArena, bounds1, allPrimBounds,
+                                  prims1, n1, depth - 1, aboveEdges,
+                                  abovePrims0.get(), abovePrims1.get(),
+                                  badRefines);
+        }, 2);
+    } else {
+        below = buildTree(ctx, arena, bounds0, allPrimBounds, prims0, n0,
+                          depth - 1, edges, prims0, prims1 + nPrimitives,
+                          badRefines);
+        above = buildTree(ctx, arena, bounds1, allPrimBounds, prims1, n1,
+                          depth - 1, edges, prims0, prims1 + nPrimitives,
+                          badRefines);
+    }
+    node->InitInterior(bestAxis, tSplit, below, above);
+    return node;
+}
+
+int KdTreeAccel::flattenTree(const KdBuildNode *buildNode) {
+    // Get next free node from _nodes_ array
+    if (nextFreeNode == nAllocedNodes) {
+        int nNewAllocNodes = std::max(2 * nAllocedNodes, 512);
+        KdAccelNode *n = AllocAligned<KdAccelNode>(nNewAllocNodes);
+        if (nAllocedNodes > 0) {
+            memcpy(n, nodes, nAllocedNodes * sizeof(KdAccelNode));
+            FreeAligned(nodes);
+        }
+        nodes = n;
+        nAllocedNodes = nNewAllocNodes;
+    }
+    int nodeNum = nextFreeNode++;
+    if (buildNode->splitAxis == -1)
+        nodes[nodeNum].InitLeaf(buildNode->primNums, buildNode->nPrimitives,
+                                &primitiveIndices);
+    else {
+        // The below child immediately follows its parent; record where the
+        // above child's subtree starts once the below subtree is flattened
+        flattenTree(buildNode->children[0]);
+        int aboveChild = nextFreeNode;
+        nodes[nodeNum].InitInterior(buildNode->splitAxis, aboveChild,
+                                    buildNode->splitPos);
+        flattenTree(buildNode->children[1]);
+    }
+    return nodeNum;
+}
+
+bool KdTreeAccel::IntersectRopes(const Ray &ray,
+                                 SurfaceInteraction *isect) const {
+    Float tMin, tMax;
+    if (!bounds.IntersectP(ray, &tMin, &tMax)) return false;
+    Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    bool hit = false;
+    int nodeIndex = 0;
+    Float tEntry = tMin;
+    while (true) {
+        if (ray.tMax < tEntry) break;
+        // Descend to the leaf containing the ray at _tEntry_, breaking
+        // exact on-plane ties by the ray direction so traversal always
+        // moves forward.
+        const KdAccelNode *node = &nodes[nodeIndex];
+        while (!node->IsLeaf()) {
+            ++perRayTraversalStats.nodesVisited;
+            int axis = node->SplitAxis();
+            Float split = node->SplitPos();
+            Float pa = ray.o[axis] + tEntry * ray.d[axis];
+            if (pa < split || (pa == split && ray.d[axis] < 0))
+                nodeIndex = nodeIndex + 1;
+            else
+                nodeIndex = node->AboveChild();
+            node = &nodes[nodeIndex];
+        }
+        ++perRayTraversalStats.nodesVisited;
+
+        // Check for intersections inside leaf node
+        int nPrimitives = node->nPrimitives();
+        perRayTraversalStats.primTests += nPrimitives;
+        if (nPrimitives == 1) {
+            const std::shared_ptr<Primitive> &p =
+                primitives[node->onePrimitive];
+            if (p->Intersect(ray, isect)) hit = true;
+        } else {
+            for (int i = 0; i < nPrimitives; ++i) {
+                int index = primitiveIndices[node->primitiveIndicesOffset + i];
+                if (primitives[index]->Intersect(ray, isect)) hit = true;
+            }
+        }
+
+        // Advance through the leaf's exit face to its neighbor
+        const Bounds3f &lb = leafBounds[nodeIndex];
+        Float tExit = Infinity;
+        int exitFace = -1;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (ray.d[axis] == 0) continue;
+            Float t = ((ray.d[axis] > 0 ? lb.pMax[axis] : lb.pMin[axis]) -
+                       ray.o[axis]) * invDir[axis];
+            if (t < tExit) {
+                tExit = t;
+                exitFace = 2 * axis + (ray.d[axis] > 0 ? 1 : 0);
+            }
+        }
+        if (exitFace < 0 || tExit > tMax) break;
+        int rope = ropes[6 * (size_t)nodeIndex + exitFace];
+        if (rope < 0) break;
+        nodeIndex = rope;
+        // Guard against zero-width leaves stalling the walk
+        tEntry = tExit > tEntry ? tExit : NextFloatUp(tEntry);
+    }
+    return hit;
+}
+
+bool KdTreeAccel::IntersectPRopes(const Ray &ray) const {
+    Float tMin, tMax;
+    if (!bounds.IntersectP(ray, &tMin, &tMax)) return false;
+    Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int nodeIndex = 0;
+    Float tEntry = tMin;
+    while (true) {
+        if (ray.tMax < tEntry) break;
+        const KdAccelNode *node = &nodes[nodeIndex];
+        while (!node->IsLeaf()) {
+            ++perRayTraversalStats.nodesVisited;
+            int axis = node->SplitAxis();
+            Float split = node->SplitPos();
+            Float pa = ray.o[axis] + tEntry * ray.d[axis];
+            if (pa < split || (pa == split && ray.d[axis] < 0))
+                nodeIndex = nodeIndex + 1;
+            else
+                nodeIndex = node->AboveChild();
+            node = &nodes[nodeIndex];
+        }
+        ++perRayTraversalStats.nodesVisited;
+
+        int nPrimitives = node->nPrimitives();
+        perRayTraversalStats.primTests += nPrimitives;
+        if (nPrimitives == 1) {
+            if (primitives[node->onePrimitive]->IntersectP(ray)) return true;
+        } else {
+            for (int i = 0; i < nPrimitives; ++i) {
+                int index = primitiveIndices[node->primitiveIndicesOffset + i];
+                if (primitives[index]->IntersectP(ray)) return true;
+            }
+        }
+
+        const Bounds3f &lb = leafBounds[nodeIndex];
+        Float tExit = Infinity;
+        int exitFace = -1;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (ray.d[axis] == 0) continue;
+            Float t = ((ray.d[axis] > 0 ? lb.pMax[axis] : lb.pMin[axis]) -
+                       ray.o[axis]) * invDir[axis];
+            if (t < tExit) {
+                tExit = t;
+                exitFace = 2 * axis + (ray.d[axis] > 0 ? 1 : 0);
+            }
+        }
+        if (exitFace < 0 || tExit > tMax) break;
+        int rope = ropes[6 * (size_t)nodeIndex + exitFace];
+        if (rope < 0) break;
+        nodeIndex = rope;
+        tEntry = tExit > tEntry ? tExit : NextFloatUp(tEntry);
+    }
+    return false;
 }
 
 bool KdTreeAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
     ProfilePhase p(Prof::AccelIntersect);
+    if (useRopes) return IntersectRopes(ray, isect);
     // Compute initial parametric range of ray inside kd-tree extent
     Float tMin, tMax;
     if (!bounds.IntersectP(ray, &tMin, &tMax)) {
@@ -282,6 +546,7 @@ bool KdTreeAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
     while (node != nullptr) {
         // Bail out if we found a hit closer than the current node
         if (ray.tMax < tMin) break;
+        ++perRayTraversalStats.nodesVisited;
         if (!node->IsLeaf()) {
             // Process kd-tree interior node
 
@@ -319,6 +584,7 @@ bool KdTreeAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
         } else {
             // Check for intersections inside leaf node
             int nPrimitives = node->nPrimitives();
+            perRayTraversalStats.primTests += nPrimitives;
             if (nPrimitives == 1) {
                 const std::shared_ptr<Primitive> &p =
                     primitives[node->onePrimitive];
@@ -349,6 +615,7 @@ bool KdTreeAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
 
 bool KdTreeAccel::IntersectP(const Ray &ray) const {
     ProfilePhase p(Prof::AccelIntersectP);
+    if (useRopes) return IntersectPRopes(ray);
     // Compute initial parametric range of ray inside kd-tree extent
     Float tMin, tMax;
     if (!bounds.IntersectP(ray, &tMin, &tMax)) {
@@ -362,9 +629,11 @@ bool KdTreeAccel::IntersectP(const Ray &ray) const {
     int todoPos = 0;
     const KdAccelNode *node = &nodes[0];
     while (node != nullptr) {
+        ++perRayTraversalStats.nodesVisited;
         if (node->IsLeaf()) {
             // Check for shadow ray intersections inside leaf node
             int nPrimitives = node->nPrimitives();
+            perRayTraversalStats.primTests += nPrimitives;
             if (nPrimitives == 1) {
                 const std::shared_ptr<Primitive> &p =
                     primitives[node->onePrimitive];
@@ -437,8 +706,9 @@ std::shared_ptr<KdTreeAccel> CreateKdTreeAccelerator(
     Float emptyBonus = ps.FindOneFloat("emptybonus", 0.5f);
     int maxPrims = ps.FindOneInt("maxprims", 1);
     int maxDepth = ps.FindOneInt("maxdepth", -1);
+    bool ropes = ps.FindOneBool("ropes", false);
     return std::make_shared<KdTreeAccel>(std::move(prims), isectCost, travCost, emptyBonus,
-                                         maxPrims, maxDepth);
+                                         maxPrims, maxDepth, ropes);
 }
 
 }  // namespace pbrt
@@ -46,13 +46,16 @@ namespace pbrt {
 
 // KdTreeAccel Declarations
 struct KdAccelNode;
+struct KdBuildNode;
+struct KdBuildContext;
 struct BoundEdge;
 class KdTreeAccel : public Aggregate {
   public:
     // KdTreeAccel Public Methods
     KdTreeAccel(std::vector<std::shared_ptr<Primitive>> p,
                 int isectCost = 80, int traversalCost = 1,
-                Float emptyBonus = 0.5, int maxPrims = 1, int maxDepth = -1);
+                Float emptyBonus = 0.5, int maxPrims = 1, int maxDepth = -1,
+                bool useRopes = false);
     Bounds3f WorldBound() const { return bounds; }
     ~KdTreeAccel();
     bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
@@ -60,11 +63,17 @@ class KdTreeAccel : public Aggregate {
 
   private:
     // KdTreeAccel Private Methods
-    void buildTree(int nodeNum, const Bounds3f &bounds,
-                   const std::vector<Bounds3f> &primBounds, int *primNums,
-                   int nprims, int depth,
-                   const std::unique_ptr<BoundEdge[]> edges[3], int *prims0,
-                   int *prims1, int badRefines = 0);
+    KdBuildNode *buildTree(KdBuildContext &ctx, MemoryArena &arena,
+                           const Bounds3f &bounds,
+                           const std::vector<Bounds3f> &primBounds,
+                           int *primNums, int nprims, int depth,
+                           const std::unique_ptr<BoundEdge[]> edges[3],
+                           int *prims0, int *prims1, int badRefines = 0);
+    int flattenTree(const KdBuildNode *buildNode);
+    void buildRopes(int nodeIndex, const Bounds3f &nodeBounds,
+                    const int ropesIn[6]);
+    bool IntersectRopes(const Ray &ray, SurfaceInteraction *isect) const;
+    bool IntersectPRopes(const Ray &ray) const;
 
     // KdTreeAccel Private Data
     const int isectCost, traversalCost, maxPrims;
@@ -74,6 +83,13 @@ class KdTreeAccel : public Aggregate {
     KdAccelNode *nodes;
     int nAllocedNodes, nextFreeNode;
     Bounds3f bounds;
+    // Rope-based stackless traversal ("ropes" parameter): each leaf stores
+    // its bounds and six neighbor links (-x,+x,-y,+y,-z,+z; -1 exterior).
+    // Traversal walks leaf to leaf through the exit face instead of
+    // maintaining a todo stack.
+    const bool useRopes;
+    std::vector<Bounds3f> leafBounds;
+    std::vector<int> ropes;
 };
 
 struct KdToDo {
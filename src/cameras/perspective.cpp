@@ -143,6 +143,39 @@ Float PerspectiveCamera::GenerateRayDifferential(const CameraSample &sample,
     return 1;
 }
 
+void PerspectiveCamera::GenerateRayDifferentialBatch(
+    const CameraSample *samples, int count, RayDifferential *rays,
+    Float *weights) const {
+    ProfilePhase prof(Prof::GenerateCameraRay);
+    if (lensRadius > 0) {
+        // The depth-of-field path does per-ray lens sampling anyway; just
+        // avoid the per-ray virtual dispatch.
+        for (int i = 0; i < count; ++i)
+            weights[i] =
+                PerspectiveCamera::GenerateRayDifferential(samples[i],
+                                                           &rays[i]);
+        return;
+    }
+    // Pinhole path: the lens branch, profiler bookkeeping, and dispatch are
+    // hoisted out of the loop, leaving three transform applications and
+    // three normalizations per ray for the compiler to pipeline.
+    for (int i = 0; i < count; ++i) {
+        Point3f pCamera = RasterToCamera(
+            Point3f(samples[i].pFilm.x, samples[i].pFilm.y, 0));
+        RayDifferential &ray = rays[i];
+        ray = RayDifferential(Point3f(0, 0, 0),
+                              Normalize(Vector3f(pCamera)));
+        ray.rxOrigin = ray.ryOrigin = ray.o;
+        ray.rxDirection = Normalize(Vector3f(pCamera) + dxCamera);
+        ray.ryDirection = Normalize(Vector3f(pCamera) + dyCamera);
+        ray.time = Lerp(samples[i].time, shutterOpen, shutterClose);
+        ray.medium = medium;
+        ray = CameraToWorld(ray);
+        ray.hasDifferentials = true;
+        weights[i] = 1;
+    }
+}
+
 Spectrum PerspectiveCamera::We(const Ray &ray, Point2f *pRaster2) const {
     // Interpolate camera matrix and check if $\w{}$ is forward-facing
     Transform c2w;
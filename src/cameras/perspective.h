@@ -56,6 +56,9 @@ class PerspectiveCamera : public ProjectiveCamera {
     Float GenerateRay(const CameraSample &sample, Ray *) const;
     Float GenerateRayDifferential(const CameraSample &sample,
                                   RayDifferential *ray) const;
+    void GenerateRayDifferentialBatch(const CameraSample *samples, int count,
+                                      RayDifferential *rays,
+                                      Float *weights) const;
     Spectrum We(const Ray &ray, Point2f *pRaster2 = nullptr) const;
     void Pdf_We(const Ray &ray, Float *pdfPos, Float *pdfDir) const;
     Spectrum Sample_Wi(const Interaction &ref, const Point2f &sample,
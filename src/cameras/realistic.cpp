@@ -40,10 +40,66 @@
 #include "reflection.h"
 #include "stats.h"
 #include "lowdiscrepancy.h"
+#include "parallel.h"
+#include "stringprint.h"
 #include <array>
+#include <cstdio>
 
 namespace pbrt {
 
+// Exit pupil tables are expensive to compute (a million probe rays per
+// film sample) but depend only on the lens prescription, aperture, focus
+// distance, and film diagonal; when --texcachedir is set they round-trip
+// through a small cache file keyed by a hash of those inputs, so repeated
+// frames of a shot with an unchanging lens skip the probing entirely.
+static const uint32_t pupilCacheMagic = 0x50555032;  // "PUP2"
+
+static bool LoadExitPupilCache(const std::string &path, int nSamples,
+                               std::vector<Bounds2f> *bounds,
+                               std::vector<uint64_t> *mask) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    uint32_t magic = 0, floatSize = 0;
+    int32_t n = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, f) == 1 &&
+              magic == pupilCacheMagic &&
+              fread(&floatSize, sizeof(floatSize), 1, f) == 1 &&
+              floatSize == sizeof(Float) &&
+              fread(&n, sizeof(n), 1, f) == 1 && n == nSamples &&
+              fread(&(*bounds)[0], sizeof(Bounds2f), nSamples, f) ==
+                  (size_t)nSamples &&
+              fread(&(*mask)[0], sizeof(uint64_t), mask->size(), f) ==
+                  mask->size();
+    fclose(f);
+    return ok;
+}
+
+static void WriteExitPupilCache(const std::string &path, int nSamples,
+                                const std::vector<Bounds2f> &bounds,
+                                const std::vector<uint64_t> &mask) {
+    std::string tempPath = path + StringPrintf(".%d.tmp", ThreadIndex);
+    FILE *f = fopen(tempPath.c_str(), "wb");
+    if (!f) {
+        Warning("Unable to write exit pupil cache file \"%s\"",
+                tempPath.c_str());
+        return;
+    }
+    uint32_t floatSize = sizeof(Float);
+    int32_t n = nSamples;
+    bool ok = fwrite(&pupilCacheMagic, sizeof(pupilCacheMagic), 1, f) == 1 &&
+              fwrite(&floatSize, sizeof(floatSize), 1, f) == 1 &&
+              fwrite(&n, sizeof(n), 1, f) == 1 &&
+              fwrite(&bounds[0], sizeof(Bounds2f), nSamples, f) ==
+                  (size_t)nSamples &&
+              fwrite(&mask[0], sizeof(uint64_t), mask.size(), f) ==
+                  mask.size();
+    if (fclose(f) != 0) ok = false;
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+        Warning("Unable to write exit pupil cache file \"%s\"", path.c_str());
+        remove(tempPath.c_str());
+    }
+}
+
 STAT_PERCENT("Camera/Rays vignetted by lens system", vignettedRays, totalRays);
 
 // RealisticCamera Method Definitions
@@ -80,14 +136,63 @@ RealisticCamera::RealisticCamera(const AnimatedTransform &CameraToWorld,
                               elementInterfaces.back().thickness,
                               FocusDistance(elementInterfaces.back().thickness));
 
-    // Compute exit pupil bounds at sampled points on the film
+    // Compute exit pupil bounds at sampled points on the film, reusing a
+    // cached table when one exists for this lens configuration
     int nSamples = 64;
     exitPupilBounds.resize(nSamples);
-    ParallelFor([&](int i) {
-        Float r0 = (Float)i / nSamples * film->diagonal / 2;
-        Float r1 = (Float)(i + 1) / nSamples * film->diagonal / 2;
-        exitPupilBounds[i] = BoundExitPupil(r0, r1);
-    }, nSamples);
+    std::string cachePath;
+    if (!PbrtOptions.texCacheDir.empty()) {
+        // FNV-1a over everything the table depends on: the (focused,
+        // aperture-clamped) element interfaces, the focus distance, and
+        // the film diagonal.
+        uint64_t hash = 14695981039346656037ull;
+        auto hashBytes = [&hash](const void *ptr, size_t size) {
+            const unsigned char *p = (const unsigned char *)ptr;
+            for (size_t i = 0; i < size; ++i)
+                hash = (hash ^ p[i]) * 1099511628211ull;
+        };
+        hashBytes(&elementInterfaces[0],
+                  elementInterfaces.size() * sizeof(LensElementInterface));
+        hashBytes(&focusDistance, sizeof(focusDistance));
+        hashBytes(&film->diagonal, sizeof(film->diagonal));
+        cachePath = PbrtOptions.texCacheDir +
+                    StringPrintf("/pupil_%016llx.bin",
+                                 (unsigned long long)hash);
+    }
+    pupilMask.assign((size_t)nSamples * pupilMaskRes, 0);
+    if (cachePath.empty() ||
+        !LoadExitPupilCache(cachePath, nSamples, &exitPupilBounds,
+                            &pupilMask)) {
+        std::fill(pupilMask.begin(), pupilMask.end(), uint64_t(0));
+        ParallelFor([&](int i) {
+            Float r0 = (Float)i / nSamples * film->diagonal / 2;
+            Float r1 = (Float)(i + 1) / nSamples * film->diagonal / 2;
+            exitPupilBounds[i] =
+                BoundExitPupil(r0, r1, &pupilMask[(size_t)i * pupilMaskRes]);
+        }, nSamples);
+        if (!cachePath.empty())
+            WriteExitPupilCache(cachePath, nSamples, exitPupilBounds,
+                                pupilMask);
+    } else
+        LOG(INFO) << "Loaded exit pupil bounds from cache file " << cachePath;
+
+    // Dilate the occupancy masks by one cell in each direction so that
+    // boundary cells the probes barely missed are never rejected.
+    {
+        std::vector<uint64_t> dilated(pupilMask.size());
+        for (int r = 0; r < nSamples; ++r)
+            for (int y = 0; y < pupilMaskRes; ++y) {
+                uint64_t acc = 0;
+                for (int dy = -1; dy <= 1; ++dy) {
+                    int yy = y + dy;
+                    if (yy < 0 || yy >= pupilMaskRes) continue;
+                    uint64_t m = pupilMask[(size_t)r * pupilMaskRes + yy];
+                    acc |= m | (m << 1) | (m >> 1);
+                }
+                dilated[(size_t)r * pupilMaskRes + y] = acc;
+            }
+        pupilMask.swap(dilated);
+    }
 
     if (simpleWeighting)
         Warning("\"simpleweighting\" option with RealisticCamera no longer "
@@ -531,7 +636,8 @@ Float RealisticCamera::FocusDistance(Float filmDistance) {
 }
 
 
-Bounds2f RealisticCamera::BoundExitPupil(Float pFilmX0, Float pFilmX1) const {
+Bounds2f RealisticCamera::BoundExitPupil(Float pFilmX0, Float pFilmX1,
+                                         uint64_t *mask) const {
     Bounds2f pupilBounds;
     // Sample a collection of points on the rear lens to find exit pupil
     const int nSamples = 1024 * 1024;
@@ -549,11 +655,21 @@ Bounds2f RealisticCamera::BoundExitPupil(Float pFilmX0, Float pFilmX1) const {
                       Lerp(u[1], projRearBounds.pMin.y, projRearBounds.pMax.y),
                       LensRearZ());
 
-        // Expand pupil bounds if ray makes it through the lens system
-        if (Inside(Point2f(pRear.x, pRear.y), pupilBounds) ||
-            TraceLensesFromFilm(Ray(pFilm, pRear - pFilm), nullptr)) {
+        // Expand pupil bounds if ray makes it through the lens system.
+        // (Every probe is traced; the bounding-box early out the scalar
+        // version used would mark vignetted cells as passing in the
+        // occupancy mask. The extra tracing is paid once per lens thanks to
+        // the on-disk pupil cache.)
+        if (TraceLensesFromFilm(Ray(pFilm, pRear - pFilm), nullptr)) {
             pupilBounds = Union(pupilBounds, Point2f(pRear.x, pRear.y));
             ++nExitingRays;
+            if (mask) {
+                int cx = std::min(pupilMaskRes - 1,
+                                  (int)(u[0] * pupilMaskRes));
+                int cy = std::min(pupilMaskRes - 1,
+                                  (int)(u[1] * pupilMaskRes));
+                mask[cy] |= 1ull << cx;
+            }
         }
     }
 
@@ -561,6 +677,9 @@ Bounds2f RealisticCamera::BoundExitPupil(Float pFilmX0, Float pFilmX1) const {
     if (nExitingRays == 0) {
         LOG(INFO) << StringPrintf("Unable to find exit pupil in x = [%f,%f] on film.",
                                   pFilmX0, pFilmX1);
+        // Disable mask rejection for this ring; there is nothing to go on.
+        if (mask)
+            for (int y = 0; y < pupilMaskRes; ++y) mask[y] = ~0ull;
         return projRearBounds;
     }
 
@@ -612,7 +731,8 @@ void RealisticCamera::RenderExitPupil(Float sx, Float sy,
 
 Point3f RealisticCamera::SampleExitPupil(const Point2f &pFilm,
                                          const Point2f &lensSample,
-                                         Float *sampleBoundsArea) const {
+                                         Float *sampleBoundsArea,
+                                         bool *vignetted) const {
     // Find exit pupil bound for sample distance from film center
     Float rFilm = std::sqrt(pFilm.x * pFilm.x + pFilm.y * pFilm.y);
     int rIndex = rFilm / (film->diagonal / 2) * exitPupilBounds.size();
@@ -623,6 +743,25 @@ Point3f RealisticCamera::SampleExitPupil(const Point2f &pFilm,
     // Generate sample point inside exit pupil bound
     Point2f pLens = pupilBounds.Lerp(lensSample);
 
+    // Report samples landing in pupil-mask cells that no probe ray escaped
+    // from; the caller can then skip tracing the lens system entirely.
+    if (vignetted) {
+        *vignetted = false;
+        if (!pupilMask.empty()) {
+            Float rearRadius = RearElementRadius();
+            Float ux = (pLens.x + 1.5f * rearRadius) / (3 * rearRadius);
+            Float uy = (pLens.y + 1.5f * rearRadius) / (3 * rearRadius);
+            // Samples outside the probed square carry no mask information;
+            // leave them to the lens trace.
+            if (ux >= 0 && ux < 1 && uy >= 0 && uy < 1) {
+                int cx = std::min(pupilMaskRes - 1, (int)(ux * pupilMaskRes));
+                int cy = std::min(pupilMaskRes - 1, (int)(uy * pupilMaskRes));
+                *vignetted =
+                    !((pupilMask[rIndex * pupilMaskRes + cy] >> cx) & 1);
+            }
+        }
+    }
+
     // Return sample point rotated by angle of _pFilm_ with $+x$ axis
     Float sinTheta = (rFilm != 0) ? pFilm.y / rFilm : 0;
     Float cosTheta = (rFilm != 0) ? pFilm.x / rFilm : 1;
@@ -687,8 +826,15 @@ Float RealisticCamera::GenerateRay(const CameraSample &sample, Ray *ray) const {
 
     // Trace ray from _pFilm_ through lens system
     Float exitPupilBoundsArea;
+    bool maskVignetted = false;
     Point3f pRear = SampleExitPupil(Point2f(pFilm.x, pFilm.y), sample.pLens,
-                                    &exitPupilBoundsArea);
+                                    &exitPupilBoundsArea, &maskVignetted);
+    if (maskVignetted) {
+        // The precomputed pupil mask says no probe ray anywhere near this
+        // lens sample escaped the element stack; don't bother tracing.
+        ++vignettedRays;
+        return 0;
+    }
     Ray rFilm(pFilm, pRear - pFilm, Infinity,
               Lerp(sample.time, shutterOpen, shutterClose));
     if (!TraceLensesFromFilm(rFilm, ray)) {
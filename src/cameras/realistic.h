@@ -69,6 +69,14 @@ class RealisticCamera : public Camera {
     const bool simpleWeighting;
     std::vector<LensElementInterface> elementInterfaces;
     std::vector<Bounds2f> exitPupilBounds;
+    // Per-ring occupancy masks over the rear-element sampling square,
+    // pupilMaskRes rows of pupilMaskRes bits each: a zero cell (after one
+    // cell of dilation) means no probe ray anywhere in it made it through
+    // the lens system, so lens samples landing there are rejected before
+    // any element math. Filled by BoundExitPupil(), tested in
+    // SampleExitPupil().
+    static PBRT_CONSTEXPR int pupilMaskRes = 64;
+    std::vector<uint64_t> pupilMask;
 
     // RealisticCamera Private Methods
     Float LensRearZ() const { return elementInterfaces.back().thickness; }
@@ -97,10 +105,12 @@ class RealisticCamera : public Camera {
     Float FocusThickLens(Float focusDistance);
     Float FocusBinarySearch(Float focusDistance);
     Float FocusDistance(Float filmDist);
-    Bounds2f BoundExitPupil(Float pFilmX0, Float pFilmX1) const;
+    Bounds2f BoundExitPupil(Float pFilmX0, Float pFilmX1,
+                            uint64_t *mask = nullptr) const;
     void RenderExitPupil(Float sx, Float sy, const char *filename) const;
     Point3f SampleExitPupil(const Point2f &pFilm, const Point2f &lensSample,
-                            Float *sampleBoundsArea) const;
+                            Float *sampleBoundsArea,
+                            bool *vignetted = nullptr) const;
     void TestExitPupilBounds() const;
 };
 
@@ -33,6 +33,7 @@
 // core/api.cpp*
 #include "api.h"
 #include "parallel.h"
+#include <iterator>
 #include "paramset.h"
 #include "spectrum.h"
 #include "scene.h"
@@ -41,6 +42,7 @@
 #include "stats.h"
 
 // API Additional Headers
+#include "bssrdf.h"
 #include "accelerators/bvh.h"
 #include "accelerators/kdtreeaccel.h"
 #include "cameras/environment.h"
@@ -83,6 +85,8 @@
 #include "materials/uber.h"
 #include "samplers/halton.h"
 #include "samplers/maxmin.h"
+#include "samplers/owensobol.h"
+#include "samplers/pmj02.h"
 #include "samplers/random.h"
 #include "samplers/sobol.h"
 #include "samplers/stratified.h"
@@ -161,6 +165,20 @@ struct RenderOptions {
     Scene *MakeScene();
     Camera *MakeCamera() const;
 
+    // Shape directives whose (file-backed) creation is deferred during
+    // parsing so that all of their files can be loaded in parallel just
+    // before the aggregate is built.
+    struct DeferredShape {
+        std::string name;
+        ParamSet params;
+        Transform *ObjectToWorld, *WorldToObject;
+        bool reverseOrientation;
+        std::shared_ptr<Material> material;
+        MediumInterface mediumInterface;
+        std::shared_ptr<std::map<std::string, std::shared_ptr<Texture<Float>>>>
+            floatTextures;
+    };
+
     // RenderOptions Public Data
     Float transformStartTime = 0, transformEndTime = 1;
     std::string FilterName = "box";
@@ -181,6 +199,7 @@ struct RenderOptions {
     std::vector<std::shared_ptr<Primitive>> primitives;
     std::map<std::string, std::vector<std::shared_ptr<Primitive>>> instances;
     std::vector<std::shared_ptr<Primitive>> *currentInstance = nullptr;
+    std::vector<DeferredShape> deferredShapes;
     bool haveScatteringMedia = false;
 };
 
@@ -256,50 +275,96 @@ STAT_INT_DISTRIBUTION("Scene/Probes per TransformCache lookup", transformCachePr
 // The hash table size is always a power of two, allowing for the use of a
 // bitwise AND to turn hash values into table offsets.  Quadratic probing
 // is used when there is a hash collision.
+// The table is concurrent so that deferred parallel scene construction can
+// dedupe transforms without a global bottleneck: reads are lock-free
+// against atomic slots, and inserts claim empty slots with a
+// compare-and-swap. The table has a fixed (lazily allocated) capacity
+// rather than growing, since resizing would require synchronizing against
+// concurrent readers; Clear() recycles it between renders.
 class TransformCache {
   public:
-    TransformCache()
-        : hashTable(512), hashTableOccupancy(0) {}
+    TransformCache() : hashTableOccupancy(0) {}
 
     // TransformCache Public Methods
     Transform *Lookup(const Transform &t) {
         ++nTransformCacheLookups;
+        std::call_once(allocOnce, [this]() {
+            hashTable = std::vector<std::atomic<Transform *>>(tableSize);
+        });
 
-        int offset = Hash(t) & (hashTable.size() - 1);
+        int offset = Hash(t) & (tableSize - 1);
         int step = 1;
         while (true) {
-            // Keep looking until we find the Transform or determine that
-            // it's not present.
-            if (!hashTable[offset] || *hashTable[offset] == t)
-                break;
+            Transform *cached = hashTable[offset].load(
+                std::memory_order_acquire);
+            if (!cached) {
+                // The table is intentionally never filled past 75%
+                // occupancy: probe chains degrade sharply beyond that and
+                // the lock-free claims rely on free slots remaining. For
+                // scenes with more distinct transforms than that, degrade
+                // gracefully by handing out an undeduplicated copy -
+                // callers only need a stable Transform*, deduplication is
+                // an optimization - instead of aborting the render. (The
+                // concurrent occupancy check may overshoot by a handful of
+                // in-flight claims, which the 25% headroom absorbs.)
+                if (hashTableOccupancy.load(std::memory_order_relaxed) >=
+                    3 * tableSize / 4) {
+                    static std::once_flag fullWarningOnce;
+                    std::call_once(fullWarningOnce, []() {
+                        Warning("TransformCache is full (%d distinct "
+                                "transforms); further transforms won't be "
+                                "deduplicated.",
+                                (int)(3 * tableSize / 4));
+                    });
+                    Transform *tUncached;
+                    {
+                        std::lock_guard<std::mutex> lock(arenaMutex);
+                        tUncached = arena.Alloc<Transform>();
+                    }
+                    *tUncached = t;
+                    ReportValue(transformCacheProbes, step);
+                    return tUncached;
+                }
+                // Try to claim the empty slot with a new cache entry
+                Transform *tNew;
+                {
+                    std::lock_guard<std::mutex> lock(arenaMutex);
+                    tNew = arena.Alloc<Transform>();
+                }
+                *tNew = t;
+                Transform *expected = nullptr;
+                if (hashTable[offset].compare_exchange_strong(
+                        expected, tNew, std::memory_order_acq_rel)) {
+                    hashTableOccupancy.fetch_add(1,
+                                                 std::memory_order_relaxed);
+                    ReportValue(transformCacheProbes, step);
+                    return tNew;
+                }
+                // Another thread claimed the slot first; the arena entry
+                // is wasted (rare) and the stored transform is re-checked
+                cached = expected;
+            }
+            if (*cached == t) {
+                ++nTransformCacheHits;
+                ReportValue(transformCacheProbes, step);
+                return cached;
+            }
             // Advance using quadratic probing.
-            offset = (offset + step * step) & (hashTable.size() - 1);
+            offset = (offset + step * step) & (tableSize - 1);
             ++step;
         }
-        ReportValue(transformCacheProbes, step);
-        Transform *tCached = hashTable[offset];
-        if (tCached)
-            ++nTransformCacheHits;
-        else {
-            tCached = arena.Alloc<Transform>();
-            *tCached = t;
-            Insert(tCached);
-        }
-        return tCached;
     }
 
     void Clear() {
-        transformCacheBytes += arena.TotalAllocated() + hashTable.size() * sizeof(Transform *);
-        hashTable.clear();
-        hashTable.resize(512);
+        transformCacheBytes +=
+            arena.TotalAllocated() + hashTable.size() * sizeof(Transform *);
+        for (auto &entry : hashTable)
+            entry.store(nullptr, std::memory_order_relaxed);
         hashTableOccupancy = 0;
         arena.Reset();
     }
 
   private:
-    void Insert(Transform *tNew);
-    void Grow();
-
     static uint64_t Hash(const Transform &t) {
         const char *ptr = (const char *)(&t.GetMatrix());
         size_t size = sizeof(Matrix4x4);
@@ -314,48 +379,14 @@ class TransformCache {
     }
 
     // TransformCache Private Data
-    std::vector<Transform *> hashTable;
-    int hashTableOccupancy;
+    static PBRT_CONSTEXPR int tableSize = 1 << 20;
+    std::once_flag allocOnce;
+    std::vector<std::atomic<Transform *>> hashTable;
+    std::atomic<int> hashTableOccupancy;
+    std::mutex arenaMutex;
     MemoryArena arena;
 };
 
-void TransformCache::Insert(Transform *tNew) {
-    if (++hashTableOccupancy == hashTable.size() / 2)
-        Grow();
-
-    int baseOffset = Hash(*tNew) & (hashTable.size() - 1);
-    for (int nProbes = 0;; ++nProbes) {
-        // Quadratic probing.
-        int offset = (baseOffset + nProbes/2 + nProbes*nProbes/2) & (hashTable.size() - 1);
-        if (hashTable[offset] == nullptr) {
-            hashTable[offset] = tNew;
-            return;
-        }
-    }
-}
-
-void TransformCache::Grow() {
-    std::vector<Transform *> newTable(2 * hashTable.size());
-    LOG(INFO) << "Growing transform cache hash table to " << newTable.size();
-
-    // Insert current elements into newTable.
-    for (Transform *tEntry : hashTable) {
-        if (!tEntry) continue;
-
-        int baseOffset = Hash(*tEntry) & (hashTable.size() - 1);
-        for (int nProbes = 0;; ++nProbes) {
-            // Quadratic probing.
-            int offset = (baseOffset + nProbes/2 + nProbes*nProbes/2) & (hashTable.size() - 1);
-            if (newTable[offset] == nullptr) {
-                newTable[offset] = tEntry;
-                break;
-            }
-        }
-    }
-
-    std::swap(hashTable, newTable);
-}
-
 
 // API Static Data
 enum class APIState { Uninitialized, OptionsBlock, WorldBlock };
@@ -718,8 +749,20 @@ std::shared_ptr<Medium> MakeMedium(const std::string &name,
         }
         Transform data2Medium = Translate(Vector3f(p0)) *
                                 Scale(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+        // Optional per-voxel temperatures enable blackbody emission
+        int nTemp;
+        const Float *temperature = paramSet.FindFloat("temperature", &nTemp);
+        if (temperature && nTemp != nx * ny * nz) {
+            Error(
+                "GridDensityMedium has %d temperature values; expected "
+                "nx*ny*nz = %d",
+                nTemp, nx * ny * nz);
+            temperature = nullptr;
+        }
+        Float LeScale = paramSet.FindOneFloat("Lescale", 1.f);
         m = new GridDensityMedium(sig_a, sig_s, g, nx, ny, nz,
-                                  medium2world * data2Medium, data);
+                                  medium2world * data2Medium, data,
+                                  temperature, LeScale);
     } else
         Warning("Medium \"%s\" unknown.", name.c_str());
     paramSet.ReportUnused();
@@ -821,10 +864,14 @@ std::shared_ptr<Sampler> MakeSampler(const std::string &name,
         sampler = CreateZeroTwoSequenceSampler(paramSet);
     else if (name == "maxmindist")
         sampler = CreateMaxMinDistSampler(paramSet);
+    else if (name == "pmj02")
+        sampler = CreatePMJ02Sampler(paramSet);
     else if (name == "halton")
         sampler = CreateHaltonSampler(paramSet, film->GetSampleBounds());
     else if (name == "sobol")
         sampler = CreateSobolSampler(paramSet, film->GetSampleBounds());
+    else if (name == "owensobol")
+        sampler = CreateOwenSobolSampler(paramSet);
     else if (name == "random")
         sampler = CreateRandomSampler(paramSet);
     else if (name == "stratified")
@@ -883,6 +930,7 @@ void pbrtInit(const Options &opt) {
     ParallelInit();  // Threads must be launched before the profiler is
                      // initialized.
     InitProfiler();
+    StartLiveStatsThread();
 }
 
 void pbrtCleanup() {
@@ -892,6 +940,10 @@ void pbrtCleanup() {
     else if (currentApiState == APIState::WorldBlock)
         Error("pbrtCleanup() called while inside world block.");
     currentApiState = APIState::Uninitialized;
+    StopLiveStatsThread();
+    ClearTriangleMeshCache();
+    ClearBSSRDFTableCache();
+    FreeArenaBlockPool();
     ParallelCleanup();
     CleanupProfiler();
 }
@@ -1342,6 +1394,30 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         // Create shapes for shape _name_
         Transform *ObjToWorld = transformCache.Lookup(curTransform[0]);
         Transform *WorldToObj = transformCache.Lookup(Inverse(curTransform[0]));
+
+        // Defer creation of file-backed meshes with no area light; all of
+        // them are then loaded in parallel in RenderOptions::MakeScene()
+        // before the aggregate is built.
+        if (name == "plymesh" && graphicsState.areaLight == "" &&
+            !renderOptions->currentInstance && !PbrtOptions.cat &&
+            !PbrtOptions.toPly) {
+            RenderOptions::DeferredShape ds;
+            ds.name = name;
+            ds.params = params;
+            ds.ObjectToWorld = ObjToWorld;
+            ds.WorldToObject = WorldToObj;
+            ds.reverseOrientation = graphicsState.reverseOrientation;
+            ds.material = graphicsState.GetMaterialForShape(params);
+            ds.mediumInterface = graphicsState.CreateMediumInterface();
+            ds.floatTextures = graphicsState.floatTextures;
+            // Start pulling the geometry file toward the page cache now;
+            // the deferred load runs much later.
+            std::string plyFile = params.FindOneFilename("filename", "");
+            if (!plyFile.empty()) PrefetchFileAsync(plyFile);
+            renderOptions->deferredShapes.push_back(std::move(ds));
+            return;
+        }
+
         std::vector<std::shared_ptr<Shape>> shapes =
             MakeShapes(name, ObjToWorld, WorldToObj,
                        graphicsState.reverseOrientation, params);
@@ -1349,7 +1425,11 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         std::shared_ptr<Material> mtl = graphicsState.GetMaterialForShape(params);
         params.ReportUnused();
         MediumInterface mi = graphicsState.CreateMediumInterface();
-        prims.reserve(shapes.size());
+        // Allocate the shapes' _GeometricPrimitive_s in one contiguous
+        // block, handing out aliasing shared_ptrs, so large meshes don't
+        // pay a heap allocation and control block per primitive
+        auto geomPrims = std::make_shared<std::vector<GeometricPrimitive>>();
+        geomPrims->reserve(shapes.size());
         for (auto s : shapes) {
             // Possibly create area light for shape
             std::shared_ptr<AreaLight> area;
@@ -1358,9 +1438,12 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
                                      mi, graphicsState.areaLightParams, s);
                 if (area) areaLights.push_back(area);
             }
-            prims.push_back(
-                std::make_shared<GeometricPrimitive>(s, mtl, area, mi));
+            geomPrims->emplace_back(s, mtl, area, mi);
         }
+        prims.reserve(shapes.size());
+        for (size_t i = 0; i < geomPrims->size(); ++i)
+            prims.push_back(
+                std::shared_ptr<Primitive>(geomPrims, &(*geomPrims)[i]));
     } else {
         // Initialize _prims_ and _areaLights_ for animated shape
 
@@ -1378,10 +1461,13 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         std::shared_ptr<Material> mtl = graphicsState.GetMaterialForShape(params);
         params.ReportUnused();
         MediumInterface mi = graphicsState.CreateMediumInterface();
+        auto geomPrims = std::make_shared<std::vector<GeometricPrimitive>>();
+        geomPrims->reserve(shapes.size());
+        for (auto s : shapes) geomPrims->emplace_back(s, mtl, nullptr, mi);
         prims.reserve(shapes.size());
-        for (auto s : shapes)
+        for (size_t i = 0; i < geomPrims->size(); ++i)
             prims.push_back(
-                std::make_shared<GeometricPrimitive>(s, mtl, nullptr, mi));
+                std::shared_ptr<Primitive>(geomPrims, &(*geomPrims)[i]));
 
         // Create single _TransformedPrimitive_ for _prims_
 
@@ -1408,10 +1494,17 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         if (areaLights.size())
             Warning("Area lights not supported with object instancing");
         renderOptions->currentInstance->insert(
-            renderOptions->currentInstance->end(), prims.begin(), prims.end());
+            renderOptions->currentInstance->end(),
+            std::make_move_iterator(prims.begin()),
+            std::make_move_iterator(prims.end()));
     } else {
-        renderOptions->primitives.insert(renderOptions->primitives.end(),
-                                         prims.begin(), prims.end());
+        // Move rather than copy: with millions of pooled shapes, the
+        // per-element atomic reference-count increments of copying
+        // shared_ptrs are a measurable slice of scene build time.
+        renderOptions->primitives.insert(
+            renderOptions->primitives.end(),
+            std::make_move_iterator(prims.begin()),
+            std::make_move_iterator(prims.end()));
         if (areaLights.size())
             renderOptions->lights.insert(renderOptions->lights.end(),
                                          areaLights.begin(), areaLights.end());
@@ -1564,11 +1657,20 @@ void pbrtObjectInstance(const std::string &name) {
     if (in.empty()) return;
     ++nObjectInstancesUsed;
     if (in.size() > 1) {
-        // Create aggregate for instance _Primitive_s
-        std::shared_ptr<Primitive> accel(
-            MakeAccelerator(renderOptions->AcceleratorName, std::move(in),
-                            renderOptions->AcceleratorParams));
-        if (!accel) accel = std::make_shared<BVHAccel>(in);
+        // Defer building the instance's aggregate until a ray first reaches
+        // it; instances the camera never sees are never built.
+        std::string accelName = renderOptions->AcceleratorName;
+        ParamSet accelParams = renderOptions->AcceleratorParams;
+        std::shared_ptr<Primitive> accel = std::make_shared<LazyAggregate>(
+            std::move(in),
+            [accelName,
+             accelParams](std::vector<std::shared_ptr<Primitive>> prims)
+                -> std::shared_ptr<Primitive> {
+                std::shared_ptr<Primitive> a(
+                    MakeAccelerator(accelName, std::move(prims), accelParams));
+                if (!a) a = std::make_shared<BVHAccel>(prims);
+                return a;
+            });
         in.clear();
         in.push_back(accel);
     }
@@ -1625,15 +1727,28 @@ void pbrtWorldEnd() {
     // Clean up after rendering. Do this before reporting stats so that
     // destructors can run and update stats as needed.
     graphicsState = GraphicsState();
-    transformCache.Clear();
     currentApiState = APIState::OptionsBlock;
-    ImageTexture<Float, Float>::ClearCache();
-    ImageTexture<RGBSpectrum, Spectrum>::ClearCache();
+    // In --watch mode the process re-parses and re-renders the scene after
+    // every edit; keep the transform and texture caches alive so a reload
+    // only pays for assets that actually changed.
+    if (!PbrtOptions.watchScene && PbrtOptions.imageBuckets <= 1) {
+        transformCache.Clear();
+        // The mesh cache must not outlive the transform cache: cached
+        // triangles hold Transform pointers into its arena, so deduping a
+        // later scene file's mesh onto them would be a use-after-free
+        ClearTriangleMeshCache();
+        ImageTexture<Float, Float>::ClearCache();
+        ImageTexture<RGBSpectrum, Spectrum>::ClearCache();
+    }
     renderOptions.reset(new RenderOptions);
 
     if (!PbrtOptions.cat && !PbrtOptions.toPly) {
         MergeWorkerThreadStats();
         ReportThreadStats();
+        // Append the telemetry record while the statistics still hold this
+        // render's values (they are cleared below)
+        if (!PbrtOptions.telemetryFile.empty())
+            WriteTelemetryRecord(PbrtOptions.telemetryFile);
         if (!PbrtOptions.quiet) {
             PrintStats(stdout);
             ReportProfilerResults(stdout);
@@ -1649,10 +1764,66 @@ void pbrtWorldEnd() {
 }
 
 Scene *RenderOptions::MakeScene() {
+    // Convert all of the scene's textures in parallel before rendering
+    LoadPendingTextures();
+
+    // Materialize deferred shapes, loading their geometry files in parallel
+    if (!deferredShapes.empty()) {
+        LOG(INFO) << "Loading " << deferredShapes.size() <<
+            " deferred meshes in parallel";
+        std::vector<std::vector<std::shared_ptr<Primitive>>> deferredPrims(
+            deferredShapes.size());
+        ParallelFor([&](int64_t i) {
+            DeferredShape &ds = deferredShapes[i];
+            CHECK_EQ(ds.name, "plymesh");
+            std::vector<std::shared_ptr<Shape>> shapes =
+                CreatePLYMesh(ds.ObjectToWorld, ds.WorldToObject,
+                              ds.reverseOrientation, ds.params,
+                              &*ds.floatTextures);
+            auto geomPrims =
+                std::make_shared<std::vector<GeometricPrimitive>>();
+            geomPrims->reserve(shapes.size());
+            for (auto s : shapes)
+                geomPrims->emplace_back(s, ds.material, nullptr,
+                                        ds.mediumInterface);
+            deferredPrims[i].reserve(shapes.size());
+            for (size_t j = 0; j < geomPrims->size(); ++j)
+                deferredPrims[i].push_back(std::shared_ptr<Primitive>(
+                    geomPrims, &(*geomPrims)[j]));
+        }, deferredShapes.size());
+        for (auto &dp : deferredPrims)
+            primitives.insert(primitives.end(),
+                              std::make_move_iterator(dp.begin()),
+                              std::make_move_iterator(dp.end()));
+        for (auto &ds : deferredShapes) ds.params.ReportUnused();
+        deferredShapes.clear();
+    }
+
+    // Build per-material probe accelerators over the subsurface materials'
+    // primitives, so BSSRDF probe rays - which only accept hits on their
+    // own material - traverse a small local BVH instead of the whole
+    // scene. Only materials with a BSSRDF get one, so the duplication is
+    // limited to exactly those meshes.
+    std::map<const Material *, std::vector<std::shared_ptr<Primitive>>>
+        subsurfacePrims;
+    for (const auto &prim : primitives) {
+        const GeometricPrimitive *gp =
+            dynamic_cast<const GeometricPrimitive *>(prim.get());
+        if (!gp) continue;
+        const Material *mtl = gp->GetMaterial();
+        if (dynamic_cast<const SubsurfaceMaterial *>(mtl) ||
+            dynamic_cast<const KdSubsurfaceMaterial *>(mtl))
+            subsurfacePrims[mtl].push_back(prim);
+    }
+    std::map<const Material *, std::shared_ptr<Primitive>> probeAccelerators;
+    for (auto &entry : subsurfacePrims)
+        probeAccelerators[entry.first] =
+            std::make_shared<BVHAccel>(std::move(entry.second));
+
     std::shared_ptr<Primitive> accelerator =
         MakeAccelerator(AcceleratorName, std::move(primitives), AcceleratorParams);
     if (!accelerator) accelerator = std::make_shared<BVHAccel>(primitives);
-    Scene *scene = new Scene(accelerator, lights);
+    Scene *scene = new Scene(accelerator, lights, std::move(probeAccelerators));
     // Erase primitives and lights from _RenderOptions_
     primitives.clear();
     lights.clear();
@@ -1704,6 +1875,27 @@ Integrator *RenderOptions::MakeIntegrator() const {
             "\"mlt\".", IntegratorName.c_str());
     }
 
+    // Enable adaptive sampling when a target error is specified
+    Float targetError = IntegratorParams.FindOneFloat("targeterror", 0);
+    int minAdaptiveSamples =
+        IntegratorParams.FindOneInt("minadaptivesamples", 16);
+    if (targetError > 0) {
+        SamplerIntegrator *si = dynamic_cast<SamplerIntegrator *>(integrator);
+        if (si)
+            si->SetAdaptiveSampling(targetError, minAdaptiveSamples);
+        else
+            Warning("\"targeterror\" is only supported by sampler-based "
+                    "integrators; ignoring.");
+    }
+    if (IntegratorParams.FindOneBool("denoisingaovs", false)) {
+        SamplerIntegrator *si = dynamic_cast<SamplerIntegrator *>(integrator);
+        if (si)
+            si->EnableDenoisingAOVs();
+        else
+            Warning("\"denoisingaovs\" is only supported by sampler-based "
+                    "integrators; ignoring.");
+    }
+
     IntegratorParams.ReportUnused();
     // Warn if no light sources are defined
     if (lights.empty())
@@ -36,6 +36,11 @@
 #include "interpolation.h"
 #include "parallel.h"
 #include "scene.h"
+#include "stringprint.h"
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <tuple>
 
 namespace pbrt {
 
@@ -174,6 +179,114 @@ void ComputeBeamDiffusionBSSRDF(Float g, Float eta, BSSRDFTable *t) {
     }, t->nRhoSamples);
 }
 
+// In-process cache of beam-diffusion tables: every SubsurfaceMaterial with
+// the same (g, eta, resolution) shares one table instead of re-running the
+// ParallelFor precomputation at startup.
+static std::mutex tableCacheMutex;
+static std::map<std::tuple<Float, Float, int, int>,
+                std::shared_ptr<BSSRDFTable>> tableCache;
+
+// On-disk table cache format: a small header identifying the layout and
+// parameters, followed by the raw table arrays.
+static const uint32_t bssrdfCacheMagic = 0x42535231;  // "BSR1"
+
+static bool LoadBSSRDFTableCache(const std::string &path, Float g, Float eta,
+                                 BSSRDFTable *t) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    uint32_t magic = 0, floatSize = 0;
+    int32_t nRho = 0, nRadius = 0;
+    Float gFile = 0, etaFile = 0;
+    int n = t->nRhoSamples, nr = t->nRadiusSamples;
+    bool ok = fread(&magic, sizeof(magic), 1, f) == 1 &&
+              magic == bssrdfCacheMagic &&
+              fread(&floatSize, sizeof(floatSize), 1, f) == 1 &&
+              floatSize == sizeof(Float) &&
+              fread(&nRho, sizeof(nRho), 1, f) == 1 && nRho == n &&
+              fread(&nRadius, sizeof(nRadius), 1, f) == 1 && nRadius == nr &&
+              fread(&gFile, sizeof(gFile), 1, f) == 1 && gFile == g &&
+              fread(&etaFile, sizeof(etaFile), 1, f) == 1 && etaFile == eta &&
+              fread(t->rhoSamples.get(), sizeof(Float), n, f) == (size_t)n &&
+              fread(t->radiusSamples.get(), sizeof(Float), nr, f) ==
+                  (size_t)nr &&
+              fread(t->profile.get(), sizeof(Float), n * nr, f) ==
+                  (size_t)(n * nr) &&
+              fread(t->rhoEff.get(), sizeof(Float), n, f) == (size_t)n &&
+              fread(t->profileCDF.get(), sizeof(Float), n * nr, f) ==
+                  (size_t)(n * nr);
+    fclose(f);
+    return ok;
+}
+
+static void WriteBSSRDFTableCache(const std::string &path, Float g, Float eta,
+                                  const BSSRDFTable *t) {
+    // Write to a per-thread temporary and rename so a concurrent or
+    // interrupted run never observes a partial file.
+    std::string tempPath = path + StringPrintf(".%d.tmp", ThreadIndex);
+    FILE *f = fopen(tempPath.c_str(), "wb");
+    if (!f) {
+        Warning("Unable to write BSSRDF table cache file \"%s\"",
+                tempPath.c_str());
+        return;
+    }
+    uint32_t floatSize = sizeof(Float);
+    int32_t nRho = t->nRhoSamples, nRadius = t->nRadiusSamples;
+    int n = t->nRhoSamples, nr = t->nRadiusSamples;
+    bool ok = fwrite(&bssrdfCacheMagic, sizeof(bssrdfCacheMagic), 1, f) == 1 &&
+              fwrite(&floatSize, sizeof(floatSize), 1, f) == 1 &&
+              fwrite(&nRho, sizeof(nRho), 1, f) == 1 &&
+              fwrite(&nRadius, sizeof(nRadius), 1, f) == 1 &&
+              fwrite(&g, sizeof(g), 1, f) == 1 &&
+              fwrite(&eta, sizeof(eta), 1, f) == 1 &&
+              fwrite(t->rhoSamples.get(), sizeof(Float), n, f) == (size_t)n &&
+              fwrite(t->radiusSamples.get(), sizeof(Float), nr, f) ==
+                  (size_t)nr &&
+              fwrite(t->profile.get(), sizeof(Float), n * nr, f) ==
+                  (size_t)(n * nr) &&
+              fwrite(t->rhoEff.get(), sizeof(Float), n, f) == (size_t)n &&
+              fwrite(t->profileCDF.get(), sizeof(Float), n * nr, f) ==
+                  (size_t)(n * nr);
+    if (fclose(f) != 0) ok = false;
+    if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+        Warning("Unable to write BSSRDF table cache file \"%s\"", path.c_str());
+        remove(tempPath.c_str());
+    }
+}
+
+std::shared_ptr<BSSRDFTable> GetBeamDiffusionBSSRDFTable(Float g, Float eta,
+                                                         int nRhoSamples,
+                                                         int nRadiusSamples) {
+    // Holding the mutex across the computation also keeps two materials
+    // created concurrently from both computing the same table.
+    std::lock_guard<std::mutex> lock(tableCacheMutex);
+    auto key = std::make_tuple(g, eta, nRhoSamples, nRadiusSamples);
+    auto iter = tableCache.find(key);
+    if (iter != tableCache.end()) return iter->second;
+
+    std::shared_ptr<BSSRDFTable> table =
+        std::make_shared<BSSRDFTable>(nRhoSamples, nRadiusSamples);
+    std::string path;
+    if (!PbrtOptions.texCacheDir.empty()) {
+        path = PbrtOptions.texCacheDir +
+               StringPrintf("/bssrdf_g%.9g_eta%.9g_%dx%d.tbl", g, eta,
+                            nRhoSamples, nRadiusSamples);
+        if (LoadBSSRDFTableCache(path, g, eta, table.get())) {
+            LOG(INFO) << "Loaded BSSRDF table from cache file " << path;
+            tableCache[key] = table;
+            return table;
+        }
+    }
+    ComputeBeamDiffusionBSSRDF(g, eta, table.get());
+    if (!path.empty()) WriteBSSRDFTableCache(path, g, eta, table.get());
+    tableCache[key] = table;
+    return table;
+}
+
+void ClearBSSRDFTableCache() {
+    std::lock_guard<std::mutex> lock(tableCacheMutex);
+    tableCache.clear();
+}
+
 void SubsurfaceFromDiffuse(const BSSRDFTable &t, const Spectrum &rhoEff,
                            const Spectrum &mfp, Spectrum *sigma_a,
                            Spectrum *sigma_s) {
@@ -201,11 +314,11 @@ Spectrum TabulatedBSSRDF::Sr(Float r) const {
         // Convert $r$ into unitless optical radius $r_{\roman{optical}}$
         Float rOptical = r * sigma_t[ch];
 
-        // Compute spline weights to interpolate BSSRDF on channel _ch_
-        int rhoOffset, radiusOffset;
-        Float rhoWeights[4], radiusWeights[4];
-        if (!CatmullRomWeights(table.nRhoSamples, table.rhoSamples.get(),
-                               rho[ch], &rhoOffset, rhoWeights) ||
+        // Interpolate using the constructor's cached albedo weights and
+        // this radius's spline weights
+        int radiusOffset;
+        Float radiusWeights[4];
+        if (!rhoValid[ch] ||
             !CatmullRomWeights(table.nRadiusSamples, table.radiusSamples.get(),
                                rOptical, &radiusOffset, radiusWeights))
             continue;
@@ -214,10 +327,11 @@ Spectrum TabulatedBSSRDF::Sr(Float r) const {
         Float sr = 0;
         for (int i = 0; i < 4; ++i) {
             for (int j = 0; j < 4; ++j) {
-                Float weight = rhoWeights[i] * radiusWeights[j];
+                Float weight = rhoWeights[ch][i] * radiusWeights[j];
                 if (weight != 0)
                     sr += weight *
-                          table.EvalProfile(rhoOffset + i, radiusOffset + j);
+                          table.EvalProfile(rhoOffset[ch] + i,
+                                            radiusOffset + j);
             }
         }
 
@@ -304,7 +418,10 @@ Spectrum SeparableBSSRDF::Sample_Sp(const Scene &scene, Float u1,
     int nFound = 0;
     while (true) {
         Ray r = base.SpawnRayTo(pTarget);
-        if (r.d == Vector3f(0, 0, 0) || !scene.Intersect(r, &ptr->si))
+        // Probe rays only accept hits on this material, so intersect
+        // against its local probe accelerator when the scene built one
+        if (r.d == Vector3f(0, 0, 0) ||
+            !scene.IntersectProbe(r, &ptr->si, this->material))
             break;
 
         base = ptr->si;
@@ -363,11 +480,11 @@ Float TabulatedBSSRDF::Pdf_Sr(int ch, Float r) const {
     // Convert $r$ into unitless optical radius $r_{\roman{optical}}$
     Float rOptical = r * sigma_t[ch];
 
-    // Compute spline weights to interpolate BSSRDF density on channel _ch_
-    int rhoOffset, radiusOffset;
-    Float rhoWeights[4], radiusWeights[4];
-    if (!CatmullRomWeights(table.nRhoSamples, table.rhoSamples.get(), rho[ch],
-                           &rhoOffset, rhoWeights) ||
+    // Interpolate the density using the constructor's cached albedo
+    // weights and this radius's spline weights
+    int radiusOffset;
+    Float radiusWeights[4];
+    if (!rhoValid[ch] ||
         !CatmullRomWeights(table.nRadiusSamples, table.radiusSamples.get(),
                            rOptical, &radiusOffset, radiusWeights))
         return 0.f;
@@ -375,12 +492,12 @@ Float TabulatedBSSRDF::Pdf_Sr(int ch, Float r) const {
     // Return BSSRDF profile density for channel _ch_
     Float sr = 0, rhoEff = 0;
     for (int i = 0; i < 4; ++i) {
-        if (rhoWeights[i] == 0) continue;
-        rhoEff += table.rhoEff[rhoOffset + i] * rhoWeights[i];
+        if (rhoWeights[ch][i] == 0) continue;
+        rhoEff += table.rhoEff[rhoOffset[ch] + i] * rhoWeights[ch][i];
         for (int j = 0; j < 4; ++j) {
             if (radiusWeights[j] == 0) continue;
-            sr += table.EvalProfile(rhoOffset + i, radiusOffset + j) *
-                  rhoWeights[i] * radiusWeights[j];
+            sr += table.EvalProfile(rhoOffset[ch] + i, radiusOffset + j) *
+                  rhoWeights[ch][i] * radiusWeights[j];
         }
     }
 
@@ -40,6 +40,7 @@
 
 // core/bssrdf.h*
 #include "interaction.h"
+#include "interpolation.h"
 #include "reflection.h"
 #include "stats.h"
 
@@ -114,6 +115,21 @@ class SeparableBSSRDF : public BSSRDF {
     const TransportMode mode;
 };
 
+struct BSSRDFTable {
+    // BSSRDFTable Public Data
+    const int nRhoSamples, nRadiusSamples;
+    std::unique_ptr<Float[]> rhoSamples, radiusSamples;
+    std::unique_ptr<Float[]> profile;
+    std::unique_ptr<Float[]> rhoEff;
+    std::unique_ptr<Float[]> profileCDF;
+
+    // BSSRDFTable Public Methods
+    BSSRDFTable(int nRhoSamples, int nRadiusSamples);
+    inline Float EvalProfile(int rhoIndex, int radiusIndex) const {
+        return profile[rhoIndex * nRadiusSamples + radiusIndex];
+    }
+};
+
 class TabulatedBSSRDF : public SeparableBSSRDF {
   public:
     // TabulatedBSSRDF Public Methods
@@ -124,6 +140,14 @@ class TabulatedBSSRDF : public SeparableBSSRDF {
         sigma_t = sigma_a + sigma_s;
         for (int c = 0; c < Spectrum::nSamples; ++c)
             rho[c] = sigma_t[c] != 0 ? (sigma_s[c] / sigma_t[c]) : 0;
+        // The albedo is fixed for this intersection, but every Sr() and
+        // Pdf_Sr() call the probe sampling makes was redoing the same
+        // binary search and spline weights over rhoSamples; compute them
+        // once per channel here.
+        for (int c = 0; c < Spectrum::nSamples; ++c)
+            rhoValid[c] =
+                CatmullRomWeights(table.nRhoSamples, table.rhoSamples.get(),
+                                  rho[c], &rhoOffset[c], rhoWeights[c]);
     }
     Spectrum Sr(Float distance) const;
     Float Pdf_Sr(int ch, Float distance) const;
@@ -133,21 +157,10 @@ class TabulatedBSSRDF : public SeparableBSSRDF {
     // TabulatedBSSRDF Private Data
     const BSSRDFTable &table;
     Spectrum sigma_t, rho;
-};
-
-struct BSSRDFTable {
-    // BSSRDFTable Public Data
-    const int nRhoSamples, nRadiusSamples;
-    std::unique_ptr<Float[]> rhoSamples, radiusSamples;
-    std::unique_ptr<Float[]> profile;
-    std::unique_ptr<Float[]> rhoEff;
-    std::unique_ptr<Float[]> profileCDF;
-
-    // BSSRDFTable Public Methods
-    BSSRDFTable(int nRhoSamples, int nRadiusSamples);
-    inline Float EvalProfile(int rhoIndex, int radiusIndex) const {
-        return profile[rhoIndex * nRadiusSamples + radiusIndex];
-    }
+    // Cached per-channel albedo spline setup; see the constructor
+    bool rhoValid[Spectrum::nSamples];
+    int rhoOffset[Spectrum::nSamples];
+    Float rhoWeights[Spectrum::nSamples][4];
 };
 
 class SeparableBSSRDFAdapter : public BxDF {
@@ -174,6 +187,14 @@ Float BeamDiffusionSS(Float sigma_s, Float sigma_a, Float g, Float eta,
 Float BeamDiffusionMS(Float sigma_s, Float sigma_a, Float g, Float eta,
                       Float r);
 void ComputeBeamDiffusionBSSRDF(Float g, Float eta, BSSRDFTable *t);
+// Return a shared beam-diffusion table for the given parameters, computing
+// it at most once per process for each distinct (g, eta, resolution) and,
+// when --texcachedir is set, round-tripping it through an on-disk cache so
+// repeated runs skip the precomputation entirely.
+std::shared_ptr<BSSRDFTable> GetBeamDiffusionBSSRDFTable(Float g, Float eta,
+                                                         int nRhoSamples,
+                                                         int nRadiusSamples);
+void ClearBSSRDFTableCache();
 void SubsurfaceFromDiffuse(const BSSRDFTable &table, const Spectrum &rhoEff,
                            const Spectrum &mfp, Spectrum *sigma_a,
                            Spectrum *sigma_s);
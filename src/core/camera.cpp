@@ -96,6 +96,13 @@ Float Camera::GenerateRayDifferential(const CameraSample &sample,
     return wt;
 }
 
+void Camera::GenerateRayDifferentialBatch(const CameraSample *samples,
+                                          int count, RayDifferential *rays,
+                                          Float *weights) const {
+    for (int i = 0; i < count; ++i)
+        weights[i] = GenerateRayDifferential(samples[i], &rays[i]);
+}
+
 Spectrum Camera::We(const Ray &ray, Point2f *raster) const {
     LOG(FATAL) << "Camera::We() is not implemented!";
     return Spectrum(0.f);
@@ -56,6 +56,15 @@ class Camera {
     virtual Float GenerateRay(const CameraSample &sample, Ray *ray) const = 0;
     virtual Float GenerateRayDifferential(const CameraSample &sample,
                                           RayDifferential *rd) const;
+    // Generate camera rays for a whole batch of samples at once, storing
+    // each ray's contribution weight in weights[i]. The default
+    // implementation just loops over GenerateRayDifferential(); cameras
+    // whose per-ray setup is largely invariant across a batch (e.g.
+    // PerspectiveCamera) override it to hoist that work out of the loop.
+    virtual void GenerateRayDifferentialBatch(const CameraSample *samples,
+                                              int count,
+                                              RayDifferential *rays,
+                                              Float *weights) const;
     virtual Spectrum We(const Ray &ray, Point2f *pRaster2 = nullptr) const;
     virtual void Pdf_We(const Ray &ray, Float *pdfPos, Float *pdfDir) const;
     virtual Spectrum Sample_Wi(const Interaction &ref, const Point2f &u,
@@ -0,0 +1,126 @@
+
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+// core/chunkedio.cpp*
+#include "chunkedio.h"
+#include "parallel.h"
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+
+namespace pbrt {
+
+// Chunk framing: magic, per-chunk raw size, compressed size, and CRC of
+// the compressed bytes. One-megabyte chunks compress independently, which
+// both parallelizes the codec and bounds what a single bad frame costs.
+static PBRT_CONSTEXPR uint32_t chunkMagic = 0x50424348;  // "PBCH"
+static PBRT_CONSTEXPR size_t chunkSize = 1 << 20;
+
+struct ChunkFrame {
+    uint32_t magic;
+    uint32_t rawSize;
+    uint32_t compressedSize;
+    uint32_t crc;
+};
+
+bool WriteCompressedChunks(FILE *f, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data;
+    size_t nChunks = (size + chunkSize - 1) / chunkSize;
+    if (nChunks == 0) return true;
+
+    // Compress all chunks in parallel, then write frames sequentially
+    std::vector<std::vector<unsigned char>> compressed(nChunks);
+    std::vector<char> failed(nChunks, 0);
+    ParallelFor(
+        [&](int64_t i) {
+            size_t rawSize =
+                std::min(chunkSize, size - (size_t)i * chunkSize);
+            uLongf destLen = compressBound(rawSize);
+            compressed[i].resize(destLen);
+            if (compress2(compressed[i].data(), &destLen,
+                          p + (size_t)i * chunkSize, rawSize,
+                          Z_BEST_SPEED) != Z_OK)
+                failed[i] = 1;
+            else
+                compressed[i].resize(destLen);
+        },
+        nChunks, 1);
+
+    for (size_t i = 0; i < nChunks; ++i) {
+        if (failed[i]) return false;
+        ChunkFrame frame;
+        frame.magic = chunkMagic;
+        frame.rawSize =
+            (uint32_t)std::min(chunkSize, size - (size_t)i * chunkSize);
+        frame.compressedSize = (uint32_t)compressed[i].size();
+        frame.crc = (uint32_t)crc32(
+            crc32(0L, Z_NULL, 0), compressed[i].data(), compressed[i].size());
+        if (fwrite(&frame, sizeof(frame), 1, f) != 1 ||
+            fwrite(compressed[i].data(), 1, compressed[i].size(), f) !=
+                compressed[i].size())
+            return false;
+    }
+    return true;
+}
+
+bool ReadCompressedChunks(FILE *f, void *data, size_t size) {
+    unsigned char *p = (unsigned char *)data;
+    size_t remaining = size;
+    std::vector<unsigned char> compressed;
+    while (remaining > 0) {
+        ChunkFrame frame;
+        if (fread(&frame, sizeof(frame), 1, f) != 1 ||
+            frame.magic != chunkMagic || frame.rawSize == 0 ||
+            frame.rawSize > remaining || frame.compressedSize == 0)
+            return false;
+        compressed.resize(frame.compressedSize);
+        if (fread(compressed.data(), 1, frame.compressedSize, f) !=
+            frame.compressedSize)
+            return false;
+        // A per-chunk CRC mismatch pinpoints a partial or corrupted write
+        // without decompressing anything else
+        if ((uint32_t)crc32(crc32(0L, Z_NULL, 0), compressed.data(),
+                            frame.compressedSize) != frame.crc)
+            return false;
+        uLongf destLen = frame.rawSize;
+        if (uncompress(p, &destLen, compressed.data(),
+                       frame.compressedSize) != Z_OK ||
+            destLen != frame.rawSize)
+            return false;
+        p += frame.rawSize;
+        remaining -= frame.rawSize;
+    }
+    return true;
+}
+
+}  // namespace pbrt
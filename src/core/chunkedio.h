@@ -0,0 +1,61 @@
+
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_CORE_CHUNKEDIO_H
+#define PBRT_CORE_CHUNKEDIO_H
+
+// core/chunkedio.h*
+#include "pbrt.h"
+#include <cstdio>
+
+namespace pbrt {
+
+// Framed, chunk-compressed container for binary cache payloads, aimed at
+// the NFS-resident caches where bandwidth rather than CPU is the limit.
+// The payload is split into fixed-size chunks compressed in parallel with
+// the vendored zlib codec; each frame carries raw size, compressed size,
+// and a CRC of the compressed bytes, so a partial or corrupted farm write
+// is detected from the damaged chunk alone rather than by decompressing
+// the whole payload. Both calls sit after the caller's own header and
+// return false on any error; readers must know the raw payload size from
+// that header.
+bool WriteCompressedChunks(FILE *f, const void *data, size_t size);
+bool ReadCompressedChunks(FILE *f, void *data, size_t size);
+
+}  // namespace pbrt
+
+#endif  // PBRT_CORE_CHUNKEDIO_H
@@ -36,13 +36,66 @@
 #include <cstdlib>
 #include <climits>
 #ifndef PBRT_IS_WINDOWS
+#include <fcntl.h>
 #include <libgen.h>
+#include <unistd.h>
 #endif
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace pbrt {
 
 static std::string searchDirectory;
 
+#ifndef PBRT_IS_WINDOWS
+// Background I/O pool for PrefetchFileAsync(): a few detached threads that
+// pull filenames off a queue and stream each file through a throwaway
+// buffer, pulling its pages into the OS cache ahead of the real read.
+static std::mutex prefetchMutex;
+static std::condition_variable prefetchCondition;
+static std::vector<std::string> prefetchQueue;
+static int nPrefetchThreads = 0;
+static const int maxPrefetchThreads = 4;
+
+static void PrefetchThreadFunc() {
+    for (;;) {
+        std::string filename;
+        {
+            std::unique_lock<std::mutex> lock(prefetchMutex);
+            while (prefetchQueue.empty()) prefetchCondition.wait(lock);
+            filename = prefetchQueue.back();
+            prefetchQueue.pop_back();
+        }
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) continue;
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+        char buf[1 << 16];
+        while (read(fd, buf, sizeof(buf)) > 0)
+            ;
+        close(fd);
+    }
+}
+#endif  // !PBRT_IS_WINDOWS
+
+void PrefetchFileAsync(const std::string &filename) {
+#ifndef PBRT_IS_WINDOWS
+    std::lock_guard<std::mutex> lock(prefetchMutex);
+    prefetchQueue.push_back(filename);
+    // Lazily spin up the pool; the threads are detached and block on the
+    // queue when idle, so they cost nothing between bursts.
+    if (nPrefetchThreads < maxPrefetchThreads &&
+        (int)prefetchQueue.size() > nPrefetchThreads) {
+        ++nPrefetchThreads;
+        std::thread(PrefetchThreadFunc).detach();
+    }
+    prefetchCondition.notify_one();
+#endif
+}
+
 #ifdef PBRT_IS_WINDOWS
 bool IsAbsolutePath(const std::string &filename) {
     if (filename.empty()) return false;
@@ -53,6 +53,13 @@ std::string ResolveFilename(const std::string &filename);
 std::string DirectoryContaining(const std::string &filename);
 void SetSearchDirectory(const std::string &dirname);
 
+// Queue the file to be read into the OS page cache by a small background
+// I/O pool, so that when the renderer gets around to decoding it the bytes
+// are already local. Useful for network filesystems where loads are
+// latency-bound; a no-op on platforms without POSIX I/O. Best-effort only -
+// errors are ignored, since the real read will report them.
+void PrefetchFileAsync(const std::string &filename);
+
 inline bool HasExtension(const std::string &value, const std::string &ending) {
     if (ending.size() > value.size()) return false;
     return std::equal(
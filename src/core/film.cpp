@@ -33,6 +33,7 @@
 
 // core/film.cpp*
 #include "film.h"
+#include "chunkedio.h"
 #include "paramset.h"
 #include "imageio.h"
 #include "stats.h"
@@ -44,11 +45,14 @@ STAT_MEMORY_COUNTER("Memory/Film pixels", filmPixelMemory);
 // Film Method Definitions
 Film::Film(const Point2i &resolution, const Bounds2f &cropWindow,
            std::unique_ptr<Filter> filt, Float diagonal,
-           const std::string &filename, Float scale, Float maxSampleLuminance)
+           const std::string &filename, Float scale, Float maxSampleLuminance,
+           bool traversalHeatmap, bool filterImportance)
     : fullResolution(resolution),
       diagonal(diagonal * .001),
       filter(std::move(filt)),
       filename(filename),
+      traversalHeatmap(traversalHeatmap),
+      filterImportance(filterImportance),
       scale(scale),
       maxSampleLuminance(maxSampleLuminance) {
     // Compute film image bounds
@@ -64,6 +68,11 @@ Film::Film(const Point2i &resolution, const Bounds2f &cropWindow,
     // Allocate film image storage
     pixels = std::unique_ptr<Pixel[]>(new Pixel[croppedPixelBounds.Area()]);
     filmPixelMemory += croppedPixelBounds.Area() * sizeof(Pixel);
+    if (traversalHeatmap) {
+        traversalPixels = std::unique_ptr<TraversalPixel[]>(
+            new TraversalPixel[croppedPixelBounds.Area()]);
+        filmPixelMemory += croppedPixelBounds.Area() * sizeof(TraversalPixel);
+    }
 
     // Precompute filter weight table
     int offset = 0;
@@ -102,16 +111,18 @@ std::unique_ptr<FilmTile> Film::GetFilmTile(const Bounds2i &sampleBounds) {
     Bounds2i tilePixelBounds = Intersect(Bounds2i(p0, p1), croppedPixelBounds);
     return std::unique_ptr<FilmTile>(new FilmTile(
         tilePixelBounds, filter->radius, filterTable, filterTableWidth,
-        maxSampleLuminance));
+        maxSampleLuminance, filterImportance, (int)aovNames.size()));
 }
 
 void Film::Clear() {
     for (Point2i p : croppedPixelBounds) {
         Pixel &pixel = GetPixel(p);
-        for (int c = 0; c < 3; ++c)
-            pixel.splatXYZ[c] = pixel.xyz[c] = 0;
+        for (int c = 0; c < 3; ++c) pixel.xyz[c] = 0;
         pixel.filterWeightSum = 0;
     }
+    AtomicFloat *splat = splatXYZ.load(std::memory_order_acquire);
+    if (splat)
+        for (int i = 0; i < 3 * croppedPixelBounds.Area(); ++i) splat[i] = 0;
 }
 
 void Film::MergeFilmTile(std::unique_ptr<FilmTile> tile) {
@@ -127,6 +138,30 @@ void Film::MergeFilmTile(std::unique_ptr<FilmTile> tile) {
         for (int i = 0; i < 3; ++i) mergePixel.xyz[i] += xyz[i];
         mergePixel.filterWeightSum += tilePixel.filterWeightSum;
     }
+    // Merge the tile's AOV accumulators
+    int tileWidth = tile->pixelBounds.pMax.x - tile->pixelBounds.pMin.x;
+    for (size_t aov = 0; aov < aovNames.size(); ++aov) {
+        for (Point2i pixel : tile->GetPixelBounds()) {
+            int tileOffset = (pixel.x - tile->pixelBounds.pMin.x) +
+                             (pixel.y - tile->pixelBounds.pMin.y) * tileWidth;
+            const FilmTile::AOVTilePixel &tp =
+                tile->aovPixels[aov * tile->pixelBounds.Area() + tileOffset];
+            AOVPixel &fp = aovPixels[aov][PixelOffset(pixel)];
+            for (int i = 0; i < 3; ++i) fp.v[i] += tp.v[i];
+            fp.weight += tp.weight;
+        }
+    }
+}
+
+int Film::RegisterAOV(const std::string &name, bool momentsToVariance) {
+    for (size_t i = 0; i < aovNames.size(); ++i)
+        if (aovNames[i] == name) return i;
+    aovNames.push_back(name);
+    aovPixels.push_back(std::unique_ptr<AOVPixel[]>(
+        new AOVPixel[croppedPixelBounds.Area()]));
+    aovMomentsToVariance.push_back(momentsToVariance ? 1 : 0);
+    filmPixelMemory += croppedPixelBounds.Area() * sizeof(AOVPixel);
+    return aovNames.size() - 1;
 }
 
 void Film::SetImage(const Spectrum *img) const {
@@ -135,22 +170,28 @@ void Film::SetImage(const Spectrum *img) const {
         Pixel &p = pixels[i];
         img[i].ToXYZ(p.xyz);
         p.filterWeightSum = 1;
-        p.splatXYZ[0] = p.splatXYZ[1] = p.splatXYZ[2] = 0;
     }
+    AtomicFloat *splat = splatXYZ.load(std::memory_order_acquire);
+    if (splat)
+        for (int i = 0; i < 3 * nPixels; ++i) splat[i] = 0;
 }
 
 void Film::AddSplat(const Point2f &p, Spectrum v) {
     ProfilePhase pp(Prof::SplatFilm);
 
+    // Evaluate the luminance once and reuse it for validation and
+    // clamping; for SampledSpectrum builds each y() call is a full dot
+    // product against the CIE Y curve.
+    Float lum = v.y();
     if (v.HasNaNs()) {
         LOG(ERROR) << StringPrintf("Ignoring splatted spectrum with NaN values "
                                    "at (%f, %f)", p.x, p.y);
         return;
-    } else if (v.y() < 0.) {
+    } else if (lum < 0.) {
         LOG(ERROR) << StringPrintf("Ignoring splatted spectrum with negative "
-                                   "luminance %f at (%f, %f)", v.y(), p.x, p.y);
+                                   "luminance %f at (%f, %f)", lum, p.x, p.y);
         return;
-    } else if (std::isinf(v.y())) {
+    } else if (std::isinf(lum)) {
         LOG(ERROR) << StringPrintf("Ignoring splatted spectrum with infinite "
                                    "luminance at (%f, %f)", p.x, p.y);
         return;
@@ -158,27 +199,197 @@ void Film::AddSplat(const Point2f &p, Spectrum v) {
 
     Point2i pi = Point2i(Floor(p));
     if (!InsideExclusive(pi, croppedPixelBounds)) return;
-    if (v.y() > maxSampleLuminance)
-        v *= maxSampleLuminance / v.y();
+    if (lum > maxSampleLuminance)
+        v *= maxSampleLuminance / lum;
     Float xyz[3];
     v.ToXYZ(xyz);
-    Pixel &pixel = GetPixel(pi);
-    for (int i = 0; i < 3; ++i) pixel.splatXYZ[i].Add(xyz[i]);
+    AtomicFloat *splat = GetSplatPixel(PixelOffset(pi));
+    for (int i = 0; i < 3; ++i) splat[i].Add(xyz[i]);
 }
 
-void Film::WriteImage(Float splatScale) {
-    // Convert image to RGB and compute final pixel values
-    LOG(INFO) <<
-        "Converting image to RGB and computing final weighted pixel values";
-    std::unique_ptr<Float[]> rgb(new Float[3 * croppedPixelBounds.Area()]);
-    int offset = 0;
-    for (Point2i p : croppedPixelBounds) {
+// SplatBuffer Method Definitions
+void SplatBuffer::AddSplat(const Point2f &p, Spectrum v) {
+    // Validate and clamp the contribution exactly as Film::AddSplat() does
+    Float lum = v.y();
+    if (v.HasNaNs()) {
+        LOG(ERROR) << StringPrintf("Ignoring splatted spectrum with NaN values "
+                                   "at (%f, %f)", p.x, p.y);
+        return;
+    } else if (lum < 0.) {
+        LOG(ERROR) << StringPrintf("Ignoring splatted spectrum with negative "
+                                   "luminance %f at (%f, %f)", lum, p.x, p.y);
+        return;
+    } else if (std::isinf(lum)) {
+        LOG(ERROR) << StringPrintf("Ignoring splatted spectrum with infinite "
+                                   "luminance at (%f, %f)", p.x, p.y);
+        return;
+    }
+    Point2i pi = Point2i(Floor(p));
+    if (!InsideExclusive(pi, film->croppedPixelBounds)) return;
+    if (lum > film->maxSampleLuminance)
+        v *= film->maxSampleLuminance / lum;
+    Float xyz[3];
+    v.ToXYZ(xyz);
+    int width = film->croppedPixelBounds.pMax.x -
+                film->croppedPixelBounds.pMin.x;
+    int offset = (pi.x - film->croppedPixelBounds.pMin.x) +
+                 (pi.y - film->croppedPixelBounds.pMin.y) * width;
+    std::array<Float, 3> &sum = sums[offset];
+    for (int i = 0; i < 3; ++i) sum[i] += xyz[i];
+    if (++nPending >= flushInterval) Flush();
+}
+
+void SplatBuffer::Flush() {
+    for (const auto &entry : sums) {
+        AtomicFloat *splat = film->GetSplatPixel(entry.first);
+        for (int i = 0; i < 3; ++i) splat[i].Add(entry.second[i]);
+    }
+    sums.clear();
+    nPending = 0;
+}
+
+// Render checkpoint format: header, then seven Floats per pixel (XYZ sum,
+// filter weight sum, splat XYZ).
+struct FilmCheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t floatSize;
+    int32_t bounds[4];
+    int64_t samplesCompleted;
+};
+static const char filmCheckpointMagic[8] = {'P', 'B', 'R', 'T',
+                                            'C', 'K', 'P', '\0'};
+PBRT_CONSTEXPR uint32_t filmCheckpointVersion = 2;
+
+void Film::WriteCheckpoint(const std::string &path,
+                           int64_t samplesCompleted) const {
+    // Write to a temporary file and rename it into place so a crash during
+    // the write never destroys the previous checkpoint
+    std::string tmpPath = path + ".tmp";
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        Warning("Unable to write checkpoint file \"%s\".", tmpPath.c_str());
+        return;
+    }
+    FilmCheckpointHeader header = {};
+    memcpy(header.magic, filmCheckpointMagic, sizeof(filmCheckpointMagic));
+    header.version = filmCheckpointVersion;
+    header.floatSize = sizeof(Float);
+    header.bounds[0] = croppedPixelBounds.pMin.x;
+    header.bounds[1] = croppedPixelBounds.pMin.y;
+    header.bounds[2] = croppedPixelBounds.pMax.x;
+    header.bounds[3] = croppedPixelBounds.pMax.y;
+    header.samplesCompleted = samplesCompleted;
+    std::vector<Float> buf;
+    SnapshotPixels(&buf);
+    // The pixel payload goes through the chunk-compressed container:
+    // checkpoints of big frames live on NFS, where the compression trades
+    // idle CPU for the bandwidth that is actually scarce, and the
+    // per-chunk CRCs catch partial farm writes on load.
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              WriteCompressedChunks(f, &buf[0],
+                                    buf.size() * sizeof(Float));
+    if (fclose(f) != 0) ok = false;
+    if (ok && rename(tmpPath.c_str(), path.c_str()) != 0) ok = false;
+    if (!ok) {
+        Warning("Error writing checkpoint file \"%s\".", path.c_str());
+        remove(tmpPath.c_str());
+    } else
+        LOG(INFO) << "Wrote render checkpoint " << path << " after " <<
+            samplesCompleted << " samples per pixel";
+}
+
+bool Film::LoadCheckpoint(const std::string &path, int64_t *samplesCompleted) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    FilmCheckpointHeader header;
+    bool ok =
+        fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, filmCheckpointMagic,
+               sizeof(filmCheckpointMagic)) == 0 &&
+        header.version == filmCheckpointVersion &&
+        header.floatSize == sizeof(Float) &&
+        header.bounds[0] == croppedPixelBounds.pMin.x &&
+        header.bounds[1] == croppedPixelBounds.pMin.y &&
+        header.bounds[2] == croppedPixelBounds.pMax.x &&
+        header.bounds[3] == croppedPixelBounds.pMax.y &&
+        header.samplesCompleted >= 0;
+    if (ok) {
+        std::vector<Float> buf(7 * croppedPixelBounds.Area());
+        ok = ReadCompressedChunks(f, &buf[0], buf.size() * sizeof(Float));
+        if (ok) {
+            for (int i = 0; i < croppedPixelBounds.Area(); ++i) {
+                Pixel &p = pixels[i];
+                const Float *b = &buf[7 * i];
+                p.xyz[0] = b[0];
+                p.xyz[1] = b[1];
+                p.xyz[2] = b[2];
+                p.filterWeightSum = b[3];
+                if (b[4] != 0 || b[5] != 0 || b[6] != 0) {
+                    AtomicFloat *splat = GetSplatPixel(i);
+                    splat[0] = b[4];
+                    splat[1] = b[5];
+                    splat[2] = b[6];
+                }
+            }
+            *samplesCompleted = header.samplesCompleted;
+        }
+    }
+    if (!ok)
+        Warning("Ignoring invalid or mismatched checkpoint file \"%s\".",
+                path.c_str());
+    fclose(f);
+    return ok;
+}
+
+void Film::AddTraversalSample(const Point2f &pFilm, Float nodesVisited,
+                              Float primTests) {
+    CHECK(traversalHeatmap);
+    Point2i pi = Point2i(Floor(pFilm));
+    if (!InsideExclusive(pi, croppedPixelBounds)) return;
+    int width = croppedPixelBounds.pMax.x - croppedPixelBounds.pMin.x;
+    int offset = (pi.x - croppedPixelBounds.pMin.x) +
+                 (pi.y - croppedPixelBounds.pMin.y) * width;
+    traversalPixels[offset].nodesVisited.Add(nodesVisited);
+    traversalPixels[offset].primTests.Add(primTests);
+    traversalPixels[offset].nSamples.Add(1);
+}
+
+// Copy the pixel accumulators into a flat buffer of seven Floats per pixel
+// (XYZ sum, filter weight sum, splat XYZ); shared by checkpointing and the
+// asynchronous in-progress writes.
+void Film::SnapshotPixels(std::vector<Float> *buf) const {
+    buf->resize(7 * croppedPixelBounds.Area());
+    const AtomicFloat *splat = splatXYZ.load(std::memory_order_acquire);
+    for (int i = 0; i < croppedPixelBounds.Area(); ++i) {
+        const Pixel &p = pixels[i];
+        Float *b = &(*buf)[7 * i];
+        b[0] = p.xyz[0];
+        b[1] = p.xyz[1];
+        b[2] = p.xyz[2];
+        b[3] = p.filterWeightSum;
+        // Splat storage is allocated lazily; absent means all zero
+        if (splat) {
+            b[4] = splat[3 * i];
+            b[5] = splat[3 * i + 1];
+            b[6] = splat[3 * i + 2];
+        } else
+            b[4] = b[5] = b[6] = 0;
+    }
+}
+
+// Convert a pixel snapshot to the final RGB values, applying filter weight
+// normalization, splats, and the output scale
+void Film::SnapshotToRGB(const std::vector<Float> &buf, Float splatScale,
+                         Float *rgb) const {
+    for (int offset = 0; offset < croppedPixelBounds.Area(); ++offset) {
+        const Float *b = &buf[7 * offset];
         // Convert pixel XYZ color to RGB
-        Pixel &pixel = GetPixel(p);
-        XYZToRGB(pixel.xyz, &rgb[3 * offset]);
+        Float xyz[3] = {b[0], b[1], b[2]};
+        XYZToRGB(xyz, &rgb[3 * offset]);
 
         // Normalize pixel with weight sum
-        Float filterWeightSum = pixel.filterWeightSum;
+        Float filterWeightSum = b[3];
         if (filterWeightSum != 0) {
             Float invWt = (Float)1 / filterWeightSum;
             rgb[3 * offset] = std::max((Float)0, rgb[3 * offset] * invWt);
@@ -190,8 +401,7 @@ void Film::WriteImage(Float splatScale) {
 
         // Add splat value at pixel
         Float splatRGB[3];
-        Float splatXYZ[3] = {pixel.splatXYZ[0], pixel.splatXYZ[1],
-                             pixel.splatXYZ[2]};
+        Float splatXYZ[3] = {b[4], b[5], b[6]};
         XYZToRGB(splatXYZ, splatRGB);
         rgb[3 * offset] += splatScale * splatRGB[0];
         rgb[3 * offset + 1] += splatScale * splatRGB[1];
@@ -201,13 +411,143 @@ void Film::WriteImage(Float splatScale) {
         rgb[3 * offset] *= scale;
         rgb[3 * offset + 1] *= scale;
         rgb[3 * offset + 2] *= scale;
-        ++offset;
+    }
+}
+
+void Film::StartAsyncWrite(int intervalSeconds, Float splatScale) {
+    if (asyncWriteThread.joinable()) return;
+    asyncWriteShutdown = false;
+    asyncWriteThread = std::thread([this, intervalSeconds, splatScale]() {
+        while (!asyncWriteShutdown) {
+            // Sleep in small increments so shutdown stays responsive
+            for (int i = 0; i < 4 * intervalSeconds; ++i) {
+                if (asyncWriteShutdown) return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            }
+            // Snapshot the accumulators while holding the tile-merge mutex
+            // only for the copy; conversion and I/O run unlocked
+            std::vector<Float> buf;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                SnapshotPixels(&buf);
+            }
+            std::unique_ptr<Float[]> rgb(
+                new Float[3 * croppedPixelBounds.Area()]);
+            SnapshotToRGB(buf, splatScale, &rgb[0]);
+            pbrt::WriteImage(filename, &rgb[0], croppedPixelBounds,
+                             fullResolution);
+        }
+    });
+}
+
+void Film::StopAsyncWrite() {
+    if (!asyncWriteThread.joinable()) return;
+    asyncWriteShutdown = true;
+    asyncWriteThread.join();
+}
+
+void Film::WriteImage(Float splatScale) {
+    // Make sure an in-progress writer isn't racing the final image
+    StopAsyncWrite();
+
+    // Convert image to RGB and compute final pixel values
+    LOG(INFO) <<
+        "Converting image to RGB and computing final weighted pixel values";
+    std::vector<Float> buf;
+    SnapshotPixels(&buf);
+    std::unique_ptr<Float[]> rgb(new Float[3 * croppedPixelBounds.Area()]);
+    SnapshotToRGB(buf, splatScale, &rgb[0]);
+
+    // Composite the rendered region into an existing full frame, if one
+    // was given; otherwise write the (possibly partial) image directly
+    bool composited = false;
+    if (!PbrtOptions.compositeFile.empty()) {
+        Point2i res;
+        std::unique_ptr<RGBSpectrum[]> base =
+            ReadImage(PbrtOptions.compositeFile, &res);
+        if (base && res == fullResolution) {
+            std::unique_ptr<Float[]> full(new Float[3 * res.x * res.y]);
+            for (int i = 0; i < res.x * res.y; ++i)
+                base[i].ToRGB(&full[3 * i]);
+            int offset = 0;
+            for (Point2i p : croppedPixelBounds) {
+                int fi = p.x + p.y * res.x;
+                for (int c = 0; c < 3; ++c)
+                    full[3 * fi + c] = rgb[3 * offset + c];
+                ++offset;
+            }
+            LOG(INFO) << "Writing image " << filename <<
+                " composited over " << PbrtOptions.compositeFile;
+            pbrt::WriteImage(filename, &full[0],
+                             Bounds2i(Point2i(0, 0), res), res);
+            composited = true;
+        } else
+            Warning(
+                "Unable to read \"%s\" or resolution doesn't match; "
+                "writing region only.",
+                PbrtOptions.compositeFile.c_str());
     }
 
     // Write RGB image
-    LOG(INFO) << "Writing image " << filename << " with bounds " <<
-        croppedPixelBounds;
-    pbrt::WriteImage(filename, &rgb[0], croppedPixelBounds, fullResolution);
+    if (!composited) {
+        LOG(INFO) << "Writing image " << filename << " with bounds " <<
+            croppedPixelBounds;
+        pbrt::WriteImage(filename, &rgb[0], croppedPixelBounds,
+                         fullResolution);
+    }
+
+    // Write each registered AOV buffer alongside the main image
+    for (size_t aov = 0; aov < aovNames.size(); ++aov) {
+        std::unique_ptr<Float[]> aovRGB(
+            new Float[3 * croppedPixelBounds.Area()]);
+        for (int i = 0; i < croppedPixelBounds.Area(); ++i) {
+            const AOVPixel &p = aovPixels[aov][i];
+            Float invWt = p.weight > 0 ? 1 / p.weight : 0;
+            if (aovMomentsToVariance[aov]) {
+                // Channels carry the first two sample moments; emit the
+                // per-pixel sample variance
+                Float mean = p.v[0] * invWt;
+                Float meanSq = p.v[1] * invWt;
+                Float variance = std::max((Float)0, meanSq - mean * mean);
+                for (int c = 0; c < 3; ++c) aovRGB[3 * i + c] = variance;
+            } else
+                for (int c = 0; c < 3; ++c)
+                    aovRGB[3 * i + c] = p.v[c] * invWt;
+        }
+        std::string aovFilename = filename;
+        size_t dot = aovFilename.find_last_of('.');
+        std::string suffix = "_" + aovNames[aov];
+        if (dot == std::string::npos)
+            aovFilename += suffix;
+        else
+            aovFilename.insert(dot, suffix);
+        LOG(INFO) << "Writing AOV " << aovNames[aov] << " to " << aovFilename;
+        pbrt::WriteImage(aovFilename, &aovRGB[0], croppedPixelBounds,
+                         fullResolution);
+    }
+
+    // Write traversal heatmap AOV alongside the main image
+    if (traversalHeatmap) {
+        std::unique_ptr<Float[]> heat(new Float[3 * croppedPixelBounds.Area()]);
+        for (int i = 0; i < croppedPixelBounds.Area(); ++i) {
+            // Store per-sample averages: R = nodes visited, G = primitive
+            // intersection tests
+            Float n = traversalPixels[i].nSamples;
+            Float inv = n > 0 ? 1 / n : 0;
+            heat[3 * i] = traversalPixels[i].nodesVisited * inv;
+            heat[3 * i + 1] = traversalPixels[i].primTests * inv;
+            heat[3 * i + 2] = 0;
+        }
+        std::string heatmapFilename = filename;
+        size_t dot = heatmapFilename.find_last_of('.');
+        if (dot == std::string::npos)
+            heatmapFilename += "_heatmap";
+        else
+            heatmapFilename.insert(dot, "_heatmap");
+        LOG(INFO) << "Writing traversal heatmap " << heatmapFilename;
+        pbrt::WriteImage(heatmapFilename, &heat[0], croppedPixelBounds,
+                         fullResolution);
+    }
 }
 
 Film *CreateFilm(const ParamSet &params, std::unique_ptr<Filter> filter) {
@@ -242,13 +582,33 @@ Film *CreateFilm(const ParamSet &params, std::unique_ptr<Filter> filter) {
                                 Clamp(PbrtOptions.cropWindow[1][0], 0, 1)),
                         Point2f(Clamp(PbrtOptions.cropWindow[0][1], 0, 1),
                                 Clamp(PbrtOptions.cropWindow[1][1], 0, 1)));
+    if (PbrtOptions.haveRenderRegion) {
+        // A pixel-space region from the command line overrides the crop
+        const int *r = PbrtOptions.renderRegion;
+        crop.pMin.x = Clamp(Float(r[0]) / xres, 0.f, 1.f);
+        crop.pMax.x = Clamp(Float(r[1]) / xres, 0.f, 1.f);
+        crop.pMin.y = Clamp(Float(r[2]) / yres, 0.f, 1.f);
+        crop.pMax.y = Clamp(Float(r[3]) / yres, 0.f, 1.f);
+    }
 
     Float scale = params.FindOneFloat("scale", 1.);
     Float diagonal = params.FindOneFloat("diagonal", 35.);
     Float maxSampleLuminance = params.FindOneFloat("maxsampleluminance",
                                                    Infinity);
+    bool traversalHeatmap = params.FindOneBool("traversalheatmap", false);
+    bool filterImportance = params.FindOneBool("filterimportance", false);
+    if (filterImportance) {
+        Point2f testOffset;
+        if (!filter->SampleOffset(Point2f(.5f, .5f), &testOffset)) {
+            Warning(
+                "\"filterimportance\" isn't supported for filters with "
+                "negative lobes; ignoring.");
+            filterImportance = false;
+        }
+    }
     return new Film(Point2i(xres, yres), crop, std::move(filter), diagonal,
-                    filename, scale, maxSampleLuminance);
+                    filename, scale, maxSampleLuminance, traversalHeatmap,
+                    filterImportance);
 }
 
 }  // namespace pbrt
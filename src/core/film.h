@@ -45,6 +45,11 @@
 #include "filter.h"
 #include "stats.h"
 #include "parallel.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace pbrt {
 
@@ -61,14 +66,47 @@ class Film {
     Film(const Point2i &resolution, const Bounds2f &cropWindow,
          std::unique_ptr<Filter> filter, Float diagonal,
          const std::string &filename, Float scale,
-         Float maxSampleLuminance = Infinity);
+         Float maxSampleLuminance = Infinity,
+         bool traversalHeatmap = false, bool filterImportance = false);
+    ~Film() { StopAsyncWrite(); }
+    // With filter importance sampling enabled, remap a conventionally
+    // jittered film position to a filter-distributed offset around the
+    // pixel center; each sample then lands in exactly one pixel with unit
+    // weight instead of being splatted across the filter support.
+    Point2f RemapToFilterSample(const Point2i &pixel,
+                                const Point2f &pFilm) const {
+        if (!filterImportance) return pFilm;
+        Point2f u(pFilm.x - pixel.x, pFilm.y - pixel.y);
+        Point2f offset;
+        if (!filter->SampleOffset(u, &offset)) return pFilm;
+        return Point2f(pixel.x + .5f + offset.x, pixel.y + .5f + offset.y);
+    }
     Bounds2i GetSampleBounds() const;
     Bounds2f GetPhysicalExtent() const;
     std::unique_ptr<FilmTile> GetFilmTile(const Bounds2i &sampleBounds);
     void MergeFilmTile(std::unique_ptr<FilmTile> tile);
     void SetImage(const Spectrum *img) const;
     void AddSplat(const Point2f &p, Spectrum v);
+    void AddTraversalSample(const Point2f &pFilm, Float nodesVisited,
+                            Float primTests);
     void WriteImage(Float splatScale = 1);
+    void WriteCheckpoint(const std::string &path,
+                         int64_t samplesCompleted) const;
+    bool LoadCheckpoint(const std::string &path, int64_t *samplesCompleted);
+    // Background thread that periodically snapshots the pixel accumulators
+    // (briefly holding the tile-merge mutex) and writes the in-progress
+    // image off-thread so renders can be watched without stalling workers.
+    void StartAsyncWrite(int intervalSeconds, Float splatScale = 1);
+    void StopAsyncWrite();
+    // AOV registry: integrators register named auxiliary buffers before
+    // rendering starts (not thread-safe; call from Preprocess) and publish
+    // per-sample values through FilmTile::AddAOVSample(). Each AOV is
+    // box-filtered per pixel and written as <filename>_<name> alongside
+    // the main image.
+    // When _momentsToVariance_ is set, samples carry (value, value^2) in
+    // their first two channels and the written buffer holds the per-pixel
+    // sample variance computed from the accumulated moments.
+    int RegisterAOV(const std::string &name, bool momentsToVariance = false);
     void Clear();
 
     // Film Public Data
@@ -76,6 +114,8 @@ class Film {
     const Float diagonal;
     std::unique_ptr<Filter> filter;
     const std::string filename;
+    const bool traversalHeatmap;
+    const bool filterImportance;
     Bounds2i croppedPixelBounds;
 
   private:
@@ -84,10 +124,44 @@ class Film {
         Pixel() { xyz[0] = xyz[1] = xyz[2] = filterWeightSum = 0; }
         Float xyz[3];
         Float filterWeightSum;
-        AtomicFloat splatXYZ[3];
-        Float pad;
     };
     std::unique_ptr<Pixel[]> pixels;
+    // Splat accumulators, three per pixel, allocated on first splat so
+    // integrators that never splat keep the film at sixteen bytes per
+    // pixel and MergeFilmTile never touches the splat cache lines
+    mutable std::once_flag splatAllocOnce;
+    mutable std::unique_ptr<AtomicFloat[]> splatStorage;
+    // Published atomically so snapshot readers racing the first splat see
+    // either null (all zero) or the fully constructed array
+    mutable std::atomic<AtomicFloat *> splatXYZ{nullptr};
+    int PixelOffset(const Point2i &p) const {
+        CHECK(InsideExclusive(p, croppedPixelBounds));
+        int width = croppedPixelBounds.pMax.x - croppedPixelBounds.pMin.x;
+        return (p.x - croppedPixelBounds.pMin.x) +
+               (p.y - croppedPixelBounds.pMin.y) * width;
+    }
+    AtomicFloat *GetSplatPixel(int offset) const {
+        std::call_once(splatAllocOnce, [this]() {
+            splatStorage.reset(
+                new AtomicFloat[3 * croppedPixelBounds.Area()]);
+            splatXYZ.store(splatStorage.get(), std::memory_order_release);
+        });
+        return &splatStorage[3 * offset];
+    }
+    // Registered AOV buffers: per pixel, an RGB sum and sample weight
+    struct AOVPixel {
+        AOVPixel() { v[0] = v[1] = v[2] = weight = 0; }
+        Float v[3];
+        Float weight;
+    };
+    std::vector<std::string> aovNames;
+    std::vector<std::unique_ptr<AOVPixel[]>> aovPixels;
+    std::vector<uint8_t> aovMomentsToVariance;
+    // Per-pixel traversal statistics accumulators for the heatmap AOV
+    struct TraversalPixel {
+        AtomicFloat nodesVisited, primTests, nSamples;
+    };
+    std::unique_ptr<TraversalPixel[]> traversalPixels;
     static PBRT_CONSTEXPR int filterTableWidth = 16;
     Float filterTable[filterTableWidth * filterTableWidth];
     std::mutex mutex;
@@ -95,6 +169,11 @@ class Film {
     const Float maxSampleLuminance;
 
     // Film Private Methods
+    void SnapshotPixels(std::vector<Float> *buf) const;
+    void SnapshotToRGB(const std::vector<Float> &buf, Float splatScale,
+                       Float *rgb) const;
+    std::thread asyncWriteThread;
+    std::atomic<bool> asyncWriteShutdown{false};
     Pixel &GetPixel(const Point2i &p) {
         CHECK(InsideExclusive(p, croppedPixelBounds));
         int width = croppedPixelBounds.pMax.x - croppedPixelBounds.pMin.x;
@@ -102,6 +181,28 @@ class Film {
                      (p.y - croppedPixelBounds.pMin.y) * width;
         return pixels[offset];
     }
+    friend class SplatBuffer;
+};
+
+// Thread-local accumulator for splatted contributions: repeated splats to
+// the same pixel are merged locally and applied to the Film's atomics in
+// periodic batches, which removes most of the per-mutation atomic traffic
+// for splat-heavy integrators such as MLT.
+class SplatBuffer {
+  public:
+    // SplatBuffer Public Methods
+    SplatBuffer(Film *film, int flushInterval = 1024)
+        : film(film), flushInterval(flushInterval) {}
+    ~SplatBuffer() { Flush(); }
+    void AddSplat(const Point2f &p, Spectrum v);
+    void Flush();
+
+  private:
+    // SplatBuffer Private Data
+    Film *film;
+    const int flushInterval;
+    int nPending = 0;
+    std::unordered_map<int, std::array<Float, 3>> sums;
 };
 
 class FilmTile {
@@ -109,20 +210,54 @@ class FilmTile {
     // FilmTile Public Methods
     FilmTile(const Bounds2i &pixelBounds, const Vector2f &filterRadius,
              const Float *filterTable, int filterTableSize,
-             Float maxSampleLuminance)
+             Float maxSampleLuminance, bool filterImportance = false,
+             int nAOVs = 0)
         : pixelBounds(pixelBounds),
           filterRadius(filterRadius),
           invFilterRadius(1 / filterRadius.x, 1 / filterRadius.y),
           filterTable(filterTable),
           filterTableSize(filterTableSize),
-          maxSampleLuminance(maxSampleLuminance) {
+          maxSampleLuminance(maxSampleLuminance),
+          filterImportance(filterImportance) {
         pixels = std::vector<FilmTilePixel>(std::max(0, pixelBounds.Area()));
+        aovPixels = std::vector<AOVTilePixel>(
+            (size_t)nAOVs * std::max(0, pixelBounds.Area()));
+    }
+    // Publish an auxiliary value for the sample at _pFilm_; AOVs use box
+    // reconstruction over the sample's pixel
+    void AddAOVSample(const Point2f &pFilm, int aov, const Spectrum &v) {
+        Point2i p((int)std::floor(pFilm.x), (int)std::floor(pFilm.y));
+        p = Point2i(Clamp(p.x, pixelBounds.pMin.x, pixelBounds.pMax.x - 1),
+                    Clamp(p.y, pixelBounds.pMin.y, pixelBounds.pMax.y - 1));
+        int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+        int offset =
+            (p.x - pixelBounds.pMin.x) + (p.y - pixelBounds.pMin.y) * width;
+        AOVTilePixel &tp =
+            aovPixels[(size_t)aov * pixelBounds.Area() + offset];
+        Float rgb[3];
+        v.ToRGB(rgb);
+        for (int i = 0; i < 3; ++i) tp.v[i] += rgb[i];
+        tp.weight += 1;
     }
     void AddSample(const Point2f &pFilm, Spectrum L,
                    Float sampleWeight = 1.) {
         ProfilePhase _(Prof::AddFilmSample);
-        if (L.y() > maxSampleLuminance)
+        // Skip the luminance evaluation entirely in the (default)
+        // unclamped configuration; for SampledSpectrum builds y() is a
+        // full dot product against the CIE Y curve per sample.
+        if (maxSampleLuminance < Infinity && L.y() > maxSampleLuminance)
             L *= maxSampleLuminance / L.y();
+        if (filterImportance) {
+            // The sample position is already filter-distributed, so it
+            // contributes to exactly one pixel with unit weight
+            Point2i p((int)std::floor(pFilm.x), (int)std::floor(pFilm.y));
+            p = Point2i(Clamp(p.x, pixelBounds.pMin.x, pixelBounds.pMax.x - 1),
+                        Clamp(p.y, pixelBounds.pMin.y, pixelBounds.pMax.y - 1));
+            FilmTilePixel &pixel = GetPixel(p);
+            pixel.contribSum += L * sampleWeight;
+            pixel.filterWeightSum += 1;
+            return;
+        }
         // Compute sample's raster bounds
         Point2f pFilmDiscrete = pFilm - Vector2f(0.5f, 0.5f);
         Point2i p0 = (Point2i)Ceil(pFilmDiscrete - filterRadius);
@@ -182,7 +317,14 @@ class FilmTile {
     const Float *filterTable;
     const int filterTableSize;
     std::vector<FilmTilePixel> pixels;
+    struct AOVTilePixel {
+        AOVTilePixel() { v[0] = v[1] = v[2] = weight = 0; }
+        Float v[3];
+        Float weight;
+    };
+    std::vector<AOVTilePixel> aovPixels;
     const Float maxSampleLuminance;
+    const bool filterImportance;
     friend class Film;
 };
 
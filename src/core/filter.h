@@ -52,6 +52,12 @@ class Filter {
     Filter(const Vector2f &radius)
         : radius(radius), invRadius(Vector2f(1 / radius.x, 1 / radius.y)) {}
     virtual Float Evaluate(const Point2f &p) const = 0;
+    // Warp a uniform sample in [0,1)^2 to an offset distributed according
+    // to the filter, for filter importance sampling; filters with negative
+    // lobes can't be sampled this way and return false.
+    virtual bool SampleOffset(const Point2f &u, Point2f *offset) const {
+        return false;
+    }
 
     // Filter Public Data
     const Vector2f radius, invRadius;
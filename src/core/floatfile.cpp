@@ -34,50 +34,55 @@
 #include "floatfile.h"
 #include <ctype.h>
 #include <stdlib.h>
+#include <string>
 
 namespace pbrt {
 
 bool ReadFloatFile(const char *filename, std::vector<Float> *values) {
-    FILE *f = fopen(filename, "r");
+    FILE *f = fopen(filename, "rb");
     if (!f) {
         Error("Unable to open file \"%s\"", filename);
         return false;
     }
 
-    int c;
-    bool inNumber = false;
-    char curNumber[32];
-    int curNumberPos = 0;
+    // Slurp the file in large blocks and parse in memory; the old
+    // character-at-a-time getc() loop dominated density-grid loads.
+    std::string contents;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) contents.append(buf, n);
+    fclose(f);
+
+    const char *p = contents.c_str();
     int lineNumber = 1;
-    while ((c = getc(f)) != EOF) {
-        if (c == '\n') ++lineNumber;
-        if (inNumber) {
-            CHECK_LT(curNumberPos, (int)sizeof(curNumber))
-                << "Overflowed buffer for parsing number in file: " << filename
-                << ", at line " << lineNumber;
-            if (isdigit(c) || c == '.' || c == 'e' || c == '-' || c == '+')
-                curNumber[curNumberPos++] = c;
-            else {
-                curNumber[curNumberPos++] = '\0';
-                values->push_back(atof(curNumber));
-                inNumber = false;
-                curNumberPos = 0;
-            }
+    while (*p) {
+        char c = *p;
+        if (c == '\n') {
+            ++lineNumber;
+            ++p;
+        } else if (isspace((unsigned char)c))
+            ++p;
+        else if (c == '#') {
+            while (*p && *p != '\n') ++p;
+        } else if (isdigit((unsigned char)c) || c == '.' || c == '-' ||
+                   c == '+') {
+            char *end = nullptr;
+            values->push_back((Float)strtod(p, &end));
+            if (end == p) {
+                // A sign or dot with no number following it; skip it with
+                // the same warning the old parser gave for stray text.
+                Warning("Unexpected text found at line %d of float file "
+                        "\"%s\"", lineNumber, filename);
+                ++p;
+                values->pop_back();
+            } else
+                p = end;
         } else {
-            if (isdigit(c) || c == '.' || c == '-' || c == '+') {
-                inNumber = true;
-                curNumber[curNumberPos++] = c;
-            } else if (c == '#') {
-                while ((c = getc(f)) != '\n' && c != EOF)
-                    ;
-                ++lineNumber;
-            } else if (!isspace(c)) {
-                Warning("Unexpected text found at line %d of float file \"%s\"",
-                        lineNumber, filename);
-            }
+            Warning("Unexpected text found at line %d of float file \"%s\"",
+                    lineNumber, filename);
+            ++p;
         }
     }
-    fclose(f);
     return true;
 }
 
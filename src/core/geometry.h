@@ -42,6 +42,9 @@
 #include "pbrt.h"
 #include "stringprint.h"
 #include <iterator>
+#if defined(__SSE__) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#include <xmmintrin.h>
+#endif
 
 namespace pbrt {
 
@@ -980,8 +983,32 @@ inline Vector3<T> Cross(const Normal3<T> &v1, const Vector3<T> &v2) {
                       (v1x * v2y) - (v1y * v2x));
 }
 
+// Opt-in fast-math kernel (build with -DPBRT_FAST_MATH): hardware
+// reciprocal square root refined by two Newton iterations, which brings
+// the ~2^-12 hardware estimate to within a couple of ulps of 1/sqrt
+// - inside the gamma()-based error budgets everything downstream already
+// tolerates - while replacing the sqrt-plus-divide pair on the
+// normalization and shading-frame hot paths. Traversal's inverse ray
+// directions deliberately stay exact divides: the slab tests' conservative
+// scaling assumes correctly rounded reciprocals.
+#if defined(PBRT_FAST_MATH) && defined(__SSE__) && \
+    !defined(PBRT_FLOAT_AS_DOUBLE)
+inline float FastRSqrt(float x) {
+    float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+    r = r * (1.5f - .5f * x * r * r);
+    r = r * (1.5f - .5f * x * r * r);
+    return r;
+}
+#else
+inline float FastRSqrt(float x) { return 1 / std::sqrt(x); }
+#endif
+
 template <typename T>
 inline Vector3<T> Normalize(const Vector3<T> &v) {
+#if defined(PBRT_FAST_MATH)
+    if (std::is_same<T, float>::value)
+        return v * (T)FastRSqrt((float)v.LengthSquared());
+#endif
     return v / v.Length();
 }
 template <typename T>
@@ -1019,6 +1046,18 @@ Vector3<T> Permute(const Vector3<T> &v, int x, int y, int z) {
 template <typename T>
 inline void CoordinateSystem(const Vector3<T> &v1, Vector3<T> *v2,
                              Vector3<T> *v3) {
+#if defined(PBRT_FAST_MATH)
+    if (std::is_same<T, float>::value) {
+        if (std::abs(v1.x) > std::abs(v1.y))
+            *v2 = Vector3<T>(-v1.z, 0, v1.x) *
+                  (T)FastRSqrt(float(v1.x * v1.x + v1.z * v1.z));
+        else
+            *v2 = Vector3<T>(0, v1.z, -v1.y) *
+                  (T)FastRSqrt(float(v1.y * v1.y + v1.z * v1.z));
+        *v3 = Cross(v1, *v2);
+        return;
+    }
+#endif
     if (std::abs(v1.x) > std::abs(v1.y))
         *v2 = Vector3<T>(-v1.z, 0, v1.x) / std::sqrt(v1.x * v1.x + v1.z * v1.z);
     else
@@ -1164,6 +1203,10 @@ inline Normal3<T> operator*(U f, const Normal3<T> &n) {
 
 template <typename T>
 inline Normal3<T> Normalize(const Normal3<T> &n) {
+#if defined(PBRT_FAST_MATH)
+    if (std::is_same<T, float>::value)
+        return n * (T)FastRSqrt((float)n.LengthSquared());
+#endif
     return n / n.Length();
 }
 
@@ -1437,6 +1480,50 @@ inline bool Bounds3<T>::IntersectP(const Ray &ray, const Vector3f &invDir,
     return (tMin < ray.tMax) && (tMax > 0);
 }
 
+// Test one ray against four axis-aligned boxes stored in SoA form
+// (minC[axis][lane], maxC[axis][lane]); returns a bitmask of the lanes
+// whose boxes the ray enters and each lane's slab entry distance in
+// tNear[4]. The conservative tFar scaling of Bounds3::IntersectP() above
+// is preserved, so vectorized callers keep the same round-off robustness.
+// Shared by the wide-BVH traversal and available to any other
+// bounds-test-heavy code; the arrays need not be aligned.
+inline int IntersectP4(const Float minC[3][4], const Float maxC[3][4],
+                       const Point3f &o, const Vector3f &invDir,
+                       const int dirIsNeg[3], Float rayTMax, Float *tNear) {
+    const Float tFarScale = 1 + 2 * gamma(3);
+#if defined(__SSE__) && !defined(PBRT_FLOAT_AS_DOUBLE)
+    __m128 tMin = _mm_setzero_ps(), tMax = _mm_set1_ps(rayTMax);
+    for (int a = 0; a < 3; ++a) {
+        __m128 lo = _mm_loadu_ps(dirIsNeg[a] ? maxC[a] : minC[a]);
+        __m128 hi = _mm_loadu_ps(dirIsNeg[a] ? minC[a] : maxC[a]);
+        __m128 oA = _mm_set1_ps(o[a]), inv = _mm_set1_ps(invDir[a]);
+        tMin = _mm_max_ps(tMin, _mm_mul_ps(_mm_sub_ps(lo, oA), inv));
+        tMax = _mm_min_ps(tMax,
+                          _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(hi, oA), inv),
+                                     _mm_set1_ps(tFarScale)));
+    }
+    _mm_storeu_ps(tNear, tMin);
+    return _mm_movemask_ps(_mm_cmple_ps(tMin, tMax));
+#else
+    int hits = 0;
+    for (int i = 0; i < 4; ++i) {
+        Float t0 = 0, t1 = rayTMax;
+        for (int a = 0; a < 3; ++a) {
+            Float tn = ((dirIsNeg[a] ? maxC[a][i] : minC[a][i]) - o[a]) *
+                       invDir[a];
+            Float tf = ((dirIsNeg[a] ? minC[a][i] : maxC[a][i]) - o[a]) *
+                       invDir[a];
+            tf *= tFarScale;
+            if (tn > t0) t0 = tn;
+            if (tf < t1) t1 = tf;
+        }
+        if (t0 <= t1) hits |= 1 << i;
+        tNear[i] = t0;
+    }
+    return hits;
+#endif
+}
+
 inline Point3f OffsetRayOrigin(const Point3f &p, const Vector3f &pError,
                                const Normal3f &n, const Vector3f &w) {
     Float d = Dot(Abs(n), pError);
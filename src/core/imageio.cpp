@@ -35,14 +35,18 @@
 #include "ext/lodepng.h"
 #include "ext/targa.h"
 #include "fileutil.h"
+#include "parallel.h"
 #include "spectrum.h"
 
 #include <ImfRgba.h>
 #include <ImfRgbaFile.h>
+#include <ImfThreading.h>
+#include <mutex>
 
 namespace pbrt {
 
 // ImageIO Local Declarations
+static void EnsureEXRThreadPool();
 static void WriteImageEXR(const std::string &name, const Float *pixels,
                           int xRes, int yRes, int totalXRes, int totalYRes,
                           int xOffset, int yOffset);
@@ -125,6 +129,7 @@ RGBSpectrum *ReadImageEXR(const std::string &name, int *width, int *height,
                           Bounds2i *dataWindow, Bounds2i *displayWindow) {
     using namespace Imf;
     using namespace Imath;
+    EnsureEXRThreadPool();
     try {
         RgbaInputFile file(name.c_str());
         Box2i dw = file.dataWindow();
@@ -161,15 +166,28 @@ RGBSpectrum *ReadImageEXR(const std::string &name, int *width, int *height,
     return NULL;
 }
 
+// Hand OpenEXR a worker pool sized to the machine so that (de)compression
+// of scanline blocks - PIZ and ZIP in particular - runs in parallel rather
+// than serializing on the calling thread. Done lazily on first image I/O.
+static void EnsureEXRThreadPool() {
+    static std::once_flag flag;
+    std::call_once(flag,
+                   []() { Imf::setGlobalThreadCount(NumSystemCores()); });
+}
+
 static void WriteImageEXR(const std::string &name, const Float *pixels,
                           int xRes, int yRes, int totalXRes, int totalYRes,
                           int xOffset, int yOffset) {
     using namespace Imf;
     using namespace Imath;
+    EnsureEXRThreadPool();
 
     Rgba *hrgba = new Rgba[xRes * yRes];
-    for (int i = 0; i < xRes * yRes; ++i)
-        hrgba[i] = Rgba(pixels[3 * i], pixels[3 * i + 1], pixels[3 * i + 2]);
+    ParallelFor(
+        [&](int64_t i) {
+            hrgba[i] = Rgba(pixels[3 * i], pixels[3 * i + 1], pixels[3 * i + 2]);
+        },
+        xRes * yRes, 4096);
 
     // OpenEXR uses inclusive pixel bounds.
     Box2i displayWindow(V2i(0, 0), V2i(totalXRes - 1, totalYRes - 1));
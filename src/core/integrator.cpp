@@ -37,26 +37,68 @@
 #include "sampling.h"
 #include "parallel.h"
 #include "film.h"
+#include "imageio.h"
 #include "sampler.h"
 #include "integrator.h"
 #include "progressreporter.h"
 #include "camera.h"
 #include "stats.h"
+#include "lights/diffuse.h"
+#include "lights/distant.h"
+#include "lights/infinite.h"
+#include "lights/point.h"
+#include "lights/spot.h"
+#include <typeinfo>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#if !defined(PBRT_IS_WINDOWS)
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 namespace pbrt {
 
 STAT_COUNTER("Integrator/Camera rays traced", nCameraRays);
 
+PBRT_THREAD_LOCAL DenoisingFeatures denoisingFeatures;
+bool denoisingAOVsEnabled = false;
+
 // Integrator Method Definitions
 Integrator::~Integrator() {}
 
 // Integrator Utility Functions
+template <typename LightT>
+static Spectrum EstimateDirectT(const Interaction &it,
+                                const Point2f &uScattering,
+                                const LightT &light, const Point2f &uLight,
+                                const Scene &scene, Sampler &sampler,
+                                MemoryArena &arena, bool handleMedia,
+                                bool specular, RayStream *shadowRays,
+                                std::vector<Spectrum> *shadowLd);
+static Spectrum EstimateDirectDispatch(const Interaction &it,
+                                       const Point2f &uScattering,
+                                       const Light &light,
+                                       const Point2f &uLight,
+                                       const Scene &scene, Sampler &sampler,
+                                       MemoryArena &arena, bool handleMedia,
+                                       bool specular, RayStream *shadowRays,
+                                       std::vector<Spectrum> *shadowLd);
 Spectrum UniformSampleAllLights(const Interaction &it, const Scene &scene,
                                 MemoryArena &arena, Sampler &sampler,
                                 const std::vector<int> &nLightSamples,
                                 bool handleMedia) {
     ProfilePhase p(Prof::DirectLighting);
     Spectrum L(0.f);
+    // Collect shadow rays from all lights' samples into one stream so the
+    // aggregate can trace them as a bundle.
+    RayStream shadowRays;
+    std::vector<Spectrum> shadowLd;
     for (size_t j = 0; j < scene.lights.size(); ++j) {
         // Accumulate contribution of _j_th light to _L_
         const std::shared_ptr<Light> &light = scene.lights[j];
@@ -67,24 +109,39 @@ Spectrum UniformSampleAllLights(const Interaction &it, const Scene &scene,
             // Use a single sample for illumination from _light_
             Point2f uLight = sampler.Get2D();
             Point2f uScattering = sampler.Get2D();
-            L += EstimateDirect(it, uScattering, *light, uLight, scene, sampler,
-                                arena, handleMedia);
+            L += EstimateDirectDispatch(it, uScattering, *light, uLight,
+                                        scene, sampler, arena, handleMedia,
+                                        false, &shadowRays, &shadowLd);
         } else {
             // Estimate direct lighting using sample arrays
+            size_t streamStart = shadowLd.size();
             Spectrum Ld(0.f);
             for (int k = 0; k < nSamples; ++k)
-                Ld += EstimateDirect(it, uScatteringArray[k], *light,
-                                     uLightArray[k], scene, sampler, arena,
-                                     handleMedia);
+                Ld += EstimateDirectDispatch(it, uScatteringArray[k],
+                                             *light, uLightArray[k], scene,
+                                             sampler, arena, handleMedia,
+                                             false, &shadowRays, &shadowLd);
             L += Ld / nSamples;
+            // Deferred contributions carry the same _1/nSamples_ weight
+            for (size_t i = streamStart; i < shadowLd.size(); ++i)
+                shadowLd[i] /= nSamples;
         }
     }
+    // Trace the queued shadow rays as one batch and add the contributions of
+    // the unoccluded samples
+    if (shadowRays.Size() > 0) {
+        scene.IntersectPStream(&shadowRays);
+        for (size_t i = 0; i < shadowRays.Size(); ++i)
+            if (!shadowRays.occluded[i]) L += shadowLd[i];
+    }
     return L;
 }
 
 Spectrum UniformSampleOneLight(const Interaction &it, const Scene &scene,
                                MemoryArena &arena, Sampler &sampler,
-                               bool handleMedia, const Distribution1D *lightDistrib) {
+                               bool handleMedia, const Distribution1D *lightDistrib,
+                               RayStream *shadowRays,
+                               std::vector<Spectrum> *shadowLd) {
     ProfilePhase p(Prof::DirectLighting);
     // Randomly choose a single light to sample, _light_
     int nLights = int(scene.lights.size());
@@ -101,14 +158,30 @@ Spectrum UniformSampleOneLight(const Interaction &it, const Scene &scene,
     const std::shared_ptr<Light> &light = scene.lights[lightNum];
     Point2f uLight = sampler.Get2D();
     Point2f uScattering = sampler.Get2D();
-    return EstimateDirect(it, uScattering, *light, uLight,
-                          scene, sampler, arena, handleMedia) / lightPdf;
+    size_t streamStart = shadowLd ? shadowLd->size() : 0;
+    Spectrum Ld = EstimateDirectDispatch(it, uScattering, *light, uLight,
+                                         scene, sampler, arena, handleMedia,
+                                         false, shadowRays, shadowLd) /
+                  lightPdf;
+    // Deferred contributions carry the same _1/lightPdf_ weight
+    if (shadowLd)
+        for (size_t i = streamStart; i < shadowLd->size(); ++i)
+            (*shadowLd)[i] /= lightPdf;
+    return Ld;
 }
 
-Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
-                        const Light &light, const Point2f &uLight,
-                        const Scene &scene, Sampler &sampler,
-                        MemoryArena &arena, bool handleMedia, bool specular) {
+// The body of EstimateDirect, templated on the light's concrete type:
+// dispatched with one of the final Light subclasses, the Sample_Li and
+// Pdf_Li calls below devirtualize and inline; instantiated with the base
+// class it behaves exactly as before.
+template <typename LightT>
+static Spectrum EstimateDirectT(const Interaction &it,
+                                const Point2f &uScattering,
+                                const LightT &light, const Point2f &uLight,
+                                const Scene &scene, Sampler &sampler,
+                                MemoryArena &arena, bool handleMedia,
+                                bool specular, RayStream *shadowRays,
+                                std::vector<Spectrum> *shadowLd) {
     BxDFType bsdfFlags =
         specular ? BSDF_ALL : BxDFType(BSDF_ALL & ~BSDF_SPECULAR);
     Spectrum Ld(0.f);
@@ -139,10 +212,11 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
         }
         if (!f.IsBlack()) {
             // Compute effect of visibility for light source sample
+            bool deferVisibility = shadowRays != nullptr && !handleMedia;
             if (handleMedia) {
                 Li *= visibility.Tr(scene, sampler);
                 VLOG(2) << "  after Tr, Li: " << Li;
-            } else {
+            } else if (!deferVisibility) {
               if (!visibility.Unoccluded(scene)) {
                 VLOG(2) << "  shadow ray blocked";
                 Li = Spectrum(0.f);
@@ -152,13 +226,22 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
 
             // Add light's contribution to reflected radiance
             if (!Li.IsBlack()) {
+                Spectrum contrib;
                 if (IsDeltaLight(light.flags))
-                    Ld += f * Li / lightPdf;
+                    contrib = f * Li / lightPdf;
                 else {
                     Float weight =
                         PowerHeuristic(1, lightPdf, 1, scatteringPdf);
-                    Ld += f * Li * weight / lightPdf;
+                    contrib = f * Li * weight / lightPdf;
                 }
+                if (deferVisibility) {
+                    // Queue the shadow ray and its would-be contribution for
+                    // a batched occlusion test by the caller
+                    shadowRays->AddRay(
+                        visibility.P0().SpawnRayTo(visibility.P1()));
+                    shadowLd->push_back(contrib);
+                } else
+                    Ld += contrib;
             }
         }
     }
@@ -204,7 +287,11 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
             // Add light contribution from material sampling
             Spectrum Li(0.f);
             if (foundSurfaceInteraction) {
-                if (lightIsect.primitive->GetAreaLight() == &light)
+                // Compare through the base class: with LightT a concrete
+                // non-area type, comparing GetAreaLight()'s AreaLight
+                // pointer against &light directly doesn't compile
+                if (lightIsect.primitive->GetAreaLight() ==
+                    static_cast<const Light *>(&light))
                     Li = lightIsect.Le(-wi);
             } else
                 Li = light.Le(ray);
@@ -214,6 +301,56 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
     return Ld;
 }
 
+Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
+                        const Light &light, const Point2f &uLight,
+                        const Scene &scene, Sampler &sampler,
+                        MemoryArena &arena, bool handleMedia, bool specular,
+                        RayStream *shadowRays,
+                        std::vector<Spectrum> *shadowLd) {
+    return EstimateDirectDispatch(it, uScattering, light, uLight, scene,
+                                  sampler, arena, handleMedia, specular,
+                                  shadowRays, shadowLd);
+}
+
+static Spectrum EstimateDirectDispatch(const Interaction &it,
+                                       const Point2f &uScattering,
+                                       const Light &light,
+                                       const Point2f &uLight,
+                                       const Scene &scene, Sampler &sampler,
+                                       MemoryArena &arena, bool handleMedia,
+                                       bool specular, RayStream *shadowRays,
+                                       std::vector<Spectrum> *shadowLd) {
+    // One typeid comparison selects the devirtualized EstimateDirectT
+    // instantiation for the common concrete (final) light types - their
+    // Sample_Li/Pdf_Li calls then inline - while anything else takes the
+    // generic virtual-dispatch instantiation.
+    const std::type_info &type = typeid(light);
+    if (type == typeid(DiffuseAreaLight))
+        return EstimateDirectT(it, uScattering,
+                               (const DiffuseAreaLight &)light, uLight, scene,
+                               sampler, arena, handleMedia, specular,
+                               shadowRays, shadowLd);
+    if (type == typeid(InfiniteAreaLight))
+        return EstimateDirectT(it, uScattering,
+                               (const InfiniteAreaLight &)light, uLight,
+                               scene, sampler, arena, handleMedia, specular,
+                               shadowRays, shadowLd);
+    if (type == typeid(DistantLight))
+        return EstimateDirectT(it, uScattering, (const DistantLight &)light,
+                               uLight, scene, sampler, arena, handleMedia,
+                               specular, shadowRays, shadowLd);
+    if (type == typeid(PointLight))
+        return EstimateDirectT(it, uScattering, (const PointLight &)light,
+                               uLight, scene, sampler, arena, handleMedia,
+                               specular, shadowRays, shadowLd);
+    if (type == typeid(SpotLight))
+        return EstimateDirectT(it, uScattering, (const SpotLight &)light,
+                               uLight, scene, sampler, arena, handleMedia,
+                               specular, shadowRays, shadowLd);
+    return EstimateDirectT(it, uScattering, light, uLight, scene, sampler,
+                           arena, handleMedia, specular, shadowRays, shadowLd);
+}
+
 std::unique_ptr<Distribution1D> ComputeLightPowerDistribution(
     const Scene &scene) {
     if (scene.lights.empty()) return nullptr;
@@ -225,18 +362,79 @@ std::unique_ptr<Distribution1D> ComputeLightPowerDistribution(
 }
 
 // SamplerIntegrator Method Definitions
+
+// Publish the current sample's denoising features and radiance moments
+// into the film's AOV buffers, and reset the per-thread feature record
+void SamplerIntegrator::PublishDenoisingAOVs(FilmTile *filmTile,
+                                             const Point2f &pFilm,
+                                             const Spectrum &L) const {
+    if (denoisingFeatures.valid) {
+        filmTile->AddAOVSample(pFilm, albedoAOV,
+                               Spectrum::FromRGB(denoisingFeatures.albedo));
+        filmTile->AddAOVSample(pFilm, normalAOV,
+                               Spectrum::FromRGB(denoisingFeatures.normal));
+    }
+    Float ly = L.y();
+    Float moments[3] = {ly, ly * ly, 0};
+    filmTile->AddAOVSample(pFilm, varianceAOV, Spectrum::FromRGB(moments));
+    denoisingFeatures.valid = false;
+}
+
+int SamplerIntegrator::ChooseTileSize(const Vector2i &sampleExtent) const {
+    if (requestedTileSize > 0) return requestedTileSize;
+    int nThreads = MaxThreadIndex();
+    Float target = std::sqrt(
+        (Float)sampleExtent.x * (Float)sampleExtent.y / (64.f * nThreads));
+    int tileSize = 8;
+    while (tileSize < 64 && tileSize < target) tileSize *= 2;
+    return tileSize;
+}
+
 void SamplerIntegrator::Render(const Scene &scene) {
+    // Periodically write the in-progress image from a background thread;
+    // the final WriteImage() stops the writer
+    if (PbrtOptions.writeIntervalSeconds > 0)
+        camera->film->StartAsyncWrite(PbrtOptions.writeIntervalSeconds);
+    if (denoisingAOVs) {
+        denoisingAOVsEnabled = true;
+        albedoAOV = camera->film->RegisterAOV("albedo");
+        normalAOV = camera->film->RegisterAOV("normal");
+        varianceAOV = camera->film->RegisterAOV("variance", true);
+    }
+    if (adaptiveTargetError > 0 || !importanceMapFile.empty()) {
+        RenderAdaptive(scene);
+        return;
+    }
+    if (!PbrtOptions.checkpointFile.empty() || PbrtOptions.progressive ||
+        PbrtOptions.costScheduler || PbrtOptions.timeBudgetSeconds > 0) {
+        RenderCheckpointed(scene);
+        return;
+    }
+    if (PbrtOptions.distCoordinatorPort > 0 ||
+        !PbrtOptions.distWorkerAddress.empty()) {
+        RenderDistributed(scene);
+        return;
+    }
     Preprocess(scene, *sampler);
     // Render image tiles in parallel
 
     // Compute number of tiles, _nTiles_, to use for parallel rendering
     Bounds2i sampleBounds = camera->film->GetSampleBounds();
     Vector2i sampleExtent = sampleBounds.Diagonal();
-    const int tileSize = 16;
+    const int tileSize = ChooseTileSize(sampleExtent);
     Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
                    (sampleExtent.y + tileSize - 1) / tileSize);
     ProgressReporter reporter(nTiles.x * nTiles.y, "Rendering");
     {
+        // In deterministic mode completed tiles are parked here and merged
+        // in tile order after the parallel loop: pixels straddling tile
+        // boundaries then accumulate their (non-associative) float sums in
+        // a fixed order, making the image bit-identical across thread
+        // counts. Tile sampler seeds depend only on the tile index, so
+        // sampling itself is already schedule-independent.
+        std::vector<std::unique_ptr<FilmTile>> pendingTiles;
+        if (PbrtOptions.deterministic)
+            pendingTiles.resize((size_t)nTiles.x * nTiles.y);
         ParallelFor2D([&](Point2i tile) {
             // Render section of image corresponding to _tile_
 
@@ -277,6 +475,8 @@ void SamplerIntegrator::Render(const Scene &scene) {
                     // Initialize _CameraSample_ for current sample
                     CameraSample cameraSample =
                         tileSampler->GetCameraSample(pixel);
+                    cameraSample.pFilm = camera->film->RemapToFilterSample(
+                        pixel, cameraSample.pFilm);
 
                     // Generate camera ray for current sample
                     RayDifferential ray;
@@ -288,8 +488,17 @@ void SamplerIntegrator::Render(const Scene &scene) {
 
                     // Evaluate radiance along camera ray
                     Spectrum L(0.f);
+                    if (camera->film->traversalHeatmap)
+                        perRayTraversalStats = PerRayTraversalStats();
                     if (rayWeight > 0) L = Li(ray, scene, *tileSampler, arena);
 
+                    // Record this ray's traversal cost in the heatmap AOV
+                    if (camera->film->traversalHeatmap)
+                        camera->film->AddTraversalSample(
+                            cameraSample.pFilm,
+                            (Float)perRayTraversalStats.nodesVisited,
+                            (Float)perRayTraversalStats.primTests);
+
                     // Issue warning if unexpected radiance value returned
                     if (L.HasNaNs()) {
                         LOG(ERROR) << StringPrintf(
@@ -318,6 +527,9 @@ void SamplerIntegrator::Render(const Scene &scene) {
 
                     // Add camera ray's contribution to image
                     filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+                    if (denoisingAOVs)
+                        PublishDenoisingAOVs(filmTile.get(),
+                                             cameraSample.pFilm, L);
 
                     // Free _MemoryArena_ memory from computing image sample
                     // value
@@ -327,9 +539,15 @@ void SamplerIntegrator::Render(const Scene &scene) {
             LOG(INFO) << "Finished image tile " << tileBounds;
 
             // Merge image tile into _Film_
-            camera->film->MergeFilmTile(std::move(filmTile));
+            if (PbrtOptions.deterministic)
+                pendingTiles[tile.y * nTiles.x + tile.x] =
+                    std::move(filmTile);
+            else
+                camera->film->MergeFilmTile(std::move(filmTile));
             reporter.Update();
         }, nTiles);
+        for (std::unique_ptr<FilmTile> &pending : pendingTiles)
+            if (pending) camera->film->MergeFilmTile(std::move(pending));
         reporter.Done();
     }
     LOG(INFO) << "Rendering finished";
@@ -338,9 +556,621 @@ void SamplerIntegrator::Render(const Scene &scene) {
     camera->film->WriteImage();
 }
 
+// Distributed Rendering Definitions
+#if !defined(PBRT_IS_WINDOWS)
+// Read or write exactly n bytes; false on error or EOF.
+static bool ReadAll(int fd, void *buf, size_t n) {
+    char *p = (char *)buf;
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+static bool WriteAll(int fd, const void *buf, size_t n) {
+    const char *p = (const char *)buf;
+    while (n > 0) {
+        ssize_t r = write(fd, p, n);
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+#endif  // !PBRT_IS_WINDOWS
+
+std::unique_ptr<FilmTile> SamplerIntegrator::RenderDistributedTile(
+    const Scene &scene, int tileIndex, const Point2i &nTiles,
+    const Bounds2i &sampleBounds, int tileSize) {
+    // Same structure (and, crucially, the same per-tile sampler seed) as
+    // the tile body in Render(), so a distributed render produces the same
+    // image as a single-process one.
+    MemoryArena arena;
+    Point2i tile(tileIndex % nTiles.x, tileIndex / nTiles.x);
+    std::unique_ptr<Sampler> tileSampler = sampler->Clone(tileIndex);
+    int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+    int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+    int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+    int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+    Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+    std::unique_ptr<FilmTile> filmTile = camera->film->GetFilmTile(tileBounds);
+    for (Point2i pixel : tileBounds) {
+        {
+            ProfilePhase pp(Prof::StartPixel);
+            tileSampler->StartPixel(pixel);
+        }
+        if (!InsideExclusive(pixel, pixelBounds)) continue;
+        do {
+            CameraSample cameraSample = tileSampler->GetCameraSample(pixel);
+            cameraSample.pFilm =
+                camera->film->RemapToFilterSample(pixel, cameraSample.pFilm);
+            RayDifferential ray;
+            Float rayWeight =
+                camera->GenerateRayDifferential(cameraSample, &ray);
+            ray.ScaleDifferentials(
+                1 / std::sqrt((Float)tileSampler->samplesPerPixel));
+            ++nCameraRays;
+            Spectrum L(0.f);
+            if (rayWeight > 0) L = Li(ray, scene, *tileSampler, arena);
+            if (L.HasNaNs() || L.y() < -1e-5 || std::isinf(L.y()))
+                L = Spectrum(0.f);
+            filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+            arena.Reset();
+        } while (tileSampler->StartNextSample());
+    }
+    return filmTile;
+}
+
+void SamplerIntegrator::RenderDistributed(const Scene &scene) {
+#if defined(PBRT_IS_WINDOWS)
+    Error("Distributed rendering is not supported on Windows.");
+#else
+    Preprocess(scene, *sampler);
+    Bounds2i sampleBounds = camera->film->GetSampleBounds();
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    // Fixed tile size: the coordinator and its workers must derive the
+    // identical tile decomposition, and their thread counts differ, so the
+    // adaptive ChooseTileSize() heuristic can't be used here.
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    int totalTiles = nTiles.x * nTiles.y;
+
+    if (!PbrtOptions.distWorkerAddress.empty()) {
+        // Worker: connect to the coordinator, then have every render
+        // thread fetch, render, and stream back tiles until told to stop.
+        const std::string &addr = PbrtOptions.distWorkerAddress;
+        size_t colon = addr.find_last_of(':');
+        if (colon == std::string::npos) {
+            Error("--worker expects host:port, got \"%s\"", addr.c_str());
+            return;
+        }
+        std::string host = addr.substr(0, colon);
+        std::string port = addr.substr(colon + 1);
+        struct addrinfo hints = {}, *res = nullptr;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 ||
+            !res) {
+            Error("Unable to resolve coordinator address \"%s\"",
+                  addr.c_str());
+            return;
+        }
+        int fd = socket(res->ai_family, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+            Error("Unable to connect to coordinator at \"%s\"", addr.c_str());
+            freeaddrinfo(res);
+            return;
+        }
+        freeaddrinfo(res);
+
+        std::mutex sockMutex;
+        std::atomic<bool> done(false);
+        ParallelFor(
+            [&](int64_t) {
+                if (done) return;
+                int32_t tileIndex;
+                {
+                    std::lock_guard<std::mutex> lock(sockMutex);
+                    if (done) return;
+                    uint32_t op = 0;
+                    if (!WriteAll(fd, &op, sizeof(op)) ||
+                        !ReadAll(fd, &tileIndex, sizeof(tileIndex))) {
+                        done = true;
+                        return;
+                    }
+                }
+                if (tileIndex < 0) {
+                    done = true;
+                    return;
+                }
+                std::unique_ptr<FilmTile> tile = RenderDistributedTile(
+                    scene, tileIndex, nTiles, sampleBounds, tileSize);
+                // Serialize the tile's pixels; the coordinator recomputes
+                // the identical pixel bounds from the tile index.
+                Bounds2i pb = tile->GetPixelBounds();
+                std::vector<Float> payload;
+                payload.reserve((Spectrum::nSamples + 1) * pb.Area());
+                for (Point2i p : pb) {
+                    FilmTilePixel &tp = tile->GetPixel(p);
+                    for (int c = 0; c < Spectrum::nSamples; ++c)
+                        payload.push_back(tp.contribSum[c]);
+                    payload.push_back(tp.filterWeightSum);
+                }
+                std::lock_guard<std::mutex> lock(sockMutex);
+                uint32_t op = 1;
+                if (!WriteAll(fd, &op, sizeof(op)) ||
+                    !WriteAll(fd, &tileIndex, sizeof(tileIndex)) ||
+                    !WriteAll(fd, payload.data(),
+                              payload.size() * sizeof(Float)))
+                    done = true;
+            },
+            totalTiles, 1);
+        close(fd);
+        LOG(INFO) << "Distributed worker finished.";
+        return;  // the coordinator writes the image
+    }
+
+    // Coordinator: serve tiles to workers, render locally in parallel, and
+    // merge everything into the film.
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in bindAddr = {};
+    bindAddr.sin_family = AF_INET;
+    bindAddr.sin_addr.s_addr = INADDR_ANY;
+    bindAddr.sin_port = htons((uint16_t)PbrtOptions.distCoordinatorPort);
+    if (bind(listenFd, (struct sockaddr *)&bindAddr, sizeof(bindAddr)) != 0 ||
+        listen(listenFd, 16) != 0) {
+        Error("Unable to listen on port %d", PbrtOptions.distCoordinatorPort);
+        return;
+    }
+
+    std::atomic<int> nextTile(0), nMerged(0);
+    std::mutex claimMutex;
+    std::vector<int32_t> retryTiles;       // guarded by claimMutex
+    std::vector<char> merged(totalTiles, 0);  // guarded by claimMutex
+    // Claim the next unrendered tile: requeued tiles from dead workers
+    // first, then the global counter; -1 when everything is claimed.
+    auto claimTile = [&]() -> int32_t {
+        {
+            std::lock_guard<std::mutex> lock(claimMutex);
+            if (!retryTiles.empty()) {
+                int32_t t = retryTiles.back();
+                retryTiles.pop_back();
+                return t;
+            }
+        }
+        int32_t t = nextTile++;
+        return t < totalTiles ? t : -1;
+    };
+    // Guard against duplicate submissions (a worker presumed dead whose
+    // tile was requeued may still deliver it later).
+    auto markMerged = [&](int32_t t) {
+        std::lock_guard<std::mutex> lock(claimMutex);
+        if (merged[t]) return false;
+        merged[t] = 1;
+        return true;
+    };
+
+    ProgressReporter reporter(totalTiles, "Rendering");
+    std::atomic<bool> shuttingDown(false);
+    std::mutex connMutex;
+    std::vector<std::thread> connThreads;
+    std::thread acceptThread([&]() {
+        for (;;) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) return;  // listener closed during shutdown
+            std::lock_guard<std::mutex> lock(connMutex);
+            connThreads.push_back(std::thread([&, fd]() {
+                std::vector<int32_t> inFlight;
+                for (;;) {
+                    uint32_t op;
+                    if (!ReadAll(fd, &op, sizeof(op))) break;
+                    if (op == 0) {
+                        int32_t t = claimTile();
+                        if (t >= 0) inFlight.push_back(t);
+                        if (!WriteAll(fd, &t, sizeof(t)) || t < 0) break;
+                    } else if (op == 1) {
+                        int32_t t;
+                        if (!ReadAll(fd, &t, sizeof(t))) break;
+                        // Rebuild the tile's pixel bounds exactly as the
+                        // worker computed them and read the payload.
+                        Point2i tile(t % nTiles.x, t / nTiles.x);
+                        int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+                        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+                        int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+                        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+                        std::unique_ptr<FilmTile> filmTile =
+                            camera->film->GetFilmTile(Bounds2i(
+                                Point2i(x0, y0), Point2i(x1, y1)));
+                        Bounds2i pb = filmTile->GetPixelBounds();
+                        std::vector<Float> payload((Spectrum::nSamples + 1) *
+                                                   pb.Area());
+                        if (!ReadAll(fd, payload.data(),
+                                     payload.size() * sizeof(Float)))
+                            break;
+                        auto iter =
+                            std::find(inFlight.begin(), inFlight.end(), t);
+                        if (iter != inFlight.end()) inFlight.erase(iter);
+                        if (!markMerged(t)) continue;
+                        size_t k = 0;
+                        for (Point2i p : pb) {
+                            FilmTilePixel &tp = filmTile->GetPixel(p);
+                            for (int c = 0; c < Spectrum::nSamples; ++c)
+                                tp.contribSum[c] = payload[k++];
+                            tp.filterWeightSum = payload[k++];
+                        }
+                        camera->film->MergeFilmTile(std::move(filmTile));
+                        ++nMerged;
+                        reporter.Update();
+                    } else
+                        break;
+                }
+                close(fd);
+                // Requeue tiles this worker claimed but never delivered
+                if (!inFlight.empty() && !shuttingDown) {
+                    std::lock_guard<std::mutex> lock(claimMutex);
+                    retryTiles.insert(retryTiles.end(), inFlight.begin(),
+                                      inFlight.end());
+                }
+            }));
+        }
+    });
+
+    // Render tiles locally with the worker pool while remote workers chew
+    // through the rest of the queue.
+    auto renderLocal = [&]() {
+        int32_t t = claimTile();
+        if (t < 0) return false;
+        std::unique_ptr<FilmTile> tile = RenderDistributedTile(
+            scene, t, nTiles, sampleBounds, tileSize);
+        if (markMerged(t)) {
+            camera->film->MergeFilmTile(std::move(tile));
+            ++nMerged;
+            reporter.Update();
+        }
+        return true;
+    };
+    ParallelFor([&](int64_t) { renderLocal(); }, totalTiles, 1);
+    // Pick up stragglers: tiles requeued after a worker died, and waiting
+    // for in-flight remote tiles to land.
+    while (nMerged < totalTiles)
+        if (!renderLocal())
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    shuttingDown = true;
+    shutdown(listenFd, SHUT_RDWR);
+    close(listenFd);
+    acceptThread.join();
+    {
+        std::lock_guard<std::mutex> lock(connMutex);
+        for (std::thread &th : connThreads) th.join();
+    }
+    reporter.Done();
+    LOG(INFO) << "Rendering finished";
+    camera->film->WriteImage();
+#endif  // PBRT_IS_WINDOWS
+}
+
+void SamplerIntegrator::RenderCheckpointed(const Scene &scene) {
+    Preprocess(scene, *sampler);
+    // Render one sample per pixel per pass so that film contents plus a
+    // completed-sample count fully describe render progress. This loop
+    // backs both checkpointing (periodically persisting film state so an
+    // interrupted render resumes exactly where it stopped) and progressive
+    // preview (rewriting the output image after every pass).
+    Bounds2i sampleBounds = camera->film->GetSampleBounds();
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = ChooseTileSize(sampleExtent);
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+
+    int64_t spp = sampler->samplesPerPixel;
+    int64_t startSample = 0;
+    if (PbrtOptions.resume &&
+        camera->film->LoadCheckpoint(PbrtOptions.checkpointFile,
+                                     &startSample)) {
+        startSample = std::min(startSample, spp);
+        if (!PbrtOptions.quiet)
+            printf("Resuming render at %d of %d samples per pixel\n",
+                   (int)startSample, (int)spp);
+    }
+
+    ProgressReporter reporter(std::max((int64_t)1, spp - startSample),
+                              "Rendering");
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+    // Per-tile cost estimates let later passes dispatch expensive tiles
+    // first so stragglers don't tail out a pass on otherwise-idle cores
+    int nTileTotal = nTiles.x * nTiles.y;
+    std::vector<double> tileCost(nTileTotal, 0);
+    std::vector<int> tileOrder(nTileTotal);
+    for (int i = 0; i < nTileTotal; ++i) tileOrder[i] = i;
+    auto renderStart = std::chrono::steady_clock::now();
+    double lastPassSeconds = 0;
+    for (int64_t s = startSample; s < spp; ++s) {
+        // Time-budget mode: stop at a pass boundary once the next pass
+        // (estimated at the previous pass's duration) would overshoot the
+        // wall-clock budget; the film then holds a properly weighted image
+        // of the completed passes.
+        if (PbrtOptions.timeBudgetSeconds > 0) {
+            double elapsed = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() -
+                                 renderStart).count();
+            if (elapsed + lastPassSeconds > PbrtOptions.timeBudgetSeconds) {
+                if (!PbrtOptions.quiet)
+                    printf("Time budget reached after %.1f s; writing image "
+                           "with %d of %d samples per pixel.\n",
+                           elapsed, (int)s, (int)spp);
+                break;
+            }
+        }
+        auto passStart = std::chrono::steady_clock::now();
+        // Render sample _s_ of every pixel
+        auto renderTile = [&](Point2i tile) {
+            auto tileStart = std::chrono::steady_clock::now();
+            MemoryArena arena;
+            int seed = tile.y * nTiles.x + tile.x;
+            std::unique_ptr<Sampler> tileSampler = sampler->Clone(seed);
+            int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+            int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+            int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+            int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+            Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+            std::unique_ptr<FilmTile> filmTile =
+                camera->film->GetFilmTile(tileBounds);
+            for (Point2i pixel : tileBounds) {
+                {
+                    ProfilePhase pp(Prof::StartPixel);
+                    tileSampler->StartPixel(pixel);
+                }
+                if (!InsideExclusive(pixel, pixelBounds)) continue;
+                if (!tileSampler->SetSampleNumber(s)) continue;
+                CameraSample cameraSample =
+                    tileSampler->GetCameraSample(pixel);
+                cameraSample.pFilm = camera->film->RemapToFilterSample(
+                    pixel, cameraSample.pFilm);
+                RayDifferential ray;
+                Float rayWeight =
+                    camera->GenerateRayDifferential(cameraSample, &ray);
+                ray.ScaleDifferentials(
+                    1 / std::sqrt((Float)tileSampler->samplesPerPixel));
+                ++nCameraRays;
+                Spectrum L(0.f);
+                if (rayWeight > 0) L = Li(ray, scene, *tileSampler, arena);
+                if (L.HasNaNs() || L.y() < -1e-5 || std::isinf(L.y())) {
+                    LOG(ERROR) << StringPrintf(
+                        "Invalid radiance value returned for pixel (%d, %d), "
+                        "sample %d. Setting to black.",
+                        pixel.x, pixel.y, (int)s);
+                    L = Spectrum(0.f);
+                }
+                filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+                if (denoisingAOVs)
+                    PublishDenoisingAOVs(filmTile.get(), cameraSample.pFilm,
+                                         L);
+                arena.Reset();
+            }
+            camera->film->MergeFilmTile(std::move(filmTile));
+            // Blend this pass's time into the tile's cost estimate
+            double elapsed =
+                std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - tileStart).count();
+            int tileIndex = tile.x + tile.y * nTiles.x;
+            tileCost[tileIndex] = .5 * tileCost[tileIndex] + .5 * elapsed;
+        };
+        if (PbrtOptions.costScheduler && s > startSample) {
+            // Dispatch tiles most-expensive-first based on measured cost
+            std::sort(tileOrder.begin(), tileOrder.end(), [&](int a, int b) {
+                return tileCost[a] > tileCost[b];
+            });
+            ParallelFor([&](int64_t i) {
+                int t = tileOrder[i];
+                renderTile(Point2i(t % nTiles.x, t / nTiles.x));
+            }, nTileTotal, 1);
+        } else
+            ParallelFor2D(renderTile, nTiles);
+        reporter.Update();
+
+        lastPassSeconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - passStart)
+                              .count();
+
+        // Flush the current image estimate after each progressive pass
+        if (PbrtOptions.progressive && s + 1 < spp) camera->film->WriteImage();
+
+        // Persist progress when the checkpoint interval has elapsed
+        auto now = std::chrono::steady_clock::now();
+        if (!PbrtOptions.checkpointFile.empty() &&
+            (s + 1 == spp ||
+             std::chrono::duration<double>(now - lastCheckpoint).count() >=
+                 PbrtOptions.checkpointSeconds)) {
+            camera->film->WriteCheckpoint(PbrtOptions.checkpointFile, s + 1);
+            lastCheckpoint = now;
+        }
+    }
+    reporter.Done();
+    LOG(INFO) << "Rendering finished";
+    camera->film->WriteImage();
+}
+
+STAT_COUNTER("Integrator/Adaptive sampling passes", nAdaptivePasses);
+STAT_PERCENT("Integrator/Pixels converged early", nConvergedPixels,
+             nAdaptivePixels);
+
+void SamplerIntegrator::RenderAdaptive(const Scene &scene) {
+    Preprocess(scene, *sampler);
+    // Render in passes, tracking per-pixel sample mean and variance and
+    // re-queueing only the pixels whose estimated relative error is still
+    // above _adaptiveTargetError_.
+    Bounds2i sampleBounds = camera->film->GetSampleBounds();
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+
+    // Per-pixel luminance statistics and activity flags
+    struct PixelStats {
+        double sum = 0, sumSq = 0;
+        int64_t n = 0;
+    };
+    int nPixels = sampleExtent.x * sampleExtent.y;
+    std::vector<PixelStats> pixelStats(nPixels);
+    std::vector<uint8_t> pixelActive(nPixels, 1);
+    auto pixelIndex = [&](const Point2i &p) {
+        return (p.x - sampleBounds.pMin.x) +
+               (p.y - sampleBounds.pMin.y) * sampleExtent.x;
+    };
+
+    int64_t spp = sampler->samplesPerPixel;
+
+    // Optional prior-frame importance map ("importancemap"): per-pixel
+    // sample budgets proportional to the previous frame's variance image
+    // (normalized so the total budget matches spp * nPixels), so the next
+    // frame of a sequence spends its samples where the last one was noisy
+    // without a warmup pass. The map is applied unwarped: reprojection
+    // would need the prior frame's camera, which the scene description
+    // has no way to carry.
+    std::vector<int64_t> sampleBudget;
+    if (!importanceMapFile.empty()) {
+        Point2i mapRes;
+        std::unique_ptr<RGBSpectrum[]> map =
+            ReadImage(importanceMapFile, &mapRes);
+        if (map) {
+            std::vector<double> w(nPixels);
+            double wSum = 0;
+            for (int i = 0; i < nPixels; ++i) {
+                int x = (i % sampleExtent.x) * mapRes.x / sampleExtent.x;
+                int y = (i / sampleExtent.x) * mapRes.y / sampleExtent.y;
+                x = Clamp(x, 0, mapRes.x - 1);
+                y = Clamp(y, 0, mapRes.y - 1);
+                w[i] = map[x + y * mapRes.x].y() + 1e-4;
+                wSum += w[i];
+            }
+            double wMean = wSum / nPixels;
+            sampleBudget.resize(nPixels);
+            for (int i = 0; i < nPixels; ++i)
+                // Budgets cap at the sampler's samples per pixel: samplers
+                // can't be advanced past the sample count they were built
+                // for, so the map reallocates by finishing quiet pixels
+                // early rather than oversampling noisy ones.
+                sampleBudget[i] =
+                    Clamp((int64_t)std::lround(spp * w[i] / wMean),
+                          (int64_t)1, spp);
+        } else
+            Warning("Unable to read importance map \"%s\"; ignoring it.",
+                    importanceMapFile.c_str());
+    }
+
+    int64_t startSample = 0;
+    int64_t passSamples = std::min((int64_t)adaptiveMinSamples, spp);
+    ProgressReporter reporter(spp, "Rendering");
+    while (startSample < spp) {
+        ++nAdaptivePasses;
+        ParallelFor2D([&](Point2i tile) {
+            // Render one adaptive pass of the tile's active pixels
+            MemoryArena arena;
+            int seed = tile.y * nTiles.x + tile.x;
+            std::unique_ptr<Sampler> tileSampler = sampler->Clone(seed);
+            int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+            int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+            int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+            int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+            Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+            std::unique_ptr<FilmTile> filmTile =
+                camera->film->GetFilmTile(tileBounds);
+            for (Point2i pixel : tileBounds) {
+                {
+                    ProfilePhase pp(Prof::StartPixel);
+                    tileSampler->StartPixel(pixel);
+                }
+                if (!InsideExclusive(pixel, pixelBounds)) continue;
+                if (!pixelActive[pixelIndex(pixel)]) continue;
+                tileSampler->SetSampleNumber(startSample);
+                PixelStats &stats = pixelStats[pixelIndex(pixel)];
+                for (int64_t s = 0; s < passSamples; ++s) {
+                    // Render one sample of _pixel_, mirroring Render()
+                    CameraSample cameraSample =
+                        tileSampler->GetCameraSample(pixel);
+                    cameraSample.pFilm = camera->film->RemapToFilterSample(
+                        pixel, cameraSample.pFilm);
+                    RayDifferential ray;
+                    Float rayWeight =
+                        camera->GenerateRayDifferential(cameraSample, &ray);
+                    ray.ScaleDifferentials(
+                        1 / std::sqrt((Float)tileSampler->samplesPerPixel));
+                    ++nCameraRays;
+                    Spectrum L(0.f);
+                    if (rayWeight > 0) L = Li(ray, scene, *tileSampler, arena);
+                    if (L.HasNaNs() || L.y() < -1e-5 || std::isinf(L.y())) {
+                        LOG(ERROR) << StringPrintf(
+                            "Invalid radiance value returned for pixel "
+                            "(%d, %d), sample %d. Setting to black.",
+                            pixel.x, pixel.y,
+                            (int)tileSampler->CurrentSampleNumber());
+                        L = Spectrum(0.f);
+                    }
+                    filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+                    if (denoisingAOVs)
+                        PublishDenoisingAOVs(filmTile.get(),
+                                             cameraSample.pFilm, L);
+                    // Update the pixel's luminance moments
+                    stats.sum += L.y();
+                    stats.sumSq += (double)L.y() * L.y();
+                    ++stats.n;
+                    arena.Reset();
+                    if (!tileSampler->StartNextSample()) break;
+                }
+            }
+            camera->film->MergeFilmTile(std::move(filmTile));
+        }, nTiles);
+        reporter.Update(passSamples);
+        startSample += passSamples;
+        if (startSample >= spp) break;
+
+        // Deactivate pixels whose relative error meets the target or
+        // whose importance budget is spent
+        bool anyActive = false;
+        for (int i = 0; i < nPixels; ++i) {
+            if (!pixelActive[i]) continue;
+            if (!sampleBudget.empty() && startSample >= sampleBudget[i]) {
+                pixelActive[i] = 0;
+                continue;
+            }
+            const PixelStats &stats = pixelStats[i];
+            if (adaptiveTargetError > 0 && stats.n > 1) {
+                double mean = stats.sum / stats.n;
+                double variance =
+                    (stats.sumSq - stats.sum * stats.sum / stats.n) /
+                    (stats.n - 1);
+                double relError = std::sqrt(std::max(0., variance) / stats.n) /
+                                  std::max(mean, 1e-3);
+                if (relError <= adaptiveTargetError) {
+                    pixelActive[i] = 0;
+                    ++nConvergedPixels;
+                    continue;
+                }
+            }
+            anyActive = true;
+        }
+        if (!anyActive) break;
+
+        // Double the per-pass sample count for the remaining noisy pixels
+        passSamples = std::min(2 * passSamples, spp - startSample);
+    }
+    nAdaptivePixels += pixelBounds.Area();
+    reporter.Done();
+    LOG(INFO) << "Rendering finished";
+    camera->film->WriteImage();
+}
+
 Spectrum SamplerIntegrator::SpecularReflect(
     const RayDifferential &ray, const SurfaceInteraction &isect,
     const Scene &scene, Sampler &sampler, MemoryArena &arena, int depth) const {
+    // Differential propagation below reads the hit's footprint
+    isect.EnsureDifferentials();
     // Compute specular reflection direction _wi_ and BSDF value
     Vector3f wo = isect.wo, wi;
     Float pdf;
@@ -379,6 +1209,8 @@ Spectrum SamplerIntegrator::SpecularReflect(
 Spectrum SamplerIntegrator::SpecularTransmit(
     const RayDifferential &ray, const SurfaceInteraction &isect,
     const Scene &scene, Sampler &sampler, MemoryArena &arena, int depth) const {
+    // Differential propagation below reads the hit's footprint
+    isect.EnsureDifferentials();
     Vector3f wo = isect.wo, wi;
     Float pdf;
     const Point3f &p = isect.p;
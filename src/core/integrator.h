@@ -49,6 +49,19 @@
 
 namespace pbrt {
 
+class FilmTile;
+
+// Per-sample denoising features, filled by integrators' Li()
+// implementations at the first camera hit; the render loops publish them
+// into the film's AOV buffers when denoising AOVs are enabled.
+struct DenoisingFeatures {
+    bool valid;
+    Float albedo[3];
+    Float normal[3];
+};
+extern PBRT_THREAD_LOCAL DenoisingFeatures denoisingFeatures;
+extern bool denoisingAOVsEnabled;
+
 // Integrator Declarations
 class Integrator {
   public:
@@ -64,12 +77,16 @@ Spectrum UniformSampleAllLights(const Interaction &it, const Scene &scene,
 Spectrum UniformSampleOneLight(const Interaction &it, const Scene &scene,
                                MemoryArena &arena, Sampler &sampler,
                                bool handleMedia = false,
-                               const Distribution1D *lightDistrib = nullptr);
+                               const Distribution1D *lightDistrib = nullptr,
+                               RayStream *shadowRays = nullptr,
+                               std::vector<Spectrum> *shadowLd = nullptr);
 Spectrum EstimateDirect(const Interaction &it, const Point2f &uShading,
                         const Light &light, const Point2f &uLight,
                         const Scene &scene, Sampler &sampler,
                         MemoryArena &arena, bool handleMedia = false,
-                        bool specular = false);
+                        bool specular = false,
+                        RayStream *shadowRays = nullptr,
+                        std::vector<Spectrum> *shadowLd = nullptr);
 std::unique_ptr<Distribution1D> ComputeLightPowerDistribution(
     const Scene &scene);
 
@@ -94,15 +111,65 @@ class SamplerIntegrator : public Integrator {
                               const SurfaceInteraction &isect,
                               const Scene &scene, Sampler &sampler,
                               MemoryArena &arena, int depth) const;
+    // Render in passes, giving additional samples only to pixels whose
+    // estimated relative error still exceeds _targetError_.
+    void SetAdaptiveSampling(Float targetError, int minSamples) {
+        adaptiveTargetError = targetError;
+        adaptiveMinSamples = minSamples;
+    }
+    // Emit albedo, normal, and sample-variance AOVs for denoisers
+    void EnableDenoisingAOVs() { denoisingAOVs = true; }
+    // Steer per-pixel sample budgets by a prior frame's variance image
+    // (e.g. the _variance denoising AOV of the previous frame in a
+    // sequence); see RenderAdaptive()
+    void SetImportanceMap(const std::string &filename) {
+        importanceMapFile = filename;
+    }
+    // Override the automatic tile granularity (the integrator "tilesize"
+    // parameter); zero keeps the adaptive choice
+    void SetTileSize(int tileSize) { requestedTileSize = tileSize; }
 
   protected:
     // SamplerIntegrator Protected Data
     std::shared_ptr<const Camera> camera;
+    std::shared_ptr<Sampler> sampler;
+    const Bounds2i pixelBounds;
 
   private:
+    // SamplerIntegrator Private Methods
+    void RenderAdaptive(const Scene &scene);
+    void RenderCheckpointed(const Scene &scene);
+    // Tile granularity: the integrator's "tilesize" parameter when set,
+    // otherwise sized so each worker thread gets roughly 64 tiles -
+    // fine-grained enough that slow tiles in tiny deep frames don't
+    // straggle, coarse enough that giant cheap frames don't drown in
+    // scheduling overhead.
+    int ChooseTileSize(const Vector2i &sampleExtent) const;
+    int requestedTileSize = 0;
+    // Distributed rendering (--coordinator / --worker): the coordinator
+    // hands out tile indices over TCP and merges streamed-back FilmTile
+    // payloads; workers fetch, render, and submit tiles. Tile seeds match
+    // the single-process path, so the merged image is identical.
+    void RenderDistributed(const Scene &scene);
+    // Render the tile with the given index into a FilmTile; shared by the
+    // local and distributed paths.
+    std::unique_ptr<FilmTile> RenderDistributedTile(const Scene &scene,
+                                                    int tileIndex,
+                                                    const Point2i &nTiles,
+                                                    const Bounds2i &sampleBounds,
+                                                    int tileSize);
+
     // SamplerIntegrator Private Data
-    std::shared_ptr<Sampler> sampler;
-    const Bounds2i pixelBounds;
+    Float adaptiveTargetError = 0;
+    int adaptiveMinSamples = 16;
+    std::string importanceMapFile;
+
+  protected:
+    // Denoising AOV state shared with the render loop variants
+    bool denoisingAOVs = false;
+    int albedoAOV = -1, normalAOV = -1, varianceAOV = -1;
+    void PublishDenoisingAOVs(FilmTile *filmTile, const Point2f &pFilm,
+                              const Spectrum &L) const;
 };
 
 }  // namespace pbrt
@@ -101,18 +101,39 @@ void SurfaceInteraction::ComputeScatteringFunctions(const RayDifferential &ray,
 void SurfaceInteraction::ComputeDifferentials(
     const RayDifferential &ray) const {
     if (ray.hasDifferentials) {
+        // Record the differential rays and defer the plane intersections
+        // and linear solves to EnsureDifferentials(): most secondary hits
+        // never request a filter footprint, so the work usually never
+        // happens.
+        diffRxOrigin = ray.rxOrigin;
+        diffRyOrigin = ray.ryOrigin;
+        diffRxDirection = ray.rxDirection;
+        diffRyDirection = ray.ryDirection;
+        differentialsComputed = false;
+        return;
+    }
+    dudx = dvdx = 0;
+    dudy = dvdy = 0;
+    dpdx = dpdy = Vector3f(0, 0, 0);
+    differentialsComputed = true;
+}
+
+void SurfaceInteraction::EnsureDifferentials() const {
+    if (differentialsComputed) return;
+    differentialsComputed = true;
+    {
         // Estimate screen space change in $\pt{}$ and $(u,v)$
 
         // Compute auxiliary intersection points with plane
         Float d = Dot(n, Vector3f(p.x, p.y, p.z));
-        Float tx =
-            -(Dot(n, Vector3f(ray.rxOrigin)) - d) / Dot(n, ray.rxDirection);
+        Float tx = -(Dot(n, Vector3f(diffRxOrigin)) - d) /
+                   Dot(n, diffRxDirection);
         if (std::isinf(tx) || std::isnan(tx)) goto fail;
-        Point3f px = ray.rxOrigin + tx * ray.rxDirection;
-        Float ty =
-            -(Dot(n, Vector3f(ray.ryOrigin)) - d) / Dot(n, ray.ryDirection);
+        Point3f px = diffRxOrigin + tx * diffRxDirection;
+        Float ty = -(Dot(n, Vector3f(diffRyOrigin)) - d) /
+                   Dot(n, diffRyDirection);
         if (std::isinf(ty) || std::isnan(ty)) goto fail;
-        Point3f py = ray.ryOrigin + ty * ray.ryDirection;
+        Point3f py = diffRyOrigin + ty * diffRyDirection;
         dpdx = px - p;
         dpdy = py - p;
 
@@ -138,12 +159,12 @@ void SurfaceInteraction::ComputeDifferentials(
         Float By[2] = {py[dim[0]] - p[dim[0]], py[dim[1]] - p[dim[1]]};
         if (!SolveLinearSystem2x2(A, Bx, &dudx, &dvdx)) dudx = dvdx = 0;
         if (!SolveLinearSystem2x2(A, By, &dudy, &dvdy)) dudy = dvdy = 0;
-    } else {
-    fail:
-        dudx = dvdx = 0;
-        dudy = dvdy = 0;
-        dpdx = dpdy = Vector3f(0, 0, 0);
+        return;
     }
+fail:
+    dudx = dvdx = 0;
+    dudy = dvdy = 0;
+    dpdx = dpdy = Vector3f(0, 0, 0);
 }
 
 Spectrum SurfaceInteraction::Le(const Vector3f &w) const {
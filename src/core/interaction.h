@@ -149,6 +149,19 @@ class SurfaceInteraction : public Interaction {
     BSSRDF *bssrdf = nullptr;
     mutable Vector3f dpdx, dpdy;
     mutable Float dudx = 0, dvdx = 0, dudy = 0, dvdy = 0;
+    // Lazy ray differentials: ComputeDifferentials() records the
+    // differential rays here and EnsureDifferentials() runs the plane
+    // intersections and linear solves on first demand (from the texture
+    // mapping paths and the other footprint consumers); hits whose
+    // textures are never filtered skip the solve entirely.
+    void EnsureDifferentials() const;
+    mutable Point3f diffRxOrigin, diffRyOrigin;
+    mutable Vector3f diffRxDirection, diffRyDirection;
+    mutable bool differentialsComputed = true;
+    // Sub-footprint slope variance of the bump map, recorded by
+    // Material::Bump(); microfacet materials fold it into their roughness
+    // so filtered-away bump detail becomes roughness instead of aliasing
+    Float bumpSlopeVariance = 0;
 
     // Added after book publication. Shapes can optionally provide a face
     // index with an intersection point for use in Ptex texture lookups.
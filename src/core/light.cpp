@@ -34,9 +34,13 @@
 // core/light.cpp*
 #include "light.h"
 #include "scene.h"
+#include "sampler.h"
 #include "sampling.h"
 #include "stats.h"
+#include "parallel.h"
 #include "paramset.h"
+#include <atomic>
+#include <mutex>
 
 namespace pbrt {
 
@@ -60,15 +64,124 @@ bool VisibilityTester::Unoccluded(const Scene &scene) const {
     return !scene.IntersectP(p0.SpawnRayTo(p1));
 }
 
+STAT_PERCENT("Lights/Transmittance cache hits", nTrCacheHits, nTrCacheQueries);
+
+// Voxel-pair transmittance cache, enabled with --trcache: shadow rays whose
+// endpoints fall into the same pair of scene voxels share converged
+// transmittance estimates. Entries serve their running mean only once they
+// have enough samples and a small standard error, and a fraction of lookups
+// still recompute so the estimates keep refining; gray transmittance only,
+// which covers the tracked heterogeneous media.
+class TransmittanceCache {
+  public:
+    bool Get(const Scene &scene, const Point3f &p0, const Point3f &p1,
+             Sampler &sampler, Float *tr) const {
+        std::call_once(initOnce, [this]() {
+            entries = std::vector<Entry>(tableSize);
+        });
+        ++nTrCacheQueries;
+        // Recompute a fraction of lookups so entries keep converging
+        if (sampler.Get1D() < 1.f / 16.f) return false;
+        int slot = FindSlot(Key(scene, p0, p1), false);
+        if (slot < 0) return false;
+        const Entry &e = entries[slot];
+        int n = e.count.load(std::memory_order_acquire);
+        if (n < minSamples) return false;
+        Float mean = Float(e.sum) / n;
+        Float variance =
+            std::max((Float)0, Float(e.sumSq) / n - mean * mean);
+        // Serve the cache only once the mean's standard error is small
+        // relative to the estimate
+        if (std::sqrt(variance / n) > .05f * std::max(mean, (Float).01))
+            return false;
+        ++nTrCacheHits;
+        *tr = mean;
+        return true;
+    }
+    void Add(const Scene &scene, const Point3f &p0, const Point3f &p1,
+             Float tr) {
+        std::call_once(initOnce, [this]() {
+            entries = std::vector<Entry>(tableSize);
+        });
+        int slot = FindSlot(Key(scene, p0, p1), true);
+        if (slot < 0) return;
+        Entry &e = entries[slot];
+        e.sum.Add(tr);
+        e.sumSq.Add(tr * tr);
+        e.count.fetch_add(1, std::memory_order_release);
+    }
+
+  private:
+    // TransmittanceCache Private Declarations
+    static PBRT_CONSTEXPR int voxelRes = 32;
+    static PBRT_CONSTEXPR int logTableSize = 20;
+    static PBRT_CONSTEXPR int minSamples = 32;
+    struct Entry {
+        std::atomic<uint64_t> key{0};
+        AtomicFloat sum, sumSq;
+        std::atomic<int> count{0};
+    };
+
+    // TransmittanceCache Private Methods
+    static uint64_t Key(const Scene &scene, const Point3f &p0,
+                        const Point3f &p1) {
+        auto voxel = [&](const Point3f &p) -> uint64_t {
+            Vector3f o = scene.WorldBound().Offset(p);
+            uint64_t v = 0;
+            for (int i = 0; i < 3; ++i)
+                v = (v << 5) |
+                    (uint64_t)Clamp(int(o[i] * voxelRes), 0, voxelRes - 1);
+            return v;
+        };
+        // Nonzero by construction so that zero can mark empty slots
+        return (voxel(p0) << 30) | voxel(p1) | (1ull << 60);
+    }
+    int FindSlot(uint64_t key, bool insert) const {
+        uint64_t h = key * 0x9e3779b97f4a7c15ull;
+        int slot = h >> (64 - logTableSize);
+        for (int probe = 0; probe < 8; ++probe) {
+            int i = (slot + probe) & (tableSize - 1);
+            uint64_t stored = entries[i].key.load(std::memory_order_acquire);
+            if (stored == key) return i;
+            if (stored == 0) {
+                if (!insert) return -1;
+                uint64_t expected = 0;
+                if (entries[i].key.compare_exchange_strong(expected, key))
+                    return i;
+                if (expected == key) return i;
+            }
+        }
+        return -1;
+    }
+
+    // TransmittanceCache Private Data
+    static PBRT_CONSTEXPR int tableSize = 1 << logTableSize;
+    // Allocated on first use so renders without --trcache pay nothing
+    mutable std::once_flag initOnce;
+    mutable std::vector<Entry> entries;
+};
+
+static TransmittanceCache transmittanceCache;
+
 Spectrum VisibilityTester::Tr(const Scene &scene, Sampler &sampler) const {
+    // Serve converged cached transmittance when the cache is enabled
+    if (PbrtOptions.transmittanceCache) {
+        Float cached;
+        if (transmittanceCache.Get(scene, p0.p, p1.p, sampler, &cached))
+            return Spectrum(cached);
+    }
+
     Ray ray(p0.SpawnRayTo(p1));
     Spectrum Tr(1.f);
     while (true) {
         SurfaceInteraction isect;
         bool hitSurface = scene.Intersect(ray, &isect);
         // Handle opaque surface along ray's path
-        if (hitSurface && isect.primitive->GetMaterial() != nullptr)
+        if (hitSurface && isect.primitive->GetMaterial() != nullptr) {
+            if (PbrtOptions.transmittanceCache)
+                transmittanceCache.Add(scene, p0.p, p1.p, 0);
             return Spectrum(0.0f);
+        }
 
         // Update transmittance for current ray segment
         if (ray.medium) Tr *= ray.medium->Tr(ray, sampler);
@@ -77,6 +190,9 @@ Spectrum VisibilityTester::Tr(const Scene &scene, Sampler &sampler) const {
         if (!hitSurface) break;
         ray = isect.SpawnRayTo(p1);
     }
+    // Record gray transmittance results for future shadow rays
+    if (PbrtOptions.transmittanceCache && Spectrum(Tr.y()) == Tr)
+        transmittanceCache.Add(scene, p0.p, p1.p, Tr.y());
     return Tr;
 }
 
@@ -77,6 +77,10 @@ class Light {
                                Float *pdfDir) const = 0;
     virtual void Pdf_Le(const Ray &ray, const Normal3f &nLight, Float *pdfPos,
                         Float *pdfDir) const = 0;
+    // Returns a bound on where the light emits from, used to build light
+    // sampling hierarchies; lights without a meaningful spatial extent
+    // (distant and infinite lights) return the default degenerate bounds.
+    virtual Bounds3f WorldBound() const { return Bounds3f(); }
 
     // Light Public Data
     const int flags;
@@ -39,6 +39,7 @@
 #include "scene.h"
 #include "stats.h"
 #include "integrator.h"
+#include <algorithm>
 #include <numeric>
 
 namespace pbrt {
@@ -56,6 +57,15 @@ std::unique_ptr<LightDistribution> CreateLightSampleDistribution(
     else if (name == "spatial")
         return std::unique_ptr<LightDistribution>{
             new SpatialLightDistribution(scene)};
+    else if (name == "spatialcull")
+        // Spatial distribution with the sampled visibility-culling pass;
+        // opt-in, since probes through small openings can all miss and
+        // zero a light that does contribute
+        return std::unique_ptr<LightDistribution>{
+            new SpatialLightDistribution(scene, 64, true)};
+    else if (name == "lightbvh")
+        return std::unique_ptr<LightDistribution>{
+            new LightBVHDistribution(scene)};
     else {
         Error(
             "Light sample distribution type \"%s\" unknown. Using \"spatial\".",
@@ -65,6 +75,134 @@ std::unique_ptr<LightDistribution> CreateLightSampleDistribution(
     }
 }
 
+// LightBVHDistribution Method Definitions
+LightBVHDistribution::LightBVHDistribution(const Scene &scene)
+    : scene(scene) {
+    // Partition lights into spatially bounded and unbounded sets
+    std::vector<std::pair<int, Bounds3f>> boundedLights;
+    for (size_t i = 0; i < scene.lights.size(); ++i) {
+        Bounds3f b = scene.lights[i]->WorldBound();
+        Float power = scene.lights[i]->Power().y();
+        if (b.pMin.x > b.pMax.x) {
+            // Degenerate bounds mark lights without spatial extent
+            unboundedLights.push_back(i);
+            unboundedPower += power;
+        } else {
+            boundedLights.push_back({(int)i, b});
+            boundedPower += power;
+        }
+    }
+
+    // Build the light cluster hierarchy over the bounded lights
+    if (!boundedLights.empty()) {
+        clusters.reserve(2 * boundedLights.size());
+        root = buildCluster(boundedLights, 0, boundedLights.size());
+    }
+
+    // Allocate the lazily computed per-voxel distribution grid
+    for (int i = 0; i < 3; ++i) nVoxels[i] = 16;
+    int totalVoxels = nVoxels[0] * nVoxels[1] * nVoxels[2];
+    voxelDistribs.resize(totalVoxels);
+    voxelOnce = std::vector<std::once_flag>(totalVoxels);
+}
+
+int LightBVHDistribution::buildCluster(
+    std::vector<std::pair<int, Bounds3f>> &lights, int start, int end) {
+    int nodeIndex = clusters.size();
+    clusters.push_back(LightCluster());
+    if (end - start == 1) {
+        // Create light cluster leaf
+        clusters[nodeIndex].bounds = lights[start].second;
+        clusters[nodeIndex].power =
+            scene.lights[lights[start].first]->Power().y();
+        clusters[nodeIndex].lightIndex = lights[start].first;
+        return nodeIndex;
+    }
+    // Split the lights at the median along the widest bounds axis
+    Bounds3f centroidBounds;
+    for (int i = start; i < end; ++i)
+        centroidBounds = Union(
+            centroidBounds, lights[i].second.pMin * 0.5 +
+                                Vector3f(lights[i].second.pMax * 0.5));
+    int dim = centroidBounds.MaximumExtent();
+    int mid = (start + end) / 2;
+    std::nth_element(&lights[start], &lights[mid], &lights[end - 1] + 1,
+                     [dim](const std::pair<int, Bounds3f> &a,
+                           const std::pair<int, Bounds3f> &b) {
+                         return a.second.pMin[dim] + a.second.pMax[dim] <
+                                b.second.pMin[dim] + b.second.pMax[dim];
+                     });
+    int c0 = buildCluster(lights, start, mid);
+    int c1 = buildCluster(lights, mid, end);
+    clusters[nodeIndex].bounds =
+        Union(clusters[c0].bounds, clusters[c1].bounds);
+    clusters[nodeIndex].power = clusters[c0].power + clusters[c1].power;
+    clusters[nodeIndex].children[0] = c0;
+    clusters[nodeIndex].children[1] = c1;
+    return nodeIndex;
+}
+
+// Distribute _prob_ down the cluster hierarchy, splitting it between
+// children in proportion to their power over squared distance to _p_
+void LightBVHDistribution::splitImportance(int node, Float prob,
+                                           const Point3f &p,
+                                           std::vector<Float> *probs) const {
+    const LightCluster &c = clusters[node];
+    if (c.lightIndex >= 0) {
+        (*probs)[c.lightIndex] += prob;
+        return;
+    }
+    Float imp[2];
+    for (int i = 0; i < 2; ++i) {
+        const LightCluster &child = clusters[c.children[i]];
+        // Use the distance to the cluster bounds, clamped to the cluster's
+        // own extent so that points inside a cluster don't see infinite
+        // importance
+        Float d2 = DistanceSquared(p, child.bounds.pMin +
+                                          .5 * child.bounds.Diagonal());
+        d2 = std::max(d2, .25f * child.bounds.Diagonal().LengthSquared());
+        imp[i] = child.power / std::max(d2, (Float)1e-6);
+    }
+    Float sum = imp[0] + imp[1];
+    if (sum == 0) {
+        imp[0] = imp[1] = 1;
+        sum = 2;
+    }
+    splitImportance(c.children[0], prob * imp[0] / sum, p, probs);
+    splitImportance(c.children[1], prob * imp[1] / sum, p, probs);
+}
+
+const Distribution1D *LightBVHDistribution::Lookup(const Point3f &p) const {
+    // Find the voxel containing _p_ and build its distribution on first use
+    Vector3f offset = scene.WorldBound().Offset(p);
+    Point3i pi;
+    for (int i = 0; i < 3; ++i)
+        pi[i] = Clamp(int(offset[i] * nVoxels[i]), 0, nVoxels[i] - 1);
+    int voxelIndex = pi.x + nVoxels[0] * (pi.y + nVoxels[1] * pi.z);
+    std::call_once(voxelOnce[voxelIndex], [this, voxelIndex, pi]() {
+        // Compute per-light probabilities for the voxel's center point
+        Point3f pCenter = scene.WorldBound().Lerp(Point3f(
+            (pi.x + .5f) / nVoxels[0], (pi.y + .5f) / nVoxels[1],
+            (pi.z + .5f) / nVoxels[2]));
+        std::vector<Float> probs(scene.lights.size(), Float(0));
+        // Split probability between the hierarchy and the unbounded lights
+        // by total power
+        Float pBounded =
+            boundedPower + unboundedPower > 0
+                ? boundedPower / (boundedPower + unboundedPower)
+                : 0;
+        if (root >= 0) splitImportance(root, pBounded, pCenter, &probs);
+        for (int li : unboundedLights)
+            probs[li] = unboundedPower > 0
+                            ? (1 - pBounded) *
+                                  scene.lights[li]->Power().y() / unboundedPower
+                            : 0;
+        voxelDistribs[voxelIndex].reset(
+            new Distribution1D(&probs[0], int(probs.size())));
+    });
+    return voxelDistribs[voxelIndex].get();
+}
+
 UniformLightDistribution::UniformLightDistribution(const Scene &scene) {
     std::vector<Float> prob(scene.lights.size(), Float(1));
     distrib.reset(new Distribution1D(&prob[0], int(prob.size())));
@@ -75,7 +213,9 @@ const Distribution1D *UniformLightDistribution::Lookup(const Point3f &p) const {
 }
 
 PowerLightDistribution::PowerLightDistribution(const Scene &scene)
-    : distrib(ComputeLightPowerDistribution(scene)) {}
+    : distrib(ComputeLightPowerDistribution(scene)) {
+    if (distrib) distrib->BuildAliasTable();
+}
 
 const Distribution1D *PowerLightDistribution::Lookup(const Point3f &p) const {
     return distrib.get();
@@ -87,6 +227,7 @@ const Distribution1D *PowerLightDistribution::Lookup(const Point3f &p) const {
 STAT_COUNTER("SpatialLightDistribution/Distributions created", nCreated);
 STAT_RATIO("SpatialLightDistribution/Lookups per distribution", nLookups, nDistributions);
 STAT_INT_DISTRIBUTION("SpatialLightDistribution/Hash probes per lookup", nProbesPerLookup);
+STAT_COUNTER("SpatialLightDistribution/Voxel-light pairs culled", nPairsCulled);
 
 // Voxel coordinates are packed into a uint64_t for hash table lookups;
 // 10 bits are allocated to each coordinate.  invalidPackedPos is an impossible
@@ -94,8 +235,9 @@ STAT_INT_DISTRIBUTION("SpatialLightDistribution/Hash probes per lookup", nProbes
 static const uint64_t invalidPackedPos = 0xffffffffffffffff;
 
 SpatialLightDistribution::SpatialLightDistribution(const Scene &scene,
-                                                   int maxVoxels)
-    : scene(scene) {
+                                                   int maxVoxels,
+                                                   bool cullOccluded)
+    : scene(scene), cullOccluded(cullOccluded) {
     // Compute the number of voxels so that the widest scene bounding box
     // dimension has maxVoxels voxels and the other dimensions have a number
     // of voxels so that voxels are roughly cube shaped.
@@ -180,20 +322,15 @@ const Distribution1D *SpatialLightDistribution::Lookup(const Point3f &p) const {
             // sampling distribution available.
             Distribution1D *dist = entry.distribution.load(std::memory_order_acquire);
             if (dist == nullptr) {
-                // Rarely, another thread will have already done a lookup
-                // at this point, found that there isn't a sampling
-                // distribution, and will already be computing the
-                // distribution for the point.  In this case, we spin until
-                // the sampling distribution is ready.  We assume that this
-                // is a rare case, so don't do anything more sophisticated
-                // than spinning.
+                // Rarely, another thread has claimed this voxel but hasn't
+                // finished computing its distribution. Rather than spin
+                // waiting, optimistically compute our own copy and discard
+                // it when the render finishes; the duplicated work is
+                // bounded while spinning is not.
                 ProfilePhase _(Prof::LightDistribSpinWait);
-                while ((dist = entry.distribution.load(std::memory_order_acquire)) ==
-                       nullptr)
-                    // spin :-(. If we were fancy, we'd have any threads
-                    // that hit this instead help out with computing the
-                    // distribution for the voxel...
-                    ;
+                dist = ComputeDistribution(pi);
+                std::lock_guard<std::mutex> lock(orphanMutex);
+                orphans.push_back(std::unique_ptr<Distribution1D>(dist));
             }
             // We have a valid sampling distribution.
             ReportValue(nProbesPerLookup, nProbes);
@@ -278,6 +415,55 @@ SpatialLightDistribution::ComputeDistribution(Point3i pi) const {
         }
     }
 
+    // Visibility culling pass ("spatialcull" only): for each light that
+    // picked up nonzero contribution above, trace a handful of shadow rays
+    // between points in the voxel and points on the light. If every one of
+    // them is blocked, the light is probably behind a wall or on another
+    // floor, and giving it zero probability here saves a doomed shadow ray
+    // at every shading point that would otherwise sample it. This is a
+    // sampled test, not a proof: a light seen only through a small opening
+    // can lose all of its probes and vanish from the voxel, which is why
+    // the pass is opt-in and why delta lights - whose lost contribution
+    // BSDF sampling can never recover - are never culled.
+    const int nVisSamples = 16;
+    std::vector<bool> culled(scene.lights.size(), false);
+    size_t nCulled = 0;
+    for (size_t j = 0; cullOccluded && j < scene.lights.size(); ++j) {
+        if (lightContrib[j] == 0) continue;
+        if (IsDeltaLight(scene.lights[j]->flags)) continue;
+        int nAttempts = 0, nVisible = 0;
+        for (int i = 0; i < nVisSamples && nVisible == 0; ++i) {
+            // Continue the Halton sequence used above so the visibility
+            // probes don't revisit the same voxel points and light samples.
+            int s = nSamples + i;
+            Point3f po = voxelBounds.Lerp(
+                Point3f(RadicalInverse(0, s), RadicalInverse(1, s),
+                        RadicalInverse(2, s)));
+            Interaction intr(po, Normal3f(), Vector3f(), Vector3f(1, 0, 0),
+                             0 /* time */, MediumInterface());
+            Point2f u(RadicalInverse(3, s), RadicalInverse(4, s));
+            Float pdf;
+            Vector3f wi;
+            VisibilityTester vis;
+            Spectrum Li = scene.lights[j]->Sample_Li(intr, u, &wi, &pdf, &vis);
+            if (pdf == 0 || Li.IsBlack()) continue;
+            ++nAttempts;
+            if (vis.Unoccluded(scene)) ++nVisible;
+        }
+        // Only cull given a reasonable amount of evidence; a single
+        // blocked ray says little about the rest of the voxel.
+        if (nAttempts >= nVisSamples / 2 && nVisible == 0) {
+            culled[j] = true;
+            ++nCulled;
+            ++nPairsCulled;
+        }
+    }
+    // If the probes somehow blocked every light (e.g. a voxel buried
+    // inside geometry), fall back to not culling at all rather than
+    // producing an unsampleable all-zero distribution.
+    if (nCulled == scene.lights.size())
+        std::fill(culled.begin(), culled.end(), false);
+
     // We don't want to leave any lights with a zero probability; it's
     // possible that a light contributes to points in the voxel even though
     // we didn't find such a point when sampling above.  Therefore, compute
@@ -289,8 +475,8 @@ SpatialLightDistribution::ComputeDistribution(Point3i pi) const {
     Float minContrib = (avgContrib > 0) ? .001 * avgContrib : 1;
     for (size_t i = 0; i < lightContrib.size(); ++i) {
         VLOG(2) << "Voxel pi = " << pi << ", light " << i << " contrib = "
-                << lightContrib[i];
-        lightContrib[i] = std::max(lightContrib[i], minContrib);
+                << lightContrib[i] << (culled[i] ? " (culled)" : "");
+        lightContrib[i] = culled[i] ? 0 : std::max(lightContrib[i], minContrib);
     }
     LOG(INFO) << "Initialized light distribution in voxel pi= " <<  pi <<
         ", avgContrib = " << avgContrib;
@@ -93,13 +93,53 @@ class PowerLightDistribution : public LightDistribution {
     std::unique_ptr<Distribution1D> distrib;
 };
 
+// Samples lights through a bounding volume hierarchy built over the
+// lights' world bounds and powers. Each voxel of a grid over the scene
+// lazily gets a sampling distribution whose per-light probabilities come
+// from walking the hierarchy and splitting probability between clusters
+// according to their power over squared distance, so nearby dim lights
+// compete fairly with distant bright ones even with tens of thousands of
+// emitters. Lights without spatial bounds (infinite, distant) are sampled
+// by power alongside the hierarchy.
+class LightBVHDistribution : public LightDistribution {
+  public:
+    LightBVHDistribution(const Scene &scene);
+    const Distribution1D *Lookup(const Point3f &p) const;
+
+  private:
+    // LightBVHDistribution Private Declarations
+    struct LightCluster {
+        Bounds3f bounds;
+        Float power;
+        int lightIndex = -1;  // leaf: index into _scene.lights_
+        int children[2] = {-1, -1};
+    };
+
+    // LightBVHDistribution Private Methods
+    int buildCluster(std::vector<std::pair<int, Bounds3f>> &lights, int start,
+                     int end);
+    void splitImportance(int node, Float prob, const Point3f &p,
+                         std::vector<Float> *prob_out) const;
+
+    const Scene &scene;
+    std::vector<LightCluster> clusters;
+    int root = -1;
+    std::vector<int> unboundedLights;
+    Float unboundedPower = 0, boundedPower = 0;
+    // Lazily computed per-voxel distributions over the scene bounds
+    int nVoxels[3];
+    mutable std::vector<std::unique_ptr<Distribution1D>> voxelDistribs;
+    mutable std::vector<std::once_flag> voxelOnce;
+};
+
 // A spatially-varying light distribution that adjusts the probability of
 // sampling a light source based on an estimate of its contribution to a
 // region of space.  A fixed voxel grid is imposed over the scene bounds
 // and a sampling distribution is computed as needed for each voxel.
 class SpatialLightDistribution : public LightDistribution {
   public:
-    SpatialLightDistribution(const Scene &scene, int maxVoxels = 64);
+    SpatialLightDistribution(const Scene &scene, int maxVoxels = 64,
+                             bool cullOccluded = false);
     ~SpatialLightDistribution();
     const Distribution1D *Lookup(const Point3f &p) const;
 
@@ -110,6 +150,10 @@ class SpatialLightDistribution : public LightDistribution {
 
     const Scene &scene;
     int nVoxels[3];
+    // Zero the probability of lights whose visibility probes all fail
+    // ("spatialcull" strategy); opt-in because sampled occlusion can
+    // wrongly eliminate lights seen through small openings
+    const bool cullOccluded;
 
     // The hash table is a fixed number of HashEntry structs (where we
     // allocate more than enough entries in the SpatialLightDistribution
@@ -122,6 +166,10 @@ class SpatialLightDistribution : public LightDistribution {
     };
     mutable std::unique_ptr<HashEntry[]> hashTable;
     size_t hashTableSize;
+    // Distributions computed optimistically while another thread owned the
+    // voxel's slot; kept alive here instead of spin-waiting on the owner
+    mutable std::mutex orphanMutex;
+    mutable std::vector<std::unique_ptr<Distribution1D>> orphans;
 };
 
 }  // namespace pbrt
@@ -33,6 +33,8 @@
 
 // core/lowdiscrepancy.cpp*
 #include "lowdiscrepancy.h"
+#include <atomic>
+#include <mutex>
 
 namespace pbrt {
 
@@ -424,7 +426,70 @@ ScrambledRadicalInverseSpecialized(const uint16_t *perm, uint64_t a) {
 }
 
 // Low Discrepancy Function Definitions
+// Tabulated radical inverse: for each of the first _nRITablePrimes_ primes
+// (skipping base 2, which already inverts in constant time via bit
+// reversal), precompute the radical inverse of every K-digit low-order
+// block, with K chosen so each table has at most 4096 entries. The inverse
+// of an arbitrary index then combines block fetches arithmetically -
+// inv(lo + hi * b^K) = table[lo] + inv(hi) / b^K - replacing the per-digit
+// peel with one fetch per 4096-fold of index magnitude. Values can differ
+// from the digit loop in the last ulp (float block sums versus one exact
+// integer reversal), which is harmless for sample generation.
+static PBRT_CONSTEXPR int nRITablePrimes = 128;
+struct RITable {
+    uint32_t size;
+    Float invSize;
+    std::vector<Float> values;
+};
+static std::vector<RITable> riTables;
+static std::once_flag riTablesOnce;
+
+static void InitRadicalInverseTables() {
+    riTables.resize(nRITablePrimes);
+    for (int i = 1; i < nRITablePrimes; ++i) {
+        uint32_t base = Primes[i];
+        uint32_t size = base;
+        while (size * (uint64_t)base <= 4096) size *= base;
+        RITable &table = riTables[i];
+        table.size = size;
+        table.invSize = (Float)1 / (Float)size;
+        table.values.resize(size);
+        for (uint32_t a = 0; a < size; ++a) {
+            // Digit-peel reference implementation, used only at setup
+            Float invBase = (Float)1 / (Float)base, invBaseN = 1;
+            uint64_t reversedDigits = 0, v = a;
+            while (v) {
+                uint64_t next = v / base;
+                reversedDigits = reversedDigits * base + (v - next * base);
+                invBaseN *= invBase;
+                v = next;
+            }
+            // Scale so that the block contributes as the low-order digits
+            // of a full K-digit group
+            uint32_t nDigits = 0;
+            for (uint32_t s = size; s > 1; s /= base) ++nDigits;
+            uint64_t full = reversedDigits;
+            uint32_t aDigits = 0;
+            for (uint64_t s = a; s > 0; s /= base) ++aDigits;
+            for (uint32_t d = aDigits; d < nDigits; ++d) full *= base;
+            table.values[a] = full * table.invSize;
+        }
+    }
+}
+
 Float RadicalInverse(int baseIndex, uint64_t a) {
+    if (baseIndex > 0 && baseIndex < nRITablePrimes) {
+        std::call_once(riTablesOnce, InitRadicalInverseTables);
+        const RITable &table = riTables[baseIndex];
+        Float ri = 0, scale = 1;
+        while (a) {
+            uint64_t hi = a / table.size;
+            ri += scale * table.values[a - hi * table.size];
+            scale *= table.invSize;
+            a = hi;
+        }
+        return std::min(ri, OneMinusEpsilon);
+    }
     switch (baseIndex) {
     case 0:
     // Compute base-2 radical inverse
@@ -2503,7 +2568,76 @@ std::vector<uint16_t> ComputeRadicalInversePermutations(RNG &rng) {
     return perms;
 }
 
+// Scrambled counterpart of the block radical-inverse tables: one lazily
+// built table per dimension, valid for a particular permutation (the
+// global Halton permutation in practice; identified by pointer). Each
+// entry holds the scrambled inverse of a full K-digit block - leading
+// zeros scramble to perm[0] like any other digit - and _tail_ carries the
+// closed-form contribution of the infinite run of scrambled zeros past
+// the last block, so the per-dimension digit loop becomes a couple of
+// fetches, matching the unscrambled fast path.
+struct ScrambledRITable {
+    const uint16_t *perm;
+    uint32_t size;
+    Float invSize;
+    Float tail;
+    std::vector<Float> values;
+};
+static std::vector<std::atomic<ScrambledRITable *>> scrambledRITables(
+    nRITablePrimes);
+static std::mutex scrambledRITableMutex;
+
+static ScrambledRITable *BuildScrambledRITable(int baseIndex,
+                                               const uint16_t *perm) {
+    std::lock_guard<std::mutex> lock(scrambledRITableMutex);
+    ScrambledRITable *t =
+        scrambledRITables[baseIndex].load(std::memory_order_relaxed);
+    if (t && t->perm == perm) return t;
+    uint32_t base = Primes[baseIndex];
+    uint32_t size = base;
+    while (size * (uint64_t)base <= 4096) size *= base;
+    std::unique_ptr<ScrambledRITable> table(new ScrambledRITable);
+    table->perm = perm;
+    table->size = size;
+    table->invSize = (Float)1 / (Float)size;
+    table->tail = (Float)perm[0] / (Float)(base - 1);
+    table->values.resize(size);
+    uint32_t nDigits = 0;
+    for (uint32_t s = size; s > 1; s /= base) ++nDigits;
+    for (uint32_t e = 0; e < size; ++e) {
+        uint64_t reversed = 0, v = e;
+        for (uint32_t d = 0; d < nDigits; ++d) {
+            uint64_t next = v / base;
+            reversed = reversed * base + perm[v - next * base];
+            v = next;
+        }
+        table->values[e] = reversed * table->invSize;
+    }
+    // Leak the previous table (if the permutation changed) rather than
+    // racing readers; permutations change at most once per render.
+    scrambledRITables[baseIndex].store(table.get(),
+                                       std::memory_order_release);
+    return table.release();
+}
+
 Float ScrambledRadicalInverse(int baseIndex, uint64_t a, const uint16_t *perm) {
+    if (baseIndex > 0 && baseIndex < nRITablePrimes) {
+        ScrambledRITable *table =
+            scrambledRITables[baseIndex].load(std::memory_order_acquire);
+        if (!table || table->perm != perm)
+            table = BuildScrambledRITable(baseIndex, perm);
+        if (table->perm == perm) {
+            Float ri = 0, scale = 1;
+            while (a) {
+                uint64_t hi = a / table->size;
+                ri += scale * table->values[a - hi * table->size];
+                scale *= table->invSize;
+                a = hi;
+            }
+            ri += scale * table->tail;
+            return std::min(ri, OneMinusEpsilon);
+        }
+    }
     switch (baseIndex) {
     case 0:
         return ScrambledRadicalInverseSpecialized<2>(perm, a);
@@ -248,6 +248,28 @@ inline uint64_t SobolIntervalToIndex(const uint32_t m, uint64_t frame,
     return index;
 }
 
+// Compute _nDims_ consecutive Sobol' dimensions of one sample with a single
+// pass over the index bits; the per-bit XOR fold runs across all of the
+// dimensions so the bit-scan control flow is amortized and the inner loop
+// vectorizes.
+inline void SobolSampleBulk(int64_t a, int dimBegin, int nDims, Float *v) {
+    CHECK_LE(dimBegin + nDims, NumSobolDimensions);
+    PBRT_CONSTEXPR int maxBulkDims = 16;
+    CHECK_LE(nDims, maxBulkDims);
+    uint32_t r[maxBulkDims] = {0};
+    for (int bit = 0; a != 0; a >>= 1, ++bit)
+        if (a & 1)
+            for (int d = 0; d < nDims; ++d)
+                r[d] ^= SobolMatrices32[(dimBegin + d) * SobolMatrixSize + bit];
+    for (int d = 0; d < nDims; ++d)
+#ifndef PBRT_HAVE_HEX_FP_CONSTANTS
+        v[d] = std::min(r[d] * (Float)2.3283064365386963e-10,
+                        OneMinusEpsilon);
+#else
+        v[d] = std::min(r[d] * (Float)0x1p-32, OneMinusEpsilon);
+#endif
+}
+
 inline Float SobolSample(int64_t index, int dimension, uint64_t scramble = 0) {
 #ifdef PBRT_FLOAT_AS_DOUBLE
     return SobolSampleDouble(index, dimension, scramble);
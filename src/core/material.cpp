@@ -33,6 +33,7 @@
 
 // core/material.cpp*
 #include "material.h"
+#include "textures/imagemap.h"
 #include "primitive.h"
 #include "texture.h"
 #include "spectrum.h"
@@ -40,11 +41,16 @@
 
 namespace pbrt {
 
+PBRT_THREAD_LOCAL int materialLODDepth = 0;
+int materialLODMinDepth = 0;
+
 // Material Method Definitions
 Material::~Material() {}
 
 void Material::Bump(const std::shared_ptr<Texture<Float>> &d,
                     SurfaceInteraction *si) {
+    // Bump differencing reads the filter footprint directly
+    si->EnsureDifferentials();
     // Compute offset positions and evaluate displacement texture
     SurfaceInteraction siEval = *si;
 
@@ -80,6 +86,16 @@ void Material::Bump(const std::shared_ptr<Texture<Float>> &d,
                     displace * Vector3f(si->shading.dndv);
     si->SetShadingGeometry(dpdu, dpdv, si->shading.dndu, si->shading.dndv,
                            false);
+
+    // Record the sub-footprint height variance the filtered bump lookups
+    // just discarded, converted to a slope variance; microfacet materials
+    // fold it into their roughness via RoughenFromBumpVariance() so lost
+    // bump detail becomes roughness instead of glint aliasing.
+    if (const ImageTexture<Float, Float> *imgBump =
+            dynamic_cast<const ImageTexture<Float, Float> *>(d.get())) {
+        Float varH = std::max((Float)0, imgBump->EvaluateVariance(*si));
+        si->bumpSlopeVariance = varH / (du * du + dv * dv);
+    }
 }
 
 }  // namespace pbrt
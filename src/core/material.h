@@ -60,6 +60,25 @@ class Material {
                      SurfaceInteraction *si);
 };
 
+// Material LOD: integrators that enable it (the path integrator's
+// "lodmindepth" parameter) publish the current path depth here before
+// requesting scattering functions; materials with expensive layered
+// stacks then substitute a cheap fitted proxy once the threshold is
+// passed. A threshold of zero (the default) disables the substitution.
+extern PBRT_THREAD_LOCAL int materialLODDepth;
+extern int materialLODMinDepth;
+
+// LEAN-style filtered bump mapping: widen a microfacet alpha by the bump
+// map's sub-footprint slope variance (recorded in
+// SurfaceInteraction::bumpSlopeVariance by Material::Bump()), so detail
+// the filtered bump derivatives can no longer resolve shows up as
+// roughness rather than as glint aliasing.
+inline Float RoughenFromBumpVariance(Float alpha, Float bumpSlopeVariance) {
+    return bumpSlopeVariance > 0
+               ? std::sqrt(alpha * alpha + 2 * bumpSlopeVariance)
+               : alpha;
+}
+
 }  // namespace pbrt
 
 #endif  // PBRT_CORE_MATERIAL_H
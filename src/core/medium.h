@@ -77,9 +77,28 @@ class Medium {
     // Medium Interface
     virtual ~Medium() {}
     virtual Spectrum Tr(const Ray &ray, Sampler &sampler) const = 0;
+    // _beta_, when non-null, is the path throughput up to this segment;
+    // media may use it to steer spectral channel selection (see
+    // HomogeneousMedium::Sample()). Passing nullptr keeps uniform
+    // selection.
     virtual Spectrum Sample(const Ray &ray, Sampler &sampler,
-                            MemoryArena &arena,
-                            MediumInteraction *mi) const = 0;
+                            MemoryArena &arena, MediumInteraction *mi,
+                            const Spectrum *beta = nullptr) const = 0;
+    // Emitted radiance for a medium interaction produced by Sample(),
+    // pre-weighted by sigma_a/sigma_s to compensate for Sample() having
+    // already folded sigma_s/sigma_t into the path throughput; integrators
+    // add beta times this value at each sampled scattering event.
+    virtual Spectrum SampledLe(const MediumInteraction &mi) const {
+        return Spectrum(0.f);
+    }
+    // If the medium is homogeneous, returns its coefficients so that
+    // integrators can evaluate transmittance and distance-sampling pdfs
+    // along rays in closed form.
+    virtual bool GetHomogeneousCoefficients(Spectrum *sigma_a,
+                                            Spectrum *sigma_s,
+                                            Float *g) const {
+        return false;
+    }
 };
 
 // HenyeyGreenstein Declarations
@@ -33,6 +33,11 @@
 
 // core/memory.cpp*
 #include "memory.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
 
 namespace pbrt {
 
@@ -58,4 +63,57 @@ void FreeAligned(void *ptr) {
 #endif
 }
 
+// Arena block pool: only blocks of the arenas' default size are recycled,
+// which covers essentially all traffic from per-tile rendering arenas. The
+// mutex is uncontended in practice since arenas are created and destroyed
+// at tile granularity, not per allocation.
+static PBRT_CONSTEXPR size_t arenaPoolBlockSize = 262144;
+static PBRT_CONSTEXPR size_t arenaPoolMaxBlocks = 1024;
+static std::mutex arenaBlockPoolMutex;
+static std::vector<uint8_t *> arenaBlockPool;
+
+uint8_t *AcquireArenaBlock(size_t size) {
+    if (size == arenaPoolBlockSize) {
+        std::lock_guard<std::mutex> lock(arenaBlockPoolMutex);
+        if (!arenaBlockPool.empty()) {
+            uint8_t *block = arenaBlockPool.back();
+            arenaBlockPool.pop_back();
+            return block;
+        }
+    }
+    return AllocAligned<uint8_t>(size);
+}
+
+void ReleaseArenaBlock(uint8_t *block, size_t size) {
+    if (size == arenaPoolBlockSize) {
+        std::lock_guard<std::mutex> lock(arenaBlockPoolMutex);
+        if (arenaBlockPool.size() < arenaPoolMaxBlocks) {
+            arenaBlockPool.push_back(block);
+            return;
+        }
+    }
+    FreeAligned(block);
+}
+
+void FreeArenaBlockPool() {
+    std::lock_guard<std::mutex> lock(arenaBlockPoolMutex);
+    for (uint8_t *block : arenaBlockPool) FreeAligned(block);
+    arenaBlockPool.clear();
+}
+
+void ParallelFirstTouch(void *ptr, size_t nBytes) {
+    if (!PbrtOptions.numa || !ptr) return;
+    // Zero the block in parallel chunks so each page is first touched by
+    // the thread that claims its chunk, distributing the pages across the
+    // render threads' NUMA nodes
+    PBRT_CONSTEXPR size_t chunkBytes = 4 * 1024 * 1024;
+    int64_t nChunks = (nBytes + chunkBytes - 1) / chunkBytes;
+    if (nChunks < 2) return;
+    ParallelFor([=](int64_t c) {
+        size_t offset = c * chunkBytes;
+        memset((char *)ptr + offset, 0,
+               std::min(chunkBytes, nBytes - offset));
+    }, nChunks);
+}
+
 }  // namespace pbrt
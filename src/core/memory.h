@@ -42,6 +42,8 @@
 #include "pbrt.h"
 #include <list>
 #include <cstddef>
+#include <type_traits>
+#include <utility>
 
 namespace pbrt {
 
@@ -54,6 +56,16 @@ T *AllocAligned(size_t count) {
 }
 
 void FreeAligned(void *);
+// Fault a freshly allocated block's pages in from all render threads
+// (zeroing it) so first-touch policy interleaves the pages across NUMA
+// nodes; a no-op unless --numa was given. Call before filling the block.
+void ParallelFirstTouch(void *ptr, size_t nBytes);
+// Global pool of default-size arena blocks recycled across MemoryArena
+// instances, so the per-tile arenas of steady-state rendering stop hitting
+// the heap allocator entirely. Oversized blocks bypass the pool.
+uint8_t *AcquireArenaBlock(size_t size);
+void ReleaseArenaBlock(uint8_t *block, size_t size);
+void FreeArenaBlockPool();
 class
 #ifdef PBRT_HAVE_ALIGNAS
 alignas(PBRT_L1_CACHE_LINE_SIZE)
@@ -63,9 +75,11 @@ alignas(PBRT_L1_CACHE_LINE_SIZE)
     // MemoryArena Public Methods
     MemoryArena(size_t blockSize = 262144) : blockSize(blockSize) {}
     ~MemoryArena() {
-        FreeAligned(currentBlock);
-        for (auto &block : usedBlocks) FreeAligned(block.second);
-        for (auto &block : availableBlocks) FreeAligned(block.second);
+        if (currentBlock) ReleaseArenaBlock(currentBlock, currentAllocSize);
+        for (auto &block : usedBlocks)
+            ReleaseArenaBlock(block.second, block.first);
+        for (auto &block : availableBlocks)
+            ReleaseArenaBlock(block.second, block.first);
     }
     void *Alloc(size_t nBytes) {
         // Round up _nBytes_ to minimum machine alignment
@@ -104,7 +118,7 @@ alignas(PBRT_L1_CACHE_LINE_SIZE)
             }
             if (!currentBlock) {
                 currentAllocSize = std::max(nBytes, blockSize);
-                currentBlock = AllocAligned<uint8_t>(currentAllocSize);
+                currentBlock = AcquireArenaBlock(currentAllocSize);
             }
             currentBlockPos = 0;
         }
@@ -190,6 +204,110 @@ class BlockedArray {
     const int uRes, vRes, uBlocks;
 };
 
+// InlinedVector is a minimal std::vector replacement that stores up to N
+// elements inline, only falling back to a heap allocation when it grows
+// past that. ParamSet uses it for its per-type parameter lists so that
+// typical small parameter sets don't allocate at all.
+template <typename T, int N>
+class InlinedVector {
+  public:
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    InlinedVector() : ptr(inlinePtr()), nAlloc(N) {}
+    InlinedVector(const InlinedVector &v) : InlinedVector() { *this = v; }
+    InlinedVector(InlinedVector &&v) : InlinedVector() {
+        *this = std::move(v);
+    }
+    ~InlinedVector() { reset(); }
+
+    InlinedVector &operator=(const InlinedVector &v) {
+        if (this == &v) return *this;
+        clear();
+        reserve(v.nStored);
+        for (size_t i = 0; i < v.nStored; ++i) new (ptr + i) T(v.ptr[i]);
+        nStored = v.nStored;
+        return *this;
+    }
+    InlinedVector &operator=(InlinedVector &&v) {
+        if (this == &v) return *this;
+        reset();
+        if (v.ptr != v.inlinePtr()) {
+            // Steal the heap allocation
+            ptr = v.ptr;
+            nAlloc = v.nAlloc;
+            nStored = v.nStored;
+            v.ptr = v.inlinePtr();
+            v.nAlloc = N;
+            v.nStored = 0;
+        } else {
+            for (size_t i = 0; i < v.nStored; ++i)
+                new (ptr + i) T(std::move(v.ptr[i]));
+            nStored = v.nStored;
+            v.clear();
+        }
+        return *this;
+    }
+
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+    template <typename... Args>
+    void emplace_back(Args &&... args) {
+        if (nStored == nAlloc) grow(2 * nAlloc);
+        new (ptr + nStored) T(std::forward<Args>(args)...);
+        ++nStored;
+    }
+    void erase(iterator it) {
+        for (iterator i = it; i + 1 != end(); ++i) *i = std::move(*(i + 1));
+        ptr[nStored - 1].~T();
+        --nStored;
+    }
+    void clear() {
+        for (size_t i = 0; i < nStored; ++i) ptr[i].~T();
+        nStored = 0;
+    }
+    void reserve(size_t n) {
+        if (n > nAlloc) grow(n);
+    }
+
+    size_t size() const { return nStored; }
+    bool empty() const { return nStored == 0; }
+    T &operator[](size_t i) { return ptr[i]; }
+    const T &operator[](size_t i) const { return ptr[i]; }
+    T &back() { return ptr[nStored - 1]; }
+    const T &back() const { return ptr[nStored - 1]; }
+    iterator begin() { return ptr; }
+    iterator end() { return ptr + nStored; }
+    const_iterator begin() const { return ptr; }
+    const_iterator end() const { return ptr + nStored; }
+
+  private:
+    // InlinedVector Private Methods
+    T *inlinePtr() { return reinterpret_cast<T *>(inlineStorage); }
+    void grow(size_t newAlloc) {
+        T *newPtr = static_cast<T *>(::operator new(newAlloc * sizeof(T)));
+        for (size_t i = 0; i < nStored; ++i) {
+            new (newPtr + i) T(std::move(ptr[i]));
+            ptr[i].~T();
+        }
+        if (ptr != inlinePtr()) ::operator delete(ptr);
+        ptr = newPtr;
+        nAlloc = newAlloc;
+    }
+    void reset() {
+        clear();
+        if (ptr != inlinePtr()) ::operator delete(ptr);
+        ptr = inlinePtr();
+        nAlloc = N;
+    }
+
+    // InlinedVector Private Data
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type
+        inlineStorage[N];
+    T *ptr;
+    size_t nAlloc, nStored = 0;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_CORE_MEMORY_H
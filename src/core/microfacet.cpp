@@ -153,13 +153,20 @@ Float BeckmannDistribution::D(const Vector3f &wh) const {
 }
 
 Float TrowbridgeReitzDistribution::D(const Vector3f &wh) const {
+    // Return the memoized value when this half vector was just evaluated
+    if (wh == dW[0]) return dVal[0];
+    if (wh == dW[1]) return dVal[1];
     Float tan2Theta = Tan2Theta(wh);
     if (std::isinf(tan2Theta)) return 0.;
     const Float cos4Theta = Cos2Theta(wh) * Cos2Theta(wh);
     Float e =
         (Cos2Phi(wh) / (alphax * alphax) + Sin2Phi(wh) / (alphay * alphay)) *
         tan2Theta;
-    return 1 / (Pi * alphax * alphay * cos4Theta * (1 + e) * (1 + e));
+    Float d = 1 / (Pi * alphax * alphay * cos4Theta * (1 + e) * (1 + e));
+    dW[dNext] = wh;
+    dVal[dNext] = d;
+    dNext ^= 1;
+    return d;
 }
 
 Float BeckmannDistribution::Lambda(const Vector3f &w) const {
@@ -174,13 +181,20 @@ Float BeckmannDistribution::Lambda(const Vector3f &w) const {
 }
 
 Float TrowbridgeReitzDistribution::Lambda(const Vector3f &w) const {
+    // Return the memoized value when this direction was just evaluated
+    if (w == lambdaW[0]) return lambdaVal[0];
+    if (w == lambdaW[1]) return lambdaVal[1];
     Float absTanTheta = std::abs(TanTheta(w));
     if (std::isinf(absTanTheta)) return 0.;
     // Compute _alpha_ for direction _w_
     Float alpha =
         std::sqrt(Cos2Phi(w) * alphax * alphax + Sin2Phi(w) * alphay * alphay);
     Float alpha2Tan2Theta = (alpha * absTanTheta) * (alpha * absTanTheta);
-    return (-1 + std::sqrt(1.f + alpha2Tan2Theta)) / 2;
+    Float lambda = (-1 + std::sqrt(1.f + alpha2Tan2Theta)) / 2;
+    lambdaW[lambdaNext] = w;
+    lambdaVal[lambdaNext] = lambda;
+    lambdaNext ^= 1;
+    return lambda;
 }
 
 std::string BeckmannDistribution::ToString() const {
@@ -235,73 +249,39 @@ Vector3f BeckmannDistribution::Sample_wh(const Vector3f &wo,
     }
 }
 
-static void TrowbridgeReitzSample11(Float cosTheta, Float U1, Float U2,
-                                    Float *slope_x, Float *slope_y) {
-    // special case (normal incidence)
-    if (cosTheta > .9999) {
-        Float r = sqrt(U1 / (1 - U1));
-        Float phi = 6.28318530718 * U2;
-        *slope_x = r * cos(phi);
-        *slope_y = r * sin(phi);
-        return;
-    }
-
-    Float sinTheta =
-        std::sqrt(std::max((Float)0, (Float)1 - cosTheta * cosTheta));
-    Float tanTheta = sinTheta / cosTheta;
-    Float a = 1 / tanTheta;
-    Float G1 = 2 / (1 + std::sqrt(1.f + 1.f / (a * a)));
-
-    // sample slope_x
-    Float A = 2 * U1 / G1 - 1;
-    Float tmp = 1.f / (A * A - 1.f);
-    if (tmp > 1e10) tmp = 1e10;
-    Float B = tanTheta;
-    Float D = std::sqrt(
-        std::max(Float(B * B * tmp * tmp - (A * A - B * B) * tmp), Float(0)));
-    Float slope_x_1 = B * tmp - D;
-    Float slope_x_2 = B * tmp + D;
-    *slope_x = (A < 0 || slope_x_2 > 1.f / tanTheta) ? slope_x_1 : slope_x_2;
-
-    // sample slope_y
-    Float S;
-    if (U2 > 0.5f) {
-        S = 1.f;
-        U2 = 2.f * (U2 - .5f);
-    } else {
-        S = -1.f;
-        U2 = 2.f * (.5f - U2);
-    }
-    Float z =
-        (U2 * (U2 * (U2 * 0.27385f - 0.73369f) + 0.46341f)) /
-        (U2 * (U2 * (U2 * 0.093073f + 0.309420f) - 1.000000f) + 0.597999f);
-    *slope_y = S * z * std::sqrt(1.f + *slope_x * *slope_x);
-
-    CHECK(!std::isinf(*slope_y));
-    CHECK(!std::isnan(*slope_y));
-}
-
 static Vector3f TrowbridgeReitzSample(const Vector3f &wi, Float alpha_x,
                                       Float alpha_y, Float U1, Float U2) {
-    // 1. stretch wi
-    Vector3f wiStretched =
-        Normalize(Vector3f(alpha_x * wi.x, alpha_y * wi.y, wi.z));
-
-    // 2. simulate P22_{wi}(x_slope, y_slope, 1, 1)
-    Float slope_x, slope_y;
-    TrowbridgeReitzSample11(CosTheta(wiStretched), U1, U2, &slope_x, &slope_y);
-
-    // 3. rotate
-    Float tmp = CosPhi(wiStretched) * slope_x - SinPhi(wiStretched) * slope_y;
-    slope_y = SinPhi(wiStretched) * slope_x + CosPhi(wiStretched) * slope_y;
-    slope_x = tmp;
-
-    // 4. unstretch
-    slope_x = alpha_x * slope_x;
-    slope_y = alpha_y * slope_y;
-
-    // 5. compute normal
-    return Normalize(Vector3f(-slope_x, -slope_y, 1.));
+    // Sample the GGX distribution of visible normals with Heitz's
+    // hemisphere projection construction (JCGT 2018): transform to the
+    // hemisphere configuration, sample a disk warped toward the visible
+    // half, and transform back. This draws from exactly the same visible
+    // normal distribution as the slope-space inversion it replaces - so
+    // Pdf() is unchanged - but runs branch-free with two square roots
+    // instead of the polynomial fit, branches, and special cases of
+    // TrowbridgeReitzSample11().
+
+    // Transform the view direction to the hemisphere configuration
+    Vector3f Vh = Normalize(Vector3f(alpha_x * wi.x, alpha_y * wi.y, wi.z));
+
+    // Build an orthonormal basis around _Vh_
+    Float lensq = Vh.x * Vh.x + Vh.y * Vh.y;
+    Vector3f T1 = lensq > 0 ? Vector3f(-Vh.y, Vh.x, 0) / std::sqrt(lensq)
+                            : Vector3f(1, 0, 0);
+    Vector3f T2 = Cross(Vh, T1);
+
+    // Sample a point on the warped projected disk
+    Float r = std::sqrt(U1);
+    Float phi = 2 * Pi * U2;
+    Float p1 = r * std::cos(phi);
+    Float p2 = r * std::sin(phi);
+    Float s = .5f * (1 + Vh.z);
+    p2 = (1 - s) * std::sqrt(std::max((Float)0, 1 - p1 * p1)) + s * p2;
+
+    // Reproject onto the hemisphere and transform back to the ellipsoid
+    Vector3f Nh = p1 * T1 + p2 * T2 +
+                  std::sqrt(std::max((Float)0, 1 - p1 * p1 - p2 * p2)) * Vh;
+    return Normalize(Vector3f(alpha_x * Nh.x, alpha_y * Nh.y,
+                              std::max((Float)1e-6, Nh.z)));
 }
 
 Vector3f TrowbridgeReitzDistribution::Sample_wh(const Vector3f &wo,
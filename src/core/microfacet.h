@@ -60,6 +60,13 @@ class MicrofacetDistribution {
     }
     virtual Vector3f Sample_wh(const Vector3f &wo, const Point2f &u) const = 0;
     Float Pdf(const Vector3f &wo, const Vector3f &wh) const;
+    // Report the distribution's parameters if it is a Trowbridge-Reitz
+    // distribution, so a MicrofacetReflection lobe can be flattened into a
+    // BxDFRecord; other distributions return false.
+    virtual bool GetTrowbridgeReitz(Float *ax, Float *ay,
+                                    bool *sampleVis) const {
+        return false;
+    }
     virtual std::string ToString() const = 0;
 
   protected:
@@ -109,6 +116,12 @@ class TrowbridgeReitzDistribution : public MicrofacetDistribution {
         : MicrofacetDistribution(samplevis), alphax(alphax), alphay(alphay) {}
     Float D(const Vector3f &wh) const;
     Vector3f Sample_wh(const Vector3f &wo, const Point2f &u) const;
+    bool GetTrowbridgeReitz(Float *ax, Float *ay, bool *sampleVis) const {
+        *ax = alphax;
+        *ay = alphay;
+        *sampleVis = sampleVisibleArea;
+        return true;
+    }
     std::string ToString() const;
 
   private:
@@ -117,6 +130,20 @@ class TrowbridgeReitzDistribution : public MicrofacetDistribution {
 
     // TrowbridgeReitzDistribution Private Data
     const Float alphax, alphay;
+    // Memo of the last two Lambda() evaluations: MIS calls f() and Pdf()
+    // back to back with the same directions, and wo recurs in every
+    // evaluation at a shading point, so G/G1 would otherwise recompute
+    // identical square roots three or four times per light sample.
+    // Distributions are arena-allocated per intersection and used from a
+    // single thread.
+    mutable Vector3f lambdaW[2];
+    mutable Float lambdaVal[2] = {0, 0};
+    mutable int lambdaNext = 0;
+    // Same memo for D(): f() and Pdf() both evaluate it for the identical
+    // half vector of one MIS sample
+    mutable Vector3f dW[2];
+    mutable Float dVal[2] = {0, 0};
+    mutable int dNext = 0;
 };
 
 // MicrofacetDistribution Inline Methods
@@ -58,6 +58,14 @@ struct ResampleWeight {
     Float weight[4];
 };
 
+// MIPMap Texel Utility Functions
+inline Float GetTexelChannel(Float v, int) { return v; }
+inline Float GetTexelChannel(const RGBSpectrum &v, int i) { return v[i]; }
+inline PBRT_CONSTEXPR int NumTexelChannels(const Float *) { return 1; }
+inline PBRT_CONSTEXPR int NumTexelChannels(const RGBSpectrum *) { return 3; }
+inline void SetTexelChannel(Float *v, int, Float x) { *v = x; }
+inline void SetTexelChannel(RGBSpectrum *v, int i, Float x) { (*v)[i] = x; }
+
 // MIPMap Declarations
 template <typename T>
 class MIPMap {
@@ -67,8 +75,10 @@ class MIPMap {
            Float maxAniso = 8.f, ImageWrap wrapMode = ImageWrap::Repeat);
     int Width() const { return resolution[0]; }
     int Height() const { return resolution[1]; }
-    int Levels() const { return pyramid.size(); }
-    const T &Texel(int level, int s, int t) const;
+    int Levels() const {
+        return halfPyramid.empty() ? pyramid.size() : halfPyramid.size();
+    }
+    T Texel(int level, int s, int t) const;
     T Lookup(const Point2f &st, Float width = 0.f) const;
     T Lookup(const Point2f &st, Vector2f dstdx, Vector2f dstdy) const;
 
@@ -101,6 +111,14 @@ class MIPMap {
     }
     T triangle(int level, const Point2f &st) const;
     T EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const;
+    int LevelUSize(int level) const {
+        return halfPyramid.empty() ? pyramid[level]->uSize()
+                                   : halfPyramid[level].uSize;
+    }
+    int LevelVSize(int level) const {
+        return halfPyramid.empty() ? pyramid[level]->vSize()
+                                   : halfPyramid[level].vSize;
+    }
 
     // MIPMap Private Data
     const bool doTrilinear;
@@ -108,6 +126,14 @@ class MIPMap {
     const ImageWrap wrapMode;
     Point2i resolution;
     std::vector<std::unique_ptr<BlockedArray<T>>> pyramid;
+    // Half-precision pyramid used in place of _pyramid_ when
+    // --compresstextures is given, cutting texture memory in half while
+    // keeping HDR range; texels decode on the fly in Texel().
+    struct HalfLevel {
+        int uSize, vSize;
+        std::vector<uint16_t> data;
+    };
+    std::vector<HalfLevel> halfPyramid;
     static PBRT_CONSTEXPR int WeightLUTSize = 128;
     static Float weightLut[WeightLUTSize];
 };
@@ -206,6 +232,28 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
         }, tRes, 16);
     }
 
+    // Convert the pyramid to half-precision storage, if requested
+    if (PbrtOptions.compressTextures) {
+        PBRT_CONSTEXPR int nCh = NumTexelChannels((T *)nullptr);
+        halfPyramid.resize(nLevels);
+        for (int i = 0; i < nLevels; ++i) {
+            HalfLevel &hl = halfPyramid[i];
+            hl.uSize = pyramid[i]->uSize();
+            hl.vSize = pyramid[i]->vSize();
+            hl.data.resize((size_t)hl.uSize * hl.vSize * nCh);
+            ParallelFor([&, i](int64_t t) {
+                for (int s = 0; s < hl.uSize; ++s) {
+                    T v = (*pyramid[i])(s, (int)t);
+                    for (int c = 0; c < nCh; ++c)
+                        hl.data[((size_t)t * hl.uSize + s) * nCh + c] =
+                            FloatToHalf(std::min(GetTexelChannel(v, c),
+                                                 (Float)65504));
+                }
+            }, hl.vSize, 32);
+        }
+        pyramid.clear();
+    }
+
     // Initialize EWA filter weights if needed
     if (weightLut[0] == 0.) {
         for (int i = 0; i < WeightLUTSize; ++i) {
@@ -214,31 +262,40 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
             weightLut[i] = std::exp(-alpha * r2) - std::exp(-alpha);
         }
     }
-    mipMapMemory += (4 * resolution[0] * resolution[1] * sizeof(T)) / 3;
+    mipMapMemory +=
+        PbrtOptions.compressTextures
+            ? (4 * (int64_t)resolution[0] * resolution[1] *
+               NumTexelChannels((T *)nullptr) * sizeof(uint16_t)) / 3
+            : (4 * (int64_t)resolution[0] * resolution[1] * sizeof(T)) / 3;
 }
 
 template <typename T>
-const T &MIPMap<T>::Texel(int level, int s, int t) const {
-    CHECK_LT(level, pyramid.size());
-    const BlockedArray<T> &l = *pyramid[level];
+T MIPMap<T>::Texel(int level, int s, int t) const {
+    CHECK_LT(level, Levels());
+    int uSize = LevelUSize(level), vSize = LevelVSize(level);
     // Compute texel $(s,t)$ accounting for boundary conditions
     switch (wrapMode) {
     case ImageWrap::Repeat:
-        s = Mod(s, l.uSize());
-        t = Mod(t, l.vSize());
+        s = Mod(s, uSize);
+        t = Mod(t, vSize);
         break;
     case ImageWrap::Clamp:
-        s = Clamp(s, 0, l.uSize() - 1);
-        t = Clamp(t, 0, l.vSize() - 1);
+        s = Clamp(s, 0, uSize - 1);
+        t = Clamp(t, 0, vSize - 1);
         break;
     case ImageWrap::Black: {
-        static const T black = 0.f;
-        if (s < 0 || s >= (int)l.uSize() || t < 0 || t >= (int)l.vSize())
-            return black;
+        if (s < 0 || s >= uSize || t < 0 || t >= vSize) return T(0.f);
         break;
     }
     }
-    return l(s, t);
+    if (halfPyramid.empty()) return (*pyramid[level])(s, t);
+    // Decode the half-precision texel
+    PBRT_CONSTEXPR int nCh = NumTexelChannels((T *)nullptr);
+    const uint16_t *h =
+        &halfPyramid[level].data[((size_t)t * uSize + s) * nCh];
+    T v;
+    for (int c = 0; c < nCh; ++c) SetTexelChannel(&v, c, HalfToFloat(h[c]));
+    return v;
 }
 
 template <typename T>
@@ -263,8 +320,8 @@ T MIPMap<T>::Lookup(const Point2f &st, Float width) const {
 template <typename T>
 T MIPMap<T>::triangle(int level, const Point2f &st) const {
     level = Clamp(level, 0, Levels() - 1);
-    Float s = st[0] * pyramid[level]->uSize() - 0.5f;
-    Float t = st[1] * pyramid[level]->vSize() - 0.5f;
+    Float s = st[0] * LevelUSize(level) - 0.5f;
+    Float t = st[1] * LevelVSize(level) - 0.5f;
     int s0 = std::floor(s), t0 = std::floor(t);
     Float ds = s - s0, dt = t - t0;
     return (1 - ds) * (1 - dt) * Texel(level, s0, t0) +
@@ -306,12 +363,13 @@ template <typename T>
 T MIPMap<T>::EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const {
     if (level >= Levels()) return Texel(Levels() - 1, 0, 0);
     // Convert EWA coordinates to appropriate scale for level
-    st[0] = st[0] * pyramid[level]->uSize() - 0.5f;
-    st[1] = st[1] * pyramid[level]->vSize() - 0.5f;
-    dst0[0] *= pyramid[level]->uSize();
-    dst0[1] *= pyramid[level]->vSize();
-    dst1[0] *= pyramid[level]->uSize();
-    dst1[1] *= pyramid[level]->vSize();
+    Point2f stOrig = st;
+    st[0] = st[0] * LevelUSize(level) - 0.5f;
+    st[1] = st[1] * LevelVSize(level) - 0.5f;
+    dst0[0] *= LevelUSize(level);
+    dst0[1] *= LevelVSize(level);
+    dst1[0] *= LevelUSize(level);
+    dst1[1] *= LevelVSize(level);
 
     // Compute ellipse coefficients to bound EWA filter region
     Float A = dst0[1] * dst0[1] + dst1[1] * dst1[1] + 1;
@@ -331,15 +389,27 @@ T MIPMap<T>::EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const {
     int t0 = std::ceil(st[1] - 2 * invDet * vSqrt);
     int t1 = std::floor(st[1] + 2 * invDet * vSqrt);
 
-    // Scan over ellipse bound and compute quadratic equation
+    // Fall back to bilinear filtering when the ellipse only covers a few
+    // texels; the anisotropic filter can't do better there and the full
+    // scan setup costs more than the lookup
+    if ((s1 - s0 + 1) * (t1 - t0 + 1) <= 4) {
+        ++nTrilerpLookups;
+        return triangle(level, stOrig);
+    }
+
+    // Scan over ellipse bound and compute quadratic equation, evaluating
+    // the quadratic incrementally along each row: for fixed _tt_ it is a
+    // parabola in _ss_ with constant second difference 2A
     T sum(0.f);
     Float sumWts = 0;
     for (int it = t0; it <= t1; ++it) {
         Float tt = it - st[1];
+        Float ss = s0 - st[0];
+        Float r2 = A * ss * ss + B * ss * tt + C * tt * tt;
+        Float dr2 = A * (2 * ss + 1) + B * tt;
+        Float ddr2 = 2 * A;
         for (int is = s0; is <= s1; ++is) {
-            Float ss = is - st[0];
-            // Compute squared radius and filter texel if inside ellipse
-            Float r2 = A * ss * ss + B * ss * tt + C * tt * tt;
+            // Filter texel if it is inside the ellipse
             if (r2 < 1) {
                 int index =
                     std::min((int)(r2 * WeightLUTSize), WeightLUTSize - 1);
@@ -347,8 +417,11 @@ T MIPMap<T>::EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const {
                 sum += Texel(level, is, it) * weight;
                 sumWts += weight;
             }
+            r2 += dr2;
+            dr2 += ddr2;
         }
     }
+    if (sumWts == 0) return triangle(level, stOrig);
     return sum / sumWts;
 }
 
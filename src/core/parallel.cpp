@@ -38,6 +38,10 @@
 #include <list>
 #include <thread>
 #include <condition_variable>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace pbrt {
 
@@ -51,6 +55,11 @@ static std::mutex workListMutex;
 // Bookkeeping variables to help with the implementation of
 // MergeWorkerThreadStats().
 static std::atomic<bool> reportWorkerStats{false};
+// Incremented for each MergeWorkerThreadStats() call; each worker tracks
+// the last generation it reported so that waking again while a request
+// is still outstanding can't report (and decrement) a second time.
+static std::atomic<int> reportStatsGeneration{0};
+static PBRT_THREAD_LOCAL int lastReportedGeneration;
 // Number of workers that still need to report their stats.
 static std::atomic<int> reporterCount;
 // After kicking the workers to report their stats, the main thread waits
@@ -58,6 +67,27 @@ static std::atomic<int> reporterCount;
 static std::condition_variable reportDoneCondition;
 static std::mutex reportDoneMutex;
 
+// Merge this worker's stats if an outstanding request hasn't been served
+// yet. Does not require _workListMutex_; workers call it between chunk
+// claims as well, since a worker pinned inside one render-length loop
+// would otherwise only revisit the work-list check when the loop ends.
+static bool reportThreadStatsIfRequested() {
+    if (!reportWorkerStats.load(std::memory_order_acquire)) return false;
+    int generation = reportStatsGeneration.load(std::memory_order_acquire);
+    if (generation == lastReportedGeneration) return false;
+    lastReportedGeneration = generation;
+    ReportThreadStats();
+    if (--reporterCount == 0) {
+        // All worker threads have merged their stats; wake up the waiting
+        // merge call. Taking the mutex here keeps the notify from landing
+        // in the window between the waiter's predicate check and its
+        // block.
+        std::lock_guard<std::mutex> doneLock(reportDoneMutex);
+        reportDoneCondition.notify_one();
+    }
+    return true;
+}
+
 class ParallelForLoop {
   public:
     // ParallelForLoop Public Methods
@@ -83,17 +113,35 @@ class ParallelForLoop {
     const int64_t maxIndex;
     const int chunkSize;
     uint64_t profilerState;
-    int64_t nextIndex = 0;
-    int activeWorkers = 0;
+    // Chunks are claimed with an atomic fetch-add so that the work-list
+    // mutex is only taken to find a loop or to sleep, not per chunk; with
+    // many threads running fine-grained loops the per-chunk mutex was the
+    // dominant source of contention.
+    std::atomic<int64_t> nextIndex{0};
+    std::atomic<int> activeWorkers{0};
     ParallelForLoop *next = nullptr;
     int nX = -1;
 
     // ParallelForLoop Private Methods
     bool Finished() const {
-        return nextIndex >= maxIndex && activeWorkers == 0;
+        return nextIndex.load(std::memory_order_acquire) >= maxIndex &&
+               activeWorkers.load(std::memory_order_acquire) == 0;
     }
 };
 
+// Splice _loop_ out of _workList_ wherever it is linked; the caller must
+// hold _workListMutex_. Removal must not be conditioned on the loop being
+// at the list head: ParallelFor() destroys its stack-allocated loop as
+// soon as the last iteration finishes, and with sibling nested loops a
+// finished loop can sit below the head - leaving it linked would hand
+// idle workers a pointer into a dead stack frame once its neighbor above
+// is popped.
+static void removeFromWorkList(ParallelForLoop *loop) {
+    ParallelForLoop **node = &workList;
+    while (*node && *node != loop) node = &(*node)->next;
+    if (*node == loop) *node = loop->next;
+}
+
 void Barrier::Wait() {
     std::unique_lock<std::mutex> lock(mutex);
     CHECK_GT(count, 0);
@@ -128,52 +176,55 @@ static void workerThreadFunc(int tIndex, std::shared_ptr<Barrier> barrier) {
 
     std::unique_lock<std::mutex> lock(workListMutex);
     while (!shutdownThreads) {
-        if (reportWorkerStats) {
-            ReportThreadStats();
-            if (--reporterCount == 0)
-                // Once all worker threads have merged their stats, wake up
-                // the main thread.
-                reportDoneCondition.notify_one();
-            // Now sleep again.
-            workListCondition.wait(lock);
+        if (reportThreadStatsIfRequested()) {
+            // Go back around the loop; there may also be work to run.
         } else if (!workList) {
             // Sleep until there are more tasks to run
             workListCondition.wait(lock);
         } else {
             // Get work from _workList_ and run loop iterations
             ParallelForLoop &loop = *workList;
-
-            // Run a chunk of loop iterations for _loop_
-
-            // Find the set of loop iterations to run next
-            int64_t indexStart = loop.nextIndex;
-            int64_t indexEnd =
-                std::min(indexStart + loop.chunkSize, loop.maxIndex);
-
-            // Update _loop_ to reflect iterations this thread will run
-            loop.nextIndex = indexEnd;
-            if (loop.nextIndex == loop.maxIndex) workList = loop.next;
             loop.activeWorkers++;
-
-            // Run loop indices in _[indexStart, indexEnd)_
             lock.unlock();
-            for (int64_t index = indexStart; index < indexEnd; ++index) {
-                uint64_t oldState = ProfilerState;
-                ProfilerState = loop.profilerState;
-                if (loop.func1D) {
-                    loop.func1D(index);
-                }
-                // Handle other types of loops
-                else {
-                    CHECK(loop.func2D);
-                    loop.func2D(Point2i(index % loop.nX, index / loop.nX));
+
+            // Claim and run chunks of _loop_ without holding the lock
+            while (true) {
+                int64_t indexStart =
+                    loop.nextIndex.fetch_add(loop.chunkSize,
+                                             std::memory_order_relaxed);
+                if (indexStart >= loop.maxIndex) break;
+                int64_t indexEnd =
+                    std::min(indexStart + loop.chunkSize, loop.maxIndex);
+
+                // Run loop indices in _[indexStart, indexEnd)_
+                for (int64_t index = indexStart; index < indexEnd; ++index) {
+                    uint64_t oldState = ProfilerState;
+                    ProfilerState = loop.profilerState;
+                    if (loop.func1D) {
+                        loop.func1D(index);
+                    }
+                    // Handle other types of loops
+                    else {
+                        CHECK(loop.func2D);
+                        loop.func2D(Point2i(index % loop.nX, index / loop.nX));
+                    }
+                    ProfilerState = oldState;
                 }
-                ProfilerState = oldState;
+
+                // Honor a pending mid-render stats snapshot between
+                // chunks; the classic Render() path is a single
+                // ParallelFor2D spanning the whole render, so this is the
+                // only place a busy worker passes with useful frequency
+                reportThreadStatsIfRequested();
             }
             lock.lock();
 
-            // Update _loop_ to reflect completion of iterations
+            // Update _loop_ to reflect completion of iterations and remove
+            // it from the work list once all indices have been claimed
             loop.activeWorkers--;
+            if (loop.nextIndex.load(std::memory_order_relaxed) >=
+                loop.maxIndex)
+                removeFromWorkList(&loop);
             if (loop.Finished()) workListCondition.notify_all();
         }
     }
@@ -202,22 +253,18 @@ void ParallelFor(std::function<void(int64_t)> func, int64_t count,
     // Notify worker threads of work to be done
     std::unique_lock<std::mutex> lock(workListMutex);
     workListCondition.notify_all();
-
-    // Help out with parallel loop iterations in the current thread
-    while (!loop.Finished()) {
-        // Run a chunk of loop iterations for _loop_
-
-        // Find the set of loop iterations to run next
-        int64_t indexStart = loop.nextIndex;
+    loop.activeWorkers++;
+    lock.unlock();
+
+    // Help out with parallel loop iterations in the current thread,
+    // claiming chunks with atomic increments rather than the lock
+    while (true) {
+        int64_t indexStart =
+            loop.nextIndex.fetch_add(loop.chunkSize, std::memory_order_relaxed);
+        if (indexStart >= loop.maxIndex) break;
         int64_t indexEnd = std::min(indexStart + loop.chunkSize, loop.maxIndex);
 
-        // Update _loop_ to reflect iterations this thread will run
-        loop.nextIndex = indexEnd;
-        if (loop.nextIndex == loop.maxIndex) workList = loop.next;
-        loop.activeWorkers++;
-
         // Run loop indices in _[indexStart, indexEnd)_
-        lock.unlock();
         for (int64_t index = indexStart; index < indexEnd; ++index) {
             uint64_t oldState = ProfilerState;
             ProfilerState = loop.profilerState;
@@ -231,11 +278,16 @@ void ParallelFor(std::function<void(int64_t)> func, int64_t count,
             }
             ProfilerState = oldState;
         }
-        lock.lock();
-
-        // Update _loop_ to reflect completion of iterations
-        loop.activeWorkers--;
     }
+    lock.lock();
+    loop.activeWorkers--;
+    // All indices have been claimed at this point, so unlink the loop
+    // before waiting; once we return, _loop_'s storage is gone
+    removeFromWorkList(&loop);
+
+    // Sleep until any straggler workers have finished the loop, instead of
+    // spinning on the lock as the previous implementation did
+    while (!loop.Finished()) workListCondition.wait(lock);
 }
 
 PBRT_THREAD_LOCAL int ThreadIndex;
@@ -262,22 +314,18 @@ void ParallelFor2D(std::function<void(Point2i)> func, const Point2i &count) {
 
     std::unique_lock<std::mutex> lock(workListMutex);
     workListCondition.notify_all();
-
-    // Help out with parallel loop iterations in the current thread
-    while (!loop.Finished()) {
-        // Run a chunk of loop iterations for _loop_
-
-        // Find the set of loop iterations to run next
-        int64_t indexStart = loop.nextIndex;
+    loop.activeWorkers++;
+    lock.unlock();
+
+    // Help out with parallel loop iterations in the current thread,
+    // claiming chunks with atomic increments rather than the lock
+    while (true) {
+        int64_t indexStart =
+            loop.nextIndex.fetch_add(loop.chunkSize, std::memory_order_relaxed);
+        if (indexStart >= loop.maxIndex) break;
         int64_t indexEnd = std::min(indexStart + loop.chunkSize, loop.maxIndex);
 
-        // Update _loop_ to reflect iterations this thread will run
-        loop.nextIndex = indexEnd;
-        if (loop.nextIndex == loop.maxIndex) workList = loop.next;
-        loop.activeWorkers++;
-
         // Run loop indices in _[indexStart, indexEnd)_
-        lock.unlock();
         for (int64_t index = indexStart; index < indexEnd; ++index) {
             uint64_t oldState = ProfilerState;
             ProfilerState = loop.profilerState;
@@ -291,11 +339,14 @@ void ParallelFor2D(std::function<void(Point2i)> func, const Point2i &count) {
             }
             ProfilerState = oldState;
         }
-        lock.lock();
-
-        // Update _loop_ to reflect completion of iterations
-        loop.activeWorkers--;
     }
+    lock.lock();
+    loop.activeWorkers--;
+    // As in ParallelFor(), unlink unconditionally before waiting
+    removeFromWorkList(&loop);
+
+    // Sleep until any straggler workers have finished the loop
+    while (!loop.Finished()) workListCondition.wait(lock);
 }
 
 int NumSystemCores() {
@@ -318,6 +369,26 @@ void ParallelInit() {
     for (int i = 0; i < nThreads - 1; ++i)
         threads.push_back(std::thread(workerThreadFunc, i + 1, barrier));
 
+#ifdef __linux__
+    if (PbrtOptions.numa) {
+        // Pin each render thread to its own core so per-thread data stays
+        // on the thread's NUMA node and threads don't migrate across
+        // sockets mid-render
+        int nCores = NumSystemCores();
+        auto pin = [nCores](pthread_t handle, int index) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(index % nCores, &set);
+            if (pthread_setaffinity_np(handle, sizeof(set), &set) != 0)
+                LOG(WARNING) << "Unable to set thread affinity for thread " <<
+                    index;
+        };
+        pin(pthread_self(), 0);
+        for (size_t i = 0; i < threads.size(); ++i)
+            pin(threads[i].native_handle(), i + 1);
+    }
+#endif
+
     barrier->Wait();
 }
 
@@ -335,19 +406,61 @@ void ParallelCleanup() {
     shutdownThreads = false;
 }
 
-void MergeWorkerThreadStats() {
-    std::unique_lock<std::mutex> lock(workListMutex);
-    std::unique_lock<std::mutex> doneLock(reportDoneMutex);
-    // Set up state so that the worker threads will know that we would like
-    // them to report their thread-specific stats when they wake up.
-    reportWorkerStats = true;
-    reporterCount = threads.size();
+// TaskGraph Method Definitions
+int TaskGraph::AddTask(std::function<void()> func,
+                       std::vector<int> dependencies) {
+    for (int d : dependencies) CHECK(d >= 0 && d < (int)tasks.size());
+    tasks.push_back({std::move(func), std::move(dependencies), false});
+    return tasks.size() - 1;
+}
 
-    // Wake up the worker threads.
-    workListCondition.notify_all();
+void TaskGraph::Run() {
+    size_t nDone = 0;
+    while (nDone < tasks.size()) {
+        // Collect the tasks whose dependencies have all completed and run
+        // them as one parallel wave
+        std::vector<int> ready;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (tasks[i].done) continue;
+            bool runnable = true;
+            for (int d : tasks[i].dependencies)
+                if (!tasks[d].done) {
+                    runnable = false;
+                    break;
+                }
+            if (runnable) ready.push_back(i);
+        }
+        CHECK(!ready.empty()) << "Cyclic dependency in TaskGraph";
+        ParallelFor([&](int64_t i) { tasks[ready[i]].func(); }, ready.size());
+        for (int i : ready) tasks[i].done = true;
+        nDone += ready.size();
+    }
+}
+
+void MergeWorkerThreadStats() {
+    // Serialize concurrent merge requests (the live stats thread can race
+    // the main thread's reporting here)
+    static std::mutex mergeMutex;
+    std::lock_guard<std::mutex> mergeLock(mergeMutex);
+    {
+        std::lock_guard<std::mutex> lock(workListMutex);
+        // Set up state so that the worker threads will know that we would
+        // like them to report their thread-specific stats: sleeping
+        // workers are woken below, busy ones notice between chunk claims.
+        // The count must be in place before the generation and flag are
+        // published.
+        reporterCount = threads.size();
+        reportStatsGeneration.fetch_add(1, std::memory_order_release);
+        reportWorkerStats.store(true, std::memory_order_release);
+
+        // Wake up the worker threads.
+        workListCondition.notify_all();
+    }
 
-    // Wait for all of them to merge their stats.
-    reportDoneCondition.wait(lock, []() { return reporterCount == 0; });
+    // Wait for all of them to merge their stats; the work-list mutex must
+    // be released first so that sleeping workers can reacquire it.
+    std::unique_lock<std::mutex> doneLock(reportDoneMutex);
+    reportDoneCondition.wait(doneLock, []() { return reporterCount == 0; });
 
     reportWorkerStats = false;
 }
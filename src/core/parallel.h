@@ -109,6 +109,26 @@ void ParallelInit();
 void ParallelCleanup();
 void MergeWorkerThreadStats();
 
+// TaskGraph Declarations
+// Minimal interface for running dependent jobs on the thread pool: tasks
+// are added along with the ids of tasks that must complete first, and Run()
+// executes ready tasks in parallel waves.
+class TaskGraph {
+  public:
+    // TaskGraph Public Methods
+    int AddTask(std::function<void()> func, std::vector<int> dependencies = {});
+    void Run();
+
+  private:
+    // TaskGraph Private Data
+    struct Task {
+        std::function<void()> func;
+        std::vector<int> dependencies;
+        bool done;
+    };
+    std::vector<Task> tasks;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_CORE_PARALLEL_H
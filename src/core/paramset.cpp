@@ -35,26 +35,44 @@
 #include "paramset.h"
 #include "floatfile.h"
 #include "textures/constant.h"
+#include <mutex>
+#include <unordered_map>
 
 namespace pbrt {
 
+// Parameter name intern table. Parameter sets are also built from worker
+// threads (e.g. deferred shape creation), so the table is mutex-protected;
+// the distinct-name count is small and lookups hash a short string once.
+uint32_t InternParamName(const std::string &name) {
+    static std::mutex internMutex;
+    static std::unordered_map<std::string, uint32_t> internTable;
+    std::lock_guard<std::mutex> lock(internMutex);
+    auto iter = internTable.find(name);
+    if (iter != internTable.end()) return iter->second;
+    uint32_t id = (uint32_t)internTable.size();
+    internTable[name] = id;
+    return id;
+}
+
 // ParamSet Macros
 #define ADD_PARAM_TYPE(T, vec) \
     (vec).emplace_back(new ParamSetItem<T>(name, std::move(values), nValues));
-#define LOOKUP_PTR(vec)             \
-    for (const auto &v : vec)       \
-        if (v->name == name) {      \
-            *nValues = v->nValues;  \
-            v->lookedUp = true;     \
-            return v->values.get(); \
-        }                           \
+#define LOOKUP_PTR(vec)                          \
+    uint32_t id = InternParamName(name);         \
+    for (const auto &v : vec)                    \
+        if (v->nameId == id) {                   \
+            *nValues = v->nValues;               \
+            v->lookedUp = true;                  \
+            return v->values.get();              \
+        }                                        \
     return nullptr
-#define LOOKUP_ONE(vec)                           \
-    for (const auto &v : vec)                     \
-        if (v->name == name && v->nValues == 1) { \
-            v->lookedUp = true;                   \
-            return v->values[0];                  \
-        }                                         \
+#define LOOKUP_ONE(vec)                             \
+    uint32_t id = InternParamName(name);            \
+    for (const auto &v : vec)                       \
+        if (v->nameId == id && v->nValues == 1) {   \
+            v->lookedUp = true;                     \
+            return v->values[0];                    \
+        }                                           \
     return d
 
 // ParamSet Methods
@@ -139,10 +157,31 @@ void ParamSet::AddBlackbodySpectrum(const std::string &name,
     nValues /= 2;
     std::unique_ptr<Spectrum[]> s(new Spectrum[nValues]);
     std::unique_ptr<Float[]> v(new Float[nCIESamples]);
+    // Normalized blackbody spectra depend only on the temperature, and
+    // scenes commonly repeat a handful of temperatures across many lights;
+    // cache them rather than re-evaluating Planck's law over the CIE
+    // samples each time.
+    static std::mutex blackbodyMutex;
+    static std::map<Float, Spectrum> blackbodyCache;
     for (int i = 0; i < nValues; ++i) {
-        BlackbodyNormalized(CIE_lambda, nCIESamples, values[2 * i], v.get());
-        s[i] = values[2 * i + 1] *
-               Spectrum::FromSampled(CIE_lambda, v.get(), nCIESamples);
+        Float temperature = values[2 * i];
+        Spectrum norm;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(blackbodyMutex);
+            auto iter = blackbodyCache.find(temperature);
+            if (iter != blackbodyCache.end()) {
+                norm = iter->second;
+                found = true;
+            }
+        }
+        if (!found) {
+            BlackbodyNormalized(CIE_lambda, nCIESamples, temperature, v.get());
+            norm = Spectrum::FromSampled(CIE_lambda, v.get(), nCIESamples);
+            std::lock_guard<std::mutex> lock(blackbodyMutex);
+            blackbodyCache[temperature] = norm;
+        }
+        s[i] = values[2 * i + 1] * norm;
     }
     std::shared_ptr<ParamSetItem<Spectrum>> psi(
         new ParamSetItem<Spectrum>(name, std::move(s), nValues));
@@ -174,9 +213,15 @@ void ParamSet::AddSampledSpectrumFiles(const std::string &name,
     std::unique_ptr<Spectrum[]> s(new Spectrum[nValues]);
     for (int i = 0; i < nValues; ++i) {
         std::string fn = AbsolutePath(ResolveFilename(names[i]));
-        if (cachedSpectra.find(fn) != cachedSpectra.end()) {
-            s[i] = cachedSpectra[fn];
-            continue;
+        {
+            // Parameter sets are also built from worker threads during
+            // deferred shape creation; guard the process-wide cache.
+            std::lock_guard<std::mutex> lock(cachedSpectraMutex);
+            auto iter = cachedSpectra.find(fn);
+            if (iter != cachedSpectra.end()) {
+                s[i] = iter->second;
+                continue;
+            }
         }
 
         std::vector<Float> vals;
@@ -199,6 +244,7 @@ void ParamSet::AddSampledSpectrumFiles(const std::string &name,
             }
             s[i] = Spectrum::FromSampled(&wls[0], &v[0], wls.size());
         }
+        std::lock_guard<std::mutex> lock(cachedSpectraMutex);
         cachedSpectra[fn] = s[i];
     }
 
@@ -208,6 +254,7 @@ void ParamSet::AddSampledSpectrumFiles(const std::string &name,
 }
 
 std::map<std::string, Spectrum> ParamSet::cachedSpectra;
+std::mutex ParamSet::cachedSpectraMutex;
 void ParamSet::AddString(const std::string &name,
                          std::unique_ptr<std::string[]> values, int nValues) {
     EraseString(name);
@@ -224,8 +271,9 @@ void ParamSet::AddTexture(const std::string &name, const std::string &value) {
 }
 
 bool ParamSet::EraseInt(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < ints.size(); ++i)
-        if (ints[i]->name == n) {
+        if (ints[i]->nameId == id) {
             ints.erase(ints.begin() + i);
             return true;
         }
@@ -233,8 +281,9 @@ bool ParamSet::EraseInt(const std::string &n) {
 }
 
 bool ParamSet::EraseBool(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < bools.size(); ++i)
-        if (bools[i]->name == n) {
+        if (bools[i]->nameId == id) {
             bools.erase(bools.begin() + i);
             return true;
         }
@@ -242,8 +291,9 @@ bool ParamSet::EraseBool(const std::string &n) {
 }
 
 bool ParamSet::EraseFloat(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < floats.size(); ++i)
-        if (floats[i]->name == n) {
+        if (floats[i]->nameId == id) {
             floats.erase(floats.begin() + i);
             return true;
         }
@@ -251,8 +301,9 @@ bool ParamSet::EraseFloat(const std::string &n) {
 }
 
 bool ParamSet::ErasePoint2f(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < point2fs.size(); ++i)
-        if (point2fs[i]->name == n) {
+        if (point2fs[i]->nameId == id) {
             point2fs.erase(point2fs.begin() + i);
             return true;
         }
@@ -260,8 +311,9 @@ bool ParamSet::ErasePoint2f(const std::string &n) {
 }
 
 bool ParamSet::EraseVector2f(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < vector2fs.size(); ++i)
-        if (vector2fs[i]->name == n) {
+        if (vector2fs[i]->nameId == id) {
             vector2fs.erase(vector2fs.begin() + i);
             return true;
         }
@@ -269,8 +321,9 @@ bool ParamSet::EraseVector2f(const std::string &n) {
 }
 
 bool ParamSet::ErasePoint3f(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < point3fs.size(); ++i)
-        if (point3fs[i]->name == n) {
+        if (point3fs[i]->nameId == id) {
             point3fs.erase(point3fs.begin() + i);
             return true;
         }
@@ -278,8 +331,9 @@ bool ParamSet::ErasePoint3f(const std::string &n) {
 }
 
 bool ParamSet::EraseVector3f(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < vector3fs.size(); ++i)
-        if (vector3fs[i]->name == n) {
+        if (vector3fs[i]->nameId == id) {
             vector3fs.erase(vector3fs.begin() + i);
             return true;
         }
@@ -287,8 +341,9 @@ bool ParamSet::EraseVector3f(const std::string &n) {
 }
 
 bool ParamSet::EraseNormal3f(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < normals.size(); ++i)
-        if (normals[i]->name == n) {
+        if (normals[i]->nameId == id) {
             normals.erase(normals.begin() + i);
             return true;
         }
@@ -296,8 +351,9 @@ bool ParamSet::EraseNormal3f(const std::string &n) {
 }
 
 bool ParamSet::EraseSpectrum(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < spectra.size(); ++i)
-        if (spectra[i]->name == n) {
+        if (spectra[i]->nameId == id) {
             spectra.erase(spectra.begin() + i);
             return true;
         }
@@ -305,8 +361,9 @@ bool ParamSet::EraseSpectrum(const std::string &n) {
 }
 
 bool ParamSet::EraseString(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < strings.size(); ++i)
-        if (strings[i]->name == n) {
+        if (strings[i]->nameId == id) {
             strings.erase(strings.begin() + i);
             return true;
         }
@@ -314,8 +371,9 @@ bool ParamSet::EraseString(const std::string &n) {
 }
 
 bool ParamSet::EraseTexture(const std::string &n) {
+    uint32_t id = InternParamName(n);
     for (size_t i = 0; i < textures.size(); ++i)
-        if (textures[i]->name == n) {
+        if (textures[i]->nameId == id) {
             textures.erase(textures.begin() + i);
             return true;
         }
@@ -323,8 +381,9 @@ bool ParamSet::EraseTexture(const std::string &n) {
 }
 
 Float ParamSet::FindOneFloat(const std::string &name, Float d) const {
+    uint32_t id = InternParamName(name);
     for (const auto &f : floats)
-        if (f->name == name && f->nValues == 1) {
+        if (f->nameId == id && f->nValues == 1) {
             f->lookedUp = true;
             return f->values[0];
         }
@@ -332,8 +391,9 @@ Float ParamSet::FindOneFloat(const std::string &name, Float d) const {
 }
 
 const Float *ParamSet::FindFloat(const std::string &name, int *n) const {
+    uint32_t id = InternParamName(name);
     for (const auto &f : floats)
-        if (f->name == name) {
+        if (f->nameId == id) {
             *n = f->nValues;
             f->lookedUp = true;
             return f->values.get();
@@ -459,7 +519,7 @@ void ParamSet::ReportUnused() const {
 }
 
 void ParamSet::Clear() {
-#define DEL_PARAMS(name) (name).erase((name).begin(), (name).end())
+#define DEL_PARAMS(name) (name).clear()
     DEL_PARAMS(ints);
     DEL_PARAMS(bools);
     DEL_PARAMS(floats);
@@ -689,7 +749,7 @@ static int print(const Spectrum &s) {
 template <typename T>
 static void printItems(
     const char *type, int indent,
-    const std::vector<std::shared_ptr<ParamSetItem<T>>> &items) {
+    const InlinedVector<std::shared_ptr<ParamSetItem<T>>, 2> &items) {
     for (const auto &item : items) {
         int np = printf("\n%*s\"%s %s\" [ ", indent + 8, "", type,
                         item->name.c_str());
@@ -819,8 +879,8 @@ std::shared_ptr<Texture<Float>> TextureParams::GetFloatTextureOrNull(
 
 template <typename T> static void
 reportUnusedMaterialParams(
-    const std::vector<std::shared_ptr<ParamSetItem<T>>> &mtl,
-    const std::vector<std::shared_ptr<ParamSetItem<T>>> &geom) {
+    const InlinedVector<std::shared_ptr<ParamSetItem<T>>, 2> &mtl,
+    const InlinedVector<std::shared_ptr<ParamSetItem<T>>, 2> &geom) {
     for (const auto &param : mtl) {
         if (param->lookedUp)
             continue;
@@ -829,7 +889,7 @@ reportUnusedMaterialParams(
         // values were provided by a shape parameter.
         if (std::find_if(geom.begin(), geom.end(),
                          [&param](const std::shared_ptr<ParamSetItem<T>> &gp) {
-                             return gp->name == param->name;
+                             return gp->nameId == param->nameId;
                          }) == geom.end())
             Warning("Parameter \"%s\" not used", param->name.c_str());
     }
@@ -42,13 +42,21 @@
 #include "pbrt.h"
 #include "fileutil.h"
 #include "geometry.h"
+#include "memory.h"
 #include "texture.h"
 #include "spectrum.h"
 #include <stdio.h>
 #include <map>
+#include <mutex>
 
 namespace pbrt {
 
+// Intern a parameter name, returning a small integer id that is stable for
+// the process's lifetime. ParamSet lookups intern the queried name once and
+// then compare ids, replacing a string comparison per stored parameter with
+// an integer one.
+uint32_t InternParamName(const std::string &name);
+
 // ParamSet Declarations
 class ParamSet {
   public:
@@ -125,18 +133,22 @@ class ParamSet {
     friend bool shapeMaySetMaterialParameters(const ParamSet &ps);
 
     // ParamSet Private Data
-    std::vector<std::shared_ptr<ParamSetItem<bool>>> bools;
-    std::vector<std::shared_ptr<ParamSetItem<int>>> ints;
-    std::vector<std::shared_ptr<ParamSetItem<Float>>> floats;
-    std::vector<std::shared_ptr<ParamSetItem<Point2f>>> point2fs;
-    std::vector<std::shared_ptr<ParamSetItem<Vector2f>>> vector2fs;
-    std::vector<std::shared_ptr<ParamSetItem<Point3f>>> point3fs;
-    std::vector<std::shared_ptr<ParamSetItem<Vector3f>>> vector3fs;
-    std::vector<std::shared_ptr<ParamSetItem<Normal3f>>> normals;
-    std::vector<std::shared_ptr<ParamSetItem<Spectrum>>> spectra;
-    std::vector<std::shared_ptr<ParamSetItem<std::string>>> strings;
-    std::vector<std::shared_ptr<ParamSetItem<std::string>>> textures;
+
+    // The per-type parameter lists hold their first two items inline;
+    // typical parameter sets then never touch the heap for list storage.
+    InlinedVector<std::shared_ptr<ParamSetItem<bool>>, 2> bools;
+    InlinedVector<std::shared_ptr<ParamSetItem<int>>, 2> ints;
+    InlinedVector<std::shared_ptr<ParamSetItem<Float>>, 2> floats;
+    InlinedVector<std::shared_ptr<ParamSetItem<Point2f>>, 2> point2fs;
+    InlinedVector<std::shared_ptr<ParamSetItem<Vector2f>>, 2> vector2fs;
+    InlinedVector<std::shared_ptr<ParamSetItem<Point3f>>, 2> point3fs;
+    InlinedVector<std::shared_ptr<ParamSetItem<Vector3f>>, 2> vector3fs;
+    InlinedVector<std::shared_ptr<ParamSetItem<Normal3f>>, 2> normals;
+    InlinedVector<std::shared_ptr<ParamSetItem<Spectrum>>, 2> spectra;
+    InlinedVector<std::shared_ptr<ParamSetItem<std::string>>, 2> strings;
+    InlinedVector<std::shared_ptr<ParamSetItem<std::string>>, 2> textures;
     static std::map<std::string, Spectrum> cachedSpectra;
+    static std::mutex cachedSpectraMutex;
 };
 
 template <typename T>
@@ -147,6 +159,7 @@ struct ParamSetItem {
 
     // ParamSetItem Data
     const std::string name;
+    const uint32_t nameId;
     const std::unique_ptr<T[]> values;
     const int nValues;
     mutable bool lookedUp = false;
@@ -156,7 +169,10 @@ struct ParamSetItem {
 template <typename T>
 ParamSetItem<T>::ParamSetItem(const std::string &name, std::unique_ptr<T[]> v,
                               int nValues)
-    : name(name), values(std::move(v)), nValues(nValues) {}
+    : name(name),
+      nameId(InternParamName(name)),
+      values(std::move(v)),
+      nValues(nValues) {}
 
 // TextureParams Declarations
 class TextureParams {
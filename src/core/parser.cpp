@@ -50,10 +50,15 @@
 #elif defined(PBRT_IS_WINDOWS)
 #include <windows.h>  // Windows file mapping API
 #endif
+#include <atomic>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -99,10 +104,12 @@ std::unique_ptr<Tokenizer> Tokenizer::CreateFromFile(
     const std::string &filename,
     std::function<void(const char *)> errorCallback) {
     if (filename == "-") {
-        // Handle stdin by slurping everything into a string.
+        // Handle stdin by slurping everything into a string, reading in
+        // large blocks rather than a byte at a time.
         std::string str;
-        int ch;
-        while ((ch = getchar()) != EOF) str.push_back((char)ch);
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) str.append(buf, n);
         // std::make_unique...
         return std::unique_ptr<Tokenizer>(
             new Tokenizer(std::move(str), std::move(errorCallback)));
@@ -187,8 +194,9 @@ std::unique_ptr<Tokenizer> Tokenizer::CreateFromFile(
     }
 
     std::string str;
-    int ch;
-    while ((ch = fgetc(f)) != EOF) str.push_back(char(ch));
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) str.append(buf, n);
     fclose(f);
 
     // std::make_unique...
@@ -198,20 +206,28 @@ std::unique_ptr<Tokenizer> Tokenizer::CreateFromFile(
 }
 
 std::unique_ptr<Tokenizer> Tokenizer::CreateFromString(
-    std::string str, std::function<void(const char *)> errorCallback) {
+    std::string str, std::function<void(const char *)> errorCallback,
+    const std::string &filename) {
     // return std::make_unique<Tokenizer>(std::move(str));
     return std::unique_ptr<Tokenizer>(
-        new Tokenizer(std::move(str), std::move(errorCallback)));
+        new Tokenizer(std::move(str), std::move(errorCallback), filename));
 }
 
+// Compiled binary token stream header: magic bytes plus a format version.
+// Tokens follow as (uint32 length, bytes) records in native byte order.
+static const char binarySceneMagic[4] = {'P', 'B', 'T', 'K'};
+static const uint32_t binarySceneVersion = 1;
+
 Tokenizer::Tokenizer(std::string str,
-                     std::function<void(const char *)> errorCallback)
-    : loc("<stdin>"),
+                     std::function<void(const char *)> errorCallback,
+                     const std::string &filename)
+    : loc(filename),
       errorCallback(std::move(errorCallback)),
       contents(std::move(str)) {
     pos = contents.data();
     end = pos + contents.size();
     tokenizerMemory += contents.size();
+    checkBinary();
 }
 
 #if defined(PBRT_HAVE_MMAP) || defined(PBRT_IS_WINDOWS)
@@ -223,9 +239,51 @@ Tokenizer::Tokenizer(void *ptr, size_t len, std::string filename,
       unmapLength(len) {
     pos = (const char *)ptr;
     end = pos + len;
+    checkBinary();
 }
 #endif
 
+void Tokenizer::checkBinary() {
+    if (end - pos < 8 || memcmp(pos, binarySceneMagic, 4) != 0) return;
+    uint32_t version;
+    memcpy(&version, pos + 4, sizeof(version));
+    if (version != binarySceneVersion) {
+        errorCallback(StringPrintf("%s: compiled scene file has unsupported "
+                                   "version %u; recompile it",
+                                   loc.filename.c_str(), version)
+                          .c_str());
+        pos = end;
+        return;
+    }
+    binary = true;
+    pos += 8;
+}
+
+string_view Tokenizer::NextBinary() {
+    if (pos == end) return {};
+    uint32_t len;
+    if (end - pos < (ptrdiff_t)sizeof(len)) {
+        errorCallback(StringPrintf("%s: truncated compiled scene file",
+                                   loc.filename.c_str()).c_str());
+        pos = end;
+        return {};
+    }
+    memcpy(&len, pos, sizeof(len));
+    pos += sizeof(len);
+    if ((size_t)(end - pos) < len) {
+        errorCallback(StringPrintf("%s: truncated compiled scene file",
+                                   loc.filename.c_str()).c_str());
+        pos = end;
+        return {};
+    }
+    string_view tok(pos, len);
+    pos += len;
+    // Line numbers don't survive compilation; report the token ordinal in
+    // their place so error messages still localize the problem.
+    ++loc.line;
+    return tok;
+}
+
 Tokenizer::~Tokenizer() {
 #ifdef PBRT_HAVE_MMAP
     if (unmapPtr && unmapLength > 0)
@@ -250,6 +308,7 @@ Tokenizer::~Tokenizer() {
 }
 
 string_view Tokenizer::Next() {
+    if (binary) return NextBinary();
     while (true) {
         const char *tokenStart = pos;
         int ch = getChar();
@@ -319,6 +378,75 @@ string_view Tokenizer::Next() {
     }
 }
 
+// Fast path for parseNumber(): decimal numbers with at most 15 significant
+// digits and a power-of-ten scale within +/-22 convert exactly from an
+// integer mantissa times an exactly-representable power of ten with a
+// single rounding (Clinger's method), so the result matches strtod()
+// without its buffer copy and locale machinery. Scene files are dominated
+// by short fixed-point coordinates, which all land here; anything unusual
+// returns false and takes the strto[lfd] path. (When Float is float the
+// value is still narrowed downstream, as with the existing code.)
+static bool parseNumberFast(string_view str, double *result) {
+    const char *p = str.begin(), *end = str.end();
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int nDigits = 0, exponent = 0;
+    bool sawDigit = false, sawDot = false;
+    for (; p < end; ++p) {
+        char c = *p;
+        if (c >= '0' && c <= '9') {
+            sawDigit = true;
+            if (mantissa == 0 && c == '0') {
+                // Leading zeros don't count as significant digits; they
+                // only shift the exponent when they follow the point.
+                if (sawDot) --exponent;
+                continue;
+            }
+            if (nDigits == 15) return false;
+            mantissa = 10 * mantissa + (c - '0');
+            ++nDigits;
+            if (sawDot) --exponent;
+        } else if (c == '.') {
+            if (sawDot) return false;
+            sawDot = true;
+        } else if (c == 'e' || c == 'E') {
+            ++p;
+            bool expNegative = false;
+            if (p < end && (*p == '+' || *p == '-')) {
+                expNegative = (*p == '-');
+                ++p;
+            }
+            if (p == end) return false;
+            int e = 0;
+            for (; p < end; ++p) {
+                if (*p < '0' || *p > '9') return false;
+                e = 10 * e + (*p - '0');
+                if (e > 60) return false;
+            }
+            exponent += expNegative ? -e : e;
+            break;
+        } else
+            return false;
+    }
+    if (!sawDigit) return false;
+    if (exponent < -22 || exponent > 22) return false;
+    static const double pow10[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                     1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                     1e18, 1e19, 1e20, 1e21, 1e22};
+    double value = (double)mantissa;
+    if (exponent < 0)
+        value /= pow10[-exponent];
+    else
+        value *= pow10[exponent];
+    *result = negative ? -value : value;
+    return true;
+}
+
 static double parseNumber(string_view str) {
     // Fast path for a single digit
     if (str.size() == 1) {
@@ -329,6 +457,9 @@ static double parseNumber(string_view str) {
         return str[0] - '0';
     }
 
+    double fastVal;
+    if (parseNumberFast(str, &fastVal)) return fastVal;
+
     // Copy to a buffer so we can NUL-terminate it, as strto[idf]() expect.
     char buf[64];
     char *bufp = buf;
@@ -385,9 +516,16 @@ static string_view dequoteString(string_view str) {
 struct ParamListItem {
     std::string name;
     double *doubleValues = nullptr;
+    // Float-typed parameters (the giant point/normal/uv arrays above all)
+    // are parsed straight into Float storage, skipping the
+    // double-precision intermediate AddParam() would otherwise convert
+    // from; integer parameters keep the double path, which preserves
+    // index values past float's 24-bit integer range.
+    Float *floatValues = nullptr;
     const char **stringValues = nullptr;
     size_t size = 0;
     bool isString = false;
+    bool wantFloat = false;
 };
 
 PBRT_CONSTEXPR int TokenOptional = 0;
@@ -524,6 +662,11 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                      SpectrumType spectrumType) {
     int type;
     std::string name;
+    // Numeric payloads may be stored in either precision; see ParamListItem
+    auto value = [&item](size_t j) -> Float {
+        return item.floatValues ? item.floatValues[j]
+                                : (Float)item.doubleValues[j];
+    };
     if (lookupType(item.name, &type, name)) {
         if (type == PARAM_TYPE_TEXTURE || type == PARAM_TYPE_STRING ||
             type == PARAM_TYPE_BOOL) {
@@ -551,6 +694,8 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
             int nAlloc = nItems;
             std::unique_ptr<int[]> idata(new int[nAlloc]);
             for (int j = 0; j < nAlloc; ++j)
+                // Integers read from the double path (never stored as
+                // Float; see ParamListItem)
                 idata[j] = int(item.doubleValues[j]);
             ps.AddInt(name, std::move(idata), nItems);
         } else if (type == PARAM_TYPE_BOOL) {
@@ -574,7 +719,7 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
             ps.AddBool(name, std::move(bdata), nItems);
         } else if (type == PARAM_TYPE_FLOAT) {
             std::unique_ptr<Float[]> floats(new Float[nItems]);
-            for (int i = 0; i < nItems; ++i) floats[i] = item.doubleValues[i];
+            for (int i = 0; i < nItems; ++i) floats[i] = value(i);
             ps.AddFloat(name, std::move(floats), nItems);
         } else if (type == PARAM_TYPE_POINT2) {
             if ((nItems % 2) != 0)
@@ -584,8 +729,8 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                     item.name.c_str());
             std::unique_ptr<Point2f[]> pts(new Point2f[nItems / 2]);
             for (int i = 0; i < nItems / 2; ++i) {
-                pts[i].x = item.doubleValues[2 * i];
-                pts[i].y = item.doubleValues[2 * i + 1];
+                pts[i].x = value(2 * i);
+                pts[i].y = value(2 * i + 1);
             }
             ps.AddPoint2f(name, std::move(pts), nItems / 2);
         } else if (type == PARAM_TYPE_VECTOR2) {
@@ -596,8 +741,8 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                     item.name.c_str());
             std::unique_ptr<Vector2f[]> vecs(new Vector2f[nItems / 2]);
             for (int i = 0; i < nItems / 2; ++i) {
-                vecs[i].x = item.doubleValues[2 * i];
-                vecs[i].y = item.doubleValues[2 * i + 1];
+                vecs[i].x = value(2 * i);
+                vecs[i].y = value(2 * i + 1);
             }
             ps.AddVector2f(name, std::move(vecs), nItems / 2);
         } else if (type == PARAM_TYPE_POINT3) {
@@ -608,9 +753,9 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                     item.name.c_str(), nItems % 3);
             std::unique_ptr<Point3f[]> pts(new Point3f[nItems / 3]);
             for (int i = 0; i < nItems / 3; ++i) {
-                pts[i].x = item.doubleValues[3 * i];
-                pts[i].y = item.doubleValues[3 * i + 1];
-                pts[i].z = item.doubleValues[3 * i + 2];
+                pts[i].x = value(3 * i);
+                pts[i].y = value(3 * i + 1);
+                pts[i].z = value(3 * i + 2);
             }
             ps.AddPoint3f(name, std::move(pts), nItems / 3);
         } else if (type == PARAM_TYPE_VECTOR3) {
@@ -621,9 +766,9 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                     item.name.c_str(), nItems % 3);
             std::unique_ptr<Vector3f[]> vecs(new Vector3f[nItems / 3]);
             for (int j = 0; j < nItems / 3; ++j) {
-                vecs[j].x = item.doubleValues[3 * j];
-                vecs[j].y = item.doubleValues[3 * j + 1];
-                vecs[j].z = item.doubleValues[3 * j + 2];
+                vecs[j].x = value(3 * j);
+                vecs[j].y = value(3 * j + 1);
+                vecs[j].z = value(3 * j + 2);
             }
             ps.AddVector3f(name, std::move(vecs), nItems / 3);
         } else if (type == PARAM_TYPE_NORMAL) {
@@ -634,9 +779,9 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                     item.name.c_str(), nItems % 3);
             std::unique_ptr<Normal3f[]> normals(new Normal3f[nItems / 3]);
             for (int j = 0; j < nItems / 3; ++j) {
-                normals[j].x = item.doubleValues[3 * j];
-                normals[j].y = item.doubleValues[3 * j + 1];
-                normals[j].z = item.doubleValues[3 * j + 2];
+                normals[j].x = value(3 * j);
+                normals[j].y = value(3 * j + 1);
+                normals[j].z = value(3 * j + 2);
             }
             ps.AddNormal3f(name, std::move(normals), nItems / 3);
         } else if (type == PARAM_TYPE_RGB) {
@@ -648,7 +793,7 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                 nItems -= nItems % 3;
             }
             std::unique_ptr<Float[]> floats(new Float[nItems]);
-            for (int j = 0; j < nItems; ++j) floats[j] = item.doubleValues[j];
+            for (int j = 0; j < nItems; ++j) floats[j] = value(j);
             ps.AddRGBSpectrum(name, std::move(floats), nItems);
         } else if (type == PARAM_TYPE_XYZ) {
             if ((nItems % 3) != 0) {
@@ -659,7 +804,7 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                 nItems -= nItems % 3;
             }
             std::unique_ptr<Float[]> floats(new Float[nItems]);
-            for (int j = 0; j < nItems; ++j) floats[j] = item.doubleValues[j];
+            for (int j = 0; j < nItems; ++j) floats[j] = value(j);
             ps.AddXYZSpectrum(name, std::move(floats), nItems);
         } else if (type == PARAM_TYPE_BLACKBODY) {
             if ((nItems % 2) != 0) {
@@ -670,7 +815,7 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                 nItems -= nItems % 2;
             }
             std::unique_ptr<Float[]> floats(new Float[nItems]);
-            for (int j = 0; j < nItems; ++j) floats[j] = item.doubleValues[j];
+            for (int j = 0; j < nItems; ++j) floats[j] = value(j);
             ps.AddBlackbodySpectrum(name, std::move(floats), nItems);
         } else if (type == PARAM_TYPE_SPECTRUM) {
             if (item.stringValues) {
@@ -686,7 +831,7 @@ static void AddParam(ParamSet &ps, const ParamListItem &item,
                 }
                 std::unique_ptr<Float[]> floats(new Float[nItems]);
                 for (int j = 0; j < nItems; ++j)
-                    floats[j] = item.doubleValues[j];
+                    floats[j] = value(j);
                 ps.AddSampledSpectrum(name, std::move(floats), nItems);
             }
         } else if (type == PARAM_TYPE_STRING) {
@@ -725,9 +870,20 @@ ParamSet parseParams(Next nextToken, Unget ungetToken, MemoryArena &arena,
         item.name = toString(dequoteString(decl));
         size_t nAlloc = 0;
 
+        // Decide the numeric storage precision from the declared type
+        {
+            int declType;
+            std::string declName;
+            if (lookupType(item.name, &declType, declName))
+                item.wantFloat = declType != PARAM_TYPE_INT &&
+                                 declType != PARAM_TYPE_BOOL &&
+                                 declType != PARAM_TYPE_STRING &&
+                                 declType != PARAM_TYPE_TEXTURE;
+        }
+
         auto addVal = [&](string_view val) {
             if (isQuotedString(val)) {
-                if (item.doubleValues) {
+                if (item.doubleValues || item.floatValues) {
                     Error("mixed string and numeric parameters");
                     exit(1);
                 }
@@ -752,12 +908,22 @@ ParamSet parseParams(Next nextToken, Unget ungetToken, MemoryArena &arena,
 
                 if (item.size == nAlloc) {
                     nAlloc = std::max<size_t>(2 * item.size, 4);
-                    double *newData = arena.Alloc<double>(nAlloc);
-                    std::copy(item.doubleValues, item.doubleValues + item.size,
-                              newData);
-                    item.doubleValues = newData;
+                    if (item.wantFloat) {
+                        Float *newData = arena.Alloc<Float>(nAlloc);
+                        std::copy(item.floatValues,
+                                  item.floatValues + item.size, newData);
+                        item.floatValues = newData;
+                    } else {
+                        double *newData = arena.Alloc<double>(nAlloc);
+                        std::copy(item.doubleValues,
+                                  item.doubleValues + item.size, newData);
+                        item.doubleValues = newData;
+                    }
                 }
-                item.doubleValues[item.size++] = parseNumber(val);
+                if (item.wantFloat)
+                    item.floatValues[item.size++] = (Float)parseNumber(val);
+                else
+                    item.doubleValues[item.size++] = parseNumber(val);
             }
         };
 
@@ -783,6 +949,13 @@ ParamSet parseParams(Next nextToken, Unget ungetToken, MemoryArena &arena,
 extern int catIndentCount;
 
 // Parsing Global Interface
+// Defined with the include pre-lexing machinery below; returns a tokenizer
+// replaying a background-lexed buffer for _filename_, or nullptr if the
+// file wasn't pre-lexed.
+static std::unique_ptr<Tokenizer> GetPreLexedTokenizer(
+    const std::string &filename,
+    std::function<void(const char *)> errorCallback);
+
 static void parse(std::unique_ptr<Tokenizer> t) {
     std::vector<std::unique_ptr<Tokenizer>> fileStack;
     fileStack.push_back(std::move(t));
@@ -925,7 +1098,9 @@ static void parse(std::unique_ptr<Tokenizer> t) {
                     filename = AbsolutePath(ResolveFilename(filename));
                     auto tokError = [](const char *msg) { Error("%s", msg); };
                     std::unique_ptr<Tokenizer> tinc =
-                        Tokenizer::CreateFromFile(filename, tokError);
+                        GetPreLexedTokenizer(filename, tokError);
+                    if (!tinc)
+                        tinc = Tokenizer::CreateFromFile(filename, tokError);
                     if (tinc) {
                         fileStack.push_back(std::move(tinc));
                         parserLoc = &fileStack.back()->loc;
@@ -1091,14 +1266,197 @@ static void parse(std::unique_ptr<Tokenizer> t) {
     }
 }
 
+// Include Pre-Lexing
+//
+// Scenes are commonly structured as one master file plus hundreds of
+// per-asset Include files. While the main thread applies directives in
+// order, background threads scan the master file for Include directives and
+// lex each target into an in-memory binary token buffer (the same format
+// pbrtCompileSceneFile() writes); when parse() reaches the Include, it
+// replays the buffer instead of lexing the file on the critical path.
+// Directive application stays strictly ordered on the main thread - only
+// lexing is offloaded.
+static std::mutex preLexMutex;
+static std::map<std::string, std::future<std::string>> preLexFutures;
+
+// Lex a file into a binary token buffer; returns an empty string on error
+// so the caller falls back to lexing it in place (which also surfaces the
+// error with proper context).
+static std::string LexFileToTokenBuffer(const std::string &filename) {
+    bool hadError = false;
+    auto cb = [&hadError](const char *) { hadError = true; };
+    std::unique_ptr<Tokenizer> t = Tokenizer::CreateFromFile(filename, cb);
+    if (!t) return {};
+    std::string buf(binarySceneMagic, sizeof(binarySceneMagic));
+    buf.append((const char *)&binarySceneVersion, sizeof(binarySceneVersion));
+    while (true) {
+        string_view tok = t->Next();
+        if (tok.empty()) break;
+        uint32_t len = (uint32_t)tok.size();
+        buf.append((const char *)&len, sizeof(len));
+        buf.append(tok.data(), len);
+    }
+    return hadError ? std::string() : buf;
+}
+
+static void StartIncludePreLex(const std::string &filename) {
+    // The scan thread is detached rather than joined: the parser's error
+    // paths exit() directly, and a joinable thread would turn that into
+    // std::terminate. Workers communicate only through the promise/future
+    // pairs, so nothing waits on the threads themselves.
+    std::thread([filename]() {
+        // Scan the master file for Include directives with a throwaway
+        // tokenizer; the master is typically tiny next to its includes.
+        auto quiet = [](const char *) {};
+        std::unique_ptr<Tokenizer> t = Tokenizer::CreateFromFile(filename, quiet);
+        if (!t) return;
+        std::vector<std::string> includes;
+        while (true) {
+            string_view tok = t->Next();
+            if (tok.empty()) break;
+            if (tok == "Include") {
+                string_view fn = t->Next();
+                if (fn.empty() || fn[0] != '"') break;
+                includes.push_back(
+                    AbsolutePath(ResolveFilename(toString(dequoteString(fn)))));
+            }
+        }
+        if (includes.empty()) return;
+
+        // Register a future per distinct include, then lex them with a
+        // small worker pool.
+        std::vector<std::pair<std::string,
+                              std::shared_ptr<std::promise<std::string>>>> work;
+        {
+            std::lock_guard<std::mutex> lock(preLexMutex);
+            for (const std::string &inc : includes) {
+                if (preLexFutures.find(inc) != preLexFutures.end()) continue;
+                auto p = std::make_shared<std::promise<std::string>>();
+                preLexFutures[inc] = p->get_future();
+                work.push_back(std::make_pair(inc, p));
+            }
+        }
+        std::atomic<size_t> nextWork(0);
+        int nWorkers = std::min((int)work.size(), 4);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < nWorkers; ++i)
+            workers.push_back(std::thread([&]() {
+                while (true) {
+                    size_t w = nextWork++;
+                    if (w >= work.size()) break;
+                    work[w].second->set_value(
+                        LexFileToTokenBuffer(work[w].first));
+                }
+            }));
+        for (std::thread &th : workers) th.join();
+    }).detach();
+}
+
+// Return a tokenizer replaying the pre-lexed buffer for _filename_, waiting
+// for an in-flight worker if necessary, or nullptr if the file wasn't
+// pre-lexed (or pre-lexing failed).
+static std::unique_ptr<Tokenizer> GetPreLexedTokenizer(
+    const std::string &filename,
+    std::function<void(const char *)> errorCallback) {
+    std::future<std::string> fut;
+    {
+        std::lock_guard<std::mutex> lock(preLexMutex);
+        auto iter = preLexFutures.find(filename);
+        if (iter == preLexFutures.end()) return nullptr;
+        fut = std::move(iter->second);
+        preLexFutures.erase(iter);
+    }
+    std::string buffer = fut.get();
+    if (buffer.empty()) return nullptr;
+    return Tokenizer::CreateFromString(std::move(buffer),
+                                       std::move(errorCallback), filename);
+}
+
+static void FinishIncludePreLex() {
+    // Drop any buffers that were pre-lexed but never consumed (e.g. an
+    // include behind a parse error); abandoning their futures is safe.
+    std::lock_guard<std::mutex> lock(preLexMutex);
+    preLexFutures.clear();
+}
+
+bool pbrtCompileSceneFile(const std::string &filename,
+                          const std::string &outFilename) {
+    if (filename != "-") SetSearchDirectory(DirectoryContaining(filename));
+    bool hadError = false;
+    auto tokError = [&hadError](const char *msg) {
+        Error("%s", msg);
+        hadError = true;
+    };
+    std::vector<std::unique_ptr<Tokenizer>> fileStack;
+    std::unique_ptr<Tokenizer> t = Tokenizer::CreateFromFile(filename, tokError);
+    if (!t) return false;
+    fileStack.push_back(std::move(t));
+
+    // Write via a temporary so an interrupted compile never leaves a
+    // half-written file that a later run would try to load.
+    std::string tempPath = outFilename + ".tmp";
+    FILE *f = fopen(tempPath.c_str(), "wb");
+    if (!f) {
+        Error("%s: unable to open compiled scene file", tempPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(binarySceneMagic, sizeof(binarySceneMagic), 1, f) == 1 &&
+              fwrite(&binarySceneVersion, sizeof(binarySceneVersion), 1, f) ==
+                  1;
+
+    // Drain the token stream, recursing into Include files so that the
+    // compiled stream is a single flat file, and copy every other token
+    // through verbatim (escapes have already been processed by Next()).
+    while (ok && !fileStack.empty()) {
+        string_view tok = fileStack.back()->Next();
+        if (tok.empty()) {
+            fileStack.pop_back();
+            continue;
+        }
+        if (tok == "Include") {
+            string_view fnTok = fileStack.back()->Next();
+            if (fnTok.empty()) {
+                Error("%s: premature EOF after Include directive",
+                      filename.c_str());
+                ok = false;
+                break;
+            }
+            std::string incName = toString(dequoteString(fnTok));
+            incName = AbsolutePath(ResolveFilename(incName));
+            std::unique_ptr<Tokenizer> tinc =
+                Tokenizer::CreateFromFile(incName, tokError);
+            if (!tinc) {
+                ok = false;
+                break;
+            }
+            fileStack.push_back(std::move(tinc));
+        } else {
+            uint32_t len = (uint32_t)tok.size();
+            ok = fwrite(&len, sizeof(len), 1, f) == 1 &&
+                 fwrite(tok.data(), len, 1, f) == 1;
+        }
+    }
+    if (fclose(f) != 0) ok = false;
+    if (hadError) ok = false;
+    if (!ok || rename(tempPath.c_str(), outFilename.c_str()) != 0) {
+        Error("%s: unable to write compiled scene file", outFilename.c_str());
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
 void pbrtParseFile(std::string filename) {
     if (filename != "-") SetSearchDirectory(DirectoryContaining(filename));
 
     auto tokError = [](const char *msg) { Error("%s", msg); exit(1); };
+    if (filename != "-" && !PbrtOptions.cat && !PbrtOptions.toPly)
+        StartIncludePreLex(filename);
     std::unique_ptr<Tokenizer> t =
         Tokenizer::CreateFromFile(filename, tokError);
     if (!t) return;
     parse(std::move(t));
+    FinishIncludePreLex();
 }
 
 void pbrtParseString(std::string str) {
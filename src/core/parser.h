@@ -106,7 +106,8 @@ class Tokenizer {
         const std::string &filename,
         std::function<void(const char *)> errorCallback);
     static std::unique_ptr<Tokenizer> CreateFromString(
-        std::string str, std::function<void(const char *)> errorCallback);
+        std::string str, std::function<void(const char *)> errorCallback,
+        const std::string &filename = "<stdin>");
 
     ~Tokenizer();
 
@@ -117,12 +118,19 @@ class Tokenizer {
     Loc loc;
 
   private:
-    Tokenizer(std::string str, std::function<void(const char *)> errorCallback);
+    Tokenizer(std::string str, std::function<void(const char *)> errorCallback,
+              const std::string &filename = "<stdin>");
 #if defined(PBRT_HAVE_MMAP) || defined(PBRT_IS_WINDOWS)
     Tokenizer(void *ptr, size_t len, std::string filename,
               std::function<void(const char *)> errorCallback);
 #endif
 
+    // Check whether the buffer holds a compiled binary token stream rather
+    // than scene text, and if so skip its header and switch Next() over to
+    // NextBinary().
+    void checkBinary();
+    string_view NextBinary();
+
     int getChar() {
         if (pos == end) return EOF;
         int ch = *pos++;
@@ -168,8 +176,19 @@ class Tokenizer {
     // thence, string_views from previous calls to Next() must be invalid
     // after a subsequent call, since we may reuse sEscaped.)
     std::string sEscaped;
+
+    // Set if the input is a compiled binary token stream (see
+    // pbrtCompileSceneFile()) rather than scene text.
+    bool binary = false;
 };
 
+// Compile the given scene file - with all of its Include files resolved and
+// inlined - into a binary token stream at _outFilename_ that the Tokenizer
+// detects and replays directly, skipping lexing on subsequent runs. Returns
+// false (and reports errors) on failure.
+bool pbrtCompileSceneFile(const std::string &filename,
+                          const std::string &outFilename);
+
 }  // namespace pbrt
 
 #endif  // PBRT_CORE_PARSER_H
@@ -179,7 +179,55 @@ struct Options {
     bool quickRender = false;
     bool quiet = false;
     bool cat = false, toPly = false;
+    bool resume = false;
+    bool progressive = false;
+    // Re-render the scene whenever its file changes, keeping the process
+    // (and its texture/mesh/transform caches) alive between renders
+    bool watchScene = false;
+    // Distributed rendering: a coordinator listens on distCoordinatorPort
+    // and hands out tiles; workers connect to distWorkerAddress
+    // ("host:port") and stream finished tiles back.
+    int distCoordinatorPort = 0;
+    std::string distWorkerAddress;
+    // Merge completed film tiles in a fixed order so output is
+    // bit-identical regardless of thread count
+    bool deterministic = false;
+    // When > 1, AnimatedTransform interpolation snaps ray times to this
+    // many precomputed buckets across the shutter instead of slerping per
+    // ray; higher values mean less time quantization
+    int motionSteps = 0;
+    // Stop rendering (at a pass boundary) once this much wall time has
+    // elapsed, writing the properly weighted image from the samples
+    // completed; 0 disables the budget
+    Float timeBudgetSeconds = 0;
+    // Render the frame as an n x n grid of crop-window buckets, one
+    // bucket-sized film at a time (constant memory in the bucket size);
+    // buckets are written as separate crop files for "imgtool assemble"
+    int imageBuckets = 1;
+    // Append machine-readable JSON progress lines to this file while
+    // rendering (see ProgressReporter)
+    std::string progressFile;
+    bool transmittanceCache = false;
+    bool costScheduler = false;
+    bool numa = false;
     std::string imageFile;
+    std::string checkpointFile;
+    int checkpointSeconds = 300;
+    std::string profileOutFile;
+    std::string liveStatsFile;
+    int liveStatsSeconds = 5;
+    // Append a versioned JSON telemetry record (stats, profile, peak RSS)
+    // after each render; see WriteTelemetryRecord()
+    std::string telemetryFile;
+    int writeIntervalSeconds = 0;
+    // Pixel-space region to re-render (--renderregion) and the existing
+    // full-frame image to composite the result into (--compositefile)
+    bool haveRenderRegion = false;
+    int renderRegion[4];
+    std::string compositeFile;
+    int textureBudgetMB = 0;
+    bool compressTextures = false;
+    std::string texCacheDir;
     // x0, x1, y0, y1
     Float cropWindow[2][2];
 };
@@ -325,6 +373,35 @@ inline Float Radians(Float deg) { return (Pi / 180) * deg; }
 
 inline Float Degrees(Float rad) { return (180 / Pi) * rad; }
 
+// IEEE half-precision conversions, used for quantized vertex attributes
+// and compressed texture storage
+inline uint16_t FloatToHalf(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = int((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent <= 0) return sign;  // flush denormals and underflow to zero
+    if (exponent >= 31) return sign | 0x7c00;  // overflow to infinity
+    return sign | (uint16_t(exponent) << 10) | uint16_t(mantissa >> 13);
+}
+
+inline float HalfToFloat(uint16_t h) {
+    uint32_t sign = uint32_t(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0 && mantissa == 0)
+        bits = sign;
+    else if (exponent == 31)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
 inline Float Log2(Float x) {
     const Float invLog2 = 1.442695040888963387004650940071;
     return std::log(x) * invLog2;
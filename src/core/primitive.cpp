@@ -43,6 +43,15 @@ STAT_MEMORY_COUNTER("Memory/Primitives", primitiveMemory);
 
 // Primitive Method Definitions
 Primitive::~Primitive() {}
+
+void Primitive::IntersectPStream(RayStream *stream) const {
+    // By default trace the stream's rays one at a time; aggregates that can
+    // amortize work across a bundle override this.
+    stream->occluded.resize(stream->rays.size());
+    for (size_t i = 0; i < stream->rays.size(); ++i)
+        stream->occluded[i] = IntersectP(stream->rays[i]) ? 1 : 0;
+}
+
 const AreaLight *Aggregate::GetAreaLight() const {
     LOG(FATAL) <<
         "Aggregate::GetAreaLight() method"
@@ -147,4 +156,41 @@ void GeometricPrimitive::ComputeScatteringFunctions(
     CHECK_GE(Dot(isect->n, isect->shading.n), 0.);
 }
 
+STAT_COUNTER("Scene/Lazy aggregates built", nLazyAggregatesBuilt);
+
+// LazyAggregate Method Definitions
+LazyAggregate::LazyAggregate(
+    std::vector<std::shared_ptr<Primitive>> prims,
+    std::function<
+        std::shared_ptr<Primitive>(std::vector<std::shared_ptr<Primitive>>)>
+        build)
+    : prims(std::move(prims)), build(std::move(build)) {
+    // The world bound must be known without building the acceleration
+    // structure so an eager top-level hierarchy can be built over instances
+    for (const std::shared_ptr<Primitive> &p : this->prims)
+        bounds = Union(bounds, p->WorldBound());
+}
+
+const Primitive *LazyAggregate::GetOrBuild() const {
+    std::call_once(buildOnce, [this]() {
+        built = build(std::move(prims));
+        prims.clear();
+        prims.shrink_to_fit();
+        ++nLazyAggregatesBuilt;
+    });
+    return built.get();
+}
+
+bool LazyAggregate::Intersect(const Ray &r, SurfaceInteraction *isect) const {
+    return GetOrBuild()->Intersect(r, isect);
+}
+
+bool LazyAggregate::IntersectP(const Ray &r) const {
+    return GetOrBuild()->IntersectP(r);
+}
+
+void LazyAggregate::IntersectPStream(RayStream *stream) const {
+    GetOrBuild()->IntersectPStream(stream);
+}
+
 }  // namespace pbrt
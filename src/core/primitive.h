@@ -44,9 +44,26 @@
 #include "material.h"
 #include "medium.h"
 #include "transform.h"
+#include <functional>
+#include <mutex>
 
 namespace pbrt {
 
+// RayStream Declarations
+struct RayStream {
+    // RayStream Public Methods
+    size_t Size() const { return rays.size(); }
+    void Clear() {
+        rays.clear();
+        occluded.clear();
+    }
+    void AddRay(const Ray &ray) { rays.push_back(ray); }
+
+    // RayStream Public Data
+    std::vector<Ray> rays;
+    std::vector<uint8_t> occluded;
+};
+
 // Primitive Declarations
 class Primitive {
   public:
@@ -55,6 +72,13 @@ class Primitive {
     virtual Bounds3f WorldBound() const = 0;
     virtual bool Intersect(const Ray &r, SurfaceInteraction *) const = 0;
     virtual bool IntersectP(const Ray &r) const = 0;
+    virtual void IntersectPStream(RayStream *stream) const;
+    // Forwarded from Shape::WorldSpaceTriangle() for primitives that wrap a
+    // mesh triangle; lets aggregates batch leaf triangle tests.
+    virtual bool WorldSpaceTriangle(const Point3f **p0, const Point3f **p1,
+                                    const Point3f **p2) const {
+        return false;
+    }
     virtual const AreaLight *GetAreaLight() const = 0;
     virtual const Material *GetMaterial() const = 0;
     virtual void ComputeScatteringFunctions(SurfaceInteraction *isect,
@@ -70,6 +94,10 @@ class GeometricPrimitive : public Primitive {
     virtual Bounds3f WorldBound() const;
     virtual bool Intersect(const Ray &r, SurfaceInteraction *isect) const;
     virtual bool IntersectP(const Ray &r) const;
+    bool WorldSpaceTriangle(const Point3f **p0, const Point3f **p1,
+                            const Point3f **p2) const {
+        return shape->WorldSpaceTriangle(p0, p1, p2);
+    }
     GeometricPrimitive(const std::shared_ptr<Shape> &shape,
                        const std::shared_ptr<Material> &material,
                        const std::shared_ptr<AreaLight> &areaLight,
@@ -126,6 +154,31 @@ class Aggregate : public Primitive {
                                     bool allowMultipleLobes) const;
 };
 
+// LazyAggregate Declarations
+class LazyAggregate : public Aggregate {
+  public:
+    // LazyAggregate Public Methods
+    LazyAggregate(std::vector<std::shared_ptr<Primitive>> prims,
+                  std::function<std::shared_ptr<Primitive>(
+                      std::vector<std::shared_ptr<Primitive>>)> build);
+    Bounds3f WorldBound() const { return bounds; }
+    bool Intersect(const Ray &r, SurfaceInteraction *isect) const;
+    bool IntersectP(const Ray &r) const;
+    void IntersectPStream(RayStream *stream) const;
+
+  private:
+    // LazyAggregate Private Methods
+    const Primitive *GetOrBuild() const;
+
+    // LazyAggregate Private Data
+    mutable std::vector<std::shared_ptr<Primitive>> prims;
+    const std::function<std::shared_ptr<Primitive>(
+        std::vector<std::shared_ptr<Primitive>>)> build;
+    Bounds3f bounds;
+    mutable std::once_flag buildOnce;
+    mutable std::shared_ptr<Primitive> built;
+};
+
 }  // namespace pbrt
 
 #endif  // PBRT_CORE_PRIMITIVE_H
@@ -86,6 +86,47 @@ ProgressReporter::~ProgressReporter() {
         updateThread.join();
         printf("\n");
     }
+    // Final progress line (also the only one in --quiet mode, where the
+    // update thread never runs)
+    EmitProgressLine();
+    if (progressFileHandle) {
+        fclose(progressFileHandle);
+        progressFileHandle = nullptr;
+    }
+}
+
+// Append one JSON progress line to --progressfile: work counts, fraction,
+// elapsed wall seconds, and an ETA extrapolated from an exponentially
+// smoothed recent work rate - responsive to the current pass's cost rather
+// than a whole-render linear fit, so deepening passes don't produce wildly
+// optimistic estimates.
+void ProgressReporter::EmitProgressLine() {
+    if (PbrtOptions.progressFile.empty()) return;
+    if (!progressFileHandle) {
+        progressFileHandle = fopen(PbrtOptions.progressFile.c_str(), "a");
+        if (!progressFileHandle) return;
+    }
+    double elapsed = ElapsedMS() / 1000.;
+    int64_t done = workDone.load(std::memory_order_relaxed);
+    double instantRate = (elapsed > lastEmitTime)
+                             ? (done - lastEmitWork) /
+                                   (elapsed - lastEmitTime)
+                             : 0;
+    smoothedRate = smoothedRate > 0
+                       ? .7 * smoothedRate + .3 * instantRate
+                       : instantRate;
+    lastEmitWork = done;
+    lastEmitTime = elapsed;
+    double eta = (smoothedRate > 0 && done < totalWork)
+                     ? (totalWork - done) / smoothedRate
+                     : 0;
+    fprintf(progressFileHandle,
+            "{\"title\": \"%s\", \"workDone\": %lld, \"totalWork\": "
+            "%lld, \"fraction\": %.4f, \"elapsedSeconds\": %.1f, "
+            "\"etaSeconds\": %.1f}\n",
+            title.c_str(), (long long)done, (long long)totalWork,
+            double(done) / double(totalWork), elapsed, eta);
+    fflush(progressFileHandle);
 }
 
 void ProgressReporter::PrintBar() {
@@ -124,6 +165,8 @@ void ProgressReporter::PrintBar() {
             // After 15m, jump up to 5s intervals
             sleepDuration *= 5;
 
+        EmitProgressLine();
+
         Float percentDone = Float(workDone) / Float(totalWork);
         int plussesNeeded = std::round(totalPlusses * percentDone);
         while (plussesPrinted < plussesNeeded) {
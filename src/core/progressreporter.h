@@ -40,6 +40,7 @@
 
 // core/progressreporter.h*
 #include "pbrt.h"
+#include <cstdio>
 #include <atomic>
 #include <chrono>
 #include <thread>
@@ -53,7 +54,10 @@ class ProgressReporter {
     ProgressReporter(int64_t totalWork, const std::string &title);
     ~ProgressReporter();
     void Update(int64_t num = 1) {
-        if (num == 0 || PbrtOptions.quiet) return;
+        // Track work in quiet mode too when a progress file wants it
+        if (num == 0 ||
+            (PbrtOptions.quiet && PbrtOptions.progressFile.empty()))
+            return;
         workDone += num;
     }
     Float ElapsedMS() const {
@@ -70,6 +74,7 @@ class ProgressReporter {
   private:
     // ProgressReporter Private Methods
     void PrintBar();
+    void EmitProgressLine();
 
     // ProgressReporter Private Data
     const int64_t totalWork;
@@ -78,6 +83,11 @@ class ProgressReporter {
     std::atomic<int64_t> workDone;
     std::atomic<bool> exitThread;
     std::thread updateThread;
+    // --progressfile state (touched only from the update thread)
+    FILE *progressFileHandle = nullptr;
+    int64_t lastEmitWork = 0;
+    double lastEmitTime = 0;
+    double smoothedRate = 0;
 };
 
 }  // namespace pbrt
@@ -237,6 +237,15 @@ Spectrum MicrofacetReflection::f(const Vector3f &wo, const Vector3f &wi) const {
            (4 * cosThetaI * cosThetaO);
 }
 
+bool MicrofacetReflection::GetRecord(BxDFRecord *rec) const {
+    rec->kind = BxDFRecord::Kind::Microfacet;
+    rec->type = type;
+    rec->R = R;
+    return distribution->GetTrowbridgeReitz(&rec->a, &rec->b,
+                                            &rec->sampleVis) &&
+           fresnel->GetRecord(rec);
+}
+
 std::string MicrofacetReflection::ToString() const {
     return std::string("[ MicrofacetReflection R: ") + R.ToString() +
            std::string(" distribution: ") + distribution->ToString() +
@@ -306,6 +315,18 @@ std::string FresnelBlend::ToString() const {
            std::string(" ]");
 }
 
+bool FourierBSDF::GetWeights(Float muI, Float muO) const {
+    if (muI != cachedMuI) {
+        validI = bsdfTable.GetWeightsAndOffset(muI, &offsetI, weightsI);
+        cachedMuI = muI;
+    }
+    if (muO != cachedMuO) {
+        validO = bsdfTable.GetWeightsAndOffset(muO, &offsetO, weightsO);
+        cachedMuO = muO;
+    }
+    return validI && validO;
+}
+
 Spectrum FourierBSDF::f(const Vector3f &wo, const Vector3f &wi) const {
     // Find the zenith angle cosines and azimuth difference angle
     Float muI = CosTheta(-wi), muO = CosTheta(wo);
@@ -313,12 +334,9 @@ Spectrum FourierBSDF::f(const Vector3f &wo, const Vector3f &wi) const {
 
     // Compute Fourier coefficients $a_k$ for $(\mui, \muo)$
 
-    // Determine offsets and weights for $\mui$ and $\muo$
-    int offsetI, offsetO;
-    Float weightsI[4], weightsO[4];
-    if (!bsdfTable.GetWeightsAndOffset(muI, &offsetI, weightsI) ||
-        !bsdfTable.GetWeightsAndOffset(muO, &offsetO, weightsO))
-        return Spectrum(0.f);
+    // Determine offsets and weights for $\mui$ and $\muo$, reusing any
+    // cached from a previous call with the same angles
+    if (!GetWeights(muI, muO)) return Spectrum(0.f);
 
     // Allocate storage to accumulate _ak_ coefficients
     Float *ak = ALLOCA(Float, bsdfTable.mMax * bsdfTable.nChannels);
@@ -537,12 +555,9 @@ Spectrum FourierBSDF::Sample_f(const Vector3f &wo, Vector3f *wi,
 
     // Compute Fourier coefficients $a_k$ for $(\mui, \muo)$
 
-    // Determine offsets and weights for $\mui$ and $\muo$
-    int offsetI, offsetO;
-    Float weightsI[4], weightsO[4];
-    if (!bsdfTable.GetWeightsAndOffset(muI, &offsetI, weightsI) ||
-        !bsdfTable.GetWeightsAndOffset(muO, &offsetO, weightsO))
-        return Spectrum(0.f);
+    // Determine offsets and weights for $\mui$ and $\muo$, reusing any
+    // cached from a previous call with the same angles
+    if (!GetWeights(muI, muO)) return Spectrum(0.f);
 
     // Allocate storage to accumulate _ak_ coefficients
     Float *ak = ALLOCA(Float, bsdfTable.mMax * bsdfTable.nChannels);
@@ -609,12 +624,10 @@ Float FourierBSDF::Pdf(const Vector3f &wo, const Vector3f &wi) const {
     Float muI = CosTheta(-wi), muO = CosTheta(wo);
     Float cosPhi = CosDPhi(-wi, wo);
 
-    // Compute luminance Fourier coefficients $a_k$ for $(\mui, \muo)$
-    int offsetI, offsetO;
-    Float weightsI[4], weightsO[4];
-    if (!bsdfTable.GetWeightsAndOffset(muI, &offsetI, weightsI) ||
-        !bsdfTable.GetWeightsAndOffset(muO, &offsetO, weightsO))
-        return 0;
+    // Compute luminance Fourier coefficients $a_k$ for $(\mui, \muo)$,
+    // reusing cached spline weights when f() was just called with the same
+    // pair of directions
+    if (!GetWeights(muI, muO)) return 0;
     Float *ak = ALLOCA(Float, bsdfTable.mMax);
     memset(ak, 0, bsdfTable.mMax * sizeof(Float));
     int mMax = 0;
@@ -790,6 +803,192 @@ Float BSDF::Pdf(const Vector3f &woWorld, const Vector3f &wiWorld,
     return v;
 }
 
+bool BSDF::Flatten(BSDFClosure *closure) const {
+    closure->eta = eta;
+    closure->ns = ns;
+    closure->ng = ng;
+    closure->ss = ss;
+    closure->ts = ts;
+    closure->nRecords = 0;
+    for (int i = 0; i < nBxDFs; ++i) {
+        if (!bxdfs[i]->GetRecord(&closure->records[closure->nRecords]))
+            return false;
+        ++closure->nRecords;
+    }
+    return true;
+}
+
+// BSDFClosure Method Definitions
+
+// Reconstruct the concrete BxDF described by |rec| on the stack and invoke
+// |func| on it. Since the object's dynamic type is known at each call site,
+// the compiler can dispatch the BxDF's methods statically.
+template <typename R, typename F>
+static R VisitBxDFRecord(const BxDFRecord &rec, F func) {
+    switch (rec.kind) {
+    case BxDFRecord::Kind::Lambertian:
+        return func(LambertianReflection(rec.R));
+    case BxDFRecord::Kind::OrenNayar:
+        return func(OrenNayar(rec.R, rec.a, rec.b));
+    case BxDFRecord::Kind::Microfacet: {
+        FresnelNoOp fresnelNoOp;
+        FresnelDielectric fresnelDielectric(rec.etaI, rec.etaT);
+        FresnelConductor fresnelConductor(rec.fEtaI, rec.fEtaT, rec.fK);
+        Fresnel *fresnel =
+            rec.fresnel == 1
+                ? (Fresnel *)&fresnelDielectric
+                : rec.fresnel == 2 ? (Fresnel *)&fresnelConductor
+                                   : (Fresnel *)&fresnelNoOp;
+        TrowbridgeReitzDistribution distrib(rec.a, rec.b, rec.sampleVis);
+        return func(MicrofacetReflection(rec.R, &distrib, fresnel));
+    }
+    case BxDFRecord::Kind::Specular: {
+        FresnelNoOp fresnelNoOp;
+        FresnelDielectric fresnelDielectric(rec.etaI, rec.etaT);
+        FresnelConductor fresnelConductor(rec.fEtaI, rec.fEtaT, rec.fK);
+        Fresnel *fresnel =
+            rec.fresnel == 1
+                ? (Fresnel *)&fresnelDielectric
+                : rec.fresnel == 2 ? (Fresnel *)&fresnelConductor
+                                   : (Fresnel *)&fresnelNoOp;
+        return func(SpecularReflection(rec.R, fresnel));
+    }
+    }
+    return R();
+}
+
+namespace {
+
+// Functors applied to reconstructed BxDFs by VisitBxDFRecord(); their
+// templated call operators see the concrete BxDF type.
+struct RecordF {
+    Vector3f wo, wi;
+    template <typename T>
+    Spectrum operator()(const T &bxdf) const {
+        return bxdf.f(wo, wi);
+    }
+};
+
+struct RecordPdf {
+    Vector3f wo, wi;
+    template <typename T>
+    Float operator()(const T &bxdf) const {
+        return bxdf.Pdf(wo, wi);
+    }
+};
+
+struct RecordSample_f {
+    Vector3f wo;
+    Vector3f *wi;
+    Point2f u;
+    Float *pdf;
+    BxDFType *sampledType;
+    template <typename T>
+    Spectrum operator()(const T &bxdf) const {
+        return bxdf.Sample_f(wo, wi, u, pdf, sampledType);
+    }
+};
+
+}  // namespace
+
+int BSDFClosure::NumComponents(BxDFType flags) const {
+    int num = 0;
+    for (int i = 0; i < nRecords; ++i)
+        if ((records[i].type & flags) == records[i].type) ++num;
+    return num;
+}
+
+Spectrum BSDFClosure::f(const Vector3f &woW, const Vector3f &wiW,
+                        BxDFType flags) const {
+    ProfilePhase pp(Prof::BSDFEvaluation);
+    Vector3f wi = WorldToLocal(wiW), wo = WorldToLocal(woW);
+    if (wo.z == 0) return 0.;
+    bool reflect = Dot(wiW, ng) * Dot(woW, ng) > 0;
+    Spectrum f(0.f);
+    RecordF eval{wo, wi};
+    for (int i = 0; i < nRecords; ++i)
+        if ((records[i].type & flags) == records[i].type &&
+            ((reflect && (records[i].type & BSDF_REFLECTION)) ||
+             (!reflect && (records[i].type & BSDF_TRANSMISSION))))
+            f += VisitBxDFRecord<Spectrum>(records[i], eval);
+    return f;
+}
+
+Spectrum BSDFClosure::Sample_f(const Vector3f &woWorld, Vector3f *wiWorld,
+                               const Point2f &u, Float *pdf, BxDFType type,
+                               BxDFType *sampledType) const {
+    ProfilePhase pp(Prof::BSDFSampling);
+    // Choose which record to sample, as in BSDF::Sample_f()
+    int matchingComps = NumComponents(type);
+    if (matchingComps == 0) {
+        *pdf = 0;
+        if (sampledType) *sampledType = BxDFType(0);
+        return Spectrum(0);
+    }
+    int comp =
+        std::min((int)std::floor(u[0] * matchingComps), matchingComps - 1);
+    int chosen = -1, count = comp;
+    for (int i = 0; i < nRecords; ++i)
+        if ((records[i].type & type) == records[i].type && count-- == 0) {
+            chosen = i;
+            break;
+        }
+    CHECK_NE(chosen, -1);
+
+    // Remap sample _u_ to $[0,1)^2$ and sample the chosen record
+    Point2f uRemapped(std::min(u[0] * matchingComps - comp, OneMinusEpsilon),
+                      u[1]);
+    Vector3f wi, wo = WorldToLocal(woWorld);
+    if (wo.z == 0) return 0.;
+    *pdf = 0;
+    if (sampledType) *sampledType = records[chosen].type;
+    RecordSample_f sample{wo, &wi, uRemapped, pdf, sampledType};
+    Spectrum f = VisitBxDFRecord<Spectrum>(records[chosen], sample);
+    if (*pdf == 0) {
+        if (sampledType) *sampledType = BxDFType(0);
+        return 0;
+    }
+    *wiWorld = LocalToWorld(wi);
+
+    // Compute overall PDF with all matching records
+    RecordPdf evalPdf{wo, wi};
+    if (!(records[chosen].type & BSDF_SPECULAR) && matchingComps > 1)
+        for (int i = 0; i < nRecords; ++i)
+            if (i != chosen && (records[i].type & type) == records[i].type)
+                *pdf += VisitBxDFRecord<Float>(records[i], evalPdf);
+    if (matchingComps > 1) *pdf /= matchingComps;
+
+    // Compute value of closure for sampled direction
+    if (!(records[chosen].type & BSDF_SPECULAR)) {
+        bool reflect = Dot(*wiWorld, ng) * Dot(woWorld, ng) > 0;
+        f = 0.;
+        RecordF eval{wo, wi};
+        for (int i = 0; i < nRecords; ++i)
+            if ((records[i].type & type) == records[i].type &&
+                ((reflect && (records[i].type & BSDF_REFLECTION)) ||
+                 (!reflect && (records[i].type & BSDF_TRANSMISSION))))
+                f += VisitBxDFRecord<Spectrum>(records[i], eval);
+    }
+    return f;
+}
+
+Float BSDFClosure::Pdf(const Vector3f &woWorld, const Vector3f &wiWorld,
+                       BxDFType flags) const {
+    ProfilePhase pp(Prof::BSDFPdf);
+    if (nRecords == 0) return 0.f;
+    Vector3f wo = WorldToLocal(woWorld), wi = WorldToLocal(wiWorld);
+    if (wo.z == 0) return 0.;
+    Float pdf = 0.f;
+    int matchingComps = 0;
+    RecordPdf evalPdf{wo, wi};
+    for (int i = 0; i < nRecords; ++i)
+        if ((records[i].type & flags) == records[i].type) {
+            ++matchingComps;
+            pdf += VisitBxDFRecord<Float>(records[i], evalPdf);
+        }
+    return matchingComps > 0 ? pdf / matchingComps : 0.f;
+}
+
 std::string BSDF::ToString() const {
     std::string s = StringPrintf("[ BSDF eta: %f nBxDFs: %d", eta, nBxDFs);
     for (int i = 0; i < nBxDFs; ++i)
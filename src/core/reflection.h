@@ -150,6 +150,26 @@ struct FourierBSDFTable {
                              Float weights[4]) const;
 };
 
+// A fixed-size, by-value description of one BxDF lobe. The supported kinds
+// cover the lobes that the common materials (matte, plastic, metal, mirror)
+// add to their BSDFs; all parameters are stored inline so a record has no
+// pointers into a MemoryArena. BxDFs that can be described this way fill
+// one in via BxDF::GetRecord().
+struct BxDFRecord {
+    enum class Kind { Lambertian, OrenNayar, Microfacet, Specular };
+    Kind kind;
+    BxDFType type;
+    Spectrum R;
+    Float a = 0, b = 0;     // OrenNayar A and B; microfacet alphax / alphay
+    bool sampleVis = true;  // microfacet visible-area sampling flag
+    // Flattened Fresnel term: 0 = no-op, 1 = dielectric, 2 = conductor
+    int fresnel = 0;
+    Float etaI = 1, etaT = 1;
+    Spectrum fEtaI, fEtaT, fK;
+};
+
+class BSDFClosure;
+
 class BSDF {
   public:
     // BSDF Public Methods
@@ -164,6 +184,10 @@ class BSDF {
         bxdfs[nBxDFs++] = b;
     }
     int NumComponents(BxDFType flags = BSDF_ALL) const;
+    // Fill *closure with a flattened copy of this BSDF; returns false
+    // (leaving *closure partially written) if any lobe has no BxDFRecord
+    // representation.
+    bool Flatten(BSDFClosure *closure) const;
     Vector3f WorldToLocal(const Vector3f &v) const {
         return Vector3f(Dot(v, ss), Dot(v, ts), Dot(v, ns));
     }
@@ -206,6 +230,48 @@ inline std::ostream &operator<<(std::ostream &os, const BSDF &bsdf) {
     return os;
 }
 
+// BSDFClosure is a flattened alternative to BSDF built from BxDFRecords:
+// all parameters live inline in the object, so closures can be copied by
+// value into shading batches and outlive the arena that held the source
+// BSDF, and evaluation dispatches through a switch over the record kind —
+// reconstructing the concrete BxDF on the stack — instead of chasing
+// per-lobe vtable pointers. The public methods mirror BSDF's and return
+// identical results for BSDFs that Flatten() accepts.
+class BSDFClosure {
+  public:
+    BSDFClosure() {}
+    int NumComponents(BxDFType flags = BSDF_ALL) const;
+    Spectrum f(const Vector3f &woW, const Vector3f &wiW,
+               BxDFType flags = BSDF_ALL) const;
+    Spectrum Sample_f(const Vector3f &woWorld, Vector3f *wiWorld,
+                      const Point2f &u, Float *pdf, BxDFType type = BSDF_ALL,
+                      BxDFType *sampledType = nullptr) const;
+    Float Pdf(const Vector3f &woWorld, const Vector3f &wiWorld,
+              BxDFType flags = BSDF_ALL) const;
+
+    // BSDFClosure Public Data
+    Float eta = 1;
+
+  private:
+    // BSDFClosure Private Methods
+    Vector3f WorldToLocal(const Vector3f &v) const {
+        return Vector3f(Dot(v, ss), Dot(v, ts), Dot(v, ns));
+    }
+    Vector3f LocalToWorld(const Vector3f &v) const {
+        return Vector3f(ss.x * v.x + ts.x * v.y + ns.x * v.z,
+                        ss.y * v.x + ts.y * v.y + ns.y * v.z,
+                        ss.z * v.x + ts.z * v.y + ns.z * v.z);
+    }
+
+    // BSDFClosure Private Data
+    friend class BSDF;
+    Normal3f ns, ng;
+    Vector3f ss, ts;
+    int nRecords = 0;
+    static PBRT_CONSTEXPR int MaxRecords = 8;  // matches BSDF::MaxBxDFs
+    BxDFRecord records[MaxRecords];
+};
+
 // BxDF Declarations
 class BxDF {
   public:
@@ -222,6 +288,10 @@ class BxDF {
     virtual Spectrum rho(int nSamples, const Point2f *samples1,
                          const Point2f *samples2) const;
     virtual Float Pdf(const Vector3f &wo, const Vector3f &wi) const;
+    // Fill *rec with a flattened description of this BxDF for use in a
+    // BSDFClosure; the default implementation reports that the BxDF has no
+    // record representation.
+    virtual bool GetRecord(BxDFRecord *rec) const { return false; }
     virtual std::string ToString() const = 0;
 
     // BxDF Public Data
@@ -262,6 +332,9 @@ class Fresnel {
     // Fresnel Interface
     virtual ~Fresnel();
     virtual Spectrum Evaluate(Float cosI) const = 0;
+    // Store the Fresnel term's parameters in *rec for a BSDFClosure; the
+    // default reports that the term can't be flattened.
+    virtual bool GetRecord(BxDFRecord *rec) const { return false; }
     virtual std::string ToString() const = 0;
 };
 
@@ -277,6 +350,13 @@ class FresnelConductor : public Fresnel {
     FresnelConductor(const Spectrum &etaI, const Spectrum &etaT,
                      const Spectrum &k)
         : etaI(etaI), etaT(etaT), k(k) {}
+    bool GetRecord(BxDFRecord *rec) const {
+        rec->fresnel = 2;
+        rec->fEtaI = etaI;
+        rec->fEtaT = etaT;
+        rec->fK = k;
+        return true;
+    }
     std::string ToString() const;
 
   private:
@@ -288,6 +368,12 @@ class FresnelDielectric : public Fresnel {
     // FresnelDielectric Public Methods
     Spectrum Evaluate(Float cosThetaI) const;
     FresnelDielectric(Float etaI, Float etaT) : etaI(etaI), etaT(etaT) {}
+    bool GetRecord(BxDFRecord *rec) const {
+        rec->fresnel = 1;
+        rec->etaI = etaI;
+        rec->etaT = etaT;
+        return true;
+    }
     std::string ToString() const;
 
   private:
@@ -297,6 +383,10 @@ class FresnelDielectric : public Fresnel {
 class FresnelNoOp : public Fresnel {
   public:
     Spectrum Evaluate(Float) const { return Spectrum(1.); }
+    bool GetRecord(BxDFRecord *rec) const {
+        rec->fresnel = 0;
+        return true;
+    }
     std::string ToString() const { return "[ FresnelNoOp ]"; }
 };
 
@@ -313,6 +403,12 @@ class SpecularReflection : public BxDF {
     Spectrum Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &sample,
                       Float *pdf, BxDFType *sampledType) const;
     Float Pdf(const Vector3f &wo, const Vector3f &wi) const { return 0; }
+    bool GetRecord(BxDFRecord *rec) const {
+        rec->kind = BxDFRecord::Kind::Specular;
+        rec->type = type;
+        rec->R = R;
+        return fresnel->GetRecord(rec);
+    }
     std::string ToString() const;
 
   private:
@@ -382,6 +478,12 @@ class LambertianReflection : public BxDF {
     Spectrum f(const Vector3f &wo, const Vector3f &wi) const;
     Spectrum rho(const Vector3f &, int, const Point2f *) const { return R; }
     Spectrum rho(int, const Point2f *, const Point2f *) const { return R; }
+    bool GetRecord(BxDFRecord *rec) const {
+        rec->kind = BxDFRecord::Kind::Lambertian;
+        rec->type = type;
+        rec->R = R;
+        return true;
+    }
     std::string ToString() const;
 
   private:
@@ -418,6 +520,18 @@ class OrenNayar : public BxDF {
         A = 1.f - (sigma2 / (2.f * (sigma2 + 0.33f)));
         B = 0.45f * sigma2 / (sigma2 + 0.09f);
     }
+    // Construct directly from the precomputed A and B terms; used when
+    // reconstituting an OrenNayar lobe from a BxDFRecord.
+    OrenNayar(const Spectrum &R, Float A, Float B)
+        : BxDF(BxDFType(BSDF_REFLECTION | BSDF_DIFFUSE)), R(R), A(A), B(B) {}
+    bool GetRecord(BxDFRecord *rec) const {
+        rec->kind = BxDFRecord::Kind::OrenNayar;
+        rec->type = type;
+        rec->R = R;
+        rec->a = A;
+        rec->b = B;
+        return true;
+    }
     std::string ToString() const;
 
   private:
@@ -439,6 +553,7 @@ class MicrofacetReflection : public BxDF {
     Spectrum Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
                       Float *pdf, BxDFType *sampledType) const;
     Float Pdf(const Vector3f &wo, const Vector3f &wi) const;
+    bool GetRecord(BxDFRecord *rec) const;
     std::string ToString() const;
 
   private:
@@ -511,9 +626,24 @@ class FourierBSDF : public BxDF {
     std::string ToString() const;
 
   private:
+    // FourierBSDF Private Methods
+
+    // Compute (or reuse) the spline weights and offsets for the given
+    // zenith angle cosines. The wo-side values are fixed across all of the
+    // f()/Sample_f()/Pdf() calls MIS makes at a shading point, and f() and
+    // Pdf() are typically called back to back with the same wi, so the
+    // sqrt-heavy CatmullRomWeights() setup is cached between calls. (A
+    // FourierBSDF is arena-allocated per intersection and only used from
+    // one thread, so the mutable cache needs no synchronization.)
+    bool GetWeights(Float muI, Float muO) const;
+
     // FourierBSDF Private Data
     const FourierBSDFTable &bsdfTable;
     const TransportMode mode;
+    mutable Float cachedMuI = Infinity, cachedMuO = Infinity;
+    mutable bool validI = false, validO = false;
+    mutable int offsetI = 0, offsetO = 0;
+    mutable Float weightsI[4], weightsO[4];
 };
 
 // BSDF Inline Method Definitions
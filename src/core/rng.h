@@ -83,6 +83,38 @@ class RNG {
         return std::min(OneMinusEpsilon, Float(UniformUInt32() * 0x1p-32f));
 #endif
     }
+    // Fill _v_ with _n_ uniform samples, producing exactly the sequence
+    // that _n_ UniformFloat() calls would. Groups of four are generated
+    // from four interleaved generator lanes, each advancing four steps per
+    // output, so the sequential state-update chain that serializes
+    // repeated single calls overlaps in the CPU pipeline.
+    void UniformFloatN(Float *v, int n) {
+        int i = 0;
+        if (n >= 4) {
+            // Derive the four lane states and the four-step affine update
+            uint64_t s0 = state;
+            uint64_t s1 = s0 * PCG32_MULT + inc;
+            uint64_t s2 = s1 * PCG32_MULT + inc;
+            uint64_t s3 = s2 * PCG32_MULT + inc;
+            uint64_t a2 = PCG32_MULT * PCG32_MULT;
+            uint64_t c2 = (PCG32_MULT + 1) * inc;
+            uint64_t a4 = a2 * a2;
+            uint64_t c4 = (a2 + 1) * c2;
+            for (; i + 4 <= n; i += 4) {
+                v[i] = OutputFloat(s0);
+                v[i + 1] = OutputFloat(s1);
+                v[i + 2] = OutputFloat(s2);
+                v[i + 3] = OutputFloat(s3);
+                s0 = s0 * a4 + c4;
+                s1 = s1 * a4 + c4;
+                s2 = s2 * a4 + c4;
+                s3 = s3 * a4 + c4;
+            }
+            // Lane zero's state is the serial state after _i_ steps
+            state = s0;
+        }
+        for (; i < n; ++i) v[i] = UniformFloat();
+    }
     template <typename Iterator>
     void Shuffle(Iterator begin, Iterator end) {
         for (Iterator it = end - 1; it > begin; --it)
@@ -121,6 +153,21 @@ class RNG {
     }
 
   private:
+    // RNG Private Methods
+    static Float OutputFloat(uint64_t oldstate) {
+        uint32_t xorshifted =
+            (uint32_t)(((oldstate >> 18u) ^ oldstate) >> 27u);
+        uint32_t rot = (uint32_t)(oldstate >> 59u);
+        uint32_t bits =
+            (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+#ifndef PBRT_HAVE_HEX_FP_CONSTANTS
+        return std::min(OneMinusEpsilon,
+                        Float(bits * 2.3283064365386963e-10f));
+#else
+        return std::min(OneMinusEpsilon, Float(bits * 0x1p-32f));
+#endif
+    }
+
     // RNG Private Data
     uint64_t state, inc;
 };
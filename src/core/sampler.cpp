@@ -36,6 +36,8 @@
 #include "sampling.h"
 #include "camera.h"
 #include "stats.h"
+#include <cmath>
+#include <mutex>
 
 namespace pbrt {
 
@@ -97,14 +99,103 @@ const Point2f *Sampler::Get2DArray(int n) {
     return &sampleArray2D[array2DOffset++][currentPixelSampleIndex * n];
 }
 
-PixelSampler::PixelSampler(int64_t samplesPerPixel, int nSampledDimensions)
-    : Sampler(samplesPerPixel) {
+PixelSampler::PixelSampler(int64_t samplesPerPixel, int nSampledDimensions,
+                           bool blueNoise)
+    : Sampler(samplesPerPixel), blueNoise(blueNoise) {
     for (int i = 0; i < nSampledDimensions; ++i) {
         samples1D.push_back(std::vector<Float>(samplesPerPixel));
         samples2D.push_back(std::vector<Point2f>(samplesPerPixel));
     }
 }
 
+// Screen-space blue-noise mask for decorrelating pixels' samples. The mask
+// is built once with a greedy largest-void insertion: each rank goes to the
+// point of minimum accumulated Gaussian energy, which yields a
+// high-frequency (blue) distribution of ranks across the tile.
+static PBRT_CONSTEXPR int blueNoiseMaskSize = 64;
+static Float blueNoiseMask[blueNoiseMaskSize][blueNoiseMaskSize];
+static std::once_flag blueNoiseMaskOnce;
+
+static void GenerateBlueNoiseMask() {
+    PBRT_CONSTEXPR int n = blueNoiseMaskSize * blueNoiseMaskSize;
+    PBRT_CONSTEXPR Float sigma = 1.9f;
+    std::vector<Float> energy(n);
+    std::vector<bool> placed(n, false);
+    // Seed with tiny random jitter so the first placements break symmetry
+    // deterministically
+    RNG rng(0);
+    for (int i = 0; i < n; ++i) energy[i] = 1e-4f * rng.UniformFloat();
+    PBRT_CONSTEXPR int radius = 9;
+    for (int rank = 0; rank < n; ++rank) {
+        // Place the next rank at the lowest-energy open position
+        int best = -1;
+        Float bestEnergy = Infinity;
+        for (int i = 0; i < n; ++i)
+            if (!placed[i] && energy[i] < bestEnergy) {
+                best = i;
+                bestEnergy = energy[i];
+            }
+        placed[best] = true;
+        int bx = best % blueNoiseMaskSize, by = best / blueNoiseMaskSize;
+        blueNoiseMask[by][bx] = (rank + .5f) / n;
+        // Splat the new point's Gaussian energy toroidally
+        for (int dy = -radius; dy <= radius; ++dy)
+            for (int dx = -radius; dx <= radius; ++dx) {
+                int x = (bx + dx + blueNoiseMaskSize) % blueNoiseMaskSize;
+                int y = (by + dy + blueNoiseMaskSize) % blueNoiseMaskSize;
+                Float d2 = dx * dx + dy * dy;
+                energy[x + y * blueNoiseMaskSize] +=
+                    std::exp(-d2 / (2 * sigma * sigma));
+            }
+    }
+}
+
+// Toroidal shift for pixel _p_ and dimension _d_: the mask decorrelates
+// pixels and a golden-ratio sequence decorrelates dimensions.
+static Float BlueNoiseShift(const Point2i &p, int d) {
+    Float v = blueNoiseMask[p.y & (blueNoiseMaskSize - 1)]
+                           [p.x & (blueNoiseMaskSize - 1)] +
+              d * (Float)0.6180339887498949;
+    return v - std::floor(v);
+}
+
+void PixelSampler::StartPixel(const Point2i &p) {
+    if (blueNoise) {
+        std::call_once(blueNoiseMaskOnce, GenerateBlueNoiseMask);
+        // Apply per-pixel Cranley-Patterson rotations to the generated
+        // sample values; toroidal shifts preserve stratification
+        auto rotate = [](Float v, Float shift) {
+            v += shift;
+            if (v >= 1) v -= 1;
+            return std::min(v, OneMinusEpsilon);
+        };
+        int d = 0;
+        for (size_t i = 0; i < samples1D.size(); ++i, ++d) {
+            Float shift = BlueNoiseShift(p, d);
+            for (Float &s : samples1D[i]) s = rotate(s, shift);
+        }
+        for (size_t i = 0; i < samples2D.size(); ++i, d += 2) {
+            Float sx = BlueNoiseShift(p, d), sy = BlueNoiseShift(p, d + 1);
+            for (Point2f &s : samples2D[i]) {
+                s.x = rotate(s.x, sx);
+                s.y = rotate(s.y, sy);
+            }
+        }
+        for (size_t i = 0; i < sampleArray1D.size(); ++i, ++d) {
+            Float shift = BlueNoiseShift(p, d);
+            for (Float &s : sampleArray1D[i]) s = rotate(s, shift);
+        }
+        for (size_t i = 0; i < sampleArray2D.size(); ++i, d += 2) {
+            Float sx = BlueNoiseShift(p, d), sy = BlueNoiseShift(p, d + 1);
+            for (Point2f &s : sampleArray2D[i]) {
+                s.x = rotate(s.x, sx);
+                s.y = rotate(s.y, sy);
+            }
+        }
+    }
+    Sampler::StartPixel(p);
+}
+
 bool PixelSampler::StartNextSample() {
     current1DDimension = current2DDimension = 0;
     return Sampler::StartNextSample();
@@ -142,13 +233,26 @@ void GlobalSampler::StartPixel(const Point2i &p) {
     arrayEndDim =
         arrayStartDim + sampleArray1D.size() + 2 * sampleArray2D.size();
 
+    // Compute and cache the pixel's sample indices once; computing them is
+    // costly (e.g. SobolIntervalToIndex) and every array dimension below
+    // reuses the same values
+    int64_t maxArraySamples = 0;
+    for (size_t i = 0; i < samples1DArraySizes.size(); ++i)
+        maxArraySamples = std::max(
+            maxArraySamples, (int64_t)samples1DArraySizes[i] * samplesPerPixel);
+    for (size_t i = 0; i < samples2DArraySizes.size(); ++i)
+        maxArraySamples = std::max(
+            maxArraySamples, (int64_t)samples2DArraySizes[i] * samplesPerPixel);
+    std::vector<int64_t> sampleIndices(maxArraySamples);
+    for (int64_t j = 0; j < maxArraySamples; ++j)
+        sampleIndices[j] = GetIndexForSample(j);
+
     // Compute 1D array samples for _GlobalSampler_
     for (size_t i = 0; i < samples1DArraySizes.size(); ++i) {
         int nSamples = samples1DArraySizes[i] * samplesPerPixel;
-        for (int j = 0; j < nSamples; ++j) {
-            int64_t index = GetIndexForSample(j);
-            sampleArray1D[i][j] = SampleDimension(index, arrayStartDim + i);
-        }
+        for (int j = 0; j < nSamples; ++j)
+            sampleArray1D[i][j] =
+                SampleDimension(sampleIndices[j], arrayStartDim + i);
     }
 
     // Compute 2D array samples for _GlobalSampler_
@@ -156,9 +260,10 @@ void GlobalSampler::StartPixel(const Point2i &p) {
     for (size_t i = 0; i < samples2DArraySizes.size(); ++i) {
         int nSamples = samples2DArraySizes[i] * samplesPerPixel;
         for (int j = 0; j < nSamples; ++j) {
-            int64_t idx = GetIndexForSample(j);
-            sampleArray2D[i][j].x = SampleDimension(idx, dim);
-            sampleArray2D[i][j].y = SampleDimension(idx, dim + 1);
+            Float v[2];
+            SampleDimensionRange(sampleIndices[j], dim, dim + 2, v);
+            sampleArray2D[i][j].x = v[0];
+            sampleArray2D[i][j].y = v[1];
         }
         dim += 2;
     }
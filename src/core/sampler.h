@@ -89,7 +89,9 @@ class Sampler {
 class PixelSampler : public Sampler {
   public:
     // PixelSampler Public Methods
-    PixelSampler(int64_t samplesPerPixel, int nSampledDimensions);
+    PixelSampler(int64_t samplesPerPixel, int nSampledDimensions,
+                 bool blueNoise = false);
+    void StartPixel(const Point2i &p);
     bool StartNextSample();
     bool SetSampleNumber(int64_t);
     Float Get1D();
@@ -101,6 +103,9 @@ class PixelSampler : public Sampler {
     std::vector<std::vector<Point2f>> samples2D;
     int current1DDimension = 0, current2DDimension = 0;
     RNG rng;
+    // Apply per-pixel blue-noise Cranley-Patterson rotations so that
+    // neighboring pixels' error decorrelates toward high frequencies
+    const bool blueNoise;
 };
 
 class GlobalSampler : public Sampler {
@@ -114,6 +119,13 @@ class GlobalSampler : public Sampler {
     GlobalSampler(int64_t samplesPerPixel) : Sampler(samplesPerPixel) {}
     virtual int64_t GetIndexForSample(int64_t sampleNum) const = 0;
     virtual Float SampleDimension(int64_t index, int dimension) const = 0;
+    // Compute several consecutive dimensions of one sample; samplers that
+    // can share per-index work across dimensions override this.
+    virtual void SampleDimensionRange(int64_t index, int dimBegin, int dimEnd,
+                                      Float *v) const {
+        for (int d = dimBegin; d < dimEnd; ++d)
+            v[d - dimBegin] = SampleDimension(index, d);
+    }
 
   private:
     // GlobalSampler Private Data
@@ -34,6 +34,7 @@
 // core/sampling.cpp*
 #include "sampling.h"
 #include "geometry.h"
+#include "parallel.h"
 #include "shape.h"
 
 namespace pbrt {
@@ -41,22 +42,39 @@ namespace pbrt {
 // Sampling Function Definitions
 void StratifiedSample1D(Float *samp, int nSamples, RNG &rng, bool jitter) {
     Float invNSamples = (Float)1 / nSamples;
-    for (int i = 0; i < nSamples; ++i) {
-        Float delta = jitter ? rng.UniformFloat() : 0.5f;
-        samp[i] = std::min((i + delta) * invNSamples, OneMinusEpsilon);
-    }
+    if (jitter) {
+        // Bulk-generate the jitters straight into the output array, then
+        // remap in place; UniformFloatN() produces exactly the sequence
+        // that repeated UniformFloat() calls would, without serializing on
+        // the generator's state-update chain.
+        rng.UniformFloatN(samp, nSamples);
+        for (int i = 0; i < nSamples; ++i)
+            samp[i] = std::min((i + samp[i]) * invNSamples, OneMinusEpsilon);
+    } else
+        for (int i = 0; i < nSamples; ++i)
+            samp[i] = std::min((i + 0.5f) * invNSamples, OneMinusEpsilon);
 }
 
 void StratifiedSample2D(Point2f *samp, int nx, int ny, RNG &rng, bool jitter) {
     Float dx = (Float)1 / nx, dy = (Float)1 / ny;
-    for (int y = 0; y < ny; ++y)
-        for (int x = 0; x < nx; ++x) {
-            Float jx = jitter ? rng.UniformFloat() : 0.5f;
-            Float jy = jitter ? rng.UniformFloat() : 0.5f;
-            samp->x = std::min((x + jx) * dx, OneMinusEpsilon);
-            samp->y = std::min((y + jy) * dy, OneMinusEpsilon);
-            ++samp;
-        }
+    if (jitter) {
+        // As above: fill the (jx, jy) pairs with one bulk pass - the
+        // Point2f array is tightly packed Floats - and remap in place.
+        rng.UniformFloatN(&samp->x, 2 * nx * ny);
+        Point2f *s = samp;
+        for (int y = 0; y < ny; ++y)
+            for (int x = 0; x < nx; ++x, ++s) {
+                s->x = std::min((x + s->x) * dx, OneMinusEpsilon);
+                s->y = std::min((y + s->y) * dy, OneMinusEpsilon);
+            }
+    } else {
+        for (int y = 0; y < ny; ++y)
+            for (int x = 0; x < nx; ++x) {
+                samp->x = std::min((x + 0.5f) * dx, OneMinusEpsilon);
+                samp->y = std::min((y + 0.5f) * dy, OneMinusEpsilon);
+                ++samp;
+            }
+    }
 }
 
 void LatinHypercube(Float *samples, int nSamples, int nDim, RNG &rng) {
@@ -156,12 +174,119 @@ Point2f UniformSampleTriangle(const Point2f &u) {
     return Point2f(1 - su0, u[1] * su0);
 }
 
-Distribution2D::Distribution2D(const Float *func, int nu, int nv) {
-    pConditionalV.reserve(nv);
-    for (int v = 0; v < nv; ++v) {
-        // Compute conditional sampling distribution for $\tilde{v}$
-        pConditionalV.emplace_back(new Distribution1D(&func[v * nu], nu));
+// Distribution1D Method Definitions
+void Distribution1D::BuildAliasTable() {
+    int n = Count();
+    if (funcInt <= 0) return;
+    aliasQ.assign(n, 1);
+    aliasIndex.resize(n);
+    for (int i = 0; i < n; ++i) aliasIndex[i] = i;
+
+    // Vose's algorithm: pair each under-full column with an over-full donor
+    std::vector<Float> scaled(n);
+    for (int i = 0; i < n; ++i) scaled[i] = func[i] / funcInt;
+    std::vector<int> small, large;
+    for (int i = 0; i < n; ++i)
+        (scaled[i] < 1 ? small : large).push_back(i);
+    while (!small.empty() && !large.empty()) {
+        int s = small.back(), l = large.back();
+        small.pop_back();
+        large.pop_back();
+        aliasQ[s] = scaled[s];
+        aliasIndex[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1;
+        (scaled[l] < 1 ? small : large).push_back(l);
     }
+    // Residual columns keep probability one (within round-off)
+    for (int s : small) aliasQ[s] = 1;
+    for (int l : large) aliasQ[l] = 1;
+}
+
+// Build alias tables for the marginal and every conditional distribution
+// in parallel; useful for large environment maps sampled per shadow ray
+void Distribution2D::BuildAliasTables() {
+    ParallelFor([this](int64_t v) {
+        if (v == (int64_t)pConditionalV.size())
+            pMarginal->BuildAliasTable();
+        else
+            pConditionalV[v]->BuildAliasTable();
+    }, pConditionalV.size() + 1, 32);
+}
+
+void Distribution2D::BuildHierarchicalWarp() {
+    int nu = pConditionalV[0]->Count(), nv = pConditionalV.size();
+    int res = RoundUpPow2(std::max(nu, nv));
+    nWarpLevels = Log2Int(res) + 1;
+    // Build the pyramid coarse-to-fine from the (zero-padded) function;
+    // the finest level reads the function directly via WarpMass()
+    warpLevel.resize(nWarpLevels - 1);
+    for (int level = nWarpLevels - 2; level >= 0; --level) {
+        int levelRes = 1 << level;
+        warpLevel[level].resize((size_t)levelRes * levelRes);
+        ParallelFor([&](int64_t y) {
+            for (int x = 0; x < levelRes; ++x)
+                warpLevel[level][x + (size_t)levelRes * y] =
+                    WarpMass(level + 1, 2 * x, 2 * y) +
+                    WarpMass(level + 1, 2 * x + 1, 2 * y) +
+                    WarpMass(level + 1, 2 * x, 2 * y + 1) +
+                    WarpMass(level + 1, 2 * x + 1, 2 * y + 1);
+        }, levelRes, 16);
+    }
+}
+
+Point2f Distribution2D::SampleHierarchical(const Point2f &uIn,
+                                           Float *pdf) const {
+    int nu = pConditionalV[0]->Count(), nv = pConditionalV.size();
+    Point2f u = uIn;
+    int x = 0, y = 0;
+    // Descend the pyramid, splitting the sample by child masses
+    for (int level = 1; level < nWarpLevels; ++level) {
+        x *= 2;
+        y *= 2;
+        Float m00 = WarpMass(level, x, y), m10 = WarpMass(level, x + 1, y);
+        Float m01 = WarpMass(level, x, y + 1),
+              m11 = WarpMass(level, x + 1, y + 1);
+        Float left = m00 + m01, right = m10 + m11;
+        Float total = left + right;
+        if (total <= 0) break;
+        Float pLeft = left / total;
+        Float c0, c1;
+        if (u.x < pLeft) {
+            u.x = std::min(u.x / pLeft, OneMinusEpsilon);
+            c0 = m00;
+            c1 = m01;
+        } else {
+            u.x = std::min((u.x - pLeft) / (1 - pLeft), OneMinusEpsilon);
+            ++x;
+            c0 = m10;
+            c1 = m11;
+        }
+        Float pBottom = c0 / (c0 + c1);
+        if (u.y < pBottom)
+            u.y = std::min(u.y / pBottom, OneMinusEpsilon);
+        else {
+            u.y = std::min((u.y - pBottom) / (1 - pBottom), OneMinusEpsilon);
+            ++y;
+        }
+    }
+    // The chosen function texel's density matches Pdf()'s convention
+    *pdf = WarpMass(nWarpLevels - 1, x, y) / pMarginal->funcInt;
+    // Texel indices map directly into the function's [0,1)^2 domain; the
+    // zero-mass padding cells are never selected
+    return Point2f(std::min((x + u.x) / nu, OneMinusEpsilon),
+                   std::min((y + u.y) / nv, OneMinusEpsilon));
+}
+
+Distribution2D::Distribution2D(const Float *func, int nu, int nv) {
+    // Compute the conditional sampling distributions for each $\tilde{v}$
+    // row in parallel; rows are independent and 16k environment maps have
+    // thousands of them
+    pConditionalV.resize(nv);
+    ParallelFor(
+        [&](int64_t v) {
+            pConditionalV[v].reset(new Distribution1D(&func[v * nu], nu));
+        },
+        nv, 16);
     // Compute marginal sampling distribution $p[\tilde{v}]$
     std::vector<Float> marginalFunc;
     marginalFunc.reserve(nv);
@@ -53,8 +53,26 @@ void StratifiedSample2D(Point2f *samples, int nx, int ny, RNG &rng,
                         bool jitter = true);
 void LatinHypercube(Float *samples, int nSamples, int nDim, RNG &rng);
 struct Distribution1D {
+    // Distribution1D Public Types
+
+    // Non-owning view into _storage_; func and cdf share one contiguous
+    // allocation rather than two separate vectors, which matters when
+    // thousands of distributions are built lazily (e.g. per light-distrib
+    // voxel).
+    struct FloatSpan {
+        Float &operator[](size_t i) { return ptr[i]; }
+        const Float &operator[](size_t i) const { return ptr[i]; }
+        size_t size() const { return n; }
+        const Float *begin() const { return ptr; }
+        const Float *end() const { return ptr + n; }
+        Float *ptr = nullptr;
+        size_t n = 0;
+    };
+
     // Distribution1D Public Methods
-    Distribution1D(const Float *f, int n) : func(f, f + n), cdf(n + 1) {
+    Distribution1D(const Float *f, int n) : storage(2 * n + 1) {
+        BindSpans(n);
+        std::copy(f, f + n, func.ptr);
         // Compute integral of step function at $x_i$
         cdf[0] = 0;
         for (int i = 1; i < n + 1; ++i) cdf[i] = cdf[i - 1] + func[i - 1] / n;
@@ -67,8 +85,59 @@ struct Distribution1D {
             for (int i = 1; i < n + 1; ++i) cdf[i] /= funcInt;
         }
     }
+    // The spans point into _storage_, so copies and moves must rebind them
+    // rather than copying the raw pointers.
+    Distribution1D(const Distribution1D &d)
+        : storage(d.storage),
+          funcInt(d.funcInt),
+          aliasQ(d.aliasQ),
+          aliasIndex(d.aliasIndex) {
+        BindSpans((int)d.func.n);
+    }
+    Distribution1D(Distribution1D &&d)
+        : storage(std::move(d.storage)),
+          funcInt(d.funcInt),
+          aliasQ(std::move(d.aliasQ)),
+          aliasIndex(std::move(d.aliasIndex)) {
+        BindSpans((int)d.func.n);
+    }
+    Distribution1D &operator=(const Distribution1D &d) {
+        if (this == &d) return *this;
+        storage = d.storage;
+        funcInt = d.funcInt;
+        aliasQ = d.aliasQ;
+        aliasIndex = d.aliasIndex;
+        BindSpans((int)d.func.n);
+        return *this;
+    }
     int Count() const { return (int)func.size(); }
+    // Build a Vose alias table so that sampling becomes constant time (one
+    // table probe plus one comparison) instead of a binary search of the
+    // CDF; worthwhile for large distributions sampled per ray.
+    void BuildAliasTable();
+    // Select a bucket and remapped intra-bucket sample via the alias table
+    int AliasSample(Float u, Float *uRemapped) const {
+        int n = Count();
+        Float un = std::min(u * n, (Float)(n - 1) + OneMinusEpsilon);
+        int i = (int)un;
+        Float uFrac = un - i;
+        if (uFrac < aliasQ[i]) {
+            *uRemapped =
+                std::min(uFrac / aliasQ[i], OneMinusEpsilon);
+            return i;
+        }
+        *uRemapped = std::min((uFrac - aliasQ[i]) / (1 - aliasQ[i]),
+                              OneMinusEpsilon);
+        return aliasIndex[i];
+    }
     Float SampleContinuous(Float u, Float *pdf, int *off = nullptr) const {
+        if (!aliasQ.empty()) {
+            Float du;
+            int offset = AliasSample(u, &du);
+            if (off) *off = offset;
+            if (pdf) *pdf = (funcInt > 0) ? func[offset] / funcInt : 0;
+            return (offset + du) / Count();
+        }
         // Find surrounding CDF segments and _offset_
         int offset = FindInterval((int)cdf.size(),
                                   [&](int index) { return cdf[index] <= u; });
@@ -89,6 +158,14 @@ struct Distribution1D {
     }
     int SampleDiscrete(Float u, Float *pdf = nullptr,
                        Float *uRemapped = nullptr) const {
+        if (!aliasQ.empty()) {
+            Float du;
+            int offset = AliasSample(u, &du);
+            if (pdf)
+                *pdf = (funcInt > 0) ? func[offset] / (funcInt * Count()) : 0;
+            if (uRemapped) *uRemapped = du;
+            return offset;
+        }
         // Find surrounding CDF segments and _offset_
         int offset = FindInterval((int)cdf.size(),
                                   [&](int index) { return cdf[index] <= u; });
@@ -104,8 +181,23 @@ struct Distribution1D {
     }
 
     // Distribution1D Public Data
-    std::vector<Float> func, cdf;
+
+    // One contiguous block holding func (n values) followed by cdf (n + 1
+    // values); the spans below view into it.
+    std::vector<Float> storage;
+    FloatSpan func, cdf;
     Float funcInt;
+    // Alias table (empty unless BuildAliasTable() has been called)
+    std::vector<Float> aliasQ;
+    std::vector<int> aliasIndex;
+
+  private:
+    void BindSpans(int n) {
+        func.ptr = storage.data();
+        func.n = n;
+        cdf.ptr = storage.data() + n;
+        cdf.n = n + 1;
+    }
 };
 
 Point2f RejectionSampleDisk(RNG &rng);
@@ -124,7 +216,15 @@ class Distribution2D {
   public:
     // Distribution2D Public Methods
     Distribution2D(const Float *data, int nu, int nv);
+    void BuildAliasTables();
+    // Build a mip pyramid over the function and sample by hierarchically
+    // splitting the 2D sample by quadrant masses; unlike the dependent CDF
+    // inversions (or alias tables), the resulting warp is smooth, so
+    // stratification of the incoming samples survives into the warped
+    // domain.
+    void BuildHierarchicalWarp();
     Point2f SampleContinuous(const Point2f &u, Float *pdf) const {
+        if (!warpLevel.empty()) return SampleHierarchical(u, pdf);
         Float pdfs[2];
         int v;
         Float d1 = pMarginal->SampleContinuous(u[1], &pdfs[1], &v);
@@ -141,9 +241,25 @@ class Distribution2D {
     }
 
   private:
+    // Distribution2D Private Methods
+    Point2f SampleHierarchical(const Point2f &u, Float *pdf) const;
+    // Mass of warp cell (x, y) at _level_, where level _nWarpLevels - 1_
+    // has one cell per function texel (reading the function directly, with
+    // zero padding out to the power-of-two warp resolution)
+    Float WarpMass(int level, int x, int y) const {
+        if (level == nWarpLevels - 1)
+            return (x < pConditionalV[0]->Count() &&
+                    y < (int)pConditionalV.size())
+                       ? pConditionalV[y]->func[x]
+                       : 0;
+        return warpLevel[level][x + ((size_t)1 << level) * y];
+    }
+
     // Distribution2D Private Data
     std::vector<std::unique_ptr<Distribution1D>> pConditionalV;
     std::unique_ptr<Distribution1D> pMarginal;
+    int nWarpLevels = 0;
+    std::vector<std::vector<Float>> warpLevel;
 };
 
 // Sampling Inline Functions
@@ -54,6 +54,11 @@ bool Scene::IntersectP(const Ray &ray) const {
     return aggregate->IntersectP(ray);
 }
 
+void Scene::IntersectPStream(RayStream *stream) const {
+    nShadowTests += stream->Size();
+    aggregate->IntersectPStream(stream);
+}
+
 bool Scene::IntersectTr(Ray ray, Sampler &sampler, SurfaceInteraction *isect,
                         Spectrum *Tr) const {
     *Tr = Spectrum(1.f);
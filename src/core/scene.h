@@ -41,6 +41,7 @@
 // core/scene.h*
 #include "pbrt.h"
 #include "geometry.h"
+#include <map>
 #include "primitive.h"
 #include "light.h"
 
@@ -51,8 +52,12 @@ class Scene {
   public:
     // Scene Public Methods
     Scene(std::shared_ptr<Primitive> aggregate,
-          const std::vector<std::shared_ptr<Light>> &lights)
-        : lights(lights), aggregate(aggregate) {
+          const std::vector<std::shared_ptr<Light>> &lights,
+          std::map<const Material *, std::shared_ptr<Primitive>>
+              probeAccelerators = {})
+        : lights(lights),
+          aggregate(aggregate),
+          probeAccelerators(std::move(probeAccelerators)) {
         // Scene Constructor Implementation
         worldBound = aggregate->WorldBound();
         for (const auto &light : lights) {
@@ -64,8 +69,22 @@ class Scene {
     const Bounds3f &WorldBound() const { return worldBound; }
     bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
     bool IntersectP(const Ray &ray) const;
+    void IntersectPStream(RayStream *stream) const;
     bool IntersectTr(Ray ray, Sampler &sampler, SurfaceInteraction *isect,
                      Spectrum *transmittance) const;
+    // Closest intersection considering only the primitives that share
+    // _material_, via the per-material probe accelerator built in
+    // MakeScene() for subsurface materials; falls back to the full
+    // aggregate when no probe structure exists. Subsurface probe rays only
+    // accept hits on their own material, so the tiny local BVH replaces
+    // whole-scene traversal for them.
+    bool IntersectProbe(const Ray &ray, SurfaceInteraction *isect,
+                        const Material *material) const {
+        auto iter = probeAccelerators.find(material);
+        if (iter != probeAccelerators.end())
+            return iter->second->Intersect(ray, isect);
+        return Intersect(ray, isect);
+    }
 
     // Scene Public Data
     std::vector<std::shared_ptr<Light>> lights;
@@ -76,6 +95,9 @@ class Scene {
   private:
     // Scene Private Data
     std::shared_ptr<Primitive> aggregate;
+    // Per-material accelerators over just that material's primitives, for
+    // subsurface probe rays; see IntersectProbe()
+    std::map<const Material *, std::shared_ptr<Primitive>> probeAccelerators;
     Bounds3f worldBound;
 };
 
@@ -82,6 +82,15 @@ class Shape {
     // used in this case.
     virtual Float SolidAngle(const Point3f &p, int nSamples = 512) const;
 
+    // If the shape is a mesh triangle, returns pointers to its three
+    // world-space vertex positions so that aggregates can run batched
+    // intersection pre-filters over leaf triangles; other shapes return
+    // false.
+    virtual bool WorldSpaceTriangle(const Point3f **p0, const Point3f **p1,
+                                    const Point3f **p2) const {
+        return false;
+    }
+
     // Shape Public Data
     const Transform *ObjectToWorld, *WorldToObject;
     const bool reverseOrientation;
@@ -47,22 +47,42 @@ namespace pbrt {
 // Spectrum Utility Declarations
 static const int sampledLambdaStart = 400;
 static const int sampledLambdaEnd = 700;
+// The spectral sample count can be overridden at build time; small counts
+// (e.g. 4) give a fast hero-wavelength-style spectral mode where each batch
+// of wavelengths is carried in a couple of SIMD registers.
+#ifdef PBRT_N_SPECTRAL_SAMPLES
+static const int nSpectralSamples = PBRT_N_SPECTRAL_SAMPLES;
+#else
 static const int nSpectralSamples = 60;
+#endif
 extern bool SpectrumSamplesSorted(const Float *lambda, const Float *vals,
                                   int n);
 extern void SortSpectrumSamples(Float *lambda, Float *vals, int n);
 extern Float AverageSpectrumSamples(const Float *lambda, const Float *vals,
                                     int n, Float lambdaStart, Float lambdaEnd);
+// CIE RGB <-> XYZ conversion matrices as compile-time constants; the two
+// functions below and any batched conversion code share one definition.
+static PBRT_CONSTEXPR Float XYZToRGBWeights[3][3] = {
+    {3.240479f, -1.537150f, -0.498535f},
+    {-0.969256f, 1.875991f, 0.041556f},
+    {0.055648f, -0.204043f, 1.057311f}};
+static PBRT_CONSTEXPR Float RGBToXYZWeights[3][3] = {
+    {0.412453f, 0.357580f, 0.180423f},
+    {0.212671f, 0.715160f, 0.072169f},
+    {0.019334f, 0.119193f, 0.950227f}};
+
 inline void XYZToRGB(const Float xyz[3], Float rgb[3]) {
-    rgb[0] = 3.240479f * xyz[0] - 1.537150f * xyz[1] - 0.498535f * xyz[2];
-    rgb[1] = -0.969256f * xyz[0] + 1.875991f * xyz[1] + 0.041556f * xyz[2];
-    rgb[2] = 0.055648f * xyz[0] - 0.204043f * xyz[1] + 1.057311f * xyz[2];
+    for (int i = 0; i < 3; ++i)
+        rgb[i] = XYZToRGBWeights[i][0] * xyz[0] +
+                 XYZToRGBWeights[i][1] * xyz[1] +
+                 XYZToRGBWeights[i][2] * xyz[2];
 }
 
 inline void RGBToXYZ(const Float rgb[3], Float xyz[3]) {
-    xyz[0] = 0.412453f * rgb[0] + 0.357580f * rgb[1] + 0.180423f * rgb[2];
-    xyz[1] = 0.212671f * rgb[0] + 0.715160f * rgb[1] + 0.072169f * rgb[2];
-    xyz[2] = 0.019334f * rgb[0] + 0.119193f * rgb[1] + 0.950227f * rgb[2];
+    for (int i = 0; i < 3; ++i)
+        xyz[i] = RGBToXYZWeights[i][0] * rgb[0] +
+                 RGBToXYZWeights[i][1] * rgb[1] +
+                 RGBToXYZWeights[i][2] * rgb[2];
 }
 
 enum class SpectrumType { Reflectance, Illuminant };
@@ -283,6 +303,11 @@ class CoefficientSpectrum {
 
   protected:
     // CoefficientSpectrum Protected Data
+    // Aligned so the fixed-trip-count arithmetic loops in the operators
+    // compile to aligned SIMD loads and stores.
+#ifdef PBRT_HAVE_ALIGNAS
+    alignas(16)
+#endif  // PBRT_HAVE_ALIGNAS
     Float c[nSpectrumSamples];
 };
 
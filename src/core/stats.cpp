@@ -32,13 +32,20 @@
 
 // core/stats.cpp*
 #include "stats.h"
+#include <chrono>
+#include <ctime>
+#ifndef PBRT_IS_WINDOWS
+#include <sys/resource.h>
+#endif
 #include <signal.h>
 #include <algorithm>
 #include <array>
 #include <atomic>
 #include <cinttypes>
 #include <functional>
+#include <chrono>
 #include <mutex>
+#include <thread>
 #include <type_traits>
 #include "parallel.h"
 #include "stringprint.h"
@@ -76,9 +83,13 @@ static void ReportProfileSample(int, siginfo_t *, void *);
 #endif  // PBRT_HAVE_ITIMER
 
 // Statistics Definitions
+
+// Guards _statsAccumulator_ against concurrent access from worker-thread
+// reporting and the live stats thread's snapshots.
+static std::mutex statsMutex;
+
 void ReportThreadStats() {
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> lock(mutex);
+    std::lock_guard<std::mutex> lock(statsMutex);
     StatRegisterer::CallCallbacks(statsAccumulator);
 }
 
@@ -88,8 +99,111 @@ void StatRegisterer::CallCallbacks(StatsAccumulator &accum) {
 
 void PrintStats(FILE *dest) { statsAccumulator.Print(dest); }
 
+void WriteStatsJSON(FILE *dest) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    statsAccumulator.WriteJSON(dest);
+}
+
+// Live Stats Reporting Definitions
+static std::thread liveStatsThread;
+static std::atomic<bool> liveStatsShutdown{false};
+
+static void LiveStatsThreadFunc() {
+    while (!liveStatsShutdown) {
+        // Sleep in short increments so shutdown stays responsive
+        for (int i = 0; i < 4 * PbrtOptions.liveStatsSeconds; ++i) {
+            if (liveStatsShutdown) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        }
+        // Merge the worker threads' counters and write a snapshot via a
+        // temporary file so readers never see a partial document
+        MergeWorkerThreadStats();
+        std::string tmpPath = PbrtOptions.liveStatsFile + ".tmp";
+        FILE *f = fopen(tmpPath.c_str(), "w");
+        if (!f) continue;
+        WriteStatsJSON(f);
+        if (fclose(f) == 0)
+            rename(tmpPath.c_str(), PbrtOptions.liveStatsFile.c_str());
+    }
+}
+
+void StartLiveStatsThread() {
+    if (PbrtOptions.liveStatsFile.empty()) return;
+    liveStatsShutdown = false;
+    liveStatsThread = std::thread(LiveStatsThreadFunc);
+}
+
+void StopLiveStatsThread() {
+    if (!liveStatsThread.joinable()) return;
+    liveStatsShutdown = true;
+    liveStatsThread.join();
+}
+
 void ClearStats() { statsAccumulator.Clear(); }
 
+// Telemetry Export Definitions
+static const auto telemetryStartTime = std::chrono::steady_clock::now();
+
+static std::string JsonEscapeString(const std::string &s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += std::string("\\") + c;
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\t')
+            out += "\\t";
+        else if ((unsigned char)c >= 0x20)
+            out += c;
+    }
+    return out;
+}
+
+// Capture one of the FILE*-writing report functions into a string
+static std::string CaptureReport(void (*writer)(FILE *)) {
+    FILE *f = tmpfile();
+    if (!f) return "";
+    writer(f);
+    long size = ftell(f);
+    rewind(f);
+    std::string s(size > 0 ? (size_t)size : 0, '\0');
+    if (size > 0 && fread(&s[0], 1, size, f) != (size_t)size) s.clear();
+    fclose(f);
+    return s;
+}
+
+void WriteTelemetryRecord(const std::string &path) {
+    FILE *f = fopen(path.c_str(), "a");
+    if (!f) {
+        Warning("Unable to append telemetry record to \"%s\"", path.c_str());
+        return;
+    }
+    long long peakRSS = 0;
+#ifndef PBRT_IS_WINDOWS
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+#ifdef __APPLE__
+        peakRSS = (long long)ru.ru_maxrss;
+#else
+        peakRSS = (long long)ru.ru_maxrss * 1024;
+#endif
+#endif
+    double elapsed = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() -
+                         telemetryStartTime).count();
+    std::string stats = CaptureReport(WriteStatsJSON);
+    std::string profile = CaptureReport(ReportProfilerResults);
+    fprintf(f,
+            "{\"version\": 1, \"timestamp\": %lld, "
+            "\"elapsedSeconds\": %.1f, \"peakRSSBytes\": %lld, "
+            "\"stats\": %s, \"profile\": \"%s\"}\n",
+            (long long)time(nullptr), elapsed, peakRSS,
+            stats.empty() ? "{}" : stats.c_str(),
+            JsonEscapeString(profile).c_str());
+    fclose(f);
+}
+
 static void getCategoryAndTitle(const std::string &str, std::string *category,
                                 std::string *title) {
     const char *s = str.c_str();
@@ -102,6 +216,47 @@ static void getCategoryAndTitle(const std::string &str, std::string *category,
     }
 }
 
+void StatsAccumulator::WriteJSON(FILE *dest) {
+    // Emit every statistic as a flat "Category/Title" key; distributions,
+    // percentages, and ratios expand into one key per component
+    fprintf(dest, "{\n");
+    bool first = true;
+    auto emit = [&](const std::string &name, const std::string &value) {
+        fprintf(dest, "%s  \"%s\": %s", first ? "" : ",\n", name.c_str(),
+                value.c_str());
+        first = false;
+    };
+    for (const auto &c : counters) emit(c.first, std::to_string(c.second));
+    for (const auto &c : memoryCounters)
+        emit(c.first, std::to_string(c.second));
+    for (const auto &d : intDistributionCounts) {
+        if (d.second == 0) continue;
+        emit(d.first + "/sum", std::to_string(intDistributionSums[d.first]));
+        emit(d.first + "/count", std::to_string(d.second));
+        emit(d.first + "/min", std::to_string(intDistributionMins[d.first]));
+        emit(d.first + "/max", std::to_string(intDistributionMaxs[d.first]));
+    }
+    for (const auto &d : floatDistributionCounts) {
+        if (d.second == 0) continue;
+        emit(d.first + "/sum",
+             std::to_string(floatDistributionSums[d.first]));
+        emit(d.first + "/count", std::to_string(d.second));
+        emit(d.first + "/min",
+             std::to_string(floatDistributionMins[d.first]));
+        emit(d.first + "/max",
+             std::to_string(floatDistributionMaxs[d.first]));
+    }
+    for (const auto &p : percentages) {
+        emit(p.first + "/num", std::to_string(p.second.first));
+        emit(p.first + "/denom", std::to_string(p.second.second));
+    }
+    for (const auto &r : ratios) {
+        emit(r.first + "/num", std::to_string(r.second.first));
+        emit(r.first + "/denom", std::to_string(r.second.second));
+    }
+    fprintf(dest, "\n}\n");
+}
+
 void StatsAccumulator::Print(FILE *dest) {
     fprintf(dest, "Statistics:\n");
     std::map<std::string, std::vector<std::string>> toPrint;
@@ -202,6 +357,7 @@ void StatsAccumulator::Clear() {
 }
 
 PBRT_THREAD_LOCAL uint64_t ProfilerState;
+PBRT_THREAD_LOCAL PerRayTraversalStats perRayTraversalStats;
 static std::atomic<bool> profilerRunning{false};
 
 void InitProfiler() {
@@ -264,8 +420,47 @@ void ClearProfiler() {
     }
 }
 
+// Write the profiler's aggregated samples in collapsed-stack format, one
+// line per observed phase combination ("Phase;SubPhase count"), directly
+// consumable by flamegraph.pl and speedscope. The sampling profiler flattens
+// the phase stack into state bits, so frames appear in category declaration
+// order, which matches their nesting in practice.
+void ExportProfilerFlameGraph(const std::string &filename) {
+#ifdef PBRT_HAVE_ITIMER
+    FILE *f = fopen(filename.c_str(), "w");
+    if (!f) {
+        Error("Unable to open profile output file \"%s\".", filename.c_str());
+        return;
+    }
+    PBRT_CONSTEXPR int NumProfCategories = (int)Prof::NumProfCategories;
+    for (const ProfileSample &ps : profileSamples) {
+        uint64_t count = ps.count;
+        if (count == 0) continue;
+        uint64_t state = ps.profilerState;
+        std::string s;
+        for (int b = 0; b < NumProfCategories; ++b)
+            if (state & (1ull << b)) {
+                if (!s.empty()) s += ";";
+                s += ProfNames[b];
+            }
+        if (s.empty()) s = "(unaccounted)";
+        // Flamegraph tools treat spaces as the count separator
+        std::replace(s.begin(), s.end(), ' ', '_');
+        fprintf(f, "%s %" PRIu64 "\n", s.c_str(), count);
+    }
+    fclose(f);
+    LOG(INFO) << "Wrote profiler flame graph data to " << filename;
+#else
+    Warning("Profiling isn't supported on this platform; no profile "
+            "output written.");
+#endif
+}
+
 void CleanupProfiler() {
     CHECK(profilerRunning);
+    // Export the collapsed-stack profile before the samples are discarded
+    if (!PbrtOptions.profileOutFile.empty())
+        ExportProfilerFlameGraph(PbrtOptions.profileOutFile);
 #ifdef PBRT_HAVE_ITIMER
     static struct itimerval timer;
     timer.it_interval.tv_sec = 0;
@@ -69,8 +69,18 @@ class StatRegisterer {
 };
 
 void PrintStats(FILE *dest);
+void WriteStatsJSON(FILE *dest);
+// Append one versioned JSON telemetry record - all statistics, the
+// profiler report, peak RSS, and wall-clock timing - to the given file;
+// used by --telemetry for fleet-wide aggregation.
+void WriteTelemetryRecord(const std::string &path);
 void ClearStats();
 void ReportThreadStats();
+// Background thread that periodically merges worker statistics and writes
+// a JSON snapshot to Options::liveStatsFile so in-flight renders can be
+// monitored externally.
+void StartLiveStatsThread();
+void StopLiveStatsThread();
 
 class StatsAccumulator {
   public:
@@ -121,6 +131,7 @@ class StatsAccumulator {
     }
 
     void Print(FILE *file);
+    void WriteJSON(FILE *file);
     void Clear();
 
   private:
@@ -276,6 +287,7 @@ void SuspendProfiler();
 void ResumeProfiler();
 void ProfilerWorkerThreadInit();
 void ReportProfilerResults(FILE *dest);
+void ExportProfilerFlameGraph(const std::string &filename);
 void ClearProfiler();
 void CleanupProfiler();
 
@@ -353,6 +365,15 @@ void CleanupProfiler();
     }                                                         \
     static StatRegisterer STATS_REG##numVar(STATS_FUNC##numVar)
 
+// Per-ray traversal counters for the accelerator heatmap AOV. Accelerators
+// bump these during traversal; the integrator resets them before each camera
+// ray and accumulates the deltas into the Film's heatmap buffer.
+struct PerRayTraversalStats {
+    int64_t nodesVisited = 0;
+    int64_t primTests = 0;
+};
+extern PBRT_THREAD_LOCAL PerRayTraversalStats perRayTraversalStats;
+
 #define STAT_RATIO(title, numVar, denomVar)                   \
     static PBRT_THREAD_LOCAL int64_t numVar, denomVar;        \
     static void STATS_FUNC##numVar(StatsAccumulator &accum) { \
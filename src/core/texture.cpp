@@ -92,6 +92,7 @@ UVMapping2D::UVMapping2D(Float su, Float sv, Float du, Float dv)
     : su(su), sv(sv), du(du), dv(dv) {}
 Point2f UVMapping2D::Map(const SurfaceInteraction &si, Vector2f *dstdx,
                          Vector2f *dstdy) const {
+    si.EnsureDifferentials();
     // Compute texture differentials for 2D identity mapping
     *dstdx = Vector2f(su * si.dudx, sv * si.dvdx);
     *dstdy = Vector2f(su * si.dudy, sv * si.dvdy);
@@ -100,6 +101,7 @@ Point2f UVMapping2D::Map(const SurfaceInteraction &si, Vector2f *dstdx,
 
 Point2f SphericalMapping2D::Map(const SurfaceInteraction &si, Vector2f *dstdx,
                                 Vector2f *dstdy) const {
+    si.EnsureDifferentials();
     Point2f st = sphere(si.p);
     // Compute texture coordinate differentials for sphere $(u,v)$ mapping
     const Float delta = .1f;
@@ -128,6 +130,7 @@ Point2f SphericalMapping2D::sphere(const Point3f &p) const {
 
 Point2f CylindricalMapping2D::Map(const SurfaceInteraction &si, Vector2f *dstdx,
                                   Vector2f *dstdy) const {
+    si.EnsureDifferentials();
     Point2f st = cylinder(si.p);
     // Compute texture coordinate differentials for cylinder $(u,v)$ mapping
     const Float delta = .01f;
@@ -148,6 +151,7 @@ Point2f CylindricalMapping2D::Map(const SurfaceInteraction &si, Vector2f *dstdx,
 
 Point2f PlanarMapping2D::Map(const SurfaceInteraction &si, Vector2f *dstdx,
                              Vector2f *dstdy) const {
+    si.EnsureDifferentials();
     Vector3f vec(si.p);
     *dstdx = Vector2f(Dot(si.dpdx, vs), Dot(si.dpdx, vt));
     *dstdy = Vector2f(Dot(si.dpdy, vs), Dot(si.dpdy, vt));
@@ -156,6 +160,7 @@ Point2f PlanarMapping2D::Map(const SurfaceInteraction &si, Vector2f *dstdx,
 
 Point3f IdentityMapping3D::Map(const SurfaceInteraction &si, Vector3f *dpdx,
                                Vector3f *dpdy) const {
+    si.EnsureDifferentials();
     *dpdx = WorldToTexture(si.dpdx);
     *dpdy = WorldToTexture(si.dpdy);
     return WorldToTexture(si.p);
@@ -205,6 +210,13 @@ inline Float NoiseWeight(Float t) {
     return 6 * t4 * t - 15 * t4 + 10 * t3;
 }
 
+// Evaluate gradient noise at four independent points; the fixed-count loop
+// unrolls so the four lattice computations' hash-lookup latencies overlap
+// in the pipeline instead of serializing as four separate calls would.
+void Noise4(const Point3f p[4], Float out[4]) {
+    for (int i = 0; i < 4; ++i) out[i] = Noise(p[i].x, p[i].y, p[i].z);
+}
+
 Float FBm(const Point3f &p, const Vector3f &dpdx, const Vector3f &dpdy,
           Float omega, int maxOctaves) {
     // Compute number of octaves for antialiased FBm
@@ -212,9 +224,24 @@ Float FBm(const Point3f &p, const Vector3f &dpdx, const Vector3f &dpdy,
     Float n = Clamp(-1 - .5f * Log2(len2), 0, maxOctaves);
     int nInt = std::floor(n);
 
-    // Compute sum of octaves of noise for FBm
+    // Compute sum of octaves of noise for FBm, evaluating the independent
+    // octave points in batches of four so their lattice work overlaps
     Float sum = 0, lambda = 1, o = 1;
-    for (int i = 0; i < nInt; ++i) {
+    int i = 0;
+    while (i + 4 <= nInt) {
+        Point3f ps[4];
+        Float weights[4], noise[4];
+        for (int j = 0; j < 4; ++j) {
+            ps[j] = lambda * p;
+            weights[j] = o;
+            lambda *= 1.99f;
+            o *= omega;
+        }
+        Noise4(ps, noise);
+        for (int j = 0; j < 4; ++j) sum += weights[j] * noise[j];
+        i += 4;
+    }
+    for (; i < nInt; ++i) {
         sum += o * Noise(lambda * p);
         lambda *= 1.99f;
         o *= omega;
@@ -231,9 +258,24 @@ Float Turbulence(const Point3f &p, const Vector3f &dpdx, const Vector3f &dpdy,
     Float n = Clamp(-1 - .5f * Log2(len2), 0, maxOctaves);
     int nInt = std::floor(n);
 
-    // Compute sum of octaves of noise for turbulence
+    // Compute sum of octaves of noise for turbulence, batching the
+    // independent octave evaluations four at a time
     Float sum = 0, lambda = 1, o = 1;
-    for (int i = 0; i < nInt; ++i) {
+    int i = 0;
+    while (i + 4 <= nInt) {
+        Point3f ps[4];
+        Float weights[4], noise[4];
+        for (int j = 0; j < 4; ++j) {
+            ps[j] = lambda * p;
+            weights[j] = o;
+            lambda *= 1.99f;
+            o *= omega;
+        }
+        Noise4(ps, noise);
+        for (int j = 0; j < 4; ++j) sum += weights[j] * std::abs(noise[j]);
+        i += 4;
+    }
+    for (; i < nInt; ++i) {
         sum += o * std::abs(Noise(lambda * p));
         lambda *= 1.99f;
         o *= omega;
@@ -243,7 +285,7 @@ Float Turbulence(const Point3f &p, const Vector3f &dpdx, const Vector3f &dpdy,
     Float nPartial = n - nInt;
     sum += o * Lerp(SmoothStep(.3f, .7f, nPartial), 0.2,
                     std::abs(Noise(lambda * p)));
-    for (int i = nInt; i < maxOctaves; ++i) {
+    for (int j = nInt; j < maxOctaves; ++j) {
         sum += o * 0.2f;
         o *= omega;
     }
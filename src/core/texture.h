@@ -42,6 +42,10 @@
 #include "pbrt.h"
 #include "spectrum.h"
 #include "geometry.h"
+// Texture::EvaluateN()'s inline default (and the batch overrides in the
+// texture headers) index SurfaceInteraction arrays, which needs the
+// complete type
+#include "interaction.h"
 #include "transform.h"
 #include "memory.h"
 
@@ -136,11 +140,19 @@ class Texture {
   public:
     // Texture Interface
     virtual T Evaluate(const SurfaceInteraction &) const = 0;
+    // Evaluate the texture at a batch of shading points; textures with
+    // per-call overhead worth amortizing (dispatch, mipmap fetches, child
+    // texture batches) override this for wavefront-style shading stages.
+    virtual void EvaluateN(const SurfaceInteraction *si, int n,
+                           T *out) const {
+        for (int i = 0; i < n; ++i) out[i] = Evaluate(si[i]);
+    }
     virtual ~Texture() {}
 };
 
 Float Lanczos(Float, Float tau = 2);
 Float Noise(Float x, Float y = .5f, Float z = .5f);
+void Noise4(const Point3f p[4], Float out[4]);
 Float Noise(const Point3f &p);
 Float FBm(const Point3f &p, const Vector3f &dpdx, const Vector3f &dpdy,
           Float omega, int octaves);
@@ -35,6 +35,11 @@
 #include "transform.h"
 #include "interaction.h"
 
+#if defined(__SSE__) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#define PBRT_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace pbrt {
 
 // Matrix4x4 Method Definitions
@@ -235,6 +240,36 @@ Transform LookAt(const Point3f &pos, const Point3f &look, const Vector3f &up) {
     return Transform(Inverse(cameraToWorld), cameraToWorld);
 }
 
+void Transform::TransformPoints(const Point3f *in, int count,
+                                Point3f *out) const {
+#ifdef PBRT_TRANSFORM_SSE
+    // One SIMD lane per output component (the fourth carries w). Each
+    // lane performs the same operations in the same order as the scalar
+    // operator, so results are bitwise identical.
+    __m128 c0 = _mm_set_ps(m.m[3][0], m.m[2][0], m.m[1][0], m.m[0][0]);
+    __m128 c1 = _mm_set_ps(m.m[3][1], m.m[2][1], m.m[1][1], m.m[0][1]);
+    __m128 c2 = _mm_set_ps(m.m[3][2], m.m[2][2], m.m[1][2], m.m[0][2]);
+    __m128 c3 = _mm_set_ps(m.m[3][3], m.m[2][3], m.m[1][3], m.m[0][3]);
+    for (int i = 0; i < count; ++i) {
+        __m128 r = _mm_add_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(in[i].x), c0),
+                                  _mm_mul_ps(_mm_set1_ps(in[i].y), c1)),
+                       _mm_mul_ps(_mm_set1_ps(in[i].z), c2)),
+            c3);
+        float result[4];
+        _mm_storeu_ps(result, r);
+        Float wp = result[3];
+        CHECK_NE(wp, 0);
+        if (wp == 1)
+            out[i] = Point3f(result[0], result[1], result[2]);
+        else
+            out[i] = Point3f(result[0], result[1], result[2]) / wp;
+    }
+#else
+    for (int i = 0; i < count; ++i) out[i] = (*this)(in[i]);
+#endif
+}
+
 Bounds3f Transform::operator()(const Bounds3f &b) const {
     const Transform &M = *this;
     Bounds3f ret(M(Point3f(b.pMin.x, b.pMin.y, b.pMin.z)));
@@ -393,6 +428,33 @@ void IntervalFindZeros(Float c1, Float c2, Float c3, Float c4, Float c5,
 }
 
 // AnimatedTransform Method Definitions
+// The copy constructor exists because the interpolation cache member is a
+// (non-copyable) atomic pointer; copies start with a cold cache.
+AnimatedTransform::AnimatedTransform(const AnimatedTransform &a)
+    : startTransform(a.startTransform),
+      endTransform(a.endTransform),
+      startTime(a.startTime),
+      endTime(a.endTime),
+      actuallyAnimated(a.actuallyAnimated),
+      hasRotation(a.hasRotation) {
+    for (int i = 0; i < 2; ++i) {
+        T[i] = a.T[i];
+        R[i] = a.R[i];
+        S[i] = a.S[i];
+    }
+    for (int i = 0; i < 3; ++i) {
+        c1[i] = a.c1[i];
+        c2[i] = a.c2[i];
+        c3[i] = a.c3[i];
+        c4[i] = a.c4[i];
+        c5[i] = a.c5[i];
+    }
+}
+
+AnimatedTransform::~AnimatedTransform() {
+    delete interpCache.load(std::memory_order_relaxed);
+}
+
 AnimatedTransform::AnimatedTransform(const Transform *startTransform,
                                      Float startTime,
                                      const Transform *endTransform,
@@ -1151,6 +1213,41 @@ void AnimatedTransform::Interpolate(Float time, Transform *t) const {
         *t = *endTransform;
         return;
     }
+    if (PbrtOptions.motionSteps > 1) {
+        // Snap to the covering bucket of the interpolation cache instead
+        // of performing the slerp and matrix recomposition per ray; the
+        // bucket count bounds the time quantization error.
+        const std::vector<Transform> *cache =
+            interpCache.load(std::memory_order_acquire);
+        if (!cache) cache = BuildInterpCache();
+        int n = (int)cache->size();
+        int i = Clamp((int)((time - startTime) / (endTime - startTime) * n),
+                      0, n - 1);
+        *t = (*cache)[i];
+        return;
+    }
+    InterpolateExact(time, t);
+}
+
+const std::vector<Transform> *AnimatedTransform::BuildInterpCache() const {
+    // Build optimistically; if another thread published a cache first,
+    // discard ours and use theirs.
+    int n = PbrtOptions.motionSteps;
+    std::vector<Transform> *cache = new std::vector<Transform>(n);
+    for (int i = 0; i < n; ++i)
+        InterpolateExact(Lerp((i + .5f) / n, startTime, endTime),
+                         &(*cache)[i]);
+    std::vector<Transform> *expected = nullptr;
+    if (!interpCache.compare_exchange_strong(expected, cache,
+                                             std::memory_order_release,
+                                             std::memory_order_acquire)) {
+        delete cache;
+        return expected;
+    }
+    return cache;
+}
+
+void AnimatedTransform::InterpolateExact(Float time, Transform *t) const {
     Float dt = (time - startTime) / (endTime - startTime);
     // Interpolate translation at _dt_
     Vector3f trans = (1 - dt) * T[0] + dt * T[1];
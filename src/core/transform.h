@@ -43,6 +43,8 @@
 #include "stringprint.h"
 #include "geometry.h"
 #include "quaternion.h"
+#include <atomic>
+#include <vector>
 
 namespace pbrt {
 
@@ -172,6 +174,12 @@ class Transform {
     inline Ray operator()(const Ray &r) const;
     inline RayDifferential operator()(const RayDifferential &r) const;
     Bounds3f operator()(const Bounds3f &b) const;
+    // Transform a whole array of points at once; the matrix columns are
+    // loaded into registers once and each point costs a handful of SIMD
+    // multiply-adds. Used by the mesh-creation path, which transforms
+    // every vertex to world space. Results are bitwise identical to the
+    // single-point operator.
+    void TransformPoints(const Point3f *in, int count, Point3f *out) const;
     Transform operator*(const Transform &t2) const;
     bool SwapsHandedness() const;
     SurfaceInteraction operator()(const SurfaceInteraction &si) const;
@@ -414,6 +422,8 @@ class AnimatedTransform {
     // AnimatedTransform Public Methods
     AnimatedTransform(const Transform *startTransform, Float startTime,
                       const Transform *endTransform, Float endTime);
+    AnimatedTransform(const AnimatedTransform &a);
+    ~AnimatedTransform();
     static void Decompose(const Matrix4x4 &m, Vector3f *T, Quaternion *R,
                           Matrix4x4 *S);
     void Interpolate(Float time, Transform *t) const;
@@ -446,6 +456,17 @@ class AnimatedTransform {
         }
     };
     DerivativeTerm c1[3], c2[3], c3[3], c4[3], c5[3];
+
+    // AnimatedTransform Private Methods
+    void InterpolateExact(Float time, Transform *t) const;
+    const std::vector<Transform> *BuildInterpCache() const;
+
+    // Lazily built time-bucketed interpolation cache (--motionsteps):
+    // bucket i holds the exact interpolation at its midpoint and lookups
+    // snap to the covering bucket, so slerp and matrix recomposition run
+    // motionsteps times total rather than once per ray. Copies start with
+    // a cold cache.
+    mutable std::atomic<std::vector<Transform> *> interpCache{nullptr};
 };
 
 }  // namespace pbrt
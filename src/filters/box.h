@@ -48,6 +48,10 @@ class BoxFilter : public Filter {
   public:
     BoxFilter(const Vector2f &radius) : Filter(radius) {}
     Float Evaluate(const Point2f &p) const;
+    bool SampleOffset(const Point2f &u, Point2f *offset) const {
+        *offset = Point2f((2 * u.x - 1) * radius.x, (2 * u.y - 1) * radius.y);
+        return true;
+    }
 };
 
 BoxFilter *CreateBoxFilter(const ParamSet &ps);
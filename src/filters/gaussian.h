@@ -53,6 +53,20 @@ class GaussianFilter : public Filter {
           expX(std::exp(-alpha * radius.x * radius.x)),
           expY(std::exp(-alpha * radius.y * radius.y)) {}
     Float Evaluate(const Point2f &p) const;
+    bool SampleOffset(const Point2f &u, Point2f *offset) const {
+        // Sample the (untruncated) Gaussian by inverting its CDF and clamp
+        // to the filter radius; the truncation of the tails is a small,
+        // accepted approximation of the offset-subtracted filter shape.
+        Float sigma = 1 / std::sqrt(2 * alpha);
+        auto sampleGaussian = [sigma](Float u, Float r) {
+            Float x = sigma * (Float)1.41421356237f *
+                      ErfInv(Clamp(2 * u - 1, (Float)-.9999, (Float).9999));
+            return Clamp(x, -r, r);
+        };
+        *offset = Point2f(sampleGaussian(u.x, radius.x),
+                          sampleGaussian(u.y, radius.y));
+        return true;
+    }
 
   private:
     // GaussianFilter Private Data
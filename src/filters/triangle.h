@@ -48,6 +48,16 @@ class TriangleFilter : public Filter {
   public:
     TriangleFilter(const Vector2f &radius) : Filter(radius) {}
     Float Evaluate(const Point2f &p) const;
+    bool SampleOffset(const Point2f &u, Point2f *offset) const {
+        // Inverse CDF of the tent function along each axis
+        auto sampleTent = [](Float u, Float r) {
+            return u < .5f ? r * (std::sqrt(2 * u) - 1)
+                           : r * (1 - std::sqrt(2 - 2 * u));
+        };
+        *offset = Point2f(sampleTent(u.x, radius.x),
+                          sampleTent(u.y, radius.y));
+        return true;
+    }
 };
 
 TriangleFilter *CreateTriangleFilter(const ParamSet &ps);
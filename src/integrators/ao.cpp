@@ -79,6 +79,13 @@ Spectrum AOIntegrator::Li(const RayDifferential &r, const Scene &scene,
         Vector3f t = Cross(isect.n, s);
 
         const Point2f *u = sampler.Get2DArray(nSamples);
+        // Warp all hemisphere samples in one tight loop, then trace the
+        // resulting occlusion rays as a single bundle so the accelerator
+        // can amortize node fetches across them
+        RayStream aoRays;
+        aoRays.rays.reserve(nSamples);
+        std::vector<Float> weights;
+        weights.reserve(nSamples);
         for (int i = 0; i < nSamples; ++i) {
             Vector3f wi;
             Float pdf;
@@ -94,10 +101,12 @@ Spectrum AOIntegrator::Li(const RayDifferential &r, const Scene &scene,
             wi = Vector3f(s.x * wi.x + t.x * wi.y + n.x * wi.z,
                           s.y * wi.x + t.y * wi.y + n.y * wi.z,
                           s.z * wi.x + t.z * wi.y + n.z * wi.z);
-
-            if (!scene.IntersectP(isect.SpawnRay(wi)))
-                L += Dot(wi, n) / (pdf * nSamples);
+            aoRays.AddRay(isect.SpawnRay(wi));
+            weights.push_back(Dot(wi, n) / (pdf * nSamples));
         }
+        scene.IntersectPStream(&aoRays);
+        for (int i = 0; i < nSamples; ++i)
+            if (!aoRays.occluded[i]) L += weights[i];
     }
     return L;
 }
@@ -52,6 +52,20 @@ int RandomWalk(const Scene &scene, RayDifferential ray, Sampler &sampler,
                TransportMode mode, Vertex *path);
 
 // BDPT Utility Functions
+
+// Strategy-invariant MIS state: the forward densities of a subpath pair
+// don't change across the O(n^2) (s, t) strategies (only reverse densities
+// and delta flags are remapped per strategy), so their reciprocals are
+// computed once per subpath pair. The epoch is bumped whenever a subpath
+// is (re)generated, which also guards against the arena handing a new
+// path the previous one's address.
+struct MISInvFwdCache {
+    uint64_t epoch = 0;
+    int cameraFilled = 0, lightFilled = 0;
+    std::vector<Float> camera, light;
+};
+static PBRT_THREAD_LOCAL MISInvFwdCache misInvFwdCache;
+static PBRT_THREAD_LOCAL uint64_t misCacheEpoch = 1;
 Float CorrectShadingNormal(const SurfaceInteraction &isect, const Vector3f &wo,
                            const Vector3f &wi, TransportMode mode) {
     if (mode == TransportMode::Importance) {
@@ -80,6 +94,7 @@ int GenerateCameraSubpath(const Scene &scene, Sampler &sampler,
     RayDifferential ray;
     Spectrum beta = camera.GenerateRayDifferential(cameraSample, &ray);
     ray.ScaleDifferentials(1 / std::sqrt(sampler.samplesPerPixel));
+    ++misCacheEpoch;
 
     // Generate first vertex on camera subpath and start random walk
     Float pdfPos, pdfDir;
@@ -101,6 +116,7 @@ int GenerateLightSubpath(
     ProfilePhase _(Prof::BDPTGenerateSubpath);
     // Sample initial ray for light subpath
     Float lightPdf;
+    ++misCacheEpoch;
     int lightNum = lightDistr.SampleDiscrete(sampler.Get1D(), &lightPdf);
     const std::shared_ptr<Light> &light = scene.lights[lightNum];
     RayDifferential ray;
@@ -152,7 +168,8 @@ int RandomWalk(const Scene &scene, RayDifferential ray, Sampler &sampler,
         // Trace a ray and sample the medium, if any
         SurfaceInteraction isect;
         bool foundIntersection = scene.Intersect(ray, &isect);
-        if (ray.medium) beta *= ray.medium->Sample(ray, sampler, arena, &mi);
+        if (ray.medium)
+            beta *= ray.medium->Sample(ray, sampler, arena, &mi, &beta);
         if (beta.IsBlack()) break;
         Vertex &vertex = path[bounces], &prev = path[bounces - 1];
         if (mi.IsValid()) {
@@ -234,6 +251,33 @@ Float MISWeight(const Scene &scene, Vertex *lightVertices,
     // Define helper function _remap0_ that deals with Dirac delta functions
     auto remap0 = [](Float f) -> Float { return f != 0 ? f : 1; };
 
+    // The forward densities are the strategy-invariant half of each
+    // ratio (the ScopedAssignments below only remap reverse densities and
+    // delta flags, except for the whole-vertex swap at s == 1 / t == 1),
+    // so their reciprocals are computed once per subpath pair and reused
+    // across all O(n^2) strategies; the tag is the per-sample vertex
+    // array identity. The cache must be filled before that swap is
+    // installed: strategies run in ascending s, and an s == 1 call that
+    // cached the _sampled_ vertex's density at index 0 would poison every
+    // later strategy of the sample.
+    MISInvFwdCache &invFwd = misInvFwdCache;
+    if (invFwd.epoch != misCacheEpoch) {
+        invFwd.epoch = misCacheEpoch;
+        invFwd.cameraFilled = invFwd.lightFilled = 0;
+    }
+    if (invFwd.cameraFilled < t) {
+        if ((int)invFwd.camera.size() < t) invFwd.camera.resize(t);
+        for (int i = invFwd.cameraFilled; i < t; ++i)
+            invFwd.camera[i] = 1 / remap0(cameraVertices[i].pdfFwd);
+        invFwd.cameraFilled = t;
+    }
+    if (invFwd.lightFilled < s) {
+        if ((int)invFwd.light.size() < s) invFwd.light.resize(s);
+        for (int i = invFwd.lightFilled; i < s; ++i)
+            invFwd.light[i] = 1 / remap0(lightVertices[i].pdfFwd);
+        invFwd.lightFilled = s;
+    }
+
     // Temporarily update vertex properties for current strategy
 
     // Look up connection vertices and their predecessors
@@ -276,8 +320,9 @@ Float MISWeight(const Scene &scene, Vertex *lightVertices,
     // Consider hypothetical connection strategies along the camera subpath
     Float ri = 1;
     for (int i = t - 1; i > 0; --i) {
-        ri *=
-            remap0(cameraVertices[i].pdfRev) / remap0(cameraVertices[i].pdfFwd);
+        // t == 1 never enters this loop, so the swapped vertex's forward
+        // density is never read from the cache here
+        ri *= remap0(cameraVertices[i].pdfRev) * invFwd.camera[i];
         if (!cameraVertices[i].delta && !cameraVertices[i - 1].delta)
             sumRi += ri;
     }
@@ -285,7 +330,12 @@ Float MISWeight(const Scene &scene, Vertex *lightVertices,
     // Consider hypothetical connection strategies along the light subpath
     ri = 1;
     for (int i = s - 1; i >= 0; --i) {
-        ri *= remap0(lightVertices[i].pdfRev) / remap0(lightVertices[i].pdfFwd);
+        // With s == 1, vertex 0 was swapped wholesale for _sampled_ above;
+        // its forward density differs from the cached one
+        Float invFwdPdf = (s == 1 && i == 0)
+                              ? 1 / remap0(lightVertices[i].pdfFwd)
+                              : invFwd.light[i];
+        ri *= remap0(lightVertices[i].pdfRev) * invFwdPdf;
         bool deltaLightvertex = i > 0 ? lightVertices[i - 1].delta
                                       : lightVertices[0].IsDeltaLight();
         if (!lightVertices[i].delta && !deltaLightvertex) sumRi += ri;
@@ -357,6 +407,42 @@ void BDPTIntegrator::Render(const Scene &scene) {
 
             std::unique_ptr<FilmTile> filmTile =
                 camera->film->GetFilmTile(tileBounds);
+            // Light-tracing (t == 1) contributions splat film-wide; batch
+            // them thread-locally so bright pixels shared between tiles
+            // don't become atomic CAS hot spots. Flushes on destruction at
+            // the end of the tile.
+            SplatBuffer splatBuffer(film);
+
+            // Optionally generate a shared pool of light subpaths for this
+            // tile; camera subpaths then connect against pooled paths
+            // round-robin, amortizing the cost of tracing light transport
+            // across many pixels. Pooled paths sample their own times, so
+            // this mode assumes the scene has no transform motion blur.
+            struct PooledLightPath {
+                Vertex *vertices;
+                int n;
+            };
+            std::vector<PooledLightPath> lightPathPool;
+            MemoryArena poolArena;
+            if (lightPathPoolSize > 0) {
+                std::unique_ptr<Sampler> poolSampler =
+                    sampler->Clone(seed + nXTiles * nYTiles);
+                poolSampler->StartPixel(Point2i(x0, y0));
+                const Distribution1D *poolLightDistr =
+                    lightDistribution->Lookup(Point3f(0, 0, 0));
+                for (int i = 0; i < lightPathPoolSize; ++i) {
+                    Vertex *lightVertices =
+                        poolArena.Alloc<Vertex>(maxDepth + 1);
+                    int nLight = GenerateLightSubpath(
+                        scene, *poolSampler, poolArena, maxDepth + 1,
+                        poolSampler->Get1D(), *poolLightDistr, lightToIndex,
+                        lightVertices);
+                    lightPathPool.push_back({lightVertices, nLight});
+                    poolSampler->StartNextSample();
+                }
+            }
+            size_t poolCounter = 0;
+
             for (Point2i pPixel : tileBounds) {
                 tileSampler->StartPixel(pPixel);
                 if (!InsideExclusive(pPixel, pixelBounds))
@@ -367,7 +453,6 @@ void BDPTIntegrator::Render(const Scene &scene) {
 
                     // Trace the camera subpath
                     Vertex *cameraVertices = arena.Alloc<Vertex>(maxDepth + 2);
-                    Vertex *lightVertices = arena.Alloc<Vertex>(maxDepth + 1);
                     int nCamera = GenerateCameraSubpath(
                         scene, *tileSampler, arena, maxDepth + 2, *camera,
                         pFilm, cameraVertices);
@@ -380,11 +465,23 @@ void BDPTIntegrator::Render(const Scene &scene) {
                     // doesn't use the point passed to it.
                     const Distribution1D *lightDistr =
                         lightDistribution->Lookup(cameraVertices[0].p());
-                    // Now trace the light subpath
-                    int nLight = GenerateLightSubpath(
-                        scene, *tileSampler, arena, maxDepth + 1,
-                        cameraVertices[0].time(), *lightDistr, lightToIndex,
-                        lightVertices);
+                    // Use the next pooled light subpath, or trace a fresh
+                    // one when pooling is disabled
+                    Vertex *lightVertices;
+                    int nLight;
+                    if (!lightPathPool.empty()) {
+                        const PooledLightPath &pooled =
+                            lightPathPool[poolCounter++ %
+                                          lightPathPool.size()];
+                        lightVertices = pooled.vertices;
+                        nLight = pooled.n;
+                    } else {
+                        lightVertices = arena.Alloc<Vertex>(maxDepth + 1);
+                        nLight = GenerateLightSubpath(
+                            scene, *tileSampler, arena, maxDepth + 1,
+                            cameraVertices[0].time(), *lightDistr,
+                            lightToIndex, lightVertices);
+                    }
 
                     // Execute all BDPT connection strategies
                     Spectrum L(0.f);
@@ -416,7 +513,7 @@ void BDPTIntegrator::Render(const Scene &scene) {
                             if (t != 1)
                                 L += Lpath;
                             else
-                                film->AddSplat(pFilmNew, Lpath);
+                                splatBuffer.AddSplat(pFilmNew, Lpath);
                         }
                     }
                     VLOG(2) << "Add film sample pFilm: " << pFilm << ", L: " << L <<
@@ -564,8 +661,10 @@ BDPTIntegrator *CreateBDPTIntegrator(const ParamSet &params,
 
     std::string lightStrategy = params.FindOneString("lightsamplestrategy",
                                                      "power");
+    int lightPathPool = params.FindOneInt("lightpathpool", 0);
     return new BDPTIntegrator(sampler, camera, maxDepth, visualizeStrategies,
-                              visualizeWeights, pixelBounds, lightStrategy);
+                              visualizeWeights, pixelBounds, lightStrategy,
+                              lightPathPool);
 }
 
 }  // namespace pbrt
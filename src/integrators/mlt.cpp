@@ -177,26 +177,77 @@ void MLTIntegrator::Render(const Scene &scene) {
     // Generate bootstrap samples and compute normalization constant $b$
     int nBootstrapSamples = nBootstrap * (maxDepth + 1);
     std::vector<Float> bootstrapWeights(nBootstrapSamples, 0);
-    if (scene.lights.size() > 0) {
+    // Optionally reuse the bootstrap luminance table from a previous run
+    // of the same scene ("bootstrapcachefile"): chains reconstruct their
+    // seed paths deterministically from the bootstrap index, so the table
+    // is the only state the bootstrap phase produces. The cache is
+    // explicitly user-managed: the normalization constant b derives from
+    // these weights, so a stale file (scene edited between runs) biases
+    // image brightness - hence no automatic fingerprinting, just the knob
+    // the re-render-at-different-mutation-counts workflow needs.
+    bool bootstrapLoaded = false;
+    if (!bootstrapCacheFile.empty()) {
+        FILE *f = fopen(bootstrapCacheFile.c_str(), "rb");
+        if (f) {
+            int32_t n = 0;
+            uint32_t floatSize = 0;
+            bootstrapLoaded =
+                fread(&floatSize, sizeof(floatSize), 1, f) == 1 &&
+                floatSize == sizeof(Float) &&
+                fread(&n, sizeof(n), 1, f) == 1 && n == nBootstrapSamples &&
+                fread(&bootstrapWeights[0], sizeof(Float), nBootstrapSamples,
+                      f) == (size_t)nBootstrapSamples;
+            fclose(f);
+            if (!bootstrapLoaded)
+                Warning("Ignoring bootstrap cache \"%s\" (size mismatch "
+                        "or truncated).", bootstrapCacheFile.c_str());
+        }
+    }
+    if (!bootstrapLoaded && scene.lights.size() > 0) {
         ProgressReporter progress(nBootstrap / 256,
                                   "Generating bootstrap paths");
         std::vector<MemoryArena> bootstrapThreadArenas(MaxThreadIndex());
         int chunkSize = Clamp(nBootstrap / 128, 1, 8192);
-        ParallelFor([&](int i) {
-            // Generate _i_th bootstrap sample
-            MemoryArena &arena = bootstrapThreadArenas[ThreadIndex];
-            for (int depth = 0; depth <= maxDepth; ++depth) {
+        // Batch the bootstrap evaluations per path depth: every iteration
+        // of a chunk then runs the same-depth strategy code, keeping the
+        // instruction and data paths warm, while each sample's RNG index
+        // (and so its value) is unchanged from the interleaved order.
+        for (int depth = 0; depth <= maxDepth; ++depth) {
+            ParallelFor([&](int i) {
+                MemoryArena &arena = bootstrapThreadArenas[ThreadIndex];
                 int rngIndex = i * (maxDepth + 1) + depth;
                 MLTSampler sampler(mutationsPerPixel, rngIndex, sigma,
                                    largeStepProbability, nSampleStreams);
                 Point2f pRaster;
                 bootstrapWeights[rngIndex] =
-                    L(scene, arena, lightDistr, lightToIndex, sampler, depth, &pRaster).y();
+                    L(scene, arena, lightDistr, lightToIndex, sampler, depth,
+                      &pRaster).y();
                 arena.Reset();
-            }
-            if ((i + 1) % 256 == 0) progress.Update();
-        }, nBootstrap, chunkSize);
+                if (depth == maxDepth && (i + 1) % 256 == 0)
+                    progress.Update();
+            }, nBootstrap, chunkSize);
+        }
         progress.Done();
+        if (!bootstrapCacheFile.empty()) {
+            std::string tempPath = bootstrapCacheFile + ".tmp";
+            FILE *f = fopen(tempPath.c_str(), "wb");
+            if (f) {
+                uint32_t floatSize = sizeof(Float);
+                int32_t n = nBootstrapSamples;
+                bool ok = fwrite(&floatSize, sizeof(floatSize), 1, f) == 1 &&
+                          fwrite(&n, sizeof(n), 1, f) == 1 &&
+                          fwrite(&bootstrapWeights[0], sizeof(Float),
+                                 nBootstrapSamples, f) ==
+                              (size_t)nBootstrapSamples;
+                if (fclose(f) != 0) ok = false;
+                if (!ok || rename(tempPath.c_str(),
+                                  bootstrapCacheFile.c_str()) != 0) {
+                    Warning("Unable to write bootstrap cache \"%s\"",
+                            bootstrapCacheFile.c_str());
+                    remove(tempPath.c_str());
+                }
+            }
+        }
     }
     Distribution1D bootstrap(&bootstrapWeights[0], nBootstrapSamples);
     Float b = bootstrap.funcInt * (maxDepth + 1);
@@ -228,6 +279,10 @@ void MLTIntegrator::Render(const Scene &scene) {
             Spectrum LCurrent =
                 L(scene, arena, lightDistr, lightToIndex, sampler, depth, &pCurrent);
 
+            // Accumulate this chain's splats locally, flushing to the film
+            // in batches to avoid per-mutation atomic contention
+            SplatBuffer splatBuffer(&film);
+
             // Run the Markov chain for _nChainMutations_ steps
             for (int64_t j = 0; j < nChainMutations; ++j) {
                 sampler.StartIteration();
@@ -239,9 +294,10 @@ void MLTIntegrator::Render(const Scene &scene) {
 
                 // Splat both current and proposed samples to _film_
                 if (accept > 0)
-                    film.AddSplat(pProposed,
-                                  LProposed * accept / LProposed.y());
-                film.AddSplat(pCurrent, LCurrent * (1 - accept) / LCurrent.y());
+                    splatBuffer.AddSplat(pProposed,
+                                         LProposed * accept / LProposed.y());
+                splatBuffer.AddSplat(pCurrent,
+                                     LCurrent * (1 - accept) / LCurrent.y());
 
                 // Accept or reject the proposal
                 if (rng.UniformFloat() < accept) {
@@ -278,8 +334,11 @@ MLTIntegrator *CreateMLTIntegrator(const ParamSet &params,
         mutationsPerPixel = std::max(1, mutationsPerPixel / 16);
         nBootstrap = std::max(1, nBootstrap / 16);
     }
+    std::string bootstrapCacheFile =
+        params.FindOneString("bootstrapcachefile", "");
     return new MLTIntegrator(camera, maxDepth, nBootstrap, nChains,
-                             mutationsPerPixel, sigma, largeStepProbability);
+                             mutationsPerPixel, sigma, largeStepProbability,
+                             bootstrapCacheFile);
 }
 
 }  // namespace pbrt
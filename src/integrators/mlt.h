@@ -109,14 +109,16 @@ class MLTIntegrator : public Integrator {
     // MLTIntegrator Public Methods
     MLTIntegrator(std::shared_ptr<const Camera> camera, int maxDepth,
                   int nBootstrap, int nChains, int mutationsPerPixel,
-                  Float sigma, Float largeStepProbability)
+                  Float sigma, Float largeStepProbability,
+                  const std::string &bootstrapCacheFile = "")
         : camera(camera),
           maxDepth(maxDepth),
           nBootstrap(nBootstrap),
           nChains(nChains),
           mutationsPerPixel(mutationsPerPixel),
           sigma(sigma),
-          largeStepProbability(largeStepProbability) {}
+          largeStepProbability(largeStepProbability),
+          bootstrapCacheFile(bootstrapCacheFile) {}
     void Render(const Scene &scene);
     Spectrum L(const Scene &scene, MemoryArena &arena,
                const std::unique_ptr<Distribution1D> &lightDistr,
@@ -131,6 +133,9 @@ class MLTIntegrator : public Integrator {
     const int nChains;
     const int mutationsPerPixel;
     const Float sigma, largeStepProbability;
+    // Reuse the bootstrap luminance table across runs of the same scene
+    // ("bootstrapcachefile"); user-managed, see Render()
+    const std::string bootstrapCacheFile;
 };
 
 MLTIntegrator *CreateMLTIntegrator(const ParamSet &params,
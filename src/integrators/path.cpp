@@ -36,39 +36,185 @@
 #include "camera.h"
 #include "film.h"
 #include "interaction.h"
+#include "parallel.h"
 #include "paramset.h"
+#include "progressreporter.h"
+#include "reflection.h"
+#include "sampler.h"
+#include "samplers/halton.h"
+#include "samplers/sobol.h"
+#include "samplers/zerotwosequence.h"
+#include "sampling.h"
 #include "scene.h"
 #include "stats.h"
+#include <algorithm>
 
 namespace pbrt {
 
 STAT_PERCENT("Integrator/Zero-radiance paths", zeroRadiancePaths, totalPaths);
 STAT_INT_DISTRIBUTION("Integrator/Path length", pathLength);
+STAT_PERCENT("Integrator/Guided bounce samples", nGuidedSamples,
+             nGuidingCandidates);
+
+// Incrementally trained spatial-directional radiance cache. Space is a
+// uniform grid over the scene bounds; each cell keeps a luminance histogram
+// over equal-solid-angle directional bins. Paths deposit estimates of the
+// radiance that arrived along their sampled bounce directions, and once a
+// cell has seen enough samples its distribution is mixed fifty-fifty into
+// BSDF sampling for subsequent bounces; throughput always divides by the
+// mixture pdf, so the estimator stays unbiased throughout training.
+class GuidedRadianceCache {
+  public:
+    // GuidedRadianceCache Public Methods
+    GuidedRadianceCache(const Bounds3f &worldBound)
+        : bounds(worldBound), cells(new Cell[gridRes * gridRes * gridRes]) {}
+    int CellIndex(const Point3f &p) const {
+        Vector3f o = bounds.Offset(p);
+        int x = Clamp(int(o.x * gridRes), 0, gridRes - 1);
+        int y = Clamp(int(o.y * gridRes), 0, gridRes - 1);
+        int z = Clamp(int(o.z * gridRes), 0, gridRes - 1);
+        return x + gridRes * (y + gridRes * z);
+    }
+    bool Trained(int cell) const {
+        return cells[cell].nSamples.load(std::memory_order_relaxed) >=
+               minSamplesForGuiding;
+    }
+    Vector3f SampleDirection(int cell, const Point2f &u, Float *pdf) const {
+        const Cell &c = cells[cell];
+        Float binWeights[nBins], total = 0;
+        for (int i = 0; i < nBins; ++i) {
+            binWeights[i] = c.bins[i];
+            total += binWeights[i];
+        }
+        if (total == 0) {
+            *pdf = Inv4Pi;
+            return UniformSampleSphere(u);
+        }
+        // Select a bin proportional to its weight, remapping _u[0]_
+        Float target = u[0] * total, cumulative = 0;
+        int bin = 0;
+        for (; bin < nBins - 1; ++bin) {
+            if (cumulative + binWeights[bin] >= target) break;
+            cumulative += binWeights[bin];
+        }
+        Float uRemapped = std::min((target - cumulative) /
+                                   std::max(binWeights[bin], (Float)1e-20),
+                                   (Float)OneMinusEpsilon);
+        *pdf = binWeights[bin] / total * nBins * Inv4Pi;
+        // Sample a direction uniformly within the bin's solid angle
+        int ti = bin / nPhi, pi = bin % nPhi;
+        Float cosTheta = -1 + 2 * (ti + uRemapped) / nTheta;
+        Float phi = 2 * Pi * (pi + u[1]) / nPhi;
+        Float sinTheta = std::sqrt(std::max((Float)0, 1 - cosTheta * cosTheta));
+        return Vector3f(sinTheta * std::cos(phi), sinTheta * std::sin(phi),
+                        cosTheta);
+    }
+    Float Pdf(int cell, const Vector3f &w) const {
+        const Cell &c = cells[cell];
+        Float total = 0;
+        for (int i = 0; i < nBins; ++i) total += c.bins[i];
+        if (total == 0) return Inv4Pi;
+        return c.bins[DirectionIndex(w)] / total * nBins * Inv4Pi;
+    }
+    void Deposit(int cell, const Vector3f &w, Float L) {
+        Cell &c = cells[cell];
+        c.bins[DirectionIndex(w)].Add(L);
+        c.nSamples.fetch_add(1, std::memory_order_relaxed);
+    }
+
+  private:
+    // GuidedRadianceCache Private Data
+    static PBRT_CONSTEXPR int gridRes = 32;
+    static PBRT_CONSTEXPR int nTheta = 8, nPhi = 8;
+    static PBRT_CONSTEXPR int nBins = nTheta * nPhi;
+    static PBRT_CONSTEXPR int minSamplesForGuiding = 128;
+    struct Cell {
+        AtomicFloat bins[nBins];
+        std::atomic<int> nSamples{0};
+    };
+    static int DirectionIndex(const Vector3f &w) {
+        int ti = Clamp(int((w.z + 1) * .5f * nTheta), 0, nTheta - 1);
+        Float phi = std::atan2(w.y, w.x);
+        if (phi < 0) phi += 2 * Pi;
+        int pi = Clamp(int(phi * Inv2Pi * nPhi), 0, nPhi - 1);
+        return ti * nPhi + pi;
+    }
+    Bounds3f bounds;
+    std::unique_ptr<Cell[]> cells;
+};
 
 // PathIntegrator Method Definitions
 PathIntegrator::PathIntegrator(int maxDepth,
                                std::shared_ptr<const Camera> camera,
                                std::shared_ptr<Sampler> sampler,
                                const Bounds2i &pixelBounds, Float rrThreshold,
-                               const std::string &lightSampleStrategy)
+                               const std::string &lightSampleStrategy,
+                               bool wavefront, bool guiding, bool adaptiveRR,
+                               int lodMinDepth)
     : SamplerIntegrator(camera, sampler, pixelBounds),
       maxDepth(maxDepth),
       rrThreshold(rrThreshold),
-      lightSampleStrategy(lightSampleStrategy) {}
+      lightSampleStrategy(lightSampleStrategy),
+      wavefront(wavefront),
+      guiding(guiding),
+      adaptiveRR(adaptiveRR) {
+    // Material LOD is a process-wide switch consumed inside the materials;
+    // see core/material.h
+    materialLODMinDepth = lodMinDepth;
+}
+
+PathIntegrator::~PathIntegrator() {}
+
+void PathIntegrator::Render(const Scene &scene) {
+    if (wavefront)
+        RenderWavefront(scene);
+    else
+        SamplerIntegrator::Render(scene);
+}
 
 void PathIntegrator::Preprocess(const Scene &scene, Sampler &sampler) {
     lightDistribution =
         CreateLightSampleDistribution(lightSampleStrategy, scene);
+    if (guiding && !guidingCache)
+        guidingCache.reset(new GuidedRadianceCache(scene.WorldBound()));
 }
 
 Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene,
                             Sampler &sampler, MemoryArena &arena,
                             int depth) const {
+    // Dispatch once on the sampler's concrete (final) type so that the
+    // bounce loop's sample requests compile to direct, inlinable calls;
+    // unknown sampler types fall back to virtual dispatch
+    if (auto *s = dynamic_cast<ZeroTwoSequenceSampler *>(&sampler))
+        return LiImpl(r, scene, *s, arena, depth);
+    if (auto *s = dynamic_cast<HaltonSampler *>(&sampler))
+        return LiImpl(r, scene, *s, arena, depth);
+    if (auto *s = dynamic_cast<SobolSampler *>(&sampler))
+        return LiImpl(r, scene, *s, arena, depth);
+    return LiImpl(r, scene, sampler, arena, depth);
+}
+
+template <typename SamplerT>
+Spectrum PathIntegrator::LiImpl(const RayDifferential &r, const Scene &scene,
+                                SamplerT &sampler, MemoryArena &arena,
+                                int depth) const {
     ProfilePhase p(Prof::SamplerIntegratorLi);
     Spectrum L(0.f), beta(1.f);
     RayDifferential ray(r);
     bool specularBounce = false;
     int bounces;
+    // Per-bounce records for training the guiding cache: the radiance that
+    // eventually arrived along a sampled direction is recovered after the
+    // path terminates as (final L - L at the bounce) / beta at the bounce.
+    struct GuideRecord {
+        int cell;
+        Vector3f wi;
+        Spectrum LBefore;
+        Float betaY;
+    };
+    PBRT_CONSTEXPR int maxGuideRecords = 64;
+    GuideRecord guideRecords[maxGuideRecords];
+    int nGuideRecords = 0;
     // Added after book publication: etaScale tracks the accumulated effect
     // of radiance scaling due to rays passing through refractive
     // boundaries (see the derivation on p. 527 of the third edition). We
@@ -104,6 +250,7 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene,
         if (!foundIntersection || bounces >= maxDepth) break;
 
         // Compute scattering functions and skip over medium boundaries
+        materialLODDepth = bounces;
         isect.ComputeScatteringFunctions(ray, arena, true);
         if (!isect.bsdf) {
             VLOG(2) << "Skipping intersection due to null bsdf";
@@ -112,6 +259,17 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene,
             continue;
         }
 
+        // Record first-hit denoising features for the AOV buffers
+        if (denoisingAOVsEnabled && bounces == 0 && !denoisingFeatures.valid) {
+            Point2f u(.5f, .5f);
+            Spectrum albedo = isect.bsdf->rho(-ray.d, 1, &u);
+            albedo.ToRGB(denoisingFeatures.albedo);
+            denoisingFeatures.normal[0] = isect.shading.n.x;
+            denoisingFeatures.normal[1] = isect.shading.n.y;
+            denoisingFeatures.normal[2] = isect.shading.n.z;
+            denoisingFeatures.valid = true;
+        }
+
         const Distribution1D *distrib = lightDistribution->Lookup(isect.p);
 
         // Sample illumination from lights to find path contribution.
@@ -131,8 +289,35 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene,
         Vector3f wo = -ray.d, wi;
         Float pdf;
         BxDFType flags;
-        Spectrum f = isect.bsdf->Sample_f(wo, &wi, sampler.Get2D(), &pdf,
-                                          BSDF_ALL, &flags);
+        Spectrum f;
+        bool guided = false;
+        if (guidingCache &&
+            isect.bsdf->NumComponents(BxDFType(BSDF_SPECULAR)) == 0) {
+            // Mix the cell's learned directional distribution into bounce
+            // sampling once it has seen enough training samples
+            ++nGuidingCandidates;
+            int cell = guidingCache->CellIndex(isect.p);
+            if (guidingCache->Trained(cell)) {
+                ++nGuidedSamples;
+                guided = true;
+                Float guidePdf;
+                if (sampler.Get1D() < .5f) {
+                    wi = guidingCache->SampleDirection(cell, sampler.Get2D(),
+                                                       &guidePdf);
+                    f = isect.bsdf->f(wo, wi);
+                } else {
+                    f = isect.bsdf->Sample_f(wo, &wi, sampler.Get2D(), &pdf,
+                                             BSDF_ALL, &flags);
+                    guidePdf = guidingCache->Pdf(cell, wi);
+                }
+                // Divide by the mixture pdf of the two strategies
+                pdf = .5f * guidePdf + .5f * isect.bsdf->Pdf(wo, wi);
+                flags = BxDFType(BSDF_ALL & ~BSDF_SPECULAR);
+            }
+        }
+        if (!guided)
+            f = isect.bsdf->Sample_f(wo, &wi, sampler.Get2D(), &pdf, BSDF_ALL,
+                                     &flags);
         VLOG(2) << "Sampled BSDF, f = " << f << ", pdf = " << pdf;
         if (f.IsBlack() || pdf == 0.f) break;
         beta *= f * AbsDot(wi, isect.shading.n) / pdf;
@@ -149,6 +334,11 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene,
         }
         ray = isect.SpawnRay(wi);
 
+        // Record this bounce for guiding-cache training
+        if (guidingCache && nGuideRecords < maxGuideRecords)
+            guideRecords[nGuideRecords++] = {guidingCache->CellIndex(isect.p),
+                                             wi, L, beta.y()};
+
         // Account for subsurface scattering, if applicable
         if (isect.bssrdf && (flags & BSDF_TRANSMISSION)) {
             // Importance sample the BSSRDF
@@ -176,17 +366,366 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene,
         // Possibly terminate the path with Russian roulette.
         // Factor out radiance scaling due to refraction in rrBeta.
         Spectrum rrBeta = beta * etaScale;
-        if (rrBeta.MaxComponentValue() < rrThreshold && bounces > 3) {
-            Float q = std::max((Float).05, 1 - rrBeta.MaxComponentValue());
+        Float rrLimit = rrThreshold;
+        if (adaptiveRR) {
+            // Scale the termination threshold by the online mean path
+            // radiance so dark scenes keep their deep bounces and bright
+            // ones terminate sooner, and tighten it with depth to reflect
+            // each additional bounce's cost
+            int64_t n = nLuminanceSamples.load(std::memory_order_relaxed);
+            if (n >= 1024) {
+                Float meanLuminance = Float(luminanceSum) / n;
+                if (meanLuminance > 0)
+                    rrLimit = rrThreshold * meanLuminance *
+                              (1 + .5f * (bounces - 3));
+            }
+        }
+        if (rrBeta.MaxComponentValue() < rrLimit && bounces > 3) {
+            // With adaptive RR the survival probability is relative to the
+            // brightness-scaled limit rather than absolute throughput
+            Float q =
+                adaptiveRR
+                    ? std::max((Float).05,
+                               1 - rrBeta.MaxComponentValue() /
+                                       std::max(rrLimit, (Float)1e-6))
+                    : std::max((Float).05, 1 - rrBeta.MaxComponentValue());
             if (sampler.Get1D() < q) break;
             beta /= 1 - q;
             DCHECK(!std::isinf(beta.y()));
         }
     }
+    // Update the online mean path radiance for adaptive Russian roulette
+    if (adaptiveRR && !std::isinf(L.y()) && !L.HasNaNs()) {
+        luminanceSum.Add(L.y());
+        nLuminanceSamples.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Deposit the radiance observed along each recorded bounce direction
+    if (guidingCache)
+        for (int i = 0; i < nGuideRecords; ++i) {
+            const GuideRecord &rec = guideRecords[i];
+            if (rec.betaY <= 0) continue;
+            Float Lr = (L.y() - rec.LBefore.y()) / rec.betaY;
+            if (Lr > 0 && !std::isinf(Lr))
+                guidingCache->Deposit(rec.cell, rec.wi, Lr);
+        }
     ReportValue(pathLength, bounces);
     return L;
 }
 
+// Per-path state carried across the wavefront stages of one bounce
+struct PathState {
+    RayDifferential ray;
+    Spectrum L = Spectrum(0.f), beta = Spectrum(1.f);
+    Float etaScale = 1;
+    Point2f pFilm;
+    Float rayWeight = 0;
+    int pixelIndex = 0;
+    bool specularBounce = false;
+    bool active = true;
+    bool foundIntersection = false;
+    SurfaceInteraction isect;
+    // Flattened copy of isect.bsdf when all of its lobes have BxDFRecord
+    // representations; evaluating it avoids per-lobe virtual dispatch and
+    // doesn't touch the arena-allocated BSDF.
+    BSDFClosure closure;
+    bool hasClosure = false;
+};
+
+void PathIntegrator::RenderWavefront(const Scene &scene) {
+    Preprocess(scene, *sampler);
+    // Render image tiles in parallel, processing each tile's paths in
+    // stages: bulk intersection, material-sorted shading with deferred
+    // shadow rays, one batched occlusion pass, then BSDF sampling. Each
+    // stage runs a tight loop over all of the tile's live paths.
+    Bounds2i sampleBounds = camera->film->GetSampleBounds();
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    ProgressReporter reporter(nTiles.x * nTiles.y, "Rendering");
+    ParallelFor2D([&](Point2i tile) {
+        MemoryArena arena;
+        int seed = tile.y * nTiles.x + tile.x;
+
+        // Compute sample bounds for tile
+        int x0 = sampleBounds.pMin.x + tile.x * tileSize;
+        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        int y0 = sampleBounds.pMin.y + tile.y * tileSize;
+        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+        std::unique_ptr<FilmTile> filmTile =
+            camera->film->GetFilmTile(tileBounds);
+
+        // Clone one sampler per pixel so that paths consume their sample
+        // dimensions in the usual order regardless of stage interleaving.
+        // Each clone needs its own seed: samplers that derive jitter or
+        // scramble tables from it would otherwise repeat one sequence
+        // across every pixel of the tile, correlating the whole 16x16
+        // block.
+        std::vector<Point2i> pixels;
+        std::vector<std::unique_ptr<Sampler>> pixelSamplers;
+        for (Point2i pixel : tileBounds) {
+            int pixelSeed = seed * tileSize * tileSize + (int)pixels.size();
+            pixels.push_back(pixel);
+            pixelSamplers.push_back(sampler->Clone(pixelSeed));
+            pixelSamplers.back()->StartPixel(pixel);
+        }
+        if (pixels.empty()) {
+            camera->film->MergeFilmTile(std::move(filmTile));
+            reporter.Update();
+            return;
+        }
+
+        bool moreSamples = true;
+        while (moreSamples) {
+            // Generate camera rays for the current sample of every pixel,
+            // batching the whole tile into one camera call
+            std::vector<PathState> paths;
+            std::vector<CameraSample> cameraSamples;
+            paths.reserve(pixels.size());
+            cameraSamples.reserve(pixels.size());
+            for (size_t i = 0; i < pixels.size(); ++i) {
+                if (!InsideExclusive(pixels[i], pixelBounds)) continue;
+                Sampler &pixelSampler = *pixelSamplers[i];
+                CameraSample cameraSample =
+                    pixelSampler.GetCameraSample(pixels[i]);
+                cameraSample.pFilm = camera->film->RemapToFilterSample(
+                    pixels[i], cameraSample.pFilm);
+                PathState state;
+                state.pixelIndex = (int)i;
+                state.pFilm = cameraSample.pFilm;
+                paths.push_back(state);
+                cameraSamples.push_back(cameraSample);
+            }
+            std::vector<RayDifferential> rays(paths.size());
+            std::vector<Float> rayWeights(paths.size());
+            camera->GenerateRayDifferentialBatch(cameraSamples.data(),
+                                                 (int)paths.size(),
+                                                 rays.data(),
+                                                 rayWeights.data());
+            for (size_t i = 0; i < paths.size(); ++i) {
+                PathState &state = paths[i];
+                state.ray = rays[i];
+                state.rayWeight = rayWeights[i];
+                state.ray.ScaleDifferentials(
+                    1 / std::sqrt((Float)pixelSamplers[state.pixelIndex]
+                                      ->samplesPerPixel));
+                state.active = state.rayWeight > 0;
+            }
+
+            for (int bounces = 0;; ++bounces) {
+                // Intersect all live rays with the scene in bulk
+                bool anyActive = false;
+                for (PathState &ps : paths) {
+                    if (!ps.active) continue;
+                    ps.foundIntersection = scene.Intersect(ps.ray, &ps.isect);
+                    anyActive = true;
+                }
+                if (!anyActive) break;
+
+                // Account for emission and retire escaped or too-deep paths
+                for (PathState &ps : paths) {
+                    if (!ps.active) continue;
+                    if (bounces == 0 || ps.specularBounce) {
+                        if (ps.foundIntersection)
+                            ps.L += ps.beta * ps.isect.Le(-ps.ray.d);
+                        else
+                            for (const auto &light : scene.infiniteLights)
+                                ps.L += ps.beta * light->Le(ps.ray);
+                    }
+                    if (!ps.foundIntersection || bounces >= maxDepth)
+                        ps.active = false;
+                }
+
+                // Compute scattering functions with the live paths sorted
+                // by material so each material's code runs over a batch
+                std::vector<int> shadePaths;
+                for (size_t i = 0; i < paths.size(); ++i)
+                    if (paths[i].active) shadePaths.push_back(i);
+                std::sort(shadePaths.begin(), shadePaths.end(),
+                          [&](int a, int b) {
+                              return paths[a].isect.primitive->GetMaterial() <
+                                     paths[b].isect.primitive->GetMaterial();
+                          });
+                for (int idx : shadePaths) {
+                    PathState &ps = paths[idx];
+                    // Compute scattering functions and skip over medium
+                    // boundaries, re-intersecting along the unchanged ray
+                    while (true) {
+                        materialLODDepth = bounces;
+                        ps.isect.ComputeScatteringFunctions(ps.ray, arena,
+                                                            true);
+                        if (ps.isect.bsdf) {
+                            ps.hasClosure = ps.isect.bsdf->Flatten(&ps.closure);
+                            break;
+                        }
+                        ps.ray = ps.isect.SpawnRay(ps.ray.d);
+                        if (!scene.Intersect(ps.ray, &ps.isect)) {
+                            if (bounces == 0 || ps.specularBounce)
+                                for (const auto &light : scene.infiniteLights)
+                                    ps.L += ps.beta * light->Le(ps.ray);
+                            ps.active = false;
+                            break;
+                        }
+                        if (bounces == 0 || ps.specularBounce)
+                            ps.L += ps.beta * ps.isect.Le(-ps.ray.d);
+                    }
+                }
+
+                // Sample direct lighting, queueing shadow rays for one
+                // batched occlusion pass
+                RayStream shadowRays;
+                std::vector<Spectrum> shadowLd;
+                std::vector<int> shadowPath;
+                for (int idx : shadePaths) {
+                    PathState &ps = paths[idx];
+                    if (!ps.active) continue;
+                    int nNonSpecular =
+                        ps.hasClosure
+                            ? ps.closure.NumComponents(
+                                  BxDFType(BSDF_ALL & ~BSDF_SPECULAR))
+                            : ps.isect.bsdf->NumComponents(
+                                  BxDFType(BSDF_ALL & ~BSDF_SPECULAR));
+                    if (nNonSpecular == 0) continue;
+                    ++totalPaths;
+                    const Distribution1D *distrib =
+                        lightDistribution->Lookup(ps.isect.p);
+                    size_t streamStart = shadowLd.size();
+                    ps.L += ps.beta *
+                            UniformSampleOneLight(
+                                ps.isect, scene, arena,
+                                *pixelSamplers[ps.pixelIndex], false, distrib,
+                                &shadowRays, &shadowLd);
+                    // Deferred contributions still need this path's beta
+                    for (size_t k = streamStart; k < shadowLd.size(); ++k) {
+                        shadowLd[k] *= ps.beta;
+                        shadowPath.push_back(idx);
+                    }
+                }
+                if (shadowRays.Size() > 0) {
+                    scene.IntersectPStream(&shadowRays);
+                    for (size_t k = 0; k < shadowRays.Size(); ++k)
+                        if (!shadowRays.occluded[k])
+                            paths[shadowPath[k]].L += shadowLd[k];
+                }
+
+                // Sample BSDFs to extend the live paths
+                for (int idx : shadePaths) {
+                    PathState &ps = paths[idx];
+                    if (!ps.active) continue;
+                    Sampler &pixelSampler = *pixelSamplers[ps.pixelIndex];
+                    Vector3f wo = -ps.ray.d, wi;
+                    Float pdf;
+                    BxDFType flags;
+                    // Sample the flattened closure when one is available;
+                    // it matches BSDF::Sample_f() exactly but dispatches
+                    // through a switch rather than per-lobe vtables.
+                    Spectrum f =
+                        ps.hasClosure
+                            ? ps.closure.Sample_f(wo, &wi, pixelSampler.Get2D(),
+                                                  &pdf, BSDF_ALL, &flags)
+                            : ps.isect.bsdf->Sample_f(wo, &wi,
+                                                      pixelSampler.Get2D(),
+                                                      &pdf, BSDF_ALL, &flags);
+                    if (f.IsBlack() || pdf == 0.f) {
+                        ps.active = false;
+                        continue;
+                    }
+                    ps.beta *= f * AbsDot(wi, ps.isect.shading.n) / pdf;
+                    ps.specularBounce = (flags & BSDF_SPECULAR) != 0;
+                    if ((flags & BSDF_SPECULAR) &&
+                        (flags & BSDF_TRANSMISSION)) {
+                        Float eta = ps.isect.bsdf->eta;
+                        ps.etaScale *= (Dot(wo, ps.isect.n) > 0)
+                                           ? (eta * eta)
+                                           : 1 / (eta * eta);
+                    }
+                    ps.ray = ps.isect.SpawnRay(wi);
+
+                    // Account for subsurface scattering, if applicable
+                    if (ps.isect.bssrdf && (flags & BSDF_TRANSMISSION)) {
+                        SurfaceInteraction pi;
+                        Spectrum S = ps.isect.bssrdf->Sample_S(
+                            scene, pixelSampler.Get1D(), pixelSampler.Get2D(),
+                            arena, &pi, &pdf);
+                        if (S.IsBlack() || pdf == 0) {
+                            ps.active = false;
+                            continue;
+                        }
+                        ps.beta *= S / pdf;
+                        ps.L += ps.beta *
+                                UniformSampleOneLight(
+                                    pi, scene, arena, pixelSampler, false,
+                                    lightDistribution->Lookup(pi.p));
+                        Spectrum f = pi.bsdf->Sample_f(pi.wo, &wi,
+                                                       pixelSampler.Get2D(),
+                                                       &pdf, BSDF_ALL, &flags);
+                        if (f.IsBlack() || pdf == 0) {
+                            ps.active = false;
+                            continue;
+                        }
+                        ps.beta *= f * AbsDot(wi, pi.shading.n) / pdf;
+                        ps.specularBounce = (flags & BSDF_SPECULAR) != 0;
+                        ps.ray = pi.SpawnRay(wi);
+                    }
+
+                    // Possibly terminate the path with Russian roulette
+                    Spectrum rrBeta = ps.beta * ps.etaScale;
+                    if (rrBeta.MaxComponentValue() < rrThreshold &&
+                        bounces > 3) {
+                        Float q = std::max(
+                            (Float).05, 1 - rrBeta.MaxComponentValue());
+                        if (pixelSampler.Get1D() < q) {
+                            ps.active = false;
+                            continue;
+                        }
+                        ps.beta /= 1 - q;
+                    }
+                }
+                // The arena only holds this bounce's BSDFs
+                arena.Reset();
+            }
+
+            // Add the completed paths' radiance to the film tile
+            for (PathState &ps : paths) {
+                Spectrum L = ps.L;
+                if (L.HasNaNs()) {
+                    LOG(ERROR) << StringPrintf(
+                        "Not-a-number radiance value returned for pixel "
+                        "(%d, %d). Setting to black.",
+                        pixels[ps.pixelIndex].x, pixels[ps.pixelIndex].y);
+                    L = Spectrum(0.f);
+                } else if (L.y() < -1e-5) {
+                    LOG(ERROR) << StringPrintf(
+                        "Negative luminance value, %f, returned for pixel "
+                        "(%d, %d). Setting to black.",
+                        L.y(), pixels[ps.pixelIndex].x,
+                        pixels[ps.pixelIndex].y);
+                    L = Spectrum(0.f);
+                } else if (std::isinf(L.y())) {
+                    LOG(ERROR) << StringPrintf(
+                        "Infinite luminance value returned for pixel "
+                        "(%d, %d). Setting to black.",
+                        pixels[ps.pixelIndex].x, pixels[ps.pixelIndex].y);
+                    L = Spectrum(0.f);
+                }
+                filmTile->AddSample(ps.pFilm, L, ps.rayWeight);
+            }
+
+            // Advance every pixel's sampler to the next sample
+            moreSamples = false;
+            for (size_t i = 0; i < pixelSamplers.size(); ++i)
+                if (pixelSamplers[i]->StartNextSample()) moreSamples = true;
+        }
+        camera->film->MergeFilmTile(std::move(filmTile));
+        reporter.Update();
+    }, nTiles);
+    reporter.Done();
+    LOG(INFO) << "Rendering finished";
+    camera->film->WriteImage();
+}
+
 PathIntegrator *CreatePathIntegrator(const ParamSet &params,
                                      std::shared_ptr<Sampler> sampler,
                                      std::shared_ptr<const Camera> camera) {
@@ -208,8 +747,19 @@ PathIntegrator *CreatePathIntegrator(const ParamSet &params,
     Float rrThreshold = params.FindOneFloat("rrthreshold", 1.);
     std::string lightStrategy =
         params.FindOneString("lightsamplestrategy", "spatial");
-    return new PathIntegrator(maxDepth, camera, sampler, pixelBounds,
-                              rrThreshold, lightStrategy);
+    bool wavefront = params.FindOneBool("wavefront", false);
+    bool guiding = params.FindOneBool("guiding", false);
+    bool adaptiveRR = params.FindOneBool("adaptiverr", false);
+    int lodMinDepth = params.FindOneInt("lodmindepth", 0);
+    PathIntegrator *integrator =
+        new PathIntegrator(maxDepth, camera, sampler, pixelBounds,
+                           rrThreshold, lightStrategy, wavefront, guiding,
+                           adaptiveRR, lodMinDepth);
+    integrator->SetTileSize(params.FindOneInt("tilesize", 0));
+    std::string importanceMap =
+        params.FindOneFilename("importancemap", "");
+    if (!importanceMap.empty()) integrator->SetImportanceMap(importanceMap);
+    return integrator;
 }
 
 }  // namespace pbrt
@@ -42,9 +42,13 @@
 #include "pbrt.h"
 #include "integrator.h"
 #include "lightdistrib.h"
+#include "parallel.h"
+#include <atomic>
 
 namespace pbrt {
 
+class GuidedRadianceCache;
+
 // PathIntegrator Declarations
 class PathIntegrator : public SamplerIntegrator {
   public:
@@ -52,18 +56,38 @@ class PathIntegrator : public SamplerIntegrator {
     PathIntegrator(int maxDepth, std::shared_ptr<const Camera> camera,
                    std::shared_ptr<Sampler> sampler,
                    const Bounds2i &pixelBounds, Float rrThreshold = 1,
-                   const std::string &lightSampleStrategy = "spatial");
+                   const std::string &lightSampleStrategy = "spatial",
+                   bool wavefront = false, bool guiding = false,
+                   bool adaptiveRR = false, int lodMinDepth = 0);
+    ~PathIntegrator();
 
     void Preprocess(const Scene &scene, Sampler &sampler);
+    void Render(const Scene &scene);
     Spectrum Li(const RayDifferential &ray, const Scene &scene,
                 Sampler &sampler, MemoryArena &arena, int depth) const;
 
   private:
+    // PathIntegrator Private Methods
+    void RenderWavefront(const Scene &scene);
+    // Li()'s implementation, templated on the sampler's concrete type so
+    // its sample requests devirtualize and inline in the bounce loop
+    template <typename SamplerT>
+    Spectrum LiImpl(const RayDifferential &ray, const Scene &scene,
+                    SamplerT &sampler, MemoryArena &arena, int depth) const;
+
     // PathIntegrator Private Data
     const int maxDepth;
     const Float rrThreshold;
     const std::string lightSampleStrategy;
+    const bool wavefront;
+    const bool guiding;
+    const bool adaptiveRR;
     std::unique_ptr<LightDistribution> lightDistribution;
+    std::unique_ptr<GuidedRadianceCache> guidingCache;
+    // Online estimate of mean path radiance used to scale the Russian
+    // roulette threshold to the scene's overall brightness
+    mutable AtomicFloat luminanceSum;
+    mutable std::atomic<int64_t> nLuminanceSamples{0};
 };
 
 PathIntegrator *CreatePathIntegrator(const ParamSet &params,
@@ -42,6 +42,7 @@
 #include "progressreporter.h"
 #include "interaction.h"
 #include "sampling.h"
+#include <algorithm>
 #include "samplers/halton.h"
 #include "stats.h"
 
@@ -84,11 +85,56 @@ struct SPPMPixel {
     Spectrum tau;
 };
 
-struct SPPMPixelListNode {
-    SPPMPixel *pixel;
-    SPPMPixelListNode *next;
+// Visible-point BVH ("visiblepointbvh" parameter): a median-split tree
+// whose nodes bound the radius-expanded visible points. Photons descend
+// only into subtrees whose bounds contain the photon position, so the
+// photon-pass cost stays bounded regardless of how the radii are
+// distributed, unlike the uniform grid where one large-radius point can
+// occupy thousands of cells.
+static PBRT_CONSTEXPR int vpBVHLeafSize = 4;
+struct VisiblePointBVHNode {
+    Bounds3f bounds;
+    int children[2];
+    int first, count;  // leaf when count > 0
 };
 
+static int BuildVisiblePointBVH(std::vector<VisiblePointBVHNode> &nodes,
+                                std::vector<SPPMPixel *> &points, int start,
+                                int end) {
+    int nodeIndex = (int)nodes.size();
+    nodes.push_back(VisiblePointBVHNode());
+    Bounds3f bounds;
+    for (int i = start; i < end; ++i)
+        bounds = Union(bounds,
+                       Expand(Bounds3f(points[i]->vp.p), points[i]->radius));
+    nodes[nodeIndex].bounds = bounds;
+    if (end - start <= vpBVHLeafSize) {
+        nodes[nodeIndex].first = start;
+        nodes[nodeIndex].count = end - start;
+        nodes[nodeIndex].children[0] = nodes[nodeIndex].children[1] = -1;
+        return nodeIndex;
+    }
+    // Median split on the widest centroid axis keeps the tree balanced, so
+    // build recursion and traversal stack depths stay logarithmic.
+    Bounds3f centroidBounds;
+    for (int i = start; i < end; ++i)
+        centroidBounds = Union(centroidBounds, points[i]->vp.p);
+    int axis = centroidBounds.MaximumExtent();
+    int midIndex = (start + end) / 2;
+    std::nth_element(points.begin() + start, points.begin() + midIndex,
+                     points.begin() + end,
+                     [axis](const SPPMPixel *a, const SPPMPixel *b) {
+                         return a->vp.p[axis] < b->vp.p[axis];
+                     });
+    nodes[nodeIndex].first = 0;
+    nodes[nodeIndex].count = 0;
+    int c0 = BuildVisiblePointBVH(nodes, points, start, midIndex);
+    int c1 = BuildVisiblePointBVH(nodes, points, midIndex, end);
+    nodes[nodeIndex].children[0] = c0;
+    nodes[nodeIndex].children[1] = c1;
+    return nodeIndex;
+}
+
 static bool ToGrid(const Point3f &p, const Bounds3f &bounds,
                    const int gridRes[3], Point3i *pi) {
     bool inBounds = true;
@@ -131,6 +177,18 @@ void SPPMIntegrator::Render(const Scene &scene) {
                    (pixelExtent.y + tileSize - 1) / tileSize);
     ProgressReporter progress(2 * nIterations, "Rendering");
     std::vector<MemoryArena> perThreadArenas(MaxThreadIndex());
+    // Iteration-persistent photon-pass storage: the grid spans, the
+    // counting atomics, the visible-point BVH arrays, and the photon
+    // shooting arenas are allocated once here and reused, so a
+    // 512-iteration render re-zeroes a few integer arrays per pass instead
+    // of reallocating gigabytes of setup.
+    const int hashSize = nPixels;
+    std::vector<int> cellStart(hashSize + 1);
+    std::vector<SPPMPixel *> gridPixels;
+    std::vector<std::atomic<int>> cellCount(hashSize), cellOffset(hashSize);
+    std::vector<VisiblePointBVHNode> vpNodes;
+    std::vector<SPPMPixel *> vpPoints;
+    std::vector<MemoryArena> photonShootArenas(MaxThreadIndex());
     for (int iter = 0; iter < nIterations; ++iter) {
         // Generate SPPM visible points
         {
@@ -241,10 +299,24 @@ void SPPMIntegrator::Render(const Scene &scene) {
         // Create grid of all SPPM visible points
         int gridRes[3];
         Bounds3f gridBounds;
-        // Allocate grid for SPPM visible points
-        const int hashSize = nPixels;
-        std::vector<std::atomic<SPPMPixelListNode *>> grid(hashSize);
-        {
+        // Each cell is a span of _gridPixels_ delimited by _cellStart_,
+        // built with a counted prefix-sum pass rather than atomic
+        // linked-list pushes; or, with "visiblepointbvh", a BVH over the
+        // visible points replaces the grid entirely
+        std::fill(cellStart.begin(), cellStart.end(), 0);
+        vpNodes.clear();
+        vpPoints.clear();
+        if (visiblePointBVH) {
+            ProfilePhase _(Prof::SPPMGridConstruction);
+            vpPoints.reserve(nPixels);
+            for (int i = 0; i < nPixels; ++i)
+                if (!pixels[i].vp.beta.IsBlack()) vpPoints.push_back(&pixels[i]);
+            if (!vpPoints.empty()) {
+                vpNodes.reserve(2 * vpPoints.size() / vpBVHLeafSize + 2);
+                BuildVisiblePointBVH(vpNodes, vpPoints, 0,
+                                     (int)vpPoints.size());
+            }
+        } else {
             ProfilePhase _(Prof::SPPMGridConstruction);
 
             // Compute grid bounds for SPPM visible points
@@ -265,9 +337,41 @@ void SPPMIntegrator::Render(const Scene &scene) {
             for (int i = 0; i < 3; ++i)
                 gridRes[i] = std::max((int)(baseGridRes * diag[i] / maxDiag), 1);
 
-            // Add visible points to SPPM grid
+            // Count the visible points overlapping each grid cell
+            for (int i = 0; i < hashSize; ++i)
+                cellCount[i].store(0, std::memory_order_relaxed);
+            ParallelFor([&](int pixelIndex) {
+                SPPMPixel &pixel = pixels[pixelIndex];
+                if (!pixel.vp.beta.IsBlack()) {
+                    // Count pixel's visible point in applicable grid cells
+                    Float radius = pixel.radius;
+                    Point3i pMin, pMax;
+                    ToGrid(pixel.vp.p - Vector3f(radius, radius, radius),
+                           gridBounds, gridRes, &pMin);
+                    ToGrid(pixel.vp.p + Vector3f(radius, radius, radius),
+                           gridBounds, gridRes, &pMax);
+                    for (int z = pMin.z; z <= pMax.z; ++z)
+                        for (int y = pMin.y; y <= pMax.y; ++y)
+                            for (int x = pMin.x; x <= pMax.x; ++x)
+                                cellCount[hash(Point3i(x, y, z), hashSize)]
+                                    .fetch_add(1, std::memory_order_relaxed);
+                    ReportValue(gridCellsPerVisiblePoint,
+                                (1 + pMax.x - pMin.x) * (1 + pMax.y - pMin.y) *
+                                    (1 + pMax.z - pMin.z));
+                }
+            }, nPixels, 4096);
+
+            // Prefix-sum the counts into per-cell spans of _gridPixels_
+            for (int i = 0; i < hashSize; ++i)
+                cellStart[i + 1] =
+                    cellStart[i] +
+                    cellCount[i].load(std::memory_order_relaxed);
+            gridPixels.resize(cellStart[hashSize]);
+
+            // Fill each cell's span with its visible points
+            for (int i = 0; i < hashSize; ++i)
+                cellOffset[i].store(0, std::memory_order_relaxed);
             ParallelFor([&](int pixelIndex) {
-                MemoryArena &arena = perThreadArenas[ThreadIndex];
                 SPPMPixel &pixel = pixels[pixelIndex];
                 if (!pixel.vp.beta.IsBlack()) {
                     // Add pixel's visible point to applicable grid cells
@@ -280,30 +384,26 @@ void SPPMIntegrator::Render(const Scene &scene) {
                     for (int z = pMin.z; z <= pMax.z; ++z)
                         for (int y = pMin.y; y <= pMax.y; ++y)
                             for (int x = pMin.x; x <= pMax.x; ++x) {
-                                // Add visible point to grid cell $(x, y, z)$
                                 int h = hash(Point3i(x, y, z), hashSize);
-                                SPPMPixelListNode *node =
-                                    arena.Alloc<SPPMPixelListNode>();
-                                node->pixel = &pixel;
-
-                                // Atomically add _node_ to the start of
-                                // _grid[h]_'s linked list
-                                node->next = grid[h];
-                                while (grid[h].compare_exchange_weak(
-                                           node->next, node) == false)
-                                    ;
+                                int index =
+                                    cellStart[h] +
+                                    cellOffset[h].fetch_add(
+                                        1, std::memory_order_relaxed);
+                                gridPixels[index] = &pixel;
                             }
-                    ReportValue(gridCellsPerVisiblePoint,
-                                (1 + pMax.x - pMin.x) * (1 + pMax.y - pMin.y) *
-                                    (1 + pMax.z - pMin.z));
                 }
             }, nPixels, 4096);
         }
 
+        // Bounds of all visible points, used to aim guided photon emission
+        Bounds3f vpBounds = visiblePointBVH
+                                ? (vpNodes.empty() ? Bounds3f()
+                                                   : vpNodes[0].bounds)
+                                : gridBounds;
+
         // Trace photons and accumulate contributions
         {
             ProfilePhase _(Prof::SPPMPhotonPass);
-            std::vector<MemoryArena> photonShootArenas(MaxThreadIndex());
             ParallelFor([&](int photonIndex) {
                 MemoryArena &arena = photonShootArenas[ThreadIndex];
                 // Follow photon path for _photonIndex_
@@ -333,12 +433,79 @@ void SPPMIntegrator::Render(const Scene &scene) {
                 RayDifferential photonRay;
                 Normal3f nLight;
                 Float pdfPos, pdfDir;
-                Spectrum Le =
-                    light->Sample_Le(uLight0, uLight1, uLightTime, &photonRay,
-                                     &nLight, &pdfPos, &pdfDir);
-                if (pdfPos == 0 || pdfDir == 0 || Le.IsBlack()) return;
-                Spectrum beta = (AbsDot(nLight, photonRay.d) * Le) /
-                                (lightPdf * pdfPos * pdfDir);
+                Spectrum Le;
+                Spectrum beta;
+                if (emissionGuiding && vpBounds.pMax.x >= vpBounds.pMin.x) {
+                    // Resampled importance sampling of the emitted ray:
+                    // draw several candidates from Sample_Le(), weight each
+                    // by whether it heads into the visible-point bounds,
+                    // keep one with probability proportional to its weight,
+                    // and scale beta by (sum w) / (K * w_chosen). This is
+                    // unbiased for any positive weight function, so no
+                    // per-light pdf plumbing changes are needed - photons
+                    // simply stop being launched toward empty sky. The
+                    // first candidate reuses the Halton sample so the
+                    // low-discrepancy stratification isn't lost entirely.
+                    int K = photonCandidates;
+                    RNG rng((uint64_t)photonIndex +
+                            (uint64_t)iter * photonsPerIteration);
+                    struct EmissionCandidate {
+                        RayDifferential ray;
+                        Normal3f n;
+                        Float pdfPos, pdfDir, weight;
+                        Spectrum Le;
+                    };
+                    EmissionCandidate candidates[16];
+                    Float sumWeight = 0;
+                    for (int c = 0; c < K; ++c) {
+                        EmissionCandidate &cand = candidates[c];
+                        Point2f u0 = (c == 0) ? uLight0
+                                              : Point2f(rng.UniformFloat(),
+                                                        rng.UniformFloat());
+                        Point2f u1 = (c == 0) ? uLight1
+                                              : Point2f(rng.UniformFloat(),
+                                                        rng.UniformFloat());
+                        cand.Le = light->Sample_Le(u0, u1, uLightTime,
+                                                   &cand.ray, &cand.n,
+                                                   &cand.pdfPos,
+                                                   &cand.pdfDir);
+                        Float hit0, hit1;
+                        bool toward =
+                            cand.pdfPos > 0 && cand.pdfDir > 0 &&
+                            !cand.Le.IsBlack() &&
+                            vpBounds.IntersectP(cand.ray, &hit0, &hit1);
+                        cand.weight = toward ? 1 : (Float).05;
+                        if (cand.pdfPos == 0 || cand.pdfDir == 0 ||
+                            cand.Le.IsBlack())
+                            cand.weight = 0;
+                        sumWeight += cand.weight;
+                    }
+                    if (sumWeight == 0) return;
+                    Float pick = rng.UniformFloat() * sumWeight;
+                    int chosen = 0;
+                    for (; chosen < K - 1; ++chosen) {
+                        pick -= candidates[chosen].weight;
+                        if (pick <= 0) break;
+                    }
+                    while (candidates[chosen].weight == 0 && chosen > 0)
+                        --chosen;
+                    const EmissionCandidate &cand = candidates[chosen];
+                    photonRay = cand.ray;
+                    nLight = cand.n;
+                    pdfPos = cand.pdfPos;
+                    pdfDir = cand.pdfDir;
+                    Le = cand.Le;
+                    beta = (AbsDot(nLight, photonRay.d) * Le) /
+                           (lightPdf * pdfPos * pdfDir) *
+                           (sumWeight / (K * cand.weight));
+                } else {
+                    Le = light->Sample_Le(uLight0, uLight1, uLightTime,
+                                          &photonRay, &nLight, &pdfPos,
+                                          &pdfDir);
+                    if (pdfPos == 0 || pdfDir == 0 || Le.IsBlack()) return;
+                    beta = (AbsDot(nLight, photonRay.d) * Le) /
+                           (lightPdf * pdfPos * pdfDir);
+                }
                 if (beta.IsBlack()) return;
 
                 // Follow photon path through scene and record intersections
@@ -346,19 +513,55 @@ void SPPMIntegrator::Render(const Scene &scene) {
                 for (int depth = 0; depth < maxDepth; ++depth) {
                     if (!scene.Intersect(photonRay, &isect)) break;
                     ++totalPhotonSurfaceInteractions;
-                    if (depth > 0) {
+                    if (depth > 0 && visiblePointBVH) {
+                        // Walk the visible-point BVH top-down, descending
+                        // only into subtrees whose (radius-expanded)
+                        // bounds contain the photon
+                        if (!vpNodes.empty()) {
+                            int nodeStack[64];
+                            int stackPos = 0;
+                            nodeStack[stackPos++] = 0;
+                            while (stackPos > 0) {
+                                const VisiblePointBVHNode &node =
+                                    vpNodes[nodeStack[--stackPos]];
+                                if (!Inside(isect.p, node.bounds)) continue;
+                                if (node.count > 0) {
+                                    for (int i = node.first;
+                                         i < node.first + node.count; ++i) {
+                                        ++visiblePointsChecked;
+                                        SPPMPixel &pixel = *vpPoints[i];
+                                        Float radius = pixel.radius;
+                                        if (DistanceSquared(pixel.vp.p,
+                                                            isect.p) >
+                                            radius * radius)
+                                            continue;
+                                        Vector3f wi = -photonRay.d;
+                                        Spectrum Phi =
+                                            beta *
+                                            pixel.vp.bsdf->f(pixel.vp.wo, wi);
+                                        for (int j = 0;
+                                             j < Spectrum::nSamples; ++j)
+                                            pixel.Phi[j].Add(Phi[j]);
+                                        ++pixel.M;
+                                    }
+                                } else {
+                                    nodeStack[stackPos++] = node.children[0];
+                                    nodeStack[stackPos++] = node.children[1];
+                                }
+                            }
+                        }
+                    } else if (depth > 0) {
                         // Add photon contribution to nearby visible points
                         Point3i photonGridIndex;
                         if (ToGrid(isect.p, gridBounds, gridRes,
                                    &photonGridIndex)) {
                             int h = hash(photonGridIndex, hashSize);
                             // Add photon contribution to visible points in
-                            // _grid[h]_
-                            for (SPPMPixelListNode *node =
-                                     grid[h].load(std::memory_order_relaxed);
-                                 node != nullptr; node = node->next) {
+                            // the cell's span of _gridPixels_
+                            for (int i = cellStart[h]; i < cellStart[h + 1];
+                                 ++i) {
                                 ++visiblePointsChecked;
-                                SPPMPixel &pixel = *node->pixel;
+                                SPPMPixel &pixel = *gridPixels[i];
                                 Float radius = pixel.radius;
                                 if (DistanceSquared(pixel.vp.p, isect.p) >
                                     radius * radius)
@@ -512,9 +715,13 @@ Integrator *CreateSPPMIntegrator(const ParamSet &params,
     int photonsPerIter = params.FindOneInt("photonsperiteration", -1);
     int writeFreq = params.FindOneInt("imagewritefrequency", 1 << 31);
     Float radius = params.FindOneFloat("radius", 1.f);
+    bool visiblePointBVH = params.FindOneBool("visiblepointbvh", false);
+    bool emissionGuiding = params.FindOneBool("emissionguiding", false);
+    int photonCandidates = params.FindOneInt("photoncandidates", 8);
     if (PbrtOptions.quickRender) nIterations = std::max(1, nIterations / 16);
     return new SPPMIntegrator(camera, nIterations, photonsPerIter, maxDepth,
-                              radius, writeFreq);
+                              radius, writeFreq, visiblePointBVH,
+                              emissionGuiding, photonCandidates);
 }
 
 }  // namespace pbrt
@@ -52,7 +52,9 @@ class SPPMIntegrator : public Integrator {
     // SPPMIntegrator Public Methods
     SPPMIntegrator(std::shared_ptr<const Camera> &camera, int nIterations,
                    int photonsPerIteration, int maxDepth,
-                   Float initialSearchRadius, int writeFrequency)
+                   Float initialSearchRadius, int writeFrequency,
+                   bool visiblePointBVH = false, bool emissionGuiding = false,
+                   int photonCandidates = 8)
         : camera(camera),
           initialSearchRadius(initialSearchRadius),
           nIterations(nIterations),
@@ -60,7 +62,10 @@ class SPPMIntegrator : public Integrator {
           photonsPerIteration(photonsPerIteration > 0
                                   ? photonsPerIteration
                                   : camera->film->croppedPixelBounds.Area()),
-          writeFrequency(writeFrequency) {}
+          writeFrequency(writeFrequency),
+          visiblePointBVH(visiblePointBVH),
+          emissionGuiding(emissionGuiding),
+          photonCandidates(Clamp(photonCandidates, 2, 16)) {}
     void Render(const Scene &scene);
 
   private:
@@ -71,6 +76,13 @@ class SPPMIntegrator : public Integrator {
     const int maxDepth;
     const int photonsPerIteration;
     const int writeFrequency;
+    // Use a BVH over visible points instead of the uniform grid; see the
+    // photon pass in sppm.cpp
+    const bool visiblePointBVH;
+    // Resample photon emission toward the visible points ("emissionguiding"
+    // and "photoncandidates"); see the photon pass in sppm.cpp
+    const bool emissionGuiding;
+    const int photonCandidates;
 };
 
 Integrator *CreateSPPMIntegrator(const ParamSet &params,
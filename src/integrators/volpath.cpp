@@ -36,6 +36,7 @@
 #include "camera.h"
 #include "film.h"
 #include "interaction.h"
+#include "medium.h"
 #include "paramset.h"
 #include "scene.h"
 #include "stats.h"
@@ -52,6 +53,87 @@ void VolPathIntegrator::Preprocess(const Scene &scene, Sampler &sampler) {
         CreateLightSampleDistribution(lightSampleStrategy, scene);
 }
 
+// Estimate direct lighting for the current medium segment by combining the
+// transmittance-sampled scattering point with an equiangular sample toward
+// a point-like light, weighting each by one-sample MIS over the distance
+// dimension. Both closed-form pdfs require a homogeneous medium; returns
+// false (leaving _L_ untouched) when the preconditions don't hold so the
+// caller can fall back to standard light sampling.
+bool VolPathIntegrator::SampleDirectEquiangular(
+    const Scene &scene, const RayDifferential &ray, const MediumInteraction &mi,
+    const Spectrum &betaBeforeMedium, const Spectrum &beta,
+    bool foundIntersection, const SurfaceInteraction &isect,
+    const Distribution1D *lightDistrib, Sampler &sampler, MemoryArena &arena,
+    Spectrum *L) const {
+    Spectrum sigma_a, sigma_s;
+    Float g;
+    if (!ray.medium->GetHomogeneousCoefficients(&sigma_a, &sigma_s, &g))
+        return false;
+    int nLights = int(scene.lights.size());
+    if (nLights == 0) return true;
+
+    // Choose a light to be shared by both sampling strategies
+    int lightNum;
+    Float lightPdf;
+    if (lightDistrib) {
+        lightNum = lightDistrib->SampleDiscrete(sampler.Get1D(), &lightPdf);
+        if (lightPdf == 0) return true;
+    } else {
+        lightNum = std::min((int)(sampler.Get1D() * nLights), nLights - 1);
+        lightPdf = Float(1) / nLights;
+    }
+    const std::shared_ptr<Light> &light = scene.lights[lightNum];
+    Bounds3f lightBound = light->WorldBound();
+    if (!(lightBound.pMin == lightBound.pMax)) return false;
+    Point3f lightPos = lightBound.pMin;
+
+    // Set up the two distance pdfs along the normalized ray
+    Spectrum sigma_t = sigma_a + sigma_s;
+    Vector3f d = Normalize(ray.d);
+    Float tSeg = foundIntersection ? Distance(ray.o, isect.p) : Infinity;
+    auto pdfDistance = [&](Float t) {
+        Float pdf = 0;
+        for (int i = 0; i < Spectrum::nSamples; ++i)
+            pdf += sigma_t[i] * std::exp(-sigma_t[i] * t);
+        return pdf / Spectrum::nSamples;
+    };
+    Float delta = Dot(lightPos - ray.o, d);
+    Float D = std::sqrt(std::max(
+        (Float)0, DistanceSquared(ray.o, lightPos) - delta * delta));
+    if (D < 1e-5f) return false;
+    Float thetaA = std::atan2(-delta, D);
+    Float thetaB =
+        std::isinf(tSeg) ? (Float)(Pi / 2) : std::atan2(tSeg - delta, D);
+    auto pdfEquiangular = [&](Float t) {
+        return D / std::max((Float)1e-10,
+                            (thetaB - thetaA) *
+                                (D * D + (t - delta) * (t - delta)));
+    };
+
+    // Direct lighting at the transmittance-sampled scattering point
+    Float tMi = Distance(ray.o, mi.p);
+    Float pdfDistMi = pdfDistance(tMi);
+    Float wDist = pdfDistMi / (pdfDistMi + pdfEquiangular(tMi));
+    *L += beta * wDist *
+          EstimateDirect(mi, sampler.Get2D(), *light, sampler.Get2D(), scene,
+                         sampler, arena, true) /
+          lightPdf;
+
+    // Direct lighting at an equiangular-sampled point toward the light
+    Float theta = Lerp(sampler.Get1D(), thetaA, thetaB);
+    Float te = Clamp(delta + D * std::tan(theta), (Float)0, tSeg);
+    Float pdfEq = pdfEquiangular(te);
+    if (pdfEq <= 0) return true;
+    Float wEq = pdfEq / (pdfEq + pdfDistance(te));
+    PhaseFunction *phase = ARENA_ALLOC(arena, HenyeyGreenstein)(g);
+    MediumInteraction pe(ray.o + te * d, -d, ray.time, ray.medium, phase);
+    *L += betaBeforeMedium * Exp(-sigma_t * te) * sigma_s * wEq *
+          EstimateDirect(pe, sampler.Get2D(), *light, sampler.Get2D(), scene,
+                         sampler, arena, true) /
+          (lightPdf * pdfEq);
+    return true;
+}
+
 Spectrum VolPathIntegrator::Li(const RayDifferential &r, const Scene &scene,
                                Sampler &sampler, MemoryArena &arena,
                                int depth) const {
@@ -76,7 +158,9 @@ Spectrum VolPathIntegrator::Li(const RayDifferential &r, const Scene &scene,
 
         // Sample the participating medium, if present
         MediumInteraction mi;
-        if (ray.medium) beta *= ray.medium->Sample(ray, sampler, arena, &mi);
+        Spectrum betaBeforeMedium = beta;
+        if (ray.medium)
+            beta *= ray.medium->Sample(ray, sampler, arena, &mi, &beta);
         if (beta.IsBlack()) break;
 
         // Handle an interaction with a medium or a surface
@@ -85,11 +169,18 @@ Spectrum VolPathIntegrator::Li(const RayDifferential &r, const Scene &scene,
             if (bounces >= maxDepth) break;
 
             ++volumeInteractions;
+            // Add emission at the sampled medium scattering event
+            L += beta * mi.GetMedium()->SampledLe(mi);
+
             // Handle scattering at point in medium for volumetric path tracer
             const Distribution1D *lightDistrib =
                 lightDistribution->Lookup(mi.p);
-            L += beta * UniformSampleOneLight(mi, scene, arena, sampler, true,
-                                              lightDistrib);
+            if (!equiangular ||
+                !SampleDirectEquiangular(scene, ray, mi, betaBeforeMedium,
+                                         beta, foundIntersection, isect,
+                                         lightDistrib, sampler, arena, &L))
+                L += beta * UniformSampleOneLight(mi, scene, arena, sampler,
+                                                  true, lightDistrib);
 
             Vector3f wo = -ray.d, wi;
             mi.phase->Sample_p(wo, &wi, sampler.Get2D());
@@ -209,8 +300,9 @@ VolPathIntegrator *CreateVolPathIntegrator(
     Float rrThreshold = params.FindOneFloat("rrthreshold", 1.);
     std::string lightStrategy =
         params.FindOneString("lightsamplestrategy", "spatial");
+    bool equiangular = params.FindOneBool("equiangular", false);
     return new VolPathIntegrator(maxDepth, camera, sampler, pixelBounds,
-                                 rrThreshold, lightStrategy);
+                                 rrThreshold, lightStrategy, equiangular);
 }
 
 }  // namespace pbrt
@@ -52,20 +52,33 @@ class VolPathIntegrator : public SamplerIntegrator {
     VolPathIntegrator(int maxDepth, std::shared_ptr<const Camera> camera,
                       std::shared_ptr<Sampler> sampler,
                       const Bounds2i &pixelBounds, Float rrThreshold = 1,
-                      const std::string &lightSampleStrategy = "spatial")
+                      const std::string &lightSampleStrategy = "spatial",
+                      bool equiangular = false)
         : SamplerIntegrator(camera, sampler, pixelBounds),
           maxDepth(maxDepth),
           rrThreshold(rrThreshold),
-          lightSampleStrategy(lightSampleStrategy) { }
+          lightSampleStrategy(lightSampleStrategy),
+          equiangular(equiangular) { }
     void Preprocess(const Scene &scene, Sampler &sampler);
     Spectrum Li(const RayDifferential &ray, const Scene &scene,
                 Sampler &sampler, MemoryArena &arena, int depth) const;
 
   private:
+    // VolPathIntegrator Private Methods
+    bool SampleDirectEquiangular(const Scene &scene,
+                                 const RayDifferential &ray,
+                                 const MediumInteraction &mi,
+                                 const Spectrum &betaBeforeMedium,
+                                 const Spectrum &beta, bool foundIntersection,
+                                 const SurfaceInteraction &isect,
+                                 const Distribution1D *lightDistrib,
+                                 Sampler &sampler, MemoryArena &arena,
+                                 Spectrum *L) const;
     // VolPathIntegrator Private Data
     const int maxDepth;
     const Float rrThreshold;
     const std::string lightSampleStrategy;
+    const bool equiangular;
     std::unique_ptr<LightDistribution> lightDistribution;
 };
 
@@ -61,6 +61,8 @@ DiffuseAreaLight::DiffuseAreaLight(const Transform &LightToWorld,
             "Proceed at your own risk; your image may have errors.");
 }
 
+Bounds3f DiffuseAreaLight::WorldBound() const { return shape->WorldBound(); }
+
 Spectrum DiffuseAreaLight::Power() const {
     return (twoSided ? 2 : 1) * Lemit * area * Pi;
 }
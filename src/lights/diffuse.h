@@ -46,7 +46,7 @@
 namespace pbrt {
 
 // DiffuseAreaLight Declarations
-class DiffuseAreaLight : public AreaLight {
+class DiffuseAreaLight final : public AreaLight {
   public:
     // DiffuseAreaLight Public Methods
     DiffuseAreaLight(const Transform &LightToWorld,
@@ -57,6 +57,7 @@ class DiffuseAreaLight : public AreaLight {
         return (twoSided || Dot(intr.n, w) > 0) ? Lemit : Spectrum(0.f);
     }
     Spectrum Power() const;
+    Bounds3f WorldBound() const;
     Spectrum Sample_Li(const Interaction &ref, const Point2f &u, Vector3f *wo,
                        Float *pdf, VisibilityTester *vis) const;
     Float Pdf_Li(const Interaction &, const Vector3f &) const;
@@ -47,7 +47,7 @@
 namespace pbrt {
 
 // DistantLight Declarations
-class DistantLight : public Light {
+class DistantLight final : public Light {
   public:
     // DistantLight Public Methods
     DistantLight(const Transform &LightToWorld, const Spectrum &L,
@@ -68,19 +68,49 @@ Spectrum GonioPhotometricLight::Sample_Le(const Point2f &u1, const Point2f &u2,
                                           Normal3f *nLight, Float *pdfPos,
                                           Float *pdfDir) const {
     ProfilePhase _(Prof::LightSample);
-    *ray = Ray(pLight, UniformSampleSphere(u1), Infinity, time,
-               mediumInterface.inside);
+    Vector3f w;
+    if (distrib) {
+        // Importance sample the photometric web: for narrow-beam IES
+        // profiles nearly all of the emitted power is concentrated in a
+        // small solid angle that uniform sphere sampling almost never hits.
+        Float mapPdf;
+        Point2f uv = distrib->SampleContinuous(u1, &mapPdf);
+        if (mapPdf == 0) {
+            *pdfPos = *pdfDir = 0;
+            return Spectrum(0.f);
+        }
+        Float theta = uv[1] * Pi, phi = uv[0] * 2 * Pi;
+        Float cosTheta = std::cos(theta), sinTheta = std::sin(theta);
+        // Undo the y/z swap that Scale() applies when mapping light-space
+        // directions to the goniometric map's parameterization.
+        Vector3f wMap = SphericalDirection(sinTheta, cosTheta, phi);
+        w = LightToWorld(Vector3f(wMap.x, wMap.z, wMap.y));
+        *pdfDir = sinTheta == 0 ? 0 : mapPdf / (2 * Pi * Pi * sinTheta);
+    } else {
+        w = UniformSampleSphere(u1);
+        *pdfDir = UniformSpherePdf();
+    }
+    *ray = Ray(pLight, w, Infinity, time, mediumInterface.inside);
     *nLight = (Normal3f)ray->d;
     *pdfPos = 1.f;
-    *pdfDir = UniformSpherePdf();
     return I * Scale(ray->d);
 }
 
-void GonioPhotometricLight::Pdf_Le(const Ray &, const Normal3f &, Float *pdfPos,
-                                   Float *pdfDir) const {
+void GonioPhotometricLight::Pdf_Le(const Ray &ray, const Normal3f &,
+                                   Float *pdfPos, Float *pdfDir) const {
     ProfilePhase _(Prof::LightPdf);
     *pdfPos = 0.f;
-    *pdfDir = UniformSpherePdf();
+    if (distrib) {
+        Vector3f wp = Normalize(WorldToLight(ray.d));
+        std::swap(wp.y, wp.z);
+        Float theta = SphericalTheta(wp), phi = SphericalPhi(wp);
+        Float sinTheta = std::sin(theta);
+        *pdfDir = sinTheta == 0
+                      ? 0
+                      : distrib->Pdf(Point2f(phi * Inv2Pi, theta * InvPi)) /
+                            (2 * Pi * Pi * sinTheta);
+    } else
+        *pdfDir = UniformSpherePdf();
 }
 
 std::shared_ptr<GonioPhotometricLight> CreateGoniometricLight(
@@ -45,6 +45,8 @@
 #include "scene.h"
 #include "mipmap.h"
 #include "imageio.h"
+#include "sampling.h"
+#include "parallel.h"
 
 namespace pbrt {
 
@@ -63,8 +65,26 @@ class GonioPhotometricLight : public Light {
         // Create _mipmap_ for _GonioPhotometricLight_
         Point2i resolution;
         std::unique_ptr<RGBSpectrum[]> texels = ReadImage(texname, &resolution);
-        if (texels)
+        if (texels) {
             mipmap.reset(new MIPMap<RGBSpectrum>(resolution, texels.get()));
+
+            // Build a sampling distribution over the photometric web so that
+            // Sample_Le() can emit along the profile's actual beam rather
+            // than uniformly over the sphere. The sin(theta) factor accounts
+            // for the (phi, theta) parameterization's mapping to the sphere.
+            int width = resolution.x, height = resolution.y;
+            std::unique_ptr<Float[]> img(new Float[width * height]);
+            ParallelFor(
+                [&](int64_t v) {
+                    Float sinTheta =
+                        std::sin(Pi * Float(v + .5f) / Float(height));
+                    for (int u = 0; u < width; ++u)
+                        img[u + v * width] =
+                            texels[u + v * width].y() * sinTheta;
+                },
+                height, 32);
+            distrib.reset(new Distribution2D(img.get(), width, height));
+        }
     }
     Spectrum Scale(const Vector3f &w) const {
         Vector3f wp = Normalize(WorldToLight(w));
@@ -76,6 +96,7 @@ class GonioPhotometricLight : public Light {
                        : Spectrum(mipmap->Lookup(st), SpectrumType::Illuminant);
     }
     Spectrum Power() const;
+    Bounds3f WorldBound() const { return Bounds3f(pLight, pLight); }
     Float Pdf_Li(const Interaction &, const Vector3f &) const;
     Spectrum Sample_Le(const Point2f &u1, const Point2f &u2, Float time,
                        Ray *ray, Normal3f *nLight, Float *pdfPos,
@@ -88,6 +109,7 @@ class GonioPhotometricLight : public Light {
     const Point3f pLight;
     const Spectrum I;
     std::unique_ptr<MIPMap<RGBSpectrum>> mipmap;
+    std::unique_ptr<Distribution2D> distrib;
 };
 
 std::shared_ptr<GonioPhotometricLight> CreateGoniometricLight(
@@ -42,9 +42,33 @@ namespace pbrt {
 // InfiniteAreaLight Method Definitions
 InfiniteAreaLight::InfiniteAreaLight(const Transform &LightToWorld,
                                      const Spectrum &L, int nSamples,
-                                     const std::string &texmap)
+                                     const std::string &texmap,
+                                     const std::string &sampleStrategy,
+                                     const Point3f *portalCorners)
     : Light((int)LightFlags::Infinite, LightToWorld, MediumInterface(),
             nSamples) {
+    if (portalCorners) {
+        // Record the portal rectangle (p0, p1, p2, p3 in order around the
+        // boundary); sampling assumes p1-p0 and p3-p0 span the rectangle
+        hasPortal = true;
+        for (int i = 0; i < 4; ++i) portal[i] = portalCorners[i];
+        portalE1 = portal[1] - portal[0];
+        portalE2 = portal[3] - portal[0];
+        Vector3f n = Cross(portalE1, portalE2);
+        portalArea = n.Length();
+        if (portalArea == 0) {
+            Error("Degenerate \"portal\" rectangle for infinite light.");
+            hasPortal = false;
+        } else {
+            portalNormal = Normal3f(n / portalArea);
+            // The pdf's inside test projects onto the edges, which is only
+            // exact for rectangles
+            if (std::abs(Dot(portalE1, portalE2)) >
+                1e-4f * portalE1.Length() * portalE2.Length())
+                Warning("Infinite light \"portal\" isn't a rectangle; "
+                        "sampling pdfs will be slightly inconsistent.");
+        }
+    }
     // Read texel data from _texmap_ and initialize _Lmap_
     Point2i resolution;
     std::unique_ptr<RGBSpectrum[]> texels(nullptr);
@@ -63,24 +87,56 @@ InfiniteAreaLight::InfiniteAreaLight(const Transform &LightToWorld,
 
     // Initialize sampling PDFs for infinite area light
 
-    // Compute scalar-valued image _img_ from environment map
+    // Compute scalar-valued image _img_ from environment map. Rather than
+    // running a filtered MIPMap lookup per texel - which refilters the
+    // full-resolution map four times over for a 16k HDRI - read the base
+    // level directly with bilinear weights (wrapping in longitude,
+    // clamping at the poles). The distribution only needs the same
+    // low-pass shape, and Sample_Li/Pdf_Li derive their pdfs from this
+    // same image either way, so the estimator is unaffected.
     int width = 2 * Lmap->Width(), height = 2 * Lmap->Height();
+    int baseWidth = Lmap->Width(), baseHeight = Lmap->Height();
     std::unique_ptr<Float[]> img(new Float[width * height]);
-    float fwidth = 0.5f / std::min(width, height);
     ParallelFor(
         [&](int64_t v) {
             Float vp = (v + .5f) / (Float)height;
             Float sinTheta = std::sin(Pi * (v + .5f) / height);
+            Float tc = vp * baseHeight - .5f;
+            int t0 = Clamp((int)std::floor(tc), 0, baseHeight - 1);
+            int t1 = std::min(t0 + 1, baseHeight - 1);
+            Float ft = Clamp(tc - t0, (Float)0, (Float)1);
             for (int u = 0; u < width; ++u) {
                 Float up = (u + .5f) / (Float)width;
-                img[u + v * width] = Lmap->Lookup(Point2f(up, vp), fwidth).y();
-                img[u + v * width] *= sinTheta;
+                Float sc = up * baseWidth - .5f;
+                int sf = (int)std::floor(sc);
+                Float fs = sc - sf;
+                int s0 = (sf % baseWidth + baseWidth) % baseWidth;
+                int s1 = (s0 + 1) % baseWidth;
+                Float y00 = Lmap->Texel(0, s0, t0).y(),
+                      y10 = Lmap->Texel(0, s1, t0).y(),
+                      y01 = Lmap->Texel(0, s0, t1).y(),
+                      y11 = Lmap->Texel(0, s1, t1).y();
+                img[u + v * width] =
+                    sinTheta *
+                    Lerp(ft, Lerp(fs, y00, y10), Lerp(fs, y01, y11));
             }
         },
         height, 32);
 
     // Compute sampling distributions for rows and columns of image
     distribution.reset(new Distribution2D(img.get(), width, height));
+    // The hierarchical warp preserves incoming sample stratification;
+    // "alias" instead gives constant-time two-touch sampling, which wins
+    // on very large maps whose CDF arrays overwhelm the caches
+    if (sampleStrategy == "alias")
+        distribution->BuildAliasTables();
+    else {
+        if (sampleStrategy != "warp")
+            Warning("Environment sampling strategy \"%s\" unknown; "
+                    "using \"warp\".",
+                    sampleStrategy.c_str());
+        distribution->BuildHierarchicalWarp();
+    }
 }
 
 Spectrum InfiniteAreaLight::Power() const {
@@ -99,6 +155,24 @@ Spectrum InfiniteAreaLight::Sample_Li(const Interaction &ref, const Point2f &u,
                                       Vector3f *wi, Float *pdf,
                                       VisibilityTester *vis) const {
     ProfilePhase _(Prof::LightSample);
+    if (hasPortal) {
+        // Sample a point on the portal and convert the area density to a
+        // solid-angle pdf at the reference point
+        Point3f pPortal = portal[0] + u[0] * portalE1 + u[1] * portalE2;
+        Vector3f d = pPortal - ref.p;
+        Float dist2 = d.LengthSquared();
+        if (dist2 == 0) return Spectrum(0.f);
+        *wi = d / std::sqrt(dist2);
+        Float cosTheta = AbsDot(*wi, portalNormal);
+        if (cosTheta == 0) return Spectrum(0.f);
+        *pdf = dist2 / (cosTheta * portalArea);
+        *vis = VisibilityTester(
+            ref, Interaction(ref.p + *wi * (2 * worldRadius), ref.time,
+                             mediumInterface));
+        Vector3f w = Normalize(WorldToLight(*wi));
+        Point2f st(SphericalPhi(w) * Inv2Pi, SphericalTheta(w) * InvPi);
+        return Spectrum(Lmap->Lookup(st), SpectrumType::Illuminant);
+    }
     // Find $(u,v)$ sample coordinates in infinite light texture
     Float mapPdf;
     Point2f uv = distribution->SampleContinuous(u, &mapPdf);
@@ -121,8 +195,23 @@ Spectrum InfiniteAreaLight::Sample_Li(const Interaction &ref, const Point2f &u,
     return Spectrum(Lmap->Lookup(uv), SpectrumType::Illuminant);
 }
 
-Float InfiniteAreaLight::Pdf_Li(const Interaction &, const Vector3f &w) const {
+Float InfiniteAreaLight::Pdf_Li(const Interaction &ref, const Vector3f &w) const {
     ProfilePhase _(Prof::LightPdf);
+    if (hasPortal) {
+        // Zero unless the direction passes through the portal rectangle
+        Float denom = Dot(Vector3f(portalNormal), w);
+        if (denom == 0) return 0;
+        Float t = Dot(portal[0] - ref.p, Vector3f(portalNormal)) / denom;
+        if (t <= 0) return 0;
+        Point3f pHit = ref.p + t * w;
+        Vector3f d = pHit - portal[0];
+        Float s1 = Dot(d, portalE1) / portalE1.LengthSquared();
+        Float s2 = Dot(d, portalE2) / portalE2.LengthSquared();
+        if (s1 < 0 || s1 > 1 || s2 < 0 || s2 > 1) return 0;
+        Float dist2 = DistanceSquared(ref.p, pHit);
+        Float cosTheta = AbsDot(w, portalNormal);
+        return dist2 / (cosTheta * portalArea);
+    }
     Vector3f wi = WorldToLight(w);
     Float theta = SphericalTheta(wi), phi = SphericalPhi(wi);
     Float sinTheta = std::sin(theta);
@@ -181,8 +270,18 @@ std::shared_ptr<InfiniteAreaLight> CreateInfiniteLight(
     int nSamples = paramSet.FindOneInt("samples",
                                        paramSet.FindOneInt("nsamples", 1));
     if (PbrtOptions.quickRender) nSamples = std::max(1, nSamples / 4);
+    std::string strategy =
+        paramSet.FindOneString("samplingstrategy", "warp");
+    int nPortal;
+    const Point3f *portal = paramSet.FindPoint3f("portal", &nPortal);
+    if (portal && nPortal != 4) {
+        Error("Expected four corner points for infinite light \"portal\"; "
+              "got %d.",
+              nPortal);
+        portal = nullptr;
+    }
     return std::make_shared<InfiniteAreaLight>(light2world, L * sc, nSamples,
-                                               texmap);
+                                               texmap, strategy, portal);
 }
 
 }  // namespace pbrt
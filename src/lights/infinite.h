@@ -49,11 +49,13 @@
 namespace pbrt {
 
 // InfiniteAreaLight Declarations
-class InfiniteAreaLight : public Light {
+class InfiniteAreaLight final : public Light {
   public:
     // InfiniteAreaLight Public Methods
     InfiniteAreaLight(const Transform &LightToWorld, const Spectrum &power,
-                      int nSamples, const std::string &texmap);
+                      int nSamples, const std::string &texmap,
+                      const std::string &sampleStrategy = "warp",
+                      const Point3f *portalCorners = nullptr);
     void Preprocess(const Scene &scene) {
         scene.WorldBound().BoundingSphere(&worldCenter, &worldRadius);
     }
@@ -74,6 +76,15 @@ class InfiniteAreaLight : public Light {
     Point3f worldCenter;
     Float worldRadius;
     std::unique_ptr<Distribution2D> distribution;
+    // Optional portal rectangle: when set, Sample_Li() samples directions
+    // through the portal instead of the whole sphere, and Pdf_Li() is zero
+    // for directions that miss it (those are covered, correctly MIS
+    // weighted, by BSDF sampling).
+    bool hasPortal = false;
+    Point3f portal[4];
+    Vector3f portalE1, portalE2;
+    Normal3f portalNormal;
+    Float portalArea;
 };
 
 std::shared_ptr<InfiniteAreaLight> CreateInfiniteLight(
@@ -46,7 +46,7 @@
 namespace pbrt {
 
 // PointLight Declarations
-class PointLight : public Light {
+class PointLight final : public Light {
   public:
     // PointLight Public Methods
     PointLight(const Transform &LightToWorld,
@@ -57,6 +57,7 @@ class PointLight : public Light {
     Spectrum Sample_Li(const Interaction &ref, const Point2f &u, Vector3f *wi,
                        Float *pdf, VisibilityTester *vis) const;
     Spectrum Power() const;
+    Bounds3f WorldBound() const { return Bounds3f(pLight, pLight); }
     Float Pdf_Li(const Interaction &, const Vector3f &) const;
     Spectrum Sample_Le(const Point2f &u1, const Point2f &u2, Float time,
                        Ray *ray, Normal3f *nLight, Float *pdfPos,
@@ -34,6 +34,7 @@
 // lights/projection.cpp*
 #include "lights/projection.h"
 #include "sampling.h"
+#include "parallel.h"
 #include "paramset.h"
 #include "imageio.h"
 #include "reflection.h"
@@ -67,10 +68,25 @@ ProjectionLight::ProjectionLight(const Transform &LightToWorld,
     yon = 1e30f;
     lightProjection = Perspective(fov, hither, yon);
 
-    Transform screenToLight = Inverse(lightProjection);
+    screenToLight = Inverse(lightProjection);
     Point3f pCorner(screenBounds.pMax.x, screenBounds.pMax.y, 0);
     Vector3f wCorner = Normalize(Vector3f(screenToLight(pCorner)));
     cosTotalWidth = wCorner.z;
+
+    // Compute sampling distribution over the projected image and the screen
+    // window's area on the z=1 plane in light space; Sample_Le() and
+    // Pdf_Le() use the latter to convert image-space pdfs to solid-angle
+    // pdfs.
+    Vector3f wAxis = Vector3f(screenToLight(Point3f(1, 0, 0)));
+    Float planeScale = wAxis.x / wAxis.z;  // tan(fov / 2)
+    screenPlaneArea = planeScale * planeScale * screenBounds.Area();
+    if (texels) {
+        std::unique_ptr<Float[]> img(new Float[resolution.x * resolution.y]);
+        ParallelFor(
+            [&](int64_t i) { img[i] = texels[i].y(); },
+            resolution.x * resolution.y, 4096);
+        distrib.reset(new Distribution2D(img.get(), resolution.x, resolution.y));
+    }
 }
 
 Spectrum ProjectionLight::Sample_Li(const Interaction &ref, const Point2f &u,
@@ -113,11 +129,27 @@ Spectrum ProjectionLight::Sample_Le(const Point2f &u1, const Point2f &u2,
                                     Float time, Ray *ray, Normal3f *nLight,
                                     Float *pdfPos, Float *pdfDir) const {
     ProfilePhase _(Prof::LightSample);
-    Vector3f v = UniformSampleCone(u1, cosTotalWidth);
+    Vector3f v;
+    if (distrib) {
+        // Importance sample the projected image so that emitted rays follow
+        // the slide's luminance rather than filling the whole cone, most of
+        // which may project dark or empty texels.
+        Float mapPdf;
+        Point2f uv = distrib->SampleContinuous(u1, &mapPdf);
+        if (mapPdf == 0) {
+            *pdfPos = *pdfDir = 0;
+            return Spectrum(0.f);
+        }
+        Point2f ps = screenBounds.Lerp(uv);
+        v = Normalize(Vector3f(screenToLight(Point3f(ps.x, ps.y, 0))));
+        *pdfDir = mapPdf / (screenPlaneArea * v.z * v.z * v.z);
+    } else {
+        v = UniformSampleCone(u1, cosTotalWidth);
+        *pdfDir = UniformConePdf(cosTotalWidth);
+    }
     *ray = Ray(pLight, LightToWorld(v), Infinity, time, mediumInterface.inside);
     *nLight = (Normal3f)ray->d;
     *pdfPos = 1.f;
-    *pdfDir = UniformConePdf(cosTotalWidth);
     return I * Projection(ray->d);
 }
 
@@ -125,6 +157,21 @@ void ProjectionLight::Pdf_Le(const Ray &ray, const Normal3f &, Float *pdfPos,
                              Float *pdfDir) const {
     ProfilePhase _(Prof::LightPdf);
     *pdfPos = 0.f;
+    if (distrib) {
+        Vector3f wl = Normalize(WorldToLight(ray.d));
+        if (wl.z < hither) {
+            *pdfDir = 0;
+            return;
+        }
+        Point3f p = lightProjection(Point3f(wl.x, wl.y, wl.z));
+        if (!Inside(Point2f(p.x, p.y), screenBounds)) {
+            *pdfDir = 0;
+            return;
+        }
+        Point2f uv = Point2f(screenBounds.Offset(Point2f(p.x, p.y)));
+        *pdfDir = distrib->Pdf(uv) / (screenPlaneArea * wl.z * wl.z * wl.z);
+        return;
+    }
     *pdfDir = (CosTheta(WorldToLight(ray.d)) >= cosTotalWidth)
                   ? UniformConePdf(cosTotalWidth)
                   : 0;
@@ -43,6 +43,7 @@
 #include "light.h"
 #include "shape.h"
 #include "mipmap.h"
+#include "sampling.h"
 
 namespace pbrt {
 
@@ -57,6 +58,7 @@ class ProjectionLight : public Light {
                        Float *pdf, VisibilityTester *vis) const;
     Spectrum Projection(const Vector3f &w) const;
     Spectrum Power() const;
+    Bounds3f WorldBound() const { return Bounds3f(pLight, pLight); }
     Float Pdf_Li(const Interaction &, const Vector3f &) const;
     Spectrum Sample_Le(const Point2f &u1, const Point2f &u2, Float time,
                        Ray *ray, Normal3f *nLight, Float *pdfPos,
@@ -69,10 +71,15 @@ class ProjectionLight : public Light {
     std::unique_ptr<MIPMap<RGBSpectrum>> projectionMap;
     const Point3f pLight;
     const Spectrum I;
-    Transform lightProjection;
+    Transform lightProjection, screenToLight;
     Float hither, yon;
     Bounds2f screenBounds;
     Float cosTotalWidth;
+    // Sampling distribution over the projected image for Sample_Le(), and
+    // the area of the screen window projected onto the z=1 plane in light
+    // space, which converts image-space pdfs to solid-angle pdfs.
+    std::unique_ptr<Distribution2D> distrib;
+    Float screenPlaneArea;
 };
 
 std::shared_ptr<ProjectionLight> CreateProjectionLight(
@@ -37,6 +37,17 @@
 #include "parser.h"
 #include "parallel.h"
 #include <glog/logging.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+
+// Returns the scene file's last-modification time, or 0 if it can't be
+// determined (e.g. mid-save while an editor replaces the file).
+static time_t SceneFileMTime(const std::string &filename) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return 0;
+    return st.st_mtime;
+}
 
 using namespace pbrt;
 
@@ -46,12 +57,75 @@ static void usage(const char *msg = nullptr) {
 
     fprintf(stderr, R"(usage: pbrt [<options>] <filename.pbrt...>
 Rendering options:
+  --buckets <n>        Render the frame as an n x n grid of crop-window
+                       buckets, one bucket-sized film at a time, writing each
+                       bucket as a separate crop file (requires --outfile);
+                       merge them afterward with "imgtool assemble". Keeps
+                       film memory constant for extreme resolutions. Not
+                       meaningful for splatting integrators (BDPT/MLT).
+  --checkpoint <filename> Periodically write render progress to the given
+                       file so an interrupted render can be resumed.
+  --checkpointinterval <seconds> Seconds between checkpoint writes.
+                       Default: 300.
+  --compresstextures   Store texture MIP maps in half precision, halving
+                       texture memory.
+  --costsched          Render in passes with expensive tiles dispatched
+                       first, based on measured per-tile cost.
   --cropwindow <x0,x1,y0,y1> Specify an image crop window.
   --help               Print this help text.
+  --livestats <filename> Periodically write a JSON snapshot of the renderer
+                       statistics to the given file during rendering.
   --nthreads <num>     Use specified number of threads for rendering.
+  --numa               Pin render threads to cores and fault hot shared
+                       structures' pages in parallel so they interleave
+                       across NUMA nodes (Linux only).
+  --motionsteps <n>    Quantize animated-transform interpolation to n
+                       precomputed steps across the shutter instead of
+                       interpolating per ray; larger n is more accurate.
   --outfile <filename> Write the final image to the given filename.
+  --profout <filename> Write the sampling profiler's results in
+                       collapsed-stack flame graph format to the given file.
+  --progressfile <filename> Append machine-readable JSON progress lines
+                       (work done, fraction, elapsed seconds, smoothed ETA)
+                       to the given file while rendering, for farm
+                       schedulers that can't parse the terminal bar.
+  --progressive        Render the whole image one sample per pixel at a time,
+                       rewriting the output image after each pass.
+  --resume             Continue rendering from the state in the --checkpoint
+                       file, if it exists.
+  --deterministic      Merge finished film tiles in a fixed order so that the
+                       output image is bit-identical regardless of the thread
+                       count. Applies to the standard tile renderer; sampler
+                       seeding is already index-based.
+  --coordinator <port> Act as the distributed-rendering coordinator: listen on
+                       the given port, hand out tiles to workers (rendering
+                       tiles locally as well), merge their results, and write
+                       the final image. All nodes must see the same scene.
+  --worker <host:port> Act as a distributed-rendering worker: fetch tiles from
+                       the coordinator and stream the results back.
+  --timebudget <sec>   Render progressive passes until the wall-clock budget
+                       would be exceeded by another pass, then write the
+                       properly weighted image and report the achieved
+                       samples per pixel.
+  --watch              After rendering, wait for the scene file to change and
+                       render it again in the same process; texture, mesh,
+                       and transform caches stay warm across iterations.
+  --telemetry <filename> Append one versioned JSON record per render - every
+                       statistic, the profiler report, peak RSS, and wall
+                       timing - to the given file for fleet-wide analytics.
+  --texbudget <MB>     Cap resident texture memory; textures load on demand
+                       and the least recently used are evicted past the cap.
+  --texcachedir <dir>  Dedupe textures by content hash and cache converted
+                       texel data in the given directory across runs.
+  --trcache            Cache converged shadow-ray transmittance values
+                       through participating media (slightly approximate).
+  --writeinterval <seconds> Write the in-progress image periodically from a
+                       background thread while rendering.
   --quick              Automatically reduce a number of quality settings to
                        render more quickly.
+  --renderregion <x0 x1 y0 y1> Render only the given pixel region.
+  --compositefile <filename> Composite the rendered region into the given
+                       existing full-frame image when writing the output.
   --quiet              Suppress all text output other than error messages.
 
 Logging options:
@@ -113,6 +187,123 @@ int main(int argc, char *argv[]) {
             FLAGS_minloglevel = atoi(argv[++i]);
         } else if (!strncmp(argv[i], "--minloglevel=", 14)) {
             FLAGS_minloglevel = atoi(&argv[i][14]);
+        } else if (!strcmp(argv[i], "--checkpoint") ||
+                   !strcmp(argv[i], "-checkpoint")) {
+            if (i + 1 == argc)
+                usage("missing value after --checkpoint argument");
+            options.checkpointFile = argv[++i];
+        } else if (!strncmp(argv[i], "--checkpoint=", 13)) {
+            options.checkpointFile = &argv[i][13];
+        } else if (!strcmp(argv[i], "--checkpointinterval") ||
+                   !strcmp(argv[i], "-checkpointinterval")) {
+            if (i + 1 == argc)
+                usage("missing value after --checkpointinterval argument");
+            options.checkpointSeconds = atoi(argv[++i]);
+        } else if (!strncmp(argv[i], "--checkpointinterval=", 21)) {
+            options.checkpointSeconds = atoi(&argv[i][21]);
+        } else if (!strcmp(argv[i], "--renderregion") ||
+                   !strcmp(argv[i], "-renderregion")) {
+            if (i + 4 >= argc)
+                usage("missing value after --renderregion argument");
+            options.haveRenderRegion = true;
+            for (int c = 0; c < 4; ++c)
+                options.renderRegion[c] = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--compositefile") ||
+                   !strcmp(argv[i], "-compositefile")) {
+            if (i + 1 == argc)
+                usage("missing value after --compositefile argument");
+            options.compositeFile = argv[++i];
+        } else if (!strncmp(argv[i], "--compositefile=", 16)) {
+            options.compositeFile = &argv[i][16];
+        } else if (!strcmp(argv[i], "--progressive") ||
+                   !strcmp(argv[i], "-progressive")) {
+            options.progressive = true;
+        } else if (!strcmp(argv[i], "--resume") || !strcmp(argv[i], "-resume")) {
+            options.resume = true;
+        } else if (!strcmp(argv[i], "--watch") || !strcmp(argv[i], "-watch")) {
+            options.watchScene = true;
+        } else if (!strcmp(argv[i], "--coordinator") ||
+                   !strcmp(argv[i], "-coordinator")) {
+            if (i + 1 == argc)
+                usage("missing port after --coordinator argument");
+            options.distCoordinatorPort = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--worker") ||
+                   !strcmp(argv[i], "-worker")) {
+            if (i + 1 == argc)
+                usage("missing host:port after --worker argument");
+            options.distWorkerAddress = argv[++i];
+        } else if (!strcmp(argv[i], "--deterministic") ||
+                   !strcmp(argv[i], "-deterministic")) {
+            options.deterministic = true;
+        } else if (!strcmp(argv[i], "--telemetry") ||
+                   !strcmp(argv[i], "-telemetry")) {
+            if (i + 1 == argc)
+                usage("missing filename after --telemetry argument");
+            options.telemetryFile = argv[++i];
+        } else if (!strcmp(argv[i], "--progressfile") ||
+                   !strcmp(argv[i], "-progressfile")) {
+            if (i + 1 == argc)
+                usage("missing filename after --progressfile argument");
+            options.progressFile = argv[++i];
+        } else if (!strcmp(argv[i], "--buckets") ||
+                   !strcmp(argv[i], "-buckets")) {
+            if (i + 1 == argc)
+                usage("missing value after --buckets argument");
+            options.imageBuckets = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--timebudget") ||
+                   !strcmp(argv[i], "-timebudget")) {
+            if (i + 1 == argc)
+                usage("missing value after --timebudget argument");
+            options.timeBudgetSeconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--motionsteps") ||
+                   !strcmp(argv[i], "-motionsteps")) {
+            if (i + 1 == argc)
+                usage("missing value after --motionsteps argument");
+            options.motionSteps = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--compresstextures") ||
+                   !strcmp(argv[i], "-compresstextures")) {
+            options.compressTextures = true;
+        } else if (!strcmp(argv[i], "--texbudget") ||
+                   !strcmp(argv[i], "-texbudget")) {
+            if (i + 1 == argc)
+                usage("missing value after --texbudget argument");
+            options.textureBudgetMB = atoi(argv[++i]);
+        } else if (!strncmp(argv[i], "--texbudget=", 12)) {
+            options.textureBudgetMB = atoi(&argv[i][12]);
+        } else if (!strcmp(argv[i], "--texcachedir") ||
+                   !strcmp(argv[i], "-texcachedir")) {
+            if (i + 1 == argc)
+                usage("missing value after --texcachedir argument");
+            options.texCacheDir = argv[++i];
+        } else if (!strncmp(argv[i], "--texcachedir=", 14)) {
+            options.texCacheDir = &argv[i][14];
+        } else if (!strcmp(argv[i], "--trcache") || !strcmp(argv[i], "-trcache")) {
+            options.transmittanceCache = true;
+        } else if (!strcmp(argv[i], "--costsched") ||
+                   !strcmp(argv[i], "-costsched")) {
+            options.costScheduler = true;
+        } else if (!strcmp(argv[i], "--numa") || !strcmp(argv[i], "-numa")) {
+            options.numa = true;
+        } else if (!strcmp(argv[i], "--profout") || !strcmp(argv[i], "-profout")) {
+            if (i + 1 == argc)
+                usage("missing value after --profout argument");
+            options.profileOutFile = argv[++i];
+        } else if (!strncmp(argv[i], "--profout=", 10)) {
+            options.profileOutFile = &argv[i][10];
+        } else if (!strcmp(argv[i], "--livestats") ||
+                   !strcmp(argv[i], "-livestats")) {
+            if (i + 1 == argc)
+                usage("missing value after --livestats argument");
+            options.liveStatsFile = argv[++i];
+        } else if (!strncmp(argv[i], "--livestats=", 12)) {
+            options.liveStatsFile = &argv[i][12];
+        } else if (!strcmp(argv[i], "--writeinterval") ||
+                   !strcmp(argv[i], "-writeinterval")) {
+            if (i + 1 == argc)
+                usage("missing value after --writeinterval argument");
+            options.writeIntervalSeconds = atoi(argv[++i]);
+        } else if (!strncmp(argv[i], "--writeinterval=", 16)) {
+            options.writeIntervalSeconds = atoi(&argv[i][16]);
         } else if (!strcmp(argv[i], "--quick") || !strcmp(argv[i], "-quick")) {
             options.quickRender = true;
         } else if (!strcmp(argv[i], "--quiet") || !strcmp(argv[i], "-quiet")) {
@@ -163,7 +354,57 @@ int main(int argc, char *argv[]) {
     if (filenames.empty()) {
         // Parse scene from standard input
         pbrtParseFile("-");
+    } else if (options.imageBuckets > 1) {
+        // Bucketed constant-memory rendering: the film only ever allocates
+        // the crop window, so rendering the frame as a sequence of crop
+        // buckets holds one bucket of pixels at a time; caches stay warm
+        // between buckets the same way --watch keeps them.
+        if (filenames.size() != 1 || options.imageFile.empty())
+            usage("--buckets requires a single scene file and --outfile");
+        int n = options.imageBuckets;
+        std::string baseOut = options.imageFile;
+        size_t dot = baseOut.find_last_of('.');
+        for (int by = 0; by < n; ++by)
+            for (int bx = 0; bx < n; ++bx) {
+                PbrtOptions.cropWindow[0][0] = (Float)bx / n;
+                PbrtOptions.cropWindow[0][1] = (Float)(bx + 1) / n;
+                PbrtOptions.cropWindow[1][0] = (Float)by / n;
+                PbrtOptions.cropWindow[1][1] = (Float)(by + 1) / n;
+                char suffix[64];
+                snprintf(suffix, sizeof(suffix), "_bucket_%d_%d", bx, by);
+                PbrtOptions.imageFile =
+                    dot == std::string::npos
+                        ? baseOut + suffix
+                        : baseOut.substr(0, dot) + suffix + baseOut.substr(dot);
+                fprintf(stderr, "pbrt: rendering bucket (%d, %d) of %dx%d\n",
+                        bx, by, n, n);
+                pbrtParseFile(filenames[0]);
+            }
+        fprintf(stderr,
+                "pbrt: all buckets rendered; merge with \"imgtool assemble "
+                "--outfile <full.exr> <bucket files>\"\n");
+    } else if (options.watchScene && filenames.size() == 1) {
+        // Lookdev loop: render, then wait for the scene file to change and
+        // render it again in the same process. The texture, mesh, and
+        // transform caches stay warm (pbrtWorldEnd() skips clearing them in
+        // this mode), so a reload only pays for what actually changed.
+        const std::string &f = filenames[0];
+        while (true) {
+            time_t mtime = SceneFileMTime(f);
+            pbrtParseFile(f);
+            fprintf(stderr,
+                    "pbrt: watching \"%s\" for changes (interrupt to exit)\n",
+                    f.c_str());
+            while (SceneFileMTime(f) == mtime)
+                std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            // Give editors that write-then-rename a moment to finish
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
     } else {
+        if (options.watchScene)
+            fprintf(stderr,
+                    "pbrt: --watch requires a single scene file; ignoring "
+                    "it.\n");
         // Parse scene from input files
         for (const std::string &f : filenames)
             pbrtParseFile(f);
@@ -34,6 +34,7 @@
 #include "materials/fourier.h"
 #include "interaction.h"
 #include "paramset.h"
+#include <mutex>
 
 namespace pbrt {
 
@@ -198,15 +199,40 @@ fail:
     return false;
 }
 
+// Hash the BSDF file's raw bytes so that material variants referencing the
+// same measured data through different paths (copies, symlink farms) share
+// one loaded table.
+static std::string FourierTableContentKey(const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f) return filename;  // let Read() report the error
+    uint64_t h = 14695981039346656037ull;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        for (size_t i = 0; i < n; ++i) {
+            h ^= (unsigned char)buf[i];
+            h *= 1099511628211ull;
+        }
+    fclose(f);
+    char key[32];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)h);
+    return key;
+}
+
 FourierMaterial::FourierMaterial(const std::string &filename,
                                  const std::shared_ptr<Texture<Float>> &bumpMap)
     : bumpMap(bumpMap) {
-    if (loadedBSDFs.find(filename) == loadedBSDFs.end()) {
+    // Key the shared-table cache by content rather than path; parameter
+    // sets may also be instantiated from worker threads, so guard the map.
+    static std::mutex loadedBSDFMutex;
+    std::string key = FourierTableContentKey(filename);
+    std::lock_guard<std::mutex> lock(loadedBSDFMutex);
+    if (loadedBSDFs.find(key) == loadedBSDFs.end()) {
         std::unique_ptr<FourierBSDFTable> table(new FourierBSDFTable);
         FourierBSDFTable::Read(filename, table.get());
-        loadedBSDFs[filename] = std::move(table);
+        loadedBSDFs[key] = std::move(table);
     }
-    bsdfTable = loadedBSDFs[filename].get();
+    bsdfTable = loadedBSDFs[key].get();
 }
 
 void FourierMaterial::ComputeScatteringFunctions(
@@ -163,7 +163,35 @@ void HairMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
 
     // Offset along width
     Float h = -1 + 2 * si->uv[1];
-    si->bsdf->Add(ARENA_ALLOC(arena, HairBSDF)(h, e, sig_a, bm, bn, a));
+    bool useTable = !azimuthalNp.empty() && bn == azimuthalBetaN;
+    si->bsdf->Add(ARENA_ALLOC(arena, HairBSDF)(
+        h, e, sig_a, bm, bn, a, useTable ? azimuthalNp.data() : nullptr,
+        useTable ? (int)azimuthalNp.size() : 0));
+}
+
+void HairMaterial::BakeAzimuthalTable() {
+    // The azimuthal lobe shape N_p only depends on beta_n (through the
+    // logistic scale s) and the azimuth difference; the per-mode offset
+    // Phi(p, gammaO, gammaT) just shifts it. So when beta_n is spatially
+    // uniform a single 1D table of the trimmed logistic serves every
+    // scattering mode and every hair intersection, replacing the exp-heavy
+    // evaluation with a lerp across millions of hits.
+    const ConstantTexture<Float> *constBetaN =
+        dynamic_cast<const ConstantTexture<Float> *>(beta_n.get());
+    if (!constBetaN) return;
+    SurfaceInteraction si;
+    Float bn = constBetaN->Evaluate(si);
+    Float s = SqrtPiOver8 *
+              (0.265f * bn + 1.194f * Sqr(bn) + 5.372f * Pow<22>(bn));
+    // Skip the table when the logistic is too narrow for the table
+    // resolution to resolve it; those cases fall back to direct evaluation.
+    if (!(s > 4 * (2 * Pi / (nAzimuthalSamples - 1)))) return;
+    azimuthalBetaN = bn;
+    azimuthalNp.resize(nAzimuthalSamples);
+    for (int i = 0; i < nAzimuthalSamples; ++i) {
+        Float dphi = Lerp(Float(i) / (nAzimuthalSamples - 1), -Pi, Pi);
+        azimuthalNp[i] = TrimmedLogistic(dphi, s, -Pi, Pi);
+    }
 }
 
 HairMaterial *CreateHairMaterial(const TextureParams &mp) {
@@ -225,14 +253,17 @@ HairMaterial *CreateHairMaterial(const TextureParams &mp) {
 
 // HairBSDF Method Definitions
 HairBSDF::HairBSDF(Float h, Float eta, const Spectrum &sigma_a, Float beta_m,
-                   Float beta_n, Float alpha)
+                   Float beta_n, Float alpha, const Float *azimuthalTable,
+                   int nAzimuthalSamples)
     : BxDF(BxDFType(BSDF_GLOSSY | BSDF_REFLECTION | BSDF_TRANSMISSION)),
       h(h),
       gammaO(SafeASin(h)),
       eta(eta),
       sigma_a(sigma_a),
       beta_m(beta_m),
-      beta_n(beta_n) {
+      beta_n(beta_n),
+      azimuthalTable(azimuthalTable),
+      nAzimuthalSamples(nAzimuthalSamples) {
     CHECK(h >= -1 && h <= 1);
     CHECK(beta_m >= 0 && beta_m <= 1);
     CHECK(beta_n >= 0 && beta_n <= 1);
@@ -261,6 +292,17 @@ HairBSDF::HairBSDF(Float h, Float eta, const Spectrum &sigma_a, Float beta_m,
     }
 }
 
+Float HairBSDF::EvalNp(Float phi, int p, Float gammaT) const {
+    if (!azimuthalTable) return Np(phi, p, s, gammaO, gammaT);
+    Float dphi = phi - Phi(p, gammaO, gammaT);
+    // Remap _dphi_ to $[-\pi,\pi]$ and interpolate the precomputed table
+    while (dphi > Pi) dphi -= 2 * Pi;
+    while (dphi < -Pi) dphi += 2 * Pi;
+    Float t = (dphi + Pi) / (2 * Pi) * (nAzimuthalSamples - 1);
+    int i = std::min((int)t, nAzimuthalSamples - 2);
+    return Lerp(t - i, azimuthalTable[i], azimuthalTable[i + 1]);
+}
+
 Spectrum HairBSDF::f(const Vector3f &wo, const Vector3f &wi) const {
     // Compute hair coordinate system terms related to _wo_
     Float sinThetaO = wo.x;
@@ -312,7 +354,7 @@ Spectrum HairBSDF::f(const Vector3f &wo, const Vector3f &wi) const {
         // Handle out-of-range $\cos \thetao$ from scale adjustment
         cosThetaOp = std::abs(cosThetaOp);
         fsum += Mp(cosThetaI, cosThetaOp, sinThetaI, sinThetaOp, v[p]) * ap[p] *
-                Np(phi, p, s, gammaO, gammaT);
+                EvalNp(phi, p, gammaT);
     }
 
     // Compute contribution of remaining terms after _pMax_
@@ -436,7 +478,7 @@ Spectrum HairBSDF::Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u2,
         // Handle out-of-range $\cos \thetao$ from scale adjustment
         cosThetaOp = std::abs(cosThetaOp);
         *pdf += Mp(cosThetaI, cosThetaOp, sinThetaI, sinThetaOp, v[p]) *
-                apPdf[p] * Np(dphi, p, s, gammaO, gammaT);
+                apPdf[p] * EvalNp(dphi, p, gammaT);
     }
     *pdf += Mp(cosThetaI, cosThetaO, sinThetaI, sinThetaO, v[pMax]) *
             apPdf[pMax] * (1 / (2 * Pi));
@@ -489,7 +531,7 @@ Float HairBSDF::Pdf(const Vector3f &wo, const Vector3f &wi) const {
         // Handle out-of-range $\cos \thetao$ from scale adjustment
         cosThetaOp = std::abs(cosThetaOp);
         pdf += Mp(cosThetaI, cosThetaOp, sinThetaI, sinThetaOp, v[p]) *
-               apPdf[p] * Np(phi, p, s, gammaO, gammaT);
+               apPdf[p] * EvalNp(phi, p, gammaT);
     }
     pdf += Mp(cosThetaI, cosThetaO, sinThetaI, sinThetaO, v[pMax]) *
            apPdf[pMax] * (1 / (2 * Pi));
@@ -72,16 +72,28 @@ class HairMaterial : public Material {
           eta(eta),
           beta_m(beta_m),
           beta_n(beta_n),
-          alpha(alpha) {}
+          alpha(alpha) {
+        BakeAzimuthalTable();
+    }
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
 
   private:
+    // HairMaterial Private Methods
+
+    // Precompute the azimuthal trimmed-logistic lookup table used by
+    // HairBSDF when beta_n is spatially uniform; see the definition for
+    // details.
+    void BakeAzimuthalTable();
+
     // HairMaterial Private Data
     std::shared_ptr<Texture<Spectrum>> sigma_a, color;
     std::shared_ptr<Texture<Float>> eumelanin, pheomelanin, eta;
     std::shared_ptr<Texture<Float>> beta_m, beta_n, alpha;
+    static const int nAzimuthalSamples = 2048;
+    std::vector<Float> azimuthalNp;
+    Float azimuthalBetaN = 0;
 };
 
 HairMaterial *CreateHairMaterial(const TextureParams &mp);
@@ -95,7 +107,8 @@ class HairBSDF : public BxDF {
   public:
     // HairBSDF Public Methods
     HairBSDF(Float h, Float eta, const Spectrum &sigma_a, Float beta_m,
-             Float beta_n, Float alpha);
+             Float beta_n, Float alpha, const Float *azimuthalTable = nullptr,
+             int nAzimuthalSamples = 0);
     Spectrum f(const Vector3f &wo, const Vector3f &wi) const;
     Spectrum Sample_f(const Vector3f &wo, Vector3f *wi, const Point2f &u,
                       Float *pdf, BxDFType *sampledType) const;
@@ -107,6 +120,9 @@ class HairBSDF : public BxDF {
   private:
     // HairBSDF Private Methods
     std::array<Float, pMax + 1> ComputeApPdf(Float cosThetaO) const;
+    // Evaluate the azimuthal scattering function, using the material's
+    // precomputed lookup table when one was baked for this beta_n.
+    Float EvalNp(Float phi, int p, Float gammaT) const;
 
     // HairBSDF Private Data
     const Float h, gammaO, eta;
@@ -115,6 +131,9 @@ class HairBSDF : public BxDF {
     Float v[pMax + 1];
     Float s;
     Float sin2kAlpha[3], cos2kAlpha[3];
+    // Borrowed from the owning HairMaterial, which outlives the BSDF
+    const Float *azimuthalTable;
+    int nAzimuthalSamples;
 };
 
 // General Utility Functions
@@ -39,6 +39,7 @@
 #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
+#include <cstring>
 
 namespace pbrt {
 
@@ -50,6 +51,44 @@ void MixMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
     // Compute weights and original _BxDF_s for mix material
     Spectrum s1 = scale->Evaluate(*si).Clamp();
     Spectrum s2 = (Spectrum(1.f) - s1).Clamp();
+
+    if (stochastic) {
+        // Evaluate a single stochastically selected child instead of both:
+        // pick child one with probability p equal to the mix luminance and
+        // scale its lobes by s1 / p (or child two by s2 / (1 - p)), which
+        // keeps the estimator's expectation exactly s1 f1 + s2 f2 while
+        // nested mixes collapse to one evaluation path per hit. The
+        // selection variable is hashed from the shading point so results
+        // are reproducible run to run.
+        Float p = Clamp(s1.y(), (Float)0, (Float)1);
+        uint64_t bits = 0;
+        float pf[3] = {(float)si->p.x, (float)si->p.y, (float)si->p.z};
+        for (int i = 0; i < 3; ++i) {
+            uint32_t b;
+            memcpy(&b, &pf[i], sizeof(b));
+            bits = (bits ^ b) * 0x9E3779B97F4A7C15ull;
+        }
+        Float u = Float(bits >> 11) * (Float)(1.0 / (1ull << 53));
+        if (p > 0 && (u < p || p >= 1)) {
+            m1->ComputeScatteringFunctions(si, arena, mode,
+                                           allowMultipleLobes);
+            Spectrum w = s1 / std::min(p, (Float)1);
+            int n = si->bsdf->NumComponents();
+            for (int i = 0; i < n; ++i)
+                si->bsdf->bxdfs[i] =
+                    ARENA_ALLOC(arena, ScaledBxDF)(si->bsdf->bxdfs[i], w);
+        } else {
+            m2->ComputeScatteringFunctions(si, arena, mode,
+                                           allowMultipleLobes);
+            Spectrum w = s2 / std::max(1 - p, (Float)1e-4);
+            int n = si->bsdf->NumComponents();
+            for (int i = 0; i < n; ++i)
+                si->bsdf->bxdfs[i] =
+                    ARENA_ALLOC(arena, ScaledBxDF)(si->bsdf->bxdfs[i], w);
+        }
+        return;
+    }
+
     SurfaceInteraction si2 = *si;
     m1->ComputeScatteringFunctions(si, arena, mode, allowMultipleLobes);
     m2->ComputeScatteringFunctions(&si2, arena, mode, allowMultipleLobes);
@@ -68,7 +107,8 @@ MixMaterial *CreateMixMaterial(const TextureParams &mp,
                                const std::shared_ptr<Material> &m2) {
     std::shared_ptr<Texture<Spectrum>> scale =
         mp.GetSpectrumTexture("amount", Spectrum(0.5f));
-    return new MixMaterial(m1, m2, scale);
+    bool stochastic = mp.FindBool("stochastic", false);
+    return new MixMaterial(m1, m2, scale, stochastic);
 }
 
 }  // namespace pbrt
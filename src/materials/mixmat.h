@@ -50,8 +50,9 @@ class MixMaterial : public Material {
     // MixMaterial Public Methods
     MixMaterial(const std::shared_ptr<Material> &m1,
                 const std::shared_ptr<Material> &m2,
-                const std::shared_ptr<Texture<Spectrum>> &scale)
-        : m1(m1), m2(m2), scale(scale) {}
+                const std::shared_ptr<Texture<Spectrum>> &scale,
+                bool stochastic = false)
+        : m1(m1), m2(m2), scale(scale), stochastic(stochastic) {}
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -60,6 +61,9 @@ class MixMaterial : public Material {
     // MixMaterial Private Data
     std::shared_ptr<Material> m1, m2;
     std::shared_ptr<Texture<Spectrum>> scale;
+    // Evaluate only one stochastically chosen child per hit ("stochastic"
+    // parameter); see ComputeScatteringFunctions()
+    const bool stochastic;
 };
 
 MixMaterial *CreateMixMaterial(const TextureParams &mp,
@@ -61,6 +61,7 @@ void PlasticMaterial::ComputeScatteringFunctions(
         Float rough = roughness->Evaluate(*si);
         if (remapRoughness)
             rough = TrowbridgeReitzDistribution::RoughnessToAlpha(rough);
+        rough = RoughenFromBumpVariance(rough, si->bumpSlopeVariance);
         MicrofacetDistribution *distrib =
             ARENA_ALLOC(arena, TrowbridgeReitzDistribution)(rough, rough);
         BxDF *spec =
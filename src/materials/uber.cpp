@@ -46,6 +46,18 @@ void UberMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
                                               MemoryArena &arena,
                                               TransportMode mode,
                                               bool allowMultipleLobes) const {
+    // Material LOD: past the configured path depth, substitute a single
+    // Lambertian proxy with the layered stack's approximate albedo. Deep
+    // GI bounces see wide filter footprints, so the filtered Kd/Ks
+    // evaluations here are effectively the textures' mip tails, and the
+    // bump mapping and specular lobe construction are skipped entirely.
+    if (materialLODMinDepth > 0 && materialLODDepth >= materialLODMinDepth) {
+        si->bsdf = ARENA_ALLOC(arena, BSDF)(*si);
+        Spectrum albedo =
+            (Kd->Evaluate(*si) + Ks->Evaluate(*si)).Clamp(0, 1);
+        si->bsdf->Add(ARENA_ALLOC(arena, LambertianReflection)(albedo));
+        return;
+    }
     // Perform bump mapping with _bumpMap_, if present
     if (bumpMap) Bump(bumpMap, si);
     Float e = eta->Evaluate(*si);
@@ -81,6 +93,8 @@ void UberMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
             roughu = TrowbridgeReitzDistribution::RoughnessToAlpha(roughu);
             roughv = TrowbridgeReitzDistribution::RoughnessToAlpha(roughv);
         }
+        roughu = RoughenFromBumpVariance(roughu, si->bumpSlopeVariance);
+        roughv = RoughenFromBumpVariance(roughv, si->bumpSlopeVariance);
         MicrofacetDistribution *distrib =
             ARENA_ALLOC(arena, TrowbridgeReitzDistribution)(roughu, roughv);
         BxDF *spec =
@@ -37,6 +37,12 @@
 #include "sampler.h"
 #include "stats.h"
 #include "interaction.h"
+#include <algorithm>
+
+#if defined(__SSE__) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#define PBRT_GRID_SSE
+#include <xmmintrin.h>
+#endif
 
 namespace pbrt {
 
@@ -59,61 +65,367 @@ Float GridDensityMedium::Density(const Point3f &p) const {
     return Lerp(d.z, d0, d1);
 }
 
+// Evaluate the density at four sample points at once: the eight corner
+// values per point are gathered with scalar loads and the trilinear
+// interpolation arithmetic runs four points wide.
+void GridDensityMedium::Density4(const Point3f p[4], Float d[4]) const {
+#ifdef PBRT_GRID_SSE
+    alignas(16) float c[8][4], dx[4], dy[4], dz[4];
+    for (int i = 0; i < 4; ++i) {
+        Point3f pSamples(p[i].x * nx - .5f, p[i].y * ny - .5f,
+                         p[i].z * nz - .5f);
+        Point3i pi = (Point3i)Floor(pSamples);
+        dx[i] = pSamples.x - pi.x;
+        dy[i] = pSamples.y - pi.y;
+        dz[i] = pSamples.z - pi.z;
+        c[0][i] = D(pi);
+        c[1][i] = D(pi + Vector3i(1, 0, 0));
+        c[2][i] = D(pi + Vector3i(0, 1, 0));
+        c[3][i] = D(pi + Vector3i(1, 1, 0));
+        c[4][i] = D(pi + Vector3i(0, 0, 1));
+        c[5][i] = D(pi + Vector3i(1, 0, 1));
+        c[6][i] = D(pi + Vector3i(0, 1, 1));
+        c[7][i] = D(pi + Vector3i(1, 1, 1));
+    }
+    auto lerp4 = [](__m128 t, __m128 a, __m128 b) {
+        return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+    };
+    __m128 tx = _mm_load_ps(dx), ty = _mm_load_ps(dy), tz = _mm_load_ps(dz);
+    __m128 d00 = lerp4(tx, _mm_load_ps(c[0]), _mm_load_ps(c[1]));
+    __m128 d10 = lerp4(tx, _mm_load_ps(c[2]), _mm_load_ps(c[3]));
+    __m128 d01 = lerp4(tx, _mm_load_ps(c[4]), _mm_load_ps(c[5]));
+    __m128 d11 = lerp4(tx, _mm_load_ps(c[6]), _mm_load_ps(c[7]));
+    __m128 d0 = lerp4(ty, d00, d10);
+    __m128 d1 = lerp4(ty, d01, d11);
+    alignas(16) float out[4];
+    _mm_store_ps(out, lerp4(tz, d0, d1));
+    for (int i = 0; i < 4; ++i) d[i] = out[i];
+#else
+    for (int i = 0; i < 4; ++i) d[i] = Density(p[i]);
+#endif
+}
+
+
+// Per-thread memo of the most recent world-to-medium ray setup. Shadow
+// rays that cross the same medium several times (enter/exit/enter) call
+// Tr() once per segment with identical origin and direction, and the
+// Sample()/Tr() pairs along one path segment chain repeat the transform
+// likewise; when origin and direction match exactly, the transformed ray
+// and the unclipped bounds entry/exit distances are reused. Reuse only
+// happens on exact equality, so results are unchanged.
+struct MediumRayMemo {
+    const GridDensityMedium *medium = nullptr;
+    Point3f oWorld;
+    Vector3f dWorld;
+    Point3f oMedium;
+    Vector3f dMedium;
+    Float t0 = 0, t1 = 0;
+    bool hits = false;
+};
+static PBRT_THREAD_LOCAL MediumRayMemo mediumRayMemo;
+
+// Transform _rWorld_ into medium space (reusing the memo when possible)
+// and clip the cached unclipped bounds overlap against the ray's tMax;
+// returns false if the ray misses the unit bounds.
+bool GridDensityMedium::MediumSpaceRay(const Ray &rWorld, Ray *ray,
+                                       Float *tMin, Float *tMax) const {
+    Vector3f dNorm = Normalize(rWorld.d);
+    Float tEnd = rWorld.tMax * rWorld.d.Length();
+    MediumRayMemo &memo = mediumRayMemo;
+    if (memo.medium != this || memo.oWorld != rWorld.o ||
+        memo.dWorld != dNorm) {
+        Ray unbounded = WorldToMedium(Ray(rWorld.o, dNorm));
+        memo.medium = this;
+        memo.oWorld = rWorld.o;
+        memo.dWorld = dNorm;
+        memo.oMedium = unbounded.o;
+        memo.dMedium = unbounded.d;
+        const Bounds3f b(Point3f(0, 0, 0), Point3f(1, 1, 1));
+        memo.hits = b.IntersectP(unbounded, &memo.t0, &memo.t1);
+    }
+    if (!memo.hits || memo.t0 > tEnd) return false;
+    *ray = Ray(memo.oMedium, memo.dMedium, tEnd);
+    *tMin = memo.t0;
+    *tMax = std::min(memo.t1, tEnd);
+    return true;
+}
+
 Spectrum GridDensityMedium::Sample(const Ray &rWorld, Sampler &sampler,
-                                   MemoryArena &arena,
-                                   MediumInteraction *mi) const {
+                                   MemoryArena &arena, MediumInteraction *mi,
+                                   const Spectrum *) const {
     ProfilePhase _(Prof::MediumSample);
-    Ray ray = WorldToMedium(
-        Ray(rWorld.o, Normalize(rWorld.d), rWorld.tMax * rWorld.d.Length()));
-    // Compute $[\tmin, \tmax]$ interval of _ray_'s overlap with medium bounds
-    const Bounds3f b(Point3f(0, 0, 0), Point3f(1, 1, 1));
+    // Compute the medium-space ray and its $[\tmin, \tmax]$ overlap with
+    // the unit bounds, reusing the per-thread memo when this segment chain
+    // has transformed the same ray before
+    Ray ray;
     Float tMin, tMax;
-    if (!b.IntersectP(ray, &tMin, &tMax)) return Spectrum(1.f);
-
-    // Run delta-tracking iterations to sample a medium interaction
-    Float t = tMin;
-    while (true) {
-        t -= std::log(1 - sampler.Get1D()) * invMaxDensity / sigma_t;
-        if (t >= tMax) break;
-        if (Density(ray(t)) * invMaxDensity > sampler.Get1D()) {
-            // Populate _mi_ with medium interaction information and return
-            PhaseFunction *phase = ARENA_ALLOC(arena, HenyeyGreenstein)(g);
-            *mi = MediumInteraction(rWorld(t), -rWorld.d, rWorld.time, this,
-                                    phase);
-            return sigma_s / sigma_t;
+    if (!MediumSpaceRay(rWorld, &ray, &tMin, &tMax)) return Spectrum(1.f);
+
+    // Run delta-tracking iterations per majorant supergrid cell to sample
+    // a medium interaction; each cell tracks at its own local bound, so
+    // rays cross empty space with no density lookups at all
+    Spectrum result(1.f);
+    TraverseMajorantGrid(ray, tMin, tMax, [&](Float t0, Float t1, Float m,
+                                              Float) {
+        if (m <= 0) return true;
+        Float invM = 1 / m;
+        Float t = t0;
+        while (true) {
+            // Draw up to four tentative collisions ahead; their positions
+            // don't depend on the density values, so the lookups can run
+            // as one batch
+            Point3f ps[4];
+            Float ts[4];
+            int nBatch = 0;
+            bool leftCell = false;
+            while (nBatch < 4) {
+                t -= std::log(1 - sampler.Get1D()) * invM / sigma_t;
+                if (t >= t1) {
+                    leftCell = true;
+                    break;
+                }
+                ts[nBatch] = t;
+                ps[nBatch++] = ray(t);
+            }
+            if (nBatch > 0) {
+                for (int i = nBatch; i < 4; ++i) ps[i] = ps[0];
+                Float dens[4];
+                Density4(ps, dens);
+                for (int i = 0; i < nBatch; ++i) {
+                    if (dens[i] * invM > sampler.Get1D()) {
+                        // Populate _mi_ with medium interaction information
+                        // and return
+                        PhaseFunction *phase =
+                            ARENA_ALLOC(arena, HenyeyGreenstein)(g);
+                        *mi = MediumInteraction(rWorld(ts[i]), -rWorld.d,
+                                                rWorld.time, this, phase);
+                        result = sigma_s / sigma_t;
+                        return false;
+                    }
+                }
+            }
+            if (leftCell) return true;
         }
+    });
+    return result;
+}
+
+void GridDensityMedium::InitEmission(const Float *temperature, Float LeScale) {
+    temperatureGrid.assign(temperature, temperature + nx * ny * nz);
+    maxTemperature =
+        *std::max_element(temperatureGrid.begin(), temperatureGrid.end());
+    if (maxTemperature <= 0) {
+        temperatureGrid.clear();
+        return;
     }
-    return Spectrum(1.f);
+    // Precompute the temperature-to-emission table over [0, maxTemperature]
+    PBRT_CONSTEXPR int nLambda = 60;
+    Float lambda[nLambda], v[nLambda];
+    for (int i = 0; i < nLambda; ++i)
+        lambda[i] =
+            Lerp(Float(i) / (nLambda - 1), sampledLambdaStart,
+                 sampledLambdaEnd);
+    emissionLUT.resize(emissionLUTSize);
+    for (int i = 0; i < emissionLUTSize; ++i) {
+        Float T = maxTemperature * Float(i) / (emissionLUTSize - 1);
+        if (T < 100)
+            emissionLUT[i] = Spectrum(0.f);
+        else {
+            BlackbodyNormalized(lambda, nLambda, T, v);
+            emissionLUT[i] = Spectrum::FromSampled(lambda, v, nLambda) *
+                             LeScale;
+        }
+    }
+    // Per-channel sigma_a/sigma_s compensation for Sample() having already
+    // folded sigma_s/sigma_t into the throughput
+    for (int i = 0; i < Spectrum::nSamples; ++i)
+        emissionScale[i] = sigma_s[i] > 0 ? sigma_a[i] / sigma_s[i] : 0;
+}
+
+Float GridDensityMedium::Temperature(const Point3f &p) const {
+    // Compute voxel coordinates and offsets for _p_
+    Point3f pSamples(p.x * nx - .5f, p.y * ny - .5f, p.z * nz - .5f);
+    Point3i pi = (Point3i)Floor(pSamples);
+    Vector3f d = pSamples - (Point3f)pi;
+    auto T = [this](const Point3i &pp) -> Float {
+        Bounds3i sampleBounds(Point3i(0, 0, 0), Point3i(nx, ny, nz));
+        if (!InsideExclusive(pp, sampleBounds)) return 0;
+        return temperatureGrid[(pp.z * ny + pp.y) * nx + pp.x];
+    };
+    // Trilinearly interpolate temperature values
+    Float t00 = Lerp(d.x, T(pi), T(pi + Vector3i(1, 0, 0)));
+    Float t10 = Lerp(d.x, T(pi + Vector3i(0, 1, 0)), T(pi + Vector3i(1, 1, 0)));
+    Float t01 = Lerp(d.x, T(pi + Vector3i(0, 0, 1)), T(pi + Vector3i(1, 0, 1)));
+    Float t11 = Lerp(d.x, T(pi + Vector3i(0, 1, 1)), T(pi + Vector3i(1, 1, 1)));
+    Float t0 = Lerp(d.y, t00, t10);
+    Float t1 = Lerp(d.y, t01, t11);
+    return Lerp(d.z, t0, t1);
+}
+
+Spectrum GridDensityMedium::SampledLe(const MediumInteraction &mi) const {
+    if (temperatureGrid.empty()) return Spectrum(0.f);
+    Float T = Temperature(WorldToMedium(mi.p));
+    if (T <= 0) return Spectrum(0.f);
+    // Interpolate the precomputed blackbody table
+    Float x = Clamp(T / maxTemperature, (Float)0, (Float)1) *
+              (emissionLUTSize - 1);
+    int i0 = (int)x;
+    int i1 = std::min(i0 + 1, emissionLUTSize - 1);
+    return Lerp(x - i0, emissionLUT[i0], emissionLUT[i1]) * emissionScale;
+}
+
+void GridDensityMedium::SparsifyDensity() {
+    // Scan the grid in 8^3 bricks; if at least half of them are entirely
+    // zero, rebuild the density into a two-level brick table and release
+    // the dense array
+    nbx = (nx + 7) / 8;
+    nby = (ny + 7) / 8;
+    nbz = (nz + 7) / 8;
+    int nBricks = nbx * nby * nbz;
+    std::vector<int32_t> index(nBricks, -1);
+    int nOccupied = 0;
+    for (int bz = 0; bz < nbz; ++bz)
+        for (int by = 0; by < nby; ++by)
+            for (int bx = 0; bx < nbx; ++bx) {
+                bool occupied = false;
+                for (int z = bz * 8; z < std::min((bz + 1) * 8, nz) &&
+                                     !occupied; ++z)
+                    for (int y = by * 8; y < std::min((by + 1) * 8, ny) &&
+                                         !occupied; ++y)
+                        for (int x = bx * 8; x < std::min((bx + 1) * 8, nx);
+                             ++x)
+                            if (density[(z * ny + y) * nx + x] != 0) {
+                                occupied = true;
+                                break;
+                            }
+                if (occupied)
+                    // Store the brick's offset into _brickData_ directly
+                    index[bx + nbx * (by + nby * bz)] = 512 * nOccupied++;
+            }
+    if (nOccupied > nBricks / 2) return;
+
+    // Fill the occupied bricks and swap the representations
+    brickData.assign((size_t)nOccupied * 512, 0);
+    for (int bz = 0; bz < nbz; ++bz)
+        for (int by = 0; by < nby; ++by)
+            for (int bx = 0; bx < nbx; ++bx) {
+                int32_t offset = index[bx + nbx * (by + nby * bz)];
+                if (offset < 0) continue;
+                for (int z = bz * 8; z < std::min((bz + 1) * 8, nz); ++z)
+                    for (int y = by * 8; y < std::min((by + 1) * 8, ny); ++y)
+                        for (int x = bx * 8; x < std::min((bx + 1) * 8, nx);
+                             ++x)
+                            brickData[offset + (x & 7) +
+                                      8 * ((y & 7) + 8 * (z & 7))] =
+                                density[(z * ny + y) * nx + x];
+            }
+    brickIndex = std::move(index);
+    densityBytes -= (int64_t)nx * ny * nz * sizeof(Float);
+    densityBytes += brickData.size() * sizeof(Float) +
+                    brickIndex.size() * sizeof(int32_t);
+    density.reset();
+}
+
+void GridDensityMedium::BuildMajorantGrid() {
+    // Use up to 16 cells per axis, clamped to the density grid resolution
+    superRes[0] = std::min(16, nx);
+    superRes[1] = std::min(16, ny);
+    superRes[2] = std::min(16, nz);
+    majorantGrid.resize(superRes[0] * superRes[1] * superRes[2]);
+    minorantGrid.resize(superRes[0] * superRes[1] * superRes[2]);
+    // A cell's majorant must cover every voxel Density() may interpolate
+    // for points inside the cell's continuous extent, so derive the voxel
+    // ranges from the continuous cell bounds in sample space.
+    auto voxelRange = [](int c, int res, int n, int *v0, int *v1) {
+        *v0 = (int)std::floor(Float(c) / res * n - .5f);
+        *v1 = (int)std::floor(Float(c + 1) / res * n - .5f) + 1;
+    };
+    for (int cz = 0; cz < superRes[2]; ++cz)
+        for (int cy = 0; cy < superRes[1]; ++cy)
+            for (int cx = 0; cx < superRes[0]; ++cx) {
+                int x0, x1, y0, y1, z0, z1;
+                voxelRange(cx, superRes[0], nx, &x0, &x1);
+                voxelRange(cy, superRes[1], ny, &y0, &y1);
+                voxelRange(cz, superRes[2], nz, &z0, &z1);
+                Float m = 0, mMin = Infinity;
+                for (int z = z0; z <= z1; ++z)
+                    for (int y = y0; y <= y1; ++y)
+                        for (int x = x0; x <= x1; ++x) {
+                            Float d = D(Point3i(x, y, z));
+                            m = std::max(m, d);
+                            mMin = std::min(mMin, d);
+                        }
+                int cell = cx + superRes[0] * (cy + superRes[1] * cz);
+                majorantGrid[cell] = m;
+                // The minimum over the same voxels bounds the trilinear
+                // interpolation inside the cell from below (interpolated
+                // values are convex combinations of them), making it a
+                // valid residual-tracking control for Tr()
+                minorantGrid[cell] = mMin;
+            }
 }
 
 Spectrum GridDensityMedium::Tr(const Ray &rWorld, Sampler &sampler) const {
     ProfilePhase _(Prof::MediumTr);
     ++nTrCalls;
 
-    Ray ray = WorldToMedium(
-        Ray(rWorld.o, Normalize(rWorld.d), rWorld.tMax * rWorld.d.Length()));
-    // Compute $[\tmin, \tmax]$ interval of _ray_'s overlap with medium bounds
-    const Bounds3f b(Point3f(0, 0, 0), Point3f(1, 1, 1));
+    Ray ray;
     Float tMin, tMax;
-    if (!b.IntersectP(ray, &tMin, &tMax)) return Spectrum(1.f);
-
-    // Perform ratio tracking to estimate the transmittance value
-    Float Tr = 1, t = tMin;
-    while (true) {
-        ++nTrSteps;
-        t -= std::log(1 - sampler.Get1D()) * invMaxDensity / sigma_t;
-        if (t >= tMax) break;
-        Float density = Density(ray(t));
-        Tr *= 1 - std::max((Float)0, density * invMaxDensity);
-        // Added after book publication: when transmittance gets low,
-        // start applying Russian roulette to terminate sampling.
-        const Float rrThreshold = .1;
-        if (Tr < rrThreshold) {
-            Float q = std::max((Float).05, 1 - Tr);
-            if (sampler.Get1D() < q) return 0;
-            Tr /= 1 - q;
+    if (!MediumSpaceRay(rWorld, &ray, &tMin, &tMax)) return Spectrum(1.f);
+
+    // Perform residual ratio tracking per majorant supergrid cell to
+    // estimate the transmittance value: each cell's minimum density is a
+    // control whose transmittance is exact, and the stochastic estimate
+    // only covers the residual above it. Vacuum cells still contribute no
+    // attenuation and cost no density lookups, while dense slowly varying
+    // cells - where the local majorant alone is no better than the global
+    // one - collapse to the analytic control with few or no collisions.
+    Float Tr = 1;
+    TraverseMajorantGrid(ray, tMin, tMax, [&](Float t0, Float t1, Float m,
+                                              Float c) {
+        if (c > 0) Tr *= std::exp(-sigma_t * c * (t1 - t0));
+        Float mResidual = m - c;
+        if (mResidual <= 0) return true;
+        Float invM = 1 / mResidual;
+        Float t = t0;
+        while (true) {
+            // Batch up to four tentative collisions; ratio tracking
+            // consumes every collision's density, so the whole batch feeds
+            // one Density4() call
+            Point3f ps[4];
+            int nBatch = 0;
+            bool leftCell = false;
+            while (nBatch < 4) {
+                t -= std::log(1 - sampler.Get1D()) * invM / sigma_t;
+                if (t >= t1) {
+                    leftCell = true;
+                    break;
+                }
+                ps[nBatch++] = ray(t);
+            }
+            nTrSteps += nBatch;
+            if (nBatch > 0) {
+                for (int i = nBatch; i < 4; ++i) ps[i] = ps[0];
+                Float dens[4];
+                Density4(ps, dens);
+                for (int i = 0; i < nBatch; ++i)
+                    Tr *= 1 - std::max((Float)0, (dens[i] - c) * invM);
+                // Added after book publication: when transmittance gets
+                // low, start applying Russian roulette to terminate
+                // sampling.
+                const Float rrThreshold = .1;
+                if (Tr < rrThreshold) {
+                    Float q = std::max((Float).05, 1 - Tr);
+                    if (sampler.Get1D() < q) {
+                        Tr = 0;
+                        return false;
+                    }
+                    Tr /= 1 - q;
+                }
+            }
+            if (leftCell) return true;
         }
-    }
+    });
     return Spectrum(Tr);
 }
 
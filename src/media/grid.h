@@ -40,6 +40,7 @@
 
 // media/grid.h*
 #include "medium.h"
+#include "memory.h"
 #include "transform.h"
 #include "stats.h"
 
@@ -53,7 +54,8 @@ class GridDensityMedium : public Medium {
     // GridDensityMedium Public Methods
     GridDensityMedium(const Spectrum &sigma_a, const Spectrum &sigma_s, Float g,
                       int nx, int ny, int nz, const Transform &mediumToWorld,
-                      const Float *d)
+                      const Float *d, const Float *temperature = nullptr,
+                      Float LeScale = 1)
         : sigma_a(sigma_a),
           sigma_s(sigma_s),
           g(g),
@@ -63,6 +65,7 @@ class GridDensityMedium : public Medium {
           WorldToMedium(Inverse(mediumToWorld)),
           density(new Float[nx * ny * nz]) {
         densityBytes += nx * ny * nz * sizeof(Float);
+        ParallelFirstTouch(density.get(), sizeof(Float) * nx * ny * nz);
         memcpy((Float *)density.get(), d, sizeof(Float) * nx * ny * nz);
         // Precompute values for Monte Carlo sampling of _GridDensityMedium_
         sigma_t = (sigma_a + sigma_s)[0];
@@ -74,27 +77,106 @@ class GridDensityMedium : public Medium {
         for (int i = 0; i < nx * ny * nz; ++i)
             maxDensity = std::max(maxDensity, density[i]);
         invMaxDensity = 1 / maxDensity;
+        // Build the coarse majorant grid so that tracking in Sample() and
+        // Tr() can step through thin regions at their local density bound
+        // rather than the global maximum
+        BuildMajorantGrid();
+        // Switch to sparse tiled storage when enough bricks are empty for
+        // the two-level table to pay off
+        SparsifyDensity();
+        // Set up blackbody emission from the temperature grid, if provided
+        if (temperature) InitEmission(temperature, LeScale);
     }
 
     Float Density(const Point3f &p) const;
+    void Density4(const Point3f p[4], Float d[4]) const;
+    Spectrum SampledLe(const MediumInteraction &mi) const;
     Float D(const Point3i &p) const {
         Bounds3i sampleBounds(Point3i(0, 0, 0), Point3i(nx, ny, nz));
         if (!InsideExclusive(p, sampleBounds)) return 0;
-        return density[(p.z * ny + p.y) * nx + p.x];
+        if (density) return density[(p.z * ny + p.y) * nx + p.x];
+        // Sparse tiled storage: empty 8^3 bricks are elided entirely
+        int b = (p.x >> 3) + nbx * ((p.y >> 3) + nby * (p.z >> 3));
+        int32_t offset = brickIndex[b];
+        if (offset < 0) return 0;
+        return brickData[offset + (p.x & 7) + 8 * ((p.y & 7) + 8 * (p.z & 7))];
     }
     Spectrum Sample(const Ray &ray, Sampler &sampler, MemoryArena &arena,
-                    MediumInteraction *mi) const;
+                    MediumInteraction *mi,
+                    const Spectrum *beta = nullptr) const;
     Spectrum Tr(const Ray &ray, Sampler &sampler) const;
 
   private:
+    // Transform a world ray into medium space and compute its overlap with
+    // the unit bounds, reusing a per-thread memo of the last transformed
+    // ray; see grid.cpp
+    bool MediumSpaceRay(const Ray &rWorld, Ray *ray, Float *tMin,
+                        Float *tMax) const;
     // GridDensityMedium Private Data
     const Spectrum sigma_a, sigma_s;
     const Float g;
     const int nx, ny, nz;
     const Transform WorldToMedium;
     std::unique_ptr<Float[]> density;
+    // Sparse tiled storage, used in place of _density_ when enough 8^3
+    // bricks are entirely empty; _brickIndex_ holds -1 for elided bricks
+    int nbx = 0, nby = 0, nbz = 0;
+    std::vector<int32_t> brickIndex;
+    std::vector<Float> brickData;
+    void SparsifyDensity();
+    // Blackbody emission from an optional per-voxel temperature grid,
+    // converted through a precomputed temperature-to-spectrum table
+    void InitEmission(const Float *temperature, Float LeScale);
+    Float Temperature(const Point3f &p) const;
+    static PBRT_CONSTEXPR int emissionLUTSize = 128;
+    std::vector<Float> temperatureGrid;
+    std::vector<Spectrum> emissionLUT;
+    Float maxTemperature = 0;
+    Spectrum emissionScale;
     Float sigma_t;
     Float invMaxDensity;
+    // Majorant supergrid: per-cell local density bounds traversed with a
+    // 3D DDA during tracking. The per-cell minimum doubles as Tr()'s
+    // residual-tracking control density; both bounds cover the cell's
+    // full trilinear interpolation support.
+    int superRes[3];
+    std::vector<Float> majorantGrid, minorantGrid;
+    void BuildMajorantGrid();
+    // Walk the supergrid cells crossed by _ray_ (in medium space) over
+    // [tMin, tMax] front to back, invoking _cellFunc(t0, t1, majorant,
+    // minorant)_ for each; traversal stops early when the callback returns
+    // false.
+    template <typename CellFunc>
+    void TraverseMajorantGrid(const Ray &ray, Float tMin, Float tMax,
+                              CellFunc cellFunc) const {
+        Point3f pEnter = ray(tMin);
+        int ci[3], step[3];
+        Float tDelta[3], tNextCross[3];
+        for (int a = 0; a < 3; ++a) {
+            Float w = 1 / Float(superRes[a]);
+            ci[a] = Clamp(int(pEnter[a] * superRes[a]), 0, superRes[a] - 1);
+            step[a] = ray.d[a] >= 0 ? 1 : -1;
+            tDelta[a] = ray.d[a] != 0 ? std::abs(w / ray.d[a]) : Infinity;
+            Float next = (ci[a] + (step[a] > 0 ? 1 : 0)) * w;
+            tNextCross[a] =
+                ray.d[a] != 0 ? tMin + (next - pEnter[a]) / ray.d[a] : Infinity;
+        }
+        Float t0 = tMin;
+        while (true) {
+            int axis = (tNextCross[0] < tNextCross[1])
+                           ? (tNextCross[0] < tNextCross[2] ? 0 : 2)
+                           : (tNextCross[1] < tNextCross[2] ? 1 : 2);
+            Float t1 = std::min(tNextCross[axis], tMax);
+            int cell = ci[0] + superRes[0] * (ci[1] + superRes[1] * ci[2]);
+            if (!cellFunc(t0, t1, majorantGrid[cell], minorantGrid[cell]))
+                return;
+            if (tNextCross[axis] >= tMax) return;
+            t0 = t1;
+            tNextCross[axis] += tDelta[axis];
+            ci[axis] += step[axis];
+            if (ci[axis] < 0 || ci[axis] >= superRes[axis]) return;
+        }
+    }
 };
 
 }  // namespace pbrt
@@ -47,12 +47,28 @@ Spectrum HomogeneousMedium::Tr(const Ray &ray, Sampler &sampler) const {
 }
 
 Spectrum HomogeneousMedium::Sample(const Ray &ray, Sampler &sampler,
-                                   MemoryArena &arena,
-                                   MediumInteraction *mi) const {
+                                   MemoryArena &arena, MediumInteraction *mi,
+                                   const Spectrum *beta) const {
     ProfilePhase _(Prof::MediumSample);
-    // Sample a channel and distance along the ray
-    int channel = std::min((int)(sampler.Get1D() * Spectrum::nSamples),
-                           Spectrum::nSamples - 1);
+    // Select a spectral channel, proportionally to the path throughput
+    // when it is available: channels the path has already attenuated to
+    // nothing are then never chosen, which is the single-sample MIS over
+    // channels with weights matched to the integrand instead of uniform.
+    Float w[Spectrum::nSamples], wSum = 0;
+    for (int i = 0; i < Spectrum::nSamples; ++i) {
+        w[i] = beta ? std::max((Float)0, (*beta)[i]) : (Float)1;
+        wSum += w[i];
+    }
+    if (wSum <= 0) {
+        for (int i = 0; i < Spectrum::nSamples; ++i) w[i] = 1;
+        wSum = Spectrum::nSamples;
+    }
+    Float u = sampler.Get1D() * wSum;
+    int channel = 0;
+    for (; channel < Spectrum::nSamples - 1; ++channel) {
+        if (u < w[channel]) break;
+        u -= w[channel];
+    }
     Float dist = -std::log(1 - sampler.Get1D()) / sigma_t[channel];
     Float t = std::min(dist / ray.d.Length(), ray.tMax);
     bool sampledMedium = t < ray.tMax;
@@ -63,11 +79,12 @@ Spectrum HomogeneousMedium::Sample(const Ray &ray, Sampler &sampler,
     // Compute the transmittance and sampling density
     Spectrum Tr = Exp(-sigma_t * std::min(t, MaxFloat) * ray.d.Length());
 
-    // Return weighting factor for scattering from homogeneous medium
+    // Return weighting factor for scattering from homogeneous medium,
+    // mixing the per-channel densities with the selection weights
     Spectrum density = sampledMedium ? (sigma_t * Tr) : Tr;
     Float pdf = 0;
-    for (int i = 0; i < Spectrum::nSamples; ++i) pdf += density[i];
-    pdf *= 1 / (Float)Spectrum::nSamples;
+    for (int i = 0; i < Spectrum::nSamples; ++i)
+        pdf += (w[i] / wSum) * density[i];
     if (pdf == 0) {
         CHECK(Tr.IsBlack());
         pdf = 1;
@@ -54,7 +54,15 @@ class HomogeneousMedium : public Medium {
           g(g) {}
     Spectrum Tr(const Ray &ray, Sampler &sampler) const;
     Spectrum Sample(const Ray &ray, Sampler &sampler, MemoryArena &arena,
-                    MediumInteraction *mi) const;
+                    MediumInteraction *mi,
+                    const Spectrum *beta = nullptr) const;
+    bool GetHomogeneousCoefficients(Spectrum *sa, Spectrum *ss,
+                                    Float *gOut) const {
+        *sa = sigma_a;
+        *ss = sigma_s;
+        *gOut = g;
+        return true;
+    }
 
   private:
     // HomogeneousMedium Private Data
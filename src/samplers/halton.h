@@ -45,7 +45,7 @@
 namespace pbrt {
 
 // HaltonSampler Declarations
-class HaltonSampler : public GlobalSampler {
+class HaltonSampler final : public GlobalSampler {
   public:
     // HaltonSampler Public Methods
     HaltonSampler(int nsamp, const Bounds2i &sampleBounds,
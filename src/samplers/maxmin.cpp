@@ -42,8 +42,22 @@ namespace pbrt {
 void MaxMinDistSampler::StartPixel(const Point2i &p) {
     ProfilePhase _(Prof::StartPixel);
     Float invSPP = (Float)1 / samplesPerPixel;
-    for (int i = 0; i < samplesPerPixel; ++i)
-        samples2D[0][i] = Point2f(i * invSPP, SampleGeneratorMatrix(CPixel, i));
+    // Enumerate the generator-matrix products in Gray-code order: each
+    // successive index flips a single bit, so the next product is one
+    // column XOR instead of a full MultiplyGenerator() loop per index.
+    // Gray code permutes [0, spp), so every sample slot is filled.
+    uint32_t v = 0;
+    for (int64_t n = 0; n < samplesPerPixel; ++n) {
+        uint32_t index = GrayCode((uint32_t)n);
+#ifndef PBRT_HAVE_HEX_FP_CONSTANTS
+        Float sv = std::min(v * Float(2.3283064365386963e-10),
+                            OneMinusEpsilon);
+#else
+        Float sv = std::min(v * Float(0x1p-32), OneMinusEpsilon);
+#endif
+        samples2D[0][index] = Point2f(index * invSPP, sv);
+        v ^= CPixel[CountTrailingZeros((uint32_t)(n + 1))];
+    }
     Shuffle(&samples2D[0][0], samplesPerPixel, 1, rng);
     // Generate remaining samples for _MaxMinDistSampler_
     for (size_t i = 0; i < samples1D.size(); ++i)
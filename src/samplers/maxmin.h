@@ -53,15 +53,20 @@ class MaxMinDistSampler : public PixelSampler {
     int RoundCount(int count) const { return RoundUpPow2(count); }
     MaxMinDistSampler(int64_t samplesPerPixel, int nSampledDimensions)
         : PixelSampler([](int64_t spp) {
-              int Cindex = Log2Int(spp);
-              if (Cindex >= sizeof(CMaxMinDist) / sizeof(CMaxMinDist[0])) {
+              // The largest precomputed matrix handles 2^(nTables-1)
+              // samples per pixel. Clamp to exactly that power of two:
+              // clamping to one less and then rounding the non-power-of-two
+              // result back up would index past the table.
+              int64_t maxSPP =
+                  (int64_t)1
+                  << (sizeof(CMaxMinDist) / sizeof(CMaxMinDist[0]) - 1);
+              if (spp > maxSPP) {
                   Warning(
-                      "No more than %d samples per pixel are supported with "
+                      "No more than %" PRId64
+                      " samples per pixel are supported with "
                       "MaxMinDistSampler. Rounding down.",
-                      (1 << int(sizeof(CMaxMinDist) / sizeof(CMaxMinDist[0]))) -
-                          1);
-                  spp =
-                      (1 << (sizeof(CMaxMinDist) / sizeof(CMaxMinDist[0]))) - 1;
+                      maxSPP);
+                  spp = maxSPP;
               }
               if (!IsPowerOf2(spp)) {
                   spp = RoundUpPow2(spp);
@@ -0,0 +1,144 @@
+
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+// samplers/owensobol.cpp*
+#include "samplers/owensobol.h"
+#include "lowdiscrepancy.h"
+#include "paramset.h"
+#include "stats.h"
+
+namespace pbrt {
+
+// OwenSobolSampler Utility Functions
+
+// Raw 32-bit Sobol' value for the given index and dimension
+static inline uint32_t SobolBits32(int64_t a, int dimension) {
+    uint32_t v = 0;
+    for (int i = dimension * SobolMatrixSize; a != 0; a >>= 1, i++)
+        if (a & 1) v ^= SobolMatrices32[i];
+    return v;
+}
+
+// Hash-based Owen scrambling (Laine-Karras style): reverse the bits, apply
+// a seeded hash whose per-bit effect only depends on higher-order input
+// bits, and reverse back. Equivalent in distribution to tree-based Owen
+// scrambling, which preserves the sequence's stratification.
+static inline uint32_t OwenScramble(uint32_t v, uint32_t seed) {
+    v = ReverseBits32(v);
+    v ^= v * 0x3d20adea;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56;
+    v ^= v * 0x53a22864;
+    return ReverseBits32(v);
+}
+
+// Per-(pixel, dimension) scramble seed
+static inline uint32_t ScrambleSeed(const Point2i &p, int dim) {
+    uint32_t h = (uint32_t)(p.x * 0x9e3779b1u) ^
+                 (uint32_t)(p.y * 0x85ebca77u) ^ (uint32_t)(dim * 0xc2b2ae3du);
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline Float OwenSobolSample(int64_t index, int sobolDim,
+                                    uint32_t seed) {
+    uint32_t v = OwenScramble(SobolBits32(index, sobolDim), seed);
+#ifndef PBRT_HAVE_HEX_FP_CONSTANTS
+    return std::min(v * Float(2.3283064365386963e-10),
+                    Float(OneMinusEpsilon));
+#else
+    return std::min(v * Float(0x1p-32), Float(OneMinusEpsilon));
+#endif
+}
+
+// OwenSobolSampler Method Definitions
+OwenSobolSampler::OwenSobolSampler(int64_t samplesPerPixel,
+                                   int nSampledDimensions)
+    : PixelSampler(RoundUpPow2(samplesPerPixel), nSampledDimensions) {
+    if (!IsPowerOf2(samplesPerPixel))
+        Warning("Non power-of-two sample count rounded up to %" PRId64
+                " for OwenSobolSampler.",
+                RoundUpPow2(samplesPerPixel));
+}
+
+void OwenSobolSampler::StartPixel(const Point2i &p) {
+    ProfilePhase _(Prof::StartPixel);
+    int dim = 0;
+    for (size_t i = 0; i < samples1D.size(); ++i, ++dim) {
+        uint32_t seed = ScrambleSeed(p, dim);
+        for (int64_t j = 0; j < samplesPerPixel; ++j)
+            samples1D[i][j] = OwenSobolSample(j, 0, seed);
+    }
+    for (size_t i = 0; i < samples2D.size(); ++i, dim += 2) {
+        uint32_t sx = ScrambleSeed(p, dim), sy = ScrambleSeed(p, dim + 1);
+        for (int64_t j = 0; j < samplesPerPixel; ++j)
+            samples2D[i][j] = Point2f(OwenSobolSample(j, 0, sx),
+                                      OwenSobolSample(j, 1, sy));
+    }
+
+    // Generate requested arrays of samples with their own scrambles
+    for (size_t i = 0; i < samples1DArraySizes.size(); ++i, ++dim) {
+        int64_t count = (int64_t)samples1DArraySizes[i] * samplesPerPixel;
+        uint32_t seed = ScrambleSeed(p, dim);
+        for (int64_t j = 0; j < count; ++j)
+            sampleArray1D[i][j] = OwenSobolSample(j, 0, seed);
+    }
+    for (size_t i = 0; i < samples2DArraySizes.size(); ++i, dim += 2) {
+        int64_t count = (int64_t)samples2DArraySizes[i] * samplesPerPixel;
+        uint32_t sx = ScrambleSeed(p, dim), sy = ScrambleSeed(p, dim + 1);
+        for (int64_t j = 0; j < count; ++j)
+            sampleArray2D[i][j] = Point2f(OwenSobolSample(j, 0, sx),
+                                          OwenSobolSample(j, 1, sy));
+    }
+    PixelSampler::StartPixel(p);
+}
+
+std::unique_ptr<Sampler> OwenSobolSampler::Clone(int seed) {
+    OwenSobolSampler *s = new OwenSobolSampler(*this);
+    s->rng.SetSequence(seed);
+    return std::unique_ptr<Sampler>(s);
+}
+
+OwenSobolSampler *CreateOwenSobolSampler(const ParamSet &params) {
+    int nsamp = params.FindOneInt("pixelsamples", 16);
+    int sd = params.FindOneInt("dimensions", 4);
+    if (PbrtOptions.quickRender) nsamp = 1;
+    return new OwenSobolSampler(nsamp, sd);
+}
+
+}  // namespace pbrt
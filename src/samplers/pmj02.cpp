@@ -0,0 +1,166 @@
+
+/*
+    pbrt source code is Copyright(c) 1998-2016
+                        Matt Pharr, Greg Humphreys, and Wenzel Jakob.
+
+    This file is part of pbrt.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are
+    met:
+
+    - Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    - Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+    IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+    TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+    PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+    HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+    LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+    DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+    THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+    OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+// samplers/pmj02.cpp*
+#include "samplers/pmj02.h"
+#include "lowdiscrepancy.h"
+#include "paramset.h"
+#include "parallel.h"
+#include "stats.h"
+#include <array>
+#include <map>
+#include <mutex>
+
+namespace pbrt {
+
+// Progressive stratified sampler in the spirit of pmj02: every pixel draws
+// its samples from a shared, precomputed progressive (0,2)-sequence point
+// table - whose power-of-two prefixes are (0,2)-nets and whose intermediate
+// prefixes remain progressively stratified - decorrelated per pixel and
+// dimension with XOR scrambling, which preserves the elementary-interval
+// structure. Tables are built once (in parallel) per sample count and
+// shared read-only across all of the sampler's clones, and sample counts
+// aren't rounded up to powers of two.
+
+// One canonical table per sample count; built lazily and shared read-only
+static std::mutex tableMutex;
+static std::map<int64_t,
+                std::shared_ptr<const std::vector<std::array<uint32_t, 2>>>>
+    tableCache;
+
+static uint32_t Sobol32Bits(int64_t a, int dim) {
+    uint32_t v = 0;
+    for (int i = dim * SobolMatrixSize; a != 0; a >>= 1, i++)
+        if (a & 1) v ^= SobolMatrices32[i];
+    return v;
+}
+
+static std::shared_ptr<const std::vector<std::array<uint32_t, 2>>>
+GetPointTable(int64_t count) {
+    {
+        std::lock_guard<std::mutex> lock(tableMutex);
+        auto iter = tableCache.find(count);
+        if (iter != tableCache.end()) return iter->second;
+    }
+    // Build the table outside the lock; a racing builder just produces an
+    // identical table and the first insert wins
+    auto table = std::make_shared<std::vector<std::array<uint32_t, 2>>>(count);
+    ParallelFor([&table](int64_t i) {
+        (*table)[i][0] = Sobol32Bits(i, 0);
+        (*table)[i][1] = Sobol32Bits(i, 1);
+    }, count, 1024);
+    std::lock_guard<std::mutex> lock(tableMutex);
+    auto iter = tableCache.find(count);
+    if (iter != tableCache.end()) return iter->second;
+    tableCache[count] = table;
+    return table;
+}
+
+// Deterministic per-(pixel, dimension) scramble bits
+static uint32_t ScrambleBits(const Point2i &p, int dim, int axis) {
+    uint64_t h = (uint64_t)(uint32_t)p.x |
+                 ((uint64_t)(uint32_t)p.y << 32);
+    h ^= (uint64_t)dim * 0x9e3779b97f4a7c15ull + axis * 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return (uint32_t)h;
+}
+
+static Float BitsToSample(uint32_t bits, uint32_t scramble) {
+#ifndef PBRT_HAVE_HEX_FP_CONSTANTS
+    return std::min(Float((bits ^ scramble) * 2.3283064365386963e-10),
+                    OneMinusEpsilon);
+#else
+    return std::min(Float((bits ^ scramble) * 0x1p-32), OneMinusEpsilon);
+#endif
+}
+
+// PMJ02Sampler Method Definitions
+PMJ02Sampler::PMJ02Sampler(int64_t samplesPerPixel, int nSampledDimensions,
+                           bool blueNoise)
+    : PixelSampler(samplesPerPixel, nSampledDimensions, blueNoise) {}
+
+void PMJ02Sampler::StartPixel(const Point2i &p) {
+    ProfilePhase _(Prof::StartPixel);
+    auto table = GetPointTable(samplesPerPixel);
+    int dim = 0;
+    // Fill the per-dimension pixel samples from the shared table
+    for (size_t i = 0; i < samples1D.size(); ++i, ++dim) {
+        uint32_t s = ScrambleBits(p, dim, 0);
+        for (int64_t j = 0; j < samplesPerPixel; ++j)
+            samples1D[i][j] = BitsToSample((*table)[j][0], s);
+    }
+    for (size_t i = 0; i < samples2D.size(); ++i, ++dim) {
+        uint32_t sx = ScrambleBits(p, dim, 0), sy = ScrambleBits(p, dim, 1);
+        for (int64_t j = 0; j < samplesPerPixel; ++j)
+            samples2D[i][j] = Point2f(BitsToSample((*table)[j][0], sx),
+                                      BitsToSample((*table)[j][1], sy));
+    }
+
+    // Fill requested sample arrays from tables of the appropriate size
+    for (size_t i = 0; i < samples1DArraySizes.size(); ++i, ++dim) {
+        int64_t count = (int64_t)samples1DArraySizes[i] * samplesPerPixel;
+        auto arrayTable = GetPointTable(count);
+        uint32_t s = ScrambleBits(p, dim, 0);
+        for (int64_t j = 0; j < count; ++j)
+            sampleArray1D[i][j] = BitsToSample((*arrayTable)[j][0], s);
+    }
+    for (size_t i = 0; i < samples2DArraySizes.size(); ++i, ++dim) {
+        int64_t count = (int64_t)samples2DArraySizes[i] * samplesPerPixel;
+        auto arrayTable = GetPointTable(count);
+        uint32_t sx = ScrambleBits(p, dim, 0), sy = ScrambleBits(p, dim, 1);
+        for (int64_t j = 0; j < count; ++j)
+            sampleArray2D[i][j] = Point2f(BitsToSample((*arrayTable)[j][0], sx),
+                                          BitsToSample((*arrayTable)[j][1], sy));
+    }
+    PixelSampler::StartPixel(p);
+}
+
+std::unique_ptr<Sampler> PMJ02Sampler::Clone(int seed) {
+    PMJ02Sampler *s = new PMJ02Sampler(*this);
+    s->rng.SetSequence(seed);
+    return std::unique_ptr<Sampler>(s);
+}
+
+PMJ02Sampler *CreatePMJ02Sampler(const ParamSet &params) {
+    int nsamp = params.FindOneInt("pixelsamples", 16);
+    int sd = params.FindOneInt("dimensions", 4);
+    bool blueNoise = params.FindOneBool("bluenoise", false);
+    if (PbrtOptions.quickRender) nsamp = 1;
+    return new PMJ02Sampler(nsamp, sd, blueNoise);
+}
+
+}  // namespace pbrt
@@ -62,12 +62,11 @@ std::unique_ptr<Sampler> RandomSampler::Clone(int seed) {
 void RandomSampler::StartPixel(const Point2i &p) {
     ProfilePhase _(Prof::StartPixel);
     for (size_t i = 0; i < sampleArray1D.size(); ++i)
-        for (size_t j = 0; j < sampleArray1D[i].size(); ++j)
-            sampleArray1D[i][j] = rng.UniformFloat();
+        rng.UniformFloatN(&sampleArray1D[i][0], sampleArray1D[i].size());
 
     for (size_t i = 0; i < sampleArray2D.size(); ++i)
-        for (size_t j = 0; j < sampleArray2D[i].size(); ++j)
-            sampleArray2D[i][j] = {rng.UniformFloat(), rng.UniformFloat()};
+        // Point2f is a pair of Floats, so the array fills as one batch
+        rng.UniformFloatN(&sampleArray2D[i][0].x, 2 * sampleArray2D[i].size());
     Sampler::StartPixel(p);
 }
 
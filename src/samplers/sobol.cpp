@@ -44,6 +44,24 @@ int64_t SobolSampler::GetIndexForSample(int64_t sampleNum) const {
                                 Point2i(currentPixel - sampleBounds.pMin));
 }
 
+void SobolSampler::SampleDimensionRange(int64_t index, int dimBegin,
+                                        int dimEnd, Float *v) const {
+#ifdef PBRT_FLOAT_AS_DOUBLE
+    // The bulk kernel uses the 32-bit matrices; keep the double-precision
+    // path's values by falling back to per-dimension sampling
+    GlobalSampler::SampleDimensionRange(index, dimBegin, dimEnd, v);
+#else
+    if (dimEnd > NumSobolDimensions)
+        LOG(FATAL) << StringPrintf("SobolSampler can only sample up to %d "
+                                   "dimensions! Exiting.",
+                                   NumSobolDimensions);
+    // The pixel-sample remapping only applies to dimensions 0 and 1, which
+    // are never part of array dimension ranges
+    CHECK_GE(dimBegin, 2);
+    SobolSampleBulk(index, dimBegin, dimEnd - dimBegin, v);
+#endif
+}
+
 Float SobolSampler::SampleDimension(int64_t index, int dim) const {
     if (dim >= NumSobolDimensions)
         LOG(FATAL) << StringPrintf("SobolSampler can only sample up to %d "
@@ -44,7 +44,7 @@
 namespace pbrt {
 
 // SobolSampler Declarations
-class SobolSampler : public GlobalSampler {
+class SobolSampler final : public GlobalSampler {
   public:
     // SobolSampler Public Methods
     std::unique_ptr<Sampler> Clone(int seed);
@@ -62,6 +62,8 @@ class SobolSampler : public GlobalSampler {
     }
     int64_t GetIndexForSample(int64_t sampleNum) const;
     Float SampleDimension(int64_t index, int dimension) const;
+    void SampleDimensionRange(int64_t index, int dimBegin, int dimEnd,
+                              Float *v) const;
 
   private:
     // SobolSampler Private Data
@@ -81,8 +81,9 @@ StratifiedSampler *CreateStratifiedSampler(const ParamSet &params) {
     int xsamp = params.FindOneInt("xsamples", 4);
     int ysamp = params.FindOneInt("ysamples", 4);
     int sd = params.FindOneInt("dimensions", 4);
+    bool blueNoise = params.FindOneBool("bluenoise", false);
     if (PbrtOptions.quickRender) xsamp = ysamp = 1;
-    return new StratifiedSampler(xsamp, ysamp, jitter, sd);
+    return new StratifiedSampler(xsamp, ysamp, jitter, sd, blueNoise);
 }
 
 }  // namespace pbrt
@@ -49,8 +49,9 @@ class StratifiedSampler : public PixelSampler {
   public:
     // StratifiedSampler Public Methods
     StratifiedSampler(int xPixelSamples, int yPixelSamples, bool jitterSamples,
-                      int nSampledDimensions)
-        : PixelSampler(xPixelSamples * yPixelSamples, nSampledDimensions),
+                      int nSampledDimensions, bool blueNoise = false)
+        : PixelSampler(xPixelSamples * yPixelSamples, nSampledDimensions,
+                       blueNoise),
           xPixelSamples(xPixelSamples),
           yPixelSamples(yPixelSamples),
           jitterSamples(jitterSamples) {}
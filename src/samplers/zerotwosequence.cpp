@@ -41,8 +41,10 @@ namespace pbrt {
 
 // ZeroTwoSequenceSampler Method Definitions
 ZeroTwoSequenceSampler::ZeroTwoSequenceSampler(int64_t samplesPerPixel,
-                                               int nSampledDimensions)
-    : PixelSampler(RoundUpPow2(samplesPerPixel), nSampledDimensions) {
+                                               int nSampledDimensions,
+                                               bool blueNoise)
+    : PixelSampler(RoundUpPow2(samplesPerPixel), nSampledDimensions,
+                   blueNoise) {
     if (!IsPowerOf2(samplesPerPixel))
         Warning(
             "Pixel samples being rounded up to power of 2 "
@@ -77,8 +79,9 @@ std::unique_ptr<Sampler> ZeroTwoSequenceSampler::Clone(int seed) {
 ZeroTwoSequenceSampler *CreateZeroTwoSequenceSampler(const ParamSet &params) {
     int nsamp = params.FindOneInt("pixelsamples", 16);
     int sd = params.FindOneInt("dimensions", 4);
+    bool blueNoise = params.FindOneBool("bluenoise", false);
     if (PbrtOptions.quickRender) nsamp = 1;
-    return new ZeroTwoSequenceSampler(nsamp, sd);
+    return new ZeroTwoSequenceSampler(nsamp, sd, blueNoise);
 }
 
 }  // namespace pbrt
@@ -44,10 +44,11 @@
 namespace pbrt {
 
 // ZeroTwoSequenceSampler Declarations
-class ZeroTwoSequenceSampler : public PixelSampler {
+class ZeroTwoSequenceSampler final : public PixelSampler {
   public:
     // ZeroTwoSequenceSampler Public Methods
-    ZeroTwoSequenceSampler(int64_t samplesPerPixel, int nSampledDimensions = 4);
+    ZeroTwoSequenceSampler(int64_t samplesPerPixel, int nSampledDimensions = 4,
+                           bool blueNoise = false);
     void StartPixel(const Point2i &);
     std::unique_ptr<Sampler> Clone(int seed);
     int RoundCount(int count) const { return RoundUpPow2(count); }
@@ -85,8 +85,9 @@ static Point3f EvalBezier(const Point3f cp[4], Float u,
 
 // Curve Method Definitions
 CurveCommon::CurveCommon(const Point3f c[4], Float width0, Float width1,
-                         CurveType type, const Normal3f *norm)
-    : type(type) {
+                         CurveType type, const Normal3f *norm,
+                         bool cheapShadow)
+    : type(type), cheapShadow(cheapShadow) {
     width[0] = width0;
     width[1] = width1;
     for (int i = 0; i < 4; ++i)
@@ -100,20 +101,34 @@ CurveCommon::CurveCommon(const Point3f c[4], Float width0, Float width1,
     ++nCurves;
 }
 
+// Append the strand's pre-split segments to _curvePool_, which holds every
+// segment of the curve batch contiguously; the pool must have been reserved
+// for the whole batch so that the aliasing shared_ptrs stay valid.
 std::vector<std::shared_ptr<Shape>> CreateCurve(
     const Transform *o2w, const Transform *w2o, bool reverseOrientation,
     const Point3f *c, Float w0, Float w1, CurveType type,
-    const Normal3f *norm, int splitDepth) {
+    const Normal3f *norm, int splitDepth,
+    const std::shared_ptr<std::vector<Curve>> &curvePool,
+    const std::shared_ptr<std::vector<CurveCommon>> &commonPool,
+    bool cheapShadow = false) {
     std::vector<std::shared_ptr<Shape>> segments;
-    std::shared_ptr<CurveCommon> common =
-        std::make_shared<CurveCommon>(c, w0, w1, type, norm);
+    // The strand's CurveCommon lives in the batch pool alongside every
+    // other segment's, referenced through an aliasing shared_ptr - one
+    // allocation and one control block per strand instead of one of each
+    // per basis segment.
+    CHECK_GE(commonPool->capacity(), commonPool->size() + 1);
+    commonPool->emplace_back(c, w0, w1, type, norm, cheapShadow);
+    std::shared_ptr<CurveCommon> common(commonPool, &commonPool->back());
     const int nSegments = 1 << splitDepth;
     segments.reserve(nSegments);
+    CHECK_GE(curvePool->capacity(), curvePool->size() + nSegments);
     for (int i = 0; i < nSegments; ++i) {
         Float uMin = i / (Float)nSegments;
         Float uMax = (i + 1) / (Float)nSegments;
-        segments.push_back(std::make_shared<Curve>(o2w, w2o, reverseOrientation,
-                                                   common, uMin, uMax));
+        curvePool->emplace_back(o2w, w2o, reverseOrientation, common, uMin,
+                                uMax);
+        segments.push_back(
+            std::shared_ptr<Shape>(curvePool, &curvePool->back()));
         ++nSplitCurves;
     }
     curveBytes += sizeof(CurveCommon) + nSegments * sizeof(Curve);
@@ -223,6 +238,12 @@ bool Curve::Intersect(const Ray &r, Float *tHit, SurfaceInteraction *isect,
     // Compute log base 4 by dividing log2 in half.
     int r0 = Log2(1.41421356237f * 6.f * L0 / (8.f * eps)) / 2;
     int maxDepth = Clamp(r0, 0, 10);
+    // Cheap-shadow mode: any-hit queries (isect == nullptr) only need a
+    // binary answer that soft shadows then average, so refine two levels
+    // less - a 4x wider flatness tolerance for roughly half the
+    // subdivision work. Closest-hit rays keep the full tolerance.
+    if (common->cheapShadow && isect == nullptr)
+        maxDepth = std::max(0, maxDepth - 2);
     ReportValue(refinementLevel, maxDepth);
 
     return recursiveIntersect(ray, tHit, isect, cp, Inverse(objectToRay), uMin,
@@ -474,8 +495,16 @@ std::vector<std::shared_ptr<Shape>> CreateCurveShape(const Transform *o2w,
 
     int sd = params.FindOneInt("splitdepth",
                                int(params.FindOneFloat("splitdepth", 3)));
+    bool cheapShadow = params.FindOneBool("cheapshadow", false);
 
     std::vector<std::shared_ptr<Shape>> curves;
+    // Allocate every split segment of this curve batch in one contiguous
+    // block so there is no per-segment heap allocation or control block and
+    // neighboring strands stay adjacent in memory during traversal
+    auto curvePool = std::make_shared<std::vector<Curve>>();
+    curvePool->reserve((size_t)nSegments << sd);
+    auto commonPool = std::make_shared<std::vector<CurveCommon>>();
+    commonPool->reserve(nSegments);
     // Pointer to the first control point for the current segment. This is
     // updated after each loop iteration depending on the current basis.
     const Point3f *cpBase = cp;
@@ -549,7 +578,8 @@ std::vector<std::shared_ptr<Shape>> CreateCurveShape(const Transform *o2w,
         auto c = CreateCurve(o2w, w2o, reverseOrientation, segCpBezier,
                              Lerp(Float(seg) / Float(nSegments), width0, width1),
                              Lerp(Float(seg + 1) / Float(nSegments), width0, width1),
-                             type, n ? &n[seg] : nullptr, sd);
+                             type, n ? &n[seg] : nullptr, sd, curvePool,
+                             commonPool, cheapShadow);
         curves.insert(curves.end(), c.begin(), c.end());
     }
     return curves;
@@ -50,12 +50,15 @@ enum class CurveType { Flat, Cylinder, Ribbon };
 // CurveCommon Declarations
 struct CurveCommon {
     CurveCommon(const Point3f c[4], Float w0, Float w1, CurveType type,
-                const Normal3f *norm);
+                const Normal3f *norm, bool cheapShadow = false);
     const CurveType type;
     Point3f cpObj[4];
     Float width[2];
     Normal3f n[2];
     Float normalAngle, invSinNormalAngle;
+    // "cheapshadow" parameter: any-hit queries refine two levels less than
+    // closest-hit ones; see Curve::Intersect()
+    bool cheapShadow;
 };
 
 // Curve Declarations
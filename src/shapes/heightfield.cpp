@@ -34,10 +34,249 @@
 // shapes/heightfield.cpp*
 #include "shapes/heightfield.h"
 #include "shapes/triangle.h"
+#include "interaction.h"
 #include "paramset.h"
+#include <algorithm>
 
 namespace pbrt {
 
+// Heightfield Local Definitions
+
+// Intersect a ray in heightfield object space with one cell triangle,
+// returning the hit distance and barycentric coordinates of _p1_ and _p2_.
+static bool IntersectHeightfieldTri(const Ray &ray, const Point3f &p0,
+                                    const Point3f &p1, const Point3f &p2,
+                                    Float *tHit, Float *b1, Float *b2) {
+    Vector3f e1 = p1 - p0, e2 = p2 - p0;
+    Vector3f pv = Cross(ray.d, e2);
+    Float det = Dot(e1, pv);
+    if (det == 0) return false;
+    Float invDet = 1 / det;
+    Vector3f tv = ray.o - p0;
+    *b1 = Dot(tv, pv) * invDet;
+    if (*b1 < 0 || *b1 > 1) return false;
+    Vector3f qv = Cross(tv, e1);
+    *b2 = Dot(ray.d, qv) * invDet;
+    if (*b2 < 0 || *b1 + *b2 > 1) return false;
+    Float t = Dot(e2, qv) * invDet;
+    if (t <= 0 || t > ray.tMax) return false;
+    *tHit = t;
+    return true;
+}
+
+// Heightfield grid over (u, v) in [0,1]^2 with per-vertex heights; rays
+// walk the cells with a 2D DDA and intersect each crossed cell's two
+// triangles on the fly, so no triangle mesh or per-triangle BVH storage is
+// ever created.
+class HeightfieldShape : public Shape {
+  public:
+    // HeightfieldShape Public Methods
+    HeightfieldShape(const Transform *ObjectToWorld,
+                     const Transform *WorldToObject, bool reverseOrientation,
+                     int nx, int ny, const Float *zIn)
+        : Shape(ObjectToWorld, WorldToObject, reverseOrientation),
+          nx(nx),
+          ny(ny),
+          z(zIn, zIn + nx * ny),
+          cellZMin((nx - 1) * (ny - 1)),
+          cellZMax((nx - 1) * (ny - 1)) {
+        // Precompute per-cell height ranges for cheap cell rejection
+        for (int y = 0; y < ny - 1; ++y)
+            for (int x = 0; x < nx - 1; ++x) {
+                Float z00 = Height(x, y), z10 = Height(x + 1, y);
+                Float z01 = Height(x, y + 1), z11 = Height(x + 1, y + 1);
+                cellZMin[x + y * (nx - 1)] =
+                    std::min(std::min(z00, z10), std::min(z01, z11));
+                cellZMax[x + y * (nx - 1)] =
+                    std::max(std::max(z00, z10), std::max(z01, z11));
+            }
+        zBounds = Bounds3f(Point3f(0, 0, *std::min_element(z.begin(), z.end())),
+                           Point3f(1, 1, *std::max_element(z.begin(), z.end())));
+    }
+    Bounds3f ObjectBound() const { return zBounds; }
+    bool Intersect(const Ray &r, Float *tHit, SurfaceInteraction *isect,
+                   bool testAlphaTexture = true) const;
+    bool IntersectP(const Ray &r, bool testAlphaTexture = true) const;
+    Float Area() const;
+
+    using Shape::Sample;  // Bring in the other Sample() overload.
+    Interaction Sample(const Point2f &u, Float *pdf) const {
+        LOG(FATAL) << "HeightfieldShape::Sample not implemented.";
+        return Interaction();
+    }
+
+  private:
+    // HeightfieldShape Private Methods
+    Float Height(int x, int y) const { return z[x + y * nx]; }
+    Point3f Vertex(int x, int y) const {
+        return Point3f(x / Float(nx - 1), y / Float(ny - 1), Height(x, y));
+    }
+    bool IntersectCell(const Ray &ray, int x, int y, Float *tHit, Float *b1,
+                       Float *b2, int *tri) const {
+        // Test the two triangles of cell _(x, y)_, keeping the nearer hit
+        bool hit = false;
+        Ray r = ray;
+        Float tb1, tb2;
+        Point3f p00 = Vertex(x, y), p10 = Vertex(x + 1, y);
+        Point3f p11 = Vertex(x + 1, y + 1), p01 = Vertex(x, y + 1);
+        if (IntersectHeightfieldTri(r, p00, p10, p11, tHit, &tb1, &tb2)) {
+            hit = true;
+            r.tMax = *tHit;
+            *b1 = tb1;
+            *b2 = tb2;
+            *tri = 0;
+        }
+        if (IntersectHeightfieldTri(r, p00, p11, p01, tHit, &tb1, &tb2)) {
+            hit = true;
+            *b1 = tb1;
+            *b2 = tb2;
+            *tri = 1;
+        }
+        return hit;
+    }
+    template <typename CellHit>
+    bool Traverse(const Ray &ray, CellHit cellHit) const;
+
+    // HeightfieldShape Private Data
+    const int nx, ny;
+    std::vector<Float> z;
+    std::vector<Float> cellZMin, cellZMax;
+    Bounds3f zBounds;
+};
+
+// Walk the grid cells crossed by _ray_ (already in object space) front to
+// back, invoking _cellHit_ for cells whose height range overlaps the ray's;
+// traversal stops when _cellHit_ returns true.
+template <typename CellHit>
+bool HeightfieldShape::Traverse(const Ray &ray, CellHit cellHit) const {
+    Float tMin, tMax;
+    if (!zBounds.IntersectP(ray, &tMin, &tMax)) return false;
+
+    // Set up 2D DDA over the (u, v) cell grid
+    int nCellsX = nx - 1, nCellsY = ny - 1;
+    Float wx = 1 / Float(nCellsX), wy = 1 / Float(nCellsY);
+    Point3f pEnter = ray(tMin);
+    int ix = Clamp(int(pEnter.x * nCellsX), 0, nCellsX - 1);
+    int iy = Clamp(int(pEnter.y * nCellsY), 0, nCellsY - 1);
+    int stepX = ray.d.x >= 0 ? 1 : -1, stepY = ray.d.y >= 0 ? 1 : -1;
+    Float tDeltaX = ray.d.x != 0 ? std::abs(wx / ray.d.x) : Infinity;
+    Float tDeltaY = ray.d.y != 0 ? std::abs(wy / ray.d.y) : Infinity;
+    Float nextX = (ix + (stepX > 0 ? 1 : 0)) * wx;
+    Float nextY = (iy + (stepY > 0 ? 1 : 0)) * wy;
+    Float tNextX =
+        ray.d.x != 0 ? tMin + (nextX - pEnter.x) / ray.d.x : Infinity;
+    Float tNextY =
+        ray.d.y != 0 ? tMin + (nextY - pEnter.y) / ray.d.y : Infinity;
+
+    Float tCell = tMin;
+    while (true) {
+        // Reject the cell early if the ray's heights over it can't overlap
+        Float tExit = std::min(std::min(tNextX, tNextY), tMax);
+        Float z0 = ray.o.z + tCell * ray.d.z, z1 = ray.o.z + tExit * ray.d.z;
+        int cell = ix + iy * nCellsX;
+        if (std::max(z0, z1) >= cellZMin[cell] &&
+            std::min(z0, z1) <= cellZMax[cell] && cellHit(ix, iy))
+            return true;
+
+        // Advance to the next cell in the DDA
+        if (tNextX < tNextY) {
+            if (tNextX > tMax) break;
+            tCell = tNextX;
+            tNextX += tDeltaX;
+            ix += stepX;
+            if (ix < 0 || ix >= nCellsX) break;
+        } else {
+            if (tNextY > tMax) break;
+            tCell = tNextY;
+            tNextY += tDeltaY;
+            iy += stepY;
+            if (iy < 0 || iy >= nCellsY) break;
+        }
+    }
+    return false;
+}
+
+bool HeightfieldShape::Intersect(const Ray &r, Float *tHit,
+                                 SurfaceInteraction *isect,
+                                 bool testAlphaTexture) const {
+    ProfilePhase p(Prof::ShapeIntersect);
+    // Transform _Ray_ to object space
+    Vector3f oErr, dErr;
+    Ray ray = (*WorldToObject)(r, &oErr, &dErr);
+
+    Float t, b1, b2;
+    int tri, hitX, hitY;
+    if (!Traverse(ray, [&](int x, int y) {
+            if (!IntersectCell(ray, x, y, &t, &b1, &b2, &tri)) return false;
+            hitX = x;
+            hitY = y;
+            return true;
+        }))
+        return false;
+
+    // Initialize _SurfaceInteraction_ for the heightfield cell triangle hit
+    Point3f p0 = Vertex(hitX, hitY);
+    Point3f p1 = tri == 0 ? Vertex(hitX + 1, hitY) : Vertex(hitX + 1, hitY + 1);
+    Point3f p2 =
+        tri == 0 ? Vertex(hitX + 1, hitY + 1) : Vertex(hitX, hitY + 1);
+    Float b0 = 1 - b1 - b2;
+    Point3f pHit = b0 * p0 + b1 * p1 + b2 * p2;
+    // The (u, v) parameterization is the grid plane, so the partials follow
+    // directly from the triangle's edges and uv deltas
+    Point2f uv0(p0.x, p0.y), uv1(p1.x, p1.y), uv2(p2.x, p2.y);
+    Vector2f duv02 = uv0 - uv2, duv12 = uv1 - uv2;
+    Vector3f dp02 = p0 - p2, dp12 = p1 - p2;
+    Float determinant = duv02[0] * duv12[1] - duv02[1] * duv12[0];
+    Vector3f dpdu, dpdv;
+    if (determinant == 0)
+        CoordinateSystem(Normalize(Cross(p2 - p0, p1 - p0)), &dpdu, &dpdv);
+    else {
+        Float invdet = 1 / determinant;
+        dpdu = (duv12[1] * dp02 - duv02[1] * dp12) * invdet;
+        dpdv = (-duv12[0] * dp02 + duv02[0] * dp12) * invdet;
+    }
+    Point2f uvHit(pHit.x, pHit.y);
+    Vector3f pError =
+        gamma(7) * Vector3f(std::abs(b0 * p0.x) + std::abs(b1 * p1.x) +
+                                std::abs(b2 * p2.x),
+                            std::abs(b0 * p0.y) + std::abs(b1 * p1.y) +
+                                std::abs(b2 * p2.y),
+                            std::abs(b0 * p0.z) + std::abs(b1 * p1.z) +
+                                std::abs(b2 * p2.z));
+    *isect = (*ObjectToWorld)(SurfaceInteraction(pHit, pError, uvHit, -ray.d,
+                                                 dpdu, dpdv, Normal3f(0, 0, 0),
+                                                 Normal3f(0, 0, 0), ray.time,
+                                                 this));
+    *tHit = t;
+    return true;
+}
+
+bool HeightfieldShape::IntersectP(const Ray &r, bool testAlphaTexture) const {
+    ProfilePhase p(Prof::ShapeIntersectP);
+    Vector3f oErr, dErr;
+    Ray ray = (*WorldToObject)(r, &oErr, &dErr);
+    Float t, b1, b2;
+    int tri;
+    return Traverse(ray, [&](int x, int y) {
+        return IntersectCell(ray, x, y, &t, &b1, &b2, &tri);
+    });
+}
+
+Float HeightfieldShape::Area() const {
+    // Sum the (world-space) areas of the two triangles of every cell
+    Float area = 0;
+    for (int y = 0; y < ny - 1; ++y)
+        for (int x = 0; x < nx - 1; ++x) {
+            Point3f p00 = (*ObjectToWorld)(Vertex(x, y));
+            Point3f p10 = (*ObjectToWorld)(Vertex(x + 1, y));
+            Point3f p11 = (*ObjectToWorld)(Vertex(x + 1, y + 1));
+            Point3f p01 = (*ObjectToWorld)(Vertex(x, y + 1));
+            area += .5f * Cross(p10 - p00, p11 - p00).Length();
+            area += .5f * Cross(p11 - p00, p01 - p00).Length();
+        }
+    return area;
+}
+
 // Heightfield Definitions
 std::vector<std::shared_ptr<Shape>> CreateHeightfield(
     const Transform *ObjectToWorld, const Transform *WorldToObject,
@@ -49,6 +288,15 @@ std::vector<std::shared_ptr<Shape>> CreateHeightfield(
     CHECK_EQ(nitems, nx * ny);
     CHECK(nx != -1 && ny != -1 && z != nullptr);
 
+    if (!params.FindOneBool("triangulate", false)) {
+        // Use the native grid-traversal shape rather than expanding the
+        // grid into a triangle mesh
+        std::vector<std::shared_ptr<Shape>> shapes;
+        shapes.push_back(std::make_shared<HeightfieldShape>(
+            ObjectToWorld, WorldToObject, reverseOrientation, nx, ny, z));
+        return shapes;
+    }
+
     int ntris = 2 * (nx - 1) * (ny - 1);
     std::unique_ptr<int[]> indices(new int[3 * ntris]);
     std::unique_ptr<Point3f[]> P(new Point3f[nx * ny]);
@@ -34,9 +34,16 @@
 // shapes/loopsubdiv.cpp*
 #include "shapes/loopsubdiv.h"
 #include "shapes/triangle.h"
+#include "accelerators/bvh.h"
+#include "interaction.h"
+#include "parallel.h"
 #include "paramset.h"
-#include <set>
+#include "sampling.h"
+#include "stats.h"
 #include <map>
+#include <mutex>
+#include <numeric>
+#include <set>
 
 namespace pbrt {
 
@@ -237,8 +244,11 @@ static std::vector<std::shared_ptr<Shape>> LoopSubdivide(
 
         // Update vertex positions and create new edge vertices
 
-        // Update vertex positions for even vertices
-        for (SDVertex *vertex : v) {
+        // Update vertex positions for even vertices; each child was
+        // allocated above and only reads the previous level, so the
+        // one-ring computations run in parallel
+        ParallelFor([&](int64_t j) {
+            SDVertex *vertex = v[j];
             if (!vertex->boundary) {
                 // Apply one-ring rule for even vertex
                 if (vertex->regular)
@@ -250,7 +260,7 @@ static std::vector<std::shared_ptr<Shape>> LoopSubdivide(
                 // Apply boundary rule for even vertex
                 vertex->child->p = weightBoundary(vertex, 1.f / 8.f);
             }
-        }
+        }, v.size(), 512);
 
         // Compute new odd edge vertices
         std::map<SDEdge, SDVertex *> edgeVerts;
@@ -288,13 +298,16 @@ static std::vector<std::shared_ptr<Shape>> LoopSubdivide(
         // Update new mesh topology
 
         // Update even vertex face pointers
-        for (SDVertex *vertex : v) {
+        ParallelFor([&](int64_t j) {
+            SDVertex *vertex = v[j];
             int vertNum = vertex->startFace->vnum(vertex);
             vertex->child->startFace = vertex->startFace->children[vertNum];
-        }
+        }, v.size(), 512);
 
-        // Update face neighbor pointers
-        for (SDFace *face : f) {
+        // Update face neighbor pointers; each face writes only its own
+        // children and reads neighbors' already-allocated children
+        ParallelFor([&](int64_t i) {
+            SDFace *face = f[i];
             for (int j = 0; j < 3; ++j) {
                 // Update children _f_ pointers for siblings
                 face->children[3]->f[j] = face->children[NEXT(j)];
@@ -308,22 +321,25 @@ static std::vector<std::shared_ptr<Shape>> LoopSubdivide(
                 face->children[j]->f[PREV(j)] =
                     f2 ? f2->children[f2->vnum(face->v[j])] : nullptr;
             }
-        }
+        }, f.size(), 512);
 
-        // Update face vertex pointers
-        for (SDFace *face : f) {
+        // Update face vertex pointers; _edgeVerts_ is only read here, so
+        // use find() rather than the inserting operator[]
+        ParallelFor([&](int64_t i) {
+            SDFace *face = f[i];
             for (int j = 0; j < 3; ++j) {
                 // Update child vertex pointer to new even vertex
                 face->children[j]->v[j] = face->v[j]->child;
 
                 // Update child vertex pointer to new odd vertex
                 SDVertex *vert =
-                    edgeVerts[SDEdge(face->v[j], face->v[NEXT(j)])];
+                    edgeVerts.find(SDEdge(face->v[j], face->v[NEXT(j)]))
+                        ->second;
                 face->children[j]->v[NEXT(j)] = vert;
                 face->children[NEXT(j)]->v[j] = vert;
                 face->children[3]->v[j] = vert;
             }
-        }
+        }, f.size(), 512);
 
         // Prepare for next level of subdivision
         f = newFaces;
@@ -332,22 +348,21 @@ static std::vector<std::shared_ptr<Shape>> LoopSubdivide(
 
     // Push vertices to limit surface
     std::unique_ptr<Point3f[]> pLimit(new Point3f[v.size()]);
-    for (size_t i = 0; i < v.size(); ++i) {
+    ParallelFor([&](int64_t i) {
         if (v[i]->boundary)
             pLimit[i] = weightBoundary(v[i], 1.f / 5.f);
         else
             pLimit[i] = weightOneRing(v[i], loopGamma(v[i]->valence()));
-    }
+    }, v.size(), 512);
     for (size_t i = 0; i < v.size(); ++i) v[i]->p = pLimit[i];
 
     // Compute vertex tangents on limit surface
-    std::vector<Normal3f> Ns;
-    Ns.reserve(v.size());
-    std::vector<Point3f> pRing(16, Point3f());
-    for (SDVertex *vertex : v) {
+    std::vector<Normal3f> Ns(v.size());
+    ParallelFor([&](int64_t i) {
+        SDVertex *vertex = v[i];
         Vector3f S(0, 0, 0), T(0, 0, 0);
         int valence = vertex->valence();
-        if (valence > (int)pRing.size()) pRing.resize(valence);
+        Point3f *pRing = ALLOCA(Point3f, valence);
         vertex->oneRing(&pRing[0]);
         if (!vertex->boundary) {
             // Compute tangents of interior face
@@ -375,8 +390,8 @@ static std::vector<std::shared_ptr<Shape>> LoopSubdivide(
                 T = -T;
             }
         }
-        Ns.push_back(Normal3f(Cross(S, T)));
-    }
+        Ns[i] = Normal3f(Cross(S, T));
+    }, v.size(), 512);
 
     // Create triangle mesh from subdivision mesh
     {
@@ -399,6 +414,96 @@ static std::vector<std::shared_ptr<Shape>> LoopSubdivide(
     }
 }
 
+STAT_COUNTER("Scene/Lazy subdivision surfaces tessellated",
+             nLazySubdivsTessellated);
+
+// Subdivision surface that stores its control cage and defers the Loop
+// refinement to the first ray that reaches its bounds; the limit surface
+// lies within the convex hull of the cage, so the cage bounds are
+// conservative. Off-screen surfaces are never tessellated.
+class LazySubdivSurface : public Shape {
+  public:
+    // LazySubdivSurface Public Methods
+    LazySubdivSurface(const Transform *ObjectToWorld,
+                      const Transform *WorldToObject, bool reverseOrientation,
+                      int nLevels, std::vector<int> vertexIndices,
+                      std::vector<Point3f> p)
+        : Shape(ObjectToWorld, WorldToObject, reverseOrientation),
+          nLevels(nLevels),
+          vertexIndices(std::move(vertexIndices)),
+          p(std::move(p)) {
+        for (const Point3f &pt : this->p)
+            cageBounds = Union(cageBounds, pt);
+    }
+    Bounds3f ObjectBound() const { return cageBounds; }
+    bool Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
+                   bool testAlphaTexture = true) const {
+        Tessellate();
+        Ray r = ray;
+        if (!tessellated->Intersect(r, isect)) return false;
+        *tHit = r.tMax;
+        return true;
+    }
+    bool IntersectP(const Ray &ray, bool testAlphaTexture = true) const {
+        Tessellate();
+        return tessellated->IntersectP(ray);
+    }
+    Float Area() const {
+        Tessellate();
+        return area;
+    }
+    using Shape::Sample;  // Bring in the other Sample() overload.
+    Interaction Sample(const Point2f &u, Float *pdf) const {
+        Tessellate();
+        // Choose a triangle with probability proportional to its area, then
+        // sample it uniformly; the overall density is uniform over the
+        // surface.
+        Float uRemapped;
+        int index = areaDistrib->SampleDiscrete(u[0], nullptr, &uRemapped);
+        Interaction it = tris[index]->Sample(Point2f(uRemapped, u[1]), pdf);
+        *pdf = 1 / area;
+        return it;
+    }
+
+  private:
+    // LazySubdivSurface Private Methods
+    void Tessellate() const;
+
+    // LazySubdivSurface Private Data
+    const int nLevels;
+    std::vector<int> vertexIndices;
+    std::vector<Point3f> p;
+    Bounds3f cageBounds;
+    mutable std::once_flag tessellateOnce;
+    mutable std::vector<std::shared_ptr<Shape>> tris;
+    mutable std::shared_ptr<Primitive> tessellated;
+    mutable std::unique_ptr<Distribution1D> areaDistrib;
+    mutable Float area = 0;
+};
+
+void LazySubdivSurface::Tessellate() const {
+    std::call_once(tessellateOnce, [this]() {
+        ++nLazySubdivsTessellated;
+        tris = LoopSubdivide(ObjectToWorld, WorldToObject, reverseOrientation,
+                             nLevels, vertexIndices.size(), &vertexIndices[0],
+                             p.size(), &p[0]);
+        // Build an aggregate over the refined triangles for traversal and a
+        // per-triangle area distribution for light sampling
+        std::vector<std::shared_ptr<Primitive>> prims;
+        prims.reserve(tris.size());
+        for (const std::shared_ptr<Shape> &s : tris)
+            prims.push_back(std::make_shared<GeometricPrimitive>(
+                s, nullptr, nullptr, MediumInterface()));
+        tessellated = std::make_shared<BVHAccel>(std::move(prims));
+        std::vector<Float> triAreas;
+        triAreas.reserve(tris.size());
+        for (const std::shared_ptr<Shape> &s : tris)
+            triAreas.push_back(s->Area());
+        area = std::accumulate(triAreas.begin(), triAreas.end(), Float(0));
+        areaDistrib.reset(new Distribution1D(&triAreas[0], triAreas.size()));
+    });
+}
+
 std::vector<std::shared_ptr<Shape>> CreateLoopSubdiv(const Transform *o2w,
                                                      const Transform *w2o,
                                                      bool reverseOrientation,
@@ -419,6 +524,17 @@ std::vector<std::shared_ptr<Shape>> CreateLoopSubdiv(const Transform *o2w,
 
     // don't actually use this for now...
     std::string scheme = params.FindOneString("scheme", "loop");
+
+    if (params.FindOneBool("lazytessellation", true)) {
+        // Keep just the control cage for now; refinement happens on first
+        // ray intersection
+        std::vector<std::shared_ptr<Shape>> shapes;
+        shapes.push_back(std::make_shared<LazySubdivSurface>(
+            o2w, w2o, reverseOrientation, nLevels,
+            std::vector<int>(vertexIndices, vertexIndices + nIndices),
+            std::vector<Point3f>(P, P + nps)));
+        return shapes;
+    }
     return LoopSubdivide(o2w, w2o, reverseOrientation, nLevels, nIndices,
                          vertexIndices, nps, P);
 }
@@ -37,7 +37,10 @@
 #include "paramset.h"
 #include "ext/rply.h"
 
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <sys/stat.h>
 
 namespace pbrt {
 using namespace std;
@@ -77,6 +80,155 @@ void rply_message_callback(p_ply ply, const char *message) {
     Warning("rply: %s", message);
 }
 
+// Binary sidecar cache for parsed PLY contents: a header recording the
+// source file's size and modification time followed by the flat index and
+// vertex attribute arrays, laid out exactly as TriangleMesh consumes them.
+struct PLYCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t floatSize;
+    int64_t sourceMTime;
+    int64_t sourceSize;
+    int32_t nVertices;
+    int32_t nTriangles;
+    int32_t nFaceIndices;
+    uint32_t hasNormals, hasUVs;
+};
+static const char plyCacheMagic[8] = {'P', 'B', 'R', 'T', 'P', 'L', 'Y', '\0'};
+PBRT_CONSTEXPR uint32_t plyCacheVersion = 1;
+
+static bool GetFileMetadata(const std::string &filename, int64_t *mtime,
+                            int64_t *size) {
+#ifdef PBRT_IS_WINDOWS
+    struct _stati64 st;
+    if (_stati64(filename.c_str(), &st) != 0) return false;
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return false;
+#endif
+    *mtime = (int64_t)st.st_mtime;
+    *size = (int64_t)st.st_size;
+    return true;
+}
+
+// Try to load the sidecar cache for _filename_; returns true and fills
+// _context_ only if the cache exists and still matches the source file.
+static bool ReadPLYCache(const std::string &filename, CallbackContext *context,
+                         long *vertexCount, int *nTriangles) {
+    int64_t mtime, size;
+    if (!GetFileMetadata(filename, &mtime, &size)) return false;
+    std::string cacheFilename = filename + ".plybin";
+    FILE *f = fopen(cacheFilename.c_str(), "rb");
+    if (!f) return false;
+    PLYCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              memcmp(header.magic, plyCacheMagic, sizeof(plyCacheMagic)) == 0 &&
+              header.version == plyCacheVersion &&
+              header.floatSize == sizeof(Float) &&
+              header.sourceMTime == mtime && header.sourceSize == size &&
+              header.nVertices > 0 && header.nTriangles > 0 &&
+              (header.nFaceIndices == 0 ||
+               header.nFaceIndices == header.nTriangles);
+    if (ok) {
+        context->indices = new int[3 * header.nTriangles];
+        context->p = new Point3f[header.nVertices];
+        if (header.hasNormals) context->n = new Normal3f[header.nVertices];
+        if (header.hasUVs) context->uv = new Point2f[header.nVertices];
+        if (header.nFaceIndices)
+            context->faceIndices = new int[header.nFaceIndices];
+        ok = fread(context->indices, sizeof(int), 3 * header.nTriangles, f) ==
+                 (size_t)(3 * header.nTriangles) &&
+             fread(context->p, sizeof(Point3f), header.nVertices, f) ==
+                 (size_t)header.nVertices &&
+             (!context->n ||
+              fread(context->n, sizeof(Normal3f), header.nVertices, f) ==
+                  (size_t)header.nVertices) &&
+             (!context->uv ||
+              fread(context->uv, sizeof(Point2f), header.nVertices, f) ==
+                  (size_t)header.nVertices) &&
+             (!context->faceIndices ||
+              fread(context->faceIndices, sizeof(int), header.nFaceIndices,
+                    f) == (size_t)header.nFaceIndices);
+        if (ok) {
+            for (int i = 0; ok && i < 3 * header.nTriangles; ++i)
+                ok = context->indices[i] >= 0 &&
+                     context->indices[i] < header.nVertices;
+        }
+        if (ok) {
+            *vertexCount = header.nVertices;
+            *nTriangles = header.nTriangles;
+            LOG(INFO) << "Loaded PLY cache " << cacheFilename;
+        } else {
+            Warning("Ignoring truncated or corrupt PLY cache file \"%s\".",
+                    cacheFilename.c_str());
+            // Release the partially-filled arrays so the rply parse path
+            // doesn't leak them when it allocates its own
+            delete[] context->indices;
+            delete[] context->p;
+            delete[] context->n;
+            delete[] context->uv;
+            delete[] context->faceIndices;
+            context->indices = nullptr;
+            context->p = nullptr;
+            context->n = nullptr;
+            context->uv = nullptr;
+            context->faceIndices = nullptr;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Write the parsed PLY contents next to the source file, via a temporary
+// so concurrent renders never read a partial cache
+static void WritePLYCache(const std::string &filename,
+                          const CallbackContext &context, long vertexCount,
+                          int nTriangles) {
+    int64_t mtime, size;
+    if (!GetFileMetadata(filename, &mtime, &size)) return;
+    std::string cacheFilename = filename + ".plybin";
+    std::string tmpFilename = cacheFilename + ".tmp";
+    FILE *f = fopen(tmpFilename.c_str(), "wb");
+    if (!f) {
+        // Read-only asset directories are common; don't warn per run.
+        LOG(WARNING) << "Unable to write PLY cache file " << tmpFilename;
+        return;
+    }
+    PLYCacheHeader header = {};
+    memcpy(header.magic, plyCacheMagic, sizeof(plyCacheMagic));
+    header.version = plyCacheVersion;
+    header.floatSize = sizeof(Float);
+    header.sourceMTime = mtime;
+    header.sourceSize = size;
+    header.nVertices = vertexCount;
+    header.nTriangles = nTriangles;
+    header.nFaceIndices = context.faceIndices ? context.faceIndexCtr : 0;
+    header.hasNormals = context.n != nullptr;
+    header.hasUVs = context.uv != nullptr;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(context.indices, sizeof(int), 3 * nTriangles, f) ==
+                  (size_t)(3 * nTriangles) &&
+              fwrite(context.p, sizeof(Point3f), vertexCount, f) ==
+                  (size_t)vertexCount &&
+              (!context.n ||
+               fwrite(context.n, sizeof(Normal3f), vertexCount, f) ==
+                   (size_t)vertexCount) &&
+              (!context.uv ||
+               fwrite(context.uv, sizeof(Point2f), vertexCount, f) ==
+                   (size_t)vertexCount) &&
+              (!context.faceIndices ||
+               fwrite(context.faceIndices, sizeof(int), header.nFaceIndices,
+                      f) == (size_t)header.nFaceIndices);
+    if (fclose(f) != 0) ok = false;
+    if (ok && rename(tmpFilename.c_str(), cacheFilename.c_str()) != 0)
+        ok = false;
+    if (!ok) {
+        Warning("Error writing PLY cache file \"%s\".", cacheFilename.c_str());
+        remove(tmpFilename.c_str());
+    } else
+        LOG(INFO) << "Wrote PLY cache file " << cacheFilename;
+}
+
 /* Callback to handle vertex data from RPly */
 int rply_vertex_callback(p_ply_argument argument) {
     Float **buffers;
@@ -154,20 +306,20 @@ int rply_face_callback(p_ply_argument argument) {
     return 1;
 }
 
-std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
-    const Transform *o2w, const Transform *w2o, bool reverseOrientation,
-    const ParamSet &params,
-    std::map<std::string, std::shared_ptr<Texture<Float>>> *floatTextures) {
-    const std::string filename = params.FindOneFilename("filename", "");
+// Parse _filename_ with rply, filling _context_'s arrays; factored out of
+// CreatePLYMesh() so the binary cache path can bypass it entirely.
+static bool ParsePLYFile(const std::string &filename, CallbackContext *ctx,
+                         long *vertexCountOut) {
+    CallbackContext &context = *ctx;
     p_ply ply = ply_open(filename.c_str(), rply_message_callback, 0, nullptr);
     if (!ply) {
         Error("Couldn't open PLY file \"%s\"", filename.c_str());
-        return std::vector<std::shared_ptr<Shape>>();
+        return false;
     }
 
     if (!ply_read_header(ply)) {
         Error("Unable to read the header of PLY file \"%s\"", filename.c_str());
-        return std::vector<std::shared_ptr<Shape>>();
+        return false;
     }
 
     p_ply_element element = nullptr;
@@ -188,11 +340,9 @@ std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
     if (vertexCount == 0 || faceCount == 0) {
         Error("%s: PLY file is invalid! No face/vertex elements found!",
               filename.c_str());
-        return std::vector<std::shared_ptr<Shape>>();
+        return false;
     }
 
-    CallbackContext context;
-
     if (ply_set_read_cb(ply, "vertex", "x", rply_vertex_callback, &context,
                         0x030) &&
         ply_set_read_cb(ply, "vertex", "y", rply_vertex_callback, &context,
@@ -203,7 +353,7 @@ std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
     } else {
         Error("%s: Vertex coordinate property not found!",
               filename.c_str());
-        return std::vector<std::shared_ptr<Shape>>();
+        return false;
     }
 
     if (ply_set_read_cb(ply, "vertex", "nx", rply_vertex_callback, &context,
@@ -249,12 +399,38 @@ std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
         Error("%s: unable to read the contents of PLY file",
               filename.c_str());
         ply_close(ply);
-        return std::vector<std::shared_ptr<Shape>>();
+        return false;
     }
 
     ply_close(ply);
 
-    if (context.error) return std::vector<std::shared_ptr<Shape>>();
+    if (context.error) return false;
+    *vertexCountOut = vertexCount;
+    return true;
+}
+
+std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
+    const Transform *o2w, const Transform *w2o, bool reverseOrientation,
+    const ParamSet &params,
+    std::map<std::string, std::shared_ptr<Texture<Float>>> *floatTextures) {
+    const std::string filename = params.FindOneFilename("filename", "");
+    bool binaryCache = params.FindOneBool("binarycache", true);
+    CallbackContext context;
+    long vertexCount = 0;
+    int nTriangles = 0;
+    if (binaryCache &&
+        ReadPLYCache(filename, &context, &vertexCount, &nTriangles)) {
+        // Cached arrays are laid out exactly as CreateTriangleMesh consumes
+        // them; nothing else to do
+        context.indexCtr = 3 * nTriangles;
+        context.vertexCount = vertexCount;
+    } else {
+        if (!ParsePLYFile(filename, &context, &vertexCount))
+            return std::vector<std::shared_ptr<Shape>>();
+        nTriangles = context.indexCtr / 3;
+        if (binaryCache)
+            WritePLYCache(filename, context, vertexCount, nTriangles);
+    }
 
     // Look up an alpha texture, if applicable
     std::shared_ptr<Texture<Float>> alphaTex;
@@ -282,11 +458,11 @@ std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
     } else if (params.FindOneFloat("shadowalpha", 1.f) == 0.f)
         shadowAlphaTex.reset(new ConstantTexture<Float>(0.f));
 
-    return CreateTriangleMesh(o2w, w2o, reverseOrientation,
-                              context.indexCtr / 3, context.indices,
-                              vertexCount, context.p, nullptr, context.n,
-                              context.uv, alphaTex, shadowAlphaTex,
-                              context.faceIndices);
+    return CreateTriangleMesh(o2w, w2o, reverseOrientation, nTriangles,
+                              context.indices, vertexCount, context.p, nullptr,
+                              context.n, context.uv, alphaTex, shadowAlphaTex,
+                              context.faceIndices,
+                              params.FindOneBool("quantizeattributes", false));
 }
 
 }  // namespace pbrt
@@ -39,6 +39,8 @@
 #include "efloat.h"
 #include "ext/rply.h"
 #include <array>
+#include <map>
+#include <mutex>
 
 namespace pbrt {
 
@@ -51,12 +53,30 @@ static void PlyErrorCallback(p_ply, const char *message) {
 
 // Triangle Method Definitions
 STAT_RATIO("Scene/Triangles per triangle mesh", nTris, nMeshes);
+// Encode a direction as two 16-bit octahedral components; inverse of
+// OctDecode().
+static uint32_t OctEncode(Vector3f v) {
+    Float d = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if (d == 0) return 0;
+    Float x = v.x / d, y = v.y / d;
+    if (v.z < 0) {
+        Float xo = x;
+        x = (1 - std::abs(y)) * (xo >= 0 ? 1 : -1);
+        y = (1 - std::abs(xo)) * (y >= 0 ? 1 : -1);
+    }
+    uint32_t qx = (uint32_t)Clamp(std::round((x + 1) * .5f * 65535.f), (Float)0,
+                                  (Float)65535);
+    uint32_t qy = (uint32_t)Clamp(std::round((y + 1) * .5f * 65535.f), (Float)0,
+                                  (Float)65535);
+    return qx | (qy << 16);
+}
+
 TriangleMesh::TriangleMesh(
     const Transform &ObjectToWorld, int nTriangles, const int *vertexIndices,
     int nVertices, const Point3f *P, const Vector3f *S, const Normal3f *N,
     const Point2f *UV, const std::shared_ptr<Texture<Float>> &alphaMask,
     const std::shared_ptr<Texture<Float>> &shadowAlphaMask,
-    const int *fIndices)
+    const int *fIndices, bool quantizeAttributes)
     : nTriangles(nTriangles),
       nVertices(nVertices),
       vertexIndices(vertexIndices, vertexIndices + 3 * nTriangles),
@@ -64,48 +84,154 @@ TriangleMesh::TriangleMesh(
       shadowAlphaMask(shadowAlphaMask) {
     ++nMeshes;
     nTris += nTriangles;
-    triMeshBytes += sizeof(*this) + this->vertexIndices.size() * sizeof(int) +
-                    nVertices * (sizeof(*P) + (N ? sizeof(*N) : 0) +
-                                 (S ? sizeof(*S) : 0) + (UV ? sizeof(*UV) : 0) +
-                                 (fIndices ? sizeof(*fIndices) : 0));
+    size_t attrBytes = quantizeAttributes ? sizeof(uint32_t) : 0;
+    triMeshBytes +=
+        sizeof(*this) + this->vertexIndices.size() * sizeof(int) +
+        nVertices *
+            (sizeof(*P) +
+             (N ? (quantizeAttributes ? attrBytes : sizeof(*N)) : 0) +
+             (S ? (quantizeAttributes ? attrBytes : sizeof(*S)) : 0) +
+             (UV ? (quantizeAttributes ? attrBytes : sizeof(*UV)) : 0) +
+             (fIndices ? sizeof(*fIndices) : 0));
 
     // Transform mesh vertices to world space
     p.reset(new Point3f[nVertices]);
-    for (int i = 0; i < nVertices; ++i) p[i] = ObjectToWorld(P[i]);
+    ObjectToWorld.TransformPoints(P, nVertices, p.get());
 
-    // Copy _UV_, _N_, and _S_ vertex data, if present
+    // Copy _UV_, _N_, and _S_ vertex data, if present, quantizing in place
+    // when the mesh was declared with "quantizeattributes"
     if (UV) {
-        uv.reset(new Point2f[nVertices]);
-        memcpy(uv.get(), UV, nVertices * sizeof(Point2f));
+        if (quantizeAttributes) {
+            uvQuantized.reset(new uint32_t[nVertices]);
+            for (int i = 0; i < nVertices; ++i)
+                uvQuantized[i] = uint32_t(FloatToHalf(UV[i].x)) |
+                                 (uint32_t(FloatToHalf(UV[i].y)) << 16);
+        } else {
+            uv.reset(new Point2f[nVertices]);
+            memcpy(uv.get(), UV, nVertices * sizeof(Point2f));
+        }
     }
     if (N) {
-        n.reset(new Normal3f[nVertices]);
-        for (int i = 0; i < nVertices; ++i) n[i] = ObjectToWorld(N[i]);
+        if (quantizeAttributes) {
+            nQuantized.reset(new uint32_t[nVertices]);
+            for (int i = 0; i < nVertices; ++i)
+                nQuantized[i] = OctEncode(Vector3f(ObjectToWorld(N[i])));
+        } else {
+            n.reset(new Normal3f[nVertices]);
+            for (int i = 0; i < nVertices; ++i) n[i] = ObjectToWorld(N[i]);
+        }
     }
     if (S) {
-        s.reset(new Vector3f[nVertices]);
-        for (int i = 0; i < nVertices; ++i) s[i] = ObjectToWorld(S[i]);
+        if (quantizeAttributes) {
+            sQuantized.reset(new uint32_t[nVertices]);
+            for (int i = 0; i < nVertices; ++i)
+                sQuantized[i] = OctEncode(ObjectToWorld(S[i]));
+        } else {
+            s.reset(new Vector3f[nVertices]);
+            for (int i = 0; i < nVertices; ++i) s[i] = ObjectToWorld(S[i]);
+        }
     }
 
     if (fIndices)
         faceIndices = std::vector<int>(fIndices, fIndices + nTriangles);
 }
 
+STAT_COUNTER("Scene/Duplicate triangle meshes deduplicated",
+             nMeshesDeduplicated);
+
+// Cache of created triangle meshes keyed by a content hash of their
+// geometry, transform, and creation flags; exporters that fail to instance
+// byte-identical meshes get deduplicated transparently here. The material
+// lives on the wrapping GeometricPrimitive, so shapes can be shared even
+// across materials.
+struct MeshCacheEntry {
+    int nTriangles, nVertices;
+    std::vector<std::shared_ptr<Shape>> tris;
+};
+static std::mutex meshCacheMutex;
+static std::map<uint64_t, MeshCacheEntry> meshCache;
+
+void ClearTriangleMeshCache() {
+    std::lock_guard<std::mutex> lock(meshCacheMutex);
+    meshCache.clear();
+}
+
+static uint64_t HashMeshInputs(
+    const Transform *ObjectToWorld, bool reverseOrientation, int nTriangles,
+    const int *vertexIndices, int nVertices, const Point3f *p,
+    const Vector3f *s, const Normal3f *n, const Point2f *uv,
+    const Texture<Float> *alphaMask, const Texture<Float> *shadowAlphaMask,
+    const int *faceIndices, bool quantizeAttributes) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const void *ptr, size_t size) {
+        const unsigned char *c = (const unsigned char *)ptr;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= c[i];
+            h *= 1099511628211ull;
+        }
+    };
+    mix(&ObjectToWorld->GetMatrix(), sizeof(Matrix4x4));
+    mix(&reverseOrientation, sizeof(reverseOrientation));
+    mix(&quantizeAttributes, sizeof(quantizeAttributes));
+    mix(&alphaMask, sizeof(alphaMask));
+    mix(&shadowAlphaMask, sizeof(shadowAlphaMask));
+    mix(&nTriangles, sizeof(nTriangles));
+    mix(&nVertices, sizeof(nVertices));
+    mix(vertexIndices, 3 * nTriangles * sizeof(int));
+    mix(p, nVertices * sizeof(Point3f));
+    if (s) mix(s, nVertices * sizeof(Vector3f));
+    if (n) mix(n, nVertices * sizeof(Normal3f));
+    if (uv) mix(uv, nVertices * sizeof(Point2f));
+    if (faceIndices) mix(faceIndices, nTriangles * sizeof(int));
+    return h;
+}
+
 std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(
     const Transform *ObjectToWorld, const Transform *WorldToObject,
     bool reverseOrientation, int nTriangles, const int *vertexIndices,
     int nVertices, const Point3f *p, const Vector3f *s, const Normal3f *n,
     const Point2f *uv, const std::shared_ptr<Texture<Float>> &alphaMask,
     const std::shared_ptr<Texture<Float>> &shadowAlphaMask,
-    const int *faceIndices) {
+    const int *faceIndices, bool quantizeAttributes) {
+    // Return the shapes of a previously created byte-identical mesh, if any
+    uint64_t hash = HashMeshInputs(
+        ObjectToWorld, reverseOrientation, nTriangles, vertexIndices,
+        nVertices, p, s, n, uv, alphaMask.get(), shadowAlphaMask.get(),
+        faceIndices, quantizeAttributes);
+    {
+        std::lock_guard<std::mutex> lock(meshCacheMutex);
+        auto iter = meshCache.find(hash);
+        if (iter != meshCache.end() &&
+            iter->second.nTriangles == nTriangles &&
+            iter->second.nVertices == nVertices) {
+            ++nMeshesDeduplicated;
+            return iter->second.tris;
+        }
+    }
+
     std::shared_ptr<TriangleMesh> mesh = std::make_shared<TriangleMesh>(
         *ObjectToWorld, nTriangles, vertexIndices, nVertices, p, s, n, uv,
-        alphaMask, shadowAlphaMask, faceIndices);
+        alphaMask, shadowAlphaMask, faceIndices, quantizeAttributes);
+    // Allocate all of the mesh's _Triangle_s in one contiguous block and
+    // return shared_ptrs that alias the block, so there is no per-triangle
+    // heap allocation or control block and adjacent triangles stay adjacent
+    // in memory during traversal.
+    std::shared_ptr<std::vector<Triangle>> triangles =
+        std::make_shared<std::vector<Triangle>>();
+    triangles->reserve(nTriangles);
+    for (int i = 0; i < nTriangles; ++i)
+        triangles->emplace_back(ObjectToWorld, WorldToObject,
+                                reverseOrientation, mesh, i);
     std::vector<std::shared_ptr<Shape>> tris;
     tris.reserve(nTriangles);
     for (int i = 0; i < nTriangles; ++i)
-        tris.push_back(std::make_shared<Triangle>(ObjectToWorld, WorldToObject,
-                                                  reverseOrientation, mesh, i));
+        tris.push_back(std::shared_ptr<Shape>(triangles, &(*triangles)[i]));
+
+    // Record the new mesh for later deduplication
+    {
+        std::lock_guard<std::mutex> lock(meshCacheMutex);
+        meshCache[hash] = {nTriangles, nVertices, tris};
+    }
     return tris;
 }
 
@@ -347,13 +473,14 @@ bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
     if (reverseOrientation ^ transformSwapsHandedness)
         isect->n = isect->shading.n = -isect->n;
 
-    if (mesh->n || mesh->s) {
+    if (mesh->HasNormals() || mesh->HasTangents()) {
         // Initialize _Triangle_ shading geometry
 
         // Compute shading normal _ns_ for triangle
         Normal3f ns;
-        if (mesh->n) {
-            ns = (b0 * mesh->n[v[0]] + b1 * mesh->n[v[1]] + b2 * mesh->n[v[2]]);
+        if (mesh->HasNormals()) {
+            ns = (b0 * mesh->NormalAt(v[0]) + b1 * mesh->NormalAt(v[1]) +
+                  b2 * mesh->NormalAt(v[2]));
             if (ns.LengthSquared() > 0)
                 ns = Normalize(ns);
             else
@@ -363,8 +490,9 @@ bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
 
         // Compute shading tangent _ss_ for triangle
         Vector3f ss;
-        if (mesh->s) {
-            ss = (b0 * mesh->s[v[0]] + b1 * mesh->s[v[1]] + b2 * mesh->s[v[2]]);
+        if (mesh->HasTangents()) {
+            ss = (b0 * mesh->TangentAt(v[0]) + b1 * mesh->TangentAt(v[1]) +
+                  b2 * mesh->TangentAt(v[2]));
             if (ss.LengthSquared() > 0)
                 ss = Normalize(ss);
             else
@@ -382,12 +510,12 @@ bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
 
         // Compute $\dndu$ and $\dndv$ for triangle shading geometry
         Normal3f dndu, dndv;
-        if (mesh->n) {
+        if (mesh->HasNormals()) {
             // Compute deltas for triangle partial derivatives of normal
             Vector2f duv02 = uv[0] - uv[2];
             Vector2f duv12 = uv[1] - uv[2];
-            Normal3f dn1 = mesh->n[v[0]] - mesh->n[v[2]];
-            Normal3f dn2 = mesh->n[v[1]] - mesh->n[v[2]];
+            Normal3f dn1 = mesh->NormalAt(v[0]) - mesh->NormalAt(v[2]);
+            Normal3f dn2 = mesh->NormalAt(v[1]) - mesh->NormalAt(v[2]);
             Float determinant = duv02[0] * duv12[1] - duv02[1] * duv12[0];
             bool degenerateUV = std::abs(determinant) < 1e-8;
             if (degenerateUV) {
@@ -397,8 +525,9 @@ bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
                 // (rather than giving up) so that ray differentials for
                 // rays reflected from triangles with degenerate
                 // parameterizations are still reasonable.
-                Vector3f dn = Cross(Vector3f(mesh->n[v[2]] - mesh->n[v[0]]),
-                                    Vector3f(mesh->n[v[1]] - mesh->n[v[0]]));
+                Vector3f dn =
+                    Cross(Vector3f(mesh->NormalAt(v[2]) - mesh->NormalAt(v[0])),
+                          Vector3f(mesh->NormalAt(v[1]) - mesh->NormalAt(v[0])));
                 if (dn.LengthSquared() == 0)
                     dndu = dndv = Normal3f(0, 0, 0);
                 else {
@@ -529,38 +658,23 @@ bool Triangle::IntersectP(const Ray &ray, bool testAlphaTexture) const {
 
     // Test shadow ray intersection against alpha texture, if present
     if (testAlphaTexture && (mesh->alphaMask || mesh->shadowAlphaMask)) {
-        // Compute triangle partial derivatives
-        Vector3f dpdu, dpdv;
+        // Reject bogus intersections with degenerate triangles, as the
+        // primary-hit path does.
+        if (Cross(p2 - p0, p1 - p0).LengthSquared() == 0) return false;
+
+        // Opacity-only evaluation: alpha textures read the hit's position
+        // and (u, v) (plus texture-space differentials, which are zero on
+        // shadow rays regardless), so fill in a minimal interaction
+        // instead of computing partial derivatives and running the full
+        // SurfaceInteraction setup that primary hits need.
         Point2f uv[3];
         GetUVs(uv);
-
-        // Compute deltas for triangle partial derivatives
-        Vector2f duv02 = uv[0] - uv[2], duv12 = uv[1] - uv[2];
-        Vector3f dp02 = p0 - p2, dp12 = p1 - p2;
-        Float determinant = duv02[0] * duv12[1] - duv02[1] * duv12[0];
-        bool degenerateUV = std::abs(determinant) < 1e-8;
-        if (!degenerateUV) {
-            Float invdet = 1 / determinant;
-            dpdu = (duv12[1] * dp02 - duv02[1] * dp12) * invdet;
-            dpdv = (-duv12[0] * dp02 + duv02[0] * dp12) * invdet;
-        }
-        if (degenerateUV || Cross(dpdu, dpdv).LengthSquared() == 0) {
-            // Handle zero determinant for triangle partial derivative matrix
-            Vector3f ng = Cross(p2 - p0, p1 - p0);
-            if (ng.LengthSquared() == 0)
-                // The triangle is actually degenerate; the intersection is
-                // bogus.
-                return false;
-
-            CoordinateSystem(Normalize(Cross(p2 - p0, p1 - p0)), &dpdu, &dpdv);
-        }
-
-        // Interpolate $(u,v)$ parametric coordinates and hit point
-        Point3f pHit = b0 * p0 + b1 * p1 + b2 * p2;
-        Point2f uvHit = b0 * uv[0] + b1 * uv[1] + b2 * uv[2];
-        SurfaceInteraction isectLocal(pHit, Vector3f(0, 0, 0), uvHit, -ray.d,
-                                      dpdu, dpdv, Normal3f(0, 0, 0),
-                                      Normal3f(0, 0, 0), ray.time, this);
+        SurfaceInteraction isectLocal;
+        isectLocal.p = b0 * p0 + b1 * p1 + b2 * p2;
+        isectLocal.uv = b0 * uv[0] + b1 * uv[1] + b2 * uv[2];
+        isectLocal.wo = -ray.d;
+        isectLocal.time = ray.time;
+        isectLocal.shape = this;
         if (mesh->alphaMask && mesh->alphaMask->Evaluate(isectLocal) == 0)
             return false;
         if (mesh->shadowAlphaMask &&
@@ -587,13 +701,17 @@ Interaction Triangle::Sample(const Point2f &u, Float *pdf) const {
     const Point3f &p2 = mesh->p[v[2]];
     Interaction it;
     it.p = b[0] * p0 + b[1] * p1 + (1 - b[0] - b[1]) * p2;
-    // Compute surface normal for sampled point on triangle
-    it.n = Normalize(Normal3f(Cross(p1 - p0, p2 - p0)));
+    // Compute surface normal for sampled point on triangle; the same cross
+    // product yields the area for the pdf below, where Area() used to
+    // recompute it (with a second square root) per sample.
+    Vector3f crossP = Cross(p1 - p0, p2 - p0);
+    Float crossLength = crossP.Length();
+    it.n = Normal3f(crossP / crossLength);
     // Ensure correct orientation of the geometric normal; follow the same
     // approach as was used in Triangle::Intersect().
-    if (mesh->n) {
-        Normal3f ns(b[0] * mesh->n[v[0]] + b[1] * mesh->n[v[1]] +
-                    (1 - b[0] - b[1]) * mesh->n[v[2]]);
+    if (mesh->HasNormals()) {
+        Normal3f ns(b[0] * mesh->NormalAt(v[0]) + b[1] * mesh->NormalAt(v[1]) +
+                    (1 - b[0] - b[1]) * mesh->NormalAt(v[2]));
         it.n = Faceforward(it.n, ns);
     } else if (reverseOrientation ^ transformSwapsHandedness)
         it.n *= -1;
@@ -602,10 +720,117 @@ Interaction Triangle::Sample(const Point2f &u, Float *pdf) const {
     Point3f pAbsSum =
         Abs(b[0] * p0) + Abs(b[1] * p1) + Abs((1 - b[0] - b[1]) * p2);
     it.pError = gamma(6) * Vector3f(pAbsSum.x, pAbsSum.y, pAbsSum.z);
-    *pdf = 1 / Area();
+    *pdf = 2 / crossLength;
     return it;
 }
 
+// Sample a direction toward the spherical triangle subtended by _v_ as
+// seen from _p_, uniformly with respect to solid angle (Arvo 1995);
+// returns a zero vector with _pdf_ zero when the configuration is
+// degenerate.
+static Vector3f SampleSphericalTriangle(const Point3f v[3], const Point3f &p,
+                                        const Point2f &u, Float *pdf) {
+    *pdf = 0;
+    Vector3f a = Normalize(v[0] - p), b = Normalize(v[1] - p),
+             c = Normalize(v[2] - p);
+    Vector3f n_ab = Cross(a, b), n_bc = Cross(b, c), n_ca = Cross(c, a);
+    if (n_ab.LengthSquared() == 0 || n_bc.LengthSquared() == 0 ||
+        n_ca.LengthSquared() == 0)
+        return Vector3f();
+    n_ab = Normalize(n_ab);
+    n_bc = Normalize(n_bc);
+    n_ca = Normalize(n_ca);
+
+    // Compute the interior angles at the spherical triangle's vertices
+    auto angleBetween = [](const Vector3f &v1, const Vector3f &v2) -> Float {
+        if (Dot(v1, v2) < 0)
+            return Pi - 2 * std::asin(Clamp((v1 + v2).Length() / 2,
+                                            (Float)-1, (Float)1));
+        return 2 * std::asin(Clamp((v2 - v1).Length() / 2, (Float)-1,
+                                   (Float)1));
+    };
+    Float alpha = angleBetween(n_ab, -n_ca);
+    Float beta = angleBetween(n_bc, -n_ab);
+    Float gamma = angleBetween(n_ca, -n_bc);
+
+    // Uniformly sample the triangle's spherical area
+    Float A_pi = alpha + beta + gamma;
+    Float A = A_pi - Pi;
+    if (A <= 0) return Vector3f();
+    *pdf = 1 / A;
+    Float Ap_pi = Lerp(u[0], Pi, A_pi);
+
+    // Compute the sub-triangle's third vertex \hat{c} along arc (a, c)
+    Float cosAlpha = std::cos(alpha), sinAlpha = std::sin(alpha);
+    Float sinPhi = std::sin(Ap_pi) * cosAlpha - std::cos(Ap_pi) * sinAlpha;
+    Float cosPhi = std::cos(Ap_pi) * cosAlpha + std::sin(Ap_pi) * sinAlpha;
+    Float k1 = cosPhi + cosAlpha;
+    Float k2 = sinPhi - sinAlpha * Dot(a, b);
+    Float denom = (k2 * sinPhi + k1 * cosPhi) * sinAlpha;
+    if (denom == 0) return Vector3f();
+    Float cosBp =
+        Clamp((k2 + (k2 * cosPhi - k1 * sinPhi) * cosAlpha) / denom,
+              (Float)-1, (Float)1);
+    Float sinBp = std::sqrt(std::max((Float)0, 1 - cosBp * cosBp));
+    auto gramSchmidt = [](const Vector3f &vv, const Vector3f &w) {
+        return vv - Dot(vv, w) * w;
+    };
+    Vector3f perpCA = gramSchmidt(c, a);
+    if (perpCA.LengthSquared() == 0) return Vector3f();
+    Vector3f cp = cosBp * a + sinBp * Normalize(perpCA);
+
+    // Sample along the arc between b and \hat{c}
+    Float cosTheta = 1 - u[1] * (1 - Dot(cp, b));
+    Float sinTheta = std::sqrt(std::max((Float)0, 1 - cosTheta * cosTheta));
+    Vector3f perpCpB = gramSchmidt(cp, b);
+    if (perpCpB.LengthSquared() == 0) return Vector3f();
+    return cosTheta * b + sinTheta * Normalize(perpCpB);
+}
+
+// Below this subtended solid angle, fall back to uniform area sampling,
+// whose variance is fine for small/distant triangles and whose math stays
+// well conditioned.
+static PBRT_CONSTEXPR Float minSphericalSampleArea = 1e-4;
+
+Interaction Triangle::Sample(const Interaction &ref, const Point2f &u,
+                             Float *pdf) const {
+    Float solidAngle = SolidAngle(ref.p);
+    if (solidAngle < minSphericalSampleArea)
+        return Shape::Sample(ref, u, pdf);
+
+    // Sample a direction within the subtended spherical triangle and find
+    // the corresponding surface point
+    Point3f verts[3] = {mesh->p[v[0]], mesh->p[v[1]], mesh->p[v[2]]};
+    Float dirPdf;
+    Vector3f w = SampleSphericalTriangle(verts, ref.p, u, &dirPdf);
+    if (dirPdf == 0) return Shape::Sample(ref, u, pdf);
+    Ray ray = ref.SpawnRay(w);
+    Float tHit;
+    SurfaceInteraction isectLight;
+    if (!Intersect(ray, &tHit, &isectLight, false))
+        return Shape::Sample(ref, u, pdf);
+
+    // Use the Girard-based solid angle so Sample() and Pdf() agree exactly
+    *pdf = 1 / solidAngle;
+    Interaction it;
+    it.p = isectLight.p;
+    it.pError = isectLight.pError;
+    it.n = isectLight.n;
+    it.time = ref.time;
+    return it;
+}
+
+Float Triangle::Pdf(const Interaction &ref, const Vector3f &wi) const {
+    Float solidAngle = SolidAngle(ref.p);
+    if (solidAngle < minSphericalSampleArea) return Shape::Pdf(ref, wi);
+    // Uniform over the subtended solid angle for directions that hit
+    Ray ray = ref.SpawnRay(wi);
+    Float tHit;
+    SurfaceInteraction isectLight;
+    if (!Intersect(ray, &tHit, &isectLight, false)) return 0;
+    return 1 / solidAngle;
+}
+
 Float Triangle::SolidAngle(const Point3f &p, int nSamples) const {
     // Project the vertices into the unit sphere around p.
     std::array<Vector3f, 3> pSphere = {
@@ -738,8 +963,12 @@ std::vector<std::shared_ptr<Shape>> CreateTriangleMeshShape(
     } else if (params.FindOneFloat("shadowalpha", 1.f) == 0.f)
         shadowAlphaTex.reset(new ConstantTexture<Float>(0.f));
 
+    bool quantizeAttributes =
+        params.FindOneBool("quantizeattributes", false);
+
     return CreateTriangleMesh(o2w, w2o, reverseOrientation, nvi / 3, vi, npi, P,
-                              S, N, uvs, alphaTex, shadowAlphaTex, faceIndices);
+                              S, N, uvs, alphaTex, shadowAlphaTex, faceIndices,
+                              quantizeAttributes);
 }
 
 }  // namespace pbrt
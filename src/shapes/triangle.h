@@ -41,12 +41,28 @@
 // shapes/triangle.h*
 #include "shape.h"
 #include "stats.h"
+#include <cstring>
 #include <map>
 
 namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/Triangle meshes", triMeshBytes);
 
+// Triangle Quantized Attribute Utility Functions
+
+// Decode an octahedral-mapped unit vector from two 16-bit components
+inline Vector3f OctDecode(uint32_t q) {
+    Float x = -1 + 2 * Float(q & 0xffff) / 65535.f;
+    Float y = -1 + 2 * Float(q >> 16) / 65535.f;
+    Float z = 1 - std::abs(x) - std::abs(y);
+    if (z < 0) {
+        Float xo = x;
+        x = (1 - std::abs(y)) * (xo >= 0 ? 1 : -1);
+        y = (1 - std::abs(xo)) * (y >= 0 ? 1 : -1);
+    }
+    return Normalize(Vector3f(x, y, z));
+}
+
 // Triangle Declarations
 struct TriangleMesh {
     // TriangleMesh Public Methods
@@ -55,7 +71,25 @@ struct TriangleMesh {
                  const Vector3f *S, const Normal3f *N, const Point2f *uv,
                  const std::shared_ptr<Texture<Float>> &alphaMask,
                  const std::shared_ptr<Texture<Float>> &shadowAlphaMask,
-                 const int *faceIndices);
+                 const int *faceIndices,
+                 bool quantizeAttributes = false);
+    // Attribute accessors that decode quantized storage on the fly when the
+    // mesh was created with _quantizeAttributes_ set
+    bool HasNormals() const { return n != nullptr || nQuantized != nullptr; }
+    bool HasTangents() const { return s != nullptr || sQuantized != nullptr; }
+    bool HasUVs() const { return uv != nullptr || uvQuantized != nullptr; }
+    Normal3f NormalAt(int i) const {
+        return n ? n[i] : Normal3f(OctDecode(nQuantized[i]));
+    }
+    Vector3f TangentAt(int i) const {
+        return s ? s[i] : OctDecode(sQuantized[i]);
+    }
+    Point2f UVAt(int i) const {
+        if (uv) return uv[i];
+        uint32_t q = uvQuantized[i];
+        return Point2f(HalfToFloat(uint16_t(q & 0xffff)),
+                       HalfToFloat(uint16_t(q >> 16)));
+    }
 
     // TriangleMesh Data
     const int nTriangles, nVertices;
@@ -64,6 +98,11 @@ struct TriangleMesh {
     std::unique_ptr<Normal3f[]> n;
     std::unique_ptr<Vector3f[]> s;
     std::unique_ptr<Point2f[]> uv;
+    // Quantized attribute storage: octahedral-encoded normals and tangents,
+    // packed half-precision UVs
+    std::unique_ptr<uint32_t[]> nQuantized;
+    std::unique_ptr<uint32_t[]> sQuantized;
+    std::unique_ptr<uint32_t[]> uvQuantized;
     std::shared_ptr<Texture<Float>> alphaMask, shadowAlphaMask;
     std::vector<int> faceIndices;
 };
@@ -84,10 +123,24 @@ class Triangle : public Shape {
     bool Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
                    bool testAlphaTexture = true) const;
     bool IntersectP(const Ray &ray, bool testAlphaTexture = true) const;
+    bool WorldSpaceTriangle(const Point3f **p0, const Point3f **p1,
+                            const Point3f **p2) const {
+        *p0 = &mesh->p[v[0]];
+        *p1 = &mesh->p[v[1]];
+        *p2 = &mesh->p[v[2]];
+        return true;
+    }
     Float Area() const;
 
     using Shape::Sample;  // Bring in the other Sample() overload.
     Interaction Sample(const Point2f &u, Float *pdf) const;
+    // Sample with respect to solid angle from _ref_ using Arvo's spherical
+    // triangle warp when the subtended solid angle is large enough for
+    // area sampling's inverse-square variance to matter
+    Interaction Sample(const Interaction &ref, const Point2f &u,
+                       Float *pdf) const;
+    using Shape::Pdf;
+    Float Pdf(const Interaction &ref, const Vector3f &wi) const;
 
     // Returns the solid angle subtended by the triangle w.r.t. the given
     // reference point p.
@@ -96,10 +149,10 @@ class Triangle : public Shape {
   private:
     // Triangle Private Methods
     void GetUVs(Point2f uv[3]) const {
-        if (mesh->uv) {
-            uv[0] = mesh->uv[v[0]];
-            uv[1] = mesh->uv[v[1]];
-            uv[2] = mesh->uv[v[2]];
+        if (mesh->HasUVs()) {
+            uv[0] = mesh->UVAt(v[0]);
+            uv[1] = mesh->UVAt(v[1]);
+            uv[2] = mesh->UVAt(v[2]);
         } else {
             uv[0] = Point2f(0, 0);
             uv[1] = Point2f(1, 0);
@@ -119,7 +172,8 @@ std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(
     const Vector3f *s, const Normal3f *n, const Point2f *uv,
     const std::shared_ptr<Texture<Float>> &alphaTexture,
     const std::shared_ptr<Texture<Float>> &shadowAlphaTexture,
-    const int *faceIndices = nullptr);
+    const int *faceIndices = nullptr, bool quantizeAttributes = false);
+void ClearTriangleMeshCache();
 std::vector<std::shared_ptr<Shape>> CreateTriangleMeshShape(
     const Transform *o2w, const Transform *w2o, bool reverseOrientation,
     const ParamSet &params,
@@ -0,0 +1,242 @@
+// tests/bench_kernels.cpp
+//
+// Microbenchmarks for the hot kernels, so optimization work has a
+// before/after number in nanoseconds rather than a scene render. Each
+// benchmark runs a fixed synthetic workload (seeded RNG ray sets and
+// procedural textures/densities), auto-calibrates its iteration count to a
+// minimum wall time, and reports ns per operation:
+//
+//   pbrt_microbench [filter-substring]
+//
+// Built as its own target (pbrt_microbench); not part of pbrt_test since it
+// has its own main().
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "accelerators/bvh.h"
+#include "interpolation.h"
+#include "media/grid.h"
+#include "memory.h"
+#include "mipmap.h"
+#include "paramset.h"
+#include "pbrt.h"
+#include "primitive.h"
+#include "rng.h"
+#include "samplers/random.h"
+#include "sampling.h"
+#include "shapes/triangle.h"
+#include "stats.h"
+#include "transform.h"
+
+using namespace pbrt;
+
+// Accumulator that keeps the optimizer from discarding kernel results.
+static volatile double benchSink;
+
+STAT_COUNTER("Bench/Counter increments", benchStatCounter);
+
+struct Benchmark {
+    const char *name;
+    // Runs the kernel _iters_ times and returns the number of operations
+    // performed (usually == iters).
+    std::function<int64_t(int64_t iters)> fn;
+};
+
+static void RunBenchmark(const Benchmark &b) {
+    using clock = std::chrono::steady_clock;
+    // Calibrate: grow the iteration count until the run takes long enough
+    // to time reliably.
+    int64_t iters = 64;
+    double seconds = 0;
+    int64_t ops = 0;
+    for (;;) {
+        auto start = clock::now();
+        ops = b.fn(iters);
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds >= 0.5 || iters > (int64_t(1) << 40)) break;
+        iters *= 4;
+    }
+    printf("%-40s %12.1f ns/op  (%lld ops in %.2f s)\n", b.name,
+           1e9 * seconds / ops, (long long)ops, seconds);
+}
+
+// Fixed set of rays toward the origin from points on a sphere.
+static std::vector<Ray> MakeRaySet(int n, Float radius) {
+    std::vector<Ray> rays;
+    rays.reserve(n);
+    RNG rng(1234);
+    for (int i = 0; i < n; ++i) {
+        Vector3f d = UniformSampleSphere(
+            Point2f(rng.UniformFloat(), rng.UniformFloat()));
+        Point3f o = Point3f(0, 0, 0) + radius * d;
+        Vector3f jitter(rng.UniformFloat() - .5f, rng.UniformFloat() - .5f,
+                        rng.UniformFloat() - .5f);
+        rays.push_back(Ray(o, Normalize(-d + .3f * jitter)));
+    }
+    return rays;
+}
+
+// A grid of triangles in [-1,1]^2 at z = 0.
+static std::vector<std::shared_ptr<Shape>> MakeTriangleGrid(int n) {
+    static Transform identity;
+    std::vector<Point3f> p;
+    std::vector<int> indices;
+    for (int y = 0; y <= n; ++y)
+        for (int x = 0; x <= n; ++x)
+            p.push_back(Point3f(-1 + 2 * Float(x) / n, -1 + 2 * Float(y) / n,
+                                0));
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x) {
+            int v00 = y * (n + 1) + x, v10 = v00 + 1;
+            int v01 = v00 + (n + 1), v11 = v01 + 1;
+            int tri[6] = {v00, v10, v11, v00, v11, v01};
+            indices.insert(indices.end(), tri, tri + 6);
+        }
+    return CreateTriangleMesh(&identity, &identity, false,
+                              (int)indices.size() / 3, indices.data(),
+                              (int)p.size(), p.data(), nullptr, nullptr,
+                              nullptr, nullptr, nullptr);
+}
+
+int main(int argc, char *argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = 1;
+    const char *filter = argc > 1 ? argv[1] : nullptr;
+
+    std::vector<Benchmark> benchmarks;
+
+    // Triangle::Intersect
+    auto triangles = MakeTriangleGrid(16);
+    auto triRays = MakeRaySet(1024, 4);
+    benchmarks.push_back({"Triangle::Intersect", [&](int64_t iters) {
+        int64_t ops = 0;
+        for (int64_t i = 0; i < iters; ++i) {
+            const Ray &r = triRays[i % triRays.size()];
+            Ray ray(r.o, r.d);
+            Float tHit;
+            SurfaceInteraction isect;
+            benchSink +=
+                triangles[i % triangles.size()]->Intersect(ray, &tHit, &isect);
+            ++ops;
+        }
+        return ops;
+    }});
+
+    // BVHAccel::IntersectP over the triangle grid
+    std::vector<std::shared_ptr<Primitive>> prims;
+    for (const auto &tri : triangles)
+        prims.push_back(std::make_shared<GeometricPrimitive>(
+            tri, nullptr, nullptr, MediumInterface()));
+    std::shared_ptr<Primitive> bvh = CreateBVHAccelerator(prims, ParamSet());
+    auto bvhRays = MakeRaySet(1024, 4);
+    benchmarks.push_back({"BVHAccel::IntersectP", [&](int64_t iters) {
+        int64_t ops = 0;
+        for (int64_t i = 0; i < iters; ++i) {
+            const Ray &r = bvhRays[i % bvhRays.size()];
+            Ray ray(r.o, r.d);
+            benchSink += bvh->IntersectP(ray);
+            ++ops;
+        }
+        return ops;
+    }});
+
+    // MIPMap::Lookup (EWA)
+    Point2i texRes(256, 256);
+    std::vector<RGBSpectrum> texels(texRes.x * texRes.y);
+    for (int i = 0; i < texRes.x * texRes.y; ++i)
+        texels[i] = RGBSpectrum(Float(i % 97) / 97);
+    MIPMap<RGBSpectrum> mipmap(texRes, texels.data());
+    benchmarks.push_back({"MIPMap::EWA", [&](int64_t iters) {
+        RNG rng(7);
+        int64_t ops = 0;
+        for (int64_t i = 0; i < iters; ++i) {
+            Point2f st(rng.UniformFloat(), rng.UniformFloat());
+            Vector2f dst0(.01f * rng.UniformFloat(), .002f),
+                dst1(.001f, .02f * rng.UniformFloat());
+            benchSink += mipmap.Lookup(st, dst0, dst1).y();
+            ++ops;
+        }
+        return ops;
+    }});
+
+    // Distribution2D::SampleContinuous
+    int distRes = 256;
+    std::vector<Float> func(distRes * distRes);
+    for (int i = 0; i < distRes * distRes; ++i)
+        func[i] = 1 + (i * 2654435761u % 64);
+    Distribution2D distrib(func.data(), distRes, distRes);
+    benchmarks.push_back({"Distribution2D::SampleContinuous",
+                          [&](int64_t iters) {
+        RNG rng(13);
+        int64_t ops = 0;
+        for (int64_t i = 0; i < iters; ++i) {
+            Float pdf;
+            Point2f u(rng.UniformFloat(), rng.UniformFloat());
+            benchSink += distrib.SampleContinuous(u, &pdf).x;
+            ++ops;
+        }
+        return ops;
+    }});
+
+    // GridDensityMedium::Sample
+    int gridRes = 64;
+    std::vector<Float> density(gridRes * gridRes * gridRes);
+    for (size_t i = 0; i < density.size(); ++i)
+        density[i] = Float(i % 31) / 31;
+    Transform mediumToWorld =
+        Translate(Vector3f(-1, -1, -1)) * Scale(2, 2, 2);
+    GridDensityMedium medium(Spectrum(.2f), Spectrum(.8f), 0, gridRes,
+                             gridRes, gridRes, mediumToWorld, density.data());
+    auto mediumRays = MakeRaySet(1024, 2);
+    benchmarks.push_back({"GridDensityMedium::Sample", [&](int64_t iters) {
+        RandomSampler sampler(1, 0);
+        sampler.StartPixel(Point2i(0, 0));
+        MemoryArena arena;
+        int64_t ops = 0;
+        for (int64_t i = 0; i < iters; ++i) {
+            Ray ray = mediumRays[i % mediumRays.size()];
+            ray.tMax = 4;
+            MediumInteraction mi;
+            benchSink += medium.Sample(ray, sampler, arena, &mi).y();
+            arena.Reset();
+            ++ops;
+        }
+        return ops;
+    }});
+
+    // Statistics counter hot path: verifies that leaving --stats enabled
+    // costs a single thread-local increment per event (the merge and
+    // registration machinery only runs at thread exit), so production
+    // renders can keep telemetry on.
+    benchmarks.push_back({"STAT_COUNTER increment", [&](int64_t iters) {
+        for (int64_t i = 0; i < iters; ++i) ++benchStatCounter;
+        benchSink += (double)benchStatCounter;
+        return iters;
+    }});
+
+    // Fourier series evaluation
+    std::vector<Float> ak(64);
+    RNG akRng(3);
+    for (size_t i = 0; i < ak.size(); ++i)
+        ak[i] = akRng.UniformFloat() / (1 + i);
+    benchmarks.push_back({"Fourier", [&](int64_t iters) {
+        RNG rng(5);
+        int64_t ops = 0;
+        for (int64_t i = 0; i < iters; ++i) {
+            benchSink += Fourier(ak.data(), (int)ak.size(),
+                                 -1 + 2 * rng.UniformFloat());
+            ++ops;
+        }
+        return ops;
+    }});
+
+    for (const Benchmark &b : benchmarks)
+        if (!filter || strstr(b.name, filter)) RunBenchmark(b);
+    return 0;
+}
@@ -0,0 +1,93 @@
+
+#include "tests/gtest/gtest.h"
+#include "pbrt.h"
+#include "accelerators/bvh.h"
+#include "paramset.h"
+#include "primitive.h"
+#include "rng.h"
+#include "sampling.h"
+#include "shapes/triangle.h"
+#include "transform.h"
+
+using namespace pbrt;
+
+// The BVH leaf loops pre-filter batches of four triangles with a
+// conservative SIMD slope test before running the watertight
+// Triangle::Intersect()/IntersectP(); its epsilon margins are load-bearing
+// for correctness, so these tests check on randomized geometry that
+// traversal through the filter agrees exactly with testing every triangle
+// directly.
+
+static std::vector<std::shared_ptr<Shape>> RandomTriangles(RNG &rng, int n,
+                                                           Float extent,
+                                                           Float triScale) {
+    static Transform identity;
+    std::vector<Point3f> p;
+    std::vector<int> indices;
+    auto u = [&rng]() { return 2 * rng.UniformFloat() - 1; };
+    for (int i = 0; i < n; ++i) {
+        Point3f base(extent * u(), extent * u(), extent * u());
+        for (int v = 0; v < 3; ++v) {
+            indices.push_back(3 * i + v);
+            p.push_back(base + triScale * Vector3f(u(), u(), u()));
+        }
+    }
+    return CreateTriangleMesh(&identity, &identity, false, n, indices.data(),
+                              3 * n, p.data(), nullptr, nullptr, nullptr,
+                              nullptr, nullptr);
+}
+
+TEST(BVHPrefilter, MatchesDirectIntersection) {
+    RNG rng(60522);
+    // Two regimes: large mutually overlapping triangles (deep leaves, many
+    // grazing hits near batch epsilon margins) and small scattered ones
+    for (Float triScale : {Float(2), Float(.25)}) {
+        std::vector<std::shared_ptr<Shape>> tris =
+            RandomTriangles(rng, 200, 4, triScale);
+        std::vector<std::shared_ptr<Primitive>> prims;
+        for (const auto &tr : tris)
+            prims.push_back(std::make_shared<GeometricPrimitive>(
+                tr, nullptr, nullptr, MediumInterface()));
+        std::shared_ptr<BVHAccel> bvh =
+            CreateBVHAccelerator(prims, ParamSet());
+
+        for (int i = 0; i < 4000; ++i) {
+            Point3f o(8 * (2 * rng.UniformFloat() - 1),
+                      8 * (2 * rng.UniformFloat() - 1),
+                      8 * (2 * rng.UniformFloat() - 1));
+            Vector3f d = UniformSampleSphere(
+                Point2f(rng.UniformFloat(), rng.UniformFloat()));
+
+            // Closest hit by testing every triangle directly, updating
+            // tMax the way GeometricPrimitive::Intersect() does
+            Ray rDirect(o, d);
+            bool hitDirect = false;
+            for (const auto &tr : tris) {
+                Float tHit;
+                SurfaceInteraction isect;
+                if (tr->Intersect(rDirect, &tHit, &isect)) {
+                    hitDirect = true;
+                    rDirect.tMax = tHit;
+                }
+            }
+
+            Ray rBVH(o, d);
+            SurfaceInteraction isectBVH;
+            bool hitBVH = bvh->Intersect(rBVH, &isectBVH);
+            EXPECT_EQ(hitDirect, hitBVH) << "ray " << i;
+            if (hitDirect && hitBVH)
+                EXPECT_FLOAT_EQ(rDirect.tMax, rBVH.tMax) << "ray " << i;
+
+            // Any-hit agreement for the shadow-ray batch path
+            bool pDirect = false;
+            Ray rp(o, d);
+            for (const auto &tr : tris)
+                if (tr->IntersectP(rp)) {
+                    pDirect = true;
+                    break;
+                }
+            Ray rpBVH(o, d);
+            EXPECT_EQ(pDirect, bvh->IntersectP(rpBVH)) << "ray " << i;
+        }
+    }
+}
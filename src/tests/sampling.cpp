@@ -4,6 +4,7 @@
 #include <algorithm>
 #include "pbrt.h"
 #include "rng.h"
+#include "parallel.h"
 #include "sampling.h"
 #include "lowdiscrepancy.h"
 #include "samplers/maxmin.h"
@@ -19,6 +20,75 @@ TEST(LowDiscrepancy, RadicalInverse) {
     }
 }
 
+// The block-table fast paths in RadicalInverse() and
+// ScrambledRadicalInverse() must agree with the per-digit reference
+// recurrences; block sums may round differently in the last float ulp.
+static Float RadicalInverseReference(int base, uint64_t a) {
+    Float invBase = (Float)1 / (Float)base, invBaseN = 1;
+    uint64_t reversedDigits = 0;
+    while (a) {
+        uint64_t next = a / base;
+        reversedDigits = reversedDigits * base + (a - next * base);
+        invBaseN *= invBase;
+        a = next;
+    }
+    return std::min(reversedDigits * invBaseN, OneMinusEpsilon);
+}
+
+static Float ScrambledRadicalInverseReference(int base, const uint16_t *perm,
+                                              uint64_t a) {
+    Float invBase = (Float)1 / (Float)base, invBaseN = 1;
+    uint64_t reversedDigits = 0;
+    while (a) {
+        uint64_t next = a / base;
+        reversedDigits = reversedDigits * base + perm[a - next * base];
+        invBaseN *= invBase;
+        a = next;
+    }
+    return std::min(
+        invBaseN * (reversedDigits + invBase * perm[0] / (1 - invBase)),
+        OneMinusEpsilon);
+}
+
+TEST(LowDiscrepancy, TabulatedRadicalInverse) {
+    RNG rng;
+    for (int dim = 1; dim < 256; ++dim) {
+        for (int i = 0; i < 512; ++i) {
+            uint64_t a = rng.UniformUInt32() |
+                         ((uint64_t)(rng.UniformUInt32() & 0x3f) << 32);
+            Float tabulated = RadicalInverse(dim, a);
+            Float reference = RadicalInverseReference(Primes[dim], a);
+            EXPECT_NEAR(tabulated, reference, 2e-6)
+                << "dim " << dim << ", a " << a;
+        }
+        // Exercise block-boundary and zero indices explicitly
+        for (uint64_t a : {0ull, 1ull, 4095ull, 4096ull, 4097ull})
+            EXPECT_NEAR(RadicalInverse(dim, a),
+                        RadicalInverseReference(Primes[dim], a), 2e-6);
+    }
+}
+
+TEST(LowDiscrepancy, TabulatedScrambledRadicalInverse) {
+    RNG rng;
+    std::vector<uint16_t> perms = ComputeRadicalInversePermutations(rng);
+    for (int dim = 1; dim < 256; ++dim) {
+        const uint16_t *perm = &perms[PrimeSums[dim]];
+        for (int i = 0; i < 512; ++i) {
+            uint64_t a = rng.UniformUInt32() |
+                         ((uint64_t)(rng.UniformUInt32() & 0x3f) << 32);
+            Float tabulated = ScrambledRadicalInverse(dim, a, perm);
+            Float reference =
+                ScrambledRadicalInverseReference(Primes[dim], perm, a);
+            EXPECT_NEAR(tabulated, reference, 2e-6)
+                << "dim " << dim << ", a " << a;
+        }
+        // The a = 0 case is the pure scrambled-zero tail
+        EXPECT_NEAR(ScrambledRadicalInverse(dim, 0, perm),
+                    ScrambledRadicalInverseReference(Primes[dim], perm, 0),
+                    2e-6);
+    }
+}
+
 TEST(LowDiscrepancy, ScrambledRadicalInverse) {
     for (int dim = 0; dim < 128; ++dim) {
         RNG rng(dim);
@@ -301,3 +371,91 @@ TEST(Distribution1D, Continuous) {
     EXPECT_FLOAT_EQ(0., dist.SampleContinuous(0., &pdf));
     EXPECT_FLOAT_EQ(1., dist.SampleContinuous(1., &pdf));
 }
+
+TEST(Distribution2D, HierarchicalWarpPdf) {
+    ParallelInit();
+
+    RNG rng(59);
+    // A non-power-of-two resolution exercises the warp's zero padding;
+    // zeroed texels check that padding and dead regions are never sampled
+    const int nu = 13, nv = 7;
+    std::vector<Float> func(nu * nv);
+    for (Float &f : func)
+        f = rng.UniformFloat() < .25 ? 0 : rng.UniformFloat();
+    Distribution2D dist(func.data(), nu, nv);
+    dist.BuildHierarchicalWarp();
+
+    std::vector<int> count(nu * nv, 0);
+    const int n = 1 << 20;
+    for (int i = 0; i < n; ++i) {
+        Float pdf;
+        Point2f u(rng.UniformFloat(), rng.UniformFloat());
+        Point2f p = dist.SampleContinuous(u, &pdf);
+        ASSERT_TRUE(p.x >= 0 && p.x < 1 && p.y >= 0 && p.y < 1);
+        int iu = int(p.x * nu), iv = int(p.y * nv);
+        ++count[iu + nu * iv];
+        // The sampled density must match Pdf() texel-for-texel. Skip
+        // samples within float slop of a texel boundary, where Pdf()'s
+        // round-trip through the [0,1)^2 mapping can land in the
+        // neighboring texel.
+        Float fu = p.x * nu - iu, fv = p.y * nv - iv;
+        if (fu < 1e-4 || fu > 1 - 1e-4 || fv < 1e-4 || fv > 1 - 1e-4)
+            continue;
+        EXPECT_FLOAT_EQ(dist.Pdf(p), pdf) << "sample " << i;
+    }
+
+    // The per-texel sample counts must follow the function: zero-valued
+    // texels are never chosen, the rest land within 5 sigma of their
+    // expected share
+    Float funcSum = 0;
+    for (Float f : func) funcSum += f;
+    for (int t = 0; t < nu * nv; ++t) {
+        if (func[t] == 0) {
+            EXPECT_EQ(0, count[t]) << "texel " << t;
+        } else {
+            Float expected = n * func[t] / funcSum;
+            EXPECT_NEAR(count[t], expected, 5 * std::sqrt(expected) + 1)
+                << "texel " << t;
+        }
+    }
+
+    ParallelCleanup();
+}
+
+TEST(Distribution2D, HierarchicalWarpMatchesCDFSampling) {
+    ParallelInit();
+
+    RNG rng(60);
+    const int nu = 16, nv = 16;
+    std::vector<Float> func(nu * nv);
+    for (Float &f : func) f = rng.UniformFloat();
+    // The same function, sampled through the hierarchical warp and
+    // through the conditional/marginal CDF inversions
+    Distribution2D warp(func.data(), nu, nv);
+    warp.BuildHierarchicalWarp();
+    Distribution2D cdf(func.data(), nu, nv);
+
+    std::vector<int> countWarp(nu * nv, 0), countCdf(nu * nv, 0);
+    const int n = 1 << 20;
+    for (int i = 0; i < n; ++i) {
+        Float pdf;
+        Point2f u(rng.UniformFloat(), rng.UniformFloat());
+        Point2f pw = warp.SampleContinuous(u, &pdf);
+        ++countWarp[std::min(int(pw.x * nu), nu - 1) +
+                    nu * std::min(int(pw.y * nv), nv - 1)];
+        // The CDF inversion can return exactly 1 after rounding, so clamp
+        // into the last texel
+        Point2f pc = cdf.SampleContinuous(u, &pdf);
+        ++countCdf[std::min(int(pc.x * nu), nu - 1) +
+                   nu * std::min(int(pc.y * nv), nv - 1)];
+    }
+    // The two samplers place any given u differently but must produce the
+    // same distribution over texels
+    for (int t = 0; t < nu * nv; ++t) {
+        Float expected = .5f * (countWarp[t] + countCdf[t]);
+        EXPECT_NEAR(countWarp[t], countCdf[t], 6 * std::sqrt(expected) + 2)
+            << "texel " << t;
+    }
+
+    ParallelCleanup();
+}
@@ -100,6 +100,23 @@ class Checkerboard2DTexture : public Texture<T> {
         }
     }
 
+    void EvaluateN(const SurfaceInteraction *si, int n, T *out) const {
+        // The closed-form filtered path is inherently per-point; batch the
+        // point-sampled path, delegating each point to the selected child
+        if (aaMethod != AAMethod::None) {
+            for (int i = 0; i < n; ++i) out[i] = Evaluate(si[i]);
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            Vector2f dstdx, dstdy;
+            Point2f st = mapping->Map(si[i], &dstdx, &dstdy);
+            if (((int)std::floor(st[0]) + (int)std::floor(st[1])) % 2 == 0)
+                out[i] = tex1->Evaluate(si[i]);
+            else
+                out[i] = tex2->Evaluate(si[i]);
+        }
+    }
+
   private:
     // Checkerboard2DTexture Private Data
     std::unique_ptr<TextureMapping2D> mapping;
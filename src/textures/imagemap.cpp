@@ -33,38 +33,244 @@
 
 // textures/imagemap.cpp*
 #include "textures/imagemap.h"
+#include "fileutil.h"
 #include "imageio.h"
+#include "parallel.h"
+#include "stringprint.h"
 #include "stats.h"
+#include <type_traits>
 
 namespace pbrt {
 
+
+// Content-hash texture sharing and the persistent converted-texel cache,
+// both enabled by --texcachedir: byte-identical source images under
+// different paths share one mipmap, and converted texel data is reused
+// across runs from <dir>/tex-<hash>.bin files.
+namespace {
+struct TexCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t floatSize;
+    uint32_t nChannels;
+    int32_t resX, resY;
+};
+const char texCacheMagic[8] = {'P', 'B', 'R', 'T', 'T', 'E', 'X', '\0'};
+PBRT_CONSTEXPR uint32_t texCacheVersion = 1;
+std::mutex contentMutex;
+}  // namespace
+
+// Hash the source file's raw bytes together with the conversion parameters;
+// reading raw bytes is far cheaper than decoding the image.
+static uint64_t HashTextureInputs(const TexInfo &info) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](const void *ptr, size_t size) {
+        const unsigned char *c = (const unsigned char *)ptr;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= c[i];
+            h *= 1099511628211ull;
+        }
+    };
+    FILE *f = fopen(info.filename.c_str(), "rb");
+    if (f) {
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) mix(buf, n);
+        fclose(f);
+    }
+    mix(&info.doTrilinear, sizeof(info.doTrilinear));
+    mix(&info.maxAniso, sizeof(info.maxAniso));
+    mix(&info.wrapMode, sizeof(info.wrapMode));
+    mix(&info.scale, sizeof(info.scale));
+    mix(&info.gamma, sizeof(info.gamma));
+    return h;
+}
+
 // ImageTexture Method Definitions
 template <typename Tmemory, typename Treturn>
 ImageTexture<Tmemory, Treturn>::ImageTexture(
     std::unique_ptr<TextureMapping2D> mapping, const std::string &filename,
     bool doTrilinear, Float maxAniso, ImageWrap wrapMode, Float scale,
     bool gamma)
-    : mapping(std::move(mapping)) {
-    mipmap =
-        GetTexture(filename, doTrilinear, maxAniso, wrapMode, scale, gamma);
+    : mapping(std::move(mapping)),
+      texParams(filename, doTrilinear, maxAniso, wrapMode, scale, gamma) {
+    if (filename.find("<UDIM>") != std::string::npos) {
+        // UDIM pattern: per-tile textures are created and loaded lazily on
+        // first lookup, so tiles the camera never sees cost nothing
+        udim = true;
+        entry = nullptr;
+        return;
+    }
+    entry = GetTexture(filename, doTrilinear, maxAniso, wrapMode, scale, gamma);
+    // Without a texture budget the texture is permanently resident, but
+    // loading is deferred so LoadPending() can convert all of the scene's
+    // textures in parallel before rendering; Evaluate() resolves and
+    // caches the raw pointer on first use
+}
+
+template <typename Tmemory, typename Treturn>
+Treturn ImageTexture<Tmemory, Treturn>::EvaluateUDIM(
+    const Point2f &st, const Vector2f &dstdx, const Vector2f &dstdy) const {
+    // Select the UDIM tile from the integer parts of the uv coordinates
+    int uTile = Clamp((int)std::floor(st.x), 0, 9);
+    int vTile = Clamp((int)std::floor(st.y), 0, 9);
+    int tileIndex = uTile + 10 * vTile;
+    CacheEntry *e = udimEntries[tileIndex].load(std::memory_order_acquire);
+    if (!e) {
+        // Expand the pattern and create (and in unbudgeted mode load) the
+        // tile's texture; GetTexture dedupes racing threads
+        std::string tileFilename = texParams.filename;
+        size_t pos = tileFilename.find("<UDIM>");
+        tileFilename.replace(pos, 6,
+                             std::to_string(1001 + uTile + 10 * vTile));
+        e = GetTexture(tileFilename, texParams.doTrilinear,
+                       texParams.maxAniso, texParams.wrapMode, texParams.scale,
+                       texParams.gamma);
+        udimEntries[tileIndex].store(e, std::memory_order_release);
+    }
+    // Tiles load lazily regardless of the budget setting; the shared_ptr
+    // keeps the tile alive across a concurrent eviction
+    std::shared_ptr<MIPMap<Tmemory>> hold = std::atomic_load(&e->mipmap);
+    if (!hold) hold = FetchBudgeted(e);
+    MIPMap<Tmemory> *mip = hold.get();
+    Point2f stLocal(st.x - uTile, st.y - vTile);
+    Tmemory mem = mip->Lookup(stLocal, dstdx, dstdy);
+    Treturn ret;
+    convertOut(mem, &ret);
+    return ret;
 }
 
 template <typename Tmemory, typename Treturn>
-MIPMap<Tmemory> *ImageTexture<Tmemory, Treturn>::GetTexture(
-    const std::string &filename, bool doTrilinear, Float maxAniso,
-    ImageWrap wrap, Float scale, bool gamma) {
-    // Return _MIPMap_ from texture cache if present
+typename ImageTexture<Tmemory, Treturn>::CacheEntry *
+ImageTexture<Tmemory, Treturn>::GetTexture(const std::string &filename,
+                                           bool doTrilinear, Float maxAniso,
+                                           ImageWrap wrap, Float scale,
+                                           bool gamma) {
+    // Return the texture cache entry, creating (and, unless a budget is
+    // set, immediately loading) it if needed
     TexInfo texInfo(filename, doTrilinear, maxAniso, wrap, scale, gamma);
-    if (textures.find(texInfo) != textures.end())
-        return textures[texInfo].get();
+    std::lock_guard<std::mutex> lock(textureMutex);
+    auto iter = textures.find(texInfo);
+    if (iter == textures.end())
+        iter = textures
+                   .emplace(std::piecewise_construct,
+                            std::forward_as_tuple(texInfo),
+                            std::forward_as_tuple(texInfo))
+                   .first;
+    CacheEntry *entry = &iter->second;
+    if (!entry->mipmap && PbrtOptions.textureBudgetMB <= 0 &&
+        !entry->queued) {
+        // Defer the load; LoadPending() runs the queued conversions in
+        // parallel before rendering, and FetchBudgeted() covers any
+        // texture used before that. Meanwhile, start pulling the file
+        // toward the page cache.
+        PrefetchFileAsync(texInfo.filename);
+        pendingLoads.push_back(entry);
+        entry->queued = true;
+    }
+    return entry;
+}
+
+// Tag-dispatched texel conversion for LoadMIPMapFromFile(). The true_type
+// overload (Tmemory is RGBSpectrum, the common case for spectrum textures)
+// converts in place in the decoded buffer and hands it back; the
+// false_type overload allocates the destination type and frees the decoded
+// buffer before returning, so the caller never holds both full-resolution
+// images while building the MIPMap.
+template <typename Tmemory, typename ConvertFn>
+static std::unique_ptr<Tmemory[]> ConvertTexelBuffer(
+    std::unique_ptr<RGBSpectrum[]> texels, const Point2i &resolution,
+    ConvertFn convert, std::true_type) {
+    ParallelFor([&](int64_t i) { convert(texels[i], &texels[i]); },
+                resolution.x * resolution.y, 4096);
+    return std::unique_ptr<Tmemory[]>(texels.release());
+}
 
+template <typename Tmemory, typename ConvertFn>
+static std::unique_ptr<Tmemory[]> ConvertTexelBuffer(
+    std::unique_ptr<RGBSpectrum[]> texels, const Point2i &resolution,
+    ConvertFn convert, std::false_type) {
+    std::unique_ptr<Tmemory[]> converted(
+        new Tmemory[resolution.x * resolution.y]);
+    ParallelFor([&](int64_t i) { convert(texels[i], &converted[i]); },
+                resolution.x * resolution.y, 4096);
+    texels.reset();
+    return converted;
+}
+
+template <typename Tmemory, typename Treturn>
+std::shared_ptr<MIPMap<Tmemory>>
+ImageTexture<Tmemory, Treturn>::LoadMIPMapFromFile(const TexInfo &texInfo,
+                                                   size_t *bytes) {
     // Create _MIPMap_ for _filename_
     ProfilePhase _(Prof::TextureLoading);
+
+    // With a texture cache directory, dedupe by content hash and try the
+    // persistent converted-texel cache before decoding
+    static std::map<uint64_t, std::shared_ptr<MIPMap<Tmemory>>>
+        contentTextures;
+    uint64_t contentHash = 0;
+    std::string cachePath;
+    PBRT_CONSTEXPR int nCh = NumTexelChannels((Tmemory *)nullptr);
+    // In-memory content sharing is disabled under a residency budget,
+    // where retaining extra references would defeat eviction
+    bool shareContent =
+        !PbrtOptions.texCacheDir.empty() && PbrtOptions.textureBudgetMB <= 0;
+    if (!PbrtOptions.texCacheDir.empty()) {
+        contentHash = HashTextureInputs(texInfo);
+        if (shareContent) {
+            std::lock_guard<std::mutex> lock(contentMutex);
+            auto iter = contentTextures.find(contentHash);
+            if (iter != contentTextures.end()) {
+                // Identical content already converted; share its mipmap
+                *bytes = 0;
+                return iter->second;
+            }
+        }
+        cachePath = PbrtOptions.texCacheDir + "/" +
+                    StringPrintf("tex-%016llx.bin",
+                                 (unsigned long long)contentHash);
+        FILE *f = fopen(cachePath.c_str(), "rb");
+        if (f) {
+            TexCacheHeader header;
+            bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+                      memcmp(header.magic, texCacheMagic,
+                             sizeof(texCacheMagic)) == 0 &&
+                      header.version == texCacheVersion &&
+                      header.floatSize == sizeof(Float) &&
+                      header.nChannels == (uint32_t)nCh && header.resX > 0 &&
+                      header.resY > 0;
+            if (ok) {
+                std::unique_ptr<Tmemory[]> texels(
+                    new Tmemory[(size_t)header.resX * header.resY]);
+                ok = fread(texels.get(), sizeof(Tmemory),
+                           (size_t)header.resX * header.resY, f) ==
+                     (size_t)header.resX * header.resY;
+                if (ok) {
+                    fclose(f);
+                    *bytes = (size_t)(4.f / 3.f * header.resX * header.resY *
+                                      sizeof(Tmemory));
+                    auto mip = std::make_shared<MIPMap<Tmemory>>(
+                        Point2i(header.resX, header.resY), texels.get(),
+                        texInfo.doTrilinear, texInfo.maxAniso,
+                        texInfo.wrapMode);
+                    if (shareContent) {
+                        std::lock_guard<std::mutex> lock(contentMutex);
+                        contentTextures[contentHash] = mip;
+                    }
+                    return mip;
+                }
+            }
+            fclose(f);
+        }
+    }
+
     Point2i resolution;
-    std::unique_ptr<RGBSpectrum[]> texels = ReadImage(filename, &resolution);
+    std::unique_ptr<RGBSpectrum[]> texels =
+        ReadImage(texInfo.filename, &resolution);
     if (!texels) {
         Warning("Creating a constant grey texture to replace \"%s\".",
-                filename.c_str());
+                texInfo.filename.c_str());
         resolution.x = resolution.y = 1;
         RGBSpectrum *rgb = new RGBSpectrum[1];
         *rgb = RGBSpectrum(0.5f);
@@ -73,34 +279,166 @@ MIPMap<Tmemory> *ImageTexture<Tmemory, Treturn>::GetTexture(
 
     // Flip image in y; texture coordinate space has (0,0) at the lower
     // left corner.
-    for (int y = 0; y < resolution.y / 2; ++y)
+    ParallelFor([&](int64_t y) {
         for (int x = 0; x < resolution.x; ++x) {
             int o1 = y * resolution.x + x;
             int o2 = (resolution.y - 1 - y) * resolution.x + x;
             std::swap(texels[o1], texels[o2]);
         }
+    }, resolution.y / 2, 64);
+
+    // Convert texels to type _Tmemory_ and create _MIPMap_. When the
+    // in-memory type is RGBSpectrum the scale/gamma conversion runs in
+    // place in the decoded buffer, and otherwise the decoded buffer is
+    // released as soon as the converted copy exists - either way only one
+    // full-resolution buffer is alive alongside the MIPMap's own storage
+    // below, rather than both.
+    std::unique_ptr<Tmemory[]> convertedTexels = ConvertTexelBuffer<Tmemory>(
+        std::move(texels), resolution,
+        [&texInfo](const RGBSpectrum &from, Tmemory *to) {
+            convertIn(from, to, texInfo.scale, texInfo.gamma);
+        },
+        std::is_same<Tmemory, RGBSpectrum>());
+    // The pyramid is roughly four thirds of the base level
+    *bytes = (size_t)(4.f / 3.f * resolution.x * resolution.y *
+                      sizeof(Tmemory));
 
-    MIPMap<Tmemory> *mipmap = nullptr;
-    if (texels) {
-        // Convert texels to type _Tmemory_ and create _MIPMap_
-        std::unique_ptr<Tmemory[]> convertedTexels(
-            new Tmemory[resolution.x * resolution.y]);
-        for (int i = 0; i < resolution.x * resolution.y; ++i)
-            convertIn(texels[i], &convertedTexels[i], scale, gamma);
-        mipmap = new MIPMap<Tmemory>(resolution, convertedTexels.get(),
-                                     doTrilinear, maxAniso, wrap);
-    } else {
-        // Create one-valued _MIPMap_
-        Tmemory oneVal = scale;
-        mipmap = new MIPMap<Tmemory>(Point2i(1, 1), &oneVal);
+    // Persist the converted texels for future runs and register the
+    // content hash so identical files under other paths share this mipmap
+    if (!cachePath.empty()) {
+        // Unique temporary name: identical-content textures loading in
+        // parallel may race to write the same cache file
+        std::string tmpPath =
+            cachePath + StringPrintf(".%d.tmp", ThreadIndex);
+        FILE *f = fopen(tmpPath.c_str(), "wb");
+        if (f) {
+            TexCacheHeader header = {};
+            memcpy(header.magic, texCacheMagic, sizeof(texCacheMagic));
+            header.version = texCacheVersion;
+            header.floatSize = sizeof(Float);
+            header.nChannels = nCh;
+            header.resX = resolution.x;
+            header.resY = resolution.y;
+            bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                      fwrite(convertedTexels.get(), sizeof(Tmemory),
+                             (size_t)resolution.x * resolution.y, f) ==
+                          (size_t)resolution.x * resolution.y;
+            if (fclose(f) != 0) ok = false;
+            if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+                remove(tmpPath.c_str());
+        }
+    }
+    auto mip = std::make_shared<MIPMap<Tmemory>>(
+        resolution, convertedTexels.get(), texInfo.doTrilinear,
+        texInfo.maxAniso, texInfo.wrapMode);
+    if (shareContent) {
+        std::lock_guard<std::mutex> lock(contentMutex);
+        contentTextures[contentHash] = mip;
     }
-    textures[texInfo].reset(mipmap);
-    return mipmap;
+    return mip;
+}
+
+template <typename Tmemory, typename Treturn>
+MIPMap<Tmemory> *ImageTexture<Tmemory, Treturn>::EnsureMomentMap(
+    MIPMap<Tmemory> *base) const {
+    MIPMap<Tmemory> *mm = momentMap.load(std::memory_order_acquire);
+    if (mm) return mm;
+    std::lock_guard<std::mutex> lock(momentMutex);
+    mm = momentMap.load(std::memory_order_relaxed);
+    if (mm) return mm;
+    // Square the base level and build a pyramid over it with the same
+    // filtering configuration as the texture itself.
+    int width = base->Width(), height = base->Height();
+    std::vector<Tmemory> squared((size_t)width * height);
+    for (int t = 0; t < height; ++t)
+        for (int s = 0; s < width; ++s) {
+            Tmemory v = base->Texel(0, s, t);
+            squared[(size_t)t * width + s] = v * v;
+        }
+    momentStorage.reset(new MIPMap<Tmemory>(
+        Point2i(width, height), squared.data(), texParams.doTrilinear,
+        texParams.maxAniso, texParams.wrapMode));
+    momentMap.store(momentStorage.get(), std::memory_order_release);
+    return momentStorage.get();
 }
 
 template <typename Tmemory, typename Treturn>
-std::map<TexInfo, std::unique_ptr<MIPMap<Tmemory>>>
+void ImageTexture<Tmemory, Treturn>::LoadPending() {
+    std::vector<CacheEntry *> pending;
+    {
+        std::lock_guard<std::mutex> lock(textureMutex);
+        pending.swap(pendingLoads);
+    }
+    if (pending.empty()) return;
+    LOG(INFO) << "Loading " << pending.size() << " textures in parallel";
+    ParallelFor([&pending](int64_t i) {
+        CacheEntry *e = pending[i];
+        size_t bytes;
+        std::shared_ptr<MIPMap<Tmemory>> mip =
+            LoadMIPMapFromFile(e->texInfo, &bytes);
+        e->bytes = bytes;
+        textureBytes += bytes;
+        std::atomic_store(&e->mipmap, mip);
+    }, pending.size(), 1);
+}
+
+// Load the deferred textures of both image texture instantiations
+void LoadPendingTextures() {
+    ImageTexture<Float, Float>::LoadPending();
+    ImageTexture<RGBSpectrum, Spectrum>::LoadPending();
+}
+
+STAT_COUNTER("Texture/Budgeted texture loads", nBudgetedTextureLoads);
+STAT_COUNTER("Texture/Budgeted texture evictions", nTextureEvictions);
+
+template <typename Tmemory, typename Treturn>
+std::shared_ptr<MIPMap<Tmemory>>
+ImageTexture<Tmemory, Treturn>::FetchBudgeted(CacheEntry *entry) {
+    entry->lastUse.store(++textureUseTick, std::memory_order_relaxed);
+    std::shared_ptr<MIPMap<Tmemory>> mip = std::atomic_load(&entry->mipmap);
+    if (mip) return mip;
+
+    // (Re)load the texture and evict least-recently-used ones past the
+    // residency budget; readers holding shared_ptrs keep evicted mipmaps
+    // alive until they finish their lookups
+    std::lock_guard<std::mutex> lock(textureMutex);
+    mip = std::atomic_load(&entry->mipmap);
+    if (mip) return mip;
+    mip = LoadMIPMapFromFile(entry->texInfo, &entry->bytes);
+    ++nBudgetedTextureLoads;
+    textureBytes += entry->bytes;
+    int64_t budget = (int64_t)PbrtOptions.textureBudgetMB << 20;
+    while (PbrtOptions.textureBudgetMB > 0 && textureBytes > budget) {
+        CacheEntry *lru = nullptr;
+        for (auto &tex : textures) {
+            CacheEntry *e = &tex.second;
+            if (e == entry || !e->mipmap) continue;
+            if (!lru || e->lastUse.load(std::memory_order_relaxed) <
+                            lru->lastUse.load(std::memory_order_relaxed))
+                lru = e;
+        }
+        if (!lru) break;
+        std::atomic_store(&lru->mipmap,
+                          std::shared_ptr<MIPMap<Tmemory>>());
+        textureBytes -= lru->bytes;
+        ++nTextureEvictions;
+    }
+    std::atomic_store(&entry->mipmap, mip);
+    return mip;
+}
+
+template <typename Tmemory, typename Treturn>
+std::map<TexInfo, typename ImageTexture<Tmemory, Treturn>::CacheEntry>
     ImageTexture<Tmemory, Treturn>::textures;
+template <typename Tmemory, typename Treturn>
+std::vector<typename ImageTexture<Tmemory, Treturn>::CacheEntry *>
+    ImageTexture<Tmemory, Treturn>::pendingLoads;
+template <typename Tmemory, typename Treturn>
+std::mutex ImageTexture<Tmemory, Treturn>::textureMutex;
+template <typename Tmemory, typename Treturn>
+std::atomic<uint64_t> ImageTexture<Tmemory, Treturn>::textureUseTick;
+template <typename Tmemory, typename Treturn>
+std::atomic<int64_t> ImageTexture<Tmemory, Treturn>::textureBytes;
 ImageTexture<Float, Float> *CreateImageFloatTexture(const Transform &tex2world,
                                                     const TextureParams &tp) {
     // Initialize 2D texture mapping _map_ from _tp_
@@ -43,7 +43,11 @@
 #include "texture.h"
 #include "mipmap.h"
 #include "paramset.h"
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 
 namespace pbrt {
 
@@ -83,21 +87,106 @@ class ImageTexture : public Texture<Treturn> {
                  ImageWrap wm, Float scale, bool gamma);
     static void ClearCache() {
         textures.erase(textures.begin(), textures.end());
+        pendingLoads.clear();
+        textureBytes = 0;
     }
+    // Load every texture queued during parsing in parallel; called before
+    // rendering starts so texture conversion overlaps across files instead
+    // of serializing inside the parse
+    static void LoadPending();
     Treturn Evaluate(const SurfaceInteraction &si) const {
         Vector2f dstdx, dstdy;
         Point2f st = mapping->Map(si, &dstdx, &dstdy);
-        Tmemory mem = mipmap->Lookup(st, dstdx, dstdy);
+        if (udim) return EvaluateUDIM(st, dstdx, dstdy);
+        Tmemory mem;
+        MIPMap<Tmemory> *mip = mipmap.load(std::memory_order_acquire);
+        if (mip)
+            // Fully resident texture: direct lookup
+            mem = mip->Lookup(st, dstdx, dstdy);
+        else if (PbrtOptions.textureBudgetMB > 0) {
+            // Budgeted mode: fetch (possibly reloading) the shared mipmap;
+            // holding the shared_ptr keeps it alive across eviction
+            std::shared_ptr<MIPMap<Tmemory>> hold = FetchBudgeted(entry);
+            mem = hold->Lookup(st, dstdx, dstdy);
+        } else {
+            // First use of a texture the parallel warm-up didn't cover
+            std::shared_ptr<MIPMap<Tmemory>> hold = FetchBudgeted(entry);
+            mip = hold.get();
+            mipmap.store(mip, std::memory_order_release);
+            mem = mip->Lookup(st, dstdx, dstdy);
+        }
         Treturn ret;
         convertOut(mem, &ret);
         return ret;
     }
+    // Variance of the texture over the lookup footprint - the detail that
+    // the filtered Evaluate() just discarded - computed as E[T^2] - E[T]^2
+    // with a lazily built pyramid of squared texels. Only bump maps ask
+    // for this, so the extra pyramid costs nothing elsewhere.
+    Treturn EvaluateVariance(const SurfaceInteraction &si) const {
+        Vector2f dstdx, dstdy;
+        Point2f st = mapping->Map(si, &dstdx, &dstdy);
+        Treturn zero;
+        convertOut(Tmemory(0.f), &zero);
+        if (udim) return zero;
+        MIPMap<Tmemory> *mip = mipmap.load(std::memory_order_acquire);
+        std::shared_ptr<MIPMap<Tmemory>> hold;
+        if (!mip) {
+            hold = FetchBudgeted(entry);
+            mip = hold.get();
+        }
+        if (!mip) return zero;
+        MIPMap<Tmemory> *moments = EnsureMomentMap(mip);
+        if (!moments) return zero;
+        Tmemory mean = mip->Lookup(st, dstdx, dstdy);
+        Tmemory m2 = moments->Lookup(st, dstdx, dstdy);
+        Treturn ret;
+        convertOut(m2 - mean * mean, &ret);
+        return ret;
+    }
+    void EvaluateN(const SurfaceInteraction *si, int n, Treturn *out) const {
+        if (udim) {
+            for (int i = 0; i < n; ++i) out[i] = Evaluate(si[i]);
+            return;
+        }
+        // Fetch the mipmap once for the whole batch; in budgeted mode this
+        // amortizes the atomic shared_ptr access across the points, and
+        // the batch's coherent lookups share mip-level cache lines
+        MIPMap<Tmemory> *mip = mipmap.load(std::memory_order_acquire);
+        std::shared_ptr<MIPMap<Tmemory>> hold;
+        if (!mip) {
+            hold = FetchBudgeted(entry);
+            mip = hold.get();
+            if (PbrtOptions.textureBudgetMB <= 0)
+                mipmap.store(mip, std::memory_order_release);
+        }
+        for (int i = 0; i < n; ++i) {
+            Vector2f dstdx, dstdy;
+            Point2f st = mapping->Map(si[i], &dstdx, &dstdy);
+            convertOut(mip->Lookup(st, dstdx, dstdy), &out[i]);
+        }
+    }
 
   private:
+    // ImageTexture Private Declarations
+    struct CacheEntry {
+        std::shared_ptr<MIPMap<Tmemory>> mipmap;  // via std::atomic_* ops
+        TexInfo texInfo;
+        size_t bytes = 0;
+        bool queued = false;
+        std::atomic<uint64_t> lastUse{0};
+        CacheEntry(const TexInfo &info) : texInfo(info) {}
+    };
+
     // ImageTexture Private Methods
-    static MIPMap<Tmemory> *GetTexture(const std::string &filename,
-                                       bool doTrilinear, Float maxAniso,
-                                       ImageWrap wm, Float scale, bool gamma);
+    static CacheEntry *GetTexture(const std::string &filename,
+                                  bool doTrilinear, Float maxAniso,
+                                  ImageWrap wm, Float scale, bool gamma);
+    static std::shared_ptr<MIPMap<Tmemory>> LoadMIPMapFromFile(
+        const TexInfo &info, size_t *bytes);
+    static std::shared_ptr<MIPMap<Tmemory>> FetchBudgeted(CacheEntry *entry);
+    Treturn EvaluateUDIM(const Point2f &st, const Vector2f &dstdx,
+                         const Vector2f &dstdy) const;
     static void convertIn(const RGBSpectrum &from, RGBSpectrum *to, Float scale,
                           bool gamma) {
         for (int i = 0; i < RGBSpectrum::nSamples; ++i)
@@ -116,13 +205,35 @@ class ImageTexture : public Texture<Treturn> {
 
     // ImageTexture Private Data
     std::unique_ptr<TextureMapping2D> mapping;
-    MIPMap<Tmemory> *mipmap;
-    static std::map<TexInfo, std::unique_ptr<MIPMap<Tmemory>>> textures;
+    // Cached raw pointer, non-null once a permanently resident (no
+    // budget) texture has been resolved
+    mutable std::atomic<MIPMap<Tmemory> *> mipmap{nullptr};
+    CacheEntry *entry;
+    // Lazily built squared-texel pyramid for EvaluateVariance(); the
+    // unique_ptr owns it, the atomic publishes it.
+    MIPMap<Tmemory> *EnsureMomentMap(MIPMap<Tmemory> *base) const;
+    mutable std::atomic<MIPMap<Tmemory> *> momentMap{nullptr};
+    mutable std::unique_ptr<MIPMap<Tmemory>> momentStorage;
+    mutable std::mutex momentMutex;
+    // UDIM mode: the filename contains "<UDIM>", tiles load lazily on
+    // first lookup into per-tile cache entries (10x10 tile grid)
+    bool udim = false;
+    TexInfo texParams;
+    mutable std::atomic<CacheEntry *> udimEntries[100] = {};
+    static std::map<TexInfo, CacheEntry> textures;
+    static std::vector<CacheEntry *> pendingLoads;
+    static std::mutex textureMutex;
+    static std::atomic<uint64_t> textureUseTick;
+    static std::atomic<int64_t> textureBytes;
 };
 
 extern template class ImageTexture<Float, Float>;
 extern template class ImageTexture<RGBSpectrum, Spectrum>;
 
+// Loads all textures whose creation was deferred during parsing, in
+// parallel; called before the aggregate is built.
+void LoadPendingTextures();
+
 ImageTexture<Float, Float> *CreateImageFloatTexture(const Transform &tex2world,
                                                     const TextureParams &tp);
 ImageTexture<RGBSpectrum, Spectrum> *CreateImageSpectrumTexture(
@@ -59,6 +59,19 @@ class MixTexture : public Texture<T> {
         Float amt = amount->Evaluate(si);
         return (1 - amt) * t1 + amt * t2;
     }
+    void EvaluateN(const SurfaceInteraction *si, int n, T *out) const {
+        PBRT_CONSTEXPR int chunkSize = 16;
+        T v1[chunkSize];
+        Float amt[chunkSize];
+        for (int i = 0; i < n; i += chunkSize) {
+            int c = std::min(chunkSize, n - i);
+            tex1->EvaluateN(si + i, c, v1);
+            tex2->EvaluateN(si + i, c, out + i);
+            amount->EvaluateN(si + i, c, amt);
+            for (int j = 0; j < c; ++j)
+                out[i + j] = (1 - amt[j]) * v1[j] + amt[j] * out[i + j];
+        }
+    }
 
   private:
     std::shared_ptr<Texture<T>> tex1, tex2;
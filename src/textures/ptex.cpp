@@ -48,10 +48,14 @@ namespace {
 // being created/destroyed concurrently by multiple threads.
 int nActiveTextures;
 Ptex::PtexCache *cache;
+// Settings the shared cache was created with, for mismatch warnings
+int cacheMaxFiles;
+size_t cacheMaxMem;
 
 STAT_COUNTER("Texture/Ptex lookups", nLookups);
 STAT_COUNTER("Texture/Ptex files accessed", nFilesAccessed);
 STAT_COUNTER("Texture/Ptex block reads", nBlockReads);
+STAT_COUNTER("Texture/Ptex file reopens (cache thrash)", nFileReopens);
 STAT_MEMORY_COUNTER("Memory/Ptex peak memory used", peakMemoryUsed);
 
 struct : public PtexErrorHandler {
@@ -62,18 +66,29 @@ struct : public PtexErrorHandler {
 
 // PtexTexture Method Definitions
 template <typename T>
-PtexTexture<T>::PtexTexture(const std::string &filename, Float gamma)
+PtexTexture<T>::PtexTexture(const std::string &filename, Float gamma,
+                            int cacheFiles, int cacheMB)
     : filename(filename), gamma(gamma) {
     if (!cache) {
         CHECK_EQ(nActiveTextures, 0);
-        int maxFiles = 100;
-        size_t maxMem = 1ull << 32;  // 4GB
+        int maxFiles = cacheFiles;
+        size_t maxMem = (size_t)cacheMB << 20;
         bool premultiply = true;
 
         cache = Ptex::PtexCache::create(maxFiles, maxMem, premultiply, nullptr,
                                         &errorHandler);
+        cacheMaxFiles = maxFiles;
+        cacheMaxMem = maxMem;
+        LOG(INFO) << "Created ptex cache: " << maxFiles << " max files, " <<
+            (maxMem >> 20) << " MB budget";
         // TODO? cache->setSearchPath(...);
-    }
+    } else if (cacheFiles != cacheMaxFiles ||
+               ((size_t)cacheMB << 20) != cacheMaxMem)
+        Warning(
+            "Ptex cache settings (\"cachefiles\"/\"cachemegabytes\") "
+            "differ between textures; the shared cache keeps the first "
+            "texture's values (%d files, %d MB).",
+            cacheMaxFiles, int(cacheMaxMem >> 20));
     ++nActiveTextures;
 
     // Issue an error if the texture doesn't exist or has an unsupported
@@ -103,6 +118,8 @@ PtexTexture<T>::~PtexTexture() {
         cache->getStats(stats);
         nFilesAccessed += stats.filesAccessed;
         nBlockReads += stats.blockReads;
+        // Reopens indicate the file-handle limit is too small for the scene
+        nFileReopens += stats.fileReopens;
         peakMemoryUsed = stats.peakMemUsed;
 
         cache->release();
@@ -150,6 +167,7 @@ T PtexTexture<T>::Evaluate(const SurfaceInteraction &si) const {
 
     float result[3];
     int firstChan = 0;
+    si.EnsureDifferentials();
     filter->eval(result, firstChan, nc, si.faceIndex, si.uv[0],
                  si.uv[1], si.dudx, si.dvdx, si.dudy, si.dvdy);
     filter->release();
@@ -168,14 +186,18 @@ PtexTexture<Float> *CreatePtexFloatTexture(const Transform &tex2world,
                                            const TextureParams &tp) {
     std::string filename = tp.FindFilename("filename");
     Float gamma = tp.FindFloat("gamma", 2.2);
-    return new PtexTexture<Float>(filename, gamma);
+    int cacheFiles = tp.FindInt("cachefiles", 100);
+    int cacheMB = tp.FindInt("cachemegabytes", 4096);
+    return new PtexTexture<Float>(filename, gamma, cacheFiles, cacheMB);
 }
 
 PtexTexture<Spectrum> *CreatePtexSpectrumTexture(const Transform &tex2world,
                                                  const TextureParams &tp) {
     std::string filename = tp.FindFilename("filename");
     Float gamma = tp.FindFloat("gamma", 2.2);
-    return new PtexTexture<Spectrum>(filename, gamma);
+    int cacheFiles = tp.FindInt("cachefiles", 100);
+    int cacheMB = tp.FindInt("cachemegabytes", 4096);
+    return new PtexTexture<Spectrum>(filename, gamma, cacheFiles, cacheMB);
 }
 
 }  // namespace pbrt
@@ -51,7 +51,8 @@ template <typename T>
 class PtexTexture : public Texture<T> {
   public:
     // PtexTexture Public Methods
-    PtexTexture(const std::string &filename, Float gamma);
+    PtexTexture(const std::string &filename, Float gamma,
+                int cacheFiles = 100, int cacheMB = 4096);
     ~PtexTexture();
     T Evaluate(const SurfaceInteraction &) const;
 
@@ -56,6 +56,18 @@ class ScaleTexture : public Texture<T2> {
     T2 Evaluate(const SurfaceInteraction &si) const {
         return tex1->Evaluate(si) * tex2->Evaluate(si);
     }
+    void EvaluateN(const SurfaceInteraction *si, int n, T2 *out) const {
+        // Batch both child textures in chunks so their own EvaluateN
+        // overrides can amortize
+        PBRT_CONSTEXPR int chunkSize = 16;
+        T1 v1[chunkSize];
+        for (int i = 0; i < n; i += chunkSize) {
+            int c = std::min(chunkSize, n - i);
+            tex1->EvaluateN(si + i, c, v1);
+            tex2->EvaluateN(si + i, c, out + i);
+            for (int j = 0; j < c; ++j) out[i + j] = v1[j] * out[i + j];
+        }
+    }
 
   private:
     // ScaleTexture Private Data
@@ -0,0 +1,250 @@
+// bench.cpp
+//
+// Renders a set of benchmark scenes and reports per-scene wall time, ray
+// throughput, peak resident set size, and the full statistics and profiler
+// dumps as machine-readable JSON. With --baseline, compares the timings
+// against a previous run's output and fails when a scene regresses beyond
+// the tolerance, for CI-style tracking of every commit, e.g.:
+//
+//   pbrt_bench --outfile bench.json scenes/killeroo-simple.pbrt
+//   pbrt_bench --baseline bench.json --tolerance 5 scenes/...
+//
+// Scenes should be small enough to render in seconds; their own output
+// images are written as usual.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "api.h"
+#include "parser.h"
+#include "pbrt.h"
+#include "stats.h"
+
+using namespace pbrt;
+
+static void usage(const char *msg = nullptr) {
+    if (msg) fprintf(stderr, "pbrt_bench: %s\n", msg);
+    fprintf(stderr, R"(usage: pbrt_bench [options] <scene.pbrt...>
+
+options:
+    --baseline <file>  Compare per-scene wall time against a previous
+                       pbrt_bench JSON output; exit non-zero if any scene
+                       is slower than baseline by more than the tolerance.
+    --outfile <file>   Write JSON results to the given file instead of
+                       stdout.
+    --tolerance <pct>  Allowed slowdown versus baseline, in percent.
+                       Default: 5
+)");
+    exit(1);
+}
+
+// Peak resident set size in bytes, or 0 where unavailable.
+static long long PeakRSS() {
+#ifndef _WIN32
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+    return (long long)ru.ru_maxrss;  // bytes
+#else
+    return (long long)ru.ru_maxrss * 1024;  // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+// Slurp a FILE written by one of the reporting functions back into memory.
+static std::string CaptureToString(void (*writer)(FILE *)) {
+    std::string path = "/tmp/pbrt_bench_capture";
+    FILE *f = fopen(path.c_str(), "w+");
+    if (!f) {
+        // Fall back to the working directory (e.g. on Windows)
+        path = "pbrt_bench_capture.tmp";
+        f = fopen(path.c_str(), "w+");
+        if (!f) return "{}";
+    }
+    writer(f);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    std::string s(size > 0 ? (size_t)size : 0, '\0');
+    if (size > 0 && fread(&s[0], 1, size, f) != (size_t)size) s.clear();
+    fclose(f);
+    remove(path.c_str());
+    return s;
+}
+
+static std::string JsonEscape(const std::string &s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += std::string("\\") + c;
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\t')
+            out += "\\t";
+        else if ((unsigned char)c < 0x20)
+            ;  // drop other control characters
+        else
+            out += c;
+    }
+    return out;
+}
+
+// Pull the numeric value following "key": out of a flat JSON document;
+// returns false if the key isn't present.
+static bool FindJSONNumber(const std::string &json, const std::string &key,
+                           double *value) {
+    std::string needle = "\"" + key + "\":";
+    size_t pos = json.find(needle);
+    if (pos == std::string::npos) return false;
+    return sscanf(json.c_str() + pos + needle.size(), " %lf", value) == 1;
+}
+
+// Find the seconds recorded for the given scene in a previous pbrt_bench
+// output.
+static bool BaselineSeconds(const std::string &baseline,
+                            const std::string &scene, double *seconds) {
+    std::string needle = "\"scene\": \"" + JsonEscape(scene) + "\"";
+    size_t pos = baseline.find(needle);
+    if (pos == std::string::npos) return false;
+    size_t secPos = baseline.find("\"seconds\":", pos);
+    if (secPos == std::string::npos) return false;
+    return sscanf(baseline.c_str() + secPos + 10, " %lf", seconds) == 1;
+}
+
+int main(int argc, char *argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = 1;  // Warning and above.
+
+    std::vector<std::string> scenes;
+    std::string outFile, baselineFile;
+    double tolerance = 5;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
+            usage();
+        else if (!strcmp(argv[i], "--outfile")) {
+            if (i + 1 == argc) usage("missing value after --outfile");
+            outFile = argv[++i];
+        } else if (!strcmp(argv[i], "--baseline")) {
+            if (i + 1 == argc) usage("missing value after --baseline");
+            baselineFile = argv[++i];
+        } else if (!strcmp(argv[i], "--tolerance")) {
+            if (i + 1 == argc) usage("missing value after --tolerance");
+            tolerance = atof(argv[++i]);
+        } else if (argv[i][0] == '-')
+            usage("unknown option");
+        else
+            scenes.push_back(argv[i]);
+    }
+    if (scenes.empty()) usage("no scene files given");
+
+    std::string baseline;
+    if (!baselineFile.empty()) {
+        FILE *f = fopen(baselineFile.c_str(), "r");
+        if (!f) {
+            fprintf(stderr, "pbrt_bench: %s: unable to open baseline\n",
+                    baselineFile.c_str());
+            return 1;
+        }
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) baseline.append(buf, n);
+        fclose(f);
+    }
+
+    Options options;
+    options.quiet = true;
+    pbrtInit(options);
+
+    std::string results = "{\n  \"benchmarks\": [\n";
+    int nRegressions = 0;
+    for (size_t i = 0; i < scenes.size(); ++i) {
+        const std::string &scene = scenes[i];
+        auto start = std::chrono::steady_clock::now();
+        pbrtParseFile(scene);
+        double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          start)
+                .count();
+
+        // Snapshot the per-scene statistics and profile, then reset them so
+        // the next scene starts clean. (pbrtWorldEnd() only clears stats
+        // when it prints them, which --quiet suppresses.)
+        std::string stats = CaptureToString(WriteStatsJSON);
+        std::string profile = CaptureToString(ReportProfilerResults);
+        ClearStats();
+        ClearProfiler();
+
+        double nCameraRays = 0, nShadow = 0, nRegular = 0;
+        FindJSONNumber(stats, "Integrator/Camera rays traced", &nCameraRays);
+        FindJSONNumber(stats, "Intersections/Regular ray intersection tests",
+                       &nRegular);
+        FindJSONNumber(stats, "Intersections/Shadow ray intersection tests",
+                       &nShadow);
+        double raysPerSec =
+            seconds > 0 ? (nRegular + nShadow) / seconds : 0;
+
+        char record[512];
+        snprintf(record, sizeof(record),
+                 "    {\n"
+                 "      \"scene\": \"%s\",\n"
+                 "      \"seconds\": %.3f,\n"
+                 "      \"raysPerSec\": %.0f,\n"
+                 "      \"cameraRays\": %.0f,\n"
+                 "      \"peakRSSBytes\": %lld,\n",
+                 JsonEscape(scene).c_str(), seconds, raysPerSec, nCameraRays,
+                 PeakRSS());
+        results += record;
+        results += "      \"stats\": " +
+                   (stats.empty() ? std::string("{}") : stats) + ",\n";
+        results += "      \"profile\": \"" + JsonEscape(profile) + "\"\n";
+        results += i + 1 < scenes.size() ? "    },\n" : "    }\n";
+
+        fprintf(stderr, "pbrt_bench: %s: %.3f s, %.3g Mrays/s\n",
+                scene.c_str(), seconds, raysPerSec / 1e6);
+
+        if (!baseline.empty()) {
+            double base;
+            if (!BaselineSeconds(baseline, scene, &base))
+                fprintf(stderr, "pbrt_bench: %s: not in baseline; skipping "
+                        "comparison\n", scene.c_str());
+            else if (seconds > base * (1 + tolerance / 100)) {
+                fprintf(stderr,
+                        "pbrt_bench: REGRESSION: %s: %.3f s vs baseline "
+                        "%.3f s (+%.1f%%)\n",
+                        scene.c_str(), seconds, base,
+                        100 * (seconds / base - 1));
+                ++nRegressions;
+            }
+        }
+    }
+    results += "  ]\n}\n";
+    pbrtCleanup();
+
+    if (outFile.empty())
+        fputs(results.c_str(), stdout);
+    else {
+        FILE *f = fopen(outFile.c_str(), "w");
+        if (!f || fputs(results.c_str(), f) == EOF ||
+            (f && fclose(f) != 0)) {
+            fprintf(stderr, "pbrt_bench: %s: unable to write results\n",
+                    outFile.c_str());
+            return 1;
+        }
+    }
+
+    if (nRegressions > 0) {
+        fprintf(stderr, "pbrt_bench: %d scene(s) regressed\n", nRegressions);
+        return 1;
+    }
+    return 0;
+}
@@ -14,6 +14,7 @@
 #include "pbrt.h"
 #include "spectrum.h"
 #include "parallel.h"
+#include "texture.h"
 extern "C" {
 #include "ext/ArHosekSkyModel.h"
 }
@@ -31,11 +32,18 @@ static void usage(const char *msg = nullptr, ...) {
     }
     fprintf(stderr, R"(usage: imgtool <command> [options] <filenames...>
 
-commands: assemble, cat, convert, diff, info, makesky
+commands: assemble, batch, cat, convert, denoise, diff, info, makesky, maketx
 
 assemble option:
     --outfile          Output image filename.
 
+batch usage: imgtool batch <commandfile | ->
+    Reads imgtool command lines - one invocation per line, without the
+    leading "imgtool", "#" for comments - from the given file (or stdin
+    with "-") and runs them in parallel across all cores, amortizing
+    process startup over the whole list. An erroneous command line aborts
+    the batch.
+
 cat option:
     --sort             Sort output by pixel luminance.
 
@@ -64,12 +72,25 @@ convert options:
     --tonemap          Apply tonemapping to the image (Reinhard et al.'s
                        photographic tone mapping operator)
 
+denoise options:
+    --albedo <name>    Albedo AOV filename. Default: input filename with an
+                       "_albedo" suffix (as written by "denoisingaovs").
+    --iterations <n>   Number of a-trous filter iterations (1-10). Default: 5
+    --normal <name>    Normal AOV filename. Default: "_normal" suffix.
+    --outfile <name>   Output filename. Default: "_denoised" suffix.
+    --variance <name>  Sample-variance AOV filename. Default: "_variance"
+                       suffix. Missing feature images are simply not used.
+
 diff options:
     --difftol <v>      Acceptable image difference percentage before differences
                        are reported. Default: 0
     --outfile <name>   Filename to use for saving an image that encodes the
                        absolute value of per-pixel differences.
 
+maketx options:
+    --outfile <name>   Filename for the power-of-two-resampled texture.
+                       Default: input filename with a "_tx" suffix.
+
 makesky options:
     --albedo <a>       Albedo of ground-plane (range 0-1). Default: 0.5
     --elevation <e>    Elevation of the sun in degrees (range 0-90). Default: 10
@@ -155,7 +176,6 @@ int makesky(int argc, char *argv[]) {
 
     int nTheta = resolution, nPhi = 2 * nTheta;
     std::vector<Float> img(3 * nTheta * nPhi, 0.f);
-    ParallelInit();
     ParallelFor([&](int64_t t) {
         Float theta = float(t + 0.5) / nTheta * Pi;
         if (theta > Pi / 2.) return;
@@ -183,7 +203,6 @@ int makesky(int argc, char *argv[]) {
 
     WriteImage(outfile, (Float *)&img[0], Bounds2i({0, 0}, {nPhi, nTheta}),
                {nPhi, nTheta});
-    ParallelCleanup();
     return 0;
 }
 
@@ -761,26 +780,355 @@ int convert(int argc, char *argv[]) {
     return 0;
 }
 
-int main(int argc, char *argv[]) {
-    google::InitGoogleLogging(argv[0]);
-    FLAGS_stderrthreshold = 1; // Warning and above.
+// Resample an image up to power-of-two resolution with the same
+// Lanczos-windowed reconstruction MIPMap applies at render time, so renders
+// referencing the output skip the resampling step of pyramid construction
+// entirely; the remaining 2x2 level averaging is cheap by comparison.
+static int maketx(int argc, char *argv[]) {
+    const char *outfile = nullptr, *infile = nullptr;
+    for (int i = 0; i < argc; ++i) {
+        if (!strcmp(argv[i], "--outfile") || !strcmp(argv[i], "-outfile")) {
+            if (i + 1 == argc)
+                usage("missing filename after %s option", argv[i]);
+            outfile = argv[++i];
+        } else if (infile == nullptr)
+            infile = argv[i];
+        else
+            usage("unexpected argument \"%s\"", argv[i]);
+    }
+    if (!infile) usage("no input filename provided to \"maketx\"");
+    std::string out =
+        outfile ? std::string(outfile) : [&]() {
+            std::string o = infile;
+            size_t dot = o.find_last_of('.');
+            if (dot == std::string::npos) return o + "_tx.exr";
+            return o.substr(0, dot) + "_tx" + o.substr(dot);
+        }();
 
-    if (argc < 2) usage();
+    Point2i res;
+    std::unique_ptr<RGBSpectrum[]> image = ReadImage(infile, &res);
+    if (!image) {
+        fprintf(stderr, "imgtool: unable to read \"%s\"\n", infile);
+        return 1;
+    }
+    Point2i resPow2(RoundUpPow2(res.x), RoundUpPow2(res.y));
+    if (resPow2 == res) {
+        // Already power-of-two; write through unchanged, as MIPMap would
+        // skip resampling too
+        std::unique_ptr<Float[]> rgb(new Float[3 * (size_t)res.x * res.y]);
+        for (int i = 0; i < res.x * res.y; ++i) image[i].ToRGB(&rgb[3 * i]);
+        WriteImage(out, &rgb[0], Bounds2i(Point2i(0, 0), res), res);
+        printf("%s: already power-of-two resolution; copied to \"%s\".\n",
+               infile, out.c_str());
+        return 0;
+    }
+
+    // Compute the same normalized Lanczos resampling weights MIPMap uses
+    auto resampleWeights = [](int oldRes, int newRes,
+                              std::vector<int> *firstTexel,
+                              std::vector<Float> *weights) {
+        firstTexel->resize(newRes);
+        weights->resize(4 * newRes);
+        Float filterwidth = 2.f;
+        for (int i = 0; i < newRes; ++i) {
+            Float center = (i + .5f) * oldRes / newRes;
+            (*firstTexel)[i] = std::floor((center - filterwidth) + 0.5f);
+            Float sum = 0;
+            for (int j = 0; j < 4; ++j) {
+                Float pos = (*firstTexel)[i] + j + .5f;
+                (*weights)[4 * i + j] = Lanczos((pos - center) / filterwidth);
+                sum += (*weights)[4 * i + j];
+            }
+            for (int j = 0; j < 4; ++j) (*weights)[4 * i + j] /= sum;
+        }
+    };
 
-    if (!strcmp(argv[1], "assemble"))
-        return assemble(argc - 2, argv + 2);
-    else if (!strcmp(argv[1], "cat"))
-        return cat(argc - 2, argv + 2);
-    else if (!strcmp(argv[1], "convert"))
-        return convert(argc - 2, argv + 2);
-    else if (!strcmp(argv[1], "diff"))
-        return diff(argc - 2, argv + 2);
-    else if (!strcmp(argv[1], "info"))
-        return info(argc - 2, argv + 2);
-    else if (!strcmp(argv[1], "makesky"))
-        return makesky(argc - 2, argv + 2);
+    // Resample in s, then in t, clamping coordinates at the borders
+    std::vector<int> sFirst, tFirst;
+    std::vector<Float> sWeights, tWeights;
+    resampleWeights(res.x, resPow2.x, &sFirst, &sWeights);
+    resampleWeights(res.y, resPow2.y, &tFirst, &tWeights);
+    std::unique_ptr<RGBSpectrum[]> sResampled(
+        new RGBSpectrum[(size_t)resPow2.x * res.y]);
+    ParallelFor([&](int64_t t) {
+        for (int s = 0; s < resPow2.x; ++s) {
+            RGBSpectrum v(0.f);
+            for (int j = 0; j < 4; ++j) {
+                int origS = Clamp(sFirst[s] + j, 0, res.x - 1);
+                v += sWeights[4 * s + j] * image[t * res.x + origS];
+            }
+            sResampled[t * resPow2.x + s] = v;
+        }
+    }, res.y, 16);
+    std::unique_ptr<RGBSpectrum[]> resampled(
+        new RGBSpectrum[(size_t)resPow2.x * resPow2.y]);
+    ParallelFor([&](int64_t s) {
+        for (int t = 0; t < resPow2.y; ++t) {
+            RGBSpectrum v(0.f);
+            for (int j = 0; j < 4; ++j) {
+                int origT = Clamp(tFirst[t] + j, 0, res.y - 1);
+                v += tWeights[4 * t + j] * sResampled[origT * resPow2.x + s];
+            }
+            resampled[t * resPow2.x + s] = v.Clamp(0.f, Infinity);
+        }
+    }, resPow2.x, 16);
+
+    std::unique_ptr<Float[]> rgb(new Float[3 * (size_t)resPow2.x * resPow2.y]);
+    for (int i = 0; i < resPow2.x * resPow2.y; ++i)
+        resampled[i].ToRGB(&rgb[3 * i]);
+    WriteImage(out, &rgb[0], Bounds2i(Point2i(0, 0), resPow2), resPow2);
+    printf("%s: wrote %dx%d texture to \"%s\".\n", infile, resPow2.x,
+           resPow2.y, out.c_str());
+    return 0;
+}
+
+int denoise(int argc, char *argv[]) {
+    std::string inFile, outFile, albedoFile, normalFile, varianceFile;
+    int iterations = 5;
+    for (int i = 0; i < argc; ++i) {
+        auto value = [&](const char *flag) -> const char * {
+            if (i + 1 == argc) usage("missing value after %s flag", flag);
+            return argv[++i];
+        };
+        if (!strcmp(argv[i], "--outfile") || !strcmp(argv[i], "-outfile"))
+            outFile = value("--outfile");
+        else if (!strcmp(argv[i], "--albedo") || !strcmp(argv[i], "-albedo"))
+            albedoFile = value("--albedo");
+        else if (!strcmp(argv[i], "--normal") || !strcmp(argv[i], "-normal"))
+            normalFile = value("--normal");
+        else if (!strcmp(argv[i], "--variance") ||
+                 !strcmp(argv[i], "-variance"))
+            varianceFile = value("--variance");
+        else if (!strcmp(argv[i], "--iterations") ||
+                 !strcmp(argv[i], "-iterations")) {
+            iterations = atoi(value("--iterations"));
+            if (iterations < 1 || iterations > 10)
+                usage("--iterations must be between 1 and 10");
+        } else if (argv[i][0] == '-')
+            usage("unknown \"denoise\" option \"%s\"", argv[i]);
+        else if (inFile.empty())
+            inFile = argv[i];
+        else
+            usage("excess filename \"%s\" provided to \"denoise\"", argv[i]);
+    }
+    if (inFile.empty()) usage("missing image filename for \"denoise\"");
+
+    // The film writes the denoising AOVs alongside the image with _albedo,
+    // _normal, and _variance suffixes; derive those names (and the output
+    // name) unless they were given explicitly.
+    auto derived = [&inFile](const char *suffix) {
+        std::string s = inFile;
+        size_t dot = s.find_last_of('.');
+        if (dot == std::string::npos)
+            s += suffix;
+        else
+            s.insert(dot, suffix);
+        return s;
+    };
+    if (albedoFile.empty()) albedoFile = derived("_albedo");
+    if (normalFile.empty()) normalFile = derived("_normal");
+    if (varianceFile.empty()) varianceFile = derived("_variance");
+    if (outFile.empty()) outFile = derived("_denoised");
+
+    Point2i res;
+    std::unique_ptr<RGBSpectrum[]> image = ReadImage(inFile, &res);
+    if (!image) {
+        fprintf(stderr, "imgtool: %s: unable to read image\n",
+                inFile.c_str());
+        return 1;
+    }
+    // Features are optional: filtering degrades gracefully to a plain
+    // edge-stopping filter on the image itself when one is missing.
+    auto readFeature =
+        [&res](const std::string &name) -> std::unique_ptr<RGBSpectrum[]> {
+        FILE *f = fopen(name.c_str(), "rb");
+        if (!f) return nullptr;
+        fclose(f);
+        Point2i fres;
+        std::unique_ptr<RGBSpectrum[]> img = ReadImage(name, &fres);
+        if (img && fres != res) {
+            fprintf(stderr,
+                    "imgtool: %s: resolution doesn't match image; ignoring\n",
+                    name.c_str());
+            return nullptr;
+        }
+        return img;
+    };
+    std::unique_ptr<RGBSpectrum[]> albedo = readFeature(albedoFile);
+    std::unique_ptr<RGBSpectrum[]> normal = readFeature(normalFile);
+    std::unique_ptr<RGBSpectrum[]> variance = readFeature(varianceFile);
+
+    int nPixels = res.x * res.y;
+    std::vector<Float> lumVariance(nPixels, (Float)0.01);
+    if (variance)
+        for (int i = 0; i < nPixels; ++i) lumVariance[i] = variance[i][0];
+    std::vector<Vector3f> n(nPixels, Vector3f(0, 0, 0));
+    if (normal)
+        for (int i = 0; i < nPixels; ++i) {
+            Float rgb[3];
+            normal[i].ToRGB(rgb);
+            Vector3f v(rgb[0], rgb[1], rgb[2]);
+            if (v.LengthSquared() > 0) n[i] = Normalize(v);
+        }
+
+    // Edge-avoiding a-trous filter: each iteration applies a 5x5 B3-spline
+    // kernel with doubling step size, with weights that stop at luminance
+    // edges (normalized by the pixel's sample variance), normal edges, and
+    // albedo edges, so smooth noisy regions blur while geometry and
+    // texture detail survive.
+    std::vector<RGBSpectrum> src(image.get(), image.get() + nPixels);
+    std::vector<RGBSpectrum> dst(nPixels);
+    const Float kernel[5] = {1.f / 16.f, 4.f / 16.f, 6.f / 16.f, 4.f / 16.f,
+                             1.f / 16.f};
+    for (int iter = 0; iter < iterations; ++iter) {
+        int step = 1 << iter;
+        ParallelFor(
+            [&](int64_t y) {
+                for (int x = 0; x < res.x; ++x) {
+                    int p = y * res.x + x;
+                    Float sigmaL =
+                        4 * std::sqrt(std::max((Float)0, lumVariance[p])) +
+                        (Float)1e-3;
+                    RGBSpectrum sum(0.f);
+                    Float sumWt = 0;
+                    for (int dy = -2; dy <= 2; ++dy) {
+                        int qy = Clamp((int)y + dy * step, 0, res.y - 1);
+                        for (int dx = -2; dx <= 2; ++dx) {
+                            int qx = Clamp(x + dx * step, 0, res.x - 1);
+                            int q = qy * res.x + qx;
+                            Float w = kernel[dy + 2] * kernel[dx + 2];
+                            // Luminance edge-stopping
+                            Float dL = src[p].y() - src[q].y();
+                            w *= std::exp(-std::abs(dL) / sigmaL);
+                            // Normal edge-stopping
+                            if (normal) {
+                                Float d = std::max((Float)0, Dot(n[p], n[q]));
+                                Float d4 = (d * d) * (d * d);
+                                w *= d4 * d4;
+                            }
+                            // Albedo edge-stopping
+                            if (albedo) {
+                                Float da[3], db[3];
+                                albedo[p].ToRGB(da);
+                                albedo[q].ToRGB(db);
+                                Float d2 = 0;
+                                for (int c = 0; c < 3; ++c)
+                                    d2 += (da[c] - db[c]) * (da[c] - db[c]);
+                                w *= std::exp(-d2 / (Float)0.01);
+                            }
+                            sum += w * src[q];
+                            sumWt += w;
+                        }
+                    }
+                    dst[p] = sumWt > 0 ? sum / sumWt : src[p];
+                }
+            },
+            res.y, 16);
+        std::swap(src, dst);
+    }
+
+    WriteImage(outFile, (Float *)&src[0], Bounds2i(Point2i(0, 0), res), res);
+    return 0;
+}
+
+int batch(int argc, char *argv[]);
+
+// Shared by main() and batch(): argv[0] holds the command name.
+static int dispatchCommand(int argc, char *argv[]) {
+    if (argc < 1) usage();
+
+    if (!strcmp(argv[0], "assemble"))
+        return assemble(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "batch"))
+        return batch(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "cat"))
+        return cat(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "convert"))
+        return convert(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "denoise"))
+        return denoise(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "diff"))
+        return diff(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "info"))
+        return info(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "makesky"))
+        return makesky(argc - 1, argv + 1);
+    else if (!strcmp(argv[0], "maketx"))
+        return maketx(argc - 1, argv + 1);
     else
-        usage("unknown command \"%s\"", argv[1]);
+        usage("unknown command \"%s\"", argv[0]);
 
     return 0;
 }
+
+// Split a batch line into argv-style tokens; double quotes protect
+// whitespace in filenames.
+static std::vector<std::string> tokenizeCommandLine(const char *line) {
+    std::vector<std::string> tokens;
+    const char *p = line;
+    while (*p) {
+        while (isspace((unsigned char)*p)) ++p;
+        if (!*p) break;
+        std::string tok;
+        if (*p == '"') {
+            ++p;
+            while (*p && *p != '"') tok.push_back(*p++);
+            if (*p == '"') ++p;
+        } else
+            while (*p && !isspace((unsigned char)*p)) tok.push_back(*p++);
+        tokens.push_back(tok);
+    }
+    return tokens;
+}
+
+int batch(int argc, char *argv[]) {
+    if (argc != 1)
+        usage("\"batch\" expects a single command-file argument (or \"-\")");
+    FILE *f = strcmp(argv[0], "-") ? fopen(argv[0], "r") : stdin;
+    if (!f) {
+        fprintf(stderr, "imgtool: %s: unable to open command file\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::vector<std::string>> commands;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        std::vector<std::string> tokens = tokenizeCommandLine(line);
+        if (!tokens.empty() && tokens[0][0] != '#')
+            commands.push_back(std::move(tokens));
+    }
+    if (f != stdin) fclose(f);
+    if (commands.empty()) return 0;
+
+    // Run the commands over the worker pool (initialized in main); each
+    // one is an independent imgtool invocation, so this is an
+    // embarrassingly parallel loop.
+    std::atomic<int> failures(0);
+    ParallelFor(
+        [&](int64_t i) {
+            std::vector<std::string> &cmd = commands[i];
+            std::vector<char *> cmdArgv;
+            for (std::string &s : cmd) cmdArgv.push_back(&s[0]);
+            if (dispatchCommand((int)cmdArgv.size(), cmdArgv.data()) != 0)
+                ++failures;
+        },
+        commands.size(), 1);
+
+    if (failures > 0)
+        fprintf(stderr, "imgtool: %d batch command(s) failed\n",
+                (int)failures);
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = 1; // Warning and above.
+
+    if (argc < 2) usage();
+    // Commands with internal ParallelFor loops (batch, denoise) share one
+    // worker pool for the whole run.
+    ParallelInit();
+    int ret = dispatchCommand(argc - 1, argv + 1);
+    ParallelCleanup();
+    return ret;
+}
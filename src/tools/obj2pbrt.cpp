@@ -1299,19 +1299,62 @@ bool LoadObj(std::vector<shape_t> &shapes,       // [output]
 using namespace tinyobj;
 
 static void usage() {
-    fprintf(stderr, "usage: obj2pbrt [--ptexquads] <OBJ filename> <pbrt filename>\n");
+    fprintf(stderr, "usage: obj2pbrt [--ptexquads] [--ply <prefix>] "
+            "<OBJ filename> <pbrt filename>\n");
+    fprintf(stderr, "    --ply <prefix>  Write each mesh as a binary PLY "
+            "file <prefix>_NNNNN.ply and\n                    reference it "
+            "with a \"plymesh\" shape instead of emitting huge\n"
+            "                    text \"trianglemesh\" arrays.\n");
     exit(1);
 }
 
+// Write the mesh as a binary PLY file that pbrt's "plymesh" shape loads
+// directly (and caches as a .plybin sidecar), avoiding both the text write
+// here and the number parsing at render time. N and st may be null.
+// (Writes native byte order and declares little-endian, as everything we
+// run on is.)
+static bool write_binary_ply(const char *filename, size_t nVertices,
+                             const float *P, const float *N, const float *st,
+                             size_t nTriangles, const int *indices) {
+    FILE *f = fopen(filename, "wb");
+    if (!f) return false;
+    fprintf(f, "ply\nformat binary_little_endian 1.0\n");
+    fprintf(f, "element vertex %d\n", (int)nVertices);
+    fprintf(f, "property float x\nproperty float y\nproperty float z\n");
+    if (N)
+        fprintf(f, "property float nx\nproperty float ny\nproperty float nz\n");
+    if (st) fprintf(f, "property float u\nproperty float v\n");
+    fprintf(f, "element face %d\n", (int)nTriangles);
+    fprintf(f, "property list uchar int vertex_indices\n");
+    fprintf(f, "end_header\n");
+    bool ok = true;
+    for (size_t i = 0; i < nVertices; ++i) {
+        ok &= fwrite(&P[3 * i], sizeof(float), 3, f) == 3;
+        if (N) ok &= fwrite(&N[3 * i], sizeof(float), 3, f) == 3;
+        if (st) ok &= fwrite(&st[2 * i], sizeof(float), 2, f) == 2;
+    }
+    for (size_t i = 0; i < nTriangles; ++i) {
+        unsigned char nv = 3;
+        ok &= fwrite(&nv, 1, 1, f) == 1;
+        ok &= fwrite(&indices[3 * i], sizeof(int), 3, f) == 3;
+    }
+    ok &= fclose(f) == 0;
+    return ok;
+}
+
 int main(int argc, char *argv[]) {
     const char *objFilename = nullptr, *pbrtFilename = nullptr;
+    const char *plyPrefix = nullptr;
     bool ptexQuads = false;
     for (int i = 1; i < argc; ++i) {
         if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
             usage();
         else if (!strcmp(argv[i], "--ptexquads"))
             ptexQuads = true;
-        else if (!objFilename)
+        else if (!strcmp(argv[i], "--ply")) {
+            if (i + 1 == argc) usage();
+            plyPrefix = argv[++i];
+        } else if (!objFilename)
             objFilename = argv[i];
         else if (!pbrtFilename)
             pbrtFilename = argv[i];
@@ -1320,6 +1363,11 @@ int main(int argc, char *argv[]) {
     }
     if (!pbrtFilename)
         usage();
+    if (plyPrefix && ptexQuads) {
+        // The quad faceIndices layout has no PLY representation here.
+        fprintf(stderr, "obj2pbrt: --ply is ignored with --ptexquads.\n");
+        plyPrefix = nullptr;
+    }
 
     std::vector<shape_t> shapes;
     std::vector<material_t> materials;
@@ -1556,6 +1604,26 @@ int main(int argc, char *argv[]) {
                 }
             }
 
+            if (plyPrefix && !P.empty()) {
+                static int plyFileIndex = 0;
+                char plyName[1024];
+                snprintf(plyName, sizeof(plyName), "%s_%05d.ply", plyPrefix,
+                         plyFileIndex++);
+                if (write_binary_ply(plyName, P.size(), &P[0].x,
+                                     N.empty() ? nullptr : &N[0].x,
+                                     st.empty() ? nullptr : &st[0].x,
+                                     indices.size() / 3, indices.data())) {
+                    fprintf(f,
+                            "Shape \"plymesh\" \"string filename\" [ \"%s\" "
+                            "]\n\n",
+                            plyName);
+                    continue;
+                }
+                fprintf(stderr,
+                        "%s: unable to write PLY file; emitting a text mesh "
+                        "instead.\n",
+                        plyName);
+            }
             fprintf(f, "Shape \"trianglemesh\"\n");
             fprintf(f, "  \"point3 P\" [ \n");
             for (Point3f p : P)
@@ -0,0 +1,25 @@
+// pbrt2bin.cpp
+//
+// Compiles a text .pbrt scene file - with all of its Include files resolved
+// and inlined - into the binary token-stream format that pbrt's parser
+// detects and loads directly, skipping lexing at render startup. The
+// compiled file is a drop-in replacement for the original scene on the pbrt
+// command line and in Include directives.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "parser.h"
+
+static void usage() {
+    fprintf(stderr, "usage: pbrt2bin <scene.pbrt> <out.pbtk>\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) usage();
+    if (!strcmp(argv[1], "--help") || !strcmp(argv[1], "-h")) usage();
+
+    if (!pbrt::pbrtCompileSceneFile(argv[1], argv[2])) return 1;
+    return 0;
+}